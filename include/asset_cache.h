@@ -0,0 +1,76 @@
+/*
+ * asset_cache.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_ASSET_CACHE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_ASSET_CACHE_H_
+
+#include "dfw_field_trial_service_library.h"
+#include "typedefs.h"
+
+
+/**
+ * The size of the buffer needed to hold a hash from
+ * GetFileContentHash () or GetStringContentHash () including
+ * its terminating \0.
+ */
+#define ASSET_HASH_BUFFER_SIZE (17)
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Make sure that a local copy of a remote file is available and up to date.
+ *
+ * Alongside the local copy, a metadata file with a ".cache" suffix stores a hash
+ * of the url along with the ETag and Last-Modified values that the server sent.
+ * If the local copy was checked within the last max_age seconds it is used as is,
+ * otherwise a conditional request is made and the file is only downloaded again
+ * if the server says that it has changed. If the server can't be reached, any
+ * existing local copy is used.
+ *
+ * @param url_s The url of the remote file.
+ * @param full_filename_s The filename for the local copy.
+ * @param max_age The number of seconds that a local copy can be used without
+ * checking whether it is still up to date.
+ * @return <code>true</code> if the local copy is available, <code>false</code>
+ * otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool UpdateCachedAsset (const char *url_s, const char *full_filename_s, const uint32 max_age);
+
+
+/**
+ * Get a hash of the contents of a file.
+ *
+ * This is used to tell whether generated files have changed, it is not
+ * suitable for anything security related.
+ *
+ * @param filename_s The file to get the hash of.
+ * @param hash_s The buffer to write the hash into as a hex string.
+ * @return <code>true</code> if the hash was calculated successfully, <code>false</code>
+ * if the file could not be read.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool GetFileContentHash (const char *filename_s, char hash_s [ASSET_HASH_BUFFER_SIZE]);
+
+
+/**
+ * Get a hash of a string.
+ *
+ * @param value_s The string to get the hash of.
+ * @param hash_s The buffer to write the hash into as a hex string.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void GetStringContentHash (const char *value_s, char hash_s [ASSET_HASH_BUFFER_SIZE]);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_ASSET_CACHE_H_ */
@@ -35,6 +35,13 @@
 #include "mongodb_tool.h"
 //#include "sqlite_tool.h"
 #include "view_format.h"
+#include "string_hash_table.h"
+
+
+/*
+ * forward declarations
+ */
+struct SharedServiceContext;
 
 
 typedef enum
@@ -126,6 +133,7 @@ typedef struct /*DFW_FIELD_TRIAL_SERVICE_LOCAL*/ FieldTrialServiceData
 	 * @private
 	 *
 	 * The MongoTool to connect to the database where our data is stored.
+	 * This is borrowed from the pool in dftsd_context_p.
 	 */
 	MongoTool *dftsd_mongo_p;
 
@@ -256,10 +264,45 @@ typedef struct /*DFW_FIELD_TRIAL_SERVICE_LOCAL*/ FieldTrialServiceData
 	const char *dftsd_latex_commmand_s;
 
 
-	LinkedList *dftsd_measured_variables_cache_p;
+	/**
+	 * @private
+	 *
+	 * The state shared with all of the other services in this
+	 * process that use the same database. This holds the pooled
+	 * MongoTools and the MeasuredVariable and Treatment caches.
+	 */
+	struct SharedServiceContext *dftsd_context_p;
+
+	/**
+	 * @private
+	 *
+	 * The pin that stops the shared caches from freeing any
+	 * entries that this service may still be using.
+	 */
+	struct SharedServiceContextPin *dftsd_context_pin_p;
+
+	/**
+	 * @private
+	 *
+	 * Does this service use the shared MeasuredVariables cache?
+	 */
+	bool dftsd_use_measured_variables_cache_flag;
 
+	/**
+	 * @private
+	 *
+	 * Should the shared MeasuredVariables cache be filled with all of the
+	 * MeasuredVariables, both at start up and again after it has been
+	 * invalidated?
+	 */
+	bool dftsd_warm_measured_variables_cache_flag;
 
-	LinkedList *dftsd_treatments_cache_p;
+	/**
+	 * @private
+	 *
+	 * Does this service use the shared Treatments cache?
+	 */
+	bool dftsd_use_treatments_cache_flag;
 
 
 	/**
@@ -289,6 +332,235 @@ typedef struct /*DFW_FIELD_TRIAL_SERVICE_LOCAL*/ FieldTrialServiceData
 	const char *dftsd_grassroots_marti_search_url_s;
 
 
+	/**
+	 * @private
+	 *
+	 * The number of seconds that the MARTi samples found for an area
+	 * are used before they are fetched again in the background.
+	 */
+	uint32 dftsd_marti_cache_ttl;
+
+
+	/**
+	 * @private
+	 *
+	 * The size, in degrees, of the grid cells that Study locations are
+	 * snapped to when caching their MARTi samples.
+	 */
+	double64 dftsd_marti_cell_size;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of areas to cache the MARTi samples for. If this
+	 * is 0, there is no limit.
+	 */
+	uint32 dftsd_marti_cache_max_entries;
+
+
+	/**
+	 * @private
+	 *
+	 * The name of the geocoder to use from the Grassroots configuration.
+	 * If this is NULL, the default geocoder is used.
+	 */
+	const char *dftsd_geocoder_s;
+
+
+	/**
+	 * @private
+	 *
+	 * Are geocoded addresses stored so that they can be reused by
+	 * later requests?
+	 */
+	bool dftsd_geocode_cache_flag;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of requests that are sent to the geocoder
+	 * at the same time when geocoding a batch of addresses.
+	 */
+	uint32 dftsd_geocode_max_connections;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of requests per second that are sent to the
+	 * geocoder. If this is 0, there is no limit.
+	 */
+	double64 dftsd_geocode_requests_per_second;
+
+
+	/**
+	 * @private
+	 *
+	 * The number of background workers used to rebuild a Study's
+	 * search index entry, Frictionless Data package and handbook
+	 * after it has been saved. If this is 0, these are rebuilt
+	 * before the save returns.
+	 */
+	uint32 dftsd_post_save_num_workers;
+
+
+	/**
+	 * @private
+	 *
+	 * The number of seconds to wait before rebuilding a Study
+	 * after it has been saved. Any further saves of the same Study
+	 * during this time are combined into a single rebuild.
+	 */
+	uint32 dftsd_post_save_delay;
+
+
+	/**
+	 * @private
+	 *
+	 * The number of seconds after which a rebuild that is still
+	 * marked as running is assumed to belong to a worker that was
+	 * stopped before it finished, so it is run again.
+	 */
+	uint32 dftsd_post_save_stale_time;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of bytes of heap to use for keeping Studies
+	 * in memory in front of the on-disk study cache. If this is 0,
+	 * which is the default, the in-memory cache is not used.
+	 */
+	size_t dftsd_study_memory_cache_size;
+
+
+	/**
+	 * @private
+	 *
+	 * The number of seconds to keep the cached lists of Programmes,
+	 * Field Trials, Studies, Locations and Crops used for the
+	 * parameter options. If this is 0, the lists are not cached.
+	 */
+	uint32 dftsd_option_list_cache_ttl;
+
+
+	/**
+	 * @private
+	 *
+	 * The number of workers used to rebuild the Lucene index
+	 * entries for the Studies. If this is less than 2, the
+	 * Studies are indexed one at a time.
+	 */
+	uint32 dftsd_reindex_num_workers;
+
+
+	/**
+	 * @private
+	 *
+	 * The file used to record which Studies have been indexed
+	 * by the workers so that an interrupted reindex can be resumed.
+	 * This can be NULL.
+	 */
+	const char *dftsd_reindex_checkpoint_path_s;
+
+
+	/**
+	 * @private
+	 *
+	 * When backing up Studies and Plots, store a full snapshot of
+	 * the previous version after this many deltas. If this is 0,
+	 * every previous version is stored in full.
+	 */
+	uint32 dftsd_revision_snapshot_interval;
+
+
+	/**
+	 * @private
+	 *
+	 * The size in bytes of the blocks used to allocate the Plots,
+	 * Rows and Observations of Studies that are loaded read-only.
+	 * If this is 0, they are allocated individually from the heap.
+	 */
+	size_t dftsd_study_arena_block_size;
+
+
+	/**
+	 * @private
+	 *
+	 * If this is <code>true</code> then a Study's phenotype statistics
+	 * are calculated by an aggregation on the Plots collection rather
+	 * than by loading all of the Study's Plots.
+	 */
+	bool dftsd_aggregate_statistics_flag;
+
+
+	/**
+	 * @private
+	 *
+	 * If this is <code>true</code> then the aggregated phenotype statistics
+	 * are checked against those calculated from the Study's Plots and any
+	 * differences are logged.
+	 */
+	bool dftsd_verify_statistics_flag;
+
+
+	/**
+	 * @private
+	 *
+	 * The number of seconds that downloaded images for the Study handbooks
+	 * can be used before checking whether they have changed.
+	 */
+	uint32 dftsd_asset_cache_max_age;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of copies of pdflatex that can be running at
+	 * once. If this is 0, there is no limit.
+	 */
+	uint32 dftsd_latex_max_jobs;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of seconds to wait for a copy of pdflatex to
+	 * finish before giving up on building a handbook. If this is 0,
+	 * there is no limit.
+	 */
+	uint32 dftsd_latex_wait_timeout;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of seconds that pdflatex can run for before
+	 * it is killed. If this is 0, there is no limit.
+	 */
+	uint32 dftsd_latex_run_timeout;
+
+
+	/**
+	 * @private
+	 *
+	 * The url that the details of Crop Ontology variables are requested
+	 * from when refreshing their scale classes. The variable's id is
+	 * appended to this.
+	 */
+	const char *dftsd_crop_ontology_brapi_url_s;
+
+
+	/**
+	 * @private
+	 *
+	 * The maximum number of requests to Crop Ontology that can be
+	 * running at once when refreshing the scale classes.
+	 */
+	uint32 dftsd_crop_ontology_max_connections;
+
 } FieldTrialServiceData;
 
 
@@ -535,6 +807,47 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL bool RemoveCachedMeasuredVariableByName (FieldTria
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool HasMeasuredVariableCache (FieldTrialServiceData *data_p);
 
 
+/**
+ * Load all of the MeasuredVariables into the cache with a single query.
+ *
+ * @param data_p The FieldTrialServiceData with the cache which must have
+ * already been enabled with EnableMeasuredVariablesCache ().
+ * @return <code>true</code> if the MeasuredVariables were loaded
+ * successfully, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool WarmMeasuredVariablesCache (FieldTrialServiceData *data_p);
+
+
+/**
+ * If this service warms the MeasuredVariables cache and it has been
+ * invalidated since, fill it again. This reloads the whole collection
+ * so it should be called before a unit of work rather than from within
+ * a lookup. Until then, any misses are looked up individually.
+ *
+ * @param data_p The FieldTrialServiceData to use.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void RewarmMeasuredVariablesCacheIfNeeded (FieldTrialServiceData *data_p);
+
+
+/**
+ * Let the shared caches free any entries that were removed before now.
+ * Long-running tasks should call this between units of work once they
+ * no longer use any MeasuredVariables or Treatments that they got from
+ * the caches.
+ *
+ * @param data_p The FieldTrialServiceData to use.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void RefreshSharedCachesPin (FieldTrialServiceData *data_p);
+
+
+/**
+ * Empty the shared MeasuredVariables caches used by every service in
+ * this process. This should be called whenever a MeasuredVariable is
+ * changed in the database.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void InvalidateMeasuredVariablesCaches (void);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool EnableTreatmentsCache (FieldTrialServiceData *data_p);
 
 
@@ -31,6 +31,7 @@
 
 #include "parameter.h"
 #include "string_parameter.h"
+#include "string_hash_table.h"
 
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -83,6 +84,22 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL void *GetDFWObjectByIdString (const char *object_i
 DFW_FIELD_TRIAL_SERVICE_LOCAL void *GetDFWObjectByNamedIdString (const char *object_id_s, FieldTrialDatatype collection_type, const char *id_key_s, void *(*get_obj_from_json_fn) (const json_t *json_p, const ViewFormat format, const FieldTrialServiceData *data_p), const ViewFormat format, const FieldTrialServiceData *data_p);
 
 
+/**
+ * Get the stored documents for a number of objects of the same type
+ * with a single query.
+ *
+ * @param ids_ss The ids of the objects to get. Any that are not valid
+ * ObjectIds will be ignored.
+ * @param num_ids The number of ids.
+ * @param collection_type The type of the objects.
+ * @param data_p The FieldTrialServiceData.
+ * @return A JSON array of the documents that were found, in no particular
+ * order, or <code>NULL</code> upon error. The caller is responsible
+ * for freeing this.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetDFWObjectsJSONByIdStrings (const char **ids_ss, const size_t num_ids, FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool CopyValidDate (const struct tm *src_p, struct tm **dest_pp);
 
 
@@ -172,6 +189,18 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL void *GetVersionedObjectFromResource (DataResource
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool SetUpListParameterFromJSON (const FieldTrialServiceData *data_p, StringParameter *param_p, const char *active_id_s, const char *empty_option_s, const char *name_key_s, json_t *objects_p);
 
 
+/**
+ * Get a HashTable that maps strings onto arbitrary pointers. Neither the keys
+ * nor the values are copied or freed by the HashTable so the caller must make
+ * sure that they stay valid for as long as they are stored in it.
+ *
+ * @param initial_capacity The initial number of buckets.
+ * @param load_percentage The load percentage at which the HashTable will be resized.
+ * @return The new HashTable or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL HashTable *GetHashTableOfStringPointers (const uint32 initial_capacity, const uint8 load_percentage);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,73 @@
+/*
+ * geocode_cache.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_GEOCODE_CACHE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_GEOCODE_CACHE_H_
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+#include "address.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Get the key that an Address's GPS coordinates are cached under.
+ *
+ * This is made from the Address's street, town, county, postcode and
+ * country. Each of them is lower-cased, with punctuation removed and
+ * repeated whitespace collapsed. Any spaces are removed from the postcode
+ * too. This means that Addresses that only differ in their formatting
+ * share the same key. The Address's name is not used.
+ *
+ * @param address_p The Address to get the key for.
+ * @return The key which should be freed with FreeCopiedString () or
+ * <code>NULL</code> if the Address has none of these values or
+ * there was an error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL char *GetGeocodeCacheKey (const Address *address_p);
+
+
+/**
+ * Set the GPS coordinates for an Address, using the cached coordinates
+ * for its key if there are any, otherwise asking the geocoder and
+ * caching the result.
+ *
+ * @param address_p The Address to set the GPS coordinates for.
+ * @param data_p The FieldTrialServiceData with the geocoding configuration.
+ * @return <code>true</code> if the GPS coordinates were set successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool GeocodeAddress (Address *address_p, FieldTrialServiceData *data_p);
+
+
+/**
+ * Set the GPS coordinates for a number of Addresses.
+ *
+ * Any Addresses with cached coordinates use those. Of the rest, those
+ * that share a key are only looked up once. The lookups are spread over
+ * up to the configured number of threads and are started no faster than
+ * the configured rate, since public geocoders limit how often they can
+ * be called.
+ *
+ * @param addresses_pp The Addresses to set the GPS coordinates for.
+ * @param num_addresses The number of Addresses.
+ * @param data_p The FieldTrialServiceData with the geocoding configuration.
+ * @return The number of Addresses whose GPS coordinates were set.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL uint32 GeocodeAddresses (Address **addresses_pp, const uint32 num_addresses, FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_GEOCODE_CACHE_H_ */
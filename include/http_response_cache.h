@@ -0,0 +1,64 @@
+/*
+ * http_response_cache.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_HTTP_RESPONSE_CACHE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_HTTP_RESPONSE_CACHE_H_
+
+#include "dfw_field_trial_service_library.h"
+#include "typedefs.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Set where the bodies of responses from remote APIs, such as Crop Ontology,
+ * are cached on disk and for how long they can be used.
+ *
+ * The cache is shared by everything in the process. Each response is stored
+ * in its own file named after a hash of its url. Since urls can contain
+ * api keys, only the hash is stored and never the url itself.
+ *
+ * @param cache_path_s The directory to store the responses in. If this is
+ * <code>NULL</code> then the cache is disabled.
+ * @param max_age The number of seconds that a cached response can be used for.
+ * @return <code>true</code> if the cache was configured successfully, <code>false</code>
+ * otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool SetHttpResponseCacheConfig (const char *cache_path_s, const uint32 max_age);
+
+
+/**
+ * Get a cached response body.
+ *
+ * @param url_s The url that the response was for.
+ * @return A copy of the response body which should be freed with FreeCopiedString ()
+ * or <code>NULL</code> if the cache is disabled or there is no response for the url
+ * that is younger than the cache's maximum age.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL char *GetCachedHttpResponse (const char *url_s);
+
+
+/**
+ * Store a response body in the cache, replacing any existing one for the same url.
+ *
+ * @param url_s The url that the response was for.
+ * @param response_s The response body.
+ * @return <code>true</code> if the response was stored successfully or the cache
+ * is disabled, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddHttpResponseToCache (const char *url_s, const char *response_s);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_HTTP_RESPONSE_CACHE_H_ */
@@ -39,7 +39,7 @@ extern "C"
 
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL IntegerObservation *AllocateIntegerObservation (bson_oid_t *id_p, const ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p, MEM_FLAG phenotype_mem, const int32 *raw_value_p, const int32 *corrected_value_p,
-																																							const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s);
+																																							const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s, StudyArena *arena_p);
 
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearIntegerObservation (Observation *observation_p);
@@ -107,6 +107,16 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL const char *GetUnsetLocationValue (void);
 DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetAllLocationsAsJSON (const FieldTrialServiceData *data_p, bson_t *opts_p);
 
 
+/**
+ * Geocode and save all of the Locations that do not have any GPS coordinates.
+ *
+ * @param job_p The ServiceJob to update with any errors and the status.
+ * @param data_p The FieldTrialServiceData for the service.
+ * @return The OperationStatus for how many of the Locations were geocoded and saved.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus GeocodeAllLocations (ServiceJob *job_p, FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddLocationToServiceJob (ServiceJob *job_p, Location *location_p, const ViewFormat format, FieldTrialServiceData *data_p);
 
 
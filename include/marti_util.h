@@ -20,9 +20,40 @@ extern "C"
 #endif
 
 
+/**
+ * Add the links to the MARTi samples near a Study's location to its JSON.
+ *
+ * The samples come from a cache shared by every service in the process
+ * which is keyed by the location snapped to a grid cell and a window of
+ * dates. This never waits for the MARTi search service. If there are no
+ * samples for the area yet or they are older than the cache's time to live,
+ * a background refresher is asked to fetch them and the Study's JSON is
+ * marked as pending until they are available.
+ *
+ * @param study_p The Study.
+ * @param study_json_p The JSON for the Study to add the samples to.
+ * @param format The ViewFormat that the Study's JSON is in.
+ * @param data_p The FieldTrialServiceData with the MARTi configuration.
+ * @return <code>OS_SUCCEEDED</code> if samples were added, <code>OS_IDLE</code>
+ * if MARTi is not configured, the Study has no location or the samples are
+ * still being fetched, and <code>OS_FAILED</code> if there was an error.
+ */
 DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddMartiResults (Study *study_p, json_t *study_json_p, const ViewFormat format, const FieldTrialServiceData *data_p);
 
 
+/**
+ * Check whether a Study's JSON is waiting for its MARTi samples.
+ *
+ * JSON like this should not be cached since the samples will be
+ * available soon.
+ *
+ * @param study_json_p The JSON for the Study.
+ * @return <code>true</code> if AddMartiResults () marked the JSON
+ * as pending, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool IsMartiResultPending (const json_t *study_json_p);
+
+
 
 
 #ifdef __cplusplus
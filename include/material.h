@@ -129,6 +129,27 @@ typedef struct Material
 } Material;
 
 
+/**
+ * A set of Materials, keyed by their ids, that can
+ * be shared by all of the rows that use them.
+ */
+typedef struct MaterialsMap
+{
+	/** The MaterialsMapNodes which own the Materials. */
+	LinkedList *mm_materials_p;
+
+	/** A table to find the MaterialsMapNodes by the ids of their Materials. */
+	HashTable *mm_table_p;
+
+	/**
+	 * A table to find the MaterialsMapNodes by the gene bank ids
+	 * and accessions of their Materials.
+	 */
+	HashTable *mm_accessions_table_p;
+
+} MaterialsMap;
+
+
 
 
 
@@ -152,6 +173,12 @@ MATERIAL_PREFIX const char *MA_ID_S MATERIAL_VAL ("id");
 
 MATERIAL_PREFIX const char *MA_ACCESSION_S MATERIAL_VAL ("accession");
 
+/**
+ * The case-folded accession which is used for
+ * case-insensitive searches.
+ */
+MATERIAL_PREFIX const char *MA_ACCESSION_KEY_S MATERIAL_VAL ("accession_key");
+
 MATERIAL_PREFIX const char *MA_BARCODE_S MATERIAL_VAL ("barcode");
 
 MATERIAL_PREFIX const char *MA_PEDIGREE_S MATERIAL_VAL ("pedigree");
@@ -240,9 +267,108 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL Material *GetMaterialById (const bson_oid_t *mater
 DFW_FIELD_TRIAL_SERVICE_LOCAL Material *GetMaterialByAccession (const char *accession_s, GeneBank *gene_bank_p, const bool case_sensitive_flag, const FieldTrialServiceData *data_p);
 
 
+/**
+ * Get the key that is stored with a Material for case-insensitive
+ * searches on its accession.
+ *
+ * @param accession_s The accession.
+ * @return The key which should be freed with FreeCopiedString () or
+ * <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL char *GetMaterialAccessionKey (const char *accession_s);
+
+
+/**
+ * Make a copy of a Material.
+ *
+ * @param material_p The Material to copy.
+ * @return The new Material or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL Material *CopyMaterial (const Material *material_p);
+
+
+/**
+ * Add the accession keys to any stored Materials that were saved
+ * before they were added.
+ *
+ * @param data_p The FieldTrialServiceData.
+ * @return The OperationStatus for how many of the Materials were updated.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddMaterialAccessionKeys (const FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool IsMaterialComplete (const Material * const material_p);
 
 
+/**
+ * Allocate an empty MaterialsMap.
+ *
+ * @return The new MaterialsMap or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL MaterialsMap *AllocateMaterialsMap (void);
+
+
+/**
+ * Free a MaterialsMap along with all of its Materials.
+ *
+ * @param map_p The MaterialsMap to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeMaterialsMap (MaterialsMap *map_p);
+
+
+/**
+ * Get a number of Materials with a single query and add them to a MaterialsMap.
+ *
+ * @param map_p The MaterialsMap to add the Materials to.
+ * @param ids_ss The ids of the Materials to get.
+ * @param num_ids The number of ids.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if all of the Materials that were found were
+ * added successfully, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddMaterialsToMaterialsMap (MaterialsMap *map_p, const char **ids_ss, const size_t num_ids, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Find a Material in a MaterialsMap.
+ *
+ * @param map_p The MaterialsMap to search.
+ * @param id_p The id of the Material.
+ * @return The Material which is still owned by the MaterialsMap or
+ * <code>NULL</code> if it is not in the MaterialsMap.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL Material *GetMaterialFromMaterialsMap (const MaterialsMap *map_p, const bson_oid_t *id_p);
+
+
+/**
+ * Get all of the Materials with any of the given accessions, from any
+ * gene bank, with a single query and add them to a MaterialsMap.
+ *
+ * @param map_p The MaterialsMap to add the Materials to.
+ * @param accessions_ss The accessions to get. These can contain duplicates.
+ * @param num_accessions The number of accessions.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if all of the Materials that were found were
+ * added successfully, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddMaterialsByAccessionsToMaterialsMap (MaterialsMap *map_p, const char **accessions_ss, const size_t num_accessions, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Find the Material with a given accession in a gene bank from a MaterialsMap.
+ * If it is not in the MaterialsMap, it is got or created in the same way as
+ * GetOrCreateMaterialByAccession () and then added to the MaterialsMap.
+ *
+ * @param map_p The MaterialsMap to search.
+ * @param accession_s The accession to match exactly.
+ * @param gene_bank_p The GeneBank for the accession.
+ * @param data_p The FieldTrialServiceData.
+ * @return The Material which is still owned by the MaterialsMap or
+ * <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL Material *GetOrCreateMaterialByAccessionFromMaterialsMap (MaterialsMap *map_p, const char *accession_s, GeneBank *gene_bank_p, const FieldTrialServiceData *data_p);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,102 @@
+/*
+ * material_usage.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_MATERIAL_USAGE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_MATERIAL_USAGE_H_
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+
+#include "operation.h"
+
+
+/*
+ * The material usage collection records where each Material has been
+ * grown. There is a document for each Material in each Plot with the
+ * following keys:
+ *
+ * SR_MATERIAL_ID_S: The Material's id.
+ * RO_STUDY_ID_S: The id of the Plot's Study.
+ * RO_PLOT_ID_S: The Plot's id.
+ * PL_ROWS_S: An array of the Plot's rows that use the Material, each
+ * with the row's id under RO_ID_S and its SR_RACK_INDEX_S and
+ * SR_REPLICATE_S values.
+ *
+ * This means that finding the Studies that used a Material doesn't
+ * need to search through every Plot. Until RebuildMaterialUsage () has
+ * been run, e.g. on an existing database, GetMaterialUsage () builds the
+ * entries from the Plots instead.
+ */
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Update the material usage entries for a Plot to match its rows.
+ *
+ * @param plot_json_p The Plot in VF_STORAGE format, as it has been saved.
+ * @param data_p The FieldTrialServiceData to use.
+ * @return <code>true</code> if the material usage was updated successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool UpdateMaterialUsageForPlot (const json_t *plot_json_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Update the material usage entries for a number of Plots to match their rows.
+ *
+ * @param plots_json_p An array of Plots in VF_STORAGE format, as they have been
+ * saved. Any entries that aren't JSON objects are skipped.
+ * @param data_p The FieldTrialServiceData to use.
+ * @return <code>true</code> if the material usage was updated successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool UpdateMaterialUsageForPlots (const json_t *plots_json_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Remove all of the material usage entries for the Plots in a Study.
+ *
+ * @param study_id_p The id of the Study.
+ * @param data_p The FieldTrialServiceData to use.
+ * @return <code>true</code> if the material usage was removed successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool RemoveMaterialUsageForStudy (const bson_oid_t *study_id_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Get the material usage entries for a Material.
+ *
+ * @param material_id_p The id of the Material.
+ * @param data_p The FieldTrialServiceData to use.
+ * @return A JSON array of the entries for each Plot that the Material
+ * was used in or <code>NULL</code> upon error. This should be freed
+ * with json_decref ().
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetMaterialUsage (const bson_oid_t *material_id_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Rebuild the material usage collection from all of the stored Plots,
+ * add its indexes and mark it as built so that GetMaterialUsage () uses it.
+ *
+ * @param data_p The FieldTrialServiceData to use.
+ * @return The OperationStatus for the rebuild.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus RebuildMaterialUsage (const FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_MATERIAL_USAGE_H_ */
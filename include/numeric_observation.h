@@ -42,7 +42,7 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL NumericObservation *AllocateNumericObservation (bs
 																																							MeasuredVariable *phenotype_p, MEM_FLAG phenotype_mem,
 																																							const double *raw_value_p, const double *corrected_value_p,
 																																							const char *growth_stage_s, const char *method_s, Instrument *instrument_p,
-																																							const ObservationNature nature, const char *notes_s);
+																																							const ObservationNature nature, const char *notes_s, StudyArena *arena_p);
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearNumericObservation (Observation *observation_p);
 
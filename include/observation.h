@@ -27,6 +27,7 @@
 #include "dfw_field_trial_service_library.h"
 #include "measured_variable.h"
 #include "observation_metadata.h"
+#include "study_arena.h"
 
 
 typedef enum ObservationType
@@ -106,6 +107,12 @@ typedef struct Observation
 
 	ObservationType ob_type;
 
+	/**
+	 * The StudyArena that this Observation was allocated
+	 * from or NULL if it was allocated from the heap.
+	 */
+	StudyArena *ob_arena_p;
+
 
 	void (*ob_clear_fn) (struct Observation *observation_p);
 
@@ -201,7 +208,8 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL bool InitObservation (Observation *observation_p,
 	bool (*add_values_to_json_fn) (const struct Observation *obs_p, const char *raw_key_s, const char *corrected_key_s, json_t *json_p, const char *null_sequence_s, bool only_if_exists_flag),
 	bool (*set_value_from_json_fn) (struct Observation *observation_p, ObservationValueType ovt, const json_t *value_p),
 	bool (*set_value_from_string_fn) (struct Observation *observation_p, ObservationValueType ovt, const char *value_s),
-	bool (*get_value_as_string_fn) (const struct Observation *observation_p, ObservationValueType ovt, char **value_ss, bool *free_value_flag_p)
+	bool (*get_value_as_string_fn) (const struct Observation *observation_p, ObservationValueType ovt, char **value_ss, bool *free_value_flag_p),
+	StudyArena *arena_p
 );
 
 
@@ -245,7 +253,16 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeObservationNode (ListItem *node_p);
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetObservationAsJSON (const Observation *observation_p, const ViewFormat format, const FieldTrialServiceData *data_p);
 
-DFW_FIELD_TRIAL_SERVICE_LOCAL Observation *GetObservationFromJSON (const json_t *phenotype_json_p, FieldTrialServiceData *data_p);
+/**
+ * Create an Observation from its JSON representation.
+ *
+ * @param phenotype_json_p The JSON for the Observation.
+ * @param arena_p The StudyArena to allocate the Observation from
+ * or <code>NULL</code> to allocate it from the heap.
+ * @param data_p The FieldTrialServiceData.
+ * @return The Observation or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL Observation *GetObservationFromJSON (const json_t *phenotype_json_p, StudyArena *arena_p, FieldTrialServiceData *data_p);
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool SaveObservation (Observation *observation_p, const FieldTrialServiceData *data_p);
 
@@ -0,0 +1,211 @@
+/*
+ * observation_matrix.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_OBSERVATION_MATRIX_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_OBSERVATION_MATRIX_H_
+
+#include "dfw_field_trial_service_library.h"
+#include "typedefs.h"
+#include "linked_list.h"
+#include "hash_table.h"
+#include "mongodb_util.h"
+
+#include "study.h"
+#include "standard_row.h"
+#include "observation.h"
+
+
+/**
+ * The value stored in a coded column for a Row that
+ * does not have a value.
+ */
+#define OBSERVATION_MATRIX_NO_CODE (UINT32_MAX)
+
+
+/**
+ * Check whether a Row has a value in one of an ObservationColumn's
+ * validity bitmaps.
+ *
+ * @param bitmap_p The validity bitmap.
+ * @param row The index of the Row within the ObservationMatrix.
+ */
+#define IS_OBSERVATION_MATRIX_VALUE_SET(bitmap_p, row) (((bitmap_p) [(row) >> 5] & (((uint32) 1) << ((row) & 31))) != 0)
+
+
+/**
+ * The values of all of the Observations in a Study that are for
+ * the same MeasuredVariable and index, stored as contiguous arrays
+ * with one entry for each Row of the ObservationMatrix.
+ *
+ * If a Row has more than one such Observation, e.g. for different
+ * dates, only the first one is stored.
+ */
+typedef struct ObservationColumn
+{
+	/** The base list node. */
+	ListItem oc_node;
+
+	/**
+	 * The MeasuredVariable. This belongs to the Observation that
+	 * it was first seen on so is only valid whilst the Study's Plots
+	 * are loaded.
+	 */
+	const MeasuredVariable *oc_variable_p;
+
+	/** The observation index that this column is for. */
+	uint32 oc_index;
+
+	/** The type of the Observations in this column. */
+	ObservationType oc_type;
+
+	/**
+	 * The key for the column lookup table made up from the
+	 * MeasuredVariable's id and the observation index.
+	 */
+	char oc_key_s [MONGO_OID_STRING_BUFFER_SIZE + 12];
+
+	/**
+	 * For OT_NUMERIC and OT_INTEGER columns, the raw values.
+	 * This is NULL for other types.
+	 */
+	double64 *oc_raw_values_p;
+
+	/**
+	 * For OT_NUMERIC and OT_INTEGER columns, the corrected values.
+	 * This is NULL for other types.
+	 */
+	double64 *oc_corrected_values_p;
+
+	/**
+	 * For OT_STRING and OT_TIME columns, the codes in the ObservationMatrix's
+	 * dictionary of the raw values. This is NULL for other types.
+	 */
+	uint32 *oc_raw_codes_p;
+
+	/**
+	 * For OT_STRING and OT_TIME columns, the codes in the ObservationMatrix's
+	 * dictionary of the corrected values. This is NULL for other types.
+	 */
+	uint32 *oc_corrected_codes_p;
+
+	/** A bitmap of which Rows have a raw value. */
+	uint32 *oc_raw_validity_p;
+
+	/** A bitmap of which Rows have a corrected value. */
+	uint32 *oc_corrected_validity_p;
+
+	/** The number of Rows that have a raw or corrected value. */
+	size_t oc_num_values;
+
+} ObservationColumn;
+
+
+/**
+ * A columnar copy of the Observations of a Study's Rows so that
+ * analyses over a MeasuredVariable can be done as scans over
+ * arrays rather than walking the Plots, Rows and Observations.
+ *
+ * It is built from a Study whose Plots are loaded and is only valid
+ * whilst they remain loaded and unchanged.
+ */
+typedef struct ObservationMatrix
+{
+	/** The number of Rows and so the length of every array. */
+	size_t om_num_rows;
+
+	/** The StandardRows in the order that they are stored. */
+	const StandardRow **om_rows_pp;
+
+	/** The by-study index of each Row. */
+	uint32 *om_study_indexes_p;
+
+	/** The row index within the Study of each Row's Plot. */
+	uint32 *om_plot_row_indexes_p;
+
+	/** The column index within the Study of each Row's Plot. */
+	uint32 *om_plot_column_indexes_p;
+
+	/**
+	 * The ObservationColumns in the order that their
+	 * MeasuredVariables were first seen.
+	 */
+	LinkedList *om_columns_p;
+
+	/** The ObservationColumns keyed by their oc_key_s. */
+	HashTable *om_columns_table_p;
+
+	/**
+	 * The distinct values of all of the OT_STRING and OT_TIME
+	 * columns, indexed by their codes.
+	 */
+	char **om_dictionary_ss;
+
+	/** The number of values in om_dictionary_ss. */
+	uint32 om_dictionary_size;
+
+	/** The number of values that om_dictionary_ss has space for. */
+	uint32 om_dictionary_capacity;
+
+	/** The codes of the values in om_dictionary_ss keyed by value. */
+	HashTable *om_dictionary_table_p;
+
+} ObservationMatrix;
+
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Build the ObservationMatrix for a Study.
+ *
+ * @param study_p The Study whose Plots have already been loaded.
+ * @return The ObservationMatrix which should be freed with FreeObservationMatrix ()
+ * or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL ObservationMatrix *AllocateObservationMatrix (const Study *study_p);
+
+
+/**
+ * Free an ObservationMatrix.
+ *
+ * @param matrix_p The ObservationMatrix to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeObservationMatrix (ObservationMatrix *matrix_p);
+
+
+/**
+ * Get the ObservationColumn for a given MeasuredVariable and observation index.
+ *
+ * @param matrix_p The ObservationMatrix to search.
+ * @param variable_p The MeasuredVariable.
+ * @param index The observation index.
+ * @return The ObservationColumn or <code>NULL</code> if no Rows have
+ * any matching Observations.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL const ObservationColumn *GetObservationMatrixColumn (const ObservationMatrix *matrix_p, const MeasuredVariable *variable_p, const uint32 index);
+
+
+/**
+ * Get the value in an ObservationMatrix's dictionary for a given code.
+ *
+ * @param matrix_p The ObservationMatrix.
+ * @param code The code from an OT_STRING or OT_TIME ObservationColumn.
+ * @return The value or <code>NULL</code> if the code is OBSERVATION_MATRIX_NO_CODE
+ * or is not valid.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL const char *GetObservationMatrixDictionaryValue (const ObservationMatrix *matrix_p, const uint32 code);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_OBSERVATION_MATRIX_H_ */
@@ -0,0 +1,84 @@
+/*
+ * option_list_cache.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_OPTION_LIST_CACHE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_OPTION_LIST_CACHE_H_
+
+#include "jansson.h"
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+
+
+/**
+ * The cached option lists for a single database. This is held in
+ * the SharedServiceContext for the database.
+ */
+typedef struct OptionListCache OptionListCache;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Allocate an empty OptionListCache.
+ *
+ * @return The new OptionListCache or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OptionListCache *AllocateOptionListCache (void);
+
+
+/**
+ * Free an OptionListCache and all of its cached documents.
+ *
+ * @param cache_p The OptionListCache to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeOptionListCache (OptionListCache *cache_p);
+
+
+/**
+ * Get the documents used to build the list of options for a parameter
+ * that lets the user choose an object of the given datatype.
+ *
+ * For Programmes, Field Trials, Studies and Crops these only contain
+ * the <code>_id</code> and name of each object. For Locations they are the
+ * full documents since their labels are built from their addresses.
+ * The documents are sorted by name.
+ *
+ * The documents are kept in memory, shared by all of the services in
+ * this process that use the same database, until an object of the given
+ * datatype is saved or deleted. Each service only uses documents that are
+ * within its own configured time to live, fetching them again otherwise.
+ *
+ * @param datatype The datatype to get the documents for. This must be one of
+ * DFTD_PROGRAMME, DFTD_FIELD_TRIAL, DFTD_STUDY, DFTD_LOCATION or DFTD_CROP.
+ * @param data_p The FieldTrialServiceData with the cache configuration.
+ * @return A JSON array of the documents which the caller is responsible
+ * for freeing, or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetOptionListDocuments (const FieldTrialDatatype datatype, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Remove the cached option list documents for a datatype. This needs
+ * to be called whenever an object of this datatype is saved or deleted.
+ *
+ * @param datatype The datatype to clear the option list for.
+ * @param data_p The FieldTrialServiceData for the database that the
+ * object was saved to or deleted from.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearOptionListCache (const FieldTrialDatatype datatype, const FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_OPTION_LIST_CACHE_H_ */
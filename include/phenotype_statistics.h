@@ -59,6 +59,40 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddPhenotypeStatisticsNodeAsJSON (const Pheno
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddPhenotypeStatisticsNodeFromJSON (Study *study_p, const json_t *phenotype_p, const FieldTrialServiceData *service_data_p);
 
+
+/**
+ * Calculate the Statistics for every MeasuredVariable that has Observations
+ * within a Study's Plots.
+ *
+ * This builds an ObservationMatrix for the Study and then scans the numeric
+ * columns of each MeasuredVariable, using at most one value from each Row.
+ * The Study's PhenotypeStatisticsNodes are then updated, or added if needed,
+ * for all of the MeasuredVariables together.
+ *
+ * @param study_p The Study whose Plots have already been loaded.
+ * @param service_data_p The configuration data for the Service.
+ * @return The OperationStatus of the calculations.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus CalculatePhenotypeStatisticsForStudy (Study *study_p, const FieldTrialServiceData *service_data_p);
+
+
+/**
+ * Calculate the Statistics for every MeasuredVariable that has Observations
+ * within a Study's Plots using an aggregation on the Plots collection.
+ *
+ * This gets the same values as CalculatePhenotypeStatisticsForStudy () without
+ * needing the Study's Plots to be loaded. If the FieldTrialServiceData has
+ * dftsd_verify_statistics_flag set, the Plots must already be loaded and the
+ * results are checked against CalculatePhenotypeStatisticsForStudy () with
+ * any differences being logged.
+ *
+ * @param study_p The Study to calculate the Statistics for.
+ * @param service_data_p The configuration data for the Service.
+ * @return The OperationStatus of the calculations.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus CalculatePhenotypeStatisticsForStudyByAggregation (Study *study_p, const FieldTrialServiceData *service_data_p);
+
+
 #ifdef __cplusplus
 }
 #endif
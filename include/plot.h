@@ -130,6 +130,14 @@ typedef struct Plot
 	 */
 	LinkedList *pl_rows_p;
 
+	/**
+	 * If this is <code>true</code> then pl_rows_p only has
+	 * some of this Plot's Rows, e.g. when a single Row was
+	 * fetched by its id, so this Plot must not be saved
+	 * as a whole.
+	 */
+	bool pl_partial_rows_flag;
+
 	/**
 	 * A url for any images,
 	 */
@@ -141,6 +149,11 @@ typedef struct Plot
 	 */
 	char *pl_thumbnail_url_s;
 
+	/**
+	 * The StudyArena that this Plot was allocated
+	 * from or NULL if it was allocated from the heap.
+	 */
+	StudyArena *pl_arena_p;
 
 } Plot;
 
@@ -29,6 +29,7 @@
 
 #include "study.h"
 #include "plot.h"
+#include "plots_table_schema.h"
 
 
 
@@ -114,6 +115,21 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL Plot *GetPlotById (bson_oid_t *id_p, Study *study_
 DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetPlotsAsFDTabularPackage (const Study *study_p, const FieldTrialServiceData *data_p);
 
 
+/**
+ * Write the plots to a csv file in the assets directory and get the
+ * Frictionless Data Tabular resource that refers to it.
+ *
+ * Unlike GetPlotsAsFDTabularPackage () the rows are not gathered into
+ * a single JSON array, each one is written to the file as soon as it has
+ * been converted so only a single row is held in memory at a time.
+ *
+ * @param study_p The Study to write the plots for.
+ * @param data_p The Field Trial Service Config
+ * @return The JSON for the plots resource or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *SavePlotsAsFDTabularFile (const Study *study_p, const FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetStudyPlotHeaderAsFrictionlessData (const Study *study_p, const FieldTrialServiceData *service_data_p);
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetPlotsFrictionlessDataTableSchema (const Study *study_p, const FieldTrialServiceData *service_data_p);
@@ -135,6 +151,22 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL bool RunForSearchPlotParams (FieldTrialServiceData
 DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus GenerateAndAddSkeletonPlotsToStudy (Study *study_p, const uint32 num_rows, const uint32 num_cols, ServiceJob *job_p, FieldTrialServiceData *data_p);
 
 
+/**
+ * Add the Plots and Rows from an uploaded plots table to a Study and save them.
+ *
+ * @param job_p The ServiceJob to add any errors to.
+ * @param plots_json_p The JSON array of the table's rows.
+ * @param study_p The Study to add the Plots to.
+ * @param schema_p The PlotsTableSchema to use for the table's column headings. Any
+ * Observations added to the Study borrow its MeasuredVariables so it must not
+ * be freed until after the Study has been.
+ * @param data_p The Field Trial Service Config
+ * @return <code>true</code> if the Plots were added successfully, <code>false</code>
+ * otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *study_p, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -13,6 +13,41 @@
 
 #include "dfw_field_trial_service_data.h"
 #include "dfw_field_trial_service_library.h"
+#include "plot.h"
+#include "string_hash_table.h"
+
+
+/**
+ * The size of the buffer needed to store the
+ * "<row>,<column>" key for a Plot.
+ */
+#define PC_PLOT_KEY_BUFFER_SIZE (24)
+
+
+/**
+ * An entry for a Plot within a PlotsCache.
+ */
+typedef struct CachedPlotNode
+{
+	/** The base list node. */
+	ListItem cpn_node;
+
+	/**
+	 * The Plot. This is owned by the Study that it is in
+	 * rather than by this CachedPlotNode.
+	 */
+	Plot *cpn_plot_p;
+
+	/** The "<row>,<column>" key used to look up this Plot. */
+	char cpn_key_s [PC_PLOT_KEY_BUFFER_SIZE];
+
+	/**
+	 * The 1-based index of the last spreadsheet row that
+	 * modified this Plot or 0 if it is unchanged.
+	 */
+	uint32 cpn_spreadsheet_row;
+
+} CachedPlotNode;
 
 
 typedef struct
@@ -20,6 +55,18 @@ typedef struct
 	json_t *pc_grid_cache_p;
 
 	json_t *pc_index_cache_p;
+
+	/**
+	 * The Study's Plots as CachedPlotNodes
+	 */
+	LinkedList *pc_plots_p;
+
+	/**
+	 * A table to look up the CachedPlotNodes in pc_plots_p
+	 * by their row and column. The racks within each Plot
+	 * are found with GetRowFromPlotsCache ().
+	 */
+	HashTable *pc_plots_table_p;
 } PlotsCache;
 
 
@@ -38,6 +85,86 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL void FreePlotsCache (PlotsCache *plots_cache_p);
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool CheckPlotRequirements (PlotsCache *plots_cache_p, const json_t *table_row_json_p, const size_t row_index, ServiceJob *job_p, int32 *row_p, int32 *column_p, int32 *index_p, int32 *rack_p);
 
 
+/**
+ * Add all of the Plots that are currently loaded for a Study
+ * to a PlotsCache so that they can be looked up without
+ * querying the database.
+ *
+ * @param plots_cache_p The PlotsCache to add the Plots to.
+ * @param study_p The Study whose Plots will be added.
+ * @return <code>true</code> if all of the Plots were added successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddStudyPlotsToPlotsCache (PlotsCache *plots_cache_p, Study *study_p);
+
+
+/**
+ * Add a Plot to a PlotsCache.
+ *
+ * @param plots_cache_p The PlotsCache to add the Plot to.
+ * @param plot_p The Plot to add. The PlotsCache does not take ownership of it.
+ * @return <code>true</code> if the Plot was added successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddPlotToPlotsCache (PlotsCache *plots_cache_p, Plot *plot_p);
+
+
+/**
+ * Get the Plot at the given position from a PlotsCache.
+ *
+ * @param plots_cache_p The PlotsCache to search.
+ * @param row The row of the Plot.
+ * @param column The column of the Plot.
+ * @return The matching Plot or <code>NULL</code> if it is not in the PlotsCache.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL Plot *GetPlotFromPlotsCache (PlotsCache *plots_cache_p, const uint32 row, const uint32 column);
+
+
+/**
+ * Get the Row with the given rack at the given position from a PlotsCache.
+ * Plots are keyed by their row and column alone since a single Plot holds
+ * all of the racks at that position, so this looks up the Plot and then
+ * finds the rack within it.
+ *
+ * @param plots_cache_p The PlotsCache to search.
+ * @param row The row of the Plot.
+ * @param column The column of the Plot.
+ * @param rack The rack index of the Row within the Plot.
+ * @return The matching Row or <code>NULL</code> if there isn't one.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL struct Row *GetRowFromPlotsCache (PlotsCache *plots_cache_p, const uint32 row, const uint32 column, const uint32 rack);
+
+
+/**
+ * Mark a Plot in a PlotsCache as needing to be saved.
+ *
+ * @param plots_cache_p The PlotsCache containing the Plot.
+ * @param plot_p The Plot that has been modified.
+ * @param spreadsheet_row The 1-based index of the spreadsheet row that
+ * modified the Plot. This is used when reporting any errors.
+ * @return <code>true</code> if the Plot was marked successfully,
+ * <code>false</code> if it is not in the PlotsCache.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool SetPlotsCacheEntryModified (PlotsCache *plots_cache_p, const Plot *plot_p, const uint32 spreadsheet_row);
+
+
+/**
+ * Save all of the modified Plots in a PlotsCache to the database
+ * using a single unordered bulk write. An updated Plot is only written
+ * if it hasn't changed since it was read and the existing versions of
+ * the updated Plots that were written are then stored with a second
+ * bulk write.
+ *
+ * @param plots_cache_p The PlotsCache containing the Plots.
+ * @param job_p The ServiceJob to add any errors for each of the
+ * spreadsheet rows to.
+ * @param data_p The FieldTrialServiceData for the database configuration.
+ * @return OS_SUCCEEDED if all of the Plots were saved, OS_PARTIALLY_SUCCEEDED
+ * if some of them were or OS_FAILED if none of them were.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus SaveModifiedPlotsFromPlotsCache (PlotsCache *plots_cache_p, ServiceJob *job_p, const FieldTrialServiceData *data_p);
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,146 @@
+/*
+ * plots_table_schema.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_PLOTS_TABLE_SCHEMA_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_PLOTS_TABLE_SCHEMA_H_
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+
+#include "measured_variable.h"
+#include "observation_metadata.h"
+#include "study.h"
+#include "treatment_factor.h"
+#include "string_hash_table.h"
+
+
+/**
+ * What the values in a column of an uploaded plots table are.
+ */
+typedef enum
+{
+	/** The column heading is a Measured Variable and its values are Observations */
+	PTCT_OBSERVATION,
+
+	/** The column heading is the url of one of the Study's Treatments */
+	PTCT_TREATMENT_FACTOR,
+
+	/** The column heading could not be matched */
+	PTCT_UNKNOWN
+} PlotsTableColumnType;
+
+
+/**
+ * The pre-resolved details for a column of an uploaded plots table.
+ */
+typedef struct PlotsTableColumn
+{
+	/** The base list node. */
+	ListItem ptc_node;
+
+	/** The column heading, which is also the key for the lookup table. */
+	char *ptc_key_s;
+
+	PlotsTableColumnType ptc_type;
+
+	/**
+	 * For PTCT_OBSERVATION columns, the Measured Variable. This is shared by
+	 * all of the Observations created from this column.
+	 */
+	MeasuredVariable *ptc_measured_variable_p;
+
+	/**
+	 * Whether this PlotsTableColumn owns ptc_measured_variable_p or
+	 * whether it is owned by the Measured Variables cache.
+	 */
+	MEM_FLAG ptc_measured_variable_mem;
+
+	/**
+	 * For PTCT_OBSERVATION columns, the dates, corrected flag and sample index
+	 * from the column heading.
+	 */
+	ObservationMetadata *ptc_metadata_p;
+
+	/**
+	 * For PTCT_TREATMENT_FACTOR columns, the TreatmentFactor. This is owned
+	 * by the Study.
+	 */
+	TreatmentFactor *ptc_treatment_factor_p;
+
+} PlotsTableColumn;
+
+
+/**
+ * The columns of an uploaded plots table. Each column heading is
+ * resolved the first time it is seen and then reused for every
+ * subsequent row.
+ */
+typedef struct PlotsTableSchema
+{
+	/** The PlotsTableColumns. */
+	LinkedList *pts_columns_p;
+
+	/** A table to look up the PlotsTableColumns by their headings. */
+	HashTable *pts_table_p;
+
+} PlotsTableSchema;
+
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Allocate an empty PlotsTableSchema.
+ *
+ * @return The new PlotsTableSchema or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL PlotsTableSchema *AllocatePlotsTableSchema (void);
+
+
+/**
+ * Free a PlotsTableSchema.
+ *
+ * Any Observations created using the PlotsTableSchema share its Measured Variables,
+ * so this must not be called until after they have been freed.
+ *
+ * @param schema_p The PlotsTableSchema to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreePlotsTableSchema (PlotsTableSchema *schema_p);
+
+
+/**
+ * Get the details for a column of an uploaded plots table, resolving
+ * them if this is the first time that the column has been seen.
+ *
+ * @param schema_p The PlotsTableSchema for the upload.
+ * @param key_s The column heading.
+ * @param study_p The Study that the plots are being uploaded to.
+ * @param job_p The ServiceJob to report any errors in the column heading to.
+ * @param data_p The FieldTrialServiceData.
+ * @return The PlotsTableColumn or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL const PlotsTableColumn *GetPlotsTableColumn (PlotsTableSchema *schema_p, const char *key_s, Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p);
+
+
+/**
+ * Free a PlotsTableColumn.
+ *
+ * @param node_p The PlotsTableColumn to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreePlotsTableColumn (ListItem *node_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_PLOTS_TABLE_SCHEMA_H_ */
@@ -0,0 +1,172 @@
+/*
+ * revision_store.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_REVISION_STORE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_REVISION_STORE_H_
+
+#include "jansson.h"
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+
+
+#ifndef DOXYGEN_SHOULD_SKIP_THIS
+
+#ifdef ALLOCATE_REVISION_STORE_TAGS
+	#define REVISION_STORE_PREFIX DFW_FIELD_TRIAL_SERVICE_LOCAL
+	#define REVISION_STORE_VAL(x)	= x
+#else
+	#define REVISION_STORE_PREFIX extern
+	#define REVISION_STORE_VAL(x)
+#endif
+
+#endif 		/* #ifndef DOXYGEN_SHOULD_SKIP_THIS */
+
+
+/**
+ * The key for the size in bytes of a version in the entries returned by
+ * GetRevisionsMetadataOfObject ().
+ */
+REVISION_STORE_PREFIX const char *RS_REVISION_SIZE_S REVISION_STORE_VAL ("revision_size");
+
+
+/**
+ * The key for a document's revision number. This goes up by one each
+ * time the document is saved and is what its versions are ordered by.
+ */
+REVISION_STORE_PREFIX const char *RS_REVISION_NUMBER_S REVISION_STORE_VAL ("revision_number");
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Save a document and keep its previous version in the backups collection.
+ *
+ * The previous version is stored as a delta from the new one, with a full
+ * snapshot stored instead every dftsd_revision_snapshot_interval revisions.
+ * If dftsd_revision_snapshot_interval is 0, every version is stored as a
+ * full snapshot. The document is only replaced if it hasn't been changed
+ * since it was read and the previous version is only stored once it has been.
+ *
+ * @param json_p The document to save. Its timestamp and revision number will be updated.
+ * @param collection_type The type of the document.
+ * @param selector_p The selector for any existing version of the document.
+ * This can be <code>NULL</code> for new documents.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if the document was saved successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool SaveAndBackupMongoDataWithRevisions (json_t *json_p, const FieldTrialDatatype collection_type, bson_t *selector_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Get the entry for the backups collection that keeps the previous version
+ * of a document which is being written some other way than by
+ * SaveAndBackupMongoDataWithRevisions (), e.g. with <code>$set</code> or as
+ * part of a bulk operation, and set the revision number of the new version.
+ *
+ * The write should use a selector that has been passed to
+ * AddRevisionConditionsToSelector () and the entry should only be stored,
+ * with AddRevisionEntry () or AddRevisionEntries (), once the write has
+ * succeeded.
+ *
+ * @param previous_p The stored document from before the change.
+ * @param current_p The document as it will be once the change has been written.
+ * Its revision number will be set.
+ * @param data_p The FieldTrialServiceData.
+ * @return The entry which the caller is responsible for freeing, or
+ * <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetRevisionEntry (const json_t *previous_p, json_t *current_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Restrict a selector to only match a document if it is still the given
+ * version, using its timestamp and revision number.
+ *
+ * @param selector_p The selector to add the conditions to.
+ * @param previous_p The version of the document that must still be stored.
+ * @return <code>true</code> if the conditions were added successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddRevisionConditionsToSelector (bson_t *selector_p, const json_t *previous_p);
+
+
+/**
+ * Store an entry from GetRevisionEntry () in the backups collection.
+ *
+ * @param entry_p The entry.
+ * @param collection_type The type of the document.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if the entry was stored successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddRevisionEntry (const json_t *entry_p, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Store a number of entries from GetRevisionEntry () in the backups
+ * collection with a single bulk write.
+ *
+ * @param entries_p The array of entries.
+ * @param collection_type The type of the documents.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if all of the entries were stored successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddRevisionEntries (const json_t *entries_p, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Get all of the versions of a document, newest first, starting with
+ * the current one. Any versions stored as deltas are rebuilt.
+ *
+ * @param id_s The id of the document.
+ * @param collection_type The type of the document.
+ * @param data_p The FieldTrialServiceData.
+ * @return A JSON array of the versions or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetAllRevisionsOfObject (const char *id_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Get the version of a document with a given timestamp, rebuilding it
+ * if it is stored as a delta.
+ *
+ * @param id_s The id of the document.
+ * @param timestamp_s The timestamp of the version.
+ * @param collection_type The type of the document.
+ * @param data_p The FieldTrialServiceData.
+ * @return The version which the caller is responsible for freeing,
+ * or <code>NULL</code> if it could not be found or upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetRevisionOfObject (const char *id_s, const char *timestamp_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Get the timestamps and sizes of all of the versions of a document,
+ * newest first, without rebuilding any of them.
+ *
+ * @param id_s The id of the document.
+ * @param collection_type The type of the document.
+ * @param data_p The FieldTrialServiceData.
+ * @return A JSON array of objects with the MONGO_TIMESTAMP_S, "revision_type"
+ * and, where known, RS_REVISION_SIZE_S in bytes of each version, or <code>NULL</code>
+ * upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetRevisionsMetadataOfObject (const char *id_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_REVISION_STORE_H_ */
@@ -67,6 +67,12 @@ struct Row
 	 */
 	uint32 ro_by_study_index;
 
+	/**
+	 * The StudyArena that this Row was allocated
+	 * from or NULL if it was allocated from the heap.
+	 */
+	StudyArena *ro_arena_p;
+
 	void (*ro_clear_fn) (Row *row_p);
 
 	bool (*ro_add_to_json_fn) (const Row *row_p, json_t *row_json_p, const ViewFormat format, const FieldTrialServiceData *data_p);
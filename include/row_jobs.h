@@ -31,6 +31,7 @@
 #include "plot.h"
 #include "treatment_factor_value.h"
 #include "observation_metadata.h"
+#include "plots_table_schema.h"
 
 
 
@@ -55,6 +56,26 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL LinkedList *GetAllRowsContainingMaterial (Material
 DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddObservationValueToStandardRow (StandardRow *row_p, const uint32 row_index, const char *key_s, const json_t *value_p, ServiceJob *job_p, FieldTrialServiceData *data_p);
 
 
+/**
+ * Add a value from an uploaded plots table to a StandardRow.
+ *
+ * The column heading is only resolved into a Measured Variable or
+ * TreatmentFactor the first time it is seen in the upload.
+ *
+ * @param row_p The StandardRow to add the value to.
+ * @param row_index The index of the row in the uploaded table.
+ * @param key_s The column heading.
+ * @param value_p The value.
+ * @param schema_p The PlotsTableSchema for the upload.
+ * @param study_p The Study that the plots are being uploaded to.
+ * @param job_p The ServiceJob to report any errors to.
+ * @param data_p The FieldTrialServiceData.
+ * @return OS_SUCCEEDED if the value was added or was empty, OS_IDLE if the
+ * column heading is unknown or one of the other OperationStatus values upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddPlotsTableValueToStandardRow (StandardRow *row_p, const uint32 row_index, const char *key_s, const json_t *value_p, PlotsTableSchema *schema_p, Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddTreatmentFactorValuesToStandardRow (StandardRow *row_p, json_t *plot_json_p, Study *study_p, FieldTrialServiceData *data_p);
 
 
@@ -94,7 +115,7 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL char *GetRowsNameKey (void);
 DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeRowsNameKey (char *key_s);
 
 
-DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddObservationValueToStandardRowByParts (ServiceJob *job_p, StandardRow *row_p, MeasuredVariable *measured_variable_p, ObservationMetadata *obs_metadata_p,
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus AddObservationValueToStandardRowByParts (ServiceJob *job_p, StandardRow *row_p, MeasuredVariable *measured_variable_p, MEM_FLAG measured_variable_mem, ObservationMetadata *obs_metadata_p,
 											const char *key_s, const json_t *raw_value_p, const json_t *corrected_value_p, const char *notes_s, bool *free_measured_variable_flag_p,
 											void (*on_error_callback_fn) (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p), void *user_data_p);
 
@@ -0,0 +1,63 @@
+/*
+ * row_update.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_ROW_UPDATE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_ROW_UPDATE_H_
+
+#include "jansson.h"
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+#include "row.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Save the changes made to a single Row without rewriting the rest of its Plot.
+ *
+ * The stored form of the Row is compared against the one taken before it was
+ * edited and only the fields that differ are written. Changed values, including
+ * any edited Observations, are updated using <code>$set</code> and any new
+ * Observations are added using <code>$push</code>. If Observations are both
+ * edited and added, the whole Row is replaced in a single update instead. If the
+ * Plot has been changed since it was read, nothing is written. Once the update
+ * has been made, the previous version of the Row's Plot is stored with
+ * AddRevisionEntry () so that it is part of the Plot's revisions in the same
+ * way as if the whole Plot had been saved.
+ *
+ * @param row_p The edited Row.
+ * @param original_row_json_p The VF_STORAGE JSON for the Row from before it was edited.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if the Row was saved successfully or was unchanged,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool SaveRowChanges (const Row *row_p, const json_t *original_row_json_p, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Replace the entry for a Row within its Study's cached JSON. If the Study
+ * is not cached, this does nothing.
+ *
+ * @param row_p The Row to update the cached Study with.
+ * @param data_p The FieldTrialServiceData.
+ * @return <code>true</code> if the cached Study was updated or there was no
+ * cached Study, <code>false</code> if the Row could not be found in the
+ * cached Study or upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool UpdateCachedStudyRow (const Row *row_p, const FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_ROW_UPDATE_H_ */
@@ -0,0 +1,391 @@
+/*
+ * shared_service_context.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_SHARED_SERVICE_CONTEXT_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_SHARED_SERVICE_CONTEXT_H_
+
+#include <pthread.h>
+
+#include "dfw_field_trial_service_library.h"
+
+#include "grassroots_server.h"
+#include "linked_list.h"
+#include "hash_table.h"
+#include "mongodb_tool.h"
+
+
+/*
+ * forward declarations
+ */
+struct MeasuredVariable;
+struct Treatment;
+
+struct OptionListCache;
+
+
+/**
+ * A record of the epoch of a SharedServiceContext at the time that a
+ * service started using the MeasuredVariables and Treatments from its
+ * caches. Any entries that are removed from the caches after this are
+ * kept until the pin is released or moved on to a later epoch.
+ */
+typedef struct SharedServiceContextPin
+{
+	/** The base list node. */
+	ListItem sscp_node;
+
+	/** The epoch that the pin was taken at. */
+	uint32 sscp_epoch;
+
+} SharedServiceContextPin;
+
+
+/**
+ * The states of the shared MeasuredVariables cache.
+ */
+typedef enum
+{
+	/** The cache only has the MeasuredVariables that have been looked up individually. */
+	MVCS_COLD,
+
+	/** A service is loading all of the MeasuredVariables into the cache. */
+	MVCS_WARMING,
+
+	/** The cache holds all of the MeasuredVariables. */
+	MVCS_WARM
+} MeasuredVariablesCacheState;
+
+
+/**
+ * The state that is shared by all of the field trial services in
+ * this process that use the same database. Each FieldTrialServiceData
+ * holds a reference to one of these and the last one to be freed
+ * frees the context.
+ */
+typedef struct SharedServiceContext
+{
+	/**
+	 * @private
+	 *
+	 * The node used to store this context in the list of
+	 * contexts for the process.
+	 */
+	ListItem ssc_node;
+
+	/**
+	 * @private
+	 *
+	 * The name of the database that this context is for.
+	 */
+	char *ssc_database_s;
+
+	/**
+	 * @private
+	 *
+	 * The GrassrootsServer used to allocate any MongoTools.
+	 */
+	GrassrootsServer *ssc_grassroots_p;
+
+	/**
+	 * @private
+	 *
+	 * The number of FieldTrialServiceData using this context. This
+	 * is protected by the mutex for the list of all contexts rather
+	 * than ssc_mutex.
+	 */
+	uint32 ssc_ref_count;
+
+	/**
+	 * @private
+	 *
+	 * The mutex protecting the pool of MongoTools and the caches.
+	 */
+	pthread_mutex_t ssc_mutex;
+
+	/**
+	 * @private
+	 *
+	 * The MongoTools that have been released by services and
+	 * are available to be reused.
+	 */
+	LinkedList *ssc_idle_mongo_tools_p;
+
+
+	LinkedList *ssc_measured_variables_cache_p;
+
+	/**
+	 * @private
+	 *
+	 * The MeasuredVariableNodes in ssc_measured_variables_cache_p
+	 * keyed by their variable names.
+	 */
+	HashTable *ssc_measured_variables_by_name_p;
+
+	/**
+	 * @private
+	 *
+	 * The MeasuredVariableNodes in ssc_measured_variables_cache_p
+	 * keyed by their ids.
+	 */
+	HashTable *ssc_measured_variables_by_id_p;
+
+	/**
+	 * @private
+	 *
+	 * Whether ssc_measured_variables_cache_p has been filled with all
+	 * of the MeasuredVariables since it was last invalidated.
+	 */
+	MeasuredVariablesCacheState ssc_measured_variables_state;
+
+
+	LinkedList *ssc_treatments_cache_p;
+
+	/**
+	 * @private
+	 *
+	 * The TreatmentNodes in ssc_treatments_cache_p keyed
+	 * by their urls.
+	 */
+	HashTable *ssc_treatments_by_url_p;
+
+	/**
+	 * @private
+	 *
+	 * The current epoch. This is incremented each time that
+	 * entries are removed from the caches.
+	 */
+	uint32 ssc_epoch;
+
+	/**
+	 * @private
+	 *
+	 * The SharedServiceContextPins for the services that may be
+	 * using the entries from the caches.
+	 */
+	LinkedList *ssc_pins_p;
+
+	/**
+	 * @private
+	 *
+	 * The entries that have been removed from the caches, oldest
+	 * first, along with the epoch that they were removed in. Observations
+	 * and Rows in any of the services may still be using them, so each
+	 * batch is only freed once every pin is from a later epoch.
+	 */
+	LinkedList *ssc_retired_p;
+
+	/**
+	 * @private
+	 *
+	 * The cached option lists for this database. This has its
+	 * own lock and may be <code>NULL</code> if it couldn't be
+	 * allocated, in which case the option lists aren't cached.
+	 */
+	struct OptionListCache *ssc_option_lists_p;
+
+} SharedServiceContext;
+
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Get the SharedServiceContext for a database, creating it if this is the
+ * first service in this process to use that database.
+ *
+ * @param database_s The name of the database.
+ * @param grassroots_p The GrassrootsServer.
+ * @return The SharedServiceContext which should be passed to
+ * ReleaseSharedServiceContext () when it is no longer needed, or <code>NULL</code>
+ * upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL SharedServiceContext *AcquireSharedServiceContext (const char *database_s, GrassrootsServer *grassroots_p);
+
+
+/**
+ * Give up a reference to a SharedServiceContext. When the last reference is
+ * released, the context along with its pooled MongoTools and caches is freed.
+ *
+ * @param context_p The SharedServiceContext.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ReleaseSharedServiceContext (SharedServiceContext *context_p);
+
+
+/**
+ * Record that a service is about to start using entries from the context's
+ * caches. Any entries that are removed from the caches from now on will not
+ * be freed until the pin is released.
+ *
+ * @param context_p The SharedServiceContext.
+ * @return The SharedServiceContextPin which should be passed to
+ * ReleaseSharedServiceContextPin () when it is no longer needed, or
+ * <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL SharedServiceContextPin *PinSharedServiceContext (SharedServiceContext *context_p);
+
+
+/**
+ * Move a pin on to the current epoch. This should be called by long-lived
+ * services once they no longer hold any entries from the caches, so that
+ * any entries that have been removed since the pin was taken can be freed.
+ *
+ * @param context_p The SharedServiceContext.
+ * @param pin_p The SharedServiceContextPin.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void RefreshSharedServiceContextPin (SharedServiceContext *context_p, SharedServiceContextPin *pin_p);
+
+
+/**
+ * Release a pin and free any removed cache entries that are no
+ * longer needed.
+ *
+ * @param context_p The SharedServiceContext.
+ * @param pin_p The SharedServiceContextPin. This will be freed.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ReleaseSharedServiceContextPin (SharedServiceContext *context_p, SharedServiceContextPin *pin_p);
+
+
+/**
+ * Get a MongoTool for the context's database. A previously released one
+ * will be reused if possible.
+ *
+ * @param context_p The SharedServiceContext.
+ * @return The MongoTool which should be passed to ReleasePooledMongoTool ()
+ * when it is no longer needed, or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL MongoTool *GetPooledMongoTool (SharedServiceContext *context_p);
+
+
+/**
+ * Return a MongoTool to the context's pool so that it can be reused.
+ *
+ * @param context_p The SharedServiceContext that the MongoTool came from.
+ * @param tool_p The MongoTool.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ReleasePooledMongoTool (SharedServiceContext *context_p, MongoTool *tool_p);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool EnableSharedMeasuredVariablesCache (SharedServiceContext *context_p);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool HasSharedMeasuredVariablesCache (SharedServiceContext *context_p);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL struct MeasuredVariable *GetSharedCachedMeasuredVariableById (SharedServiceContext *context_p, const char *mv_id_s);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL struct MeasuredVariable *GetSharedCachedMeasuredVariableByName (SharedServiceContext *context_p, const char *name_s);
+
+
+/**
+ * Add a MeasuredVariable to the shared cache.
+ *
+ * @param context_p The SharedServiceContext.
+ * @param mv_p The MeasuredVariable.
+ * @param mf How the cache should treat mv_p.
+ * @return <code>true</code> if the MeasuredVariable was added, in which case
+ * the cache is now responsible for it, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddMeasuredVariableToSharedCache (SharedServiceContext *context_p, struct MeasuredVariable *mv_p, MEM_FLAG mf);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool RemoveMeasuredVariableFromSharedCache (SharedServiceContext *context_p, const char *name_s);
+
+
+/**
+ * Empty the shared MeasuredVariables cache. Any MeasuredVariables that
+ * it held remain valid until every service that was pinned before this
+ * call has released or refreshed its pin.
+ *
+ * @param context_p The SharedServiceContext.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearSharedMeasuredVariablesCache (SharedServiceContext *context_p);
+
+
+/**
+ * Claim the job of filling the shared MeasuredVariables cache with all
+ * of the MeasuredVariables.
+ *
+ * @param context_p The SharedServiceContext.
+ * @param epoch_p If the claim succeeds, this is set to the current epoch
+ * which should be passed to EndWarmingSharedMeasuredVariablesCache ().
+ * @return <code>true</code> if the caller should fill the cache, <code>false</code>
+ * if it is already full or another service is filling it.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool BeginWarmingSharedMeasuredVariablesCache (SharedServiceContext *context_p, uint32 *epoch_p);
+
+
+/**
+ * Finish filling the shared MeasuredVariables cache. The cache is only
+ * marked as full if the fill succeeded and the cache was not cleared while
+ * it was being filled. If it was cleared, then anything added by the fill
+ * may be out of date so the cache is cleared again.
+ *
+ * @param context_p The SharedServiceContext.
+ * @param epoch The value from BeginWarmingSharedMeasuredVariablesCache ().
+ * @param success_flag <code>true</code> if all of the MeasuredVariables were
+ * loaded, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void EndWarmingSharedMeasuredVariablesCache (SharedServiceContext *context_p, const uint32 epoch, const bool success_flag);
+
+
+/**
+ * Get the state of the shared MeasuredVariables cache.
+ *
+ * @param context_p The SharedServiceContext.
+ * @return The MeasuredVariablesCacheState.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL MeasuredVariablesCacheState GetSharedMeasuredVariablesCacheState (SharedServiceContext *context_p);
+
+
+/**
+ * Empty the MeasuredVariables caches of every SharedServiceContext in
+ * this process.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearAllSharedMeasuredVariablesCaches (void);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool EnableSharedTreatmentsCache (SharedServiceContext *context_p);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool HasSharedTreatmentsCache (SharedServiceContext *context_p);
+
+
+DFW_FIELD_TRIAL_SERVICE_LOCAL struct Treatment *GetSharedCachedTreatmentByURL (SharedServiceContext *context_p, const char *url_s);
+
+
+/**
+ * Add a Treatment to the shared cache.
+ *
+ * @param context_p The SharedServiceContext.
+ * @param treatment_p The Treatment.
+ * @param mf How the cache should treat treatment_p.
+ * @return <code>true</code> if the Treatment was added, in which case
+ * the cache is now responsible for it, <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddTreatmentToSharedCache (SharedServiceContext *context_p, struct Treatment *treatment_p, MEM_FLAG mf);
+
+
+/**
+ * Empty the shared Treatments cache. Any Treatments that it held remain
+ * valid until every service that was pinned before this call has released
+ * or refreshed its pin.
+ *
+ * @param context_p The SharedServiceContext.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearSharedTreatmentsCache (SharedServiceContext *context_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_SHARED_SERVICE_CONTEXT_H_ */
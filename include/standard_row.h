@@ -133,6 +133,17 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL bool IsStandardRowGenotypeControl (const StandardR
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool SetStandardRowStoreCode (StandardRow *row_p, const char * const store_code_s);
 
 
+/**
+ * Set the Material for a StandardRow, freeing its previous
+ * Material if the StandardRow owns it.
+ *
+ * @param row_p The StandardRow to update.
+ * @param material_p The new Material.
+ * @param material_mem How the StandardRow should treat material_p.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void SetStandardRowMaterial (StandardRow *row_p, Material *material_p, MEM_FLAG material_mem);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL void UpdateStandardRow (StandardRow *row_p, const uint32 rack_index, const bool replicate_control_flag, const uint32 replicate, Material *material_p, MEM_FLAG material_mem, const char * const store_code_s);
 
 
@@ -42,7 +42,7 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL StringObservation *AllocateStringObservation (bson
 																																						MEM_FLAG phenotype_mem, const char * const raw_value_s,
 																																						const char * const corrected_value_s, const char *growth_stage_s,
 																																						const char *method_s, Instrument *instrument_p, const ObservationNature nature,
-																																						const char *notes_s);
+																																						const char *notes_s, StudyArena *arena_p);
 
 
 
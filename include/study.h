@@ -41,6 +41,7 @@
 #include "statistics.h"
 
 #include "metadata.h"
+#include "study_arena.h"
 
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
@@ -208,6 +209,13 @@ typedef struct Study
 	 */
 	LinkedList *st_plots_p;
 
+	/**
+	 * The Materials used by the rows in st_plots_p. The rows
+	 * share these rather than each having their own copy.
+	 * This can be NULL.
+	 */
+	struct MaterialsMap *st_materials_p;
+
 	Crop *st_current_crop_p;
 
 	Crop *st_previous_crop_p;
@@ -292,6 +300,14 @@ typedef struct Study
 	 */
 	LinkedList *st_contributors_p;
 
+	/**
+	 * If this Study was loaded read-only, this is the
+	 * StudyArena that its Plots, Rows and Observations
+	 * were allocated from and it is freed along with
+	 * them in FreeStudy (). This is NULL otherwise.
+	 */
+	StudyArena *st_arena_p;
+
 } Study;
 
 
@@ -349,6 +365,22 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL Study *GetStudyFromJSON (const json_t *json_p, con
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL Study *GetStudyWithParentTrialFromJSON (const json_t *json_p, FieldTrial *parent_trial_p, const ViewFormat format, const FieldTrialServiceData *data_p);
 
+/**
+ * Allocate any Plots that are subsequently loaded for a Study, along with
+ * their Rows and Observations, from a StudyArena so that they can all be
+ * freed in one go by FreeStudy (). This is only for Studies that are loaded
+ * read-only as the values of the objects allocated from the arena cannot be
+ * changed.
+ *
+ * @param study_p The Study.
+ * @param data_p The configuration data for the Service. If dftsd_study_arena_block_size
+ * is 0, this does nothing.
+ * @return <code>true</code> if the Study is using a StudyArena, <code>false</code>
+ * otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool UseStudyArena (Study *study_p, const FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool GetStudyPlots (Study *study_p, const ViewFormat format, FieldTrialServiceData *data_p);
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus SaveStudy (Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p, const char *url_key_s);
@@ -370,6 +402,30 @@ DFW_FIELD_TRIAL_SERVICE_LOCAL int64 GetNumberOfPlotsInStudy (const Study *study_
 DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus IndexStudy (Study *study_p, ServiceJob *job_p, const char *job_name_s, FieldTrialServiceData *data_p);
 
 
+/**
+ * Get the JSON used to add a Study to the Lucene index. This loads
+ * the Study's Plots.
+ *
+ * @param study_p The Study.
+ * @param data_p The FieldTrialServiceData.
+ * @return The JSON which the caller is responsible for freeing or
+ * <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetStudyIndexingJSON (Study *study_p, FieldTrialServiceData *data_p);
+
+
+/**
+ * Build the files and search index entry that are derived from a saved Study.
+ * These are its Frictionless Data package, its Lucene index entry and its handbook.
+ *
+ * @param study_p The Study to process.
+ * @param job_p The ServiceJob to add any error messages to.
+ * @param data_p The FieldTrialServiceData for the configuration.
+ * @return OS_SUCCEEDED if all of the tasks succeeded, OS_PARTIALLY_SUCCEEDED otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus RunStudyPostSaveTasks (Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p);
+
+
 DFW_FIELD_TRIAL_SERVICE_LOCAL bool AddStudyContributor (Study *study_p, Person *person_p, MEM_FLAG mf);
 
 
@@ -0,0 +1,170 @@
+/*
+ * study_arena.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_STUDY_ARENA_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_STUDY_ARENA_H_
+
+#include "dfw_field_trial_service_library.h"
+#include "typedefs.h"
+
+#include "bson/bson.h"
+
+
+/**
+ * A region of memory that the Plots, Rows and Observations of a
+ * Study that has been loaded read-only can be allocated from.
+ *
+ * Memory is handed out from large blocks and is only given back
+ * when the whole arena is freed, so none of the objects allocated
+ * from it are freed individually.
+ */
+typedef struct StudyArena StudyArena;
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Allocate a StudyArena.
+ *
+ * @param block_size The size in bytes of each block that the arena
+ * gets from the heap.
+ * @return The new StudyArena or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL StudyArena *AllocateStudyArena (const size_t block_size);
+
+
+/**
+ * Free a StudyArena along with everything that was allocated from it.
+ *
+ * @param arena_p The StudyArena to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeStudyArena (StudyArena *arena_p);
+
+
+/**
+ * Get the number of bytes that have been allocated from a StudyArena.
+ *
+ * @param arena_p The StudyArena.
+ * @return The number of bytes.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL size_t GetStudyArenaSize (const StudyArena *arena_p);
+
+
+/**
+ * Allocate some memory for an object in a Study.
+ *
+ * @param arena_p The StudyArena to allocate the memory from. If this is
+ * <code>NULL</code>, the memory is allocated from the heap.
+ * @param size The number of bytes to allocate.
+ * @return The memory or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void *AllocStudyMemory (StudyArena *arena_p, const size_t size);
+
+
+/**
+ * Free some memory that was allocated with AllocStudyMemory ().
+ *
+ * @param arena_p The StudyArena that the memory was allocated from. If this
+ * is not <code>NULL</code> then this does nothing as the memory is given back
+ * when the arena is freed.
+ * @param mem_p The memory to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeStudyMemory (StudyArena *arena_p, void *mem_p);
+
+
+/**
+ * Copy a string for an object in a Study.
+ *
+ * @param arena_p The StudyArena to allocate the copy from. If this is
+ * <code>NULL</code>, the copy is allocated from the heap.
+ * @param src_s The string to copy.
+ * @return The copied string or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL char *CopyStudyString (StudyArena *arena_p, const char *src_s);
+
+
+/**
+ * Free a string that was copied with CopyStudyString ().
+ *
+ * @param arena_p The StudyArena that the string was allocated from. If this
+ * is not <code>NULL</code> then this does nothing.
+ * @param value_s The string to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeStudyString (StudyArena *arena_p, char *value_s);
+
+
+/**
+ * Allocate an uninitialised id for an object in a Study.
+ *
+ * @param arena_p The StudyArena to allocate the id from. If this is
+ * <code>NULL</code>, the id is allocated from the heap.
+ * @return The id or <code>NULL</code> upon error.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bson_oid_t *AllocStudyBSONOid (StudyArena *arena_p);
+
+
+/**
+ * Free an id that was allocated with AllocStudyBSONOid ().
+ *
+ * @param arena_p The StudyArena that the id was allocated from. If this
+ * is not <code>NULL</code> then this does nothing.
+ * @param id_p The id to free.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void FreeStudyBSONOid (StudyArena *arena_p, bson_oid_t *id_p);
+
+
+/**
+ * Copy an optional real value for an object in a Study.
+ *
+ * @param arena_p The StudyArena to allocate the copy from. If this is
+ * <code>NULL</code>, the copy is allocated from the heap.
+ * @param src_p The value to copy. This can be <code>NULL</code>.
+ * @param dest_pp Where the copied value will be stored. If src_p is
+ * <code>NULL</code>, this will be set to <code>NULL</code>.
+ * @return <code>true</code> if the value was copied successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool CopyValidStudyReal (StudyArena *arena_p, const double64 *src_p, double64 **dest_pp);
+
+
+/**
+ * Copy an optional unsigned integer value for an object in a Study.
+ *
+ * @param arena_p The StudyArena to allocate the copy from. If this is
+ * <code>NULL</code>, the copy is allocated from the heap.
+ * @param src_p The value to copy. This can be <code>NULL</code>.
+ * @param dest_pp Where the copied value will be stored. If src_p is
+ * <code>NULL</code>, this will be set to <code>NULL</code>.
+ * @return <code>true</code> if the value was copied successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool CopyValidStudyUnsignedInteger (StudyArena *arena_p, const uint32 *src_p, uint32 **dest_pp);
+
+
+/**
+ * Copy an optional integer value for an object in a Study.
+ *
+ * @param arena_p The StudyArena to allocate the copy from. If this is
+ * <code>NULL</code>, the copy is allocated from the heap.
+ * @param src_p The value to copy. This can be <code>NULL</code>.
+ * @param dest_pp Where the copied value will be stored. If src_p is
+ * <code>NULL</code>, this will be set to <code>NULL</code>.
+ * @return <code>true</code> if the value was copied successfully,
+ * <code>false</code> otherwise.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool CopyValidStudyInteger (StudyArena *arena_p, const int32 *src_p, int32 **dest_pp);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_STUDY_ARENA_H_ */
@@ -0,0 +1,98 @@
+/*
+ * study_memory_cache.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_STUDY_MEMORY_CACHE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_STUDY_MEMORY_CACHE_H_
+
+#include "jansson.h"
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/*
+ * The in-memory cache sits in front of the on-disk study cache and is
+ * local to each process. Since the on-disk cache is shared between
+ * processes, each entry records the details of the file that it came
+ * from and is only used while that file is unchanged.
+ *
+ * The cache is only used if the "study_memory_cache_size" configuration
+ * value is set.
+ *
+ * The cached JSON is shared with the callers rather than copied for each
+ * of them, so it must not be modified.
+ */
+
+
+/**
+ * Get a Study's JSON from the in-memory cache.
+ *
+ * @param id_s The id of the Study.
+ * @param filename_s The Study's file in the on-disk cache. If this has
+ * changed since the Study was cached, the cached entry is removed.
+ * @param data_p The FieldTrialServiceData with the cache configuration.
+ * @return A new reference to the cached JSON, which must not be modified,
+ * or <code>NULL</code> if the Study is not in the cache. The caller is
+ * responsible for calling json_decref () on it.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetStudyFromMemoryCache (const char *id_s, const char *filename_s, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Load a Study's JSON from its file in the on-disk cache and add it to
+ * the in-memory cache, replacing any existing entry. If this takes the
+ * cache over its size limit, the least recently used entries are removed.
+ * The size of each entry is an estimate of the heap used by its JSON.
+ *
+ * If the file changes while it is being loaded, the JSON is still returned
+ * but it is not added to the in-memory cache.
+ *
+ * @param id_s The id of the Study.
+ * @param filename_s The Study's file in the on-disk cache.
+ * @param data_p The FieldTrialServiceData with the cache configuration.
+ * @return The Study's JSON, which must not be modified as it may be shared
+ * with the in-memory cache, or <code>NULL</code> if the file could not
+ * be loaded. The caller is responsible for calling json_decref () on it.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *LoadStudyIntoMemoryCache (const char *id_s, const char *filename_s, const FieldTrialServiceData *data_p);
+
+
+/**
+ * Remove a Study from the in-memory cache, if it is there.
+ *
+ * @param id_s The id of the Study.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void RemoveStudyFromMemoryCache (const char *id_s);
+
+
+/**
+ * Remove all of the Studies from the in-memory cache.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearStudyMemoryCache (void);
+
+
+/**
+ * Get the usage details for the in-memory cache.
+ *
+ * @return The JSON with the number of hits, misses, evictions, stale entries and entries
+ * along with the current and maximum sizes in bytes. The caller is responsible
+ * for freeing this.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetStudyMemoryCacheStatisticsAsJSON (void);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_STUDY_MEMORY_CACHE_H_ */
@@ -0,0 +1,90 @@
+/*
+ * study_post_save_queue.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_STUDY_POST_SAVE_QUEUE_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_STUDY_POST_SAVE_QUEUE_H_
+
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+#include "study.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Start the background workers that rebuild saved Studies, if the
+ * post-save queue is enabled. Any rebuilds that were still pending
+ * when the queue was last stopped, including those from other
+ * processes, will then be run.
+ *
+ * The workers are shared by all of the services in this process, so
+ * only the first call starts them and they keep running until
+ * StopStudyPostSaveQueue () is called when this library is unloaded.
+ *
+ * @param data_p The FieldTrialServiceData with the post-save queue configuration.
+ * @return <code>true</code> if the workers are running, <code>false</code> if
+ * the queue is not enabled or could not be started.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool StartStudyPostSaveQueue (FieldTrialServiceData *data_p);
+
+
+/**
+ * Stop the background workers that rebuild saved Studies. Any rebuilds
+ * that are in progress are allowed to finish and any that are still
+ * pending are kept for when the queue is next started.
+ *
+ * This is called automatically when this library is unloaded.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL void StopStudyPostSaveQueue (void);
+
+
+/**
+ * Schedule the rebuilding of the Frictionless Data package, Lucene index entry
+ * and handbook for a Study that has just been saved.
+ *
+ * The schedule is stored in the database so that it survives the process
+ * being restarted and it is shared between all of the processes that use
+ * the same database. The rebuilds are run by a pool of background workers
+ * which is started the first time that this is called if StartStudyPostSaveQueue ()
+ * has not already been called. Any further calls for the same Study before
+ * its rebuild has started are combined into that single rebuild.
+ *
+ * Note that reindexing the Studies only rebuilds their Lucene index entries,
+ * so it does not replace a rebuild that has failed.
+ *
+ * @param study_p The Study that has been saved.
+ * @param data_p The FieldTrialServiceData with the post-save queue configuration.
+ * @return <code>true</code> if the rebuild was scheduled, <code>false</code> if
+ * the queue is not enabled or could not be started. In this case the caller should
+ * call RunStudyPostSaveTasks () itself.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL bool QueueStudyPostSaveTasks (const Study *study_p, FieldTrialServiceData *data_p);
+
+
+/**
+ * Get the status of the queued rebuilds for a Study. This has an entry for
+ * any rebuild that is pending or running along with the result of the most
+ * recent rebuild that has finished, including any errors from it.
+ *
+ * @param study_id_p The id of the Study.
+ * @param data_p The FieldTrialServiceData to use.
+ * @return A JSON array of the entries or <code>NULL</code> upon error.
+ * This should be freed with json_decref ().
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL json_t *GetStudyPostSaveStatus (const bson_oid_t *study_id_p, const FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_STUDY_POST_SAVE_QUEUE_H_ */
@@ -0,0 +1,49 @@
+/*
+ * study_reindexer.h
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#ifndef SERVICES_FIELD_TRIALS_INCLUDE_STUDY_REINDEXER_H_
+#define SERVICES_FIELD_TRIALS_INCLUDE_STUDY_REINDEXER_H_
+
+
+#include "dfw_field_trial_service_data.h"
+#include "dfw_field_trial_service_library.h"
+
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+
+/**
+ * Rebuild the Lucene index entries for all of the Studies using a pool of
+ * workers.
+ *
+ * Each worker has its own Service, and so its own database connection and
+ * caches, along with its own LuceneTool. The workers take Study ids from a shared
+ * queue, load each Study with its Plots and add them to the index in batches.
+ *
+ * If a checkpoint file is configured, the id of each Study is appended to it once
+ * it has been indexed. Any Studies listed there are skipped so an interrupted
+ * reindex carries on from where it stopped. The file is removed once every Study
+ * has been indexed.
+ *
+ * The numbers of Studies and Plots indexed along with the throughput are added
+ * to the ServiceJob as a result.
+ *
+ * @param job_p The ServiceJob to report to.
+ * @param data_p The FieldTrialServiceData with the reindexing configuration.
+ * @return The OperationStatus of the reindex.
+ */
+DFW_FIELD_TRIAL_SERVICE_LOCAL OperationStatus ReindexStudiesInParallel (ServiceJob *job_p, const FieldTrialServiceData *data_p);
+
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SERVICES_FIELD_TRIALS_INCLUDE_STUDY_REINDEXER_H_ */
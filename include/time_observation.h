@@ -43,7 +43,7 @@ extern "C"
 DFW_FIELD_TRIAL_SERVICE_LOCAL TimeObservation *AllocateTimeObservation (bson_oid_t *id_p, ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p,
 																																				MEM_FLAG phenotype_mem, const struct tm *raw_value_p,
 																																				const struct tm *corrected_value_p, const char *growth_stage_s, const char *method_s,
-																																				Instrument *instrument_p, const ObservationNature nature, const char *notes_s);
+																																				Instrument *instrument_p, const ObservationNature nature, const char *notes_s, StudyArena *arena_p);
 
 DFW_FIELD_TRIAL_SERVICE_LOCAL void ClearTimeObservation (Observation *observation_p);
 
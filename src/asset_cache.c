@@ -0,0 +1,483 @@
+/*
+ * asset_cache.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <inttypes.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include <curl/curl.h>
+
+#include "asset_cache.h"
+
+#include "memory_allocations.h"
+#include "string_utils.h"
+#include "filesystem_utils.h"
+#include "streams.h"
+
+
+/**
+ * The maximum length of the ETag and Last-Modified values that are stored.
+ */
+#define S_HEADER_VALUE_BUFFER_SIZE (256)
+
+
+/**
+ * The validators for a cached asset as read from its
+ * metadata file or sent by the server.
+ */
+typedef struct AssetValidators
+{
+	/** The hash of the url that the asset was downloaded from. */
+	char av_url_hash_s [ASSET_HASH_BUFFER_SIZE];
+
+	/** The ETag header value or an empty string. */
+	char av_etag_s [S_HEADER_VALUE_BUFFER_SIZE];
+
+	/** The Last-Modified header value or an empty string. */
+	char av_last_modified_s [S_HEADER_VALUE_BUFFER_SIZE];
+
+} AssetValidators;
+
+
+static const char * const S_METADATA_SUFFIX_S = ".cache";
+
+static const uint64_t S_FNV_OFFSET_BASIS = 14695981039346656037ULL;
+
+static const uint64_t S_FNV_PRIME = 1099511628211ULL;
+
+
+static bool DownloadAsset (const char *url_s, const char *full_filename_s, const char *metadata_filename_s, const AssetValidators *cached_p, const char *url_hash_s);
+
+static bool ReadAssetValidators (const char *metadata_filename_s, AssetValidators *validators_p);
+
+static bool WriteAssetValidators (const char *metadata_filename_s, const AssetValidators *validators_p);
+
+static size_t ParseAssetHeader (char *buffer_p, size_t size, size_t num_items, void *data_p);
+
+static bool CopyHeaderValue (char *dest_s, const size_t dest_size, const char *src_p, size_t length);
+
+static uint64_t AddToContentHash (uint64_t hash, const unsigned char *data_p, const size_t length);
+
+static void PrintContentHash (const uint64_t hash, char hash_s [ASSET_HASH_BUFFER_SIZE]);
+
+
+bool UpdateCachedAsset (const char *url_s, const char *full_filename_s, const uint32 max_age)
+{
+	bool success_flag = false;
+	char *metadata_filename_s = ConcatenateStrings (full_filename_s, S_METADATA_SUFFIX_S);
+
+	if (metadata_filename_s)
+		{
+			AssetValidators cached;
+			bool have_cached_flag = false;
+			char url_hash_s [ASSET_HASH_BUFFER_SIZE];
+
+			/*
+			 * The urls can contain api keys so only a hash of them is stored
+			 */
+			GetStringContentHash (url_s, url_hash_s);
+
+			if (DoesFileExist (full_filename_s) && ReadAssetValidators (metadata_filename_s, &cached))
+				{
+					have_cached_flag = (strcmp (cached.av_url_hash_s, url_hash_s) == 0);
+				}
+
+			if (have_cached_flag)
+				{
+					struct stat metadata_stat;
+
+					/*
+					 * The metadata file is rewritten each time the asset is checked
+					 * so its modification time is when it was last known to be current
+					 */
+					if ((stat (metadata_filename_s, &metadata_stat) == 0) && (time (NULL) - metadata_stat.st_mtime < (time_t) max_age))
+						{
+							success_flag = true;
+						}
+				}
+
+			if (!success_flag)
+				{
+					success_flag = DownloadAsset (url_s, full_filename_s, metadata_filename_s, have_cached_flag ? &cached : NULL, url_hash_s);
+
+					if ((!success_flag) && have_cached_flag)
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to check \"%s\", using existing copy in \"%s\"", url_s, full_filename_s);
+							success_flag = true;
+						}
+				}
+
+			FreeCopiedString (metadata_filename_s);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get metadata filename for \"%s\"", full_filename_s);
+		}
+
+	return success_flag;
+}
+
+
+bool GetFileContentHash (const char *filename_s, char hash_s [ASSET_HASH_BUFFER_SIZE])
+{
+	bool success_flag = false;
+	FILE *in_f = fopen (filename_s, "rb");
+
+	if (in_f)
+		{
+			unsigned char buffer [8192];
+			uint64_t hash = S_FNV_OFFSET_BASIS;
+			size_t l;
+
+			while ((l = fread (buffer, 1, sizeof (buffer), in_f)) > 0)
+				{
+					hash = AddToContentHash (hash, buffer, l);
+				}
+
+			if (!ferror (in_f))
+				{
+					PrintContentHash (hash, hash_s);
+					success_flag = true;
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to read \"%s\"", filename_s);
+				}
+
+			fclose (in_f);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to open \"%s\"", filename_s);
+		}
+
+	return success_flag;
+}
+
+
+void GetStringContentHash (const char *value_s, char hash_s [ASSET_HASH_BUFFER_SIZE])
+{
+	const uint64_t hash = AddToContentHash (S_FNV_OFFSET_BASIS, (const unsigned char *) value_s, strlen (value_s));
+
+	PrintContentHash (hash, hash_s);
+}
+
+
+
+static bool DownloadAsset (const char *url_s, const char *full_filename_s, const char *metadata_filename_s, const AssetValidators *cached_p, const char *url_hash_s)
+{
+	bool success_flag = false;
+	char *temp_filename_s = ConcatenateStrings (full_filename_s, ".XXXXXX");
+
+	if (temp_filename_s)
+		{
+			/* Download to a temporary file so that a failed or unchanged download leaves the existing copy alone */
+			int fd = mkstemp (temp_filename_s);
+
+			if (fd != -1)
+				{
+					FILE *temp_f = NULL;
+
+					/* mkstemp () only gives the owner access but the file replaces one that others could read */
+					fchmod (fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+					temp_f = fdopen (fd, "wb");
+
+					if (temp_f)
+						{
+							CURL *curl_p = curl_easy_init ();
+
+							if (curl_p)
+								{
+									AssetValidators received;
+									struct curl_slist *headers_p = NULL;
+									bool headers_flag = true;
+									CURLcode res;
+
+									memset (&received, 0, sizeof (AssetValidators));
+
+									if (cached_p)
+										{
+											char *header_s = NULL;
+
+											if (*(cached_p -> av_etag_s) != '\0')
+												{
+													header_s = ConcatenateStrings ("If-None-Match: ", cached_p -> av_etag_s);
+												}
+											else if (*(cached_p -> av_last_modified_s) != '\0')
+												{
+													header_s = ConcatenateStrings ("If-Modified-Since: ", cached_p -> av_last_modified_s);
+												}
+
+											if (header_s)
+												{
+													headers_p = curl_slist_append (NULL, header_s);
+													headers_flag = (headers_p != NULL);
+
+													FreeCopiedString (header_s);
+												}
+										}
+
+									if (headers_flag)
+										{
+											curl_easy_setopt (curl_p, CURLOPT_URL, url_s);
+											curl_easy_setopt (curl_p, CURLOPT_FOLLOWLOCATION, 1L);
+											curl_easy_setopt (curl_p, CURLOPT_FAILONERROR, 1L);
+											curl_easy_setopt (curl_p, CURLOPT_CONNECTTIMEOUT, 60L);
+											curl_easy_setopt (curl_p, CURLOPT_TIMEOUT, 60L);
+											curl_easy_setopt (curl_p, CURLOPT_WRITEDATA, temp_f);
+											curl_easy_setopt (curl_p, CURLOPT_HEADERFUNCTION, ParseAssetHeader);
+											curl_easy_setopt (curl_p, CURLOPT_HEADERDATA, &received);
+											curl_easy_setopt (curl_p, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
+
+											if (headers_p)
+												{
+													curl_easy_setopt (curl_p, CURLOPT_HTTPHEADER, headers_p);
+												}
+
+											res = curl_easy_perform (curl_p);
+
+											if (res == CURLE_OK)
+												{
+													long response_code = 0;
+
+													curl_easy_getinfo (curl_p, CURLINFO_RESPONSE_CODE, &response_code);
+
+													if (response_code == 304)
+														{
+															PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "\"%s\" is unchanged", full_filename_s);
+
+															/* Rewrite the metadata so that we don't check again until max_age has passed */
+															success_flag = WriteAssetValidators (metadata_filename_s, cached_p);
+														}
+													else
+														{
+															if (fclose (temp_f) == 0)
+																{
+																	if (rename (temp_filename_s, full_filename_s) == 0)
+																		{
+																			strcpy (received.av_url_hash_s, url_hash_s);
+																			success_flag = WriteAssetValidators (metadata_filename_s, &received);
+																		}
+																	else
+																		{
+																			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to rename \"%s\" to \"%s\"", temp_filename_s, full_filename_s);
+																		}
+																}
+															else
+																{
+																	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to write \"%s\"", temp_filename_s);
+																}
+
+															temp_f = NULL;
+														}
+												}
+											else
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to download \"%s\": \"%s\"", url_s, curl_easy_strerror (res));
+												}
+
+											if (headers_p)
+												{
+													curl_slist_free_all (headers_p);
+												}
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set request headers for \"%s\"", url_s);
+										}
+
+									curl_easy_cleanup (curl_p);
+								}		/* if (curl_p) */
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to initialise curl for \"%s\"", url_s);
+								}
+
+							if (temp_f)
+								{
+									fclose (temp_f);
+								}
+						}		/* if (temp_f) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to open \"%s\"", temp_filename_s);
+							close (fd);
+						}
+
+					/* This does nothing if the download was renamed into place */
+					remove (temp_filename_s);
+				}		/* if (fd != -1) */
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create temporary file for \"%s\"", full_filename_s);
+				}
+
+			FreeCopiedString (temp_filename_s);
+		}		/* if (temp_filename_s) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get temporary filename for \"%s\"", full_filename_s);
+		}
+
+	return success_flag;
+}
+
+
+static bool ReadAssetValidators (const char *metadata_filename_s, AssetValidators *validators_p)
+{
+	bool success_flag = false;
+	FILE *in_f = fopen (metadata_filename_s, "r");
+
+	if (in_f)
+		{
+			char *lines_ss [3] = { validators_p -> av_url_hash_s, validators_p -> av_etag_s, validators_p -> av_last_modified_s };
+			const size_t sizes [3] = { ASSET_HASH_BUFFER_SIZE, S_HEADER_VALUE_BUFFER_SIZE, S_HEADER_VALUE_BUFFER_SIZE };
+			char buffer_s [S_HEADER_VALUE_BUFFER_SIZE + 2];
+			uint32 i;
+
+			success_flag = true;
+
+			for (i = 0; i < 3; ++ i)
+				{
+					if (fgets (buffer_s, sizeof (buffer_s), in_f))
+						{
+							if (!CopyHeaderValue (lines_ss [i], sizes [i], buffer_s, strlen (buffer_s)))
+								{
+									success_flag = false;
+								}
+						}
+					else
+						{
+							* (lines_ss [i]) = '\0';
+
+							/* The url hash is required, the header values are optional */
+							if (i == 0)
+								{
+									success_flag = false;
+								}
+						}
+				}
+
+			fclose (in_f);
+		}
+
+	return success_flag;
+}
+
+
+static bool WriteAssetValidators (const char *metadata_filename_s, const AssetValidators *validators_p)
+{
+	bool success_flag = false;
+	FILE *out_f = fopen (metadata_filename_s, "w");
+
+	if (out_f)
+		{
+			if (fprintf (out_f, "%s\n%s\n%s\n", validators_p -> av_url_hash_s, validators_p -> av_etag_s, validators_p -> av_last_modified_s) > 0)
+				{
+					success_flag = true;
+				}
+
+			if (fclose (out_f) != 0)
+				{
+					success_flag = false;
+				}
+		}
+
+	if (!success_flag)
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to write asset metadata to \"%s\"", metadata_filename_s);
+		}
+
+	return success_flag;
+}
+
+
+static size_t ParseAssetHeader (char *buffer_p, size_t size, size_t num_items, void *data_p)
+{
+	AssetValidators *validators_p = (AssetValidators *) data_p;
+	const size_t length = size * num_items;
+	const char * const ETAG_S = "ETag:";
+	const size_t ETAG_LENGTH = strlen (ETAG_S);
+	const char * const LAST_MODIFIED_S = "Last-Modified:";
+	const size_t LAST_MODIFIED_LENGTH = strlen (LAST_MODIFIED_S);
+
+	/*
+	 * Header names are case-insensitive and the values are not \0-terminated.
+	 * If there are redirects, the values from the final response win.
+	 */
+	if ((length > ETAG_LENGTH) && (strncasecmp (buffer_p, ETAG_S, ETAG_LENGTH) == 0))
+		{
+			CopyHeaderValue (validators_p -> av_etag_s, S_HEADER_VALUE_BUFFER_SIZE, buffer_p + ETAG_LENGTH, length - ETAG_LENGTH);
+		}
+	else if ((length > LAST_MODIFIED_LENGTH) && (strncasecmp (buffer_p, LAST_MODIFIED_S, LAST_MODIFIED_LENGTH) == 0))
+		{
+			CopyHeaderValue (validators_p -> av_last_modified_s, S_HEADER_VALUE_BUFFER_SIZE, buffer_p + LAST_MODIFIED_LENGTH, length - LAST_MODIFIED_LENGTH);
+		}
+
+	return length;
+}
+
+
+/*
+ * Copy a value without any surrounding whitespace, leaving
+ * dest_s empty if it is too long to store.
+ */
+static bool CopyHeaderValue (char *dest_s, const size_t dest_size, const char *src_p, size_t length)
+{
+	while ((length > 0) && ((*src_p == ' ') || (*src_p == '\t')))
+		{
+			++ src_p;
+			-- length;
+		}
+
+	while ((length > 0) && ((src_p [length - 1] == '\r') || (src_p [length - 1] == '\n') || (src_p [length - 1] == ' ') || (src_p [length - 1] == '\t')))
+		{
+			-- length;
+		}
+
+	if (length < dest_size)
+		{
+			memcpy (dest_s, src_p, length);
+			dest_s [length] = '\0';
+
+			return true;
+		}
+
+	*dest_s = '\0';
+
+	return false;
+}
+
+
+/*
+ * 64-bit FNV-1a
+ */
+static uint64_t AddToContentHash (uint64_t hash, const unsigned char *data_p, const size_t length)
+{
+	size_t i;
+
+	for (i = 0; i < length; ++ i, ++ data_p)
+		{
+			hash ^= (uint64_t) (*data_p);
+			hash *= S_FNV_PRIME;
+		}
+
+	return hash;
+}
+
+
+static void PrintContentHash (const uint64_t hash, char hash_s [ASSET_HASH_BUFFER_SIZE])
+{
+	snprintf (hash_s, ASSET_HASH_BUFFER_SIZE, "%016" PRIx64, hash);
+}
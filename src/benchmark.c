@@ -0,0 +1,1463 @@
+/*
+ * benchmark.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ *
+ * A program to generate synthetic Studies of given sizes and time the
+ * main read and write paths over them. It needs a Grassroots installation
+ * whose field trial configuration points at a scratch database since
+ * everything that it generates is left in place there. The Frictionless
+ * Data packages and handbooks are written to their own directory and the
+ * Lucene index entries are removed when the benchmarks finish, since
+ * those are not kept in the database.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include <sys/resource.h>
+
+#include "jansson.h"
+#include "mongoc/mongoc.h"
+#include "bson/bson.h"
+
+#include "typedefs.h"
+#include "memory_allocations.h"
+#include "string_utils.h"
+#include "filesystem_utils.h"
+#include "streams.h"
+#include "json_util.h"
+#include "mongodb_util.h"
+#include "grassroots_server.h"
+#include "service.h"
+#include "service_job.h"
+#include "address.h"
+#include "schema_term.h"
+
+#include "dfw_field_trial_service_data.h"
+#include "indexing.h"
+#include "programme.h"
+#include "field_trial.h"
+#include "location.h"
+#include "study.h"
+#include "study_jobs.h"
+#include "measured_variable.h"
+#include "metadata.h"
+#include "person.h"
+#include "gene_bank.h"
+#include "plot_jobs.h"
+#include "plots_table_schema.h"
+
+
+/*
+ * The names of the counters in the "opcounters" section of the
+ * serverStatus command's output.
+ */
+static const char * const S_OP_COUNTER_NAMES_SS [] =
+{
+	"insert",
+	"query",
+	"update",
+	"delete",
+	"getmore",
+	"command",
+	NULL
+};
+
+#define S_NUM_OP_COUNTERS (6)
+
+#define S_MAX_NUM_SCALES (16)
+
+static const uint32 S_DEFAULT_NUM_PLOTS [] = { 1000, 10000, 50000 };
+
+static const uint32 S_DEFAULT_NUM_VARIABLES [] = { 50, 200 };
+
+static const uint32 S_NUM_COLUMNS = 50;
+
+static const uint32 S_NUM_REPLICATES = 3;
+
+static const uint32 S_PLOTS_PER_ACCESSION = 4;
+
+static const char * const S_DATABASE_PREFIX_S = "benchmark";
+
+static const char * const S_JOB_NAME_S = "Benchmark";
+
+static const char * const S_ASSETS_TEMPLATE_S = "/tmp/grassroots_benchmark_XXXXXX";
+
+
+/**
+ * The things that are shared by every stage of a benchmark run.
+ */
+typedef struct BenchmarkContext
+{
+	/** The configured service that the benchmarks run against. */
+	FieldTrialServiceData *bc_data_p;
+
+	/** The job to pass to anything that reports its results or errors. */
+	ServiceJob *bc_job_p;
+
+	/**
+	 * A separate connection to the server that is used to get the number of
+	 * operations that each stage makes.
+	 */
+	mongoc_client_t *bc_stats_client_p;
+
+	/** The parent Field Trial for all of the generated Studies. */
+	FieldTrial *bc_trial_p;
+
+	/** The id of the Location for all of the generated Studies. */
+	char *bc_location_id_s;
+
+	/** The names of the Measured Variables used in the generated Studies. */
+	char **bc_variable_names_ss;
+
+	/** The number of entries in bc_variable_names_ss. */
+	uint32 bc_num_variables;
+
+	/** The seed for generating the observation values. */
+	uint32 bc_seed;
+
+	/** The time when the benchmarks started, used to keep the Study names unique. */
+	char bc_start_time_s [32];
+
+	/**
+	 * The ids of everything that has been added to the Lucene index
+	 * so that they can be removed at the end.
+	 */
+	json_t *bc_indexed_ids_p;
+
+} BenchmarkContext;
+
+
+/**
+ * The values recorded at the start of a stage.
+ */
+typedef struct StageMeasurement
+{
+	/** The time that the stage started. */
+	struct timespec sm_start;
+
+	/** The server's operation counters when the stage started. */
+	int64 sm_op_counters [S_NUM_OP_COUNTERS];
+
+	/** Whether the operation counters were read successfully. */
+	bool sm_op_counters_flag;
+
+} StageMeasurement;
+
+
+
+/*
+ * STATIC DECLARATIONS
+ */
+
+static bool ParseScale (const char *value_s, uint32 *scales_p, uint32 *num_scales_p);
+
+static bool IsScratchDatabase (const FieldTrialServiceData *data_p);
+
+static const char *GetBenchmarkAssetsPath (const char *assets_path_s, char *temp_path_s);
+
+static bool SetUpBenchmarkData (BenchmarkContext *context_p, const uint32 num_variables);
+
+static void TearDownBenchmarkData (BenchmarkContext *context_p);
+
+static void AddIndexedId (BenchmarkContext *context_p, const bson_oid_t *id_p);
+
+static void RemoveIndexedIds (BenchmarkContext *context_p);
+
+static bool EnsureGruGeneBank (FieldTrialServiceData *data_p);
+
+static char *EnsureBenchmarkVariable (const uint32 index, BenchmarkContext *context_p);
+
+static json_t *RunBenchmark (BenchmarkContext *context_p, const uint32 num_plots, const uint32 num_variables);
+
+static char *SaveBenchmarkStudy (BenchmarkContext *context_p, const uint32 num_plots, const uint32 num_variables);
+
+static json_t *GeneratePlotsTable (BenchmarkContext *context_p, const uint32 num_plots, const uint32 num_variables);
+
+static bool SetTableCell (json_t *row_json_p, const char *key_s, const char *value_s);
+
+static bool SetTableIntegerCell (json_t *row_json_p, const char *key_s, const uint32 value);
+
+static uint32 GetNextRandomValue (uint32 *state_p);
+
+static bool TimeUpload (BenchmarkContext *context_p, const char *study_id_s, json_t *plots_json_p, json_t *stages_p);
+
+static bool TimeStudyStage (BenchmarkContext *context_p, const char *study_id_s, const char *stage_s, const ViewFormat format, json_t *stages_p);
+
+static void StartStage (BenchmarkContext *context_p, StageMeasurement *measurement_p);
+
+static bool EndStage (BenchmarkContext *context_p, StageMeasurement *measurement_p, const char *stage_s, const bool success_flag, json_t *stages_p);
+
+static void ResetPeakMemoryUsage (void);
+
+static int64 GetPeakMemoryUsage (void);
+
+static bool GetServerOpCounters (mongoc_client_t *client_p, int64 op_counters_p [S_NUM_OP_COUNTERS]);
+
+static const char *GetViewFormatName (const ViewFormat format);
+
+static void PrintUsage (void);
+
+
+/*
+ * DEFINITIONS
+ */
+
+int main (int argc, char **argv)
+{
+	int res = 1;
+	const char *grassroots_path_s = NULL;
+	const char *config_filename_s = NULL;
+	const char *output_filename_s = NULL;
+	const char *mongo_uri_s = "mongodb://localhost:27017";
+	const char *assets_path_s = NULL;
+	char temp_assets_path_s [64];
+	uint32 num_plots [S_MAX_NUM_SCALES];
+	uint32 num_plots_scales = 0;
+	uint32 num_variables [S_MAX_NUM_SCALES];
+	uint32 num_variables_scales = 0;
+	uint32 seed = 1;
+	bool force_flag = false;
+	bool args_flag = true;
+	int i = 1;
+
+	while ((i < argc) && args_flag)
+		{
+			const char *arg_s = argv [i];
+			const char *value_s = ((i + 1) < argc) ? argv [i + 1] : NULL;
+
+			if (strcmp (arg_s, "--force") == 0)
+				{
+					force_flag = true;
+				}
+			else if (!value_s)
+				{
+					printf ("argument missing for \"%s\"\n", arg_s);
+					args_flag = false;
+				}
+			else
+				{
+					if (strcmp (arg_s, "--grassroots") == 0)
+						{
+							grassroots_path_s = value_s;
+						}
+					else if (strcmp (arg_s, "--config") == 0)
+						{
+							config_filename_s = value_s;
+						}
+					else if (strcmp (arg_s, "--out") == 0)
+						{
+							output_filename_s = value_s;
+						}
+					else if (strcmp (arg_s, "--mongo") == 0)
+						{
+							mongo_uri_s = value_s;
+						}
+					else if (strcmp (arg_s, "--assets") == 0)
+						{
+							assets_path_s = value_s;
+						}
+					else if (strcmp (arg_s, "--plots") == 0)
+						{
+							args_flag = ParseScale (value_s, num_plots, &num_plots_scales);
+						}
+					else if (strcmp (arg_s, "--variables") == 0)
+						{
+							args_flag = ParseScale (value_s, num_variables, &num_variables_scales);
+						}
+					else if (strcmp (arg_s, "--seed") == 0)
+						{
+							seed = (uint32) strtoul (value_s, NULL, 10);
+						}
+					else
+						{
+							printf ("unknown argument \"%s\"\n", arg_s);
+							args_flag = false;
+						}
+
+					++ i;
+				}
+
+			++ i;
+		}		/* while ((i < argc) && args_flag) */
+
+	if (args_flag && grassroots_path_s)
+		{
+			uint32 j;
+			uint32 max_num_variables = 0;
+
+			if (num_plots_scales == 0)
+				{
+					num_plots_scales = sizeof (S_DEFAULT_NUM_PLOTS) / sizeof (S_DEFAULT_NUM_PLOTS [0]);
+					memcpy (num_plots, S_DEFAULT_NUM_PLOTS, sizeof (S_DEFAULT_NUM_PLOTS));
+				}
+
+			if (num_variables_scales == 0)
+				{
+					num_variables_scales = sizeof (S_DEFAULT_NUM_VARIABLES) / sizeof (S_DEFAULT_NUM_VARIABLES [0]);
+					memcpy (num_variables, S_DEFAULT_NUM_VARIABLES, sizeof (S_DEFAULT_NUM_VARIABLES));
+				}
+
+			for (j = 0; j < num_variables_scales; ++ j)
+				{
+					if (num_variables [j] > max_num_variables)
+						{
+							max_num_variables = num_variables [j];
+						}
+				}
+
+			if (InitMongoDB ())
+				{
+					GrassrootsServer *grassroots_p = AllocateGrassrootsServer (grassroots_path_s, config_filename_s, NULL, NULL, NULL, NULL, NULL, MF_ALREADY_FREED, NULL, MF_ALREADY_FREED);
+
+					if (grassroots_p)
+						{
+							Service *service_p = GetFieldTrialIndexingService (grassroots_p);
+
+							if (service_p)
+								{
+									BenchmarkContext context;
+
+									memset (&context, 0, sizeof (BenchmarkContext));
+									context.bc_data_p = (FieldTrialServiceData *) (service_p -> se_data_p);
+									context.bc_seed = seed;
+
+									if (! (force_flag || IsScratchDatabase (context.bc_data_p)))
+										{
+											printf ("The database \"%s\" does not start with \"%s\", use --force to run against it anyway\n",
+															context.bc_data_p -> dftsd_database_s ? context.bc_data_p -> dftsd_database_s : "", S_DATABASE_PREFIX_S);
+										}
+									else if ((assets_path_s = GetBenchmarkAssetsPath (assets_path_s, temp_assets_path_s)) == NULL)
+										{
+											puts ("Failed to create a directory for the Frictionless Data packages and handbooks");
+										}
+									else
+										{
+											/*
+											 * Keep the files that the Studies generate away from the configured
+											 * ones and do the post-save tasks straight away so that they can't
+											 * index anything after we have removed it from the index.
+											 */
+											context.bc_data_p -> dftsd_assets_path_s = assets_path_s;
+											context.bc_data_p -> dftsd_fd_url_s = NULL;
+											context.bc_data_p -> dftsd_post_save_num_workers = 0;
+
+											service_p -> se_jobs_p = AllocateSimpleServiceJobSet (service_p, NULL, S_JOB_NAME_S);
+
+											if (service_p -> se_jobs_p)
+												{
+													context.bc_job_p = GetServiceJobFromServiceJobSet (service_p -> se_jobs_p, 0);
+													context.bc_stats_client_p = mongoc_client_new (mongo_uri_s);
+
+													if (context.bc_stats_client_p)
+														{
+															if (SetUpBenchmarkData (&context, max_num_variables))
+																{
+																	json_t *results_p = json_object ();
+
+																	if (results_p)
+																		{
+																			json_t *runs_p = json_array ();
+
+																			if (runs_p)
+																				{
+																					if (json_object_set_new (results_p, "runs", runs_p) == 0)
+																						{
+																							res = 0;
+
+																							if ((SetJSONString (results_p, "started", context.bc_start_time_s)) &&
+																									(SetJSONInteger (results_p, "seed", seed)) &&
+																									(SetJSONString (results_p, "database", context.bc_data_p -> dftsd_database_s)) &&
+																									(SetJSONString (results_p, "assets", assets_path_s)))
+																								{
+																									uint32 k;
+
+																									for (j = 0; j < num_plots_scales; ++ j)
+																										{
+																											for (k = 0; k < num_variables_scales; ++ k)
+																												{
+																													json_t *run_p = RunBenchmark (&context, num_plots [j], num_variables [k]);
+
+																													if (run_p)
+																														{
+																															if (json_array_append_new (runs_p, run_p) != 0)
+																																{
+																																	json_decref (run_p);
+																																	res = 1;
+																																}
+																														}
+																													else
+																														{
+																															res = 1;
+																														}
+																												}
+																										}
+																								}
+																							else
+																								{
+																									res = 1;
+																								}
+																						}
+																					else
+																						{
+																							json_decref (runs_p);
+																						}
+
+																				}		/* if (runs_p) */
+
+																			if (output_filename_s)
+																				{
+																					if (json_dump_file (results_p, output_filename_s, JSON_INDENT (2)) != 0)
+																						{
+																							printf ("Failed to write results to \"%s\"\n", output_filename_s);
+																							res = 1;
+																						}
+																				}
+																			else
+																				{
+																					json_dumpf (results_p, stdout, JSON_INDENT (2));
+																					putchar ('\n');
+																				}
+
+																			json_decref (results_p);
+																		}		/* if (results_p) */
+
+																}		/* if (SetUpBenchmarkData (&context, max_num_variables)) */
+															else
+																{
+																	puts ("Failed to set up the benchmark data");
+																}
+
+															TearDownBenchmarkData (&context);
+															mongoc_client_destroy (context.bc_stats_client_p);
+														}		/* if (context.bc_stats_client_p) */
+													else
+														{
+															printf ("Failed to connect to \"%s\"\n", mongo_uri_s);
+														}
+
+													FreeServiceJobSet (service_p -> se_jobs_p);
+													service_p -> se_jobs_p = NULL;
+												}		/* if (service_p -> se_jobs_p) */
+											else
+												{
+													puts ("Failed to allocate the benchmark job");
+												}
+										}
+
+									FreeService (service_p);
+								}		/* if (service_p) */
+							else
+								{
+									puts ("Failed to configure the field trial service");
+								}
+
+							FreeGrassrootsServer (grassroots_p);
+						}		/* if (grassroots_p) */
+					else
+						{
+							printf ("Failed to load the Grassroots configuration from \"%s\"\n", grassroots_path_s);
+						}
+
+					ExitMongoDB ();
+				}		/* if (InitMongoDB ()) */
+			else
+				{
+					puts ("Failed to initialise the mongo driver");
+				}
+		}
+	else
+		{
+			PrintUsage ();
+		}
+
+	return res;
+}
+
+
+static void PrintUsage (void)
+{
+	puts ("USAGE: benchmark --grassroots <grassroots path> [--config <config filename>] [--out <results filename>] [--mongo <uri>]\n"
+				"\t[--plots <number of plots>]... [--variables <number of variables>]... [--seed <seed>] [--assets <directory>] [--force]\n\n"
+				"Every combination of the given numbers of plots and variables is benchmarked, the defaults are\n"
+				"1000, 10000 and 50000 plots with 50 and 200 variables. The configured database must start with\n"
+				"\"benchmark\" unless --force is given. The Frictionless Data packages and handbooks are written\n"
+				"to the --assets directory, or a new temporary one, rather than the configured one and everything\n"
+				"that is added to the Lucene index is removed at the end. The operation counts come from the\n"
+				"server's serverStatus so they are only accurate if nothing else is using the server.");
+}
+
+
+static bool ParseScale (const char *value_s, uint32 *scales_p, uint32 *num_scales_p)
+{
+	bool success_flag = false;
+	char *end_s = NULL;
+	const unsigned long value = strtoul (value_s, &end_s, 10);
+
+	if ((*end_s == '\0') && (value > 0) && (value <= UINT32_MAX))
+		{
+			if (*num_scales_p < S_MAX_NUM_SCALES)
+				{
+					* (scales_p + *num_scales_p) = (uint32) value;
+					++ (*num_scales_p);
+					success_flag = true;
+				}
+			else
+				{
+					printf ("Only %d values can be given for each scale\n", S_MAX_NUM_SCALES);
+				}
+		}
+	else
+		{
+			printf ("Invalid scale \"%s\"\n", value_s);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Everything that the benchmarks generate is left in the database
+ * so refuse to run against one that looks like it might be real.
+ */
+static bool IsScratchDatabase (const FieldTrialServiceData *data_p)
+{
+	const char *database_s = data_p -> dftsd_database_s;
+
+	return ((database_s != NULL) && (strncmp (database_s, S_DATABASE_PREFIX_S, strlen (S_DATABASE_PREFIX_S)) == 0));
+}
+
+
+/*
+ * Use the given directory for the generated files or, if there isn't
+ * one, make a new temporary one in temp_path_s.
+ */
+static const char *GetBenchmarkAssetsPath (const char *assets_path_s, char *temp_path_s)
+{
+	if (assets_path_s)
+		{
+			return EnsureDirectoryExists (assets_path_s) ? assets_path_s : NULL;
+		}
+
+	strcpy (temp_path_s, S_ASSETS_TEMPLATE_S);
+
+	return mkdtemp (temp_path_s);
+}
+
+
+/*
+ * Create the Programme, Field Trial and Location that all of the
+ * generated Studies share along with the Measured Variables.
+ */
+static bool SetUpBenchmarkData (BenchmarkContext *context_p, const uint32 num_variables)
+{
+	FieldTrialServiceData *data_p = context_p -> bc_data_p;
+	const time_t now = time (NULL);
+	struct tm tm_now;
+
+	gmtime_r (&now, &tm_now);
+	strftime (context_p -> bc_start_time_s, sizeof (context_p -> bc_start_time_s), "%Y-%m-%dT%H:%M:%SZ", &tm_now);
+
+	context_p -> bc_indexed_ids_p = json_array ();
+
+	if (!context_p -> bc_indexed_ids_p)
+		{
+			return false;
+		}
+
+	if (!EnsureGruGeneBank (data_p))
+		{
+			return false;
+		}
+
+	context_p -> bc_variable_names_ss = (char **) AllocMemory (num_variables * sizeof (char *));
+
+	if (context_p -> bc_variable_names_ss)
+		{
+			uint32 i;
+
+			memset (context_p -> bc_variable_names_ss, 0, num_variables * sizeof (char *));
+			context_p -> bc_num_variables = num_variables;
+
+			for (i = 0; i < num_variables; ++ i)
+				{
+					char *name_s = EnsureBenchmarkVariable (i, context_p);
+
+					if (name_s)
+						{
+							* ((context_p -> bc_variable_names_ss) + i) = name_s;
+						}
+					else
+						{
+							return false;
+						}
+				}
+		}
+	else
+		{
+			return false;
+		}
+
+	{
+		Person *pi_p = AllocatePerson ("Benchmark PI", "benchmark@example.org", NULL, NULL, NULL);
+
+		if (pi_p)
+			{
+				Metadata *metadata_p = AllocateMetadata (NULL, NULL, false, context_p -> bc_start_time_s);
+
+				if (metadata_p)
+					{
+						Programme *programme_p = AllocateProgramme (NULL, metadata_p, "BENCH", NULL, NULL, "Benchmark programme", "Synthetic data for benchmarking", pi_p, NULL, NULL, NULL);
+
+						if (programme_p)
+							{
+								if (SaveProgramme (programme_p, context_p -> bc_job_p, data_p) == OS_SUCCEEDED)
+									{
+										AddIndexedId (context_p, programme_p -> pr_id_p);
+
+										context_p -> bc_trial_p = AllocateFieldTrial ("Benchmark trial", "Benchmark", programme_p, MF_DEEP_COPY, NULL, context_p -> bc_start_time_s);
+
+										if (context_p -> bc_trial_p)
+											{
+												if (!SaveFieldTrial (context_p -> bc_trial_p, context_p -> bc_job_p, data_p))
+													{
+														PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to save benchmark trial");
+														return false;
+													}
+
+												AddIndexedId (context_p, context_p -> bc_trial_p -> ft_id_p);
+											}
+										else
+											{
+												FreeProgramme (programme_p);
+												return false;
+											}
+									}
+								else
+									{
+										PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to save benchmark programme");
+										FreeProgramme (programme_p);
+										return false;
+									}
+							}
+						else
+							{
+								FreeMetadata (metadata_p);
+								FreePerson (pi_p);
+								return false;
+							}
+					}
+				else
+					{
+						FreePerson (pi_p);
+						return false;
+					}
+			}
+		else
+			{
+				return false;
+			}
+	}
+
+	{
+		Address *address_p = AllocateAddress ("Benchmark site", NULL, "Norwich", NULL, "United Kingdom", NULL, "GB", NULL);
+
+		if (address_p)
+			{
+				Location *location_p = AllocateLocation (address_p, 0, NULL, NULL, NULL, LT_SITE, NULL);
+
+				if (location_p)
+					{
+						if (SaveLocation (location_p, context_p -> bc_job_p, data_p) == OS_SUCCEEDED)
+							{
+								AddIndexedId (context_p, location_p -> lo_id_p);
+								context_p -> bc_location_id_s = GetBSONOidAsString (location_p -> lo_id_p);
+							}
+
+						FreeLocation (location_p);
+					}
+				else
+					{
+						FreeAddress (address_p);
+					}
+			}
+	}
+
+	if (!context_p -> bc_location_id_s)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to save benchmark location");
+			return false;
+		}
+
+	return true;
+}
+
+
+static void TearDownBenchmarkData (BenchmarkContext *context_p)
+{
+	if (context_p -> bc_indexed_ids_p)
+		{
+			RemoveIndexedIds (context_p);
+
+			json_decref (context_p -> bc_indexed_ids_p);
+			context_p -> bc_indexed_ids_p = NULL;
+		}
+
+	if (context_p -> bc_variable_names_ss)
+		{
+			uint32 i;
+
+			for (i = 0; i < context_p -> bc_num_variables; ++ i)
+				{
+					char *name_s = * ((context_p -> bc_variable_names_ss) + i);
+
+					if (name_s)
+						{
+							FreeCopiedString (name_s);
+						}
+				}
+
+			FreeMemory (context_p -> bc_variable_names_ss);
+			context_p -> bc_variable_names_ss = NULL;
+		}
+
+	if (context_p -> bc_location_id_s)
+		{
+			FreeCopiedString (context_p -> bc_location_id_s);
+			context_p -> bc_location_id_s = NULL;
+		}
+
+	if (context_p -> bc_trial_p)
+		{
+			FreeFieldTrial (context_p -> bc_trial_p);
+			context_p -> bc_trial_p = NULL;
+		}
+}
+
+
+static void AddIndexedId (BenchmarkContext *context_p, const bson_oid_t *id_p)
+{
+	char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+	bson_oid_to_string (id_p, id_s);
+
+	if (json_array_append_new (context_p -> bc_indexed_ids_p, json_string (id_s)) != 0)
+		{
+			printf ("Failed to record \"%s\", it will be left in the Lucene index\n", id_s);
+		}
+}
+
+
+/*
+ * The Lucene index is shared with the configured service rather than
+ * being in the scratch database so remove everything that we added.
+ */
+static void RemoveIndexedIds (BenchmarkContext *context_p)
+{
+	const size_t num_ids = json_array_size (context_p -> bc_indexed_ids_p);
+	size_t i;
+
+	for (i = 0; i < num_ids; ++ i)
+		{
+			const char *id_s = json_string_value (json_array_get (context_p -> bc_indexed_ids_p, i));
+
+			if (id_s)
+				{
+					if (DeleteStudyFromLuceneIndexById (id_s, context_p -> bc_job_p -> sj_id, context_p -> bc_data_p) != OS_SUCCEEDED)
+						{
+							printf ("Failed to remove \"%s\" from the Lucene index\n", id_s);
+						}
+				}
+		}
+}
+
+
+/*
+ * Plot uploads fail if the GRU gene bank that the accessions
+ * belong to is missing, which it will be in a new database.
+ */
+static bool EnsureGruGeneBank (FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	GeneBank *gene_bank_p = GetGeneBankByName (GENE_BANK_GRU_S, data_p);
+
+	if (!gene_bank_p)
+		{
+			gene_bank_p = AllocateGeneBank (NULL, GENE_BANK_GRU_S, "https://www.seedstor.ac.uk", "https://www.seedstor.ac.uk/search-infoaccession.php?idPlant=");
+
+			if (gene_bank_p)
+				{
+					if (!SaveGeneBank (gene_bank_p, data_p))
+						{
+							FreeGeneBank (gene_bank_p);
+							gene_bank_p = NULL;
+						}
+				}
+		}
+
+	if (gene_bank_p)
+		{
+			FreeGeneBank (gene_bank_p);
+			success_flag = true;
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get or create the \"%s\" gene bank", GENE_BANK_GRU_S);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * The Measured Variables have fixed names so they are reused by later
+ * runs against the same database.
+ */
+static char *EnsureBenchmarkVariable (const uint32 index, BenchmarkContext *context_p)
+{
+	char name_s [64];
+	char trait_url_s [128];
+	char method_url_s [128];
+	char unit_url_s [128];
+	char variable_url_s [128];
+	MeasuredVariable *mv_p = NULL;
+	bool success_flag = false;
+
+	snprintf (name_s, sizeof (name_s), "Benchmark variable " UINT32_FMT, index);
+	snprintf (trait_url_s, sizeof (trait_url_s), "https://example.org/benchmark/trait/" UINT32_FMT, index);
+	snprintf (method_url_s, sizeof (method_url_s), "https://example.org/benchmark/method/" UINT32_FMT, index);
+	snprintf (unit_url_s, sizeof (unit_url_s), "https://example.org/benchmark/unit/" UINT32_FMT, index);
+	snprintf (variable_url_s, sizeof (variable_url_s), "https://example.org/benchmark/variable/" UINT32_FMT, index);
+
+	mv_p = GetMeasuredVariableByName (name_s, context_p -> bc_data_p);
+
+	if (mv_p)
+		{
+			success_flag = true;
+		}
+	else
+		{
+			SchemaTerm *trait_p = AllocateExtendedSchemaTerm (trait_url_s, name_s, "Benchmark trait", "BT");
+			SchemaTerm *method_p = AllocateExtendedSchemaTerm (method_url_s, name_s, "Benchmark method", "BM");
+			SchemaTerm *unit_p = AllocateExtendedSchemaTerm (unit_url_s, "unit", "Benchmark unit", "BU");
+			SchemaTerm *variable_p = AllocateExtendedSchemaTerm (variable_url_s, name_s, "Benchmark variable", "BV");
+
+			if (trait_p && method_p && unit_p && variable_p)
+				{
+					mv_p = AllocateMeasuredVariable (NULL, trait_p, method_p, unit_p, variable_p, &SCALE_NUMERICAL, NULL, MF_ALREADY_FREED);
+
+					if (mv_p)
+						{
+							success_flag = (SaveMeasuredVariable (mv_p, context_p -> bc_job_p, S_JOB_NAME_S, context_p -> bc_data_p) == OS_SUCCEEDED);
+
+							if (success_flag)
+								{
+									AddIndexedId (context_p, mv_p -> mv_id_p);
+								}
+						}
+				}
+
+			if (!mv_p)
+				{
+					if (trait_p)
+						{
+							FreeSchemaTerm (trait_p);
+						}
+
+					if (method_p)
+						{
+							FreeSchemaTerm (method_p);
+						}
+
+					if (unit_p)
+						{
+							FreeSchemaTerm (unit_p);
+						}
+
+					if (variable_p)
+						{
+							FreeSchemaTerm (variable_p);
+						}
+				}
+		}
+
+	if (mv_p)
+		{
+			FreeMeasuredVariable (mv_p);
+		}
+
+	if (success_flag)
+		{
+			return EasyCopyToNewString (name_s);
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get or create measured variable \"%s\"", name_s);
+
+	return NULL;
+}
+
+
+static json_t *RunBenchmark (BenchmarkContext *context_p, const uint32 num_plots, const uint32 num_variables)
+{
+	json_t *run_p = json_object ();
+
+	if (run_p)
+		{
+			json_t *stages_p = json_array ();
+
+			if (stages_p)
+				{
+					if (json_object_set_new (run_p, "stages", stages_p) == 0)
+						{
+							if ((SetJSONInteger (run_p, "plots", num_plots)) && (SetJSONInteger (run_p, "variables", num_variables)))
+								{
+									char *study_id_s = SaveBenchmarkStudy (context_p, num_plots, num_variables);
+
+									if (study_id_s)
+										{
+											if (SetJSONString (run_p, "study_id", study_id_s))
+												{
+													json_t *plots_json_p = GeneratePlotsTable (context_p, num_plots, num_variables);
+
+													if (plots_json_p)
+														{
+															bool success_flag = TimeUpload (context_p, study_id_s, plots_json_p, stages_p);
+
+															json_decref (plots_json_p);
+
+															if (success_flag)
+																{
+																	TimeStudyStage (context_p, study_id_s, "GetStudyPlots", VF_CLIENT_FULL, stages_p);
+
+																	TimeStudyStage (context_p, study_id_s, "GetStudyAsJSON", VF_STORAGE, stages_p);
+																	TimeStudyStage (context_p, study_id_s, "GetStudyAsJSON", VF_INDEXING, stages_p);
+																	TimeStudyStage (context_p, study_id_s, "GetStudyAsJSON", VF_REFERENCE, stages_p);
+																	TimeStudyStage (context_p, study_id_s, "GetStudyAsJSON", VF_CLIENT_MINIMAL, stages_p);
+																	TimeStudyStage (context_p, study_id_s, "GetStudyAsJSON", VF_CLIENT_FULL, stages_p);
+
+																	TimeStudyStage (context_p, study_id_s, "CalculateStudyStatistics", VF_STORAGE, stages_p);
+																	TimeStudyStage (context_p, study_id_s, "SaveStudyAsFrictionlessData", VF_STORAGE, stages_p);
+																	TimeStudyStage (context_p, study_id_s, "IndexStudy", VF_INDEXING, stages_p);
+																}
+
+															FreeCopiedString (study_id_s);
+
+															return run_p;
+														}
+												}
+
+											FreeCopiedString (study_id_s);
+										}
+								}
+						}
+					else
+						{
+							json_decref (stages_p);
+						}
+				}
+
+			json_decref (run_p);
+		}
+
+	printf ("Failed to run benchmark for " UINT32_FMT " plots and " UINT32_FMT " variables\n", num_plots, num_variables);
+
+	return NULL;
+}
+
+
+/*
+ * Create an empty Study with the right layout for the given number of plots
+ * and return its id.
+ */
+static char *SaveBenchmarkStudy (BenchmarkContext *context_p, const uint32 num_plots, const uint32 num_variables)
+{
+	char *study_id_s = NULL;
+	Location *location_p = GetLocationByIdString (context_p -> bc_location_id_s, VF_STORAGE, context_p -> bc_data_p);
+
+	if (location_p)
+		{
+			const uint32 num_rows = (num_plots + S_NUM_COLUMNS - 1) / S_NUM_COLUMNS;
+			char name_s [128];
+			Study *study_p = NULL;
+
+			snprintf (name_s, sizeof (name_s), "Benchmark study " UINT32_FMT " plots " UINT32_FMT " variables %s", num_plots, num_variables, context_p -> bc_start_time_s);
+
+			study_p = AllocateStudy (NULL, NULL, name_s, NULL, NULL, NULL, location_p, context_p -> bc_trial_p, MF_SHADOW_USE, NULL, NULL, "Synthetic benchmark data",
+															 NULL, NULL, NULL, &num_rows, &S_NUM_COLUMNS, &S_NUM_REPLICATES, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+															 NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, NULL, context_p -> bc_data_p);
+
+			if (study_p)
+				{
+					if (SaveStudy (study_p, context_p -> bc_job_p, context_p -> bc_data_p, NULL) == OS_SUCCEEDED)
+						{
+							study_id_s = GetBSONOidAsString (study_p -> st_id_p);
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to save \"%s\"", name_s);
+						}
+
+					/* Even if it failed, the Study may have been indexed */
+					if (study_p -> st_id_p)
+						{
+							AddIndexedId (context_p, study_p -> st_id_p);
+						}
+
+					FreeStudy (study_p);
+				}
+			else
+				{
+					FreeLocation (location_p);
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to load benchmark location \"%s\"", context_p -> bc_location_id_s);
+		}
+
+	return study_id_s;
+}
+
+
+/*
+ * Build the same table that the plots submission service gets from a
+ * spreadsheet upload. Every cell is a string and the observations are
+ * derived from the seed so that each run uploads identical data.
+ */
+static json_t *GeneratePlotsTable (BenchmarkContext *context_p, const uint32 num_plots, const uint32 num_variables)
+{
+	json_t *plots_json_p = json_array ();
+
+	if (plots_json_p)
+		{
+			uint32 state = context_p -> bc_seed;
+			uint32 i;
+
+			for (i = 0; i < num_plots; ++ i)
+				{
+					json_t *row_json_p = json_object ();
+
+					if (row_json_p)
+						{
+							if (json_array_append_new (plots_json_p, row_json_p) == 0)
+								{
+									char accession_s [32];
+									bool success_flag;
+
+									snprintf (accession_s, sizeof (accession_s), "BENCH" UINT32_FMT, i / S_PLOTS_PER_ACCESSION);
+
+									success_flag = SetTableIntegerCell (row_json_p, PL_INDEX_TABLE_TITLE_S, i + 1) &&
+										SetTableIntegerCell (row_json_p, PL_ROW_TITLE_S, (i / S_NUM_COLUMNS) + 1) &&
+										SetTableIntegerCell (row_json_p, PL_COLUMN_TITLE_S, (i % S_NUM_COLUMNS) + 1) &&
+										SetTableIntegerCell (row_json_p, PL_REPLICATE_TITLE_S, (i % S_NUM_REPLICATES) + 1) &&
+										SetTableCell (row_json_p, PL_ACCESSION_TABLE_TITLE_S, accession_s);
+
+									if (success_flag)
+										{
+											uint32 j;
+
+											for (j = 0; j < num_variables; ++ j)
+												{
+													const uint32 value = GetNextRandomValue (&state);
+
+													/* Leave roughly 1 in 20 observations missing */
+													if ((value % 20) != 0)
+														{
+															char value_s [32];
+
+															snprintf (value_s, sizeof (value_s), "%u.%02u", (value >> 8) % 1000, (value >> 4) % 100);
+
+															if (!SetTableCell (row_json_p, * ((context_p -> bc_variable_names_ss) + j), value_s))
+																{
+																	success_flag = false;
+																	break;
+																}
+														}
+												}
+										}
+
+									if (!success_flag)
+										{
+											json_decref (plots_json_p);
+											return NULL;
+										}
+								}
+							else
+								{
+									json_decref (row_json_p);
+									json_decref (plots_json_p);
+									return NULL;
+								}
+						}
+					else
+						{
+							json_decref (plots_json_p);
+							return NULL;
+						}
+				}		/* for (i = 0; i < num_plots; ++ i) */
+		}
+
+	return plots_json_p;
+}
+
+
+static bool SetTableCell (json_t *row_json_p, const char *key_s, const char *value_s)
+{
+	return SetJSONString (row_json_p, key_s, value_s);
+}
+
+
+static bool SetTableIntegerCell (json_t *row_json_p, const char *key_s, const uint32 value)
+{
+	char value_s [16];
+
+	snprintf (value_s, sizeof (value_s), UINT32_FMT, value);
+
+	return SetTableCell (row_json_p, key_s, value_s);
+}
+
+
+/*
+ * A simple linear congruential generator so that the generated
+ * data is the same on every platform for a given seed.
+ */
+static uint32 GetNextRandomValue (uint32 *state_p)
+{
+	*state_p = (*state_p * 1664525) + 1013904223;
+
+	return *state_p;
+}
+
+
+static bool TimeUpload (BenchmarkContext *context_p, const char *study_id_s, json_t *plots_json_p, json_t *stages_p)
+{
+	bool success_flag = false;
+	Study *study_p = GetStudyByIdString (study_id_s, VF_STORAGE, context_p -> bc_data_p);
+
+	if (study_p)
+		{
+			StageMeasurement measurement;
+			PlotsTableSchema *schema_p = NULL;
+			bool upload_flag = false;
+
+			StartStage (context_p, &measurement);
+
+			schema_p = AllocatePlotsTableSchema ();
+
+			if (schema_p)
+				{
+					upload_flag = AddPlotsFromJSON (context_p -> bc_job_p, plots_json_p, study_p, schema_p, context_p -> bc_data_p);
+				}
+
+			success_flag = EndStage (context_p, &measurement, "AddPlotsFromJSON", upload_flag, stages_p) && upload_flag;
+
+			/* The Study's plots can refer to the schema's Measured Variables */
+			FreeStudy (study_p);
+
+			if (schema_p)
+				{
+					FreePlotsTableSchema (schema_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Each stage gets a freshly loaded Study without its plots so that nothing
+ * is reused from an earlier stage. Loading it is not part of the timings.
+ */
+static bool TimeStudyStage (BenchmarkContext *context_p, const char *study_id_s, const char *stage_s, const ViewFormat format, json_t *stages_p)
+{
+	bool success_flag = false;
+	FieldTrialServiceData *data_p = context_p -> bc_data_p;
+	Study *study_p = GetStudyByIdString (study_id_s, VF_STORAGE, data_p);
+
+	if (study_p)
+		{
+			StageMeasurement measurement;
+			bool stage_flag = false;
+			char *name_s = NULL;
+
+			StartStage (context_p, &measurement);
+
+			if (strcmp (stage_s, "GetStudyPlots") == 0)
+				{
+					stage_flag = GetStudyPlots (study_p, format, data_p);
+				}
+			else if (strcmp (stage_s, "GetStudyAsJSON") == 0)
+				{
+					json_t *study_json_p = GetStudyAsJSON (study_p, format, NULL, data_p);
+
+					if (study_json_p)
+						{
+							stage_flag = true;
+							json_decref (study_json_p);
+						}
+
+					name_s = ConcatenateVarargsStrings (stage_s, " (", GetViewFormatName (format), ")", NULL);
+				}
+			else if (strcmp (stage_s, "CalculateStudyStatistics") == 0)
+				{
+					stage_flag = (CalculateStudyStatistics (study_p, data_p) == OS_SUCCEEDED);
+				}
+			else if (strcmp (stage_s, "SaveStudyAsFrictionlessData") == 0)
+				{
+					stage_flag = SaveStudyAsFrictionlessData (study_p, data_p);
+				}
+			else if (strcmp (stage_s, "IndexStudy") == 0)
+				{
+					stage_flag = (IndexStudy (study_p, context_p -> bc_job_p, S_JOB_NAME_S, data_p) == OS_SUCCEEDED);
+				}
+
+			success_flag = EndStage (context_p, &measurement, name_s ? name_s : stage_s, stage_flag, stages_p) && stage_flag;
+
+			if (name_s)
+				{
+					FreeCopiedString (name_s);
+				}
+
+			FreeStudy (study_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to load study \"%s\" for %s", study_id_s, stage_s);
+		}
+
+	return success_flag;
+}
+
+
+static const char *GetViewFormatName (const ViewFormat format)
+{
+	const char *name_s = "unknown";
+
+	switch (format)
+		{
+			case VF_STORAGE:
+				name_s = "VF_STORAGE";
+				break;
+
+			case VF_INDEXING:
+				name_s = "VF_INDEXING";
+				break;
+
+			case VF_REFERENCE:
+				name_s = "VF_REFERENCE";
+				break;
+
+			case VF_CLIENT_MINIMAL:
+				name_s = "VF_CLIENT_MINIMAL";
+				break;
+
+			case VF_CLIENT_FULL:
+				name_s = "VF_CLIENT_FULL";
+				break;
+
+			default:
+				break;
+		}
+
+	return name_s;
+}
+
+
+static void StartStage (BenchmarkContext *context_p, StageMeasurement *measurement_p)
+{
+	ResetPeakMemoryUsage ();
+
+	measurement_p -> sm_op_counters_flag = GetServerOpCounters (context_p -> bc_stats_client_p, measurement_p -> sm_op_counters);
+
+	clock_gettime (CLOCK_MONOTONIC, & (measurement_p -> sm_start));
+}
+
+
+static bool EndStage (BenchmarkContext *context_p, StageMeasurement *measurement_p, const char *stage_s, const bool success_flag, json_t *stages_p)
+{
+	struct timespec end;
+	json_t *stage_p = NULL;
+	double64 wall_time;
+
+	clock_gettime (CLOCK_MONOTONIC, &end);
+
+	wall_time = ((double64) (end.tv_sec - measurement_p -> sm_start.tv_sec)) + (((double64) (end.tv_nsec - measurement_p -> sm_start.tv_nsec)) / 1000000000.0);
+
+	printf ("%s: %s in %.3f seconds\n", stage_s, success_flag ? "succeeded" : "failed", wall_time);
+
+	stage_p = json_object ();
+
+	if (stage_p)
+		{
+			if (json_array_append_new (stages_p, stage_p) == 0)
+				{
+					if ((SetJSONString (stage_p, "stage", stage_s)) &&
+							(SetJSONBoolean (stage_p, "success", success_flag)) &&
+							(SetJSONReal (stage_p, "wall_time_seconds", wall_time)) &&
+							(SetJSONInteger (stage_p, "peak_rss_kb", GetPeakMemoryUsage ())))
+						{
+							int64 op_counters [S_NUM_OP_COUNTERS];
+
+							if ((measurement_p -> sm_op_counters_flag) && (GetServerOpCounters (context_p -> bc_stats_client_p, op_counters)))
+								{
+									json_t *ops_p = json_object ();
+
+									if (ops_p)
+										{
+											if (json_object_set_new (stage_p, "mongo_operations", ops_p) == 0)
+												{
+													int64 total = 0;
+													uint32 i;
+
+													/*
+													 * The serverStatus call that got the starting counts is included
+													 * in the ending ones so remove it.
+													 */
+													-- (op_counters [S_NUM_OP_COUNTERS - 1]);
+
+													for (i = 0; i < S_NUM_OP_COUNTERS; ++ i)
+														{
+															const int64 count = op_counters [i] - (measurement_p -> sm_op_counters [i]);
+
+															if (!SetJSONInteger (ops_p, S_OP_COUNTER_NAMES_SS [i], count))
+																{
+																	return false;
+																}
+
+															total += count;
+														}
+
+													return SetJSONInteger (ops_p, "total", total);
+												}
+											else
+												{
+													json_decref (ops_p);
+												}
+										}
+								}
+							else
+								{
+									/* We still have the timings so carry on */
+									return true;
+								}
+						}
+				}
+			else
+				{
+					json_decref (stage_p);
+				}
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add results for %s", stage_s);
+
+	return false;
+}
+
+
+/*
+ * Writing 5 to clear_refs resets the process's peak resident set size
+ * so that each stage's peak can be measured on its own.
+ */
+static void ResetPeakMemoryUsage (void)
+{
+	FILE *clear_refs_f = fopen ("/proc/self/clear_refs", "w");
+
+	if (clear_refs_f)
+		{
+			fputs ("5", clear_refs_f);
+			fclose (clear_refs_f);
+		}
+}
+
+
+/*
+ * Get the peak resident set size in kB. If /proc is not available then
+ * this is the peak for the whole process rather than the current stage.
+ */
+static int64 GetPeakMemoryUsage (void)
+{
+	int64 peak = -1;
+	FILE *status_f = fopen ("/proc/self/status", "r");
+
+	if (status_f)
+		{
+			char line_s [256];
+
+			while ((peak == -1) && (fgets (line_s, sizeof (line_s), status_f)))
+				{
+					long long value;
+
+					if (sscanf (line_s, "VmHWM: %lld kB", &value) == 1)
+						{
+							peak = (int64) value;
+						}
+				}
+
+			fclose (status_f);
+		}
+
+	if (peak == -1)
+		{
+			struct rusage usage;
+
+			if (getrusage (RUSAGE_SELF, &usage) == 0)
+				{
+					peak = (int64) usage.ru_maxrss;
+				}
+		}
+
+	return peak;
+}
+
+
+static bool GetServerOpCounters (mongoc_client_t *client_p, int64 op_counters_p [S_NUM_OP_COUNTERS])
+{
+	bool success_flag = false;
+	bson_t *command_p = BCON_NEW ("serverStatus", BCON_INT32 (1));
+
+	if (command_p)
+		{
+			bson_t reply;
+			bson_error_t error;
+
+			if (mongoc_client_command_simple (client_p, "admin", command_p, NULL, &reply, &error))
+				{
+					bson_iter_t iter;
+					bson_iter_t counters_iter;
+
+					if (bson_iter_init_find (&iter, &reply, "opcounters") && BSON_ITER_HOLDS_DOCUMENT (&iter) && bson_iter_recurse (&iter, &counters_iter))
+						{
+							uint32 i;
+
+							success_flag = true;
+
+							for (i = 0; i < S_NUM_OP_COUNTERS; ++ i)
+								{
+									bson_iter_t value_iter = counters_iter;
+
+									if (bson_iter_find (&value_iter, S_OP_COUNTER_NAMES_SS [i]))
+										{
+											op_counters_p [i] = bson_iter_as_int64 (&value_iter);
+										}
+									else
+										{
+											success_flag = false;
+										}
+								}
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "serverStatus failed: %s", error.message);
+				}
+
+			bson_destroy (&reply);
+			bson_destroy (command_p);
+		}
+
+	return success_flag;
+}
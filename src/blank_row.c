@@ -36,10 +36,13 @@ Row *AllocateBlankRow (bson_oid_t *id_p, const uint32 study_index, Plot *parent_
 
 BlankRow *GetBlankRowFromJSON (const json_t *row_json_p, Plot *plot_p, const Study *study_p, const ViewFormat format, FieldTrialServiceData *data_p)
 {
-	BlankRow *row_p = (BlankRow *) AllocMemory (sizeof (BlankRow));
+	StudyArena *arena_p = plot_p ? plot_p -> pl_arena_p : NULL;
+	BlankRow *row_p = (BlankRow *) AllocStudyMemory (arena_p, sizeof (BlankRow));
 
 	if (row_p)
 		{
+			row_p -> br_base.ro_arena_p = arena_p;
+
 			SetRowCallbackFunctions (& (row_p -> br_base),
 															 NULL,
 															 AddBlankRowToJSON,
@@ -51,7 +54,7 @@ BlankRow *GetBlankRowFromJSON (const json_t *row_json_p, Plot *plot_p, const Stu
 					return row_p;
 				}
 
-			FreeMemory (row_p);
+			FreeStudyMemory (arena_p, row_p);
 		}
 
 	return NULL;
@@ -24,6 +24,7 @@
 #include "browse_programme_history.h"
 
 #include "dfw_util.h"
+#include "revision_store.h"
 
 #include "audit.h"
 
@@ -277,84 +278,82 @@ static bool SetUpVersionsParameter (const FieldTrialServiceData *data_p, StringP
 {
 	bool success_flag = false;
 
-	json_t *results_p = GetAllJSONVersionsOfObject (id_s, dt, data_p);
+	/*
+	 * We only need the timestamps and sizes so there's no need
+	 * to load and rebuild every version
+	 */
+	json_t *results_p = GetRevisionsMetadataOfObject (id_s, dt, data_p);
 
 
 	if (results_p)
 		{
-			if (json_is_array (results_p))
-				{
-					const size_t num_results = json_array_size (results_p);
+			const size_t num_results = json_array_size (results_p);
 
-					success_flag = true;
+			success_flag = true;
 
-					if (num_results > 0)
+			if (num_results > 0)
+				{
+					bool value_set_flag = false;
+					size_t i = 0;
+					const char *param_value_s = GetStringParameterDefaultValue (param_p);
+
+					while ((i < num_results) && success_flag)
 						{
-							if (success_flag)
-								{
-									bool value_set_flag = false;
-									size_t i = 0;
-									const char *param_value_s = GetStringParameterDefaultValue (param_p);
+							const json_t *entry_p = json_array_get (results_p, i);
+							const char *value_s = GetJSONString (entry_p, MONGO_TIMESTAMP_S);
+							char *description_s = NULL;
+							json_int_t size = 0;
 
-									while ((i < num_results) && success_flag)
+							if (value_s)
+								{
+									if (param_value_s && (strcmp (param_value_s, value_s) == 0))
 										{
-											json_t *entry_p = json_array_get (results_p, i);
-											Programme *programme_p = GetProgrammeFromJSON (entry_p, VF_CLIENT_MINIMAL, data_p);
-
-											if (programme_p)
-												{
-													const char *value_s = FT_DEFAULT_TIMESTAMP_S;
-
-													if ((programme_p -> pr_metadata_p) && (programme_p -> pr_metadata_p -> me_timestamp_s))
-														{
-															value_s = programme_p -> pr_metadata_p -> me_timestamp_s;
-
-															if (param_value_s && (strcmp (param_value_s, value_s) == 0))
-																{
-																	value_set_flag = true;
-																}
-														}
-
-													if (!CreateAndAddStringParameterOption (param_p, value_s, value_s))
-														{
-															success_flag = false;
-															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add param option for \"%s\"", value_s);
-														}
-
-													FreeProgramme (programme_p);
-												}		/* if (programme_p) */
-											else
-												{
-													success_flag = false;
-													PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to get Programme");
-												}
-
-											if (success_flag)
-												{
-													++ i;
-												}
+											value_set_flag = true;
+										}
+								}
+							else
+								{
+									value_s = FT_DEFAULT_TIMESTAMP_S;
+								}
 
-										}		/* while ((i < num_results) && success_flag) */
+							if (GetJSONInteger (entry_p, RS_REVISION_SIZE_S, &size))
+								{
+									char *size_s = ConvertSizeTToString ((size_t) size);
 
-									/*
-									 * If the parameter's value isn't on the list, reset it
-									 */
-									if ((param_value_s != NULL) && (value_set_flag == false))
+									if (size_s)
 										{
-											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "param value \"%s\" not on list of existing programmes", param_value_s);
+											description_s = ConcatenateVarargsStrings (value_s, " (", size_s, " bytes)", NULL);
+											FreeCopiedString (size_s);
 										}
+								}
+
+							if (!CreateAndAddStringParameterOption (& (param_p -> sp_base_param), value_s, description_s ? description_s : value_s))
+								{
+									success_flag = false;
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add param option for \"%s\"", value_s);
+								}
 
-								}		/* if (success_flag) */
+							if (description_s)
+								{
+									FreeCopiedString (description_s);
+								}
 
+							if (success_flag)
+								{
+									++ i;
+								}
 
-						}		/* if (num_results > 0) */
-					else
+						}		/* while ((i < num_results) && success_flag) */
+
+					/*
+					 * If the parameter's value isn't on the list, reset it
+					 */
+					if ((param_value_s != NULL) && (value_set_flag == false))
 						{
-							/* nothing to add */
-							success_flag = true;
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "param value \"%s\" not on list of existing programmes", param_value_s);
 						}
 
-				}		/* if (json_is_array (results_p)) */
+				}		/* if (num_results > 0) */
 
 			json_decref (results_p);
 		}		/* if (results_p) */
@@ -32,6 +32,7 @@
 #include "browse_study_history.h"
 
 #include "dfw_util.h"
+#include "revision_store.h"
 
 #include "audit.h"
 
@@ -312,7 +313,7 @@ static bool AddStudyVersionsList (Study *active_study_p, const char *id_s, Param
 			param_p -> pa_read_only_flag = read_only_flag;
 
 
-			if (SetUpVersionsParameter (dfw_data_p, (StringParameter *) param_p, id_s, active_study_p  ? active_study_p -> st_timestamp_s : NULL, DFTD_FIELD_TRIAL))
+			if (SetUpVersionsParameter (dfw_data_p, (StringParameter *) param_p, id_s, active_study_p  ? active_study_p -> st_timestamp_s : NULL, DFTD_STUDY))
 				{
 					/*
 					 * We want to update all of the values in the form
@@ -337,84 +338,82 @@ static bool SetUpVersionsParameter (const FieldTrialServiceData *data_p, StringP
 {
 	bool success_flag = false;
 
-	json_t *results_p = GetAllJSONVersionsOfObject (id_s, dt, data_p);
+	/*
+	 * We only need the timestamps and sizes so there's no need
+	 * to load and rebuild every version
+	 */
+	json_t *results_p = GetRevisionsMetadataOfObject (id_s, dt, data_p);
 
 
 	if (results_p)
 		{
-			if (json_is_array (results_p))
-				{
-					const size_t num_results = json_array_size (results_p);
+			const size_t num_results = json_array_size (results_p);
 
-					success_flag = true;
+			success_flag = true;
+
+			if (num_results > 0)
+				{
+					bool value_set_flag = false;
+					size_t i = 0;
+					const char *param_value_s = GetStringParameterDefaultValue (param_p);
 
-					if (num_results > 0)
+					while ((i < num_results) && success_flag)
 						{
-							if (success_flag)
-								{
-									bool value_set_flag = false;
-									size_t i = 0;
-									const char *param_value_s = GetStringParameterDefaultValue (param_p);
+							const json_t *entry_p = json_array_get (results_p, i);
+							const char *value_s = GetJSONString (entry_p, MONGO_TIMESTAMP_S);
+							char *description_s = NULL;
+							json_int_t size = 0;
 
-									while ((i < num_results) && success_flag)
+							if (value_s)
+								{
+									if (param_value_s && (strcmp (param_value_s, value_s) == 0))
 										{
-											json_t *entry_p = json_array_get (results_p, i);
-											Study *study_p = GetStudyFromJSON (entry_p, VF_CLIENT_MINIMAL, data_p);
-
-											if (study_p)
-												{
-													const char *value_s = FT_DEFAULT_TIMESTAMP_S;
-
-													if (study_p -> st_timestamp_s)
-														{
-															value_s = study_p -> st_timestamp_s;
-
-															if (param_value_s && (strcmp (param_value_s, value_s) == 0))
-																{
-																	value_set_flag = true;
-																}
-														}
-
-													if (!CreateAndAddStringParameterOption (& (param_p -> sp_base_param), value_s, value_s))
-														{
-															success_flag = false;
-															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add param option for \"%s\"", value_s);
-														}
-
-													FreeStudy (study_p);
-												}		/* if (study_p) */
-											else
-												{
-													success_flag = false;
-													PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to get Study");
-												}
-
-											if (success_flag)
-												{
-													++ i;
-												}
+											value_set_flag = true;
+										}
+								}
+							else
+								{
+									value_s = FT_DEFAULT_TIMESTAMP_S;
+								}
 
-										}		/* while ((i < num_results) && success_flag) */
+							if (GetJSONInteger (entry_p, RS_REVISION_SIZE_S, &size))
+								{
+									char *size_s = ConvertSizeTToString ((size_t) size);
 
-									/*
-									 * If the parameter's value isn't on the list, reset it
-									 */
-									if ((param_value_s != NULL) && (value_set_flag == false))
+									if (size_s)
 										{
-											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "param value \"%s\" not on list of existing studys", param_value_s);
+											description_s = ConcatenateVarargsStrings (value_s, " (", size_s, " bytes)", NULL);
+											FreeCopiedString (size_s);
 										}
+								}
 
-								}		/* if (success_flag) */
+							if (!CreateAndAddStringParameterOption (& (param_p -> sp_base_param), value_s, description_s ? description_s : value_s))
+								{
+									success_flag = false;
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add param option for \"%s\"", value_s);
+								}
 
+							if (description_s)
+								{
+									FreeCopiedString (description_s);
+								}
 
-						}		/* if (num_results > 0) */
-					else
+							if (success_flag)
+								{
+									++ i;
+								}
+
+						}		/* while ((i < num_results) && success_flag) */
+
+					/*
+					 * If the parameter's value isn't on the list, reset it
+					 */
+					if ((param_value_s != NULL) && (value_set_flag == false))
 						{
-							/* nothing to add */
-							success_flag = true;
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "param value \"%s\" not on list of existing studys", param_value_s);
 						}
 
-				}		/* if (json_is_array (results_p)) */
+				}		/* if (num_results > 0) */
 
 			json_decref (results_p);
 		}		/* if (results_p) */
@@ -28,6 +28,7 @@
 #include "bson/bson.h"
 
 #include "string_parameter.h"
+#include "option_list_cache.h"
 
 
 /*
@@ -237,111 +238,103 @@ bool GetSubmissionCropParameterTypeForNamedParameter (const char *param_name_s,
 bool SetUpCropsListParameter (const FieldTrialServiceData *data_p, Parameter *param_p, const Crop *active_crop_p, const char *empty_option_s, const bool new_study_flag)
 {
 	bool success_flag = false;
+	json_t *results_p = GetOptionListDocuments (DFTD_CROP, data_p);
 
-	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_CROP]))
+	if (results_p)
 		{
-			bson_t *query_p = NULL;
-			bson_t *opts_p =  BCON_NEW ( "sort", "{", CR_NAME_S, BCON_INT32 (1), "}", "collation", "{", "locale", BCON_UTF8 ("en"), "}");
-			json_t *results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, opts_p);
-
-			if (results_p)
+			if (json_is_array (results_p))
 				{
-					if (json_is_array (results_p))
+					const size_t num_results = json_array_size (results_p);
+
+					if (num_results > 0)
 						{
-							const size_t num_results = json_array_size (results_p);
+							size_t i;
+							const json_t *service_config_p = data_p -> dftsd_base_data.sd_config_p;
+							const char *default_crop_s = NULL;
+							bool default_is_set_flag = false;
 
-							if (num_results > 0)
+							if (active_crop_p)
 								{
-									size_t i;
-									const json_t *service_config_p = data_p -> dftsd_base_data.sd_config_p;
-									const char *default_crop_s = NULL;
-									bool default_is_set_flag = false;
+									default_crop_s = active_crop_p -> cr_name_s;
+								}
+							else if (new_study_flag)
+								{
+									default_crop_s = GetJSONString (service_config_p, "default_crop");
+								}
 
-									if (active_crop_p)
-										{
-											default_crop_s = active_crop_p -> cr_name_s;
-										}
-									else if (new_study_flag)
-										{
-											default_crop_s = GetJSONString (service_config_p, "default_crop");
-										}
+							if ((!default_crop_s) && empty_option_s)
+								{
+									default_crop_s = empty_option_s;
+								}
 
-									if ((!default_crop_s) && empty_option_s)
-										{
-											default_crop_s = empty_option_s;
-										}
+							/*
+							 * If there's an empty option, add it
+							 */
+							if (empty_option_s)
+								{
+									success_flag = CreateAndAddStringParameterOption (param_p, empty_option_s, empty_option_s);
 
-									/*
-									 * If there's an empty option, add it
-									 */
-									if (empty_option_s)
+									if (!default_crop_s)
 										{
-											success_flag = CreateAndAddStringParameterOption (param_p, empty_option_s, empty_option_s);
-
-											if (!default_crop_s)
-												{
-													success_flag = SetDefaultCropValue ((StringParameter *) param_p, empty_option_s);
+											success_flag = SetDefaultCropValue ((StringParameter *) param_p, empty_option_s);
 
-													default_is_set_flag = true;
-												}
+											default_is_set_flag = true;
 										}
+								}
+
+							for (i = 0; i < num_results; ++ i)
+								{
+									json_t *entry_p = json_array_get (results_p, i);
+									const char *name_s = GetJSONString (entry_p, CR_NAME_S);
+									bson_oid_t id;
 
-									for (i = 0; i < num_results; ++ i)
+									if (name_s && GetMongoIdFromJSON (entry_p, &id))
 										{
-											json_t *entry_p = json_array_get (results_p, i);
-											Crop *crop_p = GetCropFromJSON (entry_p, data_p);
+											char *id_s = GetBSONOidAsString (&id);
 
-											if (crop_p)
+											if (id_s)
 												{
-													char *id_s = GetBSONOidAsString (crop_p -> cr_id_p);
-
-													if (id_s)
+													if (!default_is_set_flag)
 														{
-															if (!default_is_set_flag)
+															if (default_crop_s)
 																{
-																	if (default_crop_s)
-																		{
-																			if (strcmp (crop_p -> cr_name_s, default_crop_s) == 0)
-																				{
-																					success_flag = SetDefaultCropValue ((StringParameter *) param_p, id_s);
-																					default_is_set_flag = true;
-																				}
-																		}
-																	else if (i == 0)
+																	if (strcmp (name_s, default_crop_s) == 0)
 																		{
 																			success_flag = SetDefaultCropValue ((StringParameter *) param_p, id_s);
 																			default_is_set_flag = true;
 																		}
 																}
-
-															success_flag = CreateAndAddStringParameterOption (param_p, id_s, crop_p -> cr_name_s);
-
-															FreeBSONOidString (id_s);
+															else if (i == 0)
+																{
+																	success_flag = SetDefaultCropValue ((StringParameter *) param_p, id_s);
+																	default_is_set_flag = true;
+																}
 														}
 
-													FreeCrop (crop_p);
-												}		/* if (crop_p) */
+													success_flag = CreateAndAddStringParameterOption (param_p, id_s, name_s);
 
-										}		/* for (i = 0; i < num_results; ++ i)) */
+													FreeBSONOidString (id_s);
+												}
 
-								}		/* if (num_results > 0) */
-							else
-								{
-									/* nothing to add */
-									success_flag = true;
-								}
+										}		/* if (name_s && GetMongoIdFromJSON (entry_p, &id)) */
+									else
+										{
+											PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, entry_p, "Failed to get crop id and name");
+										}
 
-						}		/* if (json_is_array (results_p)) */
+								}		/* for (i = 0; i < num_results; ++ i)) */
 
-					json_decref (results_p);
-				}		/* if (results_p) */
+						}		/* if (num_results > 0) */
+					else
+						{
+							/* nothing to add */
+							success_flag = true;
+						}
 
-			if (opts_p)
-				{
-					bson_destroy (opts_p);
-				}
+				}		/* if (json_is_array (results_p)) */
 
-		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_FIELD_TRIAL])) */
+			json_decref (results_p);
+		}		/* if (results_p) */
 
 	return success_flag;
 }
@@ -93,15 +93,50 @@
 #include "schema_term.h"
 #include "json_util.h"
 #include "nominal_scale_class.h"
+#include "http_response_cache.h"
+#include "byte_buffer.h"
+#include "hash_table.h"
+#include "linked_list.h"
+#include "memory_allocations.h"
 
 
+/*
+ * A Crop Ontology variable whose scale class is being refreshed.
+ */
+typedef struct ScaleClassRequest
+{
+	ListItem scr_node;
+
+	/* The variable's url as stored in the database, e.g. CO_321:0000007 */
+	char *scr_variable_url_s;
+
+	/* The url to get the variable's details from */
+	char *scr_request_url_s;
+
+	/* The transfer whilst the request is in progress */
+	CURL *scr_curl_p;
+
+	/* The response body whilst the request is in progress */
+	ByteBuffer *scr_response_p;
+
+	/* The scale class once it has been found */
+	const ScaleClass *scr_class_p;
+} ScaleClassRequest;
+
+
+/*
+ * The distinct Crop Ontology variables whose scale
+ * classes are being refreshed.
+ */
 typedef struct
 {
-	FieldTrialServiceData *cotd_service_data_p;
-	CurlTool *cotd_curl_p;
-	json_t *cotd_query_p;
-	char *cotd_query_key_s;
-} COToolData;
+	LinkedList *scrs_requests_p;
+
+	/* The ScaleClassRequests keyed by their variable urls */
+	HashTable *scrs_requests_table_p;
+
+	const char *scrs_api_url_s;
+} ScaleClassRequests;
 
 
 
@@ -113,6 +148,8 @@ typedef struct
 
 static const char * const S_CROP_ONTOLOGY_API_URL_S = "http://www.cropontology.org/get-attributes/";
 
+static const char * const S_VARIABLE_URL_KEY_S = "variable.so:sameAs";
+
 
 static const char * const S_SCALE_CLASS_NAME_S = CONTEXT_PREFIX_SCHEMA_ORG_S "name";
 static const char * const S_SCALE_CLASS_TYPE_S = "class_type";
@@ -131,9 +168,33 @@ static SchemaTerm *FindCachedCropOnotologySchemaTerm (const char *term_s, const
 
 static const ScaleClass *GetScaleDatatype (const json_t *document_p);
 
-static const ScaleClass *GetScaleClass (const char *variable_url_s, CurlTool *curl_p);
+static SchemaTerm *GetSchemaTermFromCropOntologyResponse (const char *results_s, const char *term_s, TermType expected_type, TermType *found_type_p);
+
+static const ScaleClass *GetScaleClassFromResponse (const char *response_s, const char *url_s);
+
+static bool InitScaleClassRequests (ScaleClassRequests *requests_p, const char *api_url_s);
+
+static void ClearScaleClassRequests (ScaleClassRequests *requests_p);
+
+static ScaleClassRequest *AllocateScaleClassRequest (const char *variable_url_s, const char *api_url_s);
+
+static void FreeScaleClassRequest (ListItem *node_p);
+
+static bool AddScaleClassRequest (const bson_t *document_p, void *data_p);
+
+static size_t FetchScaleClasses (LinkedList *requests_p, const uint32 max_connections);
+
+static bool SetScaleClassFromCache (ScaleClassRequest *request_p);
 
-static bool UpdateScaleTerms (const bson_t *document_p, void *data_p);
+static CURL *StartScaleClassRequest (ScaleClassRequest *request_p);
+
+static void FinishScaleClassRequest (ScaleClassRequest *request_p, CURLcode res);
+
+static size_t AddToScaleClassResponse (char *data_p, size_t size, size_t num_items, void *user_data_p);
+
+static size_t WriteScaleClasses (LinkedList *requests_p, FieldTrialServiceData *data_p);
+
+static size_t CountBulkWriteErrors (const bson_t *reply_p);
 
 
 /*
@@ -168,160 +229,63 @@ SchemaTerm *GetCropOnotologySchemaTerm (const char *crop_ontology_term_s, TermTy
 
 			if (url_s)
 				{
-					CurlTool *tool_p = AllocateMemoryCurlTool (0);
+					char *cached_response_s = GetCachedHttpResponse (url_s);
 
-					if (tool_p)
+					if (cached_response_s)
 						{
-							if (SetUriForCurlTool (tool_p, url_s))
-								{
-									CURLcode c = RunCurlTool (tool_p);
+							term_p = GetSchemaTermFromCropOntologyResponse (cached_response_s, term_s, expected_type, found_type_p);
+							FreeCopiedString (cached_response_s);
+						}
+					else
+						{
+							CurlTool *tool_p = AllocateMemoryCurlTool (0);
 
-									if (c == CURLE_OK)
+							if (tool_p)
+								{
+									if (SetUriForCurlTool (tool_p, url_s))
 										{
-											const char *results_s = GetCurlToolData (tool_p);
+											CURLcode c = RunCurlTool (tool_p);
 
-											if (results_s)
+											if (c == CURLE_OK)
 												{
-													json_error_t err;
-													json_t *res_p = json_loads (results_s, JSON_DECODE_ANY, &err);
+													const char *results_s = GetCurlToolData (tool_p);
 
-													if (res_p)
+													if (results_s)
 														{
-															if (json_is_array (res_p))
-																{
-																	const size_t num_results = json_array_size (res_p);
-																	size_t i = 0;
-																	TermType tt = TT_NUM_TYPES;
-
-																	/* Determine the type of data */
-																	while ((i < num_results) && (tt == TT_NUM_TYPES))
-																		{
-																			json_t *entry_p = json_array_get (res_p, i);
-																			const char *key_s = GetJSONString (entry_p, "key");
-
-																			if (key_s)
-																				{
-																					if (strcmp (key_s, "Method name") == 0)
-																						{
-																							tt = TT_METHOD;
-																						}
-																					else if (strcmp (key_s, "Variable name") == 0)
-																						{
-																							tt = TT_VARIABLE;
-																						}
-																					else if (strcmp (key_s, "Trait name") == 0)
-																						{
-																							tt = TT_TRAIT;
-																						}
-																					else if (strcmp (key_s, "Scale name") == 0)
-																						{
-																							tt = TT_UNIT;
-																						}
-
-																				}		/* if (key_s) */
-
-																			++ i;
-																		}		/* while ((i < num_results) && (var_type == TT_NUM_TYPES)) */
-
-
-																	if (tt != TT_NUM_TYPES)
-																		{
-																			/*
-																			 * Does the term type match what we expected to get?
-																			 */
-																			if ((expected_type == TT_NUM_TYPES) || (tt == expected_type))
-																				{
-																					const char *name_key_s = NULL;
-																					const char *abbr_key_s = NULL;
-																					const char *desc_key_s = NULL;
-																					bool is_unit_flag = false;
-
-																					switch (tt)
-																						{
-																							case TT_TRAIT:
-																								name_key_s = "Trait name";
-																								abbr_key_s = "Main trait abbreviation";
-																								desc_key_s = "Trait description";
-																								break;
-
-																							case TT_METHOD:
-																								name_key_s = "Method name";
-																								desc_key_s = "Method description";
-																								break;
-
-																							case TT_UNIT:
-																								name_key_s = "Scale name";
-																								is_unit_flag = true;
-																								break;
-
-																							case TT_VARIABLE:
-																								name_key_s = "Variable name";
-																								break;
-
-																							default:
-																								break;
-																						}
-
-																					term_p = GetSchemaTerm (res_p, term_s, name_key_s, abbr_key_s, desc_key_s, is_unit_flag);
-
-																					if (!term_p)
-																						{
-																							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, res_p, "GetSchemaTerm failed for term \"%s\", name_key \"%s\", abbr_key \"%s\", desc_key \"%s\"", term_s, name_key_s ? name_key_s : "", abbr_key_s ? abbr_key_s : "", desc_key_s ? desc_key_s : "");
-																						}
-																					else
-																						{
-																							*found_type_p = tt;
-																						}
-
-																				}		/* if (tt == expected_type) */
-																			else
-																				{
-																					PrintJSONToLog (STM_LEVEL_WARNING, __FILE__, __LINE__, res_p, "term is of type %d, expected is %d", tt, expected_type);
-																				}
-
-
-
-																		}		/* if (tt != TT_NUM_TYPES) */
-																	else
-																		{
-																			PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, res_p, "Failed to determine term type");
-																		}
-
-																}		/* if (json_is_array (res_p)) */
+															term_p = GetSchemaTermFromCropOntologyResponse (results_s, term_s, expected_type, found_type_p);
 
-															json_decref (res_p);
-														}		/* if (res_p) */
+															if (term_p)
+																{
+																	AddHttpResponseToCache (url_s, results_s);
+																}
+														}		/* if (results_s) */
 													else
 														{
-															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to load \"%s\" as JSON, err at %d, %d", results_s, err.line, err.column);
+															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to get data for \"%s\"", url_s);
 														}
 
-												}		/* if (results_s) */
+												}		/* if (c == CURLE_OK) */
 											else
 												{
-													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to get data for \"%s\"", url_s);
+													const char *error_s = curl_easy_strerror (c);
+
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to run \"%s\": \"%s\"", url_s, error_s);
 												}
 
-										}		/* if (c == CURLE_OK) */
+										}		/* if (SetUriForCurlTool (tool_p, url_s)) */
 									else
 										{
-											const char *error_s = curl_easy_strerror (c);
-
-											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to run \"%s\": \"%s\"", url_s, error_s);
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to get set curl tool's url to \"%s\"", url_s);
 										}
 
-								}		/* if (SetUriForCurlTool (tool_p, url_s)) */
+									FreeCurlTool (tool_p);
+								}		/* if (tool_p) */
 							else
 								{
-									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to get set curl tool's url to \"%s\"", url_s);
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to allocate curl tool for \"%s\"", url_s);
 								}
 
-							FreeCurlTool (tool_p);
-						}		/* if (tool_p) */
-					else
-						{
-							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to allocate curl tool for \"%s\"", url_s);
-						}
+						}		/* if (cached_response_s) else */
 
 					FreeCopiedString (url_s);
 				}		/* if (url_s) */
@@ -342,6 +306,127 @@ SchemaTerm *GetCropOnotologySchemaTerm (const char *crop_ontology_term_s, TermTy
  */
 
 
+static SchemaTerm *GetSchemaTermFromCropOntologyResponse (const char *results_s, const char *term_s, TermType expected_type, TermType *found_type_p)
+{
+	SchemaTerm *term_p = NULL;
+	json_error_t err;
+	json_t *res_p = json_loads (results_s, JSON_DECODE_ANY, &err);
+
+	if (res_p)
+		{
+			if (json_is_array (res_p))
+				{
+					const size_t num_results = json_array_size (res_p);
+					size_t i = 0;
+					TermType tt = TT_NUM_TYPES;
+
+					/* Determine the type of data */
+					while ((i < num_results) && (tt == TT_NUM_TYPES))
+						{
+							json_t *entry_p = json_array_get (res_p, i);
+							const char *key_s = GetJSONString (entry_p, "key");
+
+							if (key_s)
+								{
+									if (strcmp (key_s, "Method name") == 0)
+										{
+											tt = TT_METHOD;
+										}
+									else if (strcmp (key_s, "Variable name") == 0)
+										{
+											tt = TT_VARIABLE;
+										}
+									else if (strcmp (key_s, "Trait name") == 0)
+										{
+											tt = TT_TRAIT;
+										}
+									else if (strcmp (key_s, "Scale name") == 0)
+										{
+											tt = TT_UNIT;
+										}
+
+								}		/* if (key_s) */
+
+							++ i;
+						}		/* while ((i < num_results) && (var_type == TT_NUM_TYPES)) */
+
+
+					if (tt != TT_NUM_TYPES)
+						{
+							/*
+							 * Does the term type match what we expected to get?
+							 */
+							if ((expected_type == TT_NUM_TYPES) || (tt == expected_type))
+								{
+									const char *name_key_s = NULL;
+									const char *abbr_key_s = NULL;
+									const char *desc_key_s = NULL;
+									bool is_unit_flag = false;
+
+									switch (tt)
+										{
+											case TT_TRAIT:
+												name_key_s = "Trait name";
+												abbr_key_s = "Main trait abbreviation";
+												desc_key_s = "Trait description";
+												break;
+
+											case TT_METHOD:
+												name_key_s = "Method name";
+												desc_key_s = "Method description";
+												break;
+
+											case TT_UNIT:
+												name_key_s = "Scale name";
+												is_unit_flag = true;
+												break;
+
+											case TT_VARIABLE:
+												name_key_s = "Variable name";
+												break;
+
+											default:
+												break;
+										}
+
+									term_p = GetSchemaTerm (res_p, term_s, name_key_s, abbr_key_s, desc_key_s, is_unit_flag);
+
+									if (!term_p)
+										{
+											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, res_p, "GetSchemaTerm failed for term \"%s\", name_key \"%s\", abbr_key \"%s\", desc_key \"%s\"", term_s, name_key_s ? name_key_s : "", abbr_key_s ? abbr_key_s : "", desc_key_s ? desc_key_s : "");
+										}
+									else
+										{
+											*found_type_p = tt;
+										}
+
+								}		/* if (tt == expected_type) */
+							else
+								{
+									PrintJSONToLog (STM_LEVEL_WARNING, __FILE__, __LINE__, res_p, "term is of type %d, expected is %d", tt, expected_type);
+								}
+
+
+
+						}		/* if (tt != TT_NUM_TYPES) */
+					else
+						{
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, res_p, "Failed to determine term type");
+						}
+
+				}		/* if (json_is_array (res_p)) */
+
+			json_decref (res_p);
+		}		/* if (res_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "failed to load \"%s\" as JSON, err at %d, %d", results_s, err.line, err.column);
+		}
+
+	return term_p;
+}
+
+
 static char *GetTermEnglishValue (const json_t *entry_p)
 {
 	char *term_value_s = NULL;
@@ -792,170 +877,590 @@ const ScaleClass *GetScaleClassFromJSON (const json_t *class_json_p)
 }
 
 
+/*
+ * Refresh the scale classes of all of the Crop Ontology variables
+ * in the database.
+ *
+ * Each distinct variable is only requested once, the requests are run
+ * concurrently and all of the updates are written in a single bulk write.
+ */
 OperationStatus StoreAllScaleUnits (FieldTrialServiceData *data_p)
 {
 	OperationStatus status = OS_FAILED;
-	CurlTool *curl_tool_p = AllocateMemoryCurlTool (0);
+	ScaleClassRequests requests;
+
+	if (InitScaleClassRequests (&requests, data_p -> dftsd_crop_ontology_brapi_url_s))
+		{
+			if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE]))
+				{
+					/* We only need the urls of the crop ontology variables */
+					bson_t *query_p = BCON_NEW (S_VARIABLE_URL_KEY_S, "{", "$regex", BCON_UTF8 ("^CO_"), "}");
+
+					if (query_p)
+						{
+							bson_t *opts_p = BCON_NEW ("projection", "{", S_VARIABLE_URL_KEY_S, BCON_INT32 (1), "}");
+
+							if (opts_p)
+								{
+									size_t num_requests = 0;
+
+									if (ProcessMongoResults (data_p -> dftsd_mongo_p, query_p, opts_p, AddScaleClassRequest, &requests) == OS_FAILED)
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get all of the crop ontology variables");
+										}
+
+									num_requests = requests.scrs_requests_p -> ll_size;
+
+									if (num_requests > 0)
+										{
+											const size_t num_found = FetchScaleClasses (requests.scrs_requests_p, data_p -> dftsd_crop_ontology_max_connections);
+
+											PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Got scale classes for " SIZET_FMT " of " SIZET_FMT " crop ontology variables", num_found, num_requests);
+
+											if (num_found > 0)
+												{
+													const size_t num_written = WriteScaleClasses (requests.scrs_requests_p, data_p);
+
+													if (num_written > 0)
+														{
+															InvalidateMeasuredVariablesCaches ();
+														}
+
+													if (num_written == num_requests)
+														{
+															status = OS_SUCCEEDED;
+														}
+													else if (num_written > 0)
+														{
+															status = OS_PARTIALLY_SUCCEEDED;
+														}
+												}
+										}
+									else
+										{
+											status = OS_SUCCEEDED;
+										}
+
+									bson_destroy (opts_p);
+								}		/* if (opts_p) */
+
+							bson_destroy (query_p);
+						}		/* if (query_p) */
+
+				}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE])) */
+
+			ClearScaleClassRequests (&requests);
+		}		/* if (InitScaleClassRequests (&requests, data_p -> dftsd_crop_ontology_brapi_url_s)) */
+
+	return status;
+}
+
+
+static bool InitScaleClassRequests (ScaleClassRequests *requests_p, const char *api_url_s)
+{
+	requests_p -> scrs_requests_p = AllocateLinkedList (FreeScaleClassRequest);
 
-	if (curl_tool_p)
+	if (requests_p -> scrs_requests_p)
 		{
-			json_t *query_p = json_object ();
+			requests_p -> scrs_requests_table_p = GetHashTableOfStringPointers (1024, 75);
 
-			if (query_p)
+			if (requests_p -> scrs_requests_table_p)
 				{
-					COToolData tool_data;
+					requests_p -> scrs_api_url_s = api_url_s;
+
+					return true;
+				}
+
+			FreeLinkedList (requests_p -> scrs_requests_p);
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate scale class requests");
+
+	return false;
+}
+
+
+static void ClearScaleClassRequests (ScaleClassRequests *requests_p)
+{
+	/* The table's keys belong to the requests so free it first */
+	FreeHashTable (requests_p -> scrs_requests_table_p);
+	FreeLinkedList (requests_p -> scrs_requests_p);
+}
 
-					tool_data.cotd_service_data_p = data_p;
-					tool_data.cotd_query_p = query_p;
-					tool_data.cotd_curl_p = curl_tool_p;
-					tool_data.cotd_query_key_s = "variable.so:sameAs";
 
-					if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE]))
+static ScaleClassRequest *AllocateScaleClassRequest (const char *variable_url_s, const char *api_url_s)
+{
+	char *copied_variable_url_s = EasyCopyToNewString (variable_url_s);
+
+	if (copied_variable_url_s)
+		{
+			char *request_url_s = ConcatenateStrings (api_url_s, variable_url_s);
+
+			if (request_url_s)
+				{
+					ScaleClassRequest *request_p = (ScaleClassRequest *) AllocMemory (sizeof (ScaleClassRequest));
+
+					if (request_p)
 						{
-							status = ProcessMongoResults (data_p -> dftsd_mongo_p, NULL, NULL, UpdateScaleTerms, &tool_data);
+							InitListItem (& (request_p -> scr_node));
+
+							request_p -> scr_variable_url_s = copied_variable_url_s;
+							request_p -> scr_request_url_s = request_url_s;
+							request_p -> scr_curl_p = NULL;
+							request_p -> scr_response_p = NULL;
+							request_p -> scr_class_p = NULL;
+
+							return request_p;
 						}
 
-					json_decref (query_p);
+					FreeCopiedString (request_url_s);
 				}
 
-			FreeCurlTool (curl_tool_p);
+			FreeCopiedString (copied_variable_url_s);
 		}
 
-	return status;
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate scale class request for \"%s\"", variable_url_s);
+
+	return NULL;
 }
 
 
-static bool UpdateScaleTerms (const bson_t *document_p, void *data_p)
+static void FreeScaleClassRequest (ListItem *node_p)
+{
+	ScaleClassRequest *request_p = (ScaleClassRequest *) node_p;
+
+	if (request_p -> scr_curl_p)
+		{
+			curl_easy_cleanup (request_p -> scr_curl_p);
+		}
+
+	if (request_p -> scr_response_p)
+		{
+			FreeByteBuffer (request_p -> scr_response_p);
+		}
+
+	FreeCopiedString (request_p -> scr_variable_url_s);
+	FreeCopiedString (request_p -> scr_request_url_s);
+	FreeMemory (request_p);
+}
+
+
+/*
+ * The same variable can be in the database many times
+ * so only add a request for the first one.
+ */
+static bool AddScaleClassRequest (const bson_t *document_p, void *data_p)
 {
 	bool success_flag = false;
-	json_t *mv_json_p = ConvertBSONToJSON (document_p, NULL);
+	ScaleClassRequests *requests_p = (ScaleClassRequests *) data_p;
+	bson_iter_t iter;
+	bson_iter_t url_iter;
 
-	if (mv_json_p)
+	if (bson_iter_init (&iter, document_p) && bson_iter_find_descendant (&iter, S_VARIABLE_URL_KEY_S, &url_iter) && BSON_ITER_HOLDS_UTF8 (&url_iter))
 		{
-			COToolData *tool_data_p = (COToolData *) data_p;
-			MeasuredVariable *var_p = GetMeasuredVariableFromJSON (mv_json_p, tool_data_p -> cotd_service_data_p);
+			const char *var_url_s = bson_iter_utf8 (&url_iter, NULL);
 
-			if (var_p)
+			/* All crop ontology variables begin with CO_ */
+			if (DoesStringStartWith (var_url_s, "CO_"))
 				{
-					const char *var_url_s = GetMeasuredVariableURL (var_p);
+					if (GetFromHashTable (requests_p -> scrs_requests_table_p, var_url_s))
+						{
+							success_flag = true;
+						}
+					else
+						{
+							ScaleClassRequest *request_p = AllocateScaleClassRequest (var_url_s, requests_p -> scrs_api_url_s);
+
+							if (request_p)
+								{
+									if (PutInHashTable (requests_p -> scrs_requests_table_p, request_p -> scr_variable_url_s, request_p))
+										{
+											LinkedListAddTail (requests_p -> scrs_requests_p, & (request_p -> scr_node));
+											success_flag = true;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add scale class request for \"%s\"", var_url_s);
+											FreeScaleClassRequest (& (request_p -> scr_node));
+										}
+								}
+						}
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Get the scale classes for the requests, running up to max_connections
+ * requests at once, and return how many were found.
+ */
+static size_t FetchScaleClasses (LinkedList *requests_p, const uint32 max_connections)
+{
+	size_t num_found = 0;
+	CURLM *multi_p = curl_multi_init ();
+
+	if (multi_p)
+		{
+			const uint32 max_active = (max_connections > 0) ? max_connections : 1;
+			ScaleClassRequest *next_p = (ScaleClassRequest *) (requests_p -> ll_head_p);
+			ScaleClassRequest *request_p = NULL;
+			uint32 num_active = 0;
+			bool success_flag = true;
 
-					if (var_url_s)
+			while (success_flag && ((next_p != NULL) || (num_active > 0)))
+				{
+					/* Keep max_active requests running */
+					while ((next_p != NULL) && (num_active < max_active))
 						{
-							/* All crop ontology variables begin with CO: */
-							if (DoesStringStartWith (var_url_s, "CO_"))
+							if (!SetScaleClassFromCache (next_p))
 								{
-									const ScaleClass *scale_class_p = GetScaleClass (var_url_s, tool_data_p -> cotd_curl_p);
+									CURL *curl_p = StartScaleClassRequest (next_p);
 
-									if (scale_class_p)
+									if (curl_p)
 										{
-											/* update the variable in the db */
-											json_t *scale_class_json_p = GetScaleClassAsEmbeddedJSON (scale_class_p, MV_SCALE_S);
+											CURLMcode mc = curl_multi_add_handle (multi_p, curl_p);
 
-											if (scale_class_json_p)
+											if (mc == CURLM_OK)
 												{
-													if (SetJSONString (tool_data_p -> cotd_query_p, tool_data_p -> cotd_query_key_s, var_url_s))
-														{
-															if (UpdateMongoDocumentsByJSON (tool_data_p -> cotd_service_data_p -> dftsd_mongo_p, tool_data_p -> cotd_query_p, scale_class_json_p, false))
-																{
-																	success_flag = true;
-																}
-														}
+													++ num_active;
+												}
+											else
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add request for \"%s\": \"%s\"", next_p -> scr_request_url_s, curl_multi_strerror (mc));
+													FinishScaleClassRequest (next_p, CURLE_FAILED_INIT);
+												}
+										}
+								}
 
-													json_decref (scale_class_json_p);
+							next_p = (ScaleClassRequest *) (next_p -> scr_node.ln_next_p);
+						}
+
+					if (num_active > 0)
+						{
+							int num_running = 0;
+							CURLMcode mc = curl_multi_perform (multi_p, &num_running);
+
+							if (mc == CURLM_OK)
+								{
+									CURLMsg *msg_p = NULL;
+									int num_msgs = 0;
+
+									while ((msg_p = curl_multi_info_read (multi_p, &num_msgs)) != NULL)
+										{
+											if (msg_p -> msg == CURLMSG_DONE)
+												{
+													CURL *curl_p = msg_p -> easy_handle;
+													const CURLcode res = msg_p -> data.result;
+													char *private_p = NULL;
+
+													curl_easy_getinfo (curl_p, CURLINFO_PRIVATE, &private_p);
+													curl_multi_remove_handle (multi_p, curl_p);
+													-- num_active;
+
+													request_p = (ScaleClassRequest *) private_p;
+													FinishScaleClassRequest (request_p, res);
 												}
 										}
+
+									if (num_active > 0)
+										{
+											mc = curl_multi_wait (multi_p, NULL, 0, 1000, NULL);
+										}
 								}
 
+							if (mc != CURLM_OK)
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to run scale class requests: \"%s\"", curl_multi_strerror (mc));
+									success_flag = false;
+								}
 						}
 
-					FreeMeasuredVariable (var_p);
+				}		/* while (success_flag && ((next_p != NULL) || (num_active > 0))) */
+
+
+			/* Remove any requests that were still running if we stopped early */
+			request_p = (ScaleClassRequest *) (requests_p -> ll_head_p);
+			while (request_p)
+				{
+					if (request_p -> scr_curl_p)
+						{
+							curl_multi_remove_handle (multi_p, request_p -> scr_curl_p);
+							FinishScaleClassRequest (request_p, CURLE_ABORTED_BY_CALLBACK);
+						}
+
+					if (request_p -> scr_class_p)
+						{
+							++ num_found;
+						}
+
+					request_p = (ScaleClassRequest *) (request_p -> scr_node.ln_next_p);
 				}
 
-			json_decref (mv_json_p);
+			curl_multi_cleanup (multi_p);
+		}		/* if (multi_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to initialise curl multi handle");
 		}
 
-	return success_flag;
+	return num_found;
 }
 
 
+static bool SetScaleClassFromCache (ScaleClassRequest *request_p)
+{
+	char *response_s = GetCachedHttpResponse (request_p -> scr_request_url_s);
 
+	if (response_s)
+		{
+			request_p -> scr_class_p = GetScaleClassFromResponse (response_s, request_p -> scr_request_url_s);
+			FreeCopiedString (response_s);
 
+			return true;
+		}
 
-
-/*
- * Iterate over each variable in db
- *
- * get https://cropontology.org/brapi/v1/variables/CO_321:0001199
- *
- * get result.scale.dataType
- *
- *
- */
+	return false;
+}
 
 
-static const ScaleClass *GetScaleClass (const char *variable_url_s, CurlTool *curl_p)
+static CURL *StartScaleClassRequest (ScaleClassRequest *request_p)
 {
-	const ScaleClass *class_p = NULL;
-	const char * const CO_API_URL_S = "https://cropontology.org/brapi/v1/variables/";
-	char *url_s = ConcatenateStrings (CO_API_URL_S, variable_url_s);
+	request_p -> scr_response_p = AllocateByteBuffer (1024);
 
-	if (url_s)
+	if (request_p -> scr_response_p)
 		{
-			if (SetUriForCurlTool (curl_p, url_s))
+			CURL *curl_p = curl_easy_init ();
+
+			if (curl_p)
 				{
-					CURLcode res;
+					curl_easy_setopt (curl_p, CURLOPT_URL, request_p -> scr_request_url_s);
+					curl_easy_setopt (curl_p, CURLOPT_FOLLOWLOCATION, 1L);
+					curl_easy_setopt (curl_p, CURLOPT_FAILONERROR, 1L);
+					curl_easy_setopt (curl_p, CURLOPT_TIMEOUT, 60L);
+					curl_easy_setopt (curl_p, CURLOPT_WRITEFUNCTION, AddToScaleClassResponse);
+					curl_easy_setopt (curl_p, CURLOPT_WRITEDATA, request_p -> scr_response_p);
+					curl_easy_setopt (curl_p, CURLOPT_PRIVATE, request_p);
 
-					ClearCurlToolData (curl_p);
+					request_p -> scr_curl_p = curl_p;
 
-					res = RunCurlTool (curl_p);
+					return curl_p;
+				}
 
-					if (res == CURLE_OK)
+			FreeByteBuffer (request_p -> scr_response_p);
+			request_p -> scr_response_p = NULL;
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set up request for \"%s\"", request_p -> scr_request_url_s);
+
+	return NULL;
+}
+
+
+static void FinishScaleClassRequest (ScaleClassRequest *request_p, CURLcode res)
+{
+	if (res == CURLE_OK)
+		{
+			const char *response_s = GetByteBufferData (request_p -> scr_response_p);
+
+			request_p -> scr_class_p = GetScaleClassFromResponse (response_s, request_p -> scr_request_url_s);
+
+			if (request_p -> scr_class_p)
+				{
+					AddHttpResponseToCache (request_p -> scr_request_url_s, response_s);
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get \"%s\": \"%s\"", request_p -> scr_request_url_s, curl_easy_strerror (res));
+		}
+
+	if (request_p -> scr_curl_p)
+		{
+			curl_easy_cleanup (request_p -> scr_curl_p);
+			request_p -> scr_curl_p = NULL;
+		}
+
+	if (request_p -> scr_response_p)
+		{
+			FreeByteBuffer (request_p -> scr_response_p);
+			request_p -> scr_response_p = NULL;
+		}
+}
+
+
+static size_t AddToScaleClassResponse (char *data_p, size_t size, size_t num_items, void *user_data_p)
+{
+	ByteBuffer *buffer_p = (ByteBuffer *) user_data_p;
+	const size_t total = size * num_items;
+
+	return AppendToByteBuffer (buffer_p, data_p, total) ? total : 0;
+}
+
+
+/*
+ * Update all of the variables whose scale classes were found with a single
+ * bulk write and return the number of distinct variables that were updated.
+ */
+static size_t WriteScaleClasses (LinkedList *requests_p, FieldTrialServiceData *data_p)
+{
+	size_t num_written = 0;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE]))
+		{
+			bson_t *bulk_opts_p = BCON_NEW ("ordered", BCON_BOOL (false));
+
+			if (bulk_opts_p)
+				{
+					mongoc_bulk_operation_t *bulk_p = mongoc_collection_create_bulk_operation_with_opts (data_p -> dftsd_mongo_p -> mt_collection_p, bulk_opts_p);
+
+					if (bulk_p)
 						{
-							const char *data_s = GetCurlToolData (curl_p);
+							ScaleClassRequest *request_p = (ScaleClassRequest *) (requests_p -> ll_head_p);
+							size_t num_ops = 0;
 
-							if (data_s)
+							while (request_p)
 								{
-									json_error_t err;
-									json_t *res_p = json_loads (data_s, 0, &err);
-
-									if (res_p)
+									if (request_p -> scr_class_p)
 										{
-											class_p = GetScaleDatatype (res_p);
+											json_t *scale_class_json_p = GetScaleClassAsEmbeddedJSON (request_p -> scr_class_p, MV_SCALE_S);
 
-											if (!class_p)
+											if (scale_class_json_p)
 												{
+													bson_t *scale_class_p = ConvertJSONToBSON (scale_class_json_p);
 
-												}		/* if (!class_p) */
+													if (scale_class_p)
+														{
+															bson_t *selector_p = BCON_NEW (S_VARIABLE_URL_KEY_S, BCON_UTF8 (request_p -> scr_variable_url_s));
+
+															if (selector_p)
+																{
+																	bson_t *update_p = BCON_NEW ("$set", BCON_DOCUMENT (scale_class_p));
 
-											json_decref (res_p);
-										}		/* if (res_p) */
+																	if (update_p)
+																		{
+																			bson_error_t error;
+
+																			if (mongoc_bulk_operation_update_many_with_opts (bulk_p, selector_p, update_p, NULL, &error))
+																				{
+																					++ num_ops;
+																				}
+																			else
+																				{
+																					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add update for \"%s\": \"%s\"", request_p -> scr_variable_url_s, error.message);
+																				}
+
+																			bson_destroy (update_p);
+																		}
+
+																	bson_destroy (selector_p);
+																}
+
+															bson_destroy (scale_class_p);
+														}		/* if (scale_class_p) */
+
+													json_decref (scale_class_json_p);
+												}		/* if (scale_class_json_p) */
+
+										}		/* if (request_p -> scr_class_p) */
+
+									request_p = (ScaleClassRequest *) (request_p -> scr_node.ln_next_p);
+								}		/* while (request_p) */
+
+							if (num_ops > 0)
+								{
+									bson_t reply;
+									bson_error_t error;
+
+									if (mongoc_bulk_operation_execute (bulk_p, &reply, &error) != 0)
+										{
+											num_written = num_ops;
+										}
 									else
 										{
+											/*
+											 * With an unordered bulk write, the updates that
+											 * didn't fail are still written
+											 */
+											const size_t num_failed = CountBulkWriteErrors (&reply);
 
-										}
+											PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, &reply, "Bulk update of " SIZET_FMT " scale classes failed: \"%s\"", num_ops, error.message);
 
-								}		/* if (data_s) */
-							else
-								{
+											if ((num_failed > 0) && (num_failed < num_ops))
+												{
+													num_written = num_ops - num_failed;
+												}
+										}
 
-								}
+									bson_destroy (&reply);
+								}		/* if (num_ops > 0) */
 
-						}		/* if (res == CURLE_OK) */
+							mongoc_bulk_operation_destroy (bulk_p);
+						}		/* if (bulk_p) */
 					else
 						{
-
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create bulk operation for scale classes");
 						}
-				}		/* if (SetUriForCurlTool (curl_p, url_s)) */
-			else
+
+					bson_destroy (bulk_opts_p);
+				}		/* if (bulk_opts_p) */
+
+		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE])) */
+
+	return num_written;
+}
+
+
+static size_t CountBulkWriteErrors (const bson_t *reply_p)
+{
+	size_t num_errors = 0;
+	bson_iter_t iter;
+
+	if (bson_iter_init_find (&iter, reply_p, "writeErrors") && BSON_ITER_HOLDS_ARRAY (&iter))
+		{
+			bson_iter_t errors_iter;
+
+			if (bson_iter_recurse (&iter, &errors_iter))
 				{
+					while (bson_iter_next (&errors_iter))
+						{
+							++ num_errors;
+						}
+				}
+		}
+
+	return num_errors;
+}
+
+
+/*
+ * Get the scale class from a response such as
+ *
+ * https://cropontology.org/brapi/v1/variables/CO_321:0001199
+ *
+ * which is in result.scale.dataType
+ */
+static const ScaleClass *GetScaleClassFromResponse (const char *response_s, const char *url_s)
+{
+	const ScaleClass *class_p = NULL;
+	json_error_t err;
+	json_t *res_p = json_loads (response_s, 0, &err);
 
+	if (res_p)
+		{
+			class_p = GetScaleDatatype (res_p);
+
+			if (!class_p)
+				{
+					PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, res_p, "Failed to get scale class from \"%s\"", url_s);
 				}
 
-			FreeCopiedString (url_s);
-		}		/* if (url_s) */
+			json_decref (res_p);
+		}
 	else
 		{
-
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to load response from \"%s\" as JSON, err at %d, %d", url_s, err.line, err.column);
 		}
 
 	return class_p;
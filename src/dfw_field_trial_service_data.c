@@ -25,6 +25,9 @@
 
 #include "measured_variable.h"
 #include "treatment.h"
+#include "dfw_util.h"
+#include "shared_service_context.h"
+#include "http_response_cache.h"
 
 #include "jansson.h"
 
@@ -72,10 +75,6 @@ static const char *S_TYPE_DESCRIPTIONS_SS [DFTD_NUM_TYPES] =
 };
 
 
-static MeasuredVariableNode *GetCachedMeasuredVariableNodeByName (const FieldTrialServiceData *data_p, const char *name_s);
-
-
-
 FieldTrialServiceData *AllocateFieldTrialServiceData (void)
 {
 	FieldTrialServiceData *data_p = (FieldTrialServiceData *) AllocMemory (sizeof (FieldTrialServiceData));
@@ -90,7 +89,11 @@ FieldTrialServiceData *AllocateFieldTrialServiceData (void)
 
 			data_p -> dftsd_plots_uploads_path_s = NULL;
 
-			data_p -> dftsd_measured_variables_cache_p = NULL;
+			data_p -> dftsd_context_p = NULL;
+			data_p -> dftsd_context_pin_p = NULL;
+			data_p -> dftsd_use_measured_variables_cache_flag = false;
+			data_p -> dftsd_warm_measured_variables_cache_flag = false;
+			data_p -> dftsd_use_treatments_cache_flag = false;
 
 			data_p -> dftsd_view_study_url_s = NULL;
 			data_p -> dftsd_view_trial_url_s = NULL;
@@ -100,8 +103,6 @@ FieldTrialServiceData *AllocateFieldTrialServiceData (void)
 
 			data_p -> dftsd_latex_commmand_s = NULL;
 
-			data_p -> dftsd_treatments_cache_p = NULL;
-
 			data_p -> dftsd_assets_path_s = NULL;
 
 			data_p -> dftsd_fd_url_s = NULL;
@@ -120,6 +121,54 @@ FieldTrialServiceData *AllocateFieldTrialServiceData (void)
 
 			data_p -> dftsd_grassroots_marti_search_url_s = NULL;
 
+			data_p -> dftsd_marti_cache_ttl = 24 * 60 * 60;
+
+			data_p -> dftsd_marti_cell_size = 0.01;
+
+			data_p -> dftsd_marti_cache_max_entries = 4096;
+
+			data_p -> dftsd_geocoder_s = NULL;
+
+			data_p -> dftsd_geocode_cache_flag = true;
+
+			data_p -> dftsd_geocode_max_connections = 2;
+
+			data_p -> dftsd_geocode_requests_per_second = 1.0;
+
+			data_p -> dftsd_post_save_num_workers = 0;
+
+			data_p -> dftsd_post_save_delay = 0;
+
+			data_p -> dftsd_post_save_stale_time = 3600;
+
+			data_p -> dftsd_study_memory_cache_size = 0;
+
+			data_p -> dftsd_option_list_cache_ttl = 60;
+
+			data_p -> dftsd_reindex_num_workers = 0;
+
+			data_p -> dftsd_reindex_checkpoint_path_s = NULL;
+
+			data_p -> dftsd_revision_snapshot_interval = 0;
+
+			data_p -> dftsd_study_arena_block_size = 0;
+
+			data_p -> dftsd_aggregate_statistics_flag = false;
+
+			data_p -> dftsd_verify_statistics_flag = false;
+
+			data_p -> dftsd_asset_cache_max_age = 3600;
+
+			data_p -> dftsd_latex_max_jobs = 2;
+
+			data_p -> dftsd_latex_wait_timeout = 120;
+
+			data_p -> dftsd_latex_run_timeout = 300;
+
+			data_p -> dftsd_crop_ontology_brapi_url_s = "https://cropontology.org/brapi/v1/variables/";
+
+			data_p -> dftsd_crop_ontology_max_connections = 8;
+
 			return data_p;
 		}
 
@@ -129,77 +178,186 @@ FieldTrialServiceData *AllocateFieldTrialServiceData (void)
 
 bool EnableMeasuredVariablesCache (FieldTrialServiceData *data_p)
 {
-	bool success_flag = true;
-
-	if (! (data_p -> dftsd_measured_variables_cache_p))
+	/*
+	 * Without a pin, we can't safely borrow entries from the shared cache
+	 */
+	if ((data_p -> dftsd_context_pin_p) && (EnableSharedMeasuredVariablesCache (data_p -> dftsd_context_p)))
 		{
-			data_p -> dftsd_measured_variables_cache_p = AllocateLinkedList (FreeMeasuredVariableNode);
-
-			if (! (data_p -> dftsd_measured_variables_cache_p))
-				{
-					success_flag = false;
-				}
+			data_p -> dftsd_use_measured_variables_cache_flag = true;
 		}
 
-	return success_flag;
+	return data_p -> dftsd_use_measured_variables_cache_flag;
 }
 
 
 void ClearMeasuredVariablesCache (FieldTrialServiceData *data_p)
 {
-	if (data_p -> dftsd_measured_variables_cache_p)
+	if (HasMeasuredVariableCache (data_p))
 		{
-			ClearLinkedList (data_p -> dftsd_measured_variables_cache_p);
+			ClearSharedMeasuredVariablesCache (data_p -> dftsd_context_p);
 		}
 }
 
 
-
-bool EnableTreatmentsCache (FieldTrialServiceData *data_p)
+bool WarmMeasuredVariablesCache (FieldTrialServiceData *data_p)
 {
-	bool success_flag = true;
+	bool success_flag = false;
 
-	if (! (data_p -> dftsd_treatments_cache_p))
+	if (HasMeasuredVariableCache (data_p))
 		{
-			data_p -> dftsd_treatments_cache_p = AllocateLinkedList (FreeTreatmentNode);
+			uint32 epoch = 0;
 
-			if (! (data_p -> dftsd_treatments_cache_p))
+			/*
+			 * The cache is shared so only one service needs to fill
+			 * it. If another one already has done or is doing so,
+			 * any misses are looked up individually.
+			 */
+			if (!BeginWarmingSharedMeasuredVariablesCache (data_p -> dftsd_context_p, &epoch))
 				{
-					success_flag = false;
+					success_flag = true;
 				}
-		}
+			else
+				{
+					/*
+					 * Use our own MongoTool so that the service's one is left
+					 * on whichever collection it is currently using
+					 */
+					MongoTool *tool_p = GetPooledMongoTool (data_p -> dftsd_context_p);
+
+					if (!tool_p)
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get MongoTool to warm measured variables cache");
+						}
+					else if (SetMongoToolCollection (tool_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE]))
+						{
+							bson_t *query_p = bson_new ();
+
+							if (query_p)
+								{
+									json_t *results_p = GetAllMongoResultsAsJSON (tool_p, query_p, NULL);
+
+									if (results_p)
+										{
+											size_t i;
+											json_t *entry_p;
+											size_t num_added = 0;
+
+											json_array_foreach (results_p, i, entry_p)
+												{
+													MeasuredVariable *mv_p = GetMeasuredVariableFromJSON (entry_p, data_p);
+
+													if (mv_p)
+														{
+															if (AddMeasuredVariableToCache (data_p, mv_p, MF_SHALLOW_COPY))
+																{
+																	++ num_added;
+																}
+															else
+																{
+																	FreeMeasuredVariable (mv_p);
+																}
+														}
+													else
+														{
+															PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, entry_p, "GetMeasuredVariableFromJSON () failed when warming cache");
+														}
+												}
+
+											PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Added " SIZET_FMT " of " SIZET_FMT " measured variables to cache", num_added, json_array_size (results_p));
+
+											success_flag = true;
+											json_decref (results_p);
+										}		/* if (results_p) */
+									else
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get measured variables to warm cache");
+										}
+
+									bson_destroy (query_p);
+								}		/* if (query_p) */
+
+						}		/* else if (SetMongoToolCollection (tool_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE])) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE]);
+						}
+
+					if (tool_p)
+						{
+							ReleasePooledMongoTool (data_p -> dftsd_context_p, tool_p);
+						}
+
+					/*
+					 * Only mark the cache as warm once it has been filled
+					 */
+					EndWarmingSharedMeasuredVariablesCache (data_p -> dftsd_context_p, epoch, success_flag);
+				}
+
+		}		/* if (HasMeasuredVariableCache (data_p)) */
 
 	return success_flag;
 }
 
 
-void ClearTreatmentsCache (FieldTrialServiceData *data_p)
+void RefreshSharedCachesPin (FieldTrialServiceData *data_p)
 {
-	if (data_p -> dftsd_treatments_cache_p)
+	if (data_p -> dftsd_context_pin_p)
 		{
-			ClearLinkedList (data_p -> dftsd_treatments_cache_p);
+			RefreshSharedServiceContextPin (data_p -> dftsd_context_p, data_p -> dftsd_context_pin_p);
 		}
+
+	/* We're between units of work so this is a good time to refill the cache */
+	RewarmMeasuredVariablesCacheIfNeeded (data_p);
 }
 
 
+void InvalidateMeasuredVariablesCaches (void)
+{
+	ClearAllSharedMeasuredVariablesCaches ();
+}
 
-void FreeFieldTrialServiceData (FieldTrialServiceData *data_p)
+
+
+bool EnableTreatmentsCache (FieldTrialServiceData *data_p)
 {
-	if (data_p -> dftsd_mongo_p)
+	/*
+	 * Without a pin, we can't safely borrow entries from the shared cache
+	 */
+	if ((data_p -> dftsd_context_pin_p) && (EnableSharedTreatmentsCache (data_p -> dftsd_context_p)))
 		{
-			FreeMongoTool (data_p -> dftsd_mongo_p);
+			data_p -> dftsd_use_treatments_cache_flag = true;
 		}
 
-	if (data_p -> dftsd_measured_variables_cache_p)
+	return data_p -> dftsd_use_treatments_cache_flag;
+}
+
+
+void ClearTreatmentsCache (FieldTrialServiceData *data_p)
+{
+	if (HasTreatmentCache (data_p))
 		{
-			FreeLinkedList (data_p -> dftsd_measured_variables_cache_p);
+			ClearSharedTreatmentsCache (data_p -> dftsd_context_p);
 		}
+}
 
-	if (data_p -> dftsd_treatments_cache_p)
+
+
+void FreeFieldTrialServiceData (FieldTrialServiceData *data_p)
+{
+	if (data_p -> dftsd_context_p)
 		{
-			FreeLinkedList (data_p -> dftsd_treatments_cache_p);
-		}
+			if (data_p -> dftsd_mongo_p)
+				{
+					ReleasePooledMongoTool (data_p -> dftsd_context_p, data_p -> dftsd_mongo_p);
+				}
 
+			if (data_p -> dftsd_context_pin_p)
+				{
+					ReleaseSharedServiceContextPin (data_p -> dftsd_context_p, data_p -> dftsd_context_pin_p);
+				}
+
+			ReleaseSharedServiceContext (data_p -> dftsd_context_p);
+		}
 
 	FreeMemory (data_p);
 }
@@ -214,11 +372,28 @@ bool ConfigureFieldTrialService (FieldTrialServiceData *data_p, GrassrootsServer
 
 	if (data_p -> dftsd_database_s)
 		{
-			if ((data_p -> dftsd_mongo_p = AllocateMongoTool (NULL, grassroots_p -> gs_mongo_manager_p)) != NULL)
+			/*
+			 * All of the services using this database share
+			 * their MongoTools and caches
+			 */
+			if ((data_p -> dftsd_context_p = AcquireSharedServiceContext (data_p -> dftsd_database_s, grassroots_p)) != NULL)
 				{
-					if (SetMongoToolDatabase (data_p -> dftsd_mongo_p, data_p -> dftsd_database_s))
+					/*
+					 * If this fails, the service still works but won't use the shared caches
+					 */
+					data_p -> dftsd_context_pin_p = PinSharedServiceContext (data_p -> dftsd_context_p);
+
+					if ((data_p -> dftsd_mongo_p = GetPooledMongoTool (data_p -> dftsd_context_p)) != NULL)
 						{
 							bool enable_db_cache_flag = false;
+							const json_t *post_save_config_p = NULL;
+							const json_t *reindex_config_p = NULL;
+							const json_t *revisions_config_p = NULL;
+							const json_t *statistics_config_p = NULL;
+							const json_t *latex_config_p = NULL;
+							const json_t *crop_ontology_config_p = NULL;
+							const json_t *marti_cache_config_p = NULL;
+							const json_t *geocoding_config_p = NULL;
 							const char * const BACKUP_SUFFIX_S = "_backup";
 							success_flag = true;
 
@@ -277,6 +452,259 @@ bool ConfigureFieldTrialService (FieldTrialServiceData *data_p, GrassrootsServer
 
 							data_p -> dftsd_grassroots_marti_search_url_s = GetJSONString (service_config_p, "grassroots_marti_service_url");
 
+							/*
+							 * How are the MARTi samples near each Study cached?
+							 */
+							marti_cache_config_p = json_object_get (service_config_p, "marti_cache");
+
+							if (marti_cache_config_p)
+								{
+									const json_t *cell_size_p = json_object_get (marti_cache_config_p, "cell_size");
+									json_int_t i = 0;
+
+									if (GetJSONInteger (marti_cache_config_p, "ttl", &i))
+										{
+											data_p -> dftsd_marti_cache_ttl = (i > 0) ? (uint32) i : 0;
+										}
+
+									if (GetJSONInteger (marti_cache_config_p, "max_entries", &i))
+										{
+											data_p -> dftsd_marti_cache_max_entries = (i > 0) ? (uint32) i : 0;
+										}
+
+									if (json_is_number (cell_size_p) && (json_number_value (cell_size_p) > 0.0))
+										{
+											data_p -> dftsd_marti_cell_size = json_number_value (cell_size_p);
+										}
+								}
+
+
+							/*
+							 * How are addresses geocoded?
+							 */
+							geocoding_config_p = json_object_get (service_config_p, "geocoding");
+
+							if (geocoding_config_p)
+								{
+									const json_t *rate_p = json_object_get (geocoding_config_p, "requests_per_second");
+									json_int_t i = 0;
+
+									data_p -> dftsd_geocoder_s = GetJSONString (geocoding_config_p, "geocoder");
+
+									GetJSONBoolean (geocoding_config_p, "use_cache", & (data_p -> dftsd_geocode_cache_flag));
+
+									if (GetJSONInteger (geocoding_config_p, "max_connections", &i))
+										{
+											data_p -> dftsd_geocode_max_connections = (i > 1) ? (uint32) i : 1;
+										}
+
+									if (json_is_number (rate_p))
+										{
+											const double64 rate = json_number_value (rate_p);
+
+											data_p -> dftsd_geocode_requests_per_second = (rate > 0.0) ? rate : 0.0;
+										}
+								}
+
+
+							/*
+							 * Are we rebuilding the derived files for saved studies in the background?
+							 */
+							post_save_config_p = json_object_get (service_config_p, "post_save_queue");
+
+							if (post_save_config_p)
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (post_save_config_p, "workers", &i))
+										{
+											if (i > 0)
+												{
+													data_p -> dftsd_post_save_num_workers = (uint32) i;
+												}
+										}
+
+									if (GetJSONInteger (post_save_config_p, "delay", &i))
+										{
+											if (i > 0)
+												{
+													data_p -> dftsd_post_save_delay = (uint32) i;
+												}
+										}
+
+									if (GetJSONInteger (post_save_config_p, "stale_time", &i))
+										{
+											if (i > 0)
+												{
+													data_p -> dftsd_post_save_stale_time = (uint32) i;
+												}
+										}
+								}
+
+							/*
+							 * How many megabytes of studies to keep in memory?
+							 */
+							if (json_object_get (service_config_p, "study_memory_cache_size"))
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (service_config_p, "study_memory_cache_size", &i))
+										{
+											data_p -> dftsd_study_memory_cache_size = (i > 0) ? ((size_t) i) * 1024 * 1024 : 0;
+										}
+								}
+
+							/*
+							 * How many seconds to keep the parameter option lists for?
+							 */
+							if (json_object_get (service_config_p, "option_list_cache_ttl"))
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (service_config_p, "option_list_cache_ttl", &i))
+										{
+											data_p -> dftsd_option_list_cache_ttl = (i > 0) ? (uint32) i : 0;
+										}
+								}
+
+							/*
+							 * Are we reindexing the studies with a pool of workers?
+							 */
+							reindex_config_p = json_object_get (service_config_p, "reindex");
+
+							if (reindex_config_p)
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (reindex_config_p, "workers", &i))
+										{
+											if (i > 0)
+												{
+													data_p -> dftsd_reindex_num_workers = (uint32) i;
+												}
+										}
+
+									data_p -> dftsd_reindex_checkpoint_path_s = GetJSONString (reindex_config_p, "checkpoint_file");
+								}
+
+							/*
+							 * Are we storing the previous versions of Studies and Plots as deltas?
+							 */
+							revisions_config_p = json_object_get (service_config_p, "revisions");
+
+							if (revisions_config_p)
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (revisions_config_p, "snapshot_interval", &i))
+										{
+											if (i > 0)
+												{
+													data_p -> dftsd_revision_snapshot_interval = (uint32) i;
+												}
+										}
+								}
+
+							/*
+							 * How many kilobytes at a time to allocate read-only Study plots in?
+							 */
+							if (json_object_get (service_config_p, "study_arena_block_size"))
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (service_config_p, "study_arena_block_size", &i))
+										{
+											data_p -> dftsd_study_arena_block_size = (i > 0) ? ((size_t) i) * 1024 : 0;
+										}
+								}
+
+							/*
+							 * How are the phenotype statistics calculated?
+							 */
+							statistics_config_p = json_object_get (service_config_p, "statistics");
+
+							if (statistics_config_p)
+								{
+									GetJSONBoolean (statistics_config_p, "use_aggregation", & (data_p -> dftsd_aggregate_statistics_flag));
+									GetJSONBoolean (statistics_config_p, "verify", & (data_p -> dftsd_verify_statistics_flag));
+								}
+
+							/*
+							 * How long can downloaded handbook images be used before checking them again?
+							 */
+							if (json_object_get (service_config_p, "asset_cache_max_age"))
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (service_config_p, "asset_cache_max_age", &i))
+										{
+											data_p -> dftsd_asset_cache_max_age = (i > 0) ? (uint32) i : 0;
+										}
+								}
+
+							/*
+							 * How many copies of pdflatex can run at once and for how long?
+							 */
+							latex_config_p = json_object_get (service_config_p, "latex");
+
+							if (latex_config_p)
+								{
+									json_int_t i = 0;
+
+									if (GetJSONInteger (latex_config_p, "max_jobs", &i))
+										{
+											data_p -> dftsd_latex_max_jobs = (i > 0) ? (uint32) i : 0;
+										}
+
+									if (GetJSONInteger (latex_config_p, "wait_timeout", &i))
+										{
+											data_p -> dftsd_latex_wait_timeout = (i > 0) ? (uint32) i : 0;
+										}
+
+									if (GetJSONInteger (latex_config_p, "run_timeout", &i))
+										{
+											data_p -> dftsd_latex_run_timeout = (i > 0) ? (uint32) i : 0;
+										}
+								}
+
+							/*
+							 * Where are Crop Ontology responses fetched from and cached?
+							 */
+							crop_ontology_config_p = json_object_get (service_config_p, "crop_ontology");
+
+							if (crop_ontology_config_p)
+								{
+									const char *value_s = GetJSONString (crop_ontology_config_p, "brapi_url");
+									json_int_t i = 0;
+
+									if (value_s)
+										{
+											data_p -> dftsd_crop_ontology_brapi_url_s = value_s;
+										}
+
+									if (GetJSONInteger (crop_ontology_config_p, "max_connections", &i))
+										{
+											data_p -> dftsd_crop_ontology_max_connections = (i > 0) ? (uint32) i : 1;
+										}
+
+									value_s = GetJSONString (crop_ontology_config_p, "cache_path");
+
+									if (value_s)
+										{
+											uint32 max_age = 7 * 24 * 60 * 60;
+
+											if (GetJSONInteger (crop_ontology_config_p, "cache_max_age", &i))
+												{
+													max_age = (i > 0) ? (uint32) i : 0;
+												}
+
+											if (!SetHttpResponseCacheConfig (value_s, max_age))
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to set up crop ontology cache in \"%s\"", value_s);
+												}
+										}
+								}
+
 
 							* ((data_p -> dftsd_collection_ss) + DFTD_PROGRAMME) = DFT_PROGRAM_S;
 							* ((data_p -> dftsd_collection_ss) + DFTD_FIELD_TRIAL) = DFT_FIELD_TRIALS_S;
@@ -316,7 +744,23 @@ bool ConfigureFieldTrialService (FieldTrialServiceData *data_p, GrassrootsServer
 
 							if (enable_db_cache_flag)
 								{
-									if (!EnableMeasuredVariablesCache (data_p))
+									if (EnableMeasuredVariablesCache (data_p))
+										{
+											/*
+											 * Should we load all of the measured variables now
+											 * rather than one at a time as they are needed?
+											 */
+											GetJSONBoolean (service_config_p, "warm_mv_cache", & (data_p -> dftsd_warm_measured_variables_cache_flag));
+
+											if (data_p -> dftsd_warm_measured_variables_cache_flag)
+												{
+													if (!WarmMeasuredVariablesCache (data_p))
+														{
+															PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to warm measured variable cache");
+														}
+												}
+										}
+									else
 										{
 											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to enable measured variable cache");
 										}
@@ -336,13 +780,13 @@ bool ConfigureFieldTrialService (FieldTrialServiceData *data_p, GrassrootsServer
 						}
 					else
 						{
-							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set db to \"%s\"", data_p -> dftsd_database_s);
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get MongoTool for \"%s\"", data_p -> dftsd_database_s);
 						}
 
-				}		/* if ((data_p -> dftsd_mongo_p = AllocateMongoTool (NULL, grassroots_p -> gs_mongo_manager_p)) != NULL) */
+				}		/* if ((data_p -> dftsd_context_p = AcquireSharedServiceContext (data_p -> dftsd_database_s, grassroots_p)) != NULL) */
 			else
 				{
-					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate MongoTool");
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get shared service context for \"%s\"", data_p -> dftsd_database_s);
 				}
 
 
@@ -417,21 +861,9 @@ const char *GetImageForDatatype (const FieldTrialServiceData *data_p, const char
 
 MeasuredVariable *GetCachedMeasuredVariableById (FieldTrialServiceData *data_p, const char *mv_id_s)
 {
-	if (data_p -> dftsd_measured_variables_cache_p)
+	if (HasMeasuredVariableCache (data_p))
 		{
-			MeasuredVariableNode *node_p = (MeasuredVariableNode *) (data_p -> dftsd_measured_variables_cache_p -> ll_head_p);
-
-			while (node_p)
-				{
-					if (strcmp (node_p -> mvn_id_s, mv_id_s) == 0)
-						{
-							return (node_p -> mvn_measured_variable_p);
-						}
-					else
-						{
-							node_p = (MeasuredVariableNode *) (node_p -> mvn_node.ln_next_p);
-						}
-				}
+			return GetSharedCachedMeasuredVariableById (data_p -> dftsd_context_p, mv_id_s);
 		}
 
 	return NULL;
@@ -440,11 +872,9 @@ MeasuredVariable *GetCachedMeasuredVariableById (FieldTrialServiceData *data_p,
 
 MeasuredVariable *GetCachedMeasuredVariableByName (FieldTrialServiceData *data_p, const char *name_s)
 {
-	MeasuredVariableNode *node_p = GetCachedMeasuredVariableNodeByName (data_p, name_s);
-
-	if (node_p)
+	if (HasMeasuredVariableCache (data_p))
 		{
-			return (node_p -> mvn_measured_variable_p);
+			return GetSharedCachedMeasuredVariableByName (data_p -> dftsd_context_p, name_s);
 		}
 
 	return NULL;
@@ -454,69 +884,23 @@ MeasuredVariable *GetCachedMeasuredVariableByName (FieldTrialServiceData *data_p
 bool RemoveCachedMeasuredVariableByName (FieldTrialServiceData *data_p, const char *name_s)
 {
 	bool removed_flag = false;
-	MeasuredVariableNode *node_p = GetCachedMeasuredVariableNodeByName (data_p, name_s);
 
-	if (node_p)
+	if (HasMeasuredVariableCache (data_p))
 		{
-			LinkedListRemove (data_p -> dftsd_measured_variables_cache_p, & (node_p -> mvn_node));
-
-			FreeMeasuredVariableNode (& (node_p -> mvn_node));
-			removed_flag = true;
+			removed_flag = RemoveMeasuredVariableFromSharedCache (data_p -> dftsd_context_p, name_s);
 		}
 
 	return removed_flag;
 }
 
 
-
-static MeasuredVariableNode *GetCachedMeasuredVariableNodeByName (const FieldTrialServiceData *data_p, const char *name_s)
-{
-	if (data_p -> dftsd_measured_variables_cache_p)
-		{
-			MeasuredVariableNode *node_p = (MeasuredVariableNode *) (data_p -> dftsd_measured_variables_cache_p -> ll_head_p);
-
-			while (node_p)
-				{
-					const char *mv_name_s = GetMeasuredVariableName (node_p -> mvn_measured_variable_p);
-
-					if (strcmp (mv_name_s, name_s) == 0)
-						{
-							return node_p;
-						}
-					else
-						{
-							node_p = (MeasuredVariableNode *) (node_p -> mvn_node.ln_next_p);
-						}
-				}
-		}
-
-	return NULL;
-}
-
-
-
 bool AddMeasuredVariableToCache (FieldTrialServiceData *data_p, MeasuredVariable *mv_p, MEM_FLAG mf)
 {
-	bool success_flag = false;
-
-	if (data_p -> dftsd_measured_variables_cache_p)
-		{
-			MeasuredVariableNode *node_p = AllocateMeasuredVariableNode (mv_p, mf);
+	bool success_flag = true;
 
-			if (node_p)
-				{
-					LinkedListAddTail (data_p -> dftsd_measured_variables_cache_p, & (node_p -> mvn_node));
-					success_flag = true;
-				}
-			else
-				{
-					const char *name_s = GetMeasuredVariableName (mv_p);
-					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add \"%s\" to observations cache", name_s);
-				}
-		}
-	else
+	if (HasMeasuredVariableCache (data_p))
 		{
-			success_flag = true;
+			success_flag = AddMeasuredVariableToSharedCache (data_p -> dftsd_context_p, mv_p, mf);
 		}
 
 	return success_flag;
@@ -525,29 +909,16 @@ bool AddMeasuredVariableToCache (FieldTrialServiceData *data_p, MeasuredVariable
 
 bool HasMeasuredVariableCache (FieldTrialServiceData *data_p)
 {
-	return (data_p -> dftsd_measured_variables_cache_p != NULL);
+	return data_p -> dftsd_use_measured_variables_cache_flag;
 }
 
 
 
-
 Treatment *GetCachedTreatmentByURL (FieldTrialServiceData *data_p, const char *url_s)
 {
-	if (data_p -> dftsd_treatments_cache_p)
+	if (HasTreatmentCache (data_p))
 		{
-			TreatmentNode *node_p = (TreatmentNode *) (data_p -> dftsd_treatments_cache_p -> ll_head_p);
-
-			while (node_p)
-				{
-					if (strcmp (node_p -> tn_treatment_url_s, url_s) == 0)
-						{
-							return (node_p -> tn_treatment_p);
-						}
-					else
-						{
-							node_p = (TreatmentNode *) (node_p -> tn_node.ln_next_p);
-						}
-				}
+			return GetSharedCachedTreatmentByURL (data_p -> dftsd_context_p, url_s);
 		}
 
 	return NULL;
@@ -556,25 +927,11 @@ Treatment *GetCachedTreatmentByURL (FieldTrialServiceData *data_p, const char *u
 
 bool AddTreatmentToCache (FieldTrialServiceData *data_p, Treatment *treatment_p, MEM_FLAG mf)
 {
-	bool success_flag = false;
+	bool success_flag = true;
 
-	if (data_p -> dftsd_treatments_cache_p)
+	if (HasTreatmentCache (data_p))
 		{
-			TreatmentNode *node_p = AllocateTreatmentNode (treatment_p, mf);
-
-			if (node_p)
-				{
-					LinkedListAddTail (data_p -> dftsd_treatments_cache_p, & (node_p -> tn_node));
-					success_flag = true;
-				}
-			else
-				{
-					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add \"%s\" to observations cache", treatment_p -> tr_ontology_term_p -> st_url_s);
-				}
-		}
-	else
-		{
-			success_flag = true;
+			success_flag = AddTreatmentToSharedCache (data_p -> dftsd_context_p, treatment_p, mf);
 		}
 
 	return success_flag;
@@ -583,7 +940,7 @@ bool AddTreatmentToCache (FieldTrialServiceData *data_p, Treatment *treatment_p,
 
 bool HasTreatmentCache (FieldTrialServiceData *data_p)
 {
-	return (data_p -> dftsd_treatments_cache_p != NULL);
+	return data_p -> dftsd_use_treatments_cache_flag;
 }
 
 
@@ -637,3 +994,18 @@ char *GetFullCacheFilename (const char *name_s, const FieldTrialServiceData *dat
 }
 
 
+void RewarmMeasuredVariablesCacheIfNeeded (FieldTrialServiceData *data_p)
+{
+	if ((data_p -> dftsd_warm_measured_variables_cache_flag) && (HasMeasuredVariableCache (data_p)))
+		{
+			if (GetSharedMeasuredVariablesCacheState (data_p -> dftsd_context_p) == MVCS_COLD)
+				{
+					if (!WarmMeasuredVariablesCache (data_p))
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to rewarm measured variable cache");
+						}
+				}
+		}
+}
+
+
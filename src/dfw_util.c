@@ -20,6 +20,12 @@
  *      Author: billy
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
 #define ALLOCATE_DFW_UTIL_TAGS (1)
 #include "dfw_util.h"
 #include "streams.h"
@@ -27,6 +33,8 @@
 #include "string_utils.h"
 #include "schema_keys.h"
 #include "math_utils.h"
+#include "study_memory_cache.h"
+#include "revision_store.h"
 
 
 #ifdef _DEBUG
@@ -41,7 +49,9 @@ static char *GetCacheFilename (const char *id_s, const FieldTrialServiceData *da
 static char *GetIdBasedFilename (const char *id_s, const char *directory_s, const char *suffix_s);
 
 
-static bool RunVersionSearch (const char * const collection_s, const char * const key_s, const char * const id_s, const char *timestamp_s, json_t *results_p, bson_t *extra_opts_p, const FieldTrialServiceData *data_p);
+
+
+static bool FillStringPointerHashBucket (HashBucket * const bucket_p, const void * const key_p, const void * const value_p);
 
 
 
@@ -99,11 +109,66 @@ bool CacheStudy (const char *id_s, const json_t *study_json_p, const FieldTrialS
 
 			if (filename_s)
 				{
-					int res = json_dump_file (study_json_p, filename_s, JSON_INDENT (2));
+					char *temp_filename_s = ConcatenateStrings (filename_s, ".XXXXXX");
+
+					if (temp_filename_s)
+						{
+							/*
+							 * Write to a temporary file and move it into place so that
+							 * readers never see a partially written Study and each
+							 * version of the file has its own inode, which the in-memory
+							 * cache uses to spot changes.
+							 */
+							int fd = mkstemp (temp_filename_s);
+
+							if (fd != -1)
+								{
+									FILE *out_f = NULL;
+
+									/* mkstemp () only gives the owner access but the file replaces one that others could read */
+									fchmod (fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+									out_f = fdopen (fd, "w");
+
+									if (out_f)
+										{
+											/*
+											 * The cached files are only ever read back by us, so don't
+											 * spend time and space on indenting them
+											 */
+											bool written_flag = (json_dumpf (study_json_p, out_f, JSON_COMPACT) == 0);
+
+											if (fclose (out_f) != 0)
+												{
+													written_flag = false;
+												}
 
-					if (res != 0)
+											if (written_flag && (rename (temp_filename_s, filename_s) == 0))
+												{
+													success_flag = true;
+
+													/*
+													 * Another process could write the file again before we
+													 * could record its details, so the in-memory copy is
+													 * reloaded from the file when it is next needed.
+													 */
+													RemoveStudyFromMemoryCache (id_s);
+												}
+										}
+									else
+										{
+											close (fd);
+										}
+
+									/* This does nothing if the file was renamed into place */
+									remove (temp_filename_s);
+								}		/* if (fd != -1) */
+
+							FreeCopiedString (temp_filename_s);
+						}		/* if (temp_filename_s) */
+
+					if (!success_flag)
 						{
-							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, study_json_p, "Failed to save cached study to \"%s\", error \"%s\" at [%d, %d]", filename_s);
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, study_json_p, "Failed to save cached study to \"%s\"", filename_s);
 						}
 
 					FreeCopiedString (filename_s);
@@ -120,6 +185,10 @@ bool CacheStudy (const char *id_s, const json_t *study_json_p, const FieldTrialS
 }
 
 
+/*
+ * The returned JSON may be shared with the in-memory cache so it
+ * must not be modified.
+ */
 json_t *GetCachedStudy (const char *id_s, const FieldTrialServiceData *data_p)
 {
 	json_t *study_json_p = NULL;
@@ -129,37 +198,34 @@ json_t *GetCachedStudy (const char *id_s, const FieldTrialServiceData *data_p)
 	 */
 	if (data_p -> dftsd_study_cache_path_s)
 		{
-			char *filename_s = NULL;
-
-			#if DFW_UTIL_DEBUG >= STM_LEVEL_FINE
-			PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "Checking for cached study \"%s\" in \"%s\"", id_s, data_p -> dftsd_study_cache_path_s);
-			#endif
-
-			filename_s = GetCacheFilename (id_s, data_p);
+			char *filename_s = GetCacheFilename (id_s, data_p);
 
 			if (filename_s)
 				{
-					if (IsPathValid (filename_s))
-						{
-							json_error_t err;
+					study_json_p = GetStudyFromMemoryCache (id_s, filename_s, data_p);
 
+					if (!study_json_p)
+						{
 							#if DFW_UTIL_DEBUG >= STM_LEVEL_FINE
-							PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "Loading cached study \"%s\" in \"%s\"", id_s, data_p -> dftsd_study_cache_path_s);
+							PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "Checking for cached study \"%s\" in \"%s\"", id_s, data_p -> dftsd_study_cache_path_s);
 							#endif
 
-							study_json_p = json_load_file (filename_s, 0, &err);
+							if (IsPathValid (filename_s))
+								{
+									#if DFW_UTIL_DEBUG >= STM_LEVEL_FINE
+									PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "Loading cached study \"%s\" in \"%s\"", id_s, data_p -> dftsd_study_cache_path_s);
+									#endif
 
-							if (!study_json_p)
+									study_json_p = LoadStudyIntoMemoryCache (id_s, filename_s, data_p);
+								}
+							else
 								{
-									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to load cached study from \"%s\", error \"%s\" at [%d, %d]", filename_s, err.text, err.line, err.column);
+									#if DFW_UTIL_DEBUG >= STM_LEVEL_FINE
+									PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "No cached study \"%s\" in \"%s\"", id_s, data_p -> dftsd_study_cache_path_s);
+									#endif
 								}
-						}
-					else
-						{
-							#if DFW_UTIL_DEBUG >= STM_LEVEL_FINE
-							PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "No cached study \"%s\" in \"%s\"", id_s, data_p -> dftsd_study_cache_path_s);
-							#endif
-						}
+
+						}		/* if (!study_json_p) */
 
 					FreeCopiedString (filename_s);
 				}		/* if (filename_s) */
@@ -183,7 +249,11 @@ json_t *GetCachedStudy (const char *id_s, const FieldTrialServiceData *data_p)
 bool ClearCachedStudy (const char *id_s, const FieldTrialServiceData *data_p)
 {
 	bool success_flag = true;
-	char *filename_s = GetCacheFilename (id_s, data_p);
+	char *filename_s = NULL;
+
+	RemoveStudyFromMemoryCache (id_s);
+
+	filename_s = GetCacheFilename (id_s, data_p);
 
 	if (filename_s)
 		{
@@ -382,61 +452,77 @@ void *GetDFWObjectByIdString (const char *object_id_s, FieldTrialDatatype collec
 
 
 
-static bool RunVersionSearch (const char * const collection_s, const char * const key_s, const char * const id_s, const char *timestamp_s, json_t *results_p, bson_t *extra_opts_p, const FieldTrialServiceData *data_p)
+json_t *GetDFWObjectsJSONByIdStrings (const char **ids_ss, const size_t num_ids, FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
 {
-	bool success_flag = false;
+	json_t *results_p = NULL;
+	bson_t *ids_p = bson_new ();
 
-	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, collection_s))
+	if (ids_p)
 		{
-			bson_t *query_p = bson_new ();
+			size_t i;
+			uint32 num_valid_ids = 0;
 
-			if (query_p)
+			for (i = 0; i < num_ids; ++ i, ++ ids_ss)
 				{
-					bson_oid_t oid;
+					if (bson_oid_is_valid (*ids_ss, strlen (*ids_ss)))
+						{
+							bson_oid_t oid;
+							char buffer_s [16];
+							const char *key_s = NULL;
 
-					bson_oid_init_from_string (&oid, id_s);
+							bson_oid_init_from_string (&oid, *ids_ss);
 
-					if (BSON_APPEND_OID (query_p, key_s, &oid))
+							bson_uint32_to_string (num_valid_ids, &key_s, buffer_s, sizeof (buffer_s));
+							BSON_APPEND_OID (ids_p, key_s, &oid);
+							++ num_valid_ids;
+						}
+					else
 						{
-							if ((timestamp_s == NULL) || (BSON_APPEND_UTF8 (query_p, MONGO_TIMESTAMP_S, timestamp_s)))
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "\"%s\" is not a valid oid", *ids_ss);
+						}
+				}
+
+			if (num_valid_ids > 0)
+				{
+					if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [collection_type]))
+						{
+							bson_t *query_p = BCON_NEW (MONGO_ID_S, "{", "$in", BCON_ARRAY (ids_p), "}");
+
+							if (query_p)
 								{
-									if (PopulateJSONWithAllMongoResults (data_p -> dftsd_mongo_p, query_p, extra_opts_p, results_p))
-										{
-											success_flag = true;
-										}		/* if (temp_p) */
-									else
+									results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, NULL);
+
+									if (!results_p)
 										{
-											PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Failed to get results searching for key \"%s\" value \"%s\"", key_s, id_s);
+											PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "GetAllMongoResultsAsJSON () failed for \"%s\"", data_p -> dftsd_collection_ss [collection_type]);
 										}
-								}
+
+									bson_destroy (query_p);
+								}		/* if (query_p) */
 							else
 								{
-									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to append query for key \"%s\" value \"%s\"", MONGO_TIMESTAMP_S, timestamp_s);
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create query for " UINT32_FMT " ids in \"%s\"", num_valid_ids, data_p -> dftsd_collection_ss [collection_type]);
 								}
-
-						}		/* if (BSON_APPEND_OID (query_p, MONGO_ID_S, &oid)) */
+						}
 					else
 						{
-							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to append query for key \"%s\" value \"%s\"", key_s, id_s);
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set collection to \"%s\"", data_p -> dftsd_collection_ss [collection_type]);
 						}
 
-					bson_destroy (query_p);
-				}		/* if (query_p) */
+				}		/* if (num_valid_ids > 0) */
 			else
 				{
-					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create query for key \"%s\" value \"%s\"", key_s, id_s);
+					results_p = json_array ();
 				}
 
-		}		/* if (SetMongoToolCollection (tool_p, data_p -> dftsd_collection_ss [DFTD_FIELD_TRIAL])) */
-	else
-		{
-			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set collection to \"%s\"", collection_s);
-		}	
+			bson_destroy (ids_p);
+		}		/* if (ids_p) */
 
-	return success_flag;
+	return results_p;
 }
 
 
+
 void *GetVersionedObjectFromResource (DataResource *resource_p, const NamedParameterType param_type, const char **original_id_ss, FieldTrialServiceData *ft_data_p,
 																			void *(*get_versioned_obj_fn) (const char *id_s, const char *timestamp_s, const ViewFormat vf, FieldTrialServiceData *ft_data_p),
 																			void *(*get_obj_by_id_fn) (const char *id_s, const ViewFormat vf, FieldTrialServiceData *ft_data_p))
@@ -533,39 +619,30 @@ void *GetVersionedObject (const char *id_s, const char *timestamp_s, const ViewF
 
 json_t *GetSpecificJSONVersionOfObject (const char *id_s, const char *timestamp_s, FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
 {
-	json_t *results_p = NULL;
+	/*
+	 * The version may be stored as a delta so let the
+	 * revision store rebuild it if needed
+	 */
+	json_t *version_p = GetRevisionOfObject (id_s, timestamp_s, collection_type, data_p);
 
-	if (bson_oid_is_valid (id_s, strlen (id_s)))
+	if (version_p)
 		{
-			results_p = json_array ();
+			json_t *results_p = json_array ();
 
 			if (results_p)
 				{
-					/*
-					 * Get the current version first
-					 */
-					if (RunVersionSearch (data_p -> dftsd_collection_ss [collection_type], MONGO_ID_S, id_s, timestamp_s, results_p, NULL, data_p))
+					if (json_array_append_new (results_p, version_p) == 0)
 						{
-						  bson_t *opts_p = BCON_NEW ("sort", "{", MONGO_TIMESTAMP_S, BCON_INT32 (-1), "}");
-
-							if (RunVersionSearch (data_p -> dftsd_backup_collection_ss [collection_type], DFT_BACKUPS_ID_KEY_S, id_s, timestamp_s, results_p, opts_p, data_p))
-								{
-									if (json_array_size (results_p) == 1)
-										{
-											return results_p;
-										}
-								}		/* if (RunVersionSearch (data_p -> dftsd_backup_collection_ss [collection_type], id_s, MONGO_ID_S, results_p, NULL, data_p)) */
-
-						}		/* if (RunVersionSearch (data_p -> dftsd_collection_ss [collection_type], id_s, MONGO_ID_S, results_p, NULL, data_p)) */
+							return results_p;
+						}
 
 					json_decref (results_p);
-				}		/* if (results_p) */
-
-		}		/* if (bson_oid_is_valid (field_trial_id_s, strlen (field_trial_id_s))) */
-	else
-		{
-			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" is not a valid oid", id_s);
-		}
+				}
+			else
+				{
+					json_decref (version_p);
+				}
+		}		/* if (version_p) */
 
 	return NULL;
 }
@@ -574,38 +651,7 @@ json_t *GetSpecificJSONVersionOfObject (const char *id_s, const char *timestamp_
 
 json_t *GetAllJSONVersionsOfObject (const char *id_s, FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
 {
-	json_t *results_p = NULL;
-
-	if (bson_oid_is_valid (id_s, strlen (id_s)))
-		{
-			results_p = json_array ();
-
-			if (results_p)
-				{
-					/*
-					 * Get the current version first
-					 */
-					if (RunVersionSearch (data_p -> dftsd_collection_ss [collection_type], MONGO_ID_S, id_s, NULL, results_p, NULL, data_p))
-						{
-						  bson_t *opts_p = BCON_NEW ("sort", "{", MONGO_TIMESTAMP_S, BCON_INT32 (-1), "}");
-
-							if (RunVersionSearch (data_p -> dftsd_backup_collection_ss [collection_type], DFT_BACKUPS_ID_KEY_S, id_s, NULL, results_p, opts_p, data_p))
-								{
-									return results_p;
-								}		/* if (RunVersionSearch (data_p -> dftsd_backup_collection_ss [collection_type], id_s, MONGO_ID_S, results_p, NULL, data_p)) */
-
-						}		/* if (RunVersionSearch (data_p -> dftsd_collection_ss [collection_type], id_s, MONGO_ID_S, results_p, NULL, data_p)) */
-
-					json_decref (results_p);
-				}		/* if (results_p) */
-
-		}		/* if (bson_oid_is_valid (field_trial_id_s, strlen (field_trial_id_s))) */
-	else
-		{
-			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" is not a valid oid", id_s);
-		}
-
-	return NULL;
+	return GetAllRevisionsOfObject (id_s, collection_type, data_p);
 }
 
 
@@ -1422,3 +1468,23 @@ bool SetFieldTrialServiceJobURL (ServiceJob *job_p, const char * const url_prefi
 	return success_flag;
 }
 
+
+
+HashTable *GetHashTableOfStringPointers (const uint32 initial_capacity, const uint8 load_percentage)
+{
+	return AllocateHashTable (initial_capacity, load_percentage, HashString, CreateShallowCopyHashBuckets, NULL, FillStringPointerHashBucket, CompareStringHashBuckets, NULL, NULL);
+}
+
+
+static bool FillStringPointerHashBucket (HashBucket * const bucket_p, const void * const key_p, const void * const value_p)
+{
+	/*
+	 * Both the key and the value are owned by the caller
+	 * so we just store the pointers.
+	 */
+	bucket_p -> hb_key_p = key_p;
+	bucket_p -> hb_value_p = value_p;
+
+	return true;
+}
+
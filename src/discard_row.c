@@ -36,10 +36,13 @@ Row *AllocateDiscardRow (bson_oid_t *id_p, const uint32 study_index, Plot *paren
 
 DiscardRow *GetDiscardRowFromJSON (const json_t *row_json_p, Plot *plot_p, const Study *study_p, const ViewFormat format, FieldTrialServiceData *data_p)
 {
-	DiscardRow *row_p = (DiscardRow *) AllocMemory (sizeof (DiscardRow));
+	StudyArena *arena_p = plot_p ? plot_p -> pl_arena_p : NULL;
+	DiscardRow *row_p = (DiscardRow *) AllocStudyMemory (arena_p, sizeof (DiscardRow));
 
 	if (row_p)
 		{
+			row_p -> dr_base.ro_arena_p = arena_p;
+
 			SetRowCallbackFunctions (& (row_p -> dr_base),
 															 NULL,
 															 AddDiscardRowToJSON,
@@ -51,7 +54,7 @@ DiscardRow *GetDiscardRowFromJSON (const json_t *row_json_p, Plot *plot_p, const
 					return row_p;
 				}
 
-			FreeMemory (row_p);
+			FreeStudyMemory (arena_p, row_p);
 		}
 
 	return NULL;
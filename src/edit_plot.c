@@ -30,6 +30,7 @@
 #include "plot.h"
 #include "row.h"
 #include "row_jobs.h"
+#include "row_update.h"
 
 #include "string_parameter.h"
 #include "string_array_parameter.h"
@@ -163,6 +164,8 @@ static void SetObservationError (ServiceJob *job_p, const char * const observati
 
 static void ReportJSONError (ServiceJob *job_p, const NamedParameterType *param_p, const char * const observation_field_s, const json_t *value_p, const char * const message_s);
 
+static void RemoveCachedStudy (const Row *row_p, FieldTrialServiceData *data_p);
+
 /*
  * API definitions
  */
@@ -335,6 +338,9 @@ static ServiceJobSet *RunPlotEditingService (Service *service_p, ParameterSet *p
 {
 	FieldTrialServiceData *data_p = (FieldTrialServiceData *) (service_p -> se_data_p);
 
+	/* Each observation looks up its MeasuredVariable so fill the cache first */
+	RewarmMeasuredVariablesCacheIfNeeded (data_p);
+
 	service_p -> se_jobs_p = AllocateSimpleServiceJobSet (service_p, NULL, "Submit Plot");
 
 	if (service_p -> se_jobs_p)
@@ -380,6 +386,12 @@ static bool RunForEditPlotParams (FieldTrialServiceData *data_p, ParameterSet *p
 							const char *accession_s = NULL;
 							bool new_material_flag = false;
 
+							/*
+							 * Keep the stored version of the row from before it is edited
+							 * so that we only need to save what has changed
+							 */
+							json_t *original_row_json_p = GetRowAsJSON (active_row_p, VF_STORAGE, NULL, data_p);
+
 							GetCurrentStringParameterValueFromParameterSet (param_set_p, S_ACCESSION.npt_name_s, &accession_s);
 
 							if (!IsStringEmpty (accession_s))
@@ -427,13 +439,12 @@ static bool RunForEditPlotParams (FieldTrialServiceData *data_p, ParameterSet *p
 
 													if (material_p)
 														{
-															if (active_sr_p -> sr_material_p)
-																{
-																	/*  remove accession */
-																	FreeMaterial (active_sr_p -> sr_material_p);
-																}
-
-															active_sr_p -> sr_material_p = material_p;
+															/*
+															 * The old material may be shared with the
+															 * Study's other rows so let the row decide
+															 * whether to free it
+															 */
+															SetStandardRowMaterial (active_sr_p, material_p, MF_SHALLOW_COPY);
 														}
 													else
 														{
@@ -477,36 +488,38 @@ static bool RunForEditPlotParams (FieldTrialServiceData *data_p, ParameterSet *p
 
 							if ((obs_status == OS_SUCCEEDED) || (obs_status == OS_PARTIALLY_SUCCEEDED) || (obs_status == OS_IDLE) || new_material_flag)
 								{
-									if (SavePlot (active_row_p -> ro_plot_p, data_p))
+									if (original_row_json_p && SaveRowChanges (active_row_p, original_row_json_p, data_p))
 										{
 											status = OS_SUCCEEDED;
 
-											/* remove the cached study */
-
-											if ((active_row_p -> ro_study_p) && (active_row_p -> ro_study_p -> st_id_p))
+											/*
+											 * Patch the row in the cached study rather than making
+											 * the next viewer rebuild the whole study
+											 */
+											if (!UpdateCachedStudyRow (active_row_p, data_p))
 												{
-													char *id_s = GetBSONOidAsString (active_row_p -> ro_study_p -> st_id_p);
-
-													if (id_s)
-														{
-															RemoveCachedStudyById (id_s, data_p);
-															FreeCopiedString (id_s);
-														}
-													else
-														{
-															PrintErrors(STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get study id as string for plot " UINT32_FMT " in Study \"%s\"", active_row_p -> ro_by_study_index, active_row_p -> ro_study_p -> st_name_s);
-														}
-
+													RemoveCachedStudy (active_row_p, data_p);
 												}
-
-
-
+										}
+									else
+										{
+											/*
+											 * The row's plot only has this row loaded so it can't
+											 * be saved as a whole instead
+											 */
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to save changes to row \"%s\"", row_id_s);
+											AddGeneralErrorMessageToServiceJob (job_p, "Failed to save changes to row");
 										}
 								}
 							else
 								{
 									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "ProcessObservations () failed");
 								}
+
+							if (original_row_json_p)
+								{
+									json_decref (original_row_json_p);
+								}
 						}
 				}		/* if (active_row_p) */
 			else
@@ -605,7 +618,7 @@ static OperationStatus ProcessObservations (StandardRow *row_p, ServiceJob *job_
 															metadata_p -> om_index = OB_DEFAULT_INDEX;
 
 
-															obs_status = AddObservationValueToStandardRowByParts (job_p, row_p, mv_p, metadata_p, key_s,
+															obs_status = AddObservationValueToStandardRowByParts (job_p, row_p, mv_p, mv_mem, metadata_p, key_s,
 																																										raw_value_p, corrected_value_p, *note_ss,
 																																										&free_measured_variable_flag, SetObservationError, NULL);
 
@@ -707,6 +720,26 @@ static OperationStatus ProcessObservations (StandardRow *row_p, ServiceJob *job_
 }
 
 
+static void RemoveCachedStudy (const Row *row_p, FieldTrialServiceData *data_p)
+{
+	if ((row_p -> ro_study_p) && (row_p -> ro_study_p -> st_id_p))
+		{
+			char *id_s = GetBSONOidAsString (row_p -> ro_study_p -> st_id_p);
+
+			if (id_s)
+				{
+					RemoveCachedStudyById (id_s, data_p);
+					FreeCopiedString (id_s);
+				}
+			else
+				{
+					PrintErrors(STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get study id as string for plot " UINT32_FMT " in Study \"%s\"", row_p -> ro_by_study_index, row_p -> ro_study_p -> st_name_s);
+				}
+
+		}
+}
+
+
 static void ReportJSONError (ServiceJob *job_p, const NamedParameterType *param_p, const char * const key_s, const json_t *value_p, const char * const message_s)
 {
 	bool done_error_message_flag = false;
@@ -35,6 +35,7 @@
 #include "programme.h"
 #include "person_jobs.h"
 #include "mongodb_util.h"
+#include "option_list_cache.h"
 
 
 static bool AddPersonFromJSON (Person *person_p, void *user_data_p, MEM_FLAG *mem_p);
@@ -157,6 +158,9 @@ bool SaveFieldTrial (FieldTrial *trial_p, ServiceJob *job_p, FieldTrialServiceDa
 					if (SaveAndBackupMongoDataWithTimestamp (data_p -> dftsd_mongo_p, field_trial_json_p, data_p -> dftsd_collection_ss [DFTD_FIELD_TRIAL], data_p -> dftsd_backup_collection_ss [DFTD_FIELD_TRIAL], DFT_BACKUPS_ID_KEY_S,  selector_p, MONGO_TIMESTAMP_S))
 						{
 							char *id_s = GetBSONOidAsString (trial_p -> ft_id_p);
+
+							ClearOptionListCache (DFTD_FIELD_TRIAL, data_p);
+
 							status = IndexData (job_p, field_trial_json_p, NULL);
 
 							if (status != OS_SUCCEEDED)
@@ -31,6 +31,7 @@
 #include "boolean_parameter.h"
 #include "person_jobs.h"
 #include "frictionless_data_util.h"
+#include "option_list_cache.h"
 
 /*
  * Field Trial parameters
@@ -626,7 +627,7 @@ json_t *GetAllFieldTrialsAsJSON (const FieldTrialServiceData *data_p, const bool
 bool SetUpFieldTrialsListParameter (const FieldTrialServiceData *data_p, Parameter *param_p,  const char *active_trial_id_s, const bool empty_option_flag)
 {
 	bool success_flag = false;
-	json_t *trials_p = GetAllFieldTrialsAsJSON (data_p, false);
+	json_t *trials_p = GetOptionListDocuments (DFTD_FIELD_TRIAL, data_p);
 
 	if (trials_p)
 		{
@@ -0,0 +1,685 @@
+/*
+ * geocode_cache.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <ctype.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "geocode_cache.h"
+#include "geocoder_util.h"
+
+#include "grassroots_server.h"
+#include "mongodb_tool.h"
+#include "json_util.h"
+#include "byte_buffer.h"
+#include "memory_allocations.h"
+#include "string_utils.h"
+#include "streams.h"
+
+
+/**
+ * The collection that the geocoded coordinates are stored in.
+ */
+static const char * const S_GEOCODES_COLLECTION_S = "Geocodes";
+
+static const char * const S_LATITUDE_S = "latitude";
+
+static const char * const S_LONGITUDE_S = "longitude";
+
+static const char * const S_ELEVATION_S = "elevation";
+
+static const char * const S_SAVED_S = "saved";
+
+
+/**
+ * The Addresses that need to be sent to the geocoder, shared by the
+ * threads that are doing the lookups.
+ */
+typedef struct GeocodeBatch
+{
+	/** Guards the queue position and the time of the next request. */
+	pthread_mutex_t gb_mutex;
+
+	Address **gb_addresses_pp;
+
+	/** The indexes in gb_addresses_pp of the Addresses to look up. */
+	uint32 *gb_indexes_p;
+
+	/** The number of entries in gb_indexes_p. */
+	uint32 gb_num_indexes;
+
+	/** The index in gb_indexes_p of the next Address to look up. */
+	uint32 gb_next_index;
+
+	/** Whether each Address in gb_addresses_pp was looked up successfully. */
+	bool *gb_results_p;
+
+	/** The earliest time that the next request can be sent. */
+	struct timespec gb_next_request_time;
+
+	/** The minimum number of nanoseconds between requests. */
+	int64 gb_interval;
+
+	const char *gb_geocoder_s;
+
+	GrassrootsServer *gb_grassroots_p;
+
+} GeocodeBatch;
+
+
+static bool AppendNormalisedAddressPart (ByteBuffer *buffer_p, const char *value_s, const bool remove_spaces_flag);
+
+static json_t *GetCachedGeocodes (char **keys_ss, const uint32 num_keys, FieldTrialServiceData *data_p);
+
+static bool SetAddressFromCachedGeocode (Address *address_p, const json_t *geocode_p);
+
+static bool AddGeocodeToCache (const char *key_s, const Address *address_p, FieldTrialServiceData *data_p);
+
+static void RunGeocodeLookups (GeocodeBatch *batch_p, const uint32 max_connections);
+
+static void *RunGeocodeWorker (void *data_p);
+
+static void GetNextGeocodeRequestTime (GeocodeBatch *batch_p, struct timespec *request_time_p);
+
+static void WaitUntilGeocodeRequestTime (const struct timespec *request_time_p);
+
+
+char *GetGeocodeCacheKey (const Address *address_p)
+{
+	char *key_s = NULL;
+	ByteBuffer *buffer_p = AllocateByteBuffer (1024);
+
+	if (buffer_p)
+		{
+			/* Country codes are more consistent than names so prefer those */
+			const char *country_s = (address_p -> ad_country_code_s) ? (address_p -> ad_country_code_s) : (address_p -> ad_country_s);
+
+			if ((AppendNormalisedAddressPart (buffer_p, address_p -> ad_street_s, false)) &&
+					(AppendToByteBuffer (buffer_p, "|", 1)) &&
+					(AppendNormalisedAddressPart (buffer_p, address_p -> ad_town_s, false)) &&
+					(AppendToByteBuffer (buffer_p, "|", 1)) &&
+					(AppendNormalisedAddressPart (buffer_p, address_p -> ad_county_s, false)) &&
+					(AppendToByteBuffer (buffer_p, "|", 1)) &&
+					(AppendNormalisedAddressPart (buffer_p, address_p -> ad_postcode_s, true)) &&
+					(AppendToByteBuffer (buffer_p, "|", 1)) &&
+					(AppendNormalisedAddressPart (buffer_p, country_s, false)))
+				{
+					/* Only the separators means that there is nothing to look up */
+					if (GetByteBufferSize (buffer_p) > 4)
+						{
+							key_s = DetachByteBufferData (buffer_p);
+							buffer_p = NULL;
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to make geocode cache key for \"%s\"", address_p -> ad_name_s ? address_p -> ad_name_s : "");
+				}
+
+			if (buffer_p)
+				{
+					FreeByteBuffer (buffer_p);
+				}
+		}		/* if (buffer_p) */
+
+	return key_s;
+}
+
+
+bool GeocodeAddress (Address *address_p, FieldTrialServiceData *data_p)
+{
+	return (GeocodeAddresses (&address_p, 1, data_p) == 1);
+}
+
+
+uint32 GeocodeAddresses (Address **addresses_pp, const uint32 num_addresses, FieldTrialServiceData *data_p)
+{
+	uint32 num_geocoded = 0;
+	char **keys_ss = (char **) AllocMemoryArray (num_addresses, sizeof (char *));
+	uint32 *primary_indexes_p = (uint32 *) AllocMemoryArray (num_addresses, sizeof (uint32));
+	bool *results_p = (bool *) AllocMemoryArray (num_addresses, sizeof (bool));
+	GeocodeBatch batch;
+
+	memset (&batch, 0, sizeof (GeocodeBatch));
+	batch.gb_indexes_p = (uint32 *) AllocMemoryArray (num_addresses, sizeof (uint32));
+
+	if (keys_ss && primary_indexes_p && results_p && (batch.gb_indexes_p))
+		{
+			json_t *cached_geocodes_p = NULL;
+			json_t *pending_keys_p = json_object ();
+			uint32 i;
+
+			for (i = 0; i < num_addresses; ++ i)
+				{
+					* (keys_ss + i) = GetGeocodeCacheKey (* (addresses_pp + i));
+					* (primary_indexes_p + i) = i;
+				}
+
+			if (data_p -> dftsd_geocode_cache_flag)
+				{
+					cached_geocodes_p = GetCachedGeocodes (keys_ss, num_addresses, data_p);
+				}
+
+			/*
+			 * Use any cached coordinates and only look up each of the
+			 * remaining keys once.
+			 */
+			for (i = 0; i < num_addresses; ++ i)
+				{
+					const char *key_s = * (keys_ss + i);
+					bool lookup_flag = true;
+
+					if (key_s)
+						{
+							if (cached_geocodes_p)
+								{
+									const json_t *geocode_p = json_object_get (cached_geocodes_p, key_s);
+
+									if (geocode_p)
+										{
+											if (SetAddressFromCachedGeocode (* (addresses_pp + i), geocode_p))
+												{
+													* (results_p + i) = true;
+													++ num_geocoded;
+													lookup_flag = false;
+												}
+										}
+								}
+
+							if (lookup_flag && pending_keys_p)
+								{
+									const json_t *primary_p = json_object_get (pending_keys_p, key_s);
+
+									if (primary_p)
+										{
+											* (primary_indexes_p + i) = (uint32) json_integer_value (primary_p);
+											lookup_flag = false;
+										}
+									else
+										{
+											json_object_set_new (pending_keys_p, key_s, json_integer (i));
+										}
+								}
+						}
+
+					if (lookup_flag)
+						{
+							* ((batch.gb_indexes_p) + (batch.gb_num_indexes)) = i;
+							++ (batch.gb_num_indexes);
+						}
+				}
+
+			if (batch.gb_num_indexes > 0)
+				{
+					const double64 requests_per_second = data_p -> dftsd_geocode_requests_per_second;
+
+					batch.gb_addresses_pp = addresses_pp;
+					batch.gb_results_p = results_p;
+					batch.gb_geocoder_s = data_p -> dftsd_geocoder_s;
+					batch.gb_grassroots_p = data_p -> dftsd_base_data.sd_service_p -> se_grassroots_p;
+					batch.gb_interval = (requests_per_second > 0.0) ? (int64) (1000000000.0 / requests_per_second) : 0;
+
+					clock_gettime (CLOCK_MONOTONIC, & (batch.gb_next_request_time));
+
+					RunGeocodeLookups (&batch, data_p -> dftsd_geocode_max_connections);
+
+					for (i = 0; i < batch.gb_num_indexes; ++ i)
+						{
+							const uint32 index = * ((batch.gb_indexes_p) + i);
+
+							if (* (results_p + index))
+								{
+									++ num_geocoded;
+
+									if ((data_p -> dftsd_geocode_cache_flag) && (* (keys_ss + index)))
+										{
+											AddGeocodeToCache (* (keys_ss + index), * (addresses_pp + index), data_p);
+										}
+								}
+							else
+								{
+									const Address *address_p = * (addresses_pp + index);
+
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to geocode \"%s\"", address_p -> ad_name_s ? address_p -> ad_name_s : "");
+								}
+						}
+				}		/* if (batch.gb_num_indexes > 0) */
+
+			/* Copy the coordinates to the Addresses that shared a lookup */
+			for (i = 0; i < num_addresses; ++ i)
+				{
+					const uint32 primary_index = * (primary_indexes_p + i);
+
+					if ((primary_index != i) && (* (results_p + primary_index)))
+						{
+							const Coordinate *centre_p = (* (addresses_pp + primary_index)) -> ad_gps_centre_p;
+
+							if (SetAddressCentreCoordinate (* (addresses_pp + i), centre_p -> co_x, centre_p -> co_y, centre_p -> co_elevation_p))
+								{
+									* (results_p + i) = true;
+									++ num_geocoded;
+								}
+						}
+				}
+
+			if (pending_keys_p)
+				{
+					json_decref (pending_keys_p);
+				}
+
+			if (cached_geocodes_p)
+				{
+					json_decref (cached_geocodes_p);
+				}
+
+			for (i = 0; i < num_addresses; ++ i)
+				{
+					if (* (keys_ss + i))
+						{
+							FreeCopiedString (* (keys_ss + i));
+						}
+				}
+
+		}		/* if (keys_ss && primary_indexes_p && results_p && (batch.gb_indexes_p)) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate memory to geocode " UINT32_FMT " addresses", num_addresses);
+		}
+
+	if (batch.gb_indexes_p)
+		{
+			FreeMemory (batch.gb_indexes_p);
+		}
+
+	if (results_p)
+		{
+			FreeMemory (results_p);
+		}
+
+	if (primary_indexes_p)
+		{
+			FreeMemory (primary_indexes_p);
+		}
+
+	if (keys_ss)
+		{
+			FreeMemory (keys_ss);
+		}
+
+	return num_geocoded;
+}
+
+
+/*
+ * Append a lower-cased copy of a value with each run of
+ * non-alphanumeric characters replaced by a single space.
+ */
+static bool AppendNormalisedAddressPart (ByteBuffer *buffer_p, const char *value_s, const bool remove_spaces_flag)
+{
+	bool success_flag = true;
+
+	if (value_s)
+		{
+			const char *c_p = value_s;
+			bool needs_space_flag = false;
+			bool started_flag = false;
+
+			while ((*c_p != '\0') && success_flag)
+				{
+					const unsigned char c = (unsigned char) *c_p;
+
+					/* Keep any multi-byte UTF-8 characters as they are */
+					if ((isalnum (c)) || (c >= 0x80))
+						{
+							char lower_c = (char) tolower (c);
+
+							if (needs_space_flag)
+								{
+									success_flag = AppendToByteBuffer (buffer_p, " ", 1);
+									needs_space_flag = false;
+								}
+
+							if (success_flag)
+								{
+									success_flag = AppendToByteBuffer (buffer_p, &lower_c, 1);
+									started_flag = true;
+								}
+						}
+					else if (started_flag && !remove_spaces_flag)
+						{
+							needs_space_flag = true;
+						}
+
+					++ c_p;
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Get the cached geocodes for the given keys as an object with the
+ * keys as its fields.
+ */
+static json_t *GetCachedGeocodes (char **keys_ss, const uint32 num_keys, FieldTrialServiceData *data_p)
+{
+	json_t *geocodes_p = NULL;
+	MongoTool *tool_p = data_p -> dftsd_mongo_p;
+
+	if (SetMongoToolCollection (tool_p, S_GEOCODES_COLLECTION_S))
+		{
+			bson_t *keys_p = bson_new ();
+
+			if (keys_p)
+				{
+					uint32 num_added = 0;
+					uint32 i;
+
+					for (i = 0; i < num_keys; ++ i)
+						{
+							const char *key_s = * (keys_ss + i);
+
+							if (key_s)
+								{
+									char index_s [16];
+
+									sprintf (index_s, UINT32_FMT, num_added);
+
+									if (BSON_APPEND_UTF8 (keys_p, index_s, key_s))
+										{
+											++ num_added;
+										}
+								}
+						}
+
+					if (num_added > 0)
+						{
+							bson_t *query_p = BCON_NEW (MONGO_ID_S, "{", "$in", BCON_ARRAY (keys_p), "}");
+
+							if (query_p)
+								{
+									json_t *results_p = GetAllMongoResultsAsJSON (tool_p, query_p, NULL);
+
+									if (results_p)
+										{
+											geocodes_p = json_object ();
+
+											if (geocodes_p)
+												{
+													size_t j;
+													json_t *result_p;
+
+													json_array_foreach (results_p, j, result_p)
+														{
+															const char *key_s = GetJSONString (result_p, MONGO_ID_S);
+
+															if (key_s)
+																{
+																	json_object_set (geocodes_p, key_s, result_p);
+																}
+														}
+												}
+
+											json_decref (results_p);
+										}
+
+									bson_destroy (query_p);
+								}
+						}
+
+					bson_destroy (keys_p);
+				}		/* if (keys_p) */
+
+		}		/* if (SetMongoToolCollection (tool_p, S_GEOCODES_COLLECTION_S)) */
+
+	return geocodes_p;
+}
+
+
+static bool SetAddressFromCachedGeocode (Address *address_p, const json_t *geocode_p)
+{
+	bool success_flag = false;
+	const json_t *latitude_p = json_object_get (geocode_p, S_LATITUDE_S);
+	const json_t *longitude_p = json_object_get (geocode_p, S_LONGITUDE_S);
+
+	if (json_is_number (latitude_p) && json_is_number (longitude_p))
+		{
+			const json_t *elevation_p = json_object_get (geocode_p, S_ELEVATION_S);
+			double64 elevation = 0.0;
+			const double64 *elevation_value_p = NULL;
+
+			if (json_is_number (elevation_p))
+				{
+					elevation = json_number_value (elevation_p);
+					elevation_value_p = &elevation;
+				}
+
+			success_flag = SetAddressCentreCoordinate (address_p, json_number_value (latitude_p), json_number_value (longitude_p), elevation_value_p);
+		}
+	else
+		{
+			PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, geocode_p, "Cached geocode has no coordinates");
+		}
+
+	return success_flag;
+}
+
+
+static bool AddGeocodeToCache (const char *key_s, const Address *address_p, FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	const Coordinate *centre_p = address_p -> ad_gps_centre_p;
+
+	if (centre_p && SetMongoToolCollection (data_p -> dftsd_mongo_p, S_GEOCODES_COLLECTION_S))
+		{
+			bson_t *selector_p = BCON_NEW (MONGO_ID_S, BCON_UTF8 (key_s));
+			bson_t *doc_p = BCON_NEW (MONGO_ID_S, BCON_UTF8 (key_s),
+																S_LATITUDE_S, BCON_DOUBLE (centre_p -> co_x),
+																S_LONGITUDE_S, BCON_DOUBLE (centre_p -> co_y),
+																S_SAVED_S, BCON_DATE_TIME (((int64_t) time (NULL)) * 1000));
+			bson_t *opts_p = BCON_NEW ("upsert", BCON_BOOL (true));
+
+			if (selector_p && doc_p && opts_p)
+				{
+					bson_error_t error;
+
+					if ((centre_p -> co_elevation_p == NULL) || (BSON_APPEND_DOUBLE (doc_p, S_ELEVATION_S, * (centre_p -> co_elevation_p))))
+						{
+							if (mongoc_collection_replace_one (data_p -> dftsd_mongo_p -> mt_collection_p, selector_p, doc_p, opts_p, NULL, &error))
+								{
+									success_flag = true;
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to cache geocode for \"%s\": \"%s\"", key_s, error.message);
+								}
+						}
+				}
+
+			if (opts_p)
+				{
+					bson_destroy (opts_p);
+				}
+
+			if (doc_p)
+				{
+					bson_destroy (doc_p);
+				}
+
+			if (selector_p)
+				{
+					bson_destroy (selector_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+static void RunGeocodeLookups (GeocodeBatch *batch_p, const uint32 max_connections)
+{
+	uint32 num_workers = (max_connections > 0) ? max_connections : 1;
+	pthread_t *workers_p = NULL;
+	uint32 num_started = 0;
+	uint32 i;
+
+	if (num_workers > batch_p -> gb_num_indexes)
+		{
+			num_workers = batch_p -> gb_num_indexes;
+		}
+
+	pthread_mutex_init (& (batch_p -> gb_mutex), NULL);
+
+	/* The calling thread does its share of the lookups too */
+	if (num_workers > 1)
+		{
+			workers_p = (pthread_t *) AllocMemoryArray (num_workers - 1, sizeof (pthread_t));
+
+			if (workers_p)
+				{
+					for (i = 0; i < num_workers - 1; ++ i)
+						{
+							if (pthread_create (workers_p + i, NULL, RunGeocodeWorker, batch_p) == 0)
+								{
+									++ num_started;
+								}
+							else
+								{
+									/*
+									 * The workers that have started will get through all
+									 * of the addresses, it'll just take a bit longer
+									 */
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to start geocode worker " UINT32_FMT, i);
+									break;
+								}
+						}
+				}
+		}
+
+	RunGeocodeWorker (batch_p);
+
+	for (i = 0; i < num_started; ++ i)
+		{
+			pthread_join (* (workers_p + i), NULL);
+		}
+
+	if (workers_p)
+		{
+			FreeMemory (workers_p);
+		}
+
+	pthread_mutex_destroy (& (batch_p -> gb_mutex));
+}
+
+
+static void *RunGeocodeWorker (void *data_p)
+{
+	GeocodeBatch *batch_p = (GeocodeBatch *) data_p;
+	bool loop_flag = true;
+
+	while (loop_flag)
+		{
+			uint32 index = 0;
+			struct timespec request_time;
+
+			pthread_mutex_lock (& (batch_p -> gb_mutex));
+
+			if (batch_p -> gb_next_index < batch_p -> gb_num_indexes)
+				{
+					index = * ((batch_p -> gb_indexes_p) + (batch_p -> gb_next_index));
+					++ (batch_p -> gb_next_index);
+
+					GetNextGeocodeRequestTime (batch_p, &request_time);
+				}
+			else
+				{
+					loop_flag = false;
+				}
+
+			pthread_mutex_unlock (& (batch_p -> gb_mutex));
+
+			if (loop_flag)
+				{
+					Address *address_p = * ((batch_p -> gb_addresses_pp) + index);
+
+					WaitUntilGeocodeRequestTime (&request_time);
+
+					* ((batch_p -> gb_results_p) + index) = DetermineGPSLocationForAddress (address_p, batch_p -> gb_geocoder_s, batch_p -> gb_grassroots_p);
+				}
+		}
+
+	return NULL;
+}
+
+
+/*
+ * Reserve the next slot for a request to the geocoder. This must be
+ * called with the batch's mutex held.
+ */
+static void GetNextGeocodeRequestTime (GeocodeBatch *batch_p, struct timespec *request_time_p)
+{
+	struct timespec now;
+	struct timespec *next_p = & (batch_p -> gb_next_request_time);
+
+	clock_gettime (CLOCK_MONOTONIC, &now);
+
+	if ((now.tv_sec > next_p -> tv_sec) || ((now.tv_sec == next_p -> tv_sec) && (now.tv_nsec > next_p -> tv_nsec)))
+		{
+			*next_p = now;
+		}
+
+	*request_time_p = *next_p;
+
+	next_p -> tv_sec += (time_t) ((batch_p -> gb_interval) / 1000000000);
+	next_p -> tv_nsec += (long) ((batch_p -> gb_interval) % 1000000000);
+
+	if (next_p -> tv_nsec >= 1000000000)
+		{
+			++ (next_p -> tv_sec);
+			next_p -> tv_nsec -= 1000000000;
+		}
+}
+
+
+/*
+ * clock_nanosleep () isn't available on every platform, so sleep for
+ * the time that is left and check the clock again, which also covers
+ * any sleeps that are interrupted.
+ */
+static void WaitUntilGeocodeRequestTime (const struct timespec *request_time_p)
+{
+	bool wait_flag = true;
+
+	while (wait_flag)
+		{
+			struct timespec now;
+
+			clock_gettime (CLOCK_MONOTONIC, &now);
+
+			if ((now.tv_sec < request_time_p -> tv_sec) || ((now.tv_sec == request_time_p -> tv_sec) && (now.tv_nsec < request_time_p -> tv_nsec)))
+				{
+					struct timespec interval;
+
+					interval.tv_sec = request_time_p -> tv_sec - now.tv_sec;
+					interval.tv_nsec = request_time_p -> tv_nsec - now.tv_nsec;
+
+					if (interval.tv_nsec < 0)
+						{
+							-- (interval.tv_sec);
+							interval.tv_nsec += 1000000000;
+						}
+
+					nanosleep (&interval, NULL);
+				}
+			else
+				{
+					wait_flag = false;
+				}
+		}
+}
@@ -21,7 +21,18 @@
  *      Author: billy
  */
 
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
 
 #include "string_utils.h"
 #include "math_utils.h"
@@ -34,6 +45,7 @@
 #include "measured_variable.h"
 #include "phenotype_statistics.h"
 #include "measured_variable_jobs.h"
+#include "asset_cache.h"
 
 
 typedef enum
@@ -45,6 +57,24 @@ typedef enum
 } CapitalizeState;
 
 
+/*
+ * The suffix for the file next to each LaTeX file that stores
+ * the hash of the LaTeX that its PDF was last built from.
+ */
+static const char * const S_HASH_SUFFIX_S = ".hash";
+
+
+/*
+ * pdflatex is the slowest part of saving a Study so these limit
+ * how many copies of it can be running at once in this process.
+ */
+static pthread_mutex_t s_latex_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_cond_t s_latex_cond = PTHREAD_COND_INITIALIZER;
+
+static uint32 s_num_latex_jobs = 0;
+
+
 static bool InsertLatexTabularRow (FILE *out_f, const char * const key_s, const char * const value_s, const CapitalizeState capitalize, ByteBuffer *buffer_p);
 static bool InsertPersonAsLatexTabularRow (FILE *out_f, const Person * const person_p);
 static bool InsertPersonWithHeadingAsLatexTabularRow (FILE *out_f, const char * const key_s, const Person * const person_p);
@@ -68,9 +98,25 @@ static bool PrintLocation (FILE *study_tex_f, const Location * const location_p,
 
 static bool PrintJSONChildValue (FILE *study_tex_f, const json_t *parent_p, const char *key_s, const char *printed_key_s, CapitalizeState capitalize, ByteBuffer *buffer_p);
 
-static char *DownloadToFile (const char *url_s, const char *download_directory_s, const char *filename_s, const bool use_local_url_flag);
+static char *DownloadToFile (const char *url_s, const char *download_directory_s, const char *filename_s, const bool use_local_url_flag, const uint32 max_age);
+
+static OperationStatus BuildStudyHandbook (const char *latex_filename_s, const char *temp_filename_s, const FieldTrialServiceData *data_p);
+
+static bool IsStoredHashEqual (const char *hash_filename_s, const char *hash_s);
+
+static bool WriteStoredHash (const char *hash_filename_s, const char *hash_s);
+
+static char *GetHandbookPDFFilename (const char *latex_filename_s);
 
-static bool RunLatex (const char *pdf_latex_command_s, const char *output_path_s, const char *filename_s);
+static bool RunLatex (const char *pdf_latex_command_s, const char *output_path_s, const char *filename_s, const FieldTrialServiceData *data_p);
+
+static bool AcquireLatexSlot (const uint32 max_jobs, const uint32 wait_timeout);
+
+static void ReleaseLatexSlot (const uint32 max_jobs);
+
+static int RunCommandWithTimeout (const char *command_s, const uint32 timeout);
+
+static bool InsertScaledGraphic (FILE *study_tex_f, char *image_s);
 
 static char *GetFullFilenameForDownload (const char *url_s, const char *download_directory_s, const char *prefix_s, const bool use_local_url_flag);
 
@@ -125,7 +171,20 @@ OperationStatus GenerateStudyAsPDF (const Study *study_p, FieldTrialServiceData
 
 	if (full_filename_s)
 		{
-			FILE *study_tex_f = fopen (full_filename_s, "w");
+			/*
+			 * Write the LaTeX to a temporary file first so that we can
+			 * tell whether it has changed since the PDF was last built
+			 */
+			char *temp_filename_s = ConcatenateStrings (full_filename_s, ".XXXXXX");
+			int temp_fd = temp_filename_s ? mkstemp (temp_filename_s) : -1;
+			FILE *study_tex_f = NULL;
+
+			if (temp_fd != -1)
+				{
+					/* mkstemp () only gives the owner access but the file replaces one that others could read */
+					fchmod (temp_fd, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+					study_tex_f = fdopen (temp_fd, "w");
+				}
 
 			if (study_tex_f)
 				{
@@ -174,28 +233,17 @@ OperationStatus GenerateStudyAsPDF (const Study *study_p, FieldTrialServiceData
 
 											if (id_s)
 												{
-													char *image_s = DownloadToFile (programme_p -> pr_logo_url_s, download_path_s, id_s, true);
+													char *image_s = DownloadToFile (programme_p -> pr_logo_url_s, download_path_s, id_s, true, data_p -> dftsd_asset_cache_max_age);
 
 													if (image_s)
 														{
-															char *last_dot_p = strrchr (image_s, '.');
-
-															/*
-															 * includegraphics doesn't use the extension so
-															 * remove it if it's there
-															 */
-															if (last_dot_p)
-																{
-																	*last_dot_p = '\0';
-																}
-
 															fputs ("\\usepackage{titling}\n", study_tex_f);
 
 															fputs ("\\pretitle{%\n\\begin{center}\n\\LARGE\n}\n", study_tex_f);
 
 															fputs ("\\posttitle{\%%\n\\begin{figure}[H]\n\\centering\n", study_tex_f);
 
-															fprintf (study_tex_f, "\\scalegraphics{%s}\n", image_s);
+															InsertScaledGraphic (study_tex_f, image_s);
 
 															fputs ("\\end{figure}\n\\end{center}\n}\n", study_tex_f);
 
@@ -265,16 +313,22 @@ OperationStatus GenerateStudyAsPDF (const Study *study_p, FieldTrialServiceData
 
 					fclose (study_tex_f);
 
-					if (RunLatex (data_p -> dftsd_latex_commmand_s, data_p -> dftsd_assets_path_s, full_filename_s))
+					status = BuildStudyHandbook (full_filename_s, temp_filename_s, data_p);
+				}		/* if (study_tex_f) */
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get open temporary file for \"%s\"", full_filename_s);
+
+					if (temp_fd != -1)
 						{
-							status = OS_SUCCEEDED;
+							close (temp_fd);
+							remove (temp_filename_s);
 						}
+				}
 
-
-				}		/* if (study_tex_f) */
-			else
+			if (temp_filename_s)
 				{
-					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get open file \"%s\"", full_filename_s);
+					FreeCopiedString (temp_filename_s);
 				}
 
 			FreeCopiedString (full_filename_s);
@@ -289,7 +343,146 @@ OperationStatus GenerateStudyAsPDF (const Study *study_p, FieldTrialServiceData
 
 
 
-static bool RunLatex (const char *pdf_latex_command_s, const char *output_path_s, const char *latex_filename_s)
+static OperationStatus BuildStudyHandbook (const char *latex_filename_s, const char *temp_filename_s, const FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	char hash_s [ASSET_HASH_BUFFER_SIZE];
+
+	if (GetFileContentHash (temp_filename_s, hash_s))
+		{
+			char *hash_filename_s = ConcatenateStrings (latex_filename_s, S_HASH_SUFFIX_S);
+
+			if (hash_filename_s)
+				{
+					char *pdf_filename_s = GetHandbookPDFFilename (latex_filename_s);
+
+					if (pdf_filename_s)
+						{
+							if (DoesFileExist (pdf_filename_s) && IsStoredHashEqual (hash_filename_s, hash_s))
+								{
+									PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "\"%s\" is unchanged so not rebuilding \"%s\"", latex_filename_s, pdf_filename_s);
+									status = OS_SUCCEEDED;
+								}
+							else
+								{
+									/*
+									 * Remove the old hash first so that if pdflatex fails, we
+									 * don't think that the PDF is up to date next time
+									 */
+									remove (hash_filename_s);
+
+									if (rename (temp_filename_s, latex_filename_s) == 0)
+										{
+											if (RunLatex (data_p -> dftsd_latex_commmand_s, data_p -> dftsd_assets_path_s, latex_filename_s, data_p))
+												{
+													WriteStoredHash (hash_filename_s, hash_s);
+													status = OS_SUCCEEDED;
+												}
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to rename \"%s\" to \"%s\"", temp_filename_s, latex_filename_s);
+										}
+								}
+
+							FreeCopiedString (pdf_filename_s);
+						}		/* if (pdf_filename_s) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get pdf filename for \"%s\"", latex_filename_s);
+						}
+
+					FreeCopiedString (hash_filename_s);
+				}		/* if (hash_filename_s) */
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get hash filename for \"%s\"", latex_filename_s);
+				}
+
+		}		/* if (GetFileContentHash (temp_filename_s, hash_s)) */
+
+	/* This does nothing if the file was renamed into place */
+	remove (temp_filename_s);
+
+	return status;
+}
+
+
+static bool IsStoredHashEqual (const char *hash_filename_s, const char *hash_s)
+{
+	bool match_flag = false;
+	FILE *in_f = fopen (hash_filename_s, "r");
+
+	if (in_f)
+		{
+			char stored_hash_s [ASSET_HASH_BUFFER_SIZE];
+
+			if (fgets (stored_hash_s, ASSET_HASH_BUFFER_SIZE, in_f))
+				{
+					match_flag = (strcmp (stored_hash_s, hash_s) == 0);
+				}
+
+			fclose (in_f);
+		}
+
+	return match_flag;
+}
+
+
+static bool WriteStoredHash (const char *hash_filename_s, const char *hash_s)
+{
+	bool success_flag = false;
+	FILE *out_f = fopen (hash_filename_s, "w");
+
+	if (out_f)
+		{
+			success_flag = (fputs (hash_s, out_f) >= 0);
+
+			if (fclose (out_f) != 0)
+				{
+					success_flag = false;
+				}
+		}
+
+	if (!success_flag)
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to write hash to \"%s\"", hash_filename_s);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * pdflatex names the PDF after the LaTeX file, swapping the .tex
+ * extension for .pdf
+ */
+static char *GetHandbookPDFFilename (const char *latex_filename_s)
+{
+	const char * const TEX_SUFFIX_S = ".tex";
+	const size_t suffix_length = strlen (TEX_SUFFIX_S);
+	const size_t l = strlen (latex_filename_s);
+	char *pdf_filename_s = NULL;
+
+	if ((l > suffix_length) && (strcmp (latex_filename_s + l - suffix_length, TEX_SUFFIX_S) == 0))
+		{
+			pdf_filename_s = EasyCopyToNewString (latex_filename_s);
+
+			if (pdf_filename_s)
+				{
+					strcpy (pdf_filename_s + l - suffix_length, ".pdf");
+				}
+		}
+	else
+		{
+			pdf_filename_s = ConcatenateStrings (latex_filename_s, ".pdf");
+		}
+
+	return pdf_filename_s;
+}
+
+
+static bool RunLatex (const char *pdf_latex_command_s, const char *output_path_s, const char *latex_filename_s, const FieldTrialServiceData *data_p)
 {
 	bool success_flag = false;
 	/*
@@ -300,15 +493,24 @@ static bool RunLatex (const char *pdf_latex_command_s, const char *output_path_s
 
 	if (command_s)
 		{
-			int res = system (command_s);
-
-			if (res == 0)
+			if (AcquireLatexSlot (data_p -> dftsd_latex_max_jobs, data_p -> dftsd_latex_wait_timeout))
 				{
-					success_flag = true;
+					int res = RunCommandWithTimeout (command_s, data_p -> dftsd_latex_run_timeout);
+
+					ReleaseLatexSlot (data_p -> dftsd_latex_max_jobs);
+
+					if (res == 0)
+						{
+							success_flag = true;
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" failed with res %d", command_s, res);
+						}
 				}
 			else
 				{
-					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" failed with res %d", command_s, res);
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Timed out after " UINT32_FMT " seconds waiting to run \"%s\"", data_p -> dftsd_latex_wait_timeout, command_s);
 				}
 
 			FreeCopiedString (command_s);
@@ -322,6 +524,163 @@ static bool RunLatex (const char *pdf_latex_command_s, const char *output_path_s
 }
 
 
+/*
+ * Wait until fewer than max_jobs copies of pdflatex are running. If
+ * max_jobs is 0 there is no limit and if wait_timeout is 0, this
+ * waits for as long as it takes.
+ */
+static bool AcquireLatexSlot (const uint32 max_jobs, const uint32 wait_timeout)
+{
+	bool success_flag = true;
+
+	if (max_jobs > 0)
+		{
+			struct timespec deadline;
+
+			clock_gettime (CLOCK_REALTIME, &deadline);
+			deadline.tv_sec += wait_timeout;
+
+			pthread_mutex_lock (&s_latex_mutex);
+
+			while (success_flag && (s_num_latex_jobs >= max_jobs))
+				{
+					if (wait_timeout > 0)
+						{
+							if (pthread_cond_timedwait (&s_latex_cond, &s_latex_mutex, &deadline) == ETIMEDOUT)
+								{
+									success_flag = (s_num_latex_jobs < max_jobs);
+								}
+						}
+					else
+						{
+							pthread_cond_wait (&s_latex_cond, &s_latex_mutex);
+						}
+				}
+
+			if (success_flag)
+				{
+					++ s_num_latex_jobs;
+				}
+
+			pthread_mutex_unlock (&s_latex_mutex);
+		}
+
+	return success_flag;
+}
+
+
+static void ReleaseLatexSlot (const uint32 max_jobs)
+{
+	if (max_jobs > 0)
+		{
+			pthread_mutex_lock (&s_latex_mutex);
+
+			-- s_num_latex_jobs;
+			pthread_cond_signal (&s_latex_cond);
+
+			pthread_mutex_unlock (&s_latex_mutex);
+		}
+}
+
+
+/*
+ * Run a shell command and return its exit status or -1 if it couldn't
+ * be run, was killed or took longer than timeout seconds. A timeout of
+ * 0 means that there is no time limit.
+ */
+static int RunCommandWithTimeout (const char *command_s, const uint32 timeout)
+{
+	int res = -1;
+	pid_t pid = fork ();
+
+	if (pid == 0)
+		{
+			/* Put the command in its own process group so that we can kill everything it starts */
+			setpgid (0, 0);
+			execl ("/bin/sh", "sh", "-c", command_s, (char *) NULL);
+			_exit (127);
+		}
+	else if (pid > 0)
+		{
+			const time_t deadline = time (NULL) + (time_t) timeout;
+			bool running_flag = true;
+
+			while (running_flag)
+				{
+					int status;
+					pid_t waited_pid = waitpid (pid, &status, (timeout > 0) ? WNOHANG : 0);
+
+					if (waited_pid == pid)
+						{
+							if (WIFEXITED (status))
+								{
+									res = WEXITSTATUS (status);
+								}
+
+							running_flag = false;
+						}
+					else if (waited_pid == 0)
+						{
+							if (time (NULL) >= deadline)
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Killing \"%s\" after " UINT32_FMT " seconds", command_s, timeout);
+
+									kill (-pid, SIGKILL);
+									waitpid (pid, &status, 0);
+									running_flag = false;
+								}
+							else
+								{
+									const struct timespec delay = { 0, 100000000 };
+
+									nanosleep (&delay, NULL);
+								}
+						}
+					else if (errno != EINTR)
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "waitpid () failed for \"%s\", errno %d", command_s, errno);
+							running_flag = false;
+						}
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to start \"%s\", errno %d", command_s, errno);
+		}
+
+	return res;
+}
+
+
+/*
+ * Add an image to the handbook. A comment with a hash of the image's contents
+ * is added too so that if the image changes, so does the LaTeX file's hash.
+ */
+static bool InsertScaledGraphic (FILE *study_tex_f, char *image_s)
+{
+	char hash_s [ASSET_HASH_BUFFER_SIZE];
+	char *last_dot_p = NULL;
+
+	if (GetFileContentHash (image_s, hash_s))
+		{
+			fprintf (study_tex_f, "%% image %s\n", hash_s);
+		}
+
+	/*
+	 * includegraphics doesn't use the extension so
+	 * remove it if it's there
+	 */
+	last_dot_p = strrchr (image_s, '.');
+
+	if (last_dot_p)
+		{
+			*last_dot_p = '\0';
+		}
+
+	return (fprintf (study_tex_f, "\\scalegraphics{%s}\n", image_s) > 0);
+}
+
+
 
 static char *GetFullFilenameForDownload (const char *url_s, const char *download_directory_s, const char *prefix_s, const bool use_local_url_flag)
 {
@@ -378,44 +737,21 @@ static char *GetFullFilenameForDownload (const char *url_s, const char *download
 }
 
 
-static char *DownloadToFile (const char *url_s, const char *download_directory_s, const char *prefix_s, const bool use_local_url_flag)
+static char *DownloadToFile (const char *url_s, const char *download_directory_s, const char *prefix_s, const bool use_local_url_flag, const uint32 max_age)
 {
 	char *result_s = NULL;
-	char *full_output_filename_s = NULL;
 
 	if (EnsureDirectoryExists (download_directory_s))
 		{
-			full_output_filename_s = GetFullFilenameForDownload (url_s, download_directory_s, prefix_s, use_local_url_flag);
+			char *full_output_filename_s = GetFullFilenameForDownload (url_s, download_directory_s, prefix_s, use_local_url_flag);
 
 			if (full_output_filename_s)
 				{
-					if (!DoesFileExist (full_output_filename_s))
-						{
-							CurlTool *curl_tool_p = AllocateFileCurlTool (full_output_filename_s);
-
-							if (curl_tool_p)
-								{
-									if (SetUriForCurlTool (curl_tool_p, url_s))
-										{
-											CURLcode res = curl_easy_setopt (curl_tool_p -> ct_curl_p, CURLOPT_BUFFERSIZE, CURL_MAX_READ_SIZE);
-
-											res = RunCurlTool (curl_tool_p);
-
-											if (res == CURLE_OK)
-												{
-													result_s = full_output_filename_s;
-												}
-										}
-
-									FreeCurlTool (curl_tool_p);
-								}
-						}
-					else
+					if (UpdateCachedAsset (url_s, full_output_filename_s, max_age))
 						{
 							result_s = full_output_filename_s;
 						}
-
-					if (!result_s)
+					else
 						{
 							FreeCopiedString (full_output_filename_s);
 						}
@@ -538,23 +874,12 @@ static bool PrintStudy (FILE *study_tex_f, const Study * const study_p, ByteBuff
 
 			if (id_s)
 				{
-					char *image_s = DownloadToFile (study_p -> st_photo_url_s, data_p -> dftsd_assets_path_s, id_s, true);
+					char *image_s = DownloadToFile (study_p -> st_photo_url_s, data_p -> dftsd_assets_path_s, id_s, true, data_p -> dftsd_asset_cache_max_age);
 
 					if (image_s)
 						{
-							char *last_dot_p = strrchr (image_s, '.');
-
-							/*
-							 * includegraphics doesn't use the extension so
-							 * remove it if it's there
-							 */
-							if (last_dot_p)
-								{
-									*last_dot_p = '\0';
-								}
-
 							fputs ("\\begin{center}\n\\begin{figure}[H]\n", study_tex_f);
-							fprintf (study_tex_f, "\\scalegraphics{%s}\n", image_s);
+							InsertScaledGraphic (study_tex_f, image_s);
 							fputs ("\\end{figure}\n\\end{center}\n\n", study_tex_f);
 
 							FreeCopiedString (image_s);
@@ -962,23 +1287,12 @@ static bool PrintLocation (FILE *study_tex_f, const Location * const location_p,
 
 											if (id_s)
 												{
-													char *map_s = DownloadToFile (url_s, data_p -> dftsd_assets_path_s, id_s, false);
+													char *map_s = DownloadToFile (url_s, data_p -> dftsd_assets_path_s, id_s, false, data_p -> dftsd_asset_cache_max_age);
 
 													if (map_s)
 														{
-															char *last_dot_p = strrchr (map_s, '.');
-
-															/*
-															 * includegraphics doesn't use the extension so
-															 * remove it if it's there
-															 */
-															if (last_dot_p)
-																{
-																	*last_dot_p = '\0';
-																}
-
 															fputs ("\\begin{center}\n\\begin{figure}[H]\n", study_tex_f);
-															fprintf (study_tex_f, "\\scalegraphics{%s}\n", map_s);
+															InsertScaledGraphic (study_tex_f, map_s);
 															fputs ("\\end{figure}\n\\end{center}\n\n", study_tex_f);
 
 															FreeCopiedString (map_s);
@@ -1263,7 +1577,7 @@ static bool InsertPhenotypeHeatmap (FILE *study_tex_f, const char * const study_
 											if (DoesFileExist (full_filename_s))
 												{
 													fputs ("\\begin{center}\n\\begin{figure}[H]\n", study_tex_f);
-													fprintf (study_tex_f, "\\scalegraphics{%s}\n", full_filename_without_extension_s);
+													InsertScaledGraphic (study_tex_f, full_filename_s);
 													fputs ("\\end{figure}\n\\end{center}\n\n", study_tex_f);
 
 													success_flag = true;
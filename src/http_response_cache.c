@@ -0,0 +1,261 @@
+/*
+ * http_response_cache.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sys/stat.h>
+
+#include "http_response_cache.h"
+#include "asset_cache.h"
+
+#include "memory_allocations.h"
+#include "string_utils.h"
+#include "filesystem_utils.h"
+#include "streams.h"
+
+
+static const char * const S_RESPONSE_SUFFIX_S = ".response";
+
+
+/*
+ * The cache settings are shared by every service in the process.
+ */
+static pthread_mutex_t s_cache_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static char *s_cache_path_s = NULL;
+
+static uint32 s_cache_max_age = 0;
+
+
+static char *GetResponseFilename (const char *url_s, char hash_s [ASSET_HASH_BUFFER_SIZE], uint32 *max_age_p);
+
+static char *ReadResponseFile (const char *filename_s, const char *url_hash_s);
+
+
+bool SetHttpResponseCacheConfig (const char *cache_path_s, const uint32 max_age)
+{
+	bool success_flag = true;
+	char *copied_path_s = NULL;
+
+	if (cache_path_s)
+		{
+			if (EnsureDirectoryExists (cache_path_s))
+				{
+					copied_path_s = EasyCopyToNewString (cache_path_s);
+
+					if (!copied_path_s)
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to copy http response cache path \"%s\"", cache_path_s);
+							success_flag = false;
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create http response cache directory \"%s\"", cache_path_s);
+					success_flag = false;
+				}
+		}
+
+	if (success_flag)
+		{
+			pthread_mutex_lock (&s_cache_mutex);
+
+			if (s_cache_path_s)
+				{
+					FreeCopiedString (s_cache_path_s);
+				}
+
+			s_cache_path_s = copied_path_s;
+			s_cache_max_age = max_age;
+
+			pthread_mutex_unlock (&s_cache_mutex);
+		}
+
+	return success_flag;
+}
+
+
+char *GetCachedHttpResponse (const char *url_s)
+{
+	char *response_s = NULL;
+	uint32 max_age = 0;
+	char url_hash_s [ASSET_HASH_BUFFER_SIZE];
+	char *filename_s = GetResponseFilename (url_s, url_hash_s, &max_age);
+
+	if (filename_s)
+		{
+			struct stat st;
+
+			if (stat (filename_s, &st) == 0)
+				{
+					const time_t now = time (NULL);
+
+					if ((now >= st.st_mtime) && ((now - st.st_mtime) < (time_t) max_age))
+						{
+							response_s = ReadResponseFile (filename_s, url_hash_s);
+						}
+				}
+
+			FreeCopiedString (filename_s);
+		}
+
+	return response_s;
+}
+
+
+bool AddHttpResponseToCache (const char *url_s, const char *response_s)
+{
+	bool success_flag = true;
+	char url_hash_s [ASSET_HASH_BUFFER_SIZE];
+	char *filename_s = GetResponseFilename (url_s, url_hash_s, NULL);
+
+	if (filename_s)
+		{
+			char *temp_filename_s = ConcatenateStrings (filename_s, ".XXXXXX");
+
+			success_flag = false;
+
+			if (temp_filename_s)
+				{
+					/* Write to a temporary file so that readers never see a partially written response */
+					int fd = mkstemp (temp_filename_s);
+
+					if (fd != -1)
+						{
+							FILE *out_f = fdopen (fd, "w");
+
+							if (out_f)
+								{
+									/* The urls can contain api keys so only a hash of them is stored */
+									bool written_flag = (fprintf (out_f, "%s\n%s", url_hash_s, response_s) >= 0);
+
+									if (fclose (out_f) != 0)
+										{
+											written_flag = false;
+										}
+
+									if (written_flag)
+										{
+											if (rename (temp_filename_s, filename_s) == 0)
+												{
+													success_flag = true;
+												}
+											else
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to rename \"%s\" to \"%s\"", temp_filename_s, filename_s);
+												}
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to write response to \"%s\"", temp_filename_s);
+										}
+								}
+							else
+								{
+									close (fd);
+								}
+
+							/* This does nothing if the file was renamed into place */
+							remove (temp_filename_s);
+						}		/* if (fd != -1) */
+					else
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to create temporary file for \"%s\"", filename_s);
+						}
+
+					FreeCopiedString (temp_filename_s);
+				}		/* if (temp_filename_s) */
+
+			FreeCopiedString (filename_s);
+		}		/* if (filename_s) */
+
+	return success_flag;
+}
+
+
+/*
+ * Get the name of the file that caches the response for a url or NULL
+ * if the cache is disabled. hash_s is filled in with the url's hash.
+ */
+static char *GetResponseFilename (const char *url_s, char hash_s [ASSET_HASH_BUFFER_SIZE], uint32 *max_age_p)
+{
+	char *filename_s = NULL;
+
+	GetStringContentHash (url_s, hash_s);
+
+	pthread_mutex_lock (&s_cache_mutex);
+
+	if (s_cache_path_s)
+		{
+			char *local_filename_s = ConcatenateStrings (hash_s, S_RESPONSE_SUFFIX_S);
+
+			if (local_filename_s)
+				{
+					filename_s = MakeFilename (s_cache_path_s, local_filename_s);
+					FreeCopiedString (local_filename_s);
+				}
+
+			if (max_age_p)
+				{
+					*max_age_p = s_cache_max_age;
+				}
+		}
+
+	pthread_mutex_unlock (&s_cache_mutex);
+
+	return filename_s;
+}
+
+
+/*
+ * Each file is the hash of the url on the first line followed by the response body.
+ */
+static char *ReadResponseFile (const char *filename_s, const char *url_hash_s)
+{
+	char *response_s = NULL;
+	FILE *in_f = fopen (filename_s, "r");
+
+	if (in_f)
+		{
+			if (fseek (in_f, 0, SEEK_END) == 0)
+				{
+					const long size = ftell (in_f);
+
+					if ((size > 0) && (fseek (in_f, 0, SEEK_SET) == 0))
+						{
+							char *buffer_s = (char *) AllocMemory (((size_t) size) + 1);
+
+							if (buffer_s)
+								{
+									if (fread (buffer_s, 1, (size_t) size, in_f) == (size_t) size)
+										{
+											const size_t hash_length = strlen (url_hash_s);
+
+											* (buffer_s + size) = '\0';
+
+											/* Skip files that weren't written by AddHttpResponseToCache () */
+											if ((((size_t) size) > hash_length) && (strncmp (buffer_s, url_hash_s, hash_length) == 0) && (* (buffer_s + hash_length) == '\n'))
+												{
+													response_s = EasyCopyToNewString (buffer_s + hash_length + 1);
+												}
+										}
+
+									FreeMemory (buffer_s);
+								}
+						}
+				}
+
+			fclose (in_f);
+		}
+
+	return response_s;
+}
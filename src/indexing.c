@@ -34,6 +34,8 @@
 #include "treatment_jobs.h"
 #include "audit.h"
 #include "row_jobs.h"
+#include "study_memory_cache.h"
+#include "study_reindexer.h"
 
 
 #include "boolean_parameter.h"
@@ -77,6 +79,8 @@
 #include "jansson.h"
 
 #include "material.h"
+#include "material_usage.h"
+#include "study_post_save_queue.h"
 #include "plot.h"
 #include "measured_variable.h"
 
@@ -120,6 +124,12 @@ static NamedParameterType S_GENERATE_STUDY_STATISTICS = { "SS Generate Phenotype
 
 static NamedParameterType S_ADD_MONGODB_INDEXES = { "SS Add MongoDB Indexes", PT_BOOLEAN };
 
+static NamedParameterType S_GEOCODE_LOCATIONS = { "SS Geocode Locations", PT_BOOLEAN };
+
+static NamedParameterType S_REBUILD_MATERIAL_USAGE = { "SS Rebuild Material Usage", PT_BOOLEAN };
+
+static NamedParameterType S_POST_SAVE_STATUS = { "SS Post-save status", PT_STRING };
+
 
 static const char *GetFieldTrialIndexingServiceName (const Service *service_p);
 
@@ -154,6 +164,10 @@ static bool CloseFieldTrialIndexingService (Service *service_p);
 
 static void GetCacheList (ServiceJob *job_p, const bool full_path_flag, const FieldTrialServiceData *data_p);
 
+static bool AddStudyMemoryCacheStatisticsToServiceJob (ServiceJob *job_p);
+
+static OperationStatus AddStudyPostSaveStatusToServiceJob (const char * const id_s, ServiceJob *job_p, FieldTrialServiceData *data_p);
+
 static LinkedList *GetFieldTrialFiles (const char * const path_s, const char * const local_pattern_s, const bool full_path_flag);
 
 static OperationStatus GenerateAllFrictionlessDataStudies (ServiceJob *job_p, FieldTrialServiceData *data_p);
@@ -170,6 +184,8 @@ static OperationStatus CreateMongoRevisionsCollections (FieldTrialServiceData *d
 
 static OperationStatus CreateMongoRevisionsCollection (MongoTool *tool_p, const char *database_s, const char *collection_s);
 
+static OperationStatus ReindexStudiesOneAtATime (ServiceJob *job_p, const FieldTrialServiceData *service_data_p);
+
 
 /*
  * API definitions
@@ -449,6 +465,7 @@ static bool RunCaching (ParameterSet *param_set_p, ServiceJob *job_p, FieldTrial
 
 									if (strcmp (entries_s, "*") == 0)
 										{
+											ClearStudyMemoryCache ();
 											entries_p = GetFieldTrialFiles (data_p -> dftsd_study_cache_path_s, "*.json", false);
 										}
 									else
@@ -467,7 +484,11 @@ static bool RunCaching (ParameterSet *param_set_p, ServiceJob *job_p, FieldTrial
 
 											while (node_p)
 												{
-													char *filename_s = GetFullCacheFilename (node_p -> sln_string_s, data_p);
+													char *filename_s = NULL;
+
+													RemoveStudyFromMemoryCache (node_p -> sln_string_s);
+
+													filename_s = GetFullCacheFilename (node_p -> sln_string_s, data_p);
 
 													if (filename_s)
 														{
@@ -719,6 +740,7 @@ static void GetCacheList (ServiceJob *job_p, const bool full_path_flag, const Fi
 					PrintErrors (STM_LEVEL_INFO, __FILE__, __LINE__, "No cached files in \"%s\"", data_p -> dftsd_study_cache_path_s);
 				}
 
+			AddStudyMemoryCacheStatisticsToServiceJob (job_p);
 		}		/* if (data_p -> dftsd_study_cache_path_s) */
 	else
 		{
@@ -728,6 +750,80 @@ static void GetCacheList (ServiceJob *job_p, const bool full_path_flag, const Fi
 }
 
 
+static bool AddStudyMemoryCacheStatisticsToServiceJob (ServiceJob *job_p)
+{
+	bool success_flag = false;
+	json_t *stats_p = GetStudyMemoryCacheStatisticsAsJSON ();
+
+	if (stats_p)
+		{
+			json_t *dest_record_p = GetDataResourceAsJSONByParts (PROTOCOL_INLINE_S, NULL, "Study Memory Cache", stats_p);
+
+			if (dest_record_p)
+				{
+					if (AddResultToServiceJob (job_p, dest_record_p))
+						{
+							success_flag = true;
+						}
+					else
+						{
+							json_decref (dest_record_p);
+							PrintErrors (STM_LEVEL_INFO, __FILE__, __LINE__, "AddResultToServiceJob failed for study memory cache statistics");
+						}
+
+				}		/* if (dest_record_p) */
+			else
+				{
+					PrintJSONToErrors (STM_LEVEL_INFO, __FILE__, __LINE__, stats_p, "GetDataResourceAsJSONByParts failed for study memory cache statistics");
+				}
+
+			json_decref (stats_p);
+		}		/* if (stats_p) */
+
+	return success_flag;
+}
+
+
+static OperationStatus AddStudyPostSaveStatusToServiceJob (const char * const id_s, ServiceJob *job_p, FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	bson_oid_t *id_p = GetBSONOidFromString (id_s);
+
+	if (id_p)
+		{
+			json_t *entries_p = GetStudyPostSaveStatus (id_p, data_p);
+
+			if (entries_p)
+				{
+					json_t *dest_record_p = GetDataResourceAsJSONByParts (PROTOCOL_INLINE_S, NULL, id_s, entries_p);
+
+					if (dest_record_p)
+						{
+							if (AddResultToServiceJob (job_p, dest_record_p))
+								{
+									status = OS_SUCCEEDED;
+								}
+							else
+								{
+									json_decref (dest_record_p);
+									PrintErrors (STM_LEVEL_INFO, __FILE__, __LINE__, "AddResultToServiceJob failed for post-save status of \"%s\"", id_s);
+								}
+						}
+
+					json_decref (entries_p);
+				}
+
+			FreeBSONOid (id_p);
+		}
+	else
+		{
+			AddParameterErrorMessageToServiceJob (job_p, S_POST_SAVE_STATUS.npt_name_s, S_POST_SAVE_STATUS.npt_type, "Invalid Study Id");
+		}
+
+	return status;
+}
+
+
 static LinkedList *GetFieldTrialFiles (const char * const path_s, const char * const local_pattern_s, const bool full_path_flag)
 {
 	LinkedList *files_p = NULL;
@@ -869,6 +965,23 @@ OperationStatus ReindexAllData (ServiceJob *job_p, const bool update_flag, const
 
 
 OperationStatus ReindexStudies (ServiceJob *job_p, LuceneTool *lucene_p, bool update_flag, const FieldTrialServiceData *service_data_p)
+{
+	OperationStatus status = OS_FAILED;
+
+	if (service_data_p -> dftsd_reindex_num_workers > 1)
+		{
+			status = ReindexStudiesInParallel (job_p, service_data_p);
+		}
+	else
+		{
+			status = ReindexStudiesOneAtATime (job_p, service_data_p);
+		}
+
+	return status;
+}
+
+
+static OperationStatus ReindexStudiesOneAtATime (ServiceJob *job_p, const FieldTrialServiceData *service_data_p)
 {
 	OperationStatus status = OS_FAILED;
 	json_t *id_results_p = GetAllStudyIds (service_data_p -> dftsd_base_data.sd_service_p);
@@ -1383,6 +1496,36 @@ static ServiceJobSet *RunFieldTrialIndexingService (Service *service_p, Paramete
 								}
 						}
 
+					if (GetCurrentBooleanParameterValueFromParameterSet (param_set_p, S_GEOCODE_LOCATIONS.npt_name_s, &run_flag_p))
+						{
+							if ((run_flag_p != NULL) && (*run_flag_p == true))
+								{
+									OperationStatus s = GeocodeAllLocations (job_p, data_p);
+
+									MergeServiceJobStatus (job_p, s);
+								}
+						}
+
+					if (GetCurrentBooleanParameterValueFromParameterSet (param_set_p, S_REBUILD_MATERIAL_USAGE.npt_name_s, &run_flag_p))
+						{
+							if ((run_flag_p != NULL) && (*run_flag_p == true))
+								{
+									OperationStatus s = RebuildMaterialUsage (data_p);
+
+									MergeServiceJobStatus (job_p, s);
+								}
+						}
+
+					if (GetCurrentStringParameterValueFromParameterSet (param_set_p, S_POST_SAVE_STATUS.npt_name_s, &id_s))
+						{
+							if (!IsStringEmpty (id_s))
+								{
+									OperationStatus s = AddStudyPostSaveStatusToServiceJob (id_s, job_p, data_p);
+
+									MergeServiceJobStatus (job_p, s);
+								}
+						}
+
 				}
 
 		}
@@ -1489,6 +1632,11 @@ static OperationStatus StoreAllRResScaleUnits (json_t *terms_p, FieldTrialServic
 							status = OS_PARTIALLY_SUCCEEDED;
 						}
 
+					if (num_succeeded > 0)
+						{
+							InvalidateMeasuredVariablesCaches ();
+						}
+
 					bson_destroy (query_p);
 				}		/* if (query_p) */
 			else
@@ -1528,6 +1676,9 @@ static bool GetIndexingParameterTypeForNamedParameter (const Service * UNUSED_PA
 			S_ROTHAMSTED_TERMS,
 			S_GENERATE_STUDY_STATISTICS,
 			S_ADD_MONGODB_INDEXES,
+			S_GEOCODE_LOCATIONS,
+			S_REBUILD_MATERIAL_USAGE,
+			S_POST_SAVE_STATUS,
 			NULL
 		};
 
@@ -1586,7 +1737,16 @@ static ParameterSet *GetFieldTrialIndexingServiceParameters (Service *service_p,
 																																		{
 																																			if ((param_p = EasyCreateAndAddBooleanParameterToParameterSet (data_p, params_p, manager_group_p, S_ADD_MONGODB_INDEXES.npt_name_s, "Add MongoDB Indexes", "Add MongoDB Indexes for faster data handling", &b, PL_ALL)) != NULL)
 																																				{
-																																					return params_p;
+																																					if ((param_p = EasyCreateAndAddBooleanParameterToParameterSet (data_p, params_p, manager_group_p, S_GEOCODE_LOCATIONS.npt_name_s, "Geocode Locations", "Look up the GPS coordinates for any Locations that do not have them", &b, PL_ALL)) != NULL)
+																																						{
+																																							if ((param_p = EasyCreateAndAddBooleanParameterToParameterSet (data_p, params_p, manager_group_p, S_REBUILD_MATERIAL_USAGE.npt_name_s, "Rebuild Material Usage", "Rebuild the record of which Plots each Material was used in from all of the stored Plots", &b, PL_ALL)) != NULL)
+																																								{
+																																									if ((param_p = EasyCreateAndAddStringParameterToParameterSet (data_p, params_p, manager_group_p, S_POST_SAVE_STATUS.npt_type, S_POST_SAVE_STATUS.npt_name_s, "Post-save status", "Get the status of the background rebuilds for the given Study Id", NULL, PL_ALL)) != NULL)
+																																										{
+																																											return params_p;
+																																										}
+																																								}
+																																						}
 																																				}
 																																		}
 																																}
@@ -1894,7 +2054,7 @@ static OperationStatus CreateMongoIndexes (FieldTrialServiceData *data_p)
 					if (AddCollectionSingleIndex (tool_p, NULL, data_p -> dftsd_collection_ss [DFTD_PLOT], PL_PARENT_STUDY_S, NULL, false, false))
 						{
 							uint32 i = 0;
-							const uint32 num_keys = 2;
+							const uint32 num_keys = 3;
 							OperationStatus revisions_status = OS_FAILED;
 
 							/* Measured Variables */
@@ -1923,6 +2083,22 @@ static OperationStatus CreateMongoIndexes (FieldTrialServiceData *data_p)
 									FreeRowsNameKey (key_s);
 								}
 
+							/*
+							 * Materials by case-insensitive accession. Any Materials saved
+							 * before the accession keys were added need them adding first.
+							 */
+							if (AddMaterialAccessionKeys (data_p) != OS_FAILED)
+								{
+									keys_array_ss [0] = MA_ACCESSION_KEY_S;
+									keys_array_ss [1] = MA_GENE_BANK_ID_S;
+									keys_array_ss [2] = NULL;
+
+									if (AddCollectionCompoundIndex (tool_p, NULL, data_p -> dftsd_collection_ss [DFTD_MATERIAL], keys_ss, false, false))
+										{
+											++ i;
+										}
+								}
+
 							status = (i == num_keys) ? OS_SUCCEEDED : OS_PARTIALLY_SUCCEEDED;
 
 							revisions_status = CreateMongoRevisionsCollections (data_p);
@@ -31,17 +31,17 @@ static bool GetIntegerValueAsString (const struct Observation *observation_p, Ob
 IntegerObservation *AllocateIntegerObservation (bson_oid_t *id_p, const ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p,
 																								MEM_FLAG phenotype_mem, const int32 *raw_value_p, const int32 *corrected_value_p,
 																								const char *growth_stage_s, const char *method_s, Instrument *instrument_p,
-																								const ObservationNature nature, const char *notes_s)
+																								const ObservationNature nature, const char *notes_s, StudyArena *arena_p)
 {
 	int32 *copied_raw_value_p = NULL;
 
-	if (CopyValidInteger (raw_value_p, &copied_raw_value_p))
+	if (CopyValidStudyInteger (arena_p, raw_value_p, &copied_raw_value_p))
 		{
 			int32 *copied_corrected_value_p = NULL;
 
-			if (CopyValidInteger (corrected_value_p, &copied_corrected_value_p))
+			if (CopyValidStudyInteger (arena_p, corrected_value_p, &copied_corrected_value_p))
 				{
-					IntegerObservation *observation_p = (IntegerObservation *) AllocMemory (sizeof (IntegerObservation));
+					IntegerObservation *observation_p = (IntegerObservation *) AllocStudyMemory (arena_p, sizeof (IntegerObservation));
 
 					if (observation_p)
 						{
@@ -49,7 +49,7 @@ IntegerObservation *AllocateIntegerObservation (bson_oid_t *id_p, const Observat
 
 							if (InitObservation (& (observation_p -> io_base_observation), id_p, metadata_p, phenotype_p, phenotype_mem, growth_stage_s, method_s, instrument_p, nature, notes_s, OT_INTEGER,
 																	 ClearIntegerObservation, AddIntegerObservationValuesToJSON, SetIntegerObservationValueFromJSON, SetIntegerObservationValueFromString,
-																	 GetIntegerValueAsString))
+																	 GetIntegerValueAsString, arena_p))
 								{
 									observation_p -> io_raw_value_p = copied_raw_value_p;
 									observation_p -> io_corrected_value_p = copied_corrected_value_p;
@@ -59,18 +59,18 @@ IntegerObservation *AllocateIntegerObservation (bson_oid_t *id_p, const Observat
 
 							ClearObservation (& (observation_p -> io_base_observation));
 							ClearIntegerObservation (& (observation_p -> io_base_observation));
-							FreeMemory (observation_p);
+							FreeStudyMemory (arena_p, observation_p);
 						}
 
 					if (copied_corrected_value_p)
 						{
-							FreeMemory (copied_corrected_value_p);
+							FreeStudyMemory (arena_p, copied_corrected_value_p);
 						}
 				}
 
 			if (copied_raw_value_p)
 				{
-					FreeMemory (copied_raw_value_p);
+					FreeStudyMemory (arena_p, copied_raw_value_p);
 				}
 		}
 
@@ -85,14 +85,14 @@ void ClearIntegerObservation (Observation *observation_p)
 
 	if (int_obs_p -> io_raw_value_p)
 		{
-			FreeMemory (int_obs_p -> io_raw_value_p);
+			FreeStudyMemory (observation_p -> ob_arena_p, int_obs_p -> io_raw_value_p);
 			int_obs_p -> io_raw_value_p = NULL;
 
 		}
 
 	if (int_obs_p -> io_corrected_value_p)
 		{
-			FreeMemory (int_obs_p -> io_corrected_value_p);
+			FreeStudyMemory (observation_p -> ob_arena_p, int_obs_p -> io_corrected_value_p);
 			int_obs_p -> io_corrected_value_p = NULL;
 		}
 }
@@ -27,6 +27,7 @@
 #include "dfw_util.h"
 #include "indexing.h"
 #include "mongodb_util.h"
+#include "option_list_cache.h"
 
 
 
@@ -369,6 +370,8 @@ OperationStatus SaveLocation (Location *location_p, ServiceJob *job_p, FieldTria
 					if (SaveAndBackupMongoDataWithTimestamp (data_p -> dftsd_mongo_p, location_json_p, data_p -> dftsd_collection_ss [DFTD_LOCATION], 
 							data_p -> dftsd_backup_collection_ss [DFTD_LOCATION], DFT_BACKUPS_ID_KEY_S, selector_p, MONGO_TIMESTAMP_S))
 						{
+							ClearOptionListCache (DFTD_LOCATION, data_p);
+
 							status = IndexData (job_p, location_json_p, NULL);
 
 							if (status != OS_SUCCEEDED)
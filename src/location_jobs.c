@@ -23,12 +23,13 @@
 
 #define ALLOCATE_LOCATION_JOB_CONSTANTS (1)
 #include "location_jobs.h"
-#include "geocoder_util.h"
+#include "geocode_cache.h"
 #include "string_utils.h"
 #include "dfw_util.h"
 
 #include "boolean_parameter.h"
 #include "double_parameter.h"
+#include "option_list_cache.h"
 
 
 static const char *DEFAULT_COORD_PRECISION_S = "6";
@@ -644,8 +645,6 @@ static bool AddLocation (ServiceJob *job_p, ParameterSet *param_set_p, FieldTria
 
 					if (address_p)
 						{
-							GrassrootsServer *grassroots_p = GetGrassrootsServerFromService (job_p -> sj_service_p);
-
 							if ((use_gps_flag_p != NULL) && (*use_gps_flag_p == true))
 								{
 									const double64 *latitude_p = NULL;
@@ -690,13 +689,13 @@ static bool AddLocation (ServiceJob *job_p, ParameterSet *param_set_p, FieldTria
 								}		/* if (use_gps_value.st_boolean_value) */
 							else
 								{
-									if (DetermineGPSLocationForAddress (address_p, NULL, grassroots_p))
+									if (GeocodeAddress (address_p, data_p))
 										{
 											success_flag = true;
 										}
 									else
 										{
-											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "DetermineGPSLocationForAddress faialed for %s", address_p -> ad_name_s);
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GeocodeAddress failed for %s", address_p -> ad_name_s);
 											AddGeneralErrorMessageToServiceJob (job_p, "Unable to determine GPS coordinate");
 										}
 								}
@@ -757,8 +756,7 @@ static bool AddLocation (ServiceJob *job_p, ParameterSet *param_set_p, FieldTria
 bool SetUpLocationsListParameter (const FieldTrialServiceData *data_p, StringParameter *param_p, const Location *active_location_p, const char *extra_option_s)
 {
 	bool success_flag = false;
-	bson_t *opts_p =  BCON_NEW ( "sort", "{", "name", BCON_INT32 (1), "}");
-	json_t *results_p = GetAllLocationsAsJSON (data_p, opts_p);
+	json_t *results_p = GetOptionListDocuments (DFTD_LOCATION, data_p);
 	bool value_set_flag = false;
 
 	if (results_p)
@@ -859,11 +857,6 @@ bool SetUpLocationsListParameter (const FieldTrialServiceData *data_p, StringPar
 			json_decref (results_p);
 		}		/* if (results_p) */
 
-	if (opts_p)
-		{
-			bson_destroy (opts_p);
-		}
-
 	return success_flag;
 }
 
@@ -907,6 +900,121 @@ json_t *GetLocationIndexingData (Service *service_p)
 }
 
 
+OperationStatus GeocodeAllLocations (ServiceJob *job_p, FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	json_t *locations_p = GetAllLocationsAsJSON (data_p, NULL);
+
+	if (locations_p)
+		{
+			const size_t num_results = json_array_size (locations_p);
+			Location **locations_pp = NULL;
+			Address **addresses_pp = NULL;
+			uint32 num_locations = 0;
+
+			if (num_results > 0)
+				{
+					locations_pp = (Location **) AllocMemoryArray (num_results, sizeof (Location *));
+					addresses_pp = (Address **) AllocMemoryArray (num_results, sizeof (Address *));
+				}
+
+			if (locations_pp && addresses_pp)
+				{
+					size_t i;
+					json_t *location_json_p;
+
+					/* Only the Locations without GPS coordinates need geocoding */
+					json_array_foreach (locations_p, i, location_json_p)
+						{
+							Location *location_p = GetLocationFromJSON (location_json_p, data_p);
+
+							if (location_p)
+								{
+									if ((location_p -> lo_address_p) && (! (location_p -> lo_address_p -> ad_gps_centre_p)))
+										{
+											* (locations_pp + num_locations) = location_p;
+											* (addresses_pp + num_locations) = location_p -> lo_address_p;
+											++ num_locations;
+										}
+									else
+										{
+											FreeLocation (location_p);
+										}
+								}
+							else
+								{
+									PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, location_json_p, "GetLocationFromJSON () failed");
+								}
+						}
+
+					if (num_locations > 0)
+						{
+							const uint32 num_geocoded = GeocodeAddresses (addresses_pp, num_locations, data_p);
+							uint32 num_saved = 0;
+							uint32 j;
+
+							for (j = 0; j < num_locations; ++ j)
+								{
+									Location *location_p = * (locations_pp + j);
+
+									if (location_p -> lo_address_p -> ad_gps_centre_p)
+										{
+											OperationStatus save_status = SaveLocation (location_p, job_p, data_p);
+
+											if ((save_status == OS_SUCCEEDED) || (save_status == OS_PARTIALLY_SUCCEEDED))
+												{
+													++ num_saved;
+												}
+										}
+
+									FreeLocation (location_p);
+								}
+
+							PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Geocoded " UINT32_FMT " and saved " UINT32_FMT " of " UINT32_FMT " locations", num_geocoded, num_saved, num_locations);
+
+							if (num_saved == num_locations)
+								{
+									status = OS_SUCCEEDED;
+								}
+							else if (num_saved > 0)
+								{
+									status = OS_PARTIALLY_SUCCEEDED;
+								}
+						}
+					else
+						{
+							status = OS_SUCCEEDED;
+						}
+
+				}		/* if (locations_pp && addresses_pp) */
+			else if (num_results == 0)
+				{
+					status = OS_SUCCEEDED;
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate memory to geocode " SIZET_FMT " locations", num_results);
+				}
+
+			if (addresses_pp)
+				{
+					FreeMemory (addresses_pp);
+				}
+
+			if (locations_pp)
+				{
+					FreeMemory (locations_pp);
+				}
+
+			json_decref (locations_p);
+		}		/* if (locations_p) */
+
+	SetServiceJobStatus (job_p, status);
+
+	return status;
+}
+
+
 json_t *GetAllLocationsAsJSON (const FieldTrialServiceData *data_p, bson_t *opts_p)
 {
 	json_t *results_p = NULL;
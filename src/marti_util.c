@@ -5,7 +5,13 @@
  *      Author: billy
  */
 
+#include <math.h>
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
 #include "marti_util.h"
+#include "indexing.h"
 
 #include "marti_service_data.h"
 #include "marti_search_service.h"
@@ -15,18 +21,142 @@
 #include "time_parameter.h"
 
 
+static const char * const S_MARTI_SAMPLES_S = "marti_samples";
+
+static const char * const S_MARTI_STATUS_S = "marti_status";
+
+static const char * const S_MARTI_STATUS_READY_S = "ready";
+
+static const char * const S_MARTI_STATUS_PENDING_S = "pending";
+
+static const char * const S_MARTI_STATUS_UNAVAILABLE_S = "unavailable";
+
+/*
+ * How long to wait before trying again for an area
+ * where the search failed.
+ */
+static const time_t S_FAILED_RETRY_DELAY = 300;
+
+
+/**
+ * The MARTi samples found for an area around a location.
+ */
+typedef struct MartiCacheEntry
+{
+	/** The base list node. */
+	ListItem mce_node;
+
+	/** The key made from the area. */
+	char *mce_key_s;
+
+	/** The latitude of the centre of the area. */
+	double64 mce_latitude;
+
+	/** The longitude of the centre of the area. */
+	double64 mce_longitude;
+
+	/**
+	 * The links to the MARTi samples or <code>NULL</code> if the
+	 * search has not succeeded yet.
+	 */
+	json_t *mce_samples_p;
+
+	/**
+	 * When the search for this area was last run or 0 if it
+	 * has not finished yet.
+	 */
+	time_t mce_fetched_time;
+
+	/** When the samples for this area were last asked for. */
+	time_t mce_last_used_time;
+
+	/** Whether this entry is waiting for the refresher. */
+	bool mce_queued_flag;
+
+	/** Whether the last search for this area failed. */
+	bool mce_failed_flag;
+
+} MartiCacheEntry;
+
+
+/**
+ * The cached MARTi samples along with the thread that
+ * fetches them. The settings are taken from the first
+ * service to use the cache so that every service shares
+ * the same areas.
+ */
+typedef struct MartiCache
+{
+	pthread_mutex_t mc_mutex;
+
+	pthread_cond_t mc_cond;
+
+	/** The MartiCacheEntries. */
+	LinkedList *mc_entries_p;
+
+	/** The number of seconds that the samples for an area are used for. */
+	uint32 mc_ttl;
+
+	/** The maximum number of areas to keep. */
+	uint32 mc_max_entries;
+
+	/** The size, in degrees, of the grid cells that locations are snapped to. */
+	double64 mc_cell_size;
+
+	/** Set by StopMartiCache () to make the refresher exit. */
+	bool mc_stop_flag;
+
+	/** The server used to create the refresher's own Service. */
+	GrassrootsServer *mc_grassroots_p;
+
+	pthread_t mc_refresher;
+
+} MartiCache;
+
+
+/*
+ * The cache is shared by all of the services in this process and
+ * lasts until StopMartiCache () is called when this library is
+ * unloaded.
+ */
+static MartiCache *s_cache_p = NULL;
+
+static pthread_mutex_t s_cache_init_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
 static bool AddMartiSearchParametersByValues (ParameterSet *param_set_p, ParameterGroup *param_group_p, const double64 *latitude_p, const double64 *longitude_p, const struct tm *date_p, ServiceData *data_p);
 
-static OperationStatus SearchMarti (const double64 *latitude_p, const double64 *longitude_p, const struct tm *date_p, json_t *study_json_p, const FieldTrialServiceData *ft_service_data_p);
+static json_t *SearchMarti (const double64 *latitude_p, const double64 *longitude_p, const struct tm *date_p, const FieldTrialServiceData *ft_service_data_p);
+
+static json_t *GetMartiLinks (json_t *results_json_p, const char * const marti_service_name_s, const FieldTrialServiceData *service_data_p);
+
+static MartiCache *GetMartiCache (const FieldTrialServiceData *data_p);
+
+static MartiCache *AllocateMartiCache (const FieldTrialServiceData *data_p);
+
+static void StopMartiCache (void) __attribute__ ((destructor));
+
+static void FreeMartiCache (MartiCache *cache_p);
+
+static MartiCacheEntry *GetMartiCacheEntry (MartiCache *cache_p, const double64 latitude, const double64 longitude);
+
+static MartiCacheEntry *AllocateMartiCacheEntry (char *key_s, const double64 latitude, const double64 longitude);
+
+static void FreeMartiCacheEntry (ListItem *node_p);
+
+static void RemoveLeastRecentlyUsedMartiCacheEntry (MartiCache *cache_p);
+
+static bool IsMartiCacheEntryStale (const MartiCacheEntry *entry_p, const MartiCache *cache_p, const time_t now);
+
+static void *RunMartiCacheRefresher (void *data_p);
 
-static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, const char * const marti_service_name_s, const FieldTrialServiceData *service_data_p);
 
 
 OperationStatus AddMartiResults (Study *study_p, json_t *study_json_p, const ViewFormat format, const FieldTrialServiceData *data_p)
 {
 	OperationStatus status = OS_IDLE;
 
-	if (study_p -> st_location_p)
+	if ((data_p -> dftsd_grassroots_marti_search_url_s) && (study_p -> st_location_p))
 		{
 			if (study_p -> st_location_p -> lo_address_p)
 				{
@@ -34,11 +164,68 @@ OperationStatus AddMartiResults (Study *study_p, json_t *study_json_p, const Vie
 
 					if (c_p)
 						{
-							const struct tm *date_p = NULL;
+							MartiCache *cache_p = GetMartiCache (data_p);
 
-							status = SearchMarti (& (c_p -> co_x), & (c_p -> co_y), date_p, study_json_p, data_p);
+							if (cache_p)
+								{
+									const char *marti_status_s = S_MARTI_STATUS_UNAVAILABLE_S;
+									MartiCacheEntry *entry_p = NULL;
 
-						}
+									status = OS_FAILED;
+
+									pthread_mutex_lock (& (cache_p -> mc_mutex));
+
+									entry_p = GetMartiCacheEntry (cache_p, c_p -> co_x, c_p -> co_y);
+
+									if (entry_p)
+										{
+											const time_t now = time (NULL);
+
+											entry_p -> mce_last_used_time = now;
+
+											/*
+											 * Use whatever we have now and let the refresher
+											 * update it for the next time
+											 */
+											if ((!entry_p -> mce_queued_flag) && (IsMartiCacheEntryStale (entry_p, cache_p, now)))
+												{
+													entry_p -> mce_queued_flag = true;
+													pthread_cond_signal (& (cache_p -> mc_cond));
+												}
+
+											if (entry_p -> mce_samples_p)
+												{
+													json_t *samples_p = json_deep_copy (entry_p -> mce_samples_p);
+
+													if (samples_p)
+														{
+															if (json_object_set_new (study_json_p, S_MARTI_SAMPLES_S, samples_p) == 0)
+																{
+																	marti_status_s = S_MARTI_STATUS_READY_S;
+																	status = OS_SUCCEEDED;
+																}
+															else
+																{
+																	json_decref (samples_p);
+																}
+														}
+												}
+											else if (entry_p -> mce_queued_flag)
+												{
+													marti_status_s = S_MARTI_STATUS_PENDING_S;
+													status = OS_IDLE;
+												}
+										}
+
+									pthread_mutex_unlock (& (cache_p -> mc_mutex));
+
+									if (!SetJSONString (study_json_p, S_MARTI_STATUS_S, marti_status_s))
+										{
+											PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, study_json_p, "Failed to set \"%s\" to \"%s\"", S_MARTI_STATUS_S, marti_status_s);
+										}
+								}		/* if (cache_p) */
+
+						}		/* if (c_p) */
 				}
 		}
 
@@ -46,9 +233,354 @@ OperationStatus AddMartiResults (Study *study_p, json_t *study_json_p, const Vie
 }
 
 
-static OperationStatus SearchMarti (const double64 *latitude_p, const double64 *longitude_p, const struct tm *date_p, json_t *study_json_p, const FieldTrialServiceData *ft_service_data_p)
+bool IsMartiResultPending (const json_t *study_json_p)
+{
+	const char *marti_status_s = GetJSONString (study_json_p, S_MARTI_STATUS_S);
+
+	return ((marti_status_s != NULL) && (strcmp (marti_status_s, S_MARTI_STATUS_PENDING_S) == 0));
+}
+
+
+/*
+ * Called when this library is unloaded. If the refresher is in the
+ * middle of a search, this waits for it to finish.
+ */
+static void StopMartiCache (void)
+{
+	pthread_mutex_lock (&s_cache_init_mutex);
+
+	if (s_cache_p)
+		{
+			pthread_mutex_lock (& (s_cache_p -> mc_mutex));
+			s_cache_p -> mc_stop_flag = true;
+			pthread_cond_signal (& (s_cache_p -> mc_cond));
+			pthread_mutex_unlock (& (s_cache_p -> mc_mutex));
+
+			pthread_join (s_cache_p -> mc_refresher, NULL);
+
+			PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Stopped MARTi cache refresher");
+
+			FreeMartiCache (s_cache_p);
+			s_cache_p = NULL;
+		}
+
+	pthread_mutex_unlock (&s_cache_init_mutex);
+}
+
+
+static void FreeMartiCache (MartiCache *cache_p)
+{
+	FreeLinkedList (cache_p -> mc_entries_p);
+
+	pthread_cond_destroy (& (cache_p -> mc_cond));
+	pthread_mutex_destroy (& (cache_p -> mc_mutex));
+
+	FreeMemory (cache_p);
+}
+
+
+static MartiCache *GetMartiCache (const FieldTrialServiceData *data_p)
+{
+	MartiCache *cache_p = NULL;
+
+	pthread_mutex_lock (&s_cache_init_mutex);
+
+	if (!s_cache_p)
+		{
+			s_cache_p = AllocateMartiCache (data_p);
+		}
+
+	cache_p = s_cache_p;
+
+	pthread_mutex_unlock (&s_cache_init_mutex);
+
+	return cache_p;
+}
+
+
+static MartiCache *AllocateMartiCache (const FieldTrialServiceData *data_p)
+{
+	MartiCache *cache_p = (MartiCache *) AllocMemory (sizeof (MartiCache));
+
+	if (cache_p)
+		{
+			cache_p -> mc_entries_p = AllocateLinkedList (FreeMartiCacheEntry);
+
+			if (cache_p -> mc_entries_p)
+				{
+					pthread_mutex_init (& (cache_p -> mc_mutex), NULL);
+					pthread_cond_init (& (cache_p -> mc_cond), NULL);
+
+					cache_p -> mc_ttl = data_p -> dftsd_marti_cache_ttl;
+					cache_p -> mc_max_entries = data_p -> dftsd_marti_cache_max_entries;
+					cache_p -> mc_cell_size = (data_p -> dftsd_marti_cell_size > 0.0) ? data_p -> dftsd_marti_cell_size : 0.01;
+					cache_p -> mc_stop_flag = false;
+					cache_p -> mc_grassroots_p = data_p -> dftsd_base_data.sd_service_p -> se_grassroots_p;
+
+					if (pthread_create (& (cache_p -> mc_refresher), NULL, RunMartiCacheRefresher, cache_p) == 0)
+						{
+							PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Started MARTi cache refresher with a ttl of " UINT32_FMT " seconds", cache_p -> mc_ttl);
+							return cache_p;
+						}
+
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to start MARTi cache refresher");
+
+					pthread_cond_destroy (& (cache_p -> mc_cond));
+					pthread_mutex_destroy (& (cache_p -> mc_mutex));
+
+					FreeLinkedList (cache_p -> mc_entries_p);
+				}		/* if (cache_p -> mc_entries_p) */
+
+			FreeMemory (cache_p);
+		}		/* if (cache_p) */
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate MARTi cache, MARTi samples will not be added to studies");
+
+	return NULL;
+}
+
+
+/*
+ * This must be called with the cache's mutex locked. The location is
+ * snapped to a cell of the cache's size so that nearby studies share
+ * an entry. If there isn't an entry already, a new one is added.
+ */
+static MartiCacheEntry *GetMartiCacheEntry (MartiCache *cache_p, const double64 latitude, const double64 longitude)
+{
+	MartiCacheEntry *entry_p = NULL;
+	const double64 cell_size = cache_p -> mc_cell_size;
+	const double64 latitude_cell = floor (latitude / cell_size);
+	const double64 longitude_cell = floor (longitude / cell_size);
+	char key_s [128];
+
+	snprintf (key_s, sizeof (key_s), "%.0f:%.0f", latitude_cell, longitude_cell);
+
+	entry_p = (MartiCacheEntry *) (cache_p -> mc_entries_p -> ll_head_p);
+
+	while (entry_p && (strcmp (entry_p -> mce_key_s, key_s) != 0))
+		{
+			entry_p = (MartiCacheEntry *) (entry_p -> mce_node.ln_next_p);
+		}
+
+	if (!entry_p)
+		{
+			char *copied_key_s = EasyCopyToNewString (key_s);
+
+			if (copied_key_s)
+				{
+					entry_p = AllocateMartiCacheEntry (copied_key_s, (latitude_cell + 0.5) * cell_size, (longitude_cell + 0.5) * cell_size);
+
+					if (entry_p)
+						{
+							if ((cache_p -> mc_max_entries > 0) && (cache_p -> mc_entries_p -> ll_size >= cache_p -> mc_max_entries))
+								{
+									RemoveLeastRecentlyUsedMartiCacheEntry (cache_p);
+								}
+
+							LinkedListAddTail (cache_p -> mc_entries_p, & (entry_p -> mce_node));
+						}
+					else
+						{
+							FreeCopiedString (copied_key_s);
+						}
+				}
+
+			if (!entry_p)
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add MARTi cache entry for \"%s\"", key_s);
+				}
+		}
+
+	return entry_p;
+}
+
+
+static MartiCacheEntry *AllocateMartiCacheEntry (char *key_s, const double64 latitude, const double64 longitude)
+{
+	MartiCacheEntry *entry_p = (MartiCacheEntry *) AllocMemory (sizeof (MartiCacheEntry));
+
+	if (entry_p)
+		{
+			InitListItem (& (entry_p -> mce_node));
+
+			entry_p -> mce_key_s = key_s;
+			entry_p -> mce_latitude = latitude;
+			entry_p -> mce_longitude = longitude;
+			entry_p -> mce_samples_p = NULL;
+			entry_p -> mce_fetched_time = 0;
+			entry_p -> mce_last_used_time = 0;
+			entry_p -> mce_queued_flag = false;
+			entry_p -> mce_failed_flag = false;
+		}
+
+	return entry_p;
+}
+
+
+static void FreeMartiCacheEntry (ListItem *node_p)
+{
+	MartiCacheEntry *entry_p = (MartiCacheEntry *) node_p;
+
+	if (entry_p -> mce_samples_p)
+		{
+			json_decref (entry_p -> mce_samples_p);
+		}
+
+	FreeCopiedString (entry_p -> mce_key_s);
+	FreeMemory (entry_p);
+}
+
+
+/*
+ * This must be called with the cache's mutex locked. Entries that are
+ * waiting for the refresher are kept since it will be looking for them.
+ */
+static void RemoveLeastRecentlyUsedMartiCacheEntry (MartiCache *cache_p)
+{
+	MartiCacheEntry *oldest_p = NULL;
+	MartiCacheEntry *entry_p = (MartiCacheEntry *) (cache_p -> mc_entries_p -> ll_head_p);
+
+	while (entry_p)
+		{
+			if (!entry_p -> mce_queued_flag)
+				{
+					if ((!oldest_p) || (entry_p -> mce_last_used_time < oldest_p -> mce_last_used_time))
+						{
+							oldest_p = entry_p;
+						}
+				}
+
+			entry_p = (MartiCacheEntry *) (entry_p -> mce_node.ln_next_p);
+		}
+
+	if (oldest_p)
+		{
+			LinkedListRemove (cache_p -> mc_entries_p, & (oldest_p -> mce_node));
+			FreeMartiCacheEntry (& (oldest_p -> mce_node));
+		}
+}
+
+
+static bool IsMartiCacheEntryStale (const MartiCacheEntry *entry_p, const MartiCache *cache_p, const time_t now)
+{
+	bool stale_flag = true;
+
+	if (entry_p -> mce_fetched_time > 0)
+		{
+			const time_t age = now - (entry_p -> mce_fetched_time);
+
+			if (entry_p -> mce_failed_flag)
+				{
+					stale_flag = (age >= S_FAILED_RETRY_DELAY);
+				}
+			else
+				{
+					stale_flag = (age >= (time_t) (cache_p -> mc_ttl));
+				}
+		}
+
+	return stale_flag;
+}
+
+
+/*
+ * Run the searches for the queued entries one at a time. The mutex
+ * is not held during a search so the serialisers never wait on MARTi.
+ */
+static void *RunMartiCacheRefresher (void *data_p)
+{
+	MartiCache *cache_p = (MartiCache *) data_p;
+
+	/*
+	 * The refresher has its own Service so that it doesn't depend
+	 * upon the one that started it still being around
+	 */
+	Service *service_p = GetFieldTrialIndexingService (cache_p -> mc_grassroots_p);
+
+	if (!service_p)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create service for MARTi cache refresher");
+			return NULL;
+		}
+
+	pthread_mutex_lock (& (cache_p -> mc_mutex));
+
+	while (! (cache_p -> mc_stop_flag))
+		{
+			MartiCacheEntry *entry_p = (MartiCacheEntry *) (cache_p -> mc_entries_p -> ll_head_p);
+			MartiCacheEntry *next_p = NULL;
+
+			/* Do the one that was asked for the longest ago first */
+			while (entry_p)
+				{
+					if (entry_p -> mce_queued_flag)
+						{
+							if ((!next_p) || (entry_p -> mce_last_used_time < next_p -> mce_last_used_time))
+								{
+									next_p = entry_p;
+								}
+						}
+
+					entry_p = (MartiCacheEntry *) (entry_p -> mce_node.ln_next_p);
+				}
+
+			if (next_p)
+				{
+					const FieldTrialServiceData *service_data_p = (const FieldTrialServiceData *) (service_p -> se_data_p);
+					const double64 latitude = next_p -> mce_latitude;
+					const double64 longitude = next_p -> mce_longitude;
+					json_t *samples_p = NULL;
+
+					/*
+					 * Queued entries are never evicted so next_p is
+					 * still valid when we get the lock back
+					 */
+					pthread_mutex_unlock (& (cache_p -> mc_mutex));
+
+					samples_p = SearchMarti (&latitude, &longitude, NULL, service_data_p);
+
+					pthread_mutex_lock (& (cache_p -> mc_mutex));
+
+					if (samples_p)
+						{
+							if (next_p -> mce_samples_p)
+								{
+									json_decref (next_p -> mce_samples_p);
+								}
+
+							next_p -> mce_samples_p = samples_p;
+							next_p -> mce_failed_flag = false;
+						}
+					else
+						{
+							/* Keep any previous samples until we can get some new ones */
+							next_p -> mce_failed_flag = true;
+						}
+
+					next_p -> mce_fetched_time = time (NULL);
+					next_p -> mce_queued_flag = false;
+				}
+			else
+				{
+					pthread_cond_wait (& (cache_p -> mc_cond), & (cache_p -> mc_mutex));
+				}
+		}
+
+	pthread_mutex_unlock (& (cache_p -> mc_mutex));
+
+	FreeService (service_p);
+
+	return NULL;
+}
+
+
+/*
+ * Get the links to the MARTi samples near a location or NULL if the
+ * search failed.
+ */
+static json_t *SearchMarti (const double64 *latitude_p, const double64 *longitude_p, const struct tm *date_p, const FieldTrialServiceData *ft_service_data_p)
 {
-	OperationStatus status = OS_FAILED;
+	json_t *marti_links_p = NULL;
 
 	if (ft_service_data_p -> dftsd_grassroots_marti_search_url_s)
 		{
@@ -72,7 +604,7 @@ static OperationStatus SearchMarti (const double64 *latitude_p, const double64 *
 									PrintJSONToLog (STM_LEVEL_INFO, __FILE__, __LINE__, res_p, "Searching \"%lf, %lf\"", *latitude_p, *longitude_p);
 
 
-									ProcessMartiResults (res_p, study_json_p, service_name_s,  ft_service_data_p);
+									marti_links_p = GetMartiLinks (res_p, service_name_s,  ft_service_data_p);
 
 
 									json_decref (res_p);
@@ -85,11 +617,8 @@ static OperationStatus SearchMarti (const double64 *latitude_p, const double64 *
 
 
 		}		/* if (ft_service_data_p -> dftsd_grassroots_marti_search_url_s) */
-	else
-		{
-			status = OS_IDLE;
-		}
-	return status;
+
+	return marti_links_p;
 }
 
 
@@ -151,8 +680,9 @@ static bool AddMartiSearchParametersByValues (ParameterSet *param_set_p, Paramet
 }
 
 
-static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, const char * const marti_service_name_s, const FieldTrialServiceData *service_data_p)
+static json_t *GetMartiLinks (json_t *results_json_p, const char * const marti_service_name_s, const FieldTrialServiceData *service_data_p)
 {
+	json_t *marti_links_p = NULL;
 	json_t *services_json_p = json_object_get (results_json_p, SERVICE_RESULTS_S);
 
 	if (json_is_array (services_json_p))
@@ -162,6 +692,11 @@ static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, c
 
 			json_array_foreach (services_json_p, i, job_p)
 				{
+					if (marti_links_p)
+						{
+							break;
+						}
+
 					const char *service_name_s = GetJSONString (job_p, JOB_SERVICE_S);
 
 					if (service_name_s)
@@ -174,7 +709,7 @@ static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, c
 										{
 											if (((OperationStatus) status) == OS_SUCCEEDED)
 												{
-													json_t *marti_links_p = json_array ();
+													marti_links_p = json_array ();
 
 													if (marti_links_p)
 														{
@@ -231,6 +766,8 @@ static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, c
 																											json_decref (marti_p);
 																										}
 																								}
+
+																							FreeCopiedString (url_s);
 																						}
 
 																				}		/* if (marti_entry_p) */
@@ -239,16 +776,6 @@ static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, c
 
 																}		/* if (results_p) */
 
-
-															if (json_object_set_new (study_json_p, "marti_samples", marti_links_p) == 0)
-																{
-
-																}
-															else
-																{
-																	json_decref (marti_links_p);
-																}
-
 														}		/* if (marti_links_p) */
 
 
@@ -264,6 +791,5 @@ static void ProcessMartiResults (json_t *results_json_p, json_t *study_json_p, c
 
 		}		/* if (json_is_array (services_json_p)) */
 
+	return marti_links_p;
 }
-
-
@@ -20,6 +20,8 @@
  *      Author: billy
  */
 
+#include <string.h>
+
 #define ALLOCATE_MATERIAL_TAGS (1)
 #include "material.h"
 #include "memory_allocations.h"
@@ -33,10 +35,56 @@ static bool ReplaceMaterialField (const char *new_value_s, char **value_ss);
 
 static Material *SearchForMaterial (bson_t *query_p, const FieldTrialServiceData *data_p);
 
-static bool SetValidJSONString (json_t *material_json_p, const char *key_s, const char *value_s);
+static Material *SearchForUnkeyedMaterialByAccession (const char *accession_s, GeneBank *gene_bank_p, const FieldTrialServiceData *data_p);
 
 static char *GetRegex (const char *accession_s);
 
+static bool SetValidJSONString (json_t *material_json_p, const char *key_s, const char *value_s);
+
+static char *GetMaterialsMapAccessionKey (const bson_oid_t *gene_bank_id_p, const char *accession_s);
+
+static bool AddMaterialAccessionKeyToBulkOperation (const bson_t *document_p, void *data_p);
+
+
+/**
+ * A Material stored in a MaterialsMap.
+ */
+typedef struct MaterialsMapNode
+{
+	/** The base list node. */
+	ListItem mmn_node;
+
+	/** The id of the Material, which is also the key for the lookup table. */
+	char mmn_id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+	/**
+	 * The gene bank id and accession of the Material, which is the
+	 * key for the accessions table.
+	 */
+	char *mmn_accession_key_s;
+
+	/** The Material. */
+	Material *mmn_material_p;
+
+} MaterialsMapNode;
+
+
+static bool AddMaterialToMaterialsMap (MaterialsMap *map_p, Material *material_p);
+
+static void FreeMaterialsMapNode (ListItem *node_p);
+
+
+/**
+ * The updates to add the accession keys to existing Materials.
+ */
+typedef struct AccessionKeyUpdates
+{
+	mongoc_bulk_operation_t *aku_bulk_p;
+
+	size_t aku_num_updates;
+
+} AccessionKeyUpdates;
+
 /*
  * API FUNCTIONS
  */
@@ -180,6 +228,27 @@ json_t *GetMaterialAsJSON (const Material *material_p, const ViewFormat format,
 						}
 				}
 
+			if (success_flag && (format == VF_STORAGE))
+				{
+					char *accession_key_s = GetMaterialAccessionKey (material_p -> ma_accession_s);
+
+					success_flag = false;
+
+					if (accession_key_s)
+						{
+							if (SetJSONString (material_json_p, MA_ACCESSION_KEY_S, accession_key_s))
+								{
+									success_flag = true;
+								}
+							else
+								{
+									PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, material_json_p, "Failed to add \"%s\": \"%s\"", MA_ACCESSION_KEY_S, accession_key_s);
+								}
+
+							FreeCopiedString (accession_key_s);
+						}
+				}
+
 			if (success_flag)
 				{
 					if (SetJSONString (material_json_p, MA_ACCESSION_S, material_p -> ma_accession_s))
@@ -420,13 +489,17 @@ Material *GetMaterialByAccession (const char *accession_s, GeneBank *gene_bank_p
 				}
 			else
 				{
-					char *regex_s = GetRegex (accession_s);
+					/*
+					 * Use the case-folded key rather than a case-insensitive
+					 * regex since MongoDB can use an index for it
+					 */
+					char *accession_key_s = GetMaterialAccessionKey (accession_s);
 
-					if (regex_s)
+					if (accession_key_s)
 						{
-							success_flag = BSON_APPEND_REGEX (query_p, MA_ACCESSION_S, regex_s, "i");
+							success_flag = BSON_APPEND_UTF8 (query_p, MA_ACCESSION_KEY_S, accession_key_s);
 
-							FreeCopiedString (regex_s);
+							FreeCopiedString (accession_key_s);
 						}
 				}
 
@@ -443,6 +516,15 @@ Material *GetMaterialByAccession (const char *accession_s, GeneBank *gene_bank_p
 				{
 					material_p = SearchForMaterial (query_p, data_p);
 
+					/*
+					 * Materials saved before the accession keys were added won't
+					 * have one until AddMaterialAccessionKeys () has been run
+					 */
+					if ((!material_p) && (!case_sensitive_flag))
+						{
+							material_p = SearchForUnkeyedMaterialByAccession (accession_s, gene_bank_p, data_p);
+						}
+
 					if (!material_p)
 						{
 							PrintBSONToErrors (STM_LEVEL_INFO, __FILE__, __LINE__, query_p, "SearchForMaterial did not find accession \"%s\" in gene bank \"%s\"", accession_s, gene_bank_p ? gene_bank_p -> gb_name_s : "");
@@ -507,6 +589,82 @@ Material *GetMaterialById (const bson_oid_t *material_id_p, const FieldTrialServ
 }
 
 
+static Material *SearchForUnkeyedMaterialByAccession (const char *accession_s, GeneBank *gene_bank_p, const FieldTrialServiceData *data_p)
+{
+	Material *material_p = NULL;
+	char *regex_s = GetRegex (accession_s);
+
+	if (regex_s)
+		{
+			bson_t *query_p = BCON_NEW (MA_ACCESSION_KEY_S, "{", "$exists", BCON_BOOL (false), "}", MA_ACCESSION_S, BCON_REGEX (regex_s, "i"));
+
+			if (query_p)
+				{
+					bool success_flag = true;
+
+					if (gene_bank_p)
+						{
+							success_flag = BSON_APPEND_OID (query_p, MA_GENE_BANK_ID_S, gene_bank_p -> gb_id_p);
+						}
+
+					if (success_flag)
+						{
+							material_p = SearchForMaterial (query_p, data_p);
+
+							if (material_p)
+								{
+									PrintLog (STM_LEVEL_WARNING, __FILE__, __LINE__, "Accession \"%s\" has no accession key, run \"SS Add MongoDB Indexes\" to add them", accession_s);
+								}
+						}
+
+					bson_destroy (query_p);
+				}
+
+			FreeCopiedString (regex_s);
+		}
+
+	return material_p;
+}
+
+
+/*
+ * Get an anchored regular expression that matches the accession
+ * exactly, with any regular expression metacharacters escaped.
+ */
+static char *GetRegex (const char *accession_s)
+{
+	const char * const metacharacters_s = "\\^$.|?*+()[]{}/";
+	char *regex_s = (char *) AllocMemory ((2 * strlen (accession_s)) + 3);
+
+	if (regex_s)
+		{
+			char *dest_p = regex_s;
+			const char *src_p = accession_s;
+
+			*dest_p = '^';
+			++ dest_p;
+
+			while (*src_p)
+				{
+					if (strchr (metacharacters_s, *src_p))
+						{
+							*dest_p = '\\';
+							++ dest_p;
+						}
+
+					*dest_p = *src_p;
+					++ dest_p;
+					++ src_p;
+				}
+
+			*dest_p = '$';
+			* (++ dest_p) = '\0';
+		}
+
+	return regex_s;
+}
+
+
 static Material *SearchForMaterial (bson_t *query_p, const FieldTrialServiceData *data_p)
 {
 	Material *material_p = NULL;
@@ -558,6 +716,105 @@ static Material *SearchForMaterial (bson_t *query_p, const FieldTrialServiceData
 }
 
 
+char *GetMaterialAccessionKey (const char *accession_s)
+{
+	return GetStringAsLowerCase (accession_s);
+}
+
+
+Material *CopyMaterial (const Material *material_p)
+{
+	Material *copied_material_p = NULL;
+	bson_oid_t *id_p = GetNewUnitialisedBSONOid ();
+
+	if (id_p)
+		{
+			bson_oid_copy (material_p -> ma_id_p, id_p);
+
+			/* FreeMaterial () doesn't free the gene bank id so it can be shared */
+			copied_material_p = AllocateMaterialByAccession (id_p, material_p -> ma_accession_s, material_p -> ma_gene_bank_id_p, NULL);
+
+			if (!copied_material_p)
+				{
+					FreeBSONOid (id_p);
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to copy id for Material \"%s\"", material_p -> ma_accession_s);
+		}
+
+	return copied_material_p;
+}
+
+
+OperationStatus AddMaterialAccessionKeys (const FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MATERIAL]))
+		{
+			bson_t *query_p = BCON_NEW (MA_ACCESSION_KEY_S, "{", "$exists", BCON_BOOL (false), "}", MA_ACCESSION_S, "{", "$type", BCON_UTF8 ("string"), "}");
+
+			if (query_p)
+				{
+					bson_t *opts_p = BCON_NEW ("projection", "{", MA_ACCESSION_S, BCON_INT32 (1), "}");
+
+					if (opts_p)
+						{
+							bson_t *bulk_opts_p = BCON_NEW ("ordered", BCON_BOOL (false));
+
+							if (bulk_opts_p)
+								{
+									AccessionKeyUpdates updates;
+
+									updates.aku_num_updates = 0;
+									updates.aku_bulk_p = mongoc_collection_create_bulk_operation_with_opts (data_p -> dftsd_mongo_p -> mt_collection_p, bulk_opts_p);
+
+									if (updates.aku_bulk_p)
+										{
+											status = ProcessMongoResults (data_p -> dftsd_mongo_p, query_p, opts_p, AddMaterialAccessionKeyToBulkOperation, &updates);
+
+											if ((status != OS_FAILED) && (updates.aku_num_updates > 0))
+												{
+													bson_t reply;
+													bson_error_t error;
+
+													if (mongoc_bulk_operation_execute (updates.aku_bulk_p, &reply, &error) != 0)
+														{
+															PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Added accession keys to " SIZET_FMT " Materials", updates.aku_num_updates);
+														}
+													else
+														{
+															PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, &reply, "Failed to add accession keys to " SIZET_FMT " Materials: \"%s\"", updates.aku_num_updates, error.message);
+															status = OS_PARTIALLY_SUCCEEDED;
+														}
+
+													bson_destroy (&reply);
+												}
+
+											mongoc_bulk_operation_destroy (updates.aku_bulk_p);
+										}		/* if (updates.aku_bulk_p) */
+
+									bson_destroy (bulk_opts_p);
+								}		/* if (bulk_opts_p) */
+
+							bson_destroy (opts_p);
+						}		/* if (opts_p) */
+
+					bson_destroy (query_p);
+				}		/* if (query_p) */
+
+		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MATERIAL])) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", data_p -> dftsd_collection_ss [DFTD_MATERIAL]);
+		}
+
+	return status;
+}
+
+
 bool IsMaterialComplete (const Material * const material_p)
 {
 	return ((material_p -> ma_gene_bank_id_p) && (material_p -> ma_accession_s));
@@ -620,22 +877,423 @@ static bool ReplaceMaterialField (const char *new_value_s, char **value_ss)
 }
 
 
+MaterialsMap *AllocateMaterialsMap (void)
+{
+	LinkedList *materials_p = AllocateLinkedList (FreeMaterialsMapNode);
+
+	if (materials_p)
+		{
+			HashTable *table_p = GetHashTableOfStringPointers (256, 75);
+
+			if (table_p)
+				{
+					HashTable *accessions_table_p = GetHashTableOfStringPointers (256, 75);
+
+					if (accessions_table_p)
+						{
+							MaterialsMap *map_p = (MaterialsMap *) AllocMemory (sizeof (MaterialsMap));
+
+							if (map_p)
+								{
+									map_p -> mm_materials_p = materials_p;
+									map_p -> mm_table_p = table_p;
+									map_p -> mm_accessions_table_p = accessions_table_p;
+
+									return map_p;
+								}
+
+							FreeHashTable (accessions_table_p);
+						}
+
+					FreeHashTable (table_p);
+				}
+
+			FreeLinkedList (materials_p);
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate MaterialsMap");
+
+	return NULL;
+}
+
+
+void FreeMaterialsMap (MaterialsMap *map_p)
+{
+	/*
+	 * The tables only point to the nodes' keys so
+	 * they need to go before the list
+	 */
+	FreeHashTable (map_p -> mm_accessions_table_p);
+	FreeHashTable (map_p -> mm_table_p);
+	FreeLinkedList (map_p -> mm_materials_p);
+
+	FreeMemory (map_p);
+}
+
+
+bool AddMaterialsToMaterialsMap (MaterialsMap *map_p, const char **ids_ss, const size_t num_ids, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	json_t *results_p = GetDFWObjectsJSONByIdStrings (ids_ss, num_ids, DFTD_MATERIAL, data_p);
+
+	if (results_p)
+		{
+			size_t i;
+			json_t *material_json_p;
+
+			success_flag = true;
+
+			json_array_foreach (results_p, i, material_json_p)
+				{
+					Material *material_p = GetMaterialFromJSON (material_json_p, VF_STORAGE, data_p);
+
+					if (material_p)
+						{
+							if (!AddMaterialToMaterialsMap (map_p, material_p))
+								{
+									FreeMaterial (material_p);
+									success_flag = false;
+								}
+						}
+					else
+						{
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, material_json_p, "Failed to get Material from JSON");
+							success_flag = false;
+						}
+
+				}		/* json_array_foreach (results_p, i, material_json_p) */
+
+			json_decref (results_p);
+		}		/* if (results_p) */
+
+	return success_flag;
+}
+
+
+Material *GetMaterialFromMaterialsMap (const MaterialsMap *map_p, const bson_oid_t *id_p)
+{
+	Material *material_p = NULL;
+	char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+	MaterialsMapNode *node_p;
+
+	bson_oid_to_string (id_p, id_s);
+	node_p = (MaterialsMapNode *) GetFromHashTable (map_p -> mm_table_p, id_s);
+
+	if (node_p)
+		{
+			material_p = node_p -> mmn_material_p;
+		}
+
+	return material_p;
+}
+
+
+bool AddMaterialsByAccessionsToMaterialsMap (MaterialsMap *map_p, const char **accessions_ss, const size_t num_accessions, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	bson_t *accessions_p = bson_new ();
+
+	if (accessions_p)
+		{
+			json_t *added_p = json_object ();
+
+			if (added_p)
+				{
+					uint32 num_added = 0;
+					size_t i;
+
+					success_flag = true;
+
+					/* Only ask for each accession once */
+					for (i = 0; i < num_accessions; ++ i, ++ accessions_ss)
+						{
+							if ((!IsStringEmpty (*accessions_ss)) && (!json_object_get (added_p, *accessions_ss)))
+								{
+									char buffer_s [16];
+									const char *key_s = NULL;
+
+									bson_uint32_to_string (num_added, &key_s, buffer_s, sizeof (buffer_s));
+
+									if ((BSON_APPEND_UTF8 (accessions_p, key_s, *accessions_ss)) && (json_object_set_new (added_p, *accessions_ss, json_true ()) == 0))
+										{
+											++ num_added;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add accession \"%s\" to query", *accessions_ss);
+										}
+								}
+						}
+
+					if (num_added > 0)
+						{
+							if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MATERIAL]))
+								{
+									bson_t *query_p = BCON_NEW (MA_ACCESSION_S, "{", "$in", BCON_ARRAY (accessions_p), "}");
+
+									success_flag = false;
+
+									if (query_p)
+										{
+											json_t *results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, NULL);
+
+											if (results_p)
+												{
+													json_t *material_json_p;
+
+													success_flag = true;
+
+													json_array_foreach (results_p, i, material_json_p)
+														{
+															Material *material_p = GetMaterialFromJSON (material_json_p, VF_STORAGE, data_p);
+
+															if (material_p)
+																{
+																	if (GetMaterialFromMaterialsMap (map_p, material_p -> ma_id_p))
+																		{
+																			FreeMaterial (material_p);
+																		}
+																	else if (!AddMaterialToMaterialsMap (map_p, material_p))
+																		{
+																			FreeMaterial (material_p);
+																			success_flag = false;
+																		}
+																}
+															else
+																{
+																	PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, material_json_p, "Failed to get Material from JSON");
+																	success_flag = false;
+																}
+														}
+
+													json_decref (results_p);
+												}		/* if (results_p) */
+											else
+												{
+													PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "GetAllMongoResultsAsJSON () failed for " UINT32_FMT " accessions", num_added);
+												}
+
+											bson_destroy (query_p);
+										}		/* if (query_p) */
+
+								}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_MATERIAL])) */
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", data_p -> dftsd_collection_ss [DFTD_MATERIAL]);
+									success_flag = false;
+								}
+
+						}		/* if (num_added > 0) */
+
+					json_decref (added_p);
+				}		/* if (added_p) */
+
+			bson_destroy (accessions_p);
+		}		/* if (accessions_p) */
+
+	return success_flag;
+}
+
+
+Material *GetOrCreateMaterialByAccessionFromMaterialsMap (MaterialsMap *map_p, const char *accession_s, GeneBank *gene_bank_p, const FieldTrialServiceData *data_p)
+{
+	Material *material_p = NULL;
+	char *key_s = GetMaterialsMapAccessionKey (gene_bank_p -> gb_id_p, accession_s);
+
+	if (key_s)
+		{
+			MaterialsMapNode *node_p = (MaterialsMapNode *) GetFromHashTable (map_p -> mm_accessions_table_p, key_s);
+
+			if (node_p)
+				{
+					material_p = node_p -> mmn_material_p;
+				}
+			else
+				{
+					Material *new_material_p = GetOrCreateMaterialByAccession (accession_s, gene_bank_p, data_p);
+
+					if (new_material_p)
+						{
+							/*
+							 * The Material can outlive the GeneBank so it needs
+							 * its own copy of the GeneBank's id.
+							 */
+							if (new_material_p -> ma_gene_bank_id_p == gene_bank_p -> gb_id_p)
+								{
+									new_material_p -> ma_gene_bank_id_p = GetNewUnitialisedBSONOid ();
+
+									if (new_material_p -> ma_gene_bank_id_p)
+										{
+											bson_oid_copy (gene_bank_p -> gb_id_p, new_material_p -> ma_gene_bank_id_p);
+										}
+								}
+
+							if ((new_material_p -> ma_gene_bank_id_p) && (AddMaterialToMaterialsMap (map_p, new_material_p)))
+								{
+									material_p = new_material_p;
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Material \"%s\" for gene bank \"%s\" to MaterialsMap", accession_s, gene_bank_p -> gb_name_s);
+									FreeMaterial (new_material_p);
+								}
+						}
+				}
+
+			FreeCopiedString (key_s);
+		}		/* if (key_s) */
+
+	return material_p;
+}
+
+
+static bool AddMaterialToMaterialsMap (MaterialsMap *map_p, Material *material_p)
+{
+	bool success_flag = false;
+	MaterialsMapNode *node_p = (MaterialsMapNode *) AllocMemory (sizeof (MaterialsMapNode));
+
+	if (node_p)
+		{
+			InitListItem (& (node_p -> mmn_node));
+			bson_oid_to_string (material_p -> ma_id_p, node_p -> mmn_id_s);
+			node_p -> mmn_accession_key_s = NULL;
+
+			if (PutInHashTable (map_p -> mm_table_p, node_p -> mmn_id_s, node_p))
+				{
+					node_p -> mmn_material_p = material_p;
+					LinkedListAddTail (map_p -> mm_materials_p, & (node_p -> mmn_node));
+					success_flag = true;
+
+					/*
+					 * If a gene bank has more than one Material with the same
+					 * accession, the first one is used as GetMaterialByAccession ()
+					 * would.
+					 */
+					if (material_p -> ma_accession_s)
+						{
+							node_p -> mmn_accession_key_s = GetMaterialsMapAccessionKey (material_p -> ma_gene_bank_id_p, material_p -> ma_accession_s);
+
+							if (node_p -> mmn_accession_key_s)
+								{
+									if (!GetFromHashTable (map_p -> mm_accessions_table_p, node_p -> mmn_accession_key_s))
+										{
+											if (!PutInHashTable (map_p -> mm_accessions_table_p, node_p -> mmn_accession_key_s, node_p))
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add accession \"%s\" to MaterialsMap", node_p -> mmn_accession_key_s);
+												}
+										}
+								}
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add material \"%s\" to MaterialsMap", node_p -> mmn_id_s);
+					FreeMemory (node_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+static void FreeMaterialsMapNode (ListItem *node_p)
+{
+	MaterialsMapNode *mm_node_p = (MaterialsMapNode *) node_p;
+
+	if (mm_node_p -> mmn_material_p)
+		{
+			FreeMaterial (mm_node_p -> mmn_material_p);
+		}
+
+	if (mm_node_p -> mmn_accession_key_s)
+		{
+			FreeCopiedString (mm_node_p -> mmn_accession_key_s);
+		}
+
+	FreeMemory (mm_node_p);
+}
+
+
 static bool SetValidJSONString (json_t *material_json_p, const char *key_s, const char *value_s)
 {
 	return ((IsStringEmpty (value_s)) || (SetJSONString (material_json_p, key_s, value_s)));
 }
 
 
-static char *GetRegex (const char *accession_s)
+static char *GetMaterialsMapAccessionKey (const bson_oid_t *gene_bank_id_p, const char *accession_s)
 {
-	char *regex_s = NULL;
-	char *lower_case_accession_s = GetStringAsLowerCase (accession_s);
+	char gene_bank_id_s [MONGO_OID_STRING_BUFFER_SIZE];
 
-	if (lower_case_accession_s)
+	if (gene_bank_id_p)
 		{
-			regex_s = ConcatenateVarargsStrings ("^", lower_case_accession_s, "$", NULL);
+			bson_oid_to_string (gene_bank_id_p, gene_bank_id_s);
+		}
+	else
+		{
+			*gene_bank_id_s = '\0';
 		}
 
-	return regex_s;
+	return ConcatenateVarargsStrings (gene_bank_id_s, ":", accession_s, NULL);
+}
+
+
+/*
+ * Add an update to set the accession key for a Material document
+ * that was stored before the key was added.
+ */
+static bool AddMaterialAccessionKeyToBulkOperation (const bson_t *document_p, void *data_p)
+{
+	bool success_flag = false;
+	AccessionKeyUpdates *updates_p = (AccessionKeyUpdates *) data_p;
+	bson_iter_t iter;
+	bson_iter_t accession_iter;
+
+	if (bson_iter_init (&iter, document_p) && bson_iter_find (&iter, MONGO_ID_S) && BSON_ITER_HOLDS_OID (&iter))
+		{
+			const bson_oid_t *id_p = bson_iter_oid (&iter);
+
+			if (bson_iter_init (&accession_iter, document_p) && bson_iter_find (&accession_iter, MA_ACCESSION_S) && BSON_ITER_HOLDS_UTF8 (&accession_iter))
+				{
+					char *accession_key_s = GetMaterialAccessionKey (bson_iter_utf8 (&accession_iter, NULL));
+
+					if (accession_key_s)
+						{
+							bson_t *selector_p = BCON_NEW (MONGO_ID_S, BCON_OID (id_p));
+
+							if (selector_p)
+								{
+									bson_t *update_p = BCON_NEW ("$set", "{", MA_ACCESSION_KEY_S, BCON_UTF8 (accession_key_s), "}");
+
+									if (update_p)
+										{
+											bson_error_t error;
+
+											if (mongoc_bulk_operation_update_one_with_opts (updates_p -> aku_bulk_p, selector_p, update_p, NULL, &error))
+												{
+													++ (updates_p -> aku_num_updates);
+													success_flag = true;
+												}
+											else
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add accession key update for \"%s\": \"%s\"", accession_key_s, error.message);
+												}
+
+											bson_destroy (update_p);
+										}
+
+									bson_destroy (selector_p);
+								}
+
+							FreeCopiedString (accession_key_s);
+						}
+				}
+		}
+
+	if (!success_flag)
+		{
+			PrintBSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, document_p, "Failed to add accession key for Material");
+		}
+
+	return success_flag;
 }
 
@@ -29,6 +29,8 @@
 #include "row_jobs.h"
 #include "string_int_pair.h"
 #include "row_processor.h"
+#include "material_usage.h"
+#include "dfw_util.h"
 
 #include "char_parameter.h"
 #include "boolean_parameter.h"
@@ -68,9 +70,12 @@ static NamedParameterType S_GENE_BANKS_LIST = { "MA Gene Bank", PT_STRING };
 
 static NamedParameterType S_MATERIAL_ACCESSION = { "MA Accession", PT_STRING };
 static NamedParameterType S_MATERIAL_ACCESSION_CASE_SENSITIVE = { "MA Accession case-sensitive", PT_BOOLEAN };
+static NamedParameterType S_MATERIAL_USAGE_ONLY = { "MA Usage only", PT_BOOLEAN };
 
 static const bool S_DEFAULT_SEARCH_CASE_SENSITIVITY_FLAG = true;
 
+static const bool S_DEFAULT_USAGE_ONLY_FLAG = false;
+
 
 static json_t *GetTableParameterHints (void);
 
@@ -78,6 +83,8 @@ static Parameter *GetTableParameter (ParameterSet *param_set_p, ParameterGroup *
 
 static bool AddMaterialsFromJSON (ServiceJob *job_p, const json_t *materials_json_p, Study *area_p, GeneBank *gene_bank_p, const FieldTrialServiceData *data_p);
 
+static OperationStatus AddMaterialUsageToServiceJob (const Material *material_p, ServiceJob *job_p, const FieldTrialServiceData *data_p);
+
 
 
 /*
@@ -245,7 +252,12 @@ bool AddSearchMaterialParams (ServiceData *data_p, ParameterSet *param_set_p)
 
 					if ((param_p = EasyCreateAndAddBooleanParameterToParameterSet (data_p, param_set_p, group_p, S_MATERIAL_ACCESSION_CASE_SENSITIVE.npt_name_s, "Case sensitive", "Do a case-sensitive search for the accession", &case_sensitivity_flag, PL_ADVANCED)) != NULL)
 						{
-							success_flag = true;
+							const bool usage_only_flag = S_DEFAULT_USAGE_ONLY_FLAG;
+
+							if ((param_p = EasyCreateAndAddBooleanParameterToParameterSet (data_p, param_set_p, group_p, S_MATERIAL_USAGE_ONLY.npt_name_s, "Usage only", "Only list the plots and rows that the accession was used in rather than the full studies", &usage_only_flag, PL_ADVANCED)) != NULL)
+								{
+									success_flag = true;
+								}
 						}
 				}
 		}		/* if (group_p) */
@@ -266,9 +278,11 @@ bool RunForSearchMaterialParams (FieldTrialServiceData *data_p, ParameterSet *pa
 				{
 					OperationStatus status = OS_FAILED_TO_START;
 					bool case_senstive_search_flag = S_DEFAULT_SEARCH_CASE_SENSITIVITY_FLAG;
+					bool usage_only_flag = S_DEFAULT_USAGE_ONLY_FLAG;
 					GeneBank *gene_bank_p = NULL;
 					Material *material_p = NULL;
 					const bool *sens_flag_p = NULL;
+					const bool *usage_only_flag_p = NULL;
 
 					GetCurrentBooleanParameterValueFromParameterSet (param_set_p, S_MATERIAL_ACCESSION_CASE_SENSITIVE.npt_name_s, &sens_flag_p);
 
@@ -277,12 +291,26 @@ bool RunForSearchMaterialParams (FieldTrialServiceData *data_p, ParameterSet *pa
 							case_senstive_search_flag = *sens_flag_p;
 						}
 
+					GetCurrentBooleanParameterValueFromParameterSet (param_set_p, S_MATERIAL_USAGE_ONLY.npt_name_s, &usage_only_flag_p);
+
+					if (usage_only_flag_p != NULL)
+						{
+							usage_only_flag = *usage_only_flag_p;
+						}
+
 					material_p = GetMaterialByAccession (accession_s, gene_bank_p, case_senstive_search_flag, data_p);
 
 					if (material_p)
 						{
-							ViewFormat format = VF_CLIENT_FULL;
-							status = GetAllStudiesContainingMaterial (material_p, job_p, format, data_p);
+							if (usage_only_flag)
+								{
+									status = AddMaterialUsageToServiceJob (material_p, job_p, data_p);
+								}
+							else
+								{
+									ViewFormat format = VF_CLIENT_FULL;
+									status = GetAllStudiesContainingMaterial (material_p, job_p, format, data_p);
+								}
 
 							FreeMaterial (material_p);
 						}		/* if (material_p) */
@@ -309,6 +337,7 @@ bool GetSearchMaterialParameterTypeForNamedParameter (const char *param_name_s,
 		{
 			S_MATERIAL_ACCESSION,
 			S_MATERIAL_ACCESSION_CASE_SENSITIVE,
+			S_MATERIAL_USAGE_ONLY,
 			NULL
 		};
 
@@ -321,167 +350,329 @@ OperationStatus GetAllStudiesContainingMaterial (Material *material_p, ServiceJo
 {
 	OperationStatus status = OS_FAILED;
 	bool success_flag = true;
+	json_t *results_p = GetMaterialUsage (material_p -> ma_id_p, data_p);
 
-	char *query_key_s = ConcatenateVarargsStrings (PL_ROWS_S, ".", SR_MATERIAL_ID_S, NULL);
-
-	if (query_key_s)
+	if (results_p)
 		{
-			bson_t *query_p = BCON_NEW (query_key_s, BCON_OID (material_p -> ma_id_p));
+			json_t *studies_cache_p = json_object ();
 
-			if (query_p)
+			if (studies_cache_p)
 				{
-					if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+					if (json_is_array (results_p))
 						{
-							json_t *results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, NULL);
+							const size_t num_results = json_array_size (results_p);
+							size_t i = 0;
 
-							if (results_p)
+							while ((i < num_results) && success_flag)
 								{
-									json_t *studies_cache_p = json_object ();
+									json_t *usage_p = json_array_get (results_p, i);
+									bson_oid_t oid;
 
-									if (studies_cache_p)
+									/*
+									 * Get the study id
+									 */
+									if (GetNamedIdFromJSON (usage_p, RO_STUDY_ID_S, &oid))
 										{
-											if (json_is_array (results_p))
+											char *id_s = GetBSONOidAsString (&oid);
+
+											if (id_s)
 												{
-													const size_t num_results = json_array_size (results_p);
-													size_t i = 0;
+													json_int_t count = 0;
+
+													GetJSONInteger (studies_cache_p, id_s, &count);
 
-													while ((i < num_results) && success_flag)
+													/* Each usage entry lists the rows in a plot that use the material */
+													count += json_array_size (json_object_get (usage_p, PL_ROWS_S));
+
+													if (!SetJSONInteger (studies_cache_p, id_s, count))
 														{
-															json_t *row_json_p = json_array_get (results_p, i);
-															bson_oid_t oid;
+															success_flag = false;
+														}
 
-															/*
-															 * Get the study id
-															 */
-															if (GetNamedIdFromJSON (row_json_p, RO_STUDY_ID_S, &oid))
-																{
-																	char *id_s = GetBSONOidAsString (&oid);
+													FreeBSONOidString (id_s);
+												}		/* if (id_s) */
 
-																	if (id_s)
-																		{
-																			json_int_t count = 0;
+										}
 
-																			GetJSONInteger (studies_cache_p, id_s, &count);
+									if (success_flag)
+										{
+											++ i;
+										}
 
-																			++ count;
+								}		/* while ((i < num_results) && success_flag) */
 
-																			if (!SetJSONInteger (studies_cache_p, id_s, count))
-																				{
-																					success_flag = false;
-																				}
 
-																			FreeBSONOidString (id_s);
-																		}		/* if (id_s) */
+							if (success_flag)
+								{
+									/*
+									 * Now we sort the studies by how many times the material appears
+									 */
+									size_t num_studies = json_object_size (studies_cache_p);
+									if (num_studies > 0)
+										{
+											StringIntPairArray *ids_with_counts_p = AllocateStringIntPairArray (num_studies);
 
-																}
+											if (ids_with_counts_p)
+												{
+													uint32 added_count = 0;
+													const char *key_s;
+													json_t *value_p;
+													JSONProcessor *processor_p = AllocateRowProcessor (material_p);
+													StringIntPair *pair_p = ids_with_counts_p -> sipa_values_p;
 
-															if (success_flag)
+													json_object_foreach (studies_cache_p, key_s, value_p)
+														{
+															int count = json_integer_value (value_p);
+
+															if (!SetStringIntPair (pair_p, (char *) key_s, MF_SHADOW_USE, count))
 																{
-																	++ i;
+																	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "");
 																}
 
-														}		/* while ((i < num_results) && success_flag) */
+															++ pair_p;
+														}		/* json_object_foreach (studies_cache_p, key_s, value_p) */
 
+													/*
+													 * Sort by the counts of how many times each material appears
+													 * in each study
+													 */
+													SortStringIntPairsByCountDescending (ids_with_counts_p);
 
-													if (success_flag)
+													for (i = num_studies, pair_p = ids_with_counts_p -> sipa_values_p; i > 0; -- i, ++ pair_p)
 														{
-															/*
-															 * Now we sort the studies by how many times the material appears
-															 */
-															size_t num_studies = json_object_size (studies_cache_p);
-															if (num_studies > 0)
-																{
-																	StringIntPairArray *ids_with_counts_p = AllocateStringIntPairArray (num_studies);
+															Study *study_p = GetStudyByIdString (pair_p -> sip_string_s, format, data_p);
 
-																	if (ids_with_counts_p)
+															if (study_p)
+																{
+																	if (AddStudyToServiceJob (job_p, study_p, format, processor_p, data_p))
 																		{
-																			uint32 added_count = 0;
-																			const char *key_s;
-																			json_t *value_p;
-																			JSONProcessor *processor_p = AllocateRowProcessor (material_p);
-																			StringIntPair *pair_p = ids_with_counts_p -> sipa_values_p;
+																			++ added_count;
+																		}
+																	else
+																		{
+																			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add study \"%s\" to results for job \"%s\"", study_p -> st_name_s, job_p -> sj_name_s);
+																		}
 
-																			json_object_foreach (studies_cache_p, key_s, value_p)
-																				{
-																					int count = json_integer_value (value_p);
+																}		/* if (study_p) */
+															else
+																{
+																	FreeStudy (study_p);
+																}
 
-																					if (!SetStringIntPair (pair_p, (char *) key_s, MF_SHADOW_USE, count))
-																						{
-																							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "");
-																						}
+														}		/* for ( ; num_studies > 0; -- num_studies, ++ key_ss) */
 
-																					++ pair_p;
-																				}		/* json_object_foreach (studies_cache_p, key_s, value_p) */
+													if (processor_p)
+														{
+															FreeJSONProcessor (processor_p);
+														}
 
-																			/*
-																			 * Sort by the counts of how many times each material appears
-																			 * in each study
-																			 */
-																			SortStringIntPairsByCountDescending (ids_with_counts_p);
+													if (added_count == num_studies)
+														{
+															status = OS_SUCCEEDED;
+														}
+													else if (added_count > 0)
+														{
+															status = OS_PARTIALLY_SUCCEEDED;
+														}
+													else
+														{
+															status = OS_FAILED;
+														}
 
-																			for (i = num_studies, pair_p = ids_with_counts_p -> sipa_values_p; i > 0; -- i, ++ pair_p)
-																				{
-																					Study *study_p = GetStudyByIdString (pair_p -> sip_string_s, format, data_p);
+													FreeStringIntPairArray (ids_with_counts_p);
+												}		/* if (ids_with_counts_p) */
 
-																					if (study_p)
-																						{
-																							if (AddStudyToServiceJob (job_p, study_p, format, processor_p, data_p))
-																								{
-																									++ added_count;
-																								}
-																							else
-																								{
-																									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add study \"%s\" to results for job \"%s\"", study_p -> st_name_s, job_p -> sj_name_s);
-																								}
+										}		/* if (studies_cache_p -> ht_size > 0) */
 
-																						}		/* if (study_p) */
-																					else
-																						{
-																							FreeStudy (study_p);
-																						}
+								}		/* if (success_flag) */
 
-																				}		/* for ( ; num_studies > 0; -- num_studies, ++ key_ss) */
+						}		/* if (json_is_array (results_p)) */
 
-																			if (processor_p)
-																				{
-																					FreeJSONProcessor (processor_p);
-																				}
+					json_decref (studies_cache_p);
+				}		/* if (studies_cache_p */
 
-																			if (added_count == num_studies)
-																				{
-																					status = OS_SUCCEEDED;
-																				}
-																			else if (added_count > 0)
+			json_decref (results_p);
+		}		/* if (results_p) */
+
+	return status;
+}
+
+
+/*
+ * Add a result for each Study that the Material was used in, listing the
+ * plots and rows that used it. This comes straight from the material usage
+ * collection so the Studies' plots don't need loading.
+ */
+static OperationStatus AddMaterialUsageToServiceJob (const Material *material_p, ServiceJob *job_p, const FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	json_t *results_p = GetMaterialUsage (material_p -> ma_id_p, data_p);
+
+	if (results_p)
+		{
+			/* The usage entries for each plot, keyed by study id */
+			json_t *studies_p = json_object ();
+
+			if (studies_p)
+				{
+					const size_t num_results = json_array_size (results_p);
+					size_t i = 0;
+					bool success_flag = true;
+
+					while (success_flag && (i < num_results))
+						{
+							json_t *usage_p = json_array_get (results_p, i);
+							bson_oid_t study_id;
+
+							if (GetNamedIdFromJSON (usage_p, RO_STUDY_ID_S, &study_id))
+								{
+									char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+									json_t *plots_p = NULL;
+
+									bson_oid_to_string (&study_id, id_s);
+									plots_p = json_object_get (studies_p, id_s);
+
+									if (!plots_p)
+										{
+											plots_p = json_array ();
+
+											if ((!plots_p) || (json_object_set_new (studies_p, id_s, plots_p) != 0))
+												{
+													success_flag = false;
+												}
+										}
+
+									if (success_flag)
+										{
+											/* These are the same for each plot so don't repeat them */
+											json_object_del (usage_p, SR_MATERIAL_ID_S);
+											json_object_del (usage_p, RO_STUDY_ID_S);
+
+											success_flag = (json_array_append (plots_p, usage_p) == 0);
+										}
+								}
+							else
+								{
+									PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, usage_p, "Failed to get \"%s\"", RO_STUDY_ID_S);
+								}
+
+							++ i;
+						}		/* while (success_flag && (i < num_results)) */
+
+					if (success_flag)
+						{
+							const size_t num_studies = json_object_size (studies_p);
+
+							if (num_studies > 0)
+								{
+									const char **ids_ss = (const char **) AllocMemoryArray (num_studies, sizeof (const char *));
+
+									if (ids_ss)
+										{
+											const char *id_s;
+											json_t *plots_p;
+											json_t *names_p = json_object ();
+											json_t *study_docs_p = NULL;
+											size_t num_added = 0;
+
+											i = 0;
+											json_object_foreach (studies_p, id_s, plots_p)
+												{
+													* (ids_ss + i) = id_s;
+													++ i;
+												}
+
+											/*
+											 * The Study documents don't contain the plots so getting
+											 * them all for their names is cheap
+											 */
+											study_docs_p = GetDFWObjectsJSONByIdStrings (ids_ss, num_studies, DFTD_STUDY, data_p);
+
+											if (study_docs_p && names_p)
+												{
+													json_t *study_doc_p;
+
+													json_array_foreach (study_docs_p, i, study_doc_p)
+														{
+															bson_oid_t study_id;
+															const char *name_s = GetJSONString (study_doc_p, ST_NAME_S);
+
+															if (name_s && GetMongoIdFromJSON (study_doc_p, &study_id))
+																{
+																	char study_id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+																	bson_oid_to_string (&study_id, study_id_s);
+																	SetJSONString (names_p, study_id_s, name_s);
+																}
+														}
+												}
+
+											json_object_foreach (studies_p, id_s, plots_p)
+												{
+													const char *name_s = names_p ? GetJSONString (names_p, id_s) : NULL;
+													json_t *study_json_p = json_object ();
+
+													if (study_json_p)
+														{
+															if ((SetJSONString (study_json_p, RO_STUDY_ID_S, id_s)) &&
+																((!name_s) || (SetJSONString (study_json_p, ST_NAME_S, name_s))) &&
+																(json_object_set (study_json_p, ST_PLOTS_S, plots_p) == 0))
+																{
+																	json_t *dest_record_p = GetDataResourceAsJSONByParts (PROTOCOL_INLINE_S, NULL, name_s ? name_s : id_s, study_json_p);
+
+																	if (dest_record_p)
+																		{
+																			if (AddResultToServiceJob (job_p, dest_record_p))
 																				{
-																					status = OS_PARTIALLY_SUCCEEDED;
+																					++ num_added;
 																				}
 																			else
 																				{
-																					status = OS_FAILED;
+																					json_decref (dest_record_p);
 																				}
+																		}
+																}
 
-																			FreeStringIntPairArray (ids_with_counts_p);
-																		}		/* if (ids_with_counts_p) */
+															json_decref (study_json_p);
+														}		/* if (study_json_p) */
 
-																}		/* if (studies_cache_p -> ht_size > 0) */
+												}		/* json_object_foreach (studies_p, id_s, plots_p) */
 
-														}		/* if (success_flag) */
+											if (num_added == num_studies)
+												{
+													status = OS_SUCCEEDED;
+												}
+											else if (num_added > 0)
+												{
+													status = OS_PARTIALLY_SUCCEEDED;
+												}
 
-												}		/* if (json_is_array (results_p)) */
+											if (study_docs_p)
+												{
+													json_decref (study_docs_p);
+												}
+
+											if (names_p)
+												{
+													json_decref (names_p);
+												}
 
-											json_decref (studies_cache_p);
-										}		/* if (studies_cache_p */
+											FreeMemory (ids_ss);
+										}		/* if (ids_ss) */
 
-									json_decref (results_p);
-								}		/* if (results_p) */
+								}		/* if (num_studies > 0) */
+							else
+								{
+									status = OS_SUCCEEDED;
+								}
 
-						}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_ROW] */
+						}		/* if (success_flag) */
 
-					bson_free (query_p);
-				}		/* if (query_p) */
+					json_decref (studies_p);
+				}		/* if (studies_p) */
 
-			FreeCopiedString (query_key_s);
-		}		/* if (query_key_s) */
+			json_decref (results_p);
+		}		/* if (results_p) */
 
 	return status;
 }
@@ -0,0 +1,945 @@
+/*
+ * material_usage.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include "material_usage.h"
+#include "plot.h"
+#include "row.h"
+#include "standard_row.h"
+#include "dfw_util.h"
+
+#include "mongodb_tool.h"
+#include "mongodb_util.h"
+#include "json_util.h"
+#include "string_utils.h"
+#include "streams.h"
+
+
+/**
+ * The collection that the material usage entries are stored in.
+ */
+static const char * const S_MATERIAL_USAGE_COLLECTION_S = "MaterialUsage";
+
+
+/**
+ * The id of the document that RebuildMaterialUsage () adds once it has
+ * filled the collection. Until it exists, the collection only has the
+ * entries for Plots saved since it was added so the Plots are searched
+ * instead.
+ */
+static const char * const S_MATERIAL_USAGE_BUILT_ID_S = "built";
+
+
+/**
+ * The number of operations that RebuildMaterialUsage () adds before
+ * writing them so that it doesn't build up a single huge bulk
+ * operation for every Plot.
+ */
+static const size_t S_MATERIAL_USAGE_BATCH_SIZE = 1000;
+
+
+/**
+ * The state used when rebuilding the material usage collection
+ * from all of the stored Plots.
+ */
+typedef struct MaterialUsageRebuild
+{
+	/**
+	 * A copy of the material usage collection so that new batches
+	 * can be started while the Plots are being read.
+	 */
+	mongoc_collection_t *mur_collection_p;
+
+	mongoc_bulk_operation_t *mur_bulk_p;
+
+	/** The number of operations added to mur_bulk_p. */
+	size_t mur_num_pending;
+
+	/** The number of entries that have been written. */
+	size_t mur_num_entries;
+
+	/** The number of Plots that have been processed. */
+	size_t mur_num_plots;
+
+	/** The number of Plots that couldn't be processed. */
+	size_t mur_num_failed;
+
+	/** Whether any of the batches couldn't be written. */
+	bool mur_batch_failed_flag;
+} MaterialUsageRebuild;
+
+
+static json_t *GetMaterialUsageForPlotJSON (const json_t *plot_json_p, bson_oid_t *plot_id_p);
+
+static bool AddRowToMaterialUsage (json_t *entries_p, const json_t *row_json_p, const bson_oid_t *material_id_p, const bson_oid_t *study_id_p, const bson_oid_t *plot_id_p);
+
+static bool AddPlotToMaterialUsageBulkOperation (mongoc_bulk_operation_t *bulk_p, const json_t *plot_json_p, const bool remove_existing_flag, size_t *num_ops_p);
+
+static mongoc_bulk_operation_t *CreateMaterialUsageBulkOperation (const bool ordered_flag, const FieldTrialServiceData *data_p);
+
+static mongoc_bulk_operation_t *CreateBulkOperationForCollection (mongoc_collection_t *collection_p, const bool ordered_flag);
+
+static bool FlushMaterialUsageRebuild (MaterialUsageRebuild *rebuild_p);
+
+static bool RunMaterialUsageBulkOperation (mongoc_bulk_operation_t *bulk_p, const size_t num_ops);
+
+static bson_t *GetMaterialUsageRebuildOptions (void);
+
+static bool AddStoredPlotToMaterialUsage (const bson_t *document_p, void *data_p);
+
+static bool AddMaterialUsageIndexes (const FieldTrialServiceData *data_p);
+
+static bool IsMaterialUsageBuilt (const FieldTrialServiceData *data_p);
+
+static bool SetMaterialUsageBuilt (const FieldTrialServiceData *data_p);
+
+static json_t *GetMaterialUsageFromPlots (const bson_oid_t *material_id_p, const FieldTrialServiceData *data_p);
+
+
+
+bool UpdateMaterialUsageForPlot (const json_t *plot_json_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	mongoc_bulk_operation_t *bulk_p = CreateMaterialUsageBulkOperation (true, data_p);
+
+	if (bulk_p)
+		{
+			size_t num_ops = 0;
+
+			if (AddPlotToMaterialUsageBulkOperation (bulk_p, plot_json_p, true, &num_ops))
+				{
+					success_flag = RunMaterialUsageBulkOperation (bulk_p, num_ops);
+				}
+
+			mongoc_bulk_operation_destroy (bulk_p);
+		}		/* if (bulk_p) */
+
+	return success_flag;
+}
+
+
+bool UpdateMaterialUsageForPlots (const json_t *plots_json_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	mongoc_bulk_operation_t *bulk_p = CreateMaterialUsageBulkOperation (true, data_p);
+
+	if (bulk_p)
+		{
+			const json_t *plot_json_p;
+			size_t i;
+			size_t num_ops = 0;
+
+			success_flag = true;
+
+			json_array_foreach (plots_json_p, i, plot_json_p)
+				{
+					if (json_is_object (plot_json_p))
+						{
+							if (!AddPlotToMaterialUsageBulkOperation (bulk_p, plot_json_p, true, &num_ops))
+								{
+									success_flag = false;
+								}
+						}
+				}
+
+			if (!RunMaterialUsageBulkOperation (bulk_p, num_ops))
+				{
+					success_flag = false;
+				}
+
+			mongoc_bulk_operation_destroy (bulk_p);
+		}		/* if (bulk_p) */
+
+	return success_flag;
+}
+
+
+bool RemoveMaterialUsageForStudy (const bson_oid_t *study_id_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S))
+		{
+			bson_t *query_p = BCON_NEW (RO_STUDY_ID_S, BCON_OID (study_id_p));
+
+			if (query_p)
+				{
+					success_flag = RemoveMongoDocumentsByBSON (data_p -> dftsd_mongo_p, query_p, false);
+
+					bson_destroy (query_p);
+				}		/* if (query_p) */
+
+		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S)) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", S_MATERIAL_USAGE_COLLECTION_S);
+		}
+
+	return success_flag;
+}
+
+
+json_t *GetMaterialUsage (const bson_oid_t *material_id_p, const FieldTrialServiceData *data_p)
+{
+	json_t *results_p = NULL;
+
+	if (!IsMaterialUsageBuilt (data_p))
+		{
+			PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "\"%s\" has not been built, searching the plots instead", S_MATERIAL_USAGE_COLLECTION_S);
+			results_p = GetMaterialUsageFromPlots (material_id_p, data_p);
+		}
+	else if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S))
+		{
+			bson_t *query_p = BCON_NEW (SR_MATERIAL_ID_S, BCON_OID (material_id_p));
+
+			if (query_p)
+				{
+					bson_t *opts_p = BCON_NEW ("projection", "{", MONGO_ID_S, BCON_INT32 (0), "}");
+
+					if (opts_p)
+						{
+							results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, opts_p);
+
+							bson_destroy (opts_p);
+						}		/* if (opts_p) */
+
+					bson_destroy (query_p);
+				}		/* if (query_p) */
+
+		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S)) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", S_MATERIAL_USAGE_COLLECTION_S);
+		}
+
+	return results_p;
+}
+
+
+OperationStatus RebuildMaterialUsage (const FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	MongoTool *tool_p = data_p -> dftsd_mongo_p;
+
+	if (SetMongoToolCollection (tool_p, S_MATERIAL_USAGE_COLLECTION_S))
+		{
+			bson_t *all_p = bson_new ();
+
+			if (all_p)
+				{
+					/*
+					 * Start from scratch so that any entries for Plots that
+					 * were changed outside of the service are removed.
+					 */
+					if (RemoveMongoDocumentsByBSON (tool_p, all_p, false))
+						{
+							MaterialUsageRebuild rebuild;
+
+							rebuild.mur_num_pending = 0;
+							rebuild.mur_num_entries = 0;
+							rebuild.mur_num_plots = 0;
+							rebuild.mur_num_failed = 0;
+							rebuild.mur_batch_failed_flag = false;
+							rebuild.mur_bulk_p = NULL;
+							rebuild.mur_collection_p = mongoc_collection_copy (tool_p -> mt_collection_p);
+
+							if (rebuild.mur_collection_p)
+								{
+									/*
+									 * Add the indexes while the collection is empty so that
+									 * the unique one is in place before any entries are added.
+									 */
+									const bool indexes_flag = AddMaterialUsageIndexes (data_p);
+
+									rebuild.mur_bulk_p = CreateBulkOperationForCollection (rebuild.mur_collection_p, false);
+
+									if (rebuild.mur_bulk_p)
+										{
+											bson_t *opts_p = GetMaterialUsageRebuildOptions ();
+
+											if (opts_p)
+												{
+													if (SetMongoToolCollection (tool_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+														{
+															status = ProcessMongoResults (tool_p, all_p, opts_p, AddStoredPlotToMaterialUsage, &rebuild);
+
+															if (status != OS_FAILED)
+																{
+																	/* Write whatever is left over from the last batch */
+																	FlushMaterialUsageRebuild (&rebuild);
+
+																	if (!rebuild.mur_batch_failed_flag)
+																		{
+																			PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Added " SIZET_FMT " material usage entries for " SIZET_FMT " Plots", rebuild.mur_num_entries, rebuild.mur_num_plots);
+
+																			if ((rebuild.mur_num_failed > 0) || (!indexes_flag))
+																				{
+																					status = OS_PARTIALLY_SUCCEEDED;
+																				}
+
+																			if (!SetMaterialUsageBuilt (data_p))
+																				{
+																					status = OS_PARTIALLY_SUCCEEDED;
+																				}
+																		}
+																	else
+																		{
+																			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to write all of the material usage entries, only " SIZET_FMT " were added", rebuild.mur_num_entries);
+																			status = OS_FAILED;
+																		}
+																}
+
+														}		/* if (SetMongoToolCollection (tool_p, data_p -> dftsd_collection_ss [DFTD_PLOT])) */
+													else
+														{
+															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", data_p -> dftsd_collection_ss [DFTD_PLOT]);
+														}
+
+													bson_destroy (opts_p);
+												}		/* if (opts_p) */
+
+										}		/* if (rebuild.mur_bulk_p) */
+
+									if (rebuild.mur_bulk_p)
+										{
+											mongoc_bulk_operation_destroy (rebuild.mur_bulk_p);
+										}
+
+									mongoc_collection_destroy (rebuild.mur_collection_p);
+								}		/* if (rebuild.mur_collection_p) */
+
+						}		/* if (RemoveMongoDocumentsByBSON (tool_p, all_p, false)) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to clear \"%s\"", S_MATERIAL_USAGE_COLLECTION_S);
+						}
+
+					bson_destroy (all_p);
+				}		/* if (all_p) */
+
+		}		/* if (SetMongoToolCollection (tool_p, S_MATERIAL_USAGE_COLLECTION_S)) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", S_MATERIAL_USAGE_COLLECTION_S);
+		}
+
+	return status;
+}
+
+
+/*
+ * Get the material usage entries for a Plot keyed by their Material ids.
+ */
+static json_t *GetMaterialUsageForPlotJSON (const json_t *plot_json_p, bson_oid_t *plot_id_p)
+{
+	bson_oid_t study_id;
+
+	if (GetMongoIdFromJSON (plot_json_p, plot_id_p))
+		{
+			if (GetNamedIdFromJSON (plot_json_p, PL_PARENT_STUDY_S, &study_id))
+				{
+					json_t *entries_p = json_object ();
+
+					if (entries_p)
+						{
+							const json_t *rows_p = json_object_get (plot_json_p, PL_ROWS_S);
+							bool success_flag = true;
+
+							if (json_is_array (rows_p))
+								{
+									const size_t num_rows = json_array_size (rows_p);
+									size_t i = 0;
+
+									while (success_flag && (i < num_rows))
+										{
+											const json_t *row_json_p = json_array_get (rows_p, i);
+											bson_oid_t material_id;
+
+											/* Only standard rows have Materials */
+											if (GetNamedIdFromJSON (row_json_p, SR_MATERIAL_ID_S, &material_id))
+												{
+													success_flag = AddRowToMaterialUsage (entries_p, row_json_p, &material_id, &study_id, plot_id_p);
+												}
+
+											++ i;
+										}		/* while (success_flag && (i < num_rows)) */
+
+								}		/* if (json_is_array (rows_p)) */
+
+							if (success_flag)
+								{
+									return entries_p;
+								}
+
+							json_decref (entries_p);
+						}		/* if (entries_p) */
+
+				}		/* if (GetNamedIdFromJSON (plot_json_p, PL_PARENT_STUDY_S, &study_id)) */
+			else
+				{
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to get \"%s\"", PL_PARENT_STUDY_S);
+				}
+
+		}		/* if (GetMongoIdFromJSON (plot_json_p, plot_id_p)) */
+	else
+		{
+			PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to get plot id");
+		}
+
+	return NULL;
+}
+
+
+static bool AddRowToMaterialUsage (json_t *entries_p, const json_t *row_json_p, const bson_oid_t *material_id_p, const bson_oid_t *study_id_p, const bson_oid_t *plot_id_p)
+{
+	char material_id_s [MONGO_OID_STRING_BUFFER_SIZE];
+	json_t *entry_p = NULL;
+	json_t *row_usage_p = NULL;
+	const json_t *value_p = NULL;
+
+	bson_oid_to_string (material_id_p, material_id_s);
+
+	entry_p = json_object_get (entries_p, material_id_s);
+
+	if (!entry_p)
+		{
+			entry_p = json_object ();
+
+			if (!entry_p)
+				{
+					return false;
+				}
+
+			if (! ((AddNamedCompoundIdToJSON (entry_p, material_id_p, SR_MATERIAL_ID_S)) &&
+				(AddNamedCompoundIdToJSON (entry_p, study_id_p, RO_STUDY_ID_S)) &&
+				(AddNamedCompoundIdToJSON (entry_p, plot_id_p, RO_PLOT_ID_S)) &&
+				(json_object_set_new (entry_p, PL_ROWS_S, json_array ()) == 0)))
+				{
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to create material usage entry for \"%s\"", material_id_s);
+					json_decref (entry_p);
+					return false;
+				}
+
+			if (json_object_set_new (entries_p, material_id_s, entry_p) != 0)
+				{
+					return false;
+				}
+		}		/* if (!entry_p) */
+
+	row_usage_p = json_object ();
+
+	if (row_usage_p)
+		{
+			bool success_flag = true;
+
+			if ((value_p = json_object_get (row_json_p, MONGO_ID_S)) != NULL)
+				{
+					success_flag = (json_object_set (row_usage_p, RO_ID_S, (json_t *) value_p) == 0);
+				}
+
+			if (success_flag && ((value_p = json_object_get (row_json_p, SR_RACK_INDEX_S)) != NULL))
+				{
+					success_flag = (json_object_set (row_usage_p, SR_RACK_INDEX_S, (json_t *) value_p) == 0);
+				}
+
+			/* This is either the replicate index or SR_REPLICATE_CONTROL_S */
+			if (success_flag && ((value_p = json_object_get (row_json_p, SR_REPLICATE_S)) != NULL))
+				{
+					success_flag = (json_object_set (row_usage_p, SR_REPLICATE_S, (json_t *) value_p) == 0);
+				}
+
+			if (success_flag)
+				{
+					if (json_array_append_new (json_object_get (entry_p, PL_ROWS_S), row_usage_p) == 0)
+						{
+							return true;
+						}
+				}
+			else
+				{
+					json_decref (row_usage_p);
+				}
+
+		}		/* if (row_usage_p) */
+
+	PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, row_json_p, "Failed to add row to material usage entry for \"%s\"", material_id_s);
+
+	return false;
+}
+
+
+static bool AddPlotToMaterialUsageBulkOperation (mongoc_bulk_operation_t *bulk_p, const json_t *plot_json_p, const bool remove_existing_flag, size_t *num_ops_p)
+{
+	bool success_flag = false;
+	bson_oid_t plot_id;
+	json_t *entries_p = GetMaterialUsageForPlotJSON (plot_json_p, &plot_id);
+
+	if (entries_p)
+		{
+			bson_error_t error;
+
+			success_flag = true;
+
+			if (remove_existing_flag)
+				{
+					bson_t *selector_p = BCON_NEW (RO_PLOT_ID_S, BCON_OID (&plot_id));
+
+					if (selector_p)
+						{
+							if (mongoc_bulk_operation_remove_many_with_opts (bulk_p, selector_p, NULL, &error))
+								{
+									++ (*num_ops_p);
+								}
+							else
+								{
+									PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to remove existing material usage: \"%s\"", error.message);
+									success_flag = false;
+								}
+
+							bson_destroy (selector_p);
+						}
+					else
+						{
+							success_flag = false;
+						}
+				}		/* if (remove_existing_flag) */
+
+			if (success_flag)
+				{
+					/*
+					 * The entries are upserted on their Material and Plot so that
+					 * if another request has saved the same Plot at the same time,
+					 * we don't end up with duplicate entries.
+					 */
+					bson_t *upsert_opts_p = BCON_NEW ("upsert", BCON_BOOL (true));
+
+					if (upsert_opts_p)
+						{
+							const char *key_s;
+							json_t *entry_p;
+
+							json_object_foreach (entries_p, key_s, entry_p)
+								{
+									bson_oid_t material_id;
+
+									if (GetNamedIdFromJSON (entry_p, SR_MATERIAL_ID_S, &material_id))
+										{
+											bson_t *selector_p = BCON_NEW (SR_MATERIAL_ID_S, BCON_OID (&material_id), RO_PLOT_ID_S, BCON_OID (&plot_id));
+
+											if (selector_p)
+												{
+													bson_t *doc_p = ConvertJSONToBSON (entry_p);
+
+													if (doc_p)
+														{
+															if (mongoc_bulk_operation_replace_one_with_opts (bulk_p, selector_p, doc_p, upsert_opts_p, &error))
+																{
+																	++ (*num_ops_p);
+																}
+															else
+																{
+																	PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to add material usage: \"%s\"", error.message);
+																	success_flag = false;
+																}
+
+															bson_destroy (doc_p);
+														}
+													else
+														{
+															PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "ConvertJSONToBSON () failed");
+															success_flag = false;
+														}
+
+													bson_destroy (selector_p);
+												}
+											else
+												{
+													success_flag = false;
+												}
+										}
+									else
+										{
+											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to get \"%s\"", SR_MATERIAL_ID_S);
+											success_flag = false;
+										}
+
+								}		/* json_object_foreach (entries_p, key_s, entry_p) */
+
+							bson_destroy (upsert_opts_p);
+						}		/* if (upsert_opts_p) */
+					else
+						{
+							success_flag = false;
+						}
+
+				}		/* if (success_flag) */
+
+			json_decref (entries_p);
+		}		/* if (entries_p) */
+
+	return success_flag;
+}
+
+
+static mongoc_bulk_operation_t *CreateMaterialUsageBulkOperation (const bool ordered_flag, const FieldTrialServiceData *data_p)
+{
+	mongoc_bulk_operation_t *bulk_p = NULL;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S))
+		{
+			bulk_p = CreateBulkOperationForCollection (data_p -> dftsd_mongo_p -> mt_collection_p, ordered_flag);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", S_MATERIAL_USAGE_COLLECTION_S);
+		}
+
+	return bulk_p;
+}
+
+
+static mongoc_bulk_operation_t *CreateBulkOperationForCollection (mongoc_collection_t *collection_p, const bool ordered_flag)
+{
+	mongoc_bulk_operation_t *bulk_p = NULL;
+
+	/*
+	 * Updates need to be ordered so that a Plot's old entries
+	 * are removed before its new ones are added.
+	 */
+	bson_t *opts_p = BCON_NEW ("ordered", BCON_BOOL (ordered_flag));
+
+	if (opts_p)
+		{
+			bulk_p = mongoc_collection_create_bulk_operation_with_opts (collection_p, opts_p);
+
+			bson_destroy (opts_p);
+		}
+
+	return bulk_p;
+}
+
+
+/*
+ * Write the operations that have been added to the rebuild's current
+ * batch and start a new one.
+ */
+static bool FlushMaterialUsageRebuild (MaterialUsageRebuild *rebuild_p)
+{
+	if (RunMaterialUsageBulkOperation (rebuild_p -> mur_bulk_p, rebuild_p -> mur_num_pending))
+		{
+			rebuild_p -> mur_num_entries += rebuild_p -> mur_num_pending;
+		}
+	else
+		{
+			rebuild_p -> mur_batch_failed_flag = true;
+		}
+
+	mongoc_bulk_operation_destroy (rebuild_p -> mur_bulk_p);
+	rebuild_p -> mur_num_pending = 0;
+
+	rebuild_p -> mur_bulk_p = CreateBulkOperationForCollection (rebuild_p -> mur_collection_p, false);
+
+	if (!rebuild_p -> mur_bulk_p)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create bulk operation for \"%s\"", S_MATERIAL_USAGE_COLLECTION_S);
+			rebuild_p -> mur_batch_failed_flag = true;
+			return false;
+		}
+
+	return true;
+}
+
+
+static bool RunMaterialUsageBulkOperation (mongoc_bulk_operation_t *bulk_p, const size_t num_ops)
+{
+	bool success_flag = true;
+
+	/* Executing an empty bulk operation is an error */
+	if (num_ops > 0)
+		{
+			bson_t reply;
+			bson_error_t error;
+
+			if (mongoc_bulk_operation_execute (bulk_p, &reply, &error) == 0)
+				{
+					PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, &reply, "Failed to update material usage with " SIZET_FMT " operations: \"%s\"", num_ops, error.message);
+					success_flag = false;
+				}
+
+			bson_destroy (&reply);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Only get the fields of the Plots that the material usage needs rather
+ * than all of their observations and treatments.
+ */
+static bson_t *GetMaterialUsageRebuildOptions (void)
+{
+	bson_t *opts_p = bson_new ();
+
+	if (opts_p)
+		{
+			bson_t projection;
+
+			if (BSON_APPEND_DOCUMENT_BEGIN (opts_p, "projection", &projection))
+				{
+					const char *row_keys_ss [] = { MONGO_ID_S, SR_MATERIAL_ID_S, SR_RACK_INDEX_S, SR_REPLICATE_S, NULL };
+					const char **row_key_ss = row_keys_ss;
+					bool success_flag = BSON_APPEND_INT32 (&projection, PL_PARENT_STUDY_S, 1);
+
+					while (success_flag && (*row_key_ss))
+						{
+							char *key_s = ConcatenateVarargsStrings (PL_ROWS_S, ".", *row_key_ss, NULL);
+
+							if (key_s)
+								{
+									success_flag = BSON_APPEND_INT32 (&projection, key_s, 1);
+									FreeCopiedString (key_s);
+								}
+							else
+								{
+									success_flag = false;
+								}
+
+							++ row_key_ss;
+						}		/* while (success_flag && (*row_key_ss)) */
+
+					if (bson_append_document_end (opts_p, &projection) && success_flag)
+						{
+							return opts_p;
+						}
+				}
+
+			bson_destroy (opts_p);
+		}		/* if (opts_p) */
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create projection for rebuilding material usage");
+
+	return NULL;
+}
+
+
+static bool AddStoredPlotToMaterialUsage (const bson_t *document_p, void *data_p)
+{
+	MaterialUsageRebuild *rebuild_p = (MaterialUsageRebuild *) data_p;
+	json_t *plot_json_p = ConvertBSONToJSON (document_p, NULL);
+
+	if (plot_json_p)
+		{
+			if (AddPlotToMaterialUsageBulkOperation (rebuild_p -> mur_bulk_p, plot_json_p, false, & (rebuild_p -> mur_num_pending)))
+				{
+					++ (rebuild_p -> mur_num_plots);
+				}
+			else
+				{
+					++ (rebuild_p -> mur_num_failed);
+				}
+
+			json_decref (plot_json_p);
+		}
+	else
+		{
+			PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, document_p, "ConvertBSONToJSON () failed");
+			++ (rebuild_p -> mur_num_failed);
+		}
+
+	if (rebuild_p -> mur_num_pending >= S_MATERIAL_USAGE_BATCH_SIZE)
+		{
+			/* We can't carry on without a bulk operation to add to */
+			return FlushMaterialUsageRebuild (rebuild_p);
+		}
+
+	/* Keep going so that a single bad Plot doesn't stop the rebuild */
+	return true;
+}
+
+
+static bool AddMaterialUsageIndexes (const FieldTrialServiceData *data_p)
+{
+	bool success_flag = true;
+	const char *unique_keys_ss [] = { SR_MATERIAL_ID_S, RO_PLOT_ID_S, NULL };
+	const char *keys_ss [] = { RO_STUDY_ID_S, RO_PLOT_ID_S, NULL };
+	const char **key_ss = keys_ss;
+
+	/*
+	 * A Plot only has one entry for each Material and this also
+	 * covers searching by Material.
+	 */
+	if (!AddCollectionCompoundIndex (data_p -> dftsd_mongo_p, NULL, S_MATERIAL_USAGE_COLLECTION_S, unique_keys_ss, true, false))
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add unique index on \"%s\" and \"%s\" to \"%s\"", SR_MATERIAL_ID_S, RO_PLOT_ID_S, S_MATERIAL_USAGE_COLLECTION_S);
+			success_flag = false;
+		}
+
+	while (*key_ss)
+		{
+			if (!AddCollectionSingleIndex (data_p -> dftsd_mongo_p, NULL, S_MATERIAL_USAGE_COLLECTION_S, *key_ss, NULL, false, false))
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add index on \"%s\" to \"%s\"", *key_ss, S_MATERIAL_USAGE_COLLECTION_S);
+					success_flag = false;
+				}
+
+			++ key_ss;
+		}
+
+	return success_flag;
+}
+
+
+static bool IsMaterialUsageBuilt (const FieldTrialServiceData *data_p)
+{
+	bool built_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S))
+		{
+			bson_t *query_p = BCON_NEW (MONGO_ID_S, BCON_UTF8 (S_MATERIAL_USAGE_BUILT_ID_S));
+
+			if (query_p)
+				{
+					bson_error_t error;
+					int64_t count = mongoc_collection_count_documents (data_p -> dftsd_mongo_p -> mt_collection_p, query_p, NULL, NULL, NULL, &error);
+
+					if (count > 0)
+						{
+							built_flag = true;
+						}
+					else if (count < 0)
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to check whether \"%s\" has been built: \"%s\"", S_MATERIAL_USAGE_COLLECTION_S, error.message);
+						}
+
+					bson_destroy (query_p);
+				}
+		}
+
+	return built_flag;
+}
+
+
+static bool SetMaterialUsageBuilt (const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_MATERIAL_USAGE_COLLECTION_S))
+		{
+			bson_t *query_p = BCON_NEW (MONGO_ID_S, BCON_UTF8 (S_MATERIAL_USAGE_BUILT_ID_S));
+
+			if (query_p)
+				{
+					bson_t *update_p = BCON_NEW ("$set", "{", S_MATERIAL_USAGE_BUILT_ID_S, BCON_BOOL (true), "}");
+
+					if (update_p)
+						{
+							bson_t *opts_p = BCON_NEW ("upsert", BCON_BOOL (true));
+
+							if (opts_p)
+								{
+									bson_error_t error;
+
+									if (mongoc_collection_update_one (data_p -> dftsd_mongo_p -> mt_collection_p, query_p, update_p, opts_p, NULL, &error))
+										{
+											success_flag = true;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to mark \"%s\" as built: \"%s\"", S_MATERIAL_USAGE_COLLECTION_S, error.message);
+										}
+
+									bson_destroy (opts_p);
+								}
+
+							bson_destroy (update_p);
+						}
+
+					bson_destroy (query_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Build the material usage entries for a Material from the Plots that use
+ * it, in the same way as RebuildMaterialUsage () does.
+ */
+static json_t *GetMaterialUsageFromPlots (const bson_oid_t *material_id_p, const FieldTrialServiceData *data_p)
+{
+	json_t *results_p = NULL;
+	char *key_s = ConcatenateVarargsStrings (PL_ROWS_S, ".", SR_MATERIAL_ID_S, NULL);
+
+	if (key_s)
+		{
+			bson_t *query_p = BCON_NEW (key_s, BCON_OID (material_id_p));
+
+			if (query_p)
+				{
+					bson_t *opts_p = GetMaterialUsageRebuildOptions ();
+
+					if (opts_p)
+						{
+							if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+								{
+									json_t *plots_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, opts_p);
+
+									if (plots_p)
+										{
+											results_p = json_array ();
+
+											if (results_p)
+												{
+													char material_id_s [MONGO_OID_STRING_BUFFER_SIZE];
+													json_t *plot_json_p;
+													size_t i;
+
+													bson_oid_to_string (material_id_p, material_id_s);
+
+													json_array_foreach (plots_p, i, plot_json_p)
+														{
+															bson_oid_t plot_id;
+															json_t *entries_p = GetMaterialUsageForPlotJSON (plot_json_p, &plot_id);
+
+															if (entries_p)
+																{
+																	json_t *entry_p = json_object_get (entries_p, material_id_s);
+																	bool added_flag = ((!entry_p) || (json_array_append (results_p, entry_p) == 0));
+
+																	json_decref (entries_p);
+
+																	if (!added_flag)
+																		{
+																			PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to add material usage for \"%s\"", material_id_s);
+																			json_decref (results_p);
+																			results_p = NULL;
+																			break;
+																		}
+																}
+														}
+
+												}		/* if (results_p) */
+
+											json_decref (plots_p);
+										}		/* if (plots_p) */
+
+								}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT])) */
+
+							bson_destroy (opts_p);
+						}		/* if (opts_p) */
+
+					bson_destroy (query_p);
+				}		/* if (query_p) */
+
+			FreeCopiedString (key_s);
+		}		/* if (key_s) */
+
+	return results_p;
+}
+
+
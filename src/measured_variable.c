@@ -449,7 +449,11 @@ OperationStatus SaveMeasuredVariable (MeasuredVariable *mv_p, ServiceJob *job_p,
 					if (SaveAndBackupMongoDataWithTimestamp (data_p -> dftsd_mongo_p, phenotype_json_p, data_p -> dftsd_collection_ss [DFTD_MEASURED_VARIABLE],
 																									 data_p -> dftsd_backup_collection_ss [DFTD_MEASURED_VARIABLE], DFT_BACKUPS_ID_KEY_S, selector_p, MONGO_TIMESTAMP_S))
 						{
-							json_t *index_json_p = GetMeasuredVariableAsJSON (mv_p, VF_INDEXING, data_p);
+							json_t *index_json_p = NULL;
+
+							InvalidateMeasuredVariablesCaches ();
+
+							index_json_p = GetMeasuredVariableAsJSON (mv_p, VF_INDEXING, data_p);
 
 							if (index_json_p)
 								{
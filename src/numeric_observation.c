@@ -29,17 +29,17 @@ static bool GetNumericObservationValueAsString (const struct Observation *observ
 
 
 NumericObservation *AllocateNumericObservation (bson_oid_t *id_p, const ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p, MEM_FLAG phenotype_mem, const double *raw_value_p, const double *corrected_value_p,
-	const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s)
+	const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s, StudyArena *arena_p)
 {
 	double64 *copied_raw_value_p = NULL;
 
-	if (CopyValidReal (raw_value_p, &copied_raw_value_p))
+	if (CopyValidStudyReal (arena_p, raw_value_p, &copied_raw_value_p))
 		{
 			double64 *copied_corrected_value_p = NULL;
 
-			if (CopyValidReal (corrected_value_p, &copied_corrected_value_p))
+			if (CopyValidStudyReal (arena_p, corrected_value_p, &copied_corrected_value_p))
 				{
-					NumericObservation *observation_p = (NumericObservation *) AllocMemory (sizeof (NumericObservation));
+					NumericObservation *observation_p = (NumericObservation *) AllocStudyMemory (arena_p, sizeof (NumericObservation));
 
 					if (observation_p)
 						{
@@ -51,7 +51,8 @@ NumericObservation *AllocateNumericObservation (bson_oid_t *id_p, const Observat
 																	 AddNumericObservationValuesToJSON,
 																	 SetNumericObservationValueFromJSON,
 																	 SetNumericObservationValueFromString,
-																	 GetNumericObservationValueAsString))
+																	 GetNumericObservationValueAsString,
+																	 arena_p))
 								{
 									observation_p -> no_raw_value_p = copied_raw_value_p;
 									observation_p -> no_corrected_value_p = copied_corrected_value_p;
@@ -61,18 +62,18 @@ NumericObservation *AllocateNumericObservation (bson_oid_t *id_p, const Observat
 
 							ClearObservation (& (observation_p -> no_base_observation));
 							ClearNumericObservation (& (observation_p -> no_base_observation));
-							FreeMemory (observation_p);
+							FreeStudyMemory (arena_p, observation_p);
 						}
 
 					if (copied_corrected_value_p)
 						{
-							FreeMemory (copied_corrected_value_p);
+							FreeStudyMemory (arena_p, copied_corrected_value_p);
 						}
 				}
 
 			if (copied_raw_value_p)
 				{
-					FreeMemory (copied_raw_value_p);
+					FreeStudyMemory (arena_p, copied_raw_value_p);
 				}
 		}
 
@@ -89,13 +90,13 @@ void ClearNumericObservation (Observation *observation_p)
 
 	if (numeric_obs_p -> no_raw_value_p)
 		{
-			FreeMemory (numeric_obs_p -> no_raw_value_p);
+			FreeStudyMemory (observation_p -> ob_arena_p, numeric_obs_p -> no_raw_value_p);
 			numeric_obs_p -> no_raw_value_p = NULL;
 		}
 
 	if (numeric_obs_p -> no_corrected_value_p)
 		{
-			FreeMemory (numeric_obs_p -> no_corrected_value_p);
+			FreeStudyMemory (observation_p -> ob_arena_p, numeric_obs_p -> no_corrected_value_p);
 			numeric_obs_p -> no_corrected_value_p = NULL;
 		}
 }
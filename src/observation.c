@@ -67,6 +67,13 @@ static bool CompareObservationDates (const struct tm * const time_0_p, const str
 
 static bool GetObservationTypeFromJSON (ObservationType *type_p, const json_t *doc_p);
 
+static Observation *AllocateObservationInArena (bson_oid_t *id_p, ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p,
+																								MEM_FLAG phenotype_mem, const json_t *raw_value_p, const json_t *corrected_value_p,
+																								const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature,
+																								const char *notes_s, const ObservationType obs_type,
+																								void (*on_error_callback_fn) (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p),
+																								ServiceJob *job_p, void *user_data_p, StudyArena *arena_p);
+
 
 
 
@@ -82,20 +89,21 @@ bool InitObservation (Observation *observation_p, bson_oid_t *id_p, ObservationM
 											bool (*add_values_to_json_fn) (const struct Observation *obs_p, const char *raw_key_s, const char *corrected_key_s, json_t *json_p, const char *null_sequence_s, bool only_if_exists_flag),
 											bool (*set_value_from_json_fn) (struct Observation *observation_p, ObservationValueType ovt, const json_t *value_p),
 											bool (*set_value_from_string_fn) (struct Observation *observation_p, ObservationValueType ovt, const char *value_s),
-											bool (*get_value_as_string_fn) (const struct Observation *observation_p, ObservationValueType ovt, char **value_ss, bool *free_value_flag_p)
+											bool (*get_value_as_string_fn) (const struct Observation *observation_p, ObservationValueType ovt, char **value_ss, bool *free_value_flag_p),
+											StudyArena *arena_p
 )
 {
 	char *copied_growth_stage_s = NULL;
 
-	if ((IsStringEmpty (growth_stage_s)) || ((copied_growth_stage_s = EasyCopyToNewString (growth_stage_s)) != NULL))
+	if ((IsStringEmpty (growth_stage_s)) || ((copied_growth_stage_s = CopyStudyString (arena_p, growth_stage_s)) != NULL))
 		{
 			char *copied_method_s = NULL;
 
-			if ((IsStringEmpty (method_s)) || ((copied_method_s = EasyCopyToNewString (method_s)) != NULL))
+			if ((IsStringEmpty (method_s)) || ((copied_method_s = CopyStudyString (arena_p, method_s)) != NULL))
 				{
 					char *copied_notes_s = NULL;
 
-					if ((IsStringEmpty (notes_s)) || ((copied_notes_s = EasyCopyToNewString (notes_s)) != NULL))
+					if ((IsStringEmpty (notes_s)) || ((copied_notes_s = CopyStudyString (arena_p, notes_s)) != NULL))
 						{
 							ObservationMetadata *copied_metadata_p = NULL;
 
@@ -116,6 +124,7 @@ bool InitObservation (Observation *observation_p, bson_oid_t *id_p, ObservationM
 									observation_p -> ob_set_value_from_json_fn = set_value_from_json_fn;
 									observation_p -> ob_set_value_from_string_fn = set_value_from_string_fn;
 									observation_p -> ob_get_value_as_string_fn = get_value_as_string_fn;
+									observation_p -> ob_arena_p = arena_p;
 
 									return true;
 								}
@@ -138,7 +147,7 @@ bool InitObservation (Observation *observation_p, bson_oid_t *id_p, ObservationM
 
 			if (copied_growth_stage_s)
 				{
-					FreeCopiedString (copied_growth_stage_s);
+					FreeStudyString (arena_p, copied_growth_stage_s);
 				}
 
 		}		/* if ((IsStringEmpty (growth_stage_s)) || ((copied_growth_stage_s = EasyCopyToNewString (growth_stage_s)) != NULL)) */
@@ -169,6 +178,18 @@ Observation *AllocateObservationWithErrorHandler (bson_oid_t *id_p, ObservationM
 																									const char *notes_s, const ObservationType obs_type,
 																									void (*on_error_callback_fn) (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p),
 																									ServiceJob *job_p, void *user_data_p)
+{
+	return AllocateObservationInArena (id_p, metadata_p, phenotype_p, phenotype_mem, raw_value_p, corrected_value_p, growth_stage_s,
+																		 method_s, instrument_p, nature, notes_s, obs_type, on_error_callback_fn, job_p, user_data_p, NULL);
+}
+
+
+static Observation *AllocateObservationInArena (bson_oid_t *id_p, ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p,
+																								MEM_FLAG phenotype_mem, const json_t *raw_value_p, const json_t *corrected_value_p,
+																								const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature,
+																								const char *notes_s, const ObservationType obs_type,
+																								void (*on_error_callback_fn) (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p),
+																								ServiceJob *job_p, void *user_data_p, StudyArena *arena_p)
 {
 	Observation *observation_p = NULL;
 	const ScaleClass *class_p = GetMeasuredVariableScaleClass (phenotype_p);
@@ -257,7 +278,7 @@ Observation *AllocateObservationWithErrorHandler (bson_oid_t *id_p, ObservationM
 
 						if (raw_p || corrected_p)
 							{
-								NumericObservation *numeric_obs_p = AllocateNumericObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_p, corrected_p, growth_stage_s, method_s, instrument_p, nature, notes_s);
+								NumericObservation *numeric_obs_p = AllocateNumericObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_p, corrected_p, growth_stage_s, method_s, instrument_p, nature, notes_s, arena_p);
 
 								if (numeric_obs_p)
 									{
@@ -351,7 +372,7 @@ Observation *AllocateObservationWithErrorHandler (bson_oid_t *id_p, ObservationM
 
 						if (raw_p || corrected_p)
 							{
-								IntegerObservation *int_obs_p = AllocateIntegerObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_p, corrected_p, growth_stage_s, method_s, instrument_p, nature, notes_s);
+								IntegerObservation *int_obs_p = AllocateIntegerObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_p, corrected_p, growth_stage_s, method_s, instrument_p, nature, notes_s, arena_p);
 
 								if (int_obs_p)
 									{
@@ -379,7 +400,7 @@ Observation *AllocateObservationWithErrorHandler (bson_oid_t *id_p, ObservationM
 
 						if (raw_value_s || corrected_value_s)
 							{
-								StringObservation *string_obs_p = AllocateStringObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_value_s, corrected_value_s, growth_stage_s, method_s, instrument_p, nature, notes_s);
+								StringObservation *string_obs_p = AllocateStringObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_value_s, corrected_value_s, growth_stage_s, method_s, instrument_p, nature, notes_s, arena_p);
 
 								if (string_obs_p)
 									{
@@ -436,7 +457,7 @@ Observation *AllocateObservationWithErrorHandler (bson_oid_t *id_p, ObservationM
 							{
 								if (raw_value_p || corrected_value_p)
 									{
-										TimeObservation *time_obs_p = AllocateTimeObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_time_p, corrected_time_p, growth_stage_s, method_s, instrument_p, nature, notes_s);
+										TimeObservation *time_obs_p = AllocateTimeObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_time_p, corrected_time_p, growth_stage_s, method_s, instrument_p, nature, notes_s, arena_p);
 
 										if (time_obs_p)
 											{
@@ -479,7 +500,7 @@ void ClearObservation (Observation *observation_p)
 {
 	if (observation_p -> ob_id_p)
 		{
-			FreeBSONOid (observation_p -> ob_id_p);
+			FreeStudyBSONOid (observation_p -> ob_arena_p, observation_p -> ob_id_p);
 			observation_p -> ob_id_p = NULL;
 		}
 
@@ -502,13 +523,13 @@ void ClearObservation (Observation *observation_p)
 
 	if (observation_p -> ob_method_s)
 		{
-			FreeCopiedString (observation_p -> ob_method_s);
+			FreeStudyString (observation_p -> ob_arena_p, observation_p -> ob_method_s);
 			observation_p -> ob_method_s = NULL;
 		}
 
 	if (observation_p -> ob_notes_s)
 		{
-			FreeCopiedString (observation_p -> ob_notes_s);
+			FreeStudyString (observation_p -> ob_arena_p, observation_p -> ob_notes_s);
 			observation_p -> ob_notes_s = NULL;
 		}
 
@@ -532,13 +553,13 @@ void FreeObservation (Observation *observation_p)
 	 * observation_p -> ob_instrument_p
 	 */
 
-	FreeMemory (observation_p);
+	FreeStudyMemory (observation_p -> ob_arena_p, observation_p);
 }
 
 
 ObservationNode *AllocateObservationNode (Observation *observation_p)
 {
-	ObservationNode *ob_node_p = (ObservationNode *) AllocMemory (sizeof (ObservationNode));
+	ObservationNode *ob_node_p = (ObservationNode *) AllocStudyMemory (observation_p -> ob_arena_p, sizeof (ObservationNode));
 
 	if (ob_node_p)
 		{
@@ -554,13 +575,15 @@ ObservationNode *AllocateObservationNode (Observation *observation_p)
 void FreeObservationNode (ListItem *node_p)
 {
 	ObservationNode *ob_node_p = (ObservationNode *) node_p;
+	StudyArena *arena_p = NULL;
 
 	if (ob_node_p -> on_observation_p)
 		{
+			arena_p = ob_node_p -> on_observation_p -> ob_arena_p;
 			FreeObservation (ob_node_p -> on_observation_p);
 		}
 
-	FreeMemory (ob_node_p);
+	FreeStudyMemory (arena_p, ob_node_p);
 }
 
 
@@ -744,7 +767,7 @@ bool PopulateObservationFromJSON (Observation *observation_p, const json_t *obse
 
 
 
-Observation *GetObservationFromJSON (const json_t *observation_json_p, FieldTrialServiceData *data_p)
+Observation *GetObservationFromJSON (const json_t *observation_json_p, StudyArena *arena_p, FieldTrialServiceData *data_p)
 {
 	Observation *observation_p = NULL;
 	struct tm *start_date_p = NULL;
@@ -755,7 +778,7 @@ Observation *GetObservationFromJSON (const json_t *observation_json_p, FieldTria
 
 			if (CreateValidDateFromJSON (observation_json_p, OB_END_DATE_S, &end_date_p))
 				{
-					bson_oid_t *id_p = GetNewUnitialisedBSONOid ();
+					bson_oid_t *id_p = AllocStudyBSONOid (arena_p);
 
 					if (id_p)
 						{
@@ -805,8 +828,8 @@ Observation *GetObservationFromJSON (const json_t *observation_json_p, FieldTria
 
 																					GetObservationNatureFromJSON (&nature, observation_json_p);
 
-																					observation_p = AllocateObservation (id_p, metadata_p, phenotype_p, phenotype_mem, raw_value_p, corrected_value_p, growth_stage_s, method_s,
-																																							 instrument_p, nature, notes_s, class_p -> sc_type);
+																					observation_p = AllocateObservationInArena (id_p, metadata_p, phenotype_p, phenotype_mem, raw_value_p, corrected_value_p, growth_stage_s, method_s,
+																																										instrument_p, nature, notes_s, class_p -> sc_type, NULL, NULL, NULL, arena_p);
 
 																					if (!observation_p)
 																						{
@@ -842,7 +865,7 @@ Observation *GetObservationFromJSON (const json_t *observation_json_p, FieldTria
 
 							if (!observation_p)
 								{
-									FreeBSONOid (id_p);
+									FreeStudyBSONOid (arena_p, id_p);
 								}
 						}		/* if (id_p) */
 					else
@@ -0,0 +1,602 @@
+/*
+ * observation_matrix.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "observation_matrix.h"
+
+#include "memory_allocations.h"
+#include "string_utils.h"
+#include "streams.h"
+
+#include "plot.h"
+#include "numeric_observation.h"
+#include "integer_observation.h"
+
+
+static size_t GetNumberOfStandardRows (const Study *study_p);
+
+static bool AddRowToObservationMatrix (ObservationMatrix *matrix_p, const size_t row, const StandardRow *row_p);
+
+static bool AddObservationToObservationMatrix (ObservationMatrix *matrix_p, const size_t row, const Observation *obs_p);
+
+static ObservationColumn *GetOrCreateObservationColumn (ObservationMatrix *matrix_p, const Observation *obs_p);
+
+static ObservationColumn *AllocateObservationColumn (const char *key_s, const Observation *obs_p, const size_t num_rows);
+
+static void FreeObservationColumnNode (ListItem *node_p);
+
+static bool GetObservationMatrixCode (ObservationMatrix *matrix_p, const Observation *obs_p, ObservationValueType ovt, uint32 *code_p);
+
+static bool AddToObservationMatrixDictionary (ObservationMatrix *matrix_p, const char *value_s, uint32 *code_p);
+
+static void GetObservationColumnKey (char *key_s, const MeasuredVariable *variable_p, const uint32 index);
+
+static void SetObservationMatrixValue (uint32 *bitmap_p, const size_t row);
+
+
+ObservationMatrix *AllocateObservationMatrix (const Study *study_p)
+{
+	const size_t num_rows = GetNumberOfStandardRows (study_p);
+	ObservationMatrix *matrix_p = (ObservationMatrix *) AllocMemory (sizeof (ObservationMatrix));
+
+	if (matrix_p)
+		{
+			memset (matrix_p, 0, sizeof (ObservationMatrix));
+
+			matrix_p -> om_num_rows = num_rows;
+			matrix_p -> om_columns_p = AllocateLinkedList (FreeObservationColumnNode);
+			matrix_p -> om_columns_table_p = GetHashTableOfStringPointers (64, 75);
+			matrix_p -> om_dictionary_table_p = GetHashTableOfStringPointers (256, 75);
+
+			if ((matrix_p -> om_columns_p) && (matrix_p -> om_columns_table_p) && (matrix_p -> om_dictionary_table_p))
+				{
+					/* allocate at least one entry so that empty studies don't look like failures */
+					const size_t l = (num_rows > 0) ? num_rows : 1;
+
+					matrix_p -> om_rows_pp = (const StandardRow **) AllocMemory (l * sizeof (const StandardRow *));
+					matrix_p -> om_study_indexes_p = (uint32 *) AllocMemory (l * sizeof (uint32));
+					matrix_p -> om_plot_row_indexes_p = (uint32 *) AllocMemory (l * sizeof (uint32));
+					matrix_p -> om_plot_column_indexes_p = (uint32 *) AllocMemory (l * sizeof (uint32));
+
+					if ((matrix_p -> om_rows_pp) && (matrix_p -> om_study_indexes_p) && (matrix_p -> om_plot_row_indexes_p) && (matrix_p -> om_plot_column_indexes_p))
+						{
+							PlotNode *plot_node_p = (PlotNode *) (study_p -> st_plots_p -> ll_head_p);
+							size_t row = 0;
+							bool success_flag = true;
+
+							while (plot_node_p && success_flag)
+								{
+									RowNode *row_node_p = (RowNode *) (plot_node_p -> pn_plot_p -> pl_rows_p -> ll_head_p);
+
+									while (row_node_p && success_flag)
+										{
+											if (row_node_p -> rn_row_p -> ro_type == RT_STANDARD)
+												{
+													success_flag = AddRowToObservationMatrix (matrix_p, row, (const StandardRow *) (row_node_p -> rn_row_p));
+													++ row;
+												}
+
+											row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
+										}
+
+									plot_node_p = (PlotNode *) (plot_node_p -> pn_node.ln_next_p);
+								}
+
+							if (success_flag)
+								{
+									return matrix_p;
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add row " SIZET_FMT " to observation matrix for study \"%s\"", row, study_p -> st_name_s);
+								}
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate row arrays of size " SIZET_FMT " for observation matrix for study \"%s\"", num_rows, study_p -> st_name_s);
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate column tables for observation matrix for study \"%s\"", study_p -> st_name_s);
+				}
+
+			FreeObservationMatrix (matrix_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate observation matrix for study \"%s\"", study_p -> st_name_s);
+		}
+
+	return NULL;
+}
+
+
+void FreeObservationMatrix (ObservationMatrix *matrix_p)
+{
+	if (matrix_p -> om_columns_table_p)
+		{
+			FreeHashTable (matrix_p -> om_columns_table_p);
+		}
+
+	if (matrix_p -> om_columns_p)
+		{
+			FreeLinkedList (matrix_p -> om_columns_p);
+		}
+
+	if (matrix_p -> om_dictionary_table_p)
+		{
+			FreeHashTable (matrix_p -> om_dictionary_table_p);
+		}
+
+	if (matrix_p -> om_dictionary_ss)
+		{
+			uint32 i;
+
+			for (i = 0; i < matrix_p -> om_dictionary_size; ++ i)
+				{
+					FreeCopiedString (matrix_p -> om_dictionary_ss [i]);
+				}
+
+			FreeMemory (matrix_p -> om_dictionary_ss);
+		}
+
+	if (matrix_p -> om_rows_pp)
+		{
+			FreeMemory (matrix_p -> om_rows_pp);
+		}
+
+	if (matrix_p -> om_study_indexes_p)
+		{
+			FreeMemory (matrix_p -> om_study_indexes_p);
+		}
+
+	if (matrix_p -> om_plot_row_indexes_p)
+		{
+			FreeMemory (matrix_p -> om_plot_row_indexes_p);
+		}
+
+	if (matrix_p -> om_plot_column_indexes_p)
+		{
+			FreeMemory (matrix_p -> om_plot_column_indexes_p);
+		}
+
+	FreeMemory (matrix_p);
+}
+
+
+const ObservationColumn *GetObservationMatrixColumn (const ObservationMatrix *matrix_p, const MeasuredVariable *variable_p, const uint32 index)
+{
+	char key_s [MONGO_OID_STRING_BUFFER_SIZE + 12];
+
+	GetObservationColumnKey (key_s, variable_p, index);
+
+	return ((const ObservationColumn *) GetFromHashTable (matrix_p -> om_columns_table_p, key_s));
+}
+
+
+const char *GetObservationMatrixDictionaryValue (const ObservationMatrix *matrix_p, const uint32 code)
+{
+	const char *value_s = NULL;
+
+	if (code < matrix_p -> om_dictionary_size)
+		{
+			value_s = matrix_p -> om_dictionary_ss [code];
+		}
+
+	return value_s;
+}
+
+
+
+static size_t GetNumberOfStandardRows (const Study *study_p)
+{
+	size_t num_rows = 0;
+	PlotNode *plot_node_p = (PlotNode *) (study_p -> st_plots_p -> ll_head_p);
+
+	while (plot_node_p)
+		{
+			RowNode *row_node_p = (RowNode *) (plot_node_p -> pn_plot_p -> pl_rows_p -> ll_head_p);
+
+			while (row_node_p)
+				{
+					if (row_node_p -> rn_row_p -> ro_type == RT_STANDARD)
+						{
+							++ num_rows;
+						}
+
+					row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
+				}
+
+			plot_node_p = (PlotNode *) (plot_node_p -> pn_node.ln_next_p);
+		}
+
+	return num_rows;
+}
+
+
+static bool AddRowToObservationMatrix (ObservationMatrix *matrix_p, const size_t row, const StandardRow *row_p)
+{
+	bool success_flag = true;
+	ObservationNode *obs_node_p = (ObservationNode *) (row_p -> sr_observations_p -> ll_head_p);
+	const Plot *plot_p = row_p -> sr_base.ro_plot_p;
+
+	matrix_p -> om_rows_pp [row] = row_p;
+	matrix_p -> om_study_indexes_p [row] = row_p -> sr_base.ro_by_study_index;
+	matrix_p -> om_plot_row_indexes_p [row] = plot_p ? plot_p -> pl_row_index : 0;
+	matrix_p -> om_plot_column_indexes_p [row] = plot_p ? plot_p -> pl_column_index : 0;
+
+	while (obs_node_p && success_flag)
+		{
+			success_flag = AddObservationToObservationMatrix (matrix_p, row, obs_node_p -> on_observation_p);
+			obs_node_p = (ObservationNode *) (obs_node_p -> on_node.ln_next_p);
+		}
+
+	return success_flag;
+}
+
+
+static bool AddObservationToObservationMatrix (ObservationMatrix *matrix_p, const size_t row, const Observation *obs_p)
+{
+	bool success_flag = false;
+	ObservationColumn *column_p = GetOrCreateObservationColumn (matrix_p, obs_p);
+
+	if (column_p)
+		{
+			success_flag = true;
+
+			if (column_p -> oc_type != obs_p -> ob_type)
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Observation of type %d doesn't match column \"%s\" of type %d", obs_p -> ob_type, column_p -> oc_key_s, column_p -> oc_type);
+				}
+			else if ((IS_OBSERVATION_MATRIX_VALUE_SET (column_p -> oc_raw_validity_p, row)) || (IS_OBSERVATION_MATRIX_VALUE_SET (column_p -> oc_corrected_validity_p, row)))
+				{
+					/* Only the first matching Observation on each Row is used */
+				}
+			else
+				{
+					bool added_flag = false;
+
+					switch (obs_p -> ob_type)
+						{
+							case OT_NUMERIC:
+								{
+									const NumericObservation *num_obs_p = (const NumericObservation *) obs_p;
+
+									if (num_obs_p -> no_raw_value_p)
+										{
+											column_p -> oc_raw_values_p [row] = * (num_obs_p -> no_raw_value_p);
+											SetObservationMatrixValue (column_p -> oc_raw_validity_p, row);
+											added_flag = true;
+										}
+
+									if (num_obs_p -> no_corrected_value_p)
+										{
+											column_p -> oc_corrected_values_p [row] = * (num_obs_p -> no_corrected_value_p);
+											SetObservationMatrixValue (column_p -> oc_corrected_validity_p, row);
+											added_flag = true;
+										}
+								}
+								break;
+
+							case OT_INTEGER:
+								{
+									const IntegerObservation *int_obs_p = (const IntegerObservation *) obs_p;
+
+									if (int_obs_p -> io_raw_value_p)
+										{
+											column_p -> oc_raw_values_p [row] = (double64) * (int_obs_p -> io_raw_value_p);
+											SetObservationMatrixValue (column_p -> oc_raw_validity_p, row);
+											added_flag = true;
+										}
+
+									if (int_obs_p -> io_corrected_value_p)
+										{
+											column_p -> oc_corrected_values_p [row] = (double64) * (int_obs_p -> io_corrected_value_p);
+											SetObservationMatrixValue (column_p -> oc_corrected_validity_p, row);
+											added_flag = true;
+										}
+								}
+								break;
+
+							case OT_STRING:
+							case OT_TIME:
+								{
+									if (GetObservationMatrixCode (matrix_p, obs_p, OVT_RAW_VALUE, & (column_p -> oc_raw_codes_p [row])))
+										{
+											if (column_p -> oc_raw_codes_p [row] != OBSERVATION_MATRIX_NO_CODE)
+												{
+													SetObservationMatrixValue (column_p -> oc_raw_validity_p, row);
+													added_flag = true;
+												}
+
+											if (GetObservationMatrixCode (matrix_p, obs_p, OVT_CORRECTED_VALUE, & (column_p -> oc_corrected_codes_p [row])))
+												{
+													if (column_p -> oc_corrected_codes_p [row] != OBSERVATION_MATRIX_NO_CODE)
+														{
+															SetObservationMatrixValue (column_p -> oc_corrected_validity_p, row);
+															added_flag = true;
+														}
+												}
+											else
+												{
+													success_flag = false;
+												}
+										}
+									else
+										{
+											success_flag = false;
+										}
+								}
+								break;
+
+							default:
+								break;
+						}
+
+					if (added_flag)
+						{
+							++ (column_p -> oc_num_values);
+						}
+				}
+		}
+
+	return success_flag;
+}
+
+
+static ObservationColumn *GetOrCreateObservationColumn (ObservationMatrix *matrix_p, const Observation *obs_p)
+{
+	char key_s [MONGO_OID_STRING_BUFFER_SIZE + 12];
+	const uint32 index = (obs_p -> ob_metadata_p) ? obs_p -> ob_metadata_p -> om_index : OB_DEFAULT_INDEX;
+	ObservationColumn *column_p = NULL;
+
+	GetObservationColumnKey (key_s, obs_p -> ob_phenotype_p, index);
+
+	column_p = (ObservationColumn *) GetFromHashTable (matrix_p -> om_columns_table_p, key_s);
+
+	if (!column_p)
+		{
+			column_p = AllocateObservationColumn (key_s, obs_p, matrix_p -> om_num_rows);
+
+			if (column_p)
+				{
+					/*
+					 * The key is the column's own copy so it
+					 * stays valid as long as the column does.
+					 */
+					if (PutInHashTable (matrix_p -> om_columns_table_p, column_p -> oc_key_s, column_p))
+						{
+							LinkedListAddTail (matrix_p -> om_columns_p, & (column_p -> oc_node));
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add column \"%s\" to observation matrix lookup table", key_s);
+							FreeObservationColumnNode (& (column_p -> oc_node));
+							column_p = NULL;
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate observation matrix column \"%s\"", key_s);
+				}
+		}
+
+	return column_p;
+}
+
+
+static ObservationColumn *AllocateObservationColumn (const char *key_s, const Observation *obs_p, const size_t num_rows)
+{
+	const size_t num_bitmap_words = (num_rows + 31) >> 5;
+	ObservationColumn *column_p = (ObservationColumn *) AllocMemory (sizeof (ObservationColumn));
+
+	if (column_p)
+		{
+			bool success_flag = false;
+
+			memset (column_p, 0, sizeof (ObservationColumn));
+			InitListItem (& (column_p -> oc_node));
+
+			column_p -> oc_variable_p = obs_p -> ob_phenotype_p;
+			column_p -> oc_index = (obs_p -> ob_metadata_p) ? obs_p -> ob_metadata_p -> om_index : OB_DEFAULT_INDEX;
+			column_p -> oc_type = obs_p -> ob_type;
+			strcpy (column_p -> oc_key_s, key_s);
+
+			column_p -> oc_raw_validity_p = (uint32 *) AllocMemory (num_bitmap_words * sizeof (uint32));
+			column_p -> oc_corrected_validity_p = (uint32 *) AllocMemory (num_bitmap_words * sizeof (uint32));
+
+			if ((column_p -> oc_raw_validity_p) && (column_p -> oc_corrected_validity_p))
+				{
+					memset (column_p -> oc_raw_validity_p, 0, num_bitmap_words * sizeof (uint32));
+					memset (column_p -> oc_corrected_validity_p, 0, num_bitmap_words * sizeof (uint32));
+
+					if ((column_p -> oc_type == OT_NUMERIC) || (column_p -> oc_type == OT_INTEGER))
+						{
+							column_p -> oc_raw_values_p = (double64 *) AllocMemory (num_rows * sizeof (double64));
+							column_p -> oc_corrected_values_p = (double64 *) AllocMemory (num_rows * sizeof (double64));
+
+							success_flag = (column_p -> oc_raw_values_p) && (column_p -> oc_corrected_values_p);
+						}
+					else
+						{
+							column_p -> oc_raw_codes_p = (uint32 *) AllocMemory (num_rows * sizeof (uint32));
+							column_p -> oc_corrected_codes_p = (uint32 *) AllocMemory (num_rows * sizeof (uint32));
+
+							if ((column_p -> oc_raw_codes_p) && (column_p -> oc_corrected_codes_p))
+								{
+									size_t i;
+
+									for (i = 0; i < num_rows; ++ i)
+										{
+											column_p -> oc_raw_codes_p [i] = OBSERVATION_MATRIX_NO_CODE;
+											column_p -> oc_corrected_codes_p [i] = OBSERVATION_MATRIX_NO_CODE;
+										}
+
+									success_flag = true;
+								}
+						}
+				}
+
+			if (success_flag)
+				{
+					return column_p;
+				}
+
+			FreeObservationColumnNode (& (column_p -> oc_node));
+		}
+
+	return NULL;
+}
+
+
+static void FreeObservationColumnNode (ListItem *node_p)
+{
+	ObservationColumn *column_p = (ObservationColumn *) node_p;
+
+	if (column_p -> oc_raw_values_p)
+		{
+			FreeMemory (column_p -> oc_raw_values_p);
+		}
+
+	if (column_p -> oc_corrected_values_p)
+		{
+			FreeMemory (column_p -> oc_corrected_values_p);
+		}
+
+	if (column_p -> oc_raw_codes_p)
+		{
+			FreeMemory (column_p -> oc_raw_codes_p);
+		}
+
+	if (column_p -> oc_corrected_codes_p)
+		{
+			FreeMemory (column_p -> oc_corrected_codes_p);
+		}
+
+	if (column_p -> oc_raw_validity_p)
+		{
+			FreeMemory (column_p -> oc_raw_validity_p);
+		}
+
+	if (column_p -> oc_corrected_validity_p)
+		{
+			FreeMemory (column_p -> oc_corrected_validity_p);
+		}
+
+	FreeMemory (column_p);
+}
+
+
+static bool GetObservationMatrixCode (ObservationMatrix *matrix_p, const Observation *obs_p, ObservationValueType ovt, uint32 *code_p)
+{
+	bool success_flag = true;
+	char *value_s = NULL;
+	bool free_value_flag = false;
+
+	*code_p = OBSERVATION_MATRIX_NO_CODE;
+
+	if (obs_p -> ob_get_value_as_string_fn)
+		{
+			if (obs_p -> ob_get_value_as_string_fn (obs_p, ovt, &value_s, &free_value_flag))
+				{
+					if (value_s)
+						{
+							success_flag = AddToObservationMatrixDictionary (matrix_p, value_s, code_p);
+
+							if (free_value_flag)
+								{
+									FreeCopiedString (value_s);
+								}
+						}
+				}
+		}
+
+	return success_flag;
+}
+
+
+static bool AddToObservationMatrixDictionary (ObservationMatrix *matrix_p, const char *value_s, uint32 *code_p)
+{
+	/*
+	 * The codes are stored in the table offset by 1 so
+	 * that code 0 can be told apart from a missing entry.
+	 */
+	uintptr_t stored_code = (uintptr_t) GetFromHashTable (matrix_p -> om_dictionary_table_p, value_s);
+
+	if (stored_code == 0)
+		{
+			char *copied_value_s = NULL;
+
+			if (matrix_p -> om_dictionary_size == matrix_p -> om_dictionary_capacity)
+				{
+					const uint32 new_capacity = (matrix_p -> om_dictionary_capacity > 0) ? (matrix_p -> om_dictionary_capacity) << 1 : 64;
+					char **new_dictionary_ss = (char **) AllocMemory (new_capacity * sizeof (char *));
+
+					if (new_dictionary_ss)
+						{
+							if (matrix_p -> om_dictionary_ss)
+								{
+									memcpy (new_dictionary_ss, matrix_p -> om_dictionary_ss, (matrix_p -> om_dictionary_size) * sizeof (char *));
+									FreeMemory (matrix_p -> om_dictionary_ss);
+								}
+
+							matrix_p -> om_dictionary_ss = new_dictionary_ss;
+							matrix_p -> om_dictionary_capacity = new_capacity;
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to grow observation matrix dictionary to " UINT32_FMT " entries", new_capacity);
+							return false;
+						}
+				}
+
+			copied_value_s = EasyCopyToNewString (value_s);
+
+			if (copied_value_s)
+				{
+					stored_code = (uintptr_t) (matrix_p -> om_dictionary_size) + 1;
+
+					if (PutInHashTable (matrix_p -> om_dictionary_table_p, copied_value_s, (void *) stored_code))
+						{
+							matrix_p -> om_dictionary_ss [matrix_p -> om_dictionary_size] = copied_value_s;
+							++ (matrix_p -> om_dictionary_size);
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add \"%s\" to observation matrix dictionary", value_s);
+							FreeCopiedString (copied_value_s);
+							return false;
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to copy \"%s\" for observation matrix dictionary", value_s);
+					return false;
+				}
+		}
+
+	*code_p = (uint32) (stored_code - 1);
+
+	return true;
+}
+
+
+static void GetObservationColumnKey (char *key_s, const MeasuredVariable *variable_p, const uint32 index)
+{
+	bson_oid_to_string (variable_p -> mv_id_p, key_s);
+	sprintf (key_s + strlen (key_s), ":" UINT32_FMT, index);
+}
+
+
+static void SetObservationMatrixValue (uint32 *bitmap_p, const size_t row)
+{
+	bitmap_p [row >> 5] |= ((uint32) 1) << (row & 31);
+}
@@ -0,0 +1,288 @@
+/*
+ * option_list_cache.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <pthread.h>
+#include <time.h>
+
+#include "option_list_cache.h"
+#include "shared_service_context.h"
+
+#include "crop.h"
+#include "field_trial.h"
+#include "programme.h"
+#include "study.h"
+
+#include "json_util.h"
+#include "memory_allocations.h"
+#include "streams.h"
+
+
+/**
+ * The cached option list documents for a single datatype.
+ */
+typedef struct OptionListCacheEntry
+{
+	/** The documents sorted by name, or NULL if they have not been fetched. */
+	json_t *olce_docs_p;
+
+	/** When the documents were fetched. */
+	time_t olce_fetched;
+
+	/**
+	 * This is incremented each time that the entry is cleared so that
+	 * documents fetched before then aren't stored afterwards.
+	 */
+	uint32 olce_generation;
+
+} OptionListCacheEntry;
+
+
+/**
+ * The option lists for a single database, shared by all of the services
+ * in this process that use it.
+ */
+struct OptionListCache
+{
+	pthread_mutex_t olc_mutex;
+
+	OptionListCacheEntry olc_entries [DFTD_NUM_TYPES];
+};
+
+
+static json_t *FetchOptionListDocuments (const FieldTrialDatatype datatype, const FieldTrialServiceData *data_p);
+
+static bson_t *GetOptionListQueryOptions (const FieldTrialDatatype datatype);
+
+static json_t *CopyOptionListDocuments (const json_t *docs_p, const FieldTrialDatatype datatype);
+
+
+
+OptionListCache *AllocateOptionListCache (void)
+{
+	OptionListCache *cache_p = (OptionListCache *) AllocMemory (sizeof (OptionListCache));
+
+	if (cache_p)
+		{
+			if (pthread_mutex_init (& (cache_p -> olc_mutex), NULL) == 0)
+				{
+					uint32 i;
+
+					for (i = 0; i < DFTD_NUM_TYPES; ++ i)
+						{
+							OptionListCacheEntry *entry_p = (cache_p -> olc_entries) + i;
+
+							entry_p -> olce_docs_p = NULL;
+							entry_p -> olce_fetched = 0;
+							entry_p -> olce_generation = 0;
+						}
+
+					return cache_p;
+				}
+
+			FreeMemory (cache_p);
+		}
+
+	return NULL;
+}
+
+
+void FreeOptionListCache (OptionListCache *cache_p)
+{
+	uint32 i;
+
+	for (i = 0; i < DFTD_NUM_TYPES; ++ i)
+		{
+			OptionListCacheEntry *entry_p = (cache_p -> olc_entries) + i;
+
+			if (entry_p -> olce_docs_p)
+				{
+					json_decref (entry_p -> olce_docs_p);
+				}
+		}
+
+	pthread_mutex_destroy (& (cache_p -> olc_mutex));
+	FreeMemory (cache_p);
+}
+
+
+json_t *GetOptionListDocuments (const FieldTrialDatatype datatype, const FieldTrialServiceData *data_p)
+{
+	json_t *docs_p = NULL;
+	OptionListCache *cache_p = (data_p -> dftsd_context_p) ? data_p -> dftsd_context_p -> ssc_option_lists_p : NULL;
+
+	if ((cache_p) && (data_p -> dftsd_option_list_cache_ttl > 0))
+		{
+			OptionListCacheEntry *entry_p = (cache_p -> olc_entries) + datatype;
+			uint32 generation;
+			json_t *fetched_docs_p;
+			time_t now = time (NULL);
+
+			pthread_mutex_lock (& (cache_p -> olc_mutex));
+
+			/*
+			 * Other server processes may have changed the collection so
+			 * each service only uses documents that are within its own
+			 * time to live
+			 */
+			if ((entry_p -> olce_docs_p) && (difftime (now, entry_p -> olce_fetched) <= (double) (data_p -> dftsd_option_list_cache_ttl)))
+				{
+					docs_p = CopyOptionListDocuments (entry_p -> olce_docs_p, datatype);
+					pthread_mutex_unlock (& (cache_p -> olc_mutex));
+
+					return docs_p;
+				}
+
+			generation = entry_p -> olce_generation;
+
+			pthread_mutex_unlock (& (cache_p -> olc_mutex));
+
+			/*
+			 * Don't hold the lock while querying the database so that
+			 * other datatypes and services aren't kept waiting
+			 */
+			fetched_docs_p = FetchOptionListDocuments (datatype, data_p);
+
+			if (fetched_docs_p)
+				{
+					pthread_mutex_lock (& (cache_p -> olc_mutex));
+
+					/*
+					 * Only store the documents if the entry hasn't been cleared
+					 * while we were fetching them and nobody else has stored
+					 * more recent ones.
+					 */
+					if ((entry_p -> olce_generation == generation) && ((! (entry_p -> olce_docs_p)) || (entry_p -> olce_fetched <= now)))
+						{
+							if (entry_p -> olce_docs_p)
+								{
+									json_decref (entry_p -> olce_docs_p);
+								}
+
+							entry_p -> olce_docs_p = fetched_docs_p;
+							entry_p -> olce_fetched = now;
+
+							docs_p = CopyOptionListDocuments (fetched_docs_p, datatype);
+						}
+					else
+						{
+							docs_p = fetched_docs_p;
+						}
+
+					pthread_mutex_unlock (& (cache_p -> olc_mutex));
+				}
+		}
+	else
+		{
+			docs_p = FetchOptionListDocuments (datatype, data_p);
+		}
+
+	return docs_p;
+}
+
+
+void ClearOptionListCache (const FieldTrialDatatype datatype, const FieldTrialServiceData *data_p)
+{
+	OptionListCache *cache_p = (data_p -> dftsd_context_p) ? data_p -> dftsd_context_p -> ssc_option_lists_p : NULL;
+
+	if (cache_p)
+		{
+			OptionListCacheEntry *entry_p = (cache_p -> olc_entries) + datatype;
+
+			pthread_mutex_lock (& (cache_p -> olc_mutex));
+
+			if (entry_p -> olce_docs_p)
+				{
+					json_decref (entry_p -> olce_docs_p);
+					entry_p -> olce_docs_p = NULL;
+				}
+
+			++ (entry_p -> olce_generation);
+
+			pthread_mutex_unlock (& (cache_p -> olc_mutex));
+		}
+}
+
+
+/*
+ * The cached documents are never modified so each
+ * caller gets their own copy
+ */
+static json_t *CopyOptionListDocuments (const json_t *docs_p, const FieldTrialDatatype datatype)
+{
+	json_t *copy_p = json_deep_copy (docs_p);
+
+	if (!copy_p)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to copy option list for datatype %d", datatype);
+		}
+
+	return copy_p;
+}
+
+
+static json_t *FetchOptionListDocuments (const FieldTrialDatatype datatype, const FieldTrialServiceData *data_p)
+{
+	json_t *docs_p = NULL;
+	bson_t *opts_p = GetOptionListQueryOptions (datatype);
+
+	if (opts_p)
+		{
+			if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [datatype]))
+				{
+					docs_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, NULL, opts_p);
+
+					if (!docs_p)
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get option list for \"%s\"", data_p -> dftsd_collection_ss [datatype]);
+						}
+				}
+
+			bson_destroy (opts_p);
+		}
+
+	return docs_p;
+}
+
+
+static bson_t *GetOptionListQueryOptions (const FieldTrialDatatype datatype)
+{
+	bson_t *opts_p = NULL;
+
+	switch (datatype)
+		{
+			case DFTD_PROGRAMME:
+				opts_p = BCON_NEW ("projection", "{", PR_NAME_S, BCON_BOOL (true), "}",
+													 "sort", "{", PR_NAME_S, BCON_INT32 (1), "}");
+				break;
+
+			case DFTD_FIELD_TRIAL:
+				opts_p = BCON_NEW ("projection", "{", FT_NAME_S, BCON_BOOL (true), "}",
+													 "sort", "{", FT_NAME_S, BCON_INT32 (1), "}");
+				break;
+
+			case DFTD_STUDY:
+				opts_p = BCON_NEW ("projection", "{", ST_NAME_S, BCON_BOOL (true), "}",
+													 "sort", "{", ST_NAME_S, BCON_INT32 (1), "}");
+				break;
+
+			case DFTD_CROP:
+				opts_p = BCON_NEW ("projection", "{", CR_NAME_S, BCON_BOOL (true), "}",
+													 "sort", "{", CR_NAME_S, BCON_INT32 (1), "}",
+													 "collation", "{", "locale", BCON_UTF8 ("en"), "}");
+				break;
+
+			case DFTD_LOCATION:
+				opts_p = BCON_NEW ("sort", "{", "name", BCON_INT32 (1), "}");
+				break;
+
+			default:
+				PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "No option list for datatype %d", datatype);
+				break;
+		}
+
+	return opts_p;
+}
@@ -6,16 +6,54 @@
  */
 
 
+#include <math.h>
+#include <string.h>
+
 #include "phenotype_statistics.h"
 #include "memory_allocations.h"
 #include "measured_variable_jobs.h"
 
 #include "string_utils.h"
+#include "mongodb_tool.h"
 
 #include "study.h"
+#include "plot.h"
+#include "standard_row.h"
+#include "observation_matrix.h"
+#include "dfw_util.h"
+
 
 static const char * const S_MV_ID_S = "measured_variable_id";
 
+/*
+ * The relative difference allowed between the aggregated
+ * and in-process statistics when verifying them.
+ */
+static const double64 S_STATISTICS_TOLERANCE = 1e-9;
+
+
+static bool GetPhenotypeStatisticsFromPlots (const Study *study_p, LinkedList *stats_p, size_t *num_failures_p);
+
+static bool GetPhenotypeStatisticsFromAggregation (const Study *study_p, LinkedList *stats_p, size_t *num_failures_p, const FieldTrialServiceData *service_data_p);
+
+static bson_t *GetPhenotypeStatisticsPipeline (const Study *study_p);
+
+static bool AddPhenotypeStatisticsNodeFromAggregation (const bson_t *doc_p, LinkedList *stats_p, size_t *num_failures_p, const FieldTrialServiceData *service_data_p);
+
+static void VerifyPhenotypeStatistics (const Study *study_p, const LinkedList *stats_p);
+
+static bool AreStatisticsValuesEqual (const double64 expected, const double64 actual);
+
+static OperationStatus SetStudyPhenotypeStatisticsFromList (Study *study_p, const LinkedList *stats_p, const size_t num_failures);
+
+static bool IsFirstObservationColumnForVariable (const ObservationColumn *column_p);
+
+static size_t GetNumericObservationColumnsForVariable (const ObservationColumn *first_column_p, const ObservationColumn **columns_pp);
+
+static bool CalculateObservationColumnsStatistics (const ObservationColumn **columns_pp, const size_t num_columns, const size_t num_rows, Statistics *stats_p);
+
+static bool SetStudyPhenotypeStatistics (Study *study_p, const char *mv_s, const Statistics *stats_p);
+
 
 PhenotypeStatisticsNode *AllocatePhenotypeStatisticsNode (const char *measured_variable_name_s, const Statistics *src_p)
 {
@@ -292,3 +330,731 @@ bool AddPhenotypeStatisticsNodeFromJSON (Study *study_p, const json_t *phenotype
 
 	return success_flag;
 }
+
+
+
+OperationStatus CalculatePhenotypeStatisticsForStudy (Study *study_p, const FieldTrialServiceData *service_data_p)
+{
+	OperationStatus status = OS_FAILED;
+	LinkedList *stats_p = AllocateLinkedList (FreePhenotypeStatisticsNode);
+
+	if (stats_p)
+		{
+			size_t num_failures = 0;
+
+			if (GetPhenotypeStatisticsFromPlots (study_p, stats_p, &num_failures))
+				{
+					status = SetStudyPhenotypeStatisticsFromList (study_p, stats_p, num_failures);
+				}
+
+			FreeLinkedList (stats_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate statistics list for study \"%s\"", study_p -> st_name_s);
+		}
+
+	return status;
+}
+
+
+OperationStatus CalculatePhenotypeStatisticsForStudyByAggregation (Study *study_p, const FieldTrialServiceData *service_data_p)
+{
+	OperationStatus status = OS_FAILED;
+	LinkedList *stats_p = AllocateLinkedList (FreePhenotypeStatisticsNode);
+
+	if (stats_p)
+		{
+			size_t num_failures = 0;
+
+			if (GetPhenotypeStatisticsFromAggregation (study_p, stats_p, &num_failures, service_data_p))
+				{
+					if (service_data_p -> dftsd_verify_statistics_flag)
+						{
+							VerifyPhenotypeStatistics (study_p, stats_p);
+						}
+
+					status = SetStudyPhenotypeStatisticsFromList (study_p, stats_p, num_failures);
+				}
+
+			FreeLinkedList (stats_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate statistics list for study \"%s\"", study_p -> st_name_s);
+		}
+
+	return status;
+}
+
+
+static bool GetPhenotypeStatisticsFromPlots (const Study *study_p, LinkedList *stats_p, size_t *num_failures_p)
+{
+	bool success_flag = false;
+	ObservationMatrix *matrix_p = AllocateObservationMatrix (study_p);
+
+	if (matrix_p)
+		{
+			const size_t num_columns = matrix_p -> om_columns_p -> ll_size;
+			const ObservationColumn **columns_pp = (const ObservationColumn **) AllocMemory ((num_columns > 0 ? num_columns : 1) * sizeof (const ObservationColumn *));
+
+			if (columns_pp)
+				{
+					const ObservationColumn *column_p = (const ObservationColumn *) (matrix_p -> om_columns_p -> ll_head_p);
+
+					success_flag = true;
+
+					/*
+					 * Get the statistics once for each MeasuredVariable,
+					 * in the order that they were first seen
+					 */
+					while (column_p && success_flag)
+						{
+							if (IsFirstObservationColumnForVariable (column_p))
+								{
+									const char *mv_s = GetMeasuredVariableName (column_p -> oc_variable_p);
+
+									if (mv_s)
+										{
+											Statistics stats;
+											Statistics *column_stats_p = NULL;
+											const size_t num_numeric_columns = GetNumericObservationColumnsForVariable (column_p, columns_pp);
+											PhenotypeStatisticsNode *node_p = NULL;
+
+											if (CalculateObservationColumnsStatistics (columns_pp, num_numeric_columns, matrix_p -> om_num_rows, &stats))
+												{
+													column_stats_p = &stats;
+												}
+
+											node_p = AllocatePhenotypeStatisticsNode (mv_s, column_stats_p);
+
+											if (node_p)
+												{
+													LinkedListAddTail (stats_p, & (node_p -> psn_node));
+												}
+											else
+												{
+													success_flag = false;
+												}
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "No name for measured variable column \"%s\" in study \"%s\"", column_p -> oc_key_s, study_p -> st_name_s);
+											++ (*num_failures_p);
+										}
+								}
+
+							column_p = (const ObservationColumn *) (column_p -> oc_node.ln_next_p);
+						}		/* while (column_p && success_flag) */
+
+					FreeMemory (columns_pp);
+				}		/* if (columns_pp) */
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate " SIZET_FMT " statistics columns for study \"%s\"", num_columns, study_p -> st_name_s);
+				}
+
+			FreeObservationMatrix (matrix_p);
+		}		/* if (matrix_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to build observation matrix for study \"%s\"", study_p -> st_name_s);
+		}
+
+	return success_flag;
+}
+
+
+static bool GetPhenotypeStatisticsFromAggregation (const Study *study_p, LinkedList *stats_p, size_t *num_failures_p, const FieldTrialServiceData *service_data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (service_data_p -> dftsd_mongo_p, service_data_p -> dftsd_collection_ss [DFTD_PLOT]))
+		{
+			bson_t *pipeline_p = GetPhenotypeStatisticsPipeline (study_p);
+
+			if (pipeline_p)
+				{
+					/* Large studies can go over the memory limit for the $group stages */
+					bson_t *opts_p = BCON_NEW ("allowDiskUse", BCON_BOOL (true));
+					mongoc_cursor_t *cursor_p = mongoc_collection_aggregate (service_data_p -> dftsd_mongo_p -> mt_collection_p, MONGOC_QUERY_NONE, pipeline_p, opts_p, NULL);
+
+					if (cursor_p)
+						{
+							const bson_t *doc_p = NULL;
+							bson_error_t error;
+
+							success_flag = true;
+
+							while (success_flag && mongoc_cursor_next (cursor_p, &doc_p))
+								{
+									success_flag = AddPhenotypeStatisticsNodeFromAggregation (doc_p, stats_p, num_failures_p, service_data_p);
+								}
+
+							if (mongoc_cursor_error (cursor_p, &error))
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Statistics aggregation failed for study \"%s\": \"%s\"", study_p -> st_name_s, error.message);
+									success_flag = false;
+								}
+
+							mongoc_cursor_destroy (cursor_p);
+						}		/* if (cursor_p) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to run statistics aggregation for study \"%s\"", study_p -> st_name_s);
+						}
+
+					if (opts_p)
+						{
+							bson_destroy (opts_p);
+						}
+
+					bson_destroy (pipeline_p);
+				}		/* if (pipeline_p) */
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to build statistics aggregation for study \"%s\"", study_p -> st_name_s);
+				}
+
+		}		/* if (SetMongoToolCollection (service_data_p -> dftsd_mongo_p, service_data_p -> dftsd_collection_ss [DFTD_PLOT])) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set collection to \"%s\"", service_data_p -> dftsd_collection_ss [DFTD_PLOT]);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Build the pipeline that gets the same values as GetPhenotypeStatisticsFromPlots ()
+ * does, i.e. for each Row and MeasuredVariable, the corrected or raw value of the
+ * lowest indexed numeric Observation. NumericObservations always store their values
+ * as doubles so that is how they are told apart from the other types.
+ *
+ * Rather than sorting every Observation in the Study, the Observation to use for
+ * each Row is picked with $min on a document whose first field is 0 for numeric
+ * values and 1 otherwise, followed by the index. Observations that embed their
+ * MeasuredVariable rather than storing its id are grouped by the embedded id.
+ */
+static bson_t *GetPhenotypeStatisticsPipeline (const Study *study_p)
+{
+	bson_t *pipeline_p = NULL;
+	char *rows_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, NULL);
+	char *observations_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, ".", SR_OBSERVATIONS_S, NULL);
+	char *phenotype_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, ".", SR_OBSERVATIONS_S, ".", OB_PHENOTYPE_ID_S, NULL);
+	char *embedded_phenotype_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, ".", SR_OBSERVATIONS_S, ".", OB_PHENOTYPE_S, ".", MONGO_ID_S, NULL);
+	char *index_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, ".", SR_OBSERVATIONS_S, ".", OB_INDEX_S, NULL);
+	char *raw_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, ".", SR_OBSERVATIONS_S, ".", OB_RAW_VALUE_S, NULL);
+	char *corrected_path_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, ".", SR_OBSERVATIONS_S, ".", OB_CORRECTED_VALUE_S, NULL);
+
+	if (rows_path_s && observations_path_s && phenotype_path_s && embedded_phenotype_path_s && index_path_s && raw_path_s && corrected_path_s)
+		{
+			pipeline_p = BCON_NEW ("pipeline", "[",
+				"{", "$match", "{", PL_PARENT_STUDY_S, BCON_OID (study_p -> st_id_p), "}", "}",
+				"{", "$unwind", "{", "path", BCON_UTF8 (rows_path_s), "includeArrayIndex", BCON_UTF8 ("row"), "}", "}",
+				"{", "$unwind", BCON_UTF8 (observations_path_s), "}",
+				"{", "$project", "{",
+					"row", BCON_INT32 (1),
+					"phenotype", "{", "$ifNull", "[", BCON_UTF8 (phenotype_path_s), BCON_UTF8 (embedded_phenotype_path_s), "]", "}",
+					"index", "{", "$ifNull", "[", BCON_UTF8 (index_path_s), BCON_INT32 (OB_DEFAULT_INDEX), "]", "}",
+					"value", "{", "$ifNull", "[", BCON_UTF8 (corrected_path_s), BCON_UTF8 (raw_path_s), "]", "}",
+				"}", "}",
+				"{", "$group", "{",
+					"_id", "{", "plot", BCON_UTF8 ("$_id"), "row", BCON_UTF8 ("$row"), "phenotype", BCON_UTF8 ("$phenotype"), "}",
+					"first", "{", "$min", "{",
+						"n", "{", "$cond", "[", "{", "$eq", "[", "{", "$type", BCON_UTF8 ("$value"), "}", BCON_UTF8 ("double"), "]", "}", BCON_INT32 (0), BCON_INT32 (1), "]", "}",
+						"i", BCON_UTF8 ("$index"),
+						"v", BCON_UTF8 ("$value"),
+					"}", "}",
+				"}", "}",
+				"{", "$project", "{",
+					"numeric", "{", "$eq", "[", BCON_UTF8 ("$first.n"), BCON_INT32 (0), "]", "}",
+					"value", BCON_UTF8 ("$first.v"),
+				"}", "}",
+				"{", "$group", "{",
+					"_id", BCON_UTF8 ("$_id.phenotype"),
+					"rows", "{", "$sum", BCON_INT32 (1), "}",
+					"count", "{", "$sum", "{", "$cond", "[", BCON_UTF8 ("$numeric"), BCON_INT32 (1), BCON_INT32 (0), "]", "}", "}",
+					"sum", "{", "$sum", "{", "$cond", "[", BCON_UTF8 ("$numeric"), BCON_UTF8 ("$value"), BCON_DOUBLE (0.0), "]", "}", "}",
+					"std_dev", "{", "$stdDevPop", "{", "$cond", "[", BCON_UTF8 ("$numeric"), BCON_UTF8 ("$value"), BCON_NULL, "]", "}", "}",
+					"min", "{", "$min", "{", "$cond", "[", BCON_UTF8 ("$numeric"), BCON_UTF8 ("$value"), BCON_NULL, "]", "}", "}",
+					"max", "{", "$max", "{", "$cond", "[", BCON_UTF8 ("$numeric"), BCON_UTF8 ("$value"), BCON_NULL, "]", "}", "}",
+				"}", "}",
+			"]");
+		}
+
+	if (corrected_path_s)
+		{
+			FreeCopiedString (corrected_path_s);
+		}
+
+	if (raw_path_s)
+		{
+			FreeCopiedString (raw_path_s);
+		}
+
+	if (index_path_s)
+		{
+			FreeCopiedString (index_path_s);
+		}
+
+	if (embedded_phenotype_path_s)
+		{
+			FreeCopiedString (embedded_phenotype_path_s);
+		}
+
+	if (phenotype_path_s)
+		{
+			FreeCopiedString (phenotype_path_s);
+		}
+
+	if (observations_path_s)
+		{
+			FreeCopiedString (observations_path_s);
+		}
+
+	if (rows_path_s)
+		{
+			FreeCopiedString (rows_path_s);
+		}
+
+	return pipeline_p;
+}
+
+
+static bool AddPhenotypeStatisticsNodeFromAggregation (const bson_t *doc_p, LinkedList *stats_p, size_t *num_failures_p, const FieldTrialServiceData *service_data_p)
+{
+	bool success_flag = true;
+	bson_iter_t iter;
+
+	if (bson_iter_init_find (&iter, doc_p, MONGO_ID_S) && BSON_ITER_HOLDS_OID (&iter))
+		{
+			MeasuredVariable *mv_p = GetMeasuredVariableById (bson_iter_oid (&iter), service_data_p);
+
+			if (mv_p)
+				{
+					const char *mv_s = GetMeasuredVariableName (mv_p);
+
+					if (mv_s)
+						{
+							Statistics stats;
+							Statistics *group_stats_p = NULL;
+							PhenotypeStatisticsNode *node_p = NULL;
+							int64 count = 0;
+
+							if (bson_iter_init_find (&iter, doc_p, "count"))
+								{
+									count = bson_iter_as_int64 (&iter);
+								}
+
+							if (count > 0)
+								{
+									double64 sum = 0.0;
+
+									memset (&stats, 0, sizeof (Statistics));
+
+									if (bson_iter_init_find (&iter, doc_p, "sum"))
+										{
+											sum = bson_iter_as_double (&iter);
+										}
+
+									/* $stdDevPop gives the population standard deviation to match CalculateStatistics () */
+									if (bson_iter_init_find (&iter, doc_p, "std_dev"))
+										{
+											stats.st_std_dev = bson_iter_as_double (&iter);
+										}
+
+									if (bson_iter_init_find (&iter, doc_p, "min"))
+										{
+											stats.st_min = bson_iter_as_double (&iter);
+										}
+
+									if (bson_iter_init_find (&iter, doc_p, "max"))
+										{
+											stats.st_max = bson_iter_as_double (&iter);
+										}
+
+									stats.st_population_size = (size_t) count;
+									stats.st_sum = sum;
+									stats.st_mean = sum / ((double64) count);
+									stats.st_variance = stats.st_std_dev * stats.st_std_dev;
+
+									group_stats_p = &stats;
+								}
+
+							node_p = AllocatePhenotypeStatisticsNode (mv_s, group_stats_p);
+
+							if (node_p)
+								{
+									LinkedListAddTail (stats_p, & (node_p -> psn_node));
+								}
+							else
+								{
+									success_flag = false;
+								}
+						}
+					else
+						{
+							PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, doc_p, "No name for measured variable");
+							++ (*num_failures_p);
+						}
+
+					FreeMeasuredVariable (mv_p);
+				}
+			else
+				{
+					PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, doc_p, "GetMeasuredVariableById () failed");
+					++ (*num_failures_p);
+				}
+		}
+	else
+		{
+			/*
+			 * These are the Observations with neither a phenotype id nor an
+			 * embedded phenotype with an id, so we can't tell which variable
+			 * they are for.
+			 */
+			int64 num_rows = 0;
+
+			if (bson_iter_init_find (&iter, doc_p, "rows"))
+				{
+					num_rows = bson_iter_as_int64 (&iter);
+				}
+
+			PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, doc_p, SIZET_FMT " rows have observations without a measured variable id", (size_t) num_rows);
+			++ (*num_failures_p);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Compare the statistics from the aggregation against those from the
+ * in-process engine, logging any differences.
+ */
+static void VerifyPhenotypeStatistics (const Study *study_p, const LinkedList *stats_p)
+{
+	LinkedList *expected_stats_p = AllocateLinkedList (FreePhenotypeStatisticsNode);
+
+	if (expected_stats_p)
+		{
+			size_t num_failures = 0;
+
+			if (GetPhenotypeStatisticsFromPlots (study_p, expected_stats_p, &num_failures))
+				{
+					const PhenotypeStatisticsNode *expected_node_p = (const PhenotypeStatisticsNode *) (expected_stats_p -> ll_head_p);
+					size_t num_mismatches = 0;
+
+					while (expected_node_p)
+						{
+							const PhenotypeStatisticsNode *node_p = (const PhenotypeStatisticsNode *) (stats_p -> ll_head_p);
+							const Statistics *expected_p = expected_node_p -> psn_stats_p;
+
+							while (node_p && (strcmp (node_p -> psn_measured_variable_name_s, expected_node_p -> psn_measured_variable_name_s) != 0))
+								{
+									node_p = (const PhenotypeStatisticsNode *) (node_p -> psn_node.ln_next_p);
+								}
+
+							if (node_p)
+								{
+									const Statistics *actual_p = node_p -> psn_stats_p;
+
+									if ((!expected_p) || (!actual_p))
+										{
+											if (expected_p != actual_p)
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Statistics for \"%s\" in study \"%s\" are set by only one of the engines", expected_node_p -> psn_measured_variable_name_s, study_p -> st_name_s);
+													++ num_mismatches;
+												}
+										}
+									else if ((expected_p -> st_population_size != actual_p -> st_population_size) ||
+										(!AreStatisticsValuesEqual (expected_p -> st_mean, actual_p -> st_mean)) ||
+										(!AreStatisticsValuesEqual (expected_p -> st_sum, actual_p -> st_sum)) ||
+										(!AreStatisticsValuesEqual (expected_p -> st_min, actual_p -> st_min)) ||
+										(!AreStatisticsValuesEqual (expected_p -> st_max, actual_p -> st_max)) ||
+										(!AreStatisticsValuesEqual (expected_p -> st_std_dev, actual_p -> st_std_dev)))
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Statistics for \"%s\" in study \"%s\" differ, in-process: n " SIZET_FMT " mean %lf sd %lf, aggregation: n " SIZET_FMT " mean %lf sd %lf",
+												expected_node_p -> psn_measured_variable_name_s, study_p -> st_name_s,
+												expected_p -> st_population_size, expected_p -> st_mean, expected_p -> st_std_dev,
+												actual_p -> st_population_size, actual_p -> st_mean, actual_p -> st_std_dev);
+											++ num_mismatches;
+										}
+								}
+							else if (expected_p)
+								{
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "No aggregated statistics for \"%s\" in study \"%s\"", expected_node_p -> psn_measured_variable_name_s, study_p -> st_name_s);
+									++ num_mismatches;
+								}
+
+							expected_node_p = (const PhenotypeStatisticsNode *) (expected_node_p -> psn_node.ln_next_p);
+						}		/* while (expected_node_p) */
+
+					if (num_mismatches == 0)
+						{
+							PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Aggregated statistics for study \"%s\" match the in-process ones", study_p -> st_name_s);
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get in-process statistics to verify study \"%s\"", study_p -> st_name_s);
+				}
+
+			FreeLinkedList (expected_stats_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to allocate statistics list to verify study \"%s\"", study_p -> st_name_s);
+		}
+}
+
+
+static bool AreStatisticsValuesEqual (const double64 expected, const double64 actual)
+{
+	const double64 scale = (fabs (expected) > 1.0) ? fabs (expected) : 1.0;
+
+	return (fabs (expected - actual) <= (S_STATISTICS_TOLERANCE * scale));
+}
+
+
+static OperationStatus SetStudyPhenotypeStatisticsFromList (Study *study_p, const LinkedList *stats_p, const size_t num_failures)
+{
+	OperationStatus status = OS_FAILED;
+	const PhenotypeStatisticsNode *node_p = (const PhenotypeStatisticsNode *) (stats_p -> ll_head_p);
+	size_t num_successes = 0;
+
+	/*
+	 * Fill in all of the Study's phenotype entries together
+	 */
+	while (node_p)
+		{
+			if (SetStudyPhenotypeStatistics (study_p, node_p -> psn_measured_variable_name_s, node_p -> psn_stats_p))
+				{
+					++ num_successes;
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set statistics for \"%s\" in study \"%s\"", node_p -> psn_measured_variable_name_s, study_p -> st_name_s);
+				}
+
+			node_p = (const PhenotypeStatisticsNode *) (node_p -> psn_node.ln_next_p);
+		}
+
+	if ((num_successes == stats_p -> ll_size) && (num_failures == 0))
+		{
+			status = OS_SUCCEEDED;
+		}
+	else if (num_successes > 0)
+		{
+			status = OS_PARTIALLY_SUCCEEDED;
+		}
+
+	return status;
+}
+
+
+static bool IsFirstObservationColumnForVariable (const ObservationColumn *column_p)
+{
+	const ObservationColumn *prev_p = (const ObservationColumn *) (column_p -> oc_node.ln_prev_p);
+
+	while (prev_p)
+		{
+			if (bson_oid_equal (prev_p -> oc_variable_p -> mv_id_p, column_p -> oc_variable_p -> mv_id_p))
+				{
+					return false;
+				}
+
+			prev_p = (const ObservationColumn *) (prev_p -> oc_node.ln_prev_p);
+		}
+
+	return true;
+}
+
+
+/*
+ * Get all of the OT_NUMERIC columns for the MeasuredVariable
+ * sorted by their observation index.
+ */
+static size_t GetNumericObservationColumnsForVariable (const ObservationColumn *first_column_p, const ObservationColumn **columns_pp)
+{
+	const ObservationColumn *column_p = first_column_p;
+	size_t num_columns = 0;
+
+	while (column_p)
+		{
+			if ((column_p -> oc_type == OT_NUMERIC) && (bson_oid_equal (column_p -> oc_variable_p -> mv_id_p, first_column_p -> oc_variable_p -> mv_id_p)))
+				{
+					size_t i = num_columns;
+
+					while ((i > 0) && (columns_pp [i - 1] -> oc_index > column_p -> oc_index))
+						{
+							columns_pp [i] = columns_pp [i - 1];
+							-- i;
+						}
+
+					columns_pp [i] = column_p;
+					++ num_columns;
+				}
+
+			column_p = (const ObservationColumn *) (column_p -> oc_node.ln_next_p);
+		}
+
+	return num_columns;
+}
+
+
+static bool CalculateObservationColumnsStatistics (const ObservationColumn **columns_pp, const size_t num_columns, const size_t num_rows, Statistics *stats_p)
+{
+	size_t count = 0;
+	double64 sum = 0.0;
+	double64 min = 0.0;
+	double64 max = 0.0;
+	size_t row;
+
+	/*
+	 * Each Row contributes its value from the lowest indexed column
+	 * that has one, using the corrected value in preference to the raw one
+	 */
+	for (row = 0; row < num_rows; ++ row)
+		{
+			size_t i;
+
+			for (i = 0; i < num_columns; ++ i)
+				{
+					const ObservationColumn *column_p = columns_pp [i];
+					const double64 *values_p = NULL;
+
+					if (IS_OBSERVATION_MATRIX_VALUE_SET (column_p -> oc_corrected_validity_p, row))
+						{
+							values_p = column_p -> oc_corrected_values_p;
+						}
+					else if (IS_OBSERVATION_MATRIX_VALUE_SET (column_p -> oc_raw_validity_p, row))
+						{
+							values_p = column_p -> oc_raw_values_p;
+						}
+
+					if (values_p)
+						{
+							const double64 value = values_p [row];
+
+							if (count == 0)
+								{
+									min = value;
+									max = value;
+								}
+							else if (value < min)
+								{
+									min = value;
+								}
+							else if (value > max)
+								{
+									max = value;
+								}
+
+							sum += value;
+							++ count;
+
+							break;
+						}
+				}
+		}
+
+	if (count > 0)
+		{
+			const double64 mean = sum / ((double64) count);
+			double64 m2 = 0.0;
+
+			/*
+			 * The values are in arrays so a second pass to get the sum
+			 * of squared differences from the mean is cheap and more
+			 * accurate than the textbook single pass formula
+			 */
+			for (row = 0; row < num_rows; ++ row)
+				{
+					size_t i;
+
+					for (i = 0; i < num_columns; ++ i)
+						{
+							const ObservationColumn *column_p = columns_pp [i];
+							const double64 *values_p = NULL;
+
+							if (IS_OBSERVATION_MATRIX_VALUE_SET (column_p -> oc_corrected_validity_p, row))
+								{
+									values_p = column_p -> oc_corrected_values_p;
+								}
+							else if (IS_OBSERVATION_MATRIX_VALUE_SET (column_p -> oc_raw_validity_p, row))
+								{
+									values_p = column_p -> oc_raw_values_p;
+								}
+
+							if (values_p)
+								{
+									const double64 diff = values_p [row] - mean;
+
+									m2 += diff * diff;
+									break;
+								}
+						}
+				}
+
+			memset (stats_p, 0, sizeof (Statistics));
+
+			/* The population variance to match CalculateStatistics () */
+			stats_p -> st_population_size = count;
+			stats_p -> st_mean = mean;
+			stats_p -> st_sum = sum;
+			stats_p -> st_min = min;
+			stats_p -> st_max = max;
+			stats_p -> st_variance = m2 / ((double64) count);
+			stats_p -> st_std_dev = sqrt (stats_p -> st_variance);
+
+			return true;
+		}
+
+	return false;
+}
+
+
+static bool SetStudyPhenotypeStatistics (Study *study_p, const char *mv_s, const Statistics *stats_p)
+{
+	PhenotypeStatisticsNode *node_p = (PhenotypeStatisticsNode *) (study_p -> st_phenotypes_p -> ll_head_p);
+
+	/*
+	 * If the Study already has an entry for this MeasuredVariable, update it
+	 * rather than adding a duplicate
+	 */
+	while (node_p)
+		{
+			if (strcmp (node_p -> psn_measured_variable_name_s, mv_s) == 0)
+				{
+					Statistics *copied_stats_p = NULL;
+
+					if (stats_p)
+						{
+							copied_stats_p = CopyStatistics (stats_p);
+
+							if (!copied_stats_p)
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "CopyStatistics () failed for \"%s\"", mv_s);
+									return false;
+								}
+						}
+
+					if (node_p -> psn_stats_p)
+						{
+							FreeStatistics (node_p -> psn_stats_p);
+						}
+
+					node_p -> psn_stats_p = copied_stats_p;
+
+					return true;
+				}
+
+			node_p = (PhenotypeStatisticsNode *) (node_p -> psn_node.ln_next_p);
+		}
+
+	return AddPhenotypeStatisticsToStudy (study_p, mv_s, stats_p);
+}
+
@@ -31,6 +31,8 @@
 #include "study.h"
 #include "int_linked_list.h"
 #include "mongodb_util.h"
+#include "revision_store.h"
+#include "material_usage.h"
 
 
 static bool AddRowsToJSON (const Plot *plot_p, json_t *plot_json_p, const ViewFormat format, JSONProcessor *processor_p, const FieldTrialServiceData *data_p);
@@ -44,21 +46,22 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 										const uint32 column_index, const char *treatments_s, const char *comment_s, const char *image_s, const char *thumbnail_s,
 										const uint32 *sowing_order_p, const uint32 *walking_order_p, Study *parent_p)
 {
+	StudyArena *arena_p = parent_p ? parent_p -> st_arena_p : NULL;
 	char *copied_treatments_s = NULL;
 
-	if ((IsStringEmpty (treatments_s)) || ((copied_treatments_s = EasyCopyToNewString (treatments_s)) != NULL))
+	if ((IsStringEmpty (treatments_s)) || ((copied_treatments_s = CopyStudyString (arena_p, treatments_s)) != NULL))
 		{
 			char *copied_comment_s = NULL;
 
-			if ((IsStringEmpty (comment_s)) || ((copied_comment_s = EasyCopyToNewString (comment_s)) != NULL))
+			if ((IsStringEmpty (comment_s)) || ((copied_comment_s = CopyStudyString (arena_p, comment_s)) != NULL))
 				{
 					char *copied_image_s = NULL;
 
-					if ((IsStringEmpty (image_s)) || ((copied_image_s = EasyCopyToNewString (image_s)) != NULL))
+					if ((IsStringEmpty (image_s)) || ((copied_image_s = CopyStudyString (arena_p, image_s)) != NULL))
 						{
 							char *copied_thumbnail_s = NULL;
 
-							if ((IsStringEmpty (thumbnail_s)) || ((copied_thumbnail_s = EasyCopyToNewString (thumbnail_s)) != NULL))
+							if ((IsStringEmpty (thumbnail_s)) || ((copied_thumbnail_s = CopyStudyString (arena_p, thumbnail_s)) != NULL))
 								{
 									struct tm *copied_sowing_date_p = NULL;
 
@@ -70,25 +73,25 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 												{
 													double64 *copied_width_p = NULL;
 
-													if (CopyValidReal (width_p, &copied_width_p))
+													if (CopyValidStudyReal (arena_p, width_p, &copied_width_p))
 														{
 															double64 *copied_length_p = NULL;
 
-															if (CopyValidReal (length_p, &copied_length_p))
+															if (CopyValidStudyReal (arena_p, length_p, &copied_length_p))
 																{
 																	uint32 *copied_sowing_order_p = NULL;
 
-																	if (CopyValidUnsignedInteger (sowing_order_p, &copied_sowing_order_p))
+																	if (CopyValidStudyUnsignedInteger (arena_p, sowing_order_p, &copied_sowing_order_p))
 																		{
 																			uint32 *copied_walking_order_p = NULL;
 
-																			if (CopyValidUnsignedInteger (walking_order_p, &copied_walking_order_p))
+																			if (CopyValidStudyUnsignedInteger (arena_p, walking_order_p, &copied_walking_order_p))
 																				{
 																					LinkedList *rows_p = AllocateLinkedList (FreeRowNode);
 
 																					if (rows_p)
 																						{
-																							Plot *plot_p = (Plot *) AllocMemory (sizeof (Plot));
+																							Plot *plot_p = (Plot *) AllocStudyMemory (arena_p, sizeof (Plot));
 
 																							if (plot_p)
 																								{
@@ -102,6 +105,7 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 																									plot_p -> pl_parent_p = parent_p;
 																									plot_p -> pl_rows_p = rows_p;
+																									plot_p -> pl_partial_rows_flag = false;
 
 																									plot_p -> pl_comment_s = copied_comment_s;
 
@@ -117,6 +121,8 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 																									plot_p -> pl_sowing_order_index_p = copied_sowing_order_p;
 																									plot_p -> pl_walking_order_index_p = copied_walking_order_p;
 
+																									plot_p -> pl_arena_p = arena_p;
+
 																									return plot_p;
 																								}		/* if (plot_p) */
 
@@ -126,7 +132,7 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 																					if (copied_walking_order_p)
 																						{
-																							FreeMemory (copied_walking_order_p);
+																							FreeStudyMemory (arena_p, copied_walking_order_p);
 																						}
 																				}		/* if (CopyValidUnsignedInteger (harvest_order_p, &copied_harvest_order_p)) */
 																			else
@@ -138,9 +144,9 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 																			if (copied_sowing_order_p)
 																				{
-																					FreeMemory (copied_sowing_order_p);
+																					FreeStudyMemory (arena_p, copied_sowing_order_p);
 																				}
-																		}		/* if (CopyValidUnsignedInteger (sowing_order_p, &copied_sowing_order_p)) */
+																		}		/* if (CopyValidStudyUnsignedInteger (arena_p, sowing_order_p, &copied_sowing_order_p)) */
 																	else
 																		{
 																			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to copy sowing order %lu\n", sowing_order_p ? *sowing_order_p : 0);
@@ -149,18 +155,18 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 																	if (copied_length_p)
 																		{
-																			FreeMemory (copied_length_p);
+																			FreeStudyMemory (arena_p, copied_length_p);
 																		}
 
-																}		/* if (CopyValidReal (length_p, &copied_length_p)) */
+																}		/* if (CopyValidStudyReal (arena_p, length_p, &copied_length_p)) */
 
 
 															if (copied_width_p)
 																{
-																	FreeMemory (copied_width_p);
+																	FreeStudyMemory (arena_p, copied_width_p);
 																}
 
-														}		/* if (CopyValidReal (width_p, &copied_width_p)) */
+														}		/* if (CopyValidStudyReal (arena_p, width_p, &copied_width_p)) */
 
 
 													if (copied_harvest_date_p)
@@ -179,7 +185,7 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 									if (copied_thumbnail_s)
 										{
-											FreeCopiedString (copied_thumbnail_s);
+											FreeStudyString (arena_p, copied_thumbnail_s);
 										}
 
 								}		/* if ((IsStringEmpty (thumbnail_s)) || ((copied_thumbnail_s = EasyCopyToNewString (thumbnail_s)) != NULL)) */
@@ -187,13 +193,13 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 							if (copied_image_s)
 								{
-									FreeCopiedString (copied_image_s);
+									FreeStudyString (arena_p, copied_image_s);
 								}
 						}
 
 					if (copied_comment_s)
 						{
-							FreeCopiedString (copied_comment_s);
+							FreeStudyString (arena_p, copied_comment_s);
 						}
 
 
@@ -202,7 +208,7 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 			if (copied_treatments_s)
 				{
-					FreeCopiedString (copied_treatments_s);
+					FreeStudyString (arena_p, copied_treatments_s);
 				}
 
 		}		/* if ((IsStringEmpty (treatments_s)) || ((copied_treatments_s = EasyCopyToNewString (treatments_s)) != NULL)) */
@@ -215,30 +221,32 @@ Plot *AllocatePlot (bson_oid_t *id_p, const struct tm *sowing_date_p, const stru
 
 void FreePlot (Plot *plot_p)
 {
+	StudyArena *arena_p = plot_p -> pl_arena_p;
+
 	if (plot_p -> pl_id_p)
 		{
-			FreeBSONOid (plot_p -> pl_id_p);
+			FreeStudyBSONOid (arena_p, plot_p -> pl_id_p);
 		}
 
 
 	if (plot_p -> pl_comment_s)
 		{
-			FreeCopiedString (plot_p -> pl_comment_s);
+			FreeStudyString (arena_p, plot_p -> pl_comment_s);
 		}
 
 	if (plot_p -> pl_treatments_s)
 		{
-			FreeCopiedString (plot_p -> pl_treatments_s);
+			FreeStudyString (arena_p, plot_p -> pl_treatments_s);
 		}
 
 	if (plot_p -> pl_image_url_s)
 		{
-			FreeCopiedString (plot_p -> pl_image_url_s);
+			FreeStudyString (arena_p, plot_p -> pl_image_url_s);
 		}
 
 	if (plot_p -> pl_thumbnail_url_s)
 		{
-			FreeCopiedString (plot_p -> pl_thumbnail_url_s);
+			FreeStudyString (arena_p, plot_p -> pl_thumbnail_url_s);
 		}
 
 	FreeLinkedList (plot_p -> pl_rows_p);
@@ -256,32 +264,32 @@ void FreePlot (Plot *plot_p)
 
 	if (plot_p -> pl_width_p)
 		{
-			FreeMemory (plot_p -> pl_width_p);
+			FreeStudyMemory (arena_p, plot_p -> pl_width_p);
 		}
 
 	if (plot_p -> pl_length_p)
 		{
-			FreeMemory (plot_p -> pl_length_p);
+			FreeStudyMemory (arena_p, plot_p -> pl_length_p);
 		}
 
 
 	if (plot_p -> pl_sowing_order_index_p)
 		{
-			FreeMemory (plot_p -> pl_sowing_order_index_p);
+			FreeStudyMemory (arena_p, plot_p -> pl_sowing_order_index_p);
 		}
 
 	if (plot_p -> pl_walking_order_index_p)
 		{
-			FreeMemory (plot_p -> pl_walking_order_index_p);
+			FreeStudyMemory (arena_p, plot_p -> pl_walking_order_index_p);
 		}
 
-	FreeMemory (plot_p);
+	FreeStudyMemory (arena_p, plot_p);
 }
 
 
 PlotNode *AllocatePlotNode (Plot *plot_p)
 {
-	PlotNode *pl_node_p = (PlotNode *) AllocMemory (sizeof (PlotNode));
+	PlotNode *pl_node_p = (PlotNode *) AllocStudyMemory (plot_p -> pl_arena_p, sizeof (PlotNode));
 
 	if (pl_node_p)
 		{
@@ -298,20 +306,31 @@ PlotNode *AllocatePlotNode (Plot *plot_p)
 void FreePlotNode (ListItem *node_p)
 {
 	PlotNode *pl_node_p = (PlotNode *) node_p;
+	StudyArena *arena_p = NULL;
 
 	if (pl_node_p -> pn_plot_p)
 		{
+			arena_p = pl_node_p -> pn_plot_p -> pl_arena_p;
 			FreePlot (pl_node_p -> pn_plot_p);
 		}
 
-	FreeMemory (pl_node_p);
+	FreeStudyMemory (arena_p, pl_node_p);
 }
 
 
 bool SavePlot (Plot *plot_p, const FieldTrialServiceData *data_p)
 {
 	bson_t *selector_p = NULL;
-	bool success_flag = PrepareSaveData (& (plot_p -> pl_id_p), &selector_p);
+	bool success_flag = false;
+
+	/* Saving the Plot would remove the Rows that weren't loaded */
+	if (plot_p -> pl_partial_rows_flag)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Cannot save plot at row " UINT32_FMT ", column " UINT32_FMT " as not all of its rows are loaded", plot_p -> pl_row_index, plot_p -> pl_column_index);
+			return false;
+		}
+
+	success_flag = PrepareSaveData (& (plot_p -> pl_id_p), &selector_p);
 
 	if (success_flag)
 		{
@@ -319,8 +338,15 @@ bool SavePlot (Plot *plot_p, const FieldTrialServiceData *data_p)
 
 			if (plot_json_p)
 				{
-					success_flag = SaveAndBackupMongoDataWithTimestamp (data_p -> dftsd_mongo_p, plot_json_p, data_p -> dftsd_collection_ss [DFTD_PLOT], 
-					data_p -> dftsd_backup_collection_ss [DFTD_PLOT], DFT_BACKUPS_ID_KEY_S, selector_p, MONGO_TIMESTAMP_S);
+					success_flag = SaveAndBackupMongoDataWithRevisions (plot_json_p, DFTD_PLOT, selector_p, data_p);
+
+					if (success_flag)
+						{
+							if (!UpdateMaterialUsageForPlot (plot_json_p, data_p))
+								{
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to update material usage for plot at row " UINT32_FMT ", column " UINT32_FMT " in study \"%s\"", plot_p -> pl_row_index, plot_p -> pl_column_index, plot_p -> pl_parent_p -> st_name_s);
+								}
+						}
 
 					json_decref (plot_json_p);
 				}		/* if (plot_json_p) */
@@ -604,7 +630,7 @@ Plot *GetPlotFromJSON (const json_t *plot_json_p, Study *parent_study_p, const V
 
 							if (CreateValidDateFromJSON (plot_json_p, PL_HARVEST_DATE_S, &harvest_date_p))
 								{
-									bson_oid_t *id_p = GetNewUnitialisedBSONOid ();
+									bson_oid_t *id_p = AllocStudyBSONOid (parent_study_p ? parent_study_p -> st_arena_p : NULL);
 
 									if (id_p)
 										{
@@ -52,6 +52,12 @@
 #include "treatment_factor.h"
 
 #include "plots_cache.h"
+#include "plots_table_schema.h"
+#include "material_usage.h"
+#include "filesystem_utils.h"
+
+#include <stdio.h>
+#include <string.h>
 
 
 typedef enum
@@ -143,13 +149,29 @@ static const bool S_DEFAULT_CONTROL_REP_FLAG = false;
 
 static const char * const S_DEFAULT_VARIETY_S = "variety";
 
+
+/*
+ * The Frictionless Data keys and csv settings for the plots file
+ * written alongside a Study's data package.
+ */
+static const char * const S_PLOTS_CSV_SUFFIX_S = "_plots.csv";
+
+static const char * const S_FD_PATH_S = "path";
+
+static const char * const S_FD_FORMAT_S = "format";
+
+static const char * const S_FD_MEDIA_TYPE_S = "mediatype";
+
+static const char S_CSV_DELIMITER_C = ',';
+
+static const char * const S_CSV_LINE_TERMINATOR_S = "\r\n";
+
 /*
  * static declarations
  */
 
 
 
-static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *study_p,  FieldTrialServiceData *data_p);
 
 static Parameter *GetTableParameter (ParameterSet *param_set_p, ParameterGroup *group_p, Study *active_study_p, FieldTrialServiceData *data_p);
 
@@ -175,8 +197,20 @@ static bool RemoveExistingPlotsForStudy (Study *study_p, const FieldTrialService
 
 static json_t *GetPlotsAsFrictionlessData (const Study *study_p, const FieldTrialServiceData *service_data_p, const char * const null_sequence_s);
 
+static json_t *GetPlotRowAsFrictionlessData (const Plot *plot_p, const Row *row_p, const FieldTrialServiceData *service_data_p, const char * const null_sequence_s);
+
+static bool WritePlotsAsCSV (const Study *study_p, const json_t *fields_p, const char * const filename_s, const FieldTrialServiceData *service_data_p, const char * const null_sequence_s);
+
+static bool WritePlotsCSVHeader (FILE *out_f, const json_t *fields_p);
 
-static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, GeneBank *gru_gene_bank_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, PlotsCache *plots_cache_p, FieldTrialServiceData *data_p);
+static bool WritePlotsCSVRow (FILE *out_f, const json_t *fields_p, const json_t *row_fd_p, const char * const null_sequence_s);
+
+static void WriteCSVString (FILE *out_f, const char *value_s);
+
+static json_t *GetPlotsAsFDTabularFileResource (const char * const path_s, json_t *schema_p, const char * const null_sequence_s);
+
+
+static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, GeneBank *gru_gene_bank_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, PlotsCache *plots_cache_p, MaterialsMap *materials_p, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p);
 
 
 static void RemoveUnneededColumns (json_t *table_row_json_p, const json_t *unknown_cols_p);
@@ -185,10 +219,10 @@ static void RemoveUnneededColumns (json_t *table_row_json_p, const json_t *unkno
 static Plot *GetPlotForUpdating (ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, const uint32 row_index, bool *new_plot_flag_p, PlotsCache *plots_cache_p, FieldTrialServiceData *data_p);
 
 
-static OperationStatus ProcessStandardRow (StandardRow *row_p, ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, FieldTrialServiceData *data_p);
+static OperationStatus ProcessStandardRow (StandardRow *row_p, ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p);
 
 
-static OperationStatus CreateOrUpdateStandardRowFromJSON (StandardRow **row_pp, ServiceJob *job_p, json_t *table_row_json_p, StandardRow *existing_row_p, Study *study_p, GeneBank *gru_gene_bank_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, int32 rack_studywise_index, Plot *plot_p, FieldTrialServiceData *data_p);
+static OperationStatus CreateOrUpdateStandardRowFromJSON (StandardRow **row_pp, ServiceJob *job_p, json_t *table_row_json_p, StandardRow *existing_row_p, Study *study_p, GeneBank *gru_gene_bank_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, int32 rack_studywise_index, Plot *plot_p, MaterialsMap *materials_p, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p);
 
 
 static bool AddStudyDetailsToJSON (json_t *result_json_p, const Study * const study_p, const ViewFormat format, FieldTrialServiceData *data_p);
@@ -196,8 +230,7 @@ static bool AddStudyDetailsToJSON (json_t *result_json_p, const Study * const st
 
 static OperationStatus GenerateSkeletonPlots (Study *study_p, ParameterSet *param_set_p, ServiceJob *job_p, FieldTrialServiceData *data_p);
 
-
-static Plot *GetPlotByRowColumn (const uint32 row, const uint32 column, Study *study_p, const ViewFormat format, FieldTrialServiceData *data_p);
+static bool AddUploadedMaterialsToMaterialsMap (MaterialsMap *materials_p, const json_t *plots_json_p, const size_t num_rows, const FieldTrialServiceData *data_p);
 
 
 /*
@@ -331,6 +364,8 @@ bool RunForSubmissionPlotParams (FieldTrialServiceData *data_p, ParameterSet *pa
 
 					if (study_p)
 						{
+							PlotsTableSchema *schema_p = NULL;
+
 							if (param_set_p -> ps_current_level == PL_WIZARD)
 								{
 									/*
@@ -405,9 +440,18 @@ bool RunForSubmissionPlotParams (FieldTrialServiceData *data_p, ParameterSet *pa
 
 															if (success_flag)
 																{
-																	if (!AddPlotsFromJSON (job_p, plots_table_p, study_p, data_p))
+																	schema_p = AllocatePlotsTableSchema ();
+
+																	if (schema_p)
+																		{
+																			if (!AddPlotsFromJSON (job_p, plots_table_p, study_p, schema_p, data_p))
+																				{
+																					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plots_table_p, "AddPlotsFromJSON failed for study \"%s\"", study_p -> st_name_s);
+																				}
+																		}
+																	else
 																		{
-																			PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plots_table_p, "AddPlotsFromJSON failed for study \"%s\"", study_p -> st_name_s);
+																			AddGeneralErrorMessageToServiceJob (job_p, "Failed to process the plots table");
 																		}
 																}
 
@@ -445,6 +489,15 @@ bool RunForSubmissionPlotParams (FieldTrialServiceData *data_p, ParameterSet *pa
 
 
 							FreeStudy (study_p);
+
+							/*
+							 * The Observations added from the uploaded table borrow
+							 * the schema's Measured Variables so it must outlive the Study
+							 */
+							if (schema_p)
+								{
+									FreePlotsTableSchema (schema_p);
+								}
 						}		/* if (study_p) */
 					else
 						{
@@ -720,51 +773,25 @@ bool AddPlotAsFrictionlessData (const Plot *plot_p, json_t *plots_array_p, const
 
 			while (row_node_p && success_flag)
 				{
-					json_t *row_fd_p = json_object ();
+					json_t *row_fd_p = GetPlotRowAsFrictionlessData (plot_p, row_node_p -> rn_row_p, service_data_p, null_sequence_s);
+
+					success_flag = false;
 
 					if (row_fd_p)
 						{
-							success_flag = false;
-
-							if (SetJSONInteger (row_fd_p, PL_ROW_TITLE_S, plot_p -> pl_row_index))
+							if (json_array_append_new (plots_array_p, row_fd_p) == 0)
 								{
-									if (SetJSONInteger (row_fd_p, PL_COLUMN_TITLE_S, plot_p -> pl_column_index))
-										{
-											if (SetFDTableReal (row_fd_p, S_LENGTH_TITLE_S, plot_p -> pl_length_p, null_sequence_s))
-												{
-													if (SetFDTableReal (row_fd_p, S_WIDTH_TITLE_S, plot_p -> pl_width_p, null_sequence_s))
-														{
-															if (AddValidDateToJSON (plot_p -> pl_sowing_date_p, row_fd_p, S_SOWING_TITLE_S, false))
-																{
-																	if (AddValidDateToJSON (plot_p -> pl_harvest_date_p, row_fd_p, S_HARVEST_TITLE_S, false))
-																		{
-																			if (AddRowFrictionlessDataDetails (row_node_p -> rn_row_p, row_fd_p, service_data_p, null_sequence_s))
-																				{
-																					if (json_array_append_new (plots_array_p, row_fd_p) == 0)
-																						{
-																							++ num_added;
-
-																							row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
-																							success_flag = true;
-																						}
-
-																				}
-
-																		}
+									++ num_added;
 
-																}
-														}
-												}
-										}
+									row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
+									success_flag = true;
 								}
-
-							if (!success_flag)
+							else
 								{
 									json_decref (row_fd_p);
 								}
 						}
 
-
 				}		/* while (row_node_p) */
 
 
@@ -775,6 +802,60 @@ bool AddPlotAsFrictionlessData (const Plot *plot_p, json_t *plots_array_p, const
 }
 
 
+json_t *SavePlotsAsFDTabularFile (const Study *study_p, const FieldTrialServiceData *service_data_p)
+{
+	json_t *plots_p = NULL;
+
+	if (service_data_p -> dftsd_assets_path_s)
+		{
+			/*
+			 * The path in the resource is relative to the data package
+			 * so the csv file goes in the same directory
+			 */
+			char *local_filename_s = ConcatenateStrings (study_p -> st_name_s, S_PLOTS_CSV_SUFFIX_S);
+
+			if (local_filename_s)
+				{
+					char *full_filename_s = MakeFilename (service_data_p -> dftsd_assets_path_s, local_filename_s);
+
+					if (full_filename_s)
+						{
+							json_t *schema_p = GetPlotsFrictionlessDataTableSchema (study_p, service_data_p);
+
+							if (schema_p)
+								{
+									const char *null_sequence_s = "-";
+
+									if (WritePlotsAsCSV (study_p, json_object_get (schema_p, FD_TABLE_FIELDS_S), full_filename_s, service_data_p, null_sequence_s))
+										{
+											plots_p = GetPlotsAsFDTabularFileResource (local_filename_s, schema_p, null_sequence_s);
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to write plots for \"%s\" to \"%s\"", study_p -> st_name_s, full_filename_s);
+											json_decref (schema_p);
+										}
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GetPlotsFrictionlessDataTableSchema () failed for \"%s\"", study_p -> st_name_s);
+								}
+
+							FreeCopiedString (full_filename_s);
+						}		/* if (full_filename_s) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "MakeFilename () failed for \"%s\" and \"%s\"", service_data_p -> dftsd_assets_path_s, local_filename_s);
+						}
+
+					FreeCopiedString (local_filename_s);
+				}		/* if (local_filename_s) */
+
+		}		/* if (service_data_p -> dftsd_assets_path_s) */
+
+	return plots_p;
+}
+
 
 json_t *GetStudyPlotHeaderAsFrictionlessData (const Study *study_p, const FieldTrialServiceData *service_data_p)
 {
@@ -1049,6 +1130,262 @@ json_t *GetPlotsFrictionlessDataTableSchema (const Study *study_p, const FieldTr
  */
 
 
+static json_t *GetPlotRowAsFrictionlessData (const Plot *plot_p, const Row *row_p, const FieldTrialServiceData *service_data_p, const char * const null_sequence_s)
+{
+	json_t *row_fd_p = json_object ();
+
+	if (row_fd_p)
+		{
+			if (SetJSONInteger (row_fd_p, PL_ROW_TITLE_S, plot_p -> pl_row_index))
+				{
+					if (SetJSONInteger (row_fd_p, PL_COLUMN_TITLE_S, plot_p -> pl_column_index))
+						{
+							if (SetFDTableReal (row_fd_p, S_LENGTH_TITLE_S, plot_p -> pl_length_p, null_sequence_s))
+								{
+									if (SetFDTableReal (row_fd_p, S_WIDTH_TITLE_S, plot_p -> pl_width_p, null_sequence_s))
+										{
+											if (AddValidDateToJSON (plot_p -> pl_sowing_date_p, row_fd_p, S_SOWING_TITLE_S, false))
+												{
+													if (AddValidDateToJSON (plot_p -> pl_harvest_date_p, row_fd_p, S_HARVEST_TITLE_S, false))
+														{
+															if (AddRowFrictionlessDataDetails (row_p, row_fd_p, service_data_p, null_sequence_s))
+																{
+																	return row_fd_p;
+																}
+														}
+												}
+										}
+								}
+						}
+				}
+
+			json_decref (row_fd_p);
+		}
+
+	return NULL;
+}
+
+
+/*
+ * Write the rows one at a time so that we never have more
+ * than a single row's JSON in memory.
+ */
+static bool WritePlotsAsCSV (const Study *study_p, const json_t *fields_p, const char * const filename_s, const FieldTrialServiceData *service_data_p, const char * const null_sequence_s)
+{
+	bool success_flag = false;
+	FILE *out_f = fopen (filename_s, "w");
+
+	if (out_f)
+		{
+			success_flag = WritePlotsCSVHeader (out_f, fields_p);
+
+			if (success_flag && (study_p -> st_plots_p))
+				{
+					PlotNode *plot_node_p = (PlotNode *) (study_p -> st_plots_p -> ll_head_p);
+
+					while (plot_node_p && success_flag)
+						{
+							const Plot *plot_p = plot_node_p -> pn_plot_p;
+
+							if (plot_p -> pl_rows_p)
+								{
+									RowNode *row_node_p = (RowNode *) (plot_p -> pl_rows_p -> ll_head_p);
+
+									while (row_node_p && success_flag)
+										{
+											json_t *row_fd_p = GetPlotRowAsFrictionlessData (plot_p, row_node_p -> rn_row_p, service_data_p, null_sequence_s);
+
+											if (row_fd_p)
+												{
+													success_flag = WritePlotsCSVRow (out_f, fields_p, row_fd_p, null_sequence_s);
+													json_decref (row_fd_p);
+												}
+											else
+												{
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get row " UINT32_FMT " of plot [" UINT32_FMT ", " UINT32_FMT "] as frictionless data for \"%s\"",
+																			 row_node_p -> rn_row_p -> ro_by_study_index, plot_p -> pl_row_index, plot_p -> pl_column_index, study_p -> st_name_s);
+													success_flag = false;
+												}
+
+											row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
+										}
+								}
+
+							plot_node_p = (PlotNode *) (plot_node_p -> pn_node.ln_next_p);
+						}
+				}
+
+			if (ferror (out_f))
+				{
+					success_flag = false;
+				}
+
+			if (fclose (out_f) != 0)
+				{
+					success_flag = false;
+				}
+		}		/* if (out_f) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to open \"%s\" for writing", filename_s);
+		}
+
+	return success_flag;
+}
+
+
+static bool WritePlotsCSVHeader (FILE *out_f, const json_t *fields_p)
+{
+	bool success_flag = true;
+	const size_t num_fields = json_array_size (fields_p);
+	size_t i;
+
+	for (i = 0; i < num_fields; ++ i)
+		{
+			const char *name_s = GetJSONString (json_array_get (fields_p, i), FD_TABLE_FIELD_NAME);
+
+			if (i > 0)
+				{
+					fputc (S_CSV_DELIMITER_C, out_f);
+				}
+
+			if (name_s)
+				{
+					WriteCSVString (out_f, name_s);
+				}
+			else
+				{
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, json_array_get (fields_p, i), "Plots table field " SIZET_FMT " has no name", i);
+					success_flag = false;
+				}
+		}
+
+	fputs (S_CSV_LINE_TERMINATOR_S, out_f);
+
+	return success_flag;
+}
+
+
+/*
+ * The values are written in the order of the schema's fields so
+ * every row has the same columns, with any missing values written
+ * as the null sequence.
+ */
+static bool WritePlotsCSVRow (FILE *out_f, const json_t *fields_p, const json_t *row_fd_p, const char * const null_sequence_s)
+{
+	const size_t num_fields = json_array_size (fields_p);
+	size_t i;
+
+	for (i = 0; i < num_fields; ++ i)
+		{
+			const char *name_s = GetJSONString (json_array_get (fields_p, i), FD_TABLE_FIELD_NAME);
+			const json_t *value_p = name_s ? json_object_get (row_fd_p, name_s) : NULL;
+
+			if (i > 0)
+				{
+					fputc (S_CSV_DELIMITER_C, out_f);
+				}
+
+			if ((!value_p) || (json_is_null (value_p)))
+				{
+					fputs (null_sequence_s, out_f);
+				}
+			else if (json_is_string (value_p))
+				{
+					WriteCSVString (out_f, json_string_value (value_p));
+				}
+			else
+				{
+					/* numbers and booleans */
+					json_dumpf (value_p, out_f, JSON_ENCODE_ANY);
+				}
+		}
+
+	fputs (S_CSV_LINE_TERMINATOR_S, out_f);
+
+	return (ferror (out_f) == 0);
+}
+
+
+static void WriteCSVString (FILE *out_f, const char *value_s)
+{
+	if (strpbrk (value_s, ",\"\r\n"))
+		{
+			const char *c_p = value_s;
+
+			fputc ('"', out_f);
+
+			while (*c_p)
+				{
+					if (*c_p == '"')
+						{
+							fputc ('"', out_f);
+						}
+
+					fputc (*c_p, out_f);
+					++ c_p;
+				}
+
+			fputc ('"', out_f);
+		}
+	else
+		{
+			fputs (value_s, out_f);
+		}
+}
+
+
+static json_t *GetPlotsAsFDTabularFileResource (const char * const path_s, json_t *schema_p, const char * const null_sequence_s)
+{
+	json_t *plots_p = json_object ();
+
+	if (plots_p)
+		{
+			if (json_object_set_new (plots_p, FD_SCHEMA_S, schema_p) == 0)
+				{
+					if (SetJSONString (plots_p, FD_PROFILE_S, FD_PROFILE_TABULAR_RESOURCE_S))
+						{
+							if (SetJSONString (plots_p, S_FD_PATH_S, path_s))
+								{
+									if (SetJSONString (plots_p, S_FD_FORMAT_S, "csv"))
+										{
+											if (SetJSONString (plots_p, S_FD_MEDIA_TYPE_S, "text/csv"))
+												{
+													json_t *dialect_p = GetPlotsCSVDialect (null_sequence_s);
+
+													if (dialect_p)
+														{
+															if (json_object_set_new (plots_p, FD_CSV_DIALECT, dialect_p) == 0)
+																{
+																	return plots_p;
+																}
+															else
+																{
+																	json_decref (dialect_p);
+																}
+														}
+												}
+										}
+								}
+						}
+				}
+			else
+				{
+					json_decref (schema_p);
+				}
+
+			json_decref (plots_p);
+		}
+	else
+		{
+			json_decref (schema_p);
+		}
+
+	return NULL;
+}
+
+
+
 static json_t *GetTableParameterHints (void)
 {
 	/*
@@ -1191,7 +1528,7 @@ static Parameter *GetTableParameter (ParameterSet *param_set_p, ParameterGroup *
 static OperationStatus CreateOrUpdateStandardRowFromJSON (StandardRow **row_pp, ServiceJob *job_p, json_t *table_row_json_p,
 																													StandardRow *existing_row_p, Study *study_p, GeneBank *gru_gene_bank_p,
 																													json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index,
-																													int32 rack_studywise_index, Plot *plot_p, FieldTrialServiceData *data_p)
+																													int32 rack_studywise_index, Plot *plot_p, MaterialsMap *materials_p, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p)
 {
 	OperationStatus status = OS_FAILED;
 	StandardRow *sr_p = NULL;
@@ -1220,7 +1557,22 @@ static OperationStatus CreateOrUpdateStandardRowFromJSON (StandardRow **row_pp,
 
 			if (!IsStringEmpty (accession_s))
 				{
-					Material *material_p = GetOrCreateMaterialByAccession (accession_s, gene_bank_p, data_p);
+					Material *material_p = NULL;
+
+					if (materials_p)
+						{
+							/* Each row owns its Material so take a copy of the shared one */
+							const Material *shared_material_p = GetOrCreateMaterialByAccessionFromMaterialsMap (materials_p, accession_s, gene_bank_p, data_p);
+
+							if (shared_material_p)
+								{
+									material_p = CopyMaterial (shared_material_p);
+								}
+						}
+					else
+						{
+							material_p = GetOrCreateMaterialByAccession (accession_s, gene_bank_p, data_p);
+						}
 
 					if (material_p)
 						{
@@ -1271,7 +1623,7 @@ static OperationStatus CreateOrUpdateStandardRowFromJSON (StandardRow **row_pp,
 
 									if (sr_p)
 										{
-											status = ProcessStandardRow (sr_p, job_p, table_row_json_p, study_p, unknown_cols_p, notes_cols_p, row_index, data_p);
+											status = ProcessStandardRow (sr_p, job_p, table_row_json_p, study_p, unknown_cols_p, notes_cols_p, row_index, schema_p, data_p);
 
 
 											if ((status == OS_SUCCEEDED) || (status == OS_PARTIALLY_SUCCEEDED))
@@ -1325,7 +1677,7 @@ static OperationStatus CreateOrUpdateStandardRowFromJSON (StandardRow **row_pp,
 }
 
 
-static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, GeneBank *gru_gene_bank_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, PlotsCache *plots_cache_p, FieldTrialServiceData *data_p)
+static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, GeneBank *gru_gene_bank_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, PlotsCache *plots_cache_p, MaterialsMap *materials_p, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p)
 {
 	OperationStatus add_status = OS_FAILED;
 	int32 rack_studywise_index = -1;
@@ -1358,7 +1710,7 @@ static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_jso
 									/* Assume a Standard Row */
 									StandardRow *sr_p = NULL;
 
-									add_status = CreateOrUpdateStandardRowFromJSON (&sr_p, job_p, table_row_json_p, (StandardRow *) row_p, study_p, gru_gene_bank_p, unknown_cols_p, notes_cols_p, row_index, rack_studywise_index, plot_p, data_p);
+									add_status = CreateOrUpdateStandardRowFromJSON (&sr_p, job_p, table_row_json_p, (StandardRow *) row_p, study_p, gru_gene_bank_p, unknown_cols_p, notes_cols_p, row_index, rack_studywise_index, plot_p, materials_p, schema_p, data_p);
 
 									if (sr_p)
 										{
@@ -1408,7 +1760,7 @@ static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_jso
 									/* Assume a Standard Row */
 									StandardRow *sr_p = NULL;
 
-									add_status = CreateOrUpdateStandardRowFromJSON (&sr_p, job_p, table_row_json_p, NULL, study_p, gru_gene_bank_p, unknown_cols_p, notes_cols_p, row_index, rack_studywise_index, plot_p, data_p);
+									add_status = CreateOrUpdateStandardRowFromJSON (&sr_p, job_p, table_row_json_p, NULL, study_p, gru_gene_bank_p, unknown_cols_p, notes_cols_p, row_index, rack_studywise_index, plot_p, materials_p, schema_p, data_p);
 
 									if (sr_p)
 										{
@@ -1430,7 +1782,15 @@ static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_jso
 												{
 													if (AddPlotToStudy (study_p, plot_p))
 														{
-															success_flag = true;
+															if (AddPlotToPlotsCache (plots_cache_p, plot_p))
+																{
+																	success_flag = true;
+																}
+															else
+																{
+																	AddTabularParameterErrorMessageToServiceJob (job_p, PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, "Failed to add the plot to the study", row_index, NULL);
+																	PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, table_row_json_p, "AddPlotToPlotsCache () failed");
+																}
 														}
 													else
 														{
@@ -1462,11 +1822,12 @@ static OperationStatus AddPlotFromJSON (ServiceJob *job_p, json_t *table_row_jso
 
 
 					/*
-					 * Save the row
+					 * Mark the plot for saving. All of the modified plots are
+					 * written together once the whole spreadsheet has been processed.
 					 */
 					if (success_flag)
 						{
-							if (SavePlot (plot_p, data_p))
+							if (SetPlotsCacheEntryModified (plots_cache_p, plot_p, row_index))
 								{
 									add_status = OS_SUCCEEDED;
 								}
@@ -1563,7 +1924,7 @@ static OperationStatus GetAllNotesColumns (const json_t *table_row_json_p, json_
 }
 
 
-static OperationStatus ProcessStandardRow (StandardRow *row_p, ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, FieldTrialServiceData *data_p)
+static OperationStatus ProcessStandardRow (StandardRow *row_p, ServiceJob *job_p, json_t *table_row_json_p, Study *study_p, json_t *unknown_cols_p, json_t *notes_cols_p, const uint32 row_index, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p)
 {
 	OperationStatus status = OS_SUCCEEDED;
 	size_t num_columns;
@@ -1596,17 +1957,12 @@ static OperationStatus ProcessStandardRow (StandardRow *row_p, ServiceJob *job_p
 					 */
 					if ((strcmp (key_s, SR_IMPORT_RACK_S) != 0) && (strcmp (key_s, SR_PLOT_INDEX_S) != 0))
 						{
-							const char *value_s = NULL;
-
 							value_p = json_object_iter_value (iterator_p);
 
-
 							/*
-							 * Is it an observation?
+							 * Is it an observation or a treatment?
 							 */
-
-
-							add_status = AddObservationValueToStandardRow (row_p, row_index, key_s, value_p, job_p, data_p);
+							add_status = AddPlotsTableValueToStandardRow (row_p, row_index, key_s, value_p, schema_p, study_p, job_p, data_p);
 
 							if (add_status == OS_SUCCEEDED)
 								{
@@ -1614,40 +1970,24 @@ static OperationStatus ProcessStandardRow (StandardRow *row_p, ServiceJob *job_p
 								}
 							else if (add_status == OS_IDLE)
 								{
-									value_s = json_string_value (value_p);
+									char *error_s = ConcatenateVarargsStrings ("Unknown column name \"", key_s, "\"", NULL);
 
-									if (!IsStringEmpty (value_s))
+									/*
+									 * unknown column
+									 */
+									if (!SetJSONNull (unknown_cols_p, key_s))
 										{
-											add_status = AddSingleTreatmentFactorValueToStandardRow (row_p, key_s, value_s, study_p, job_p, row_index, data_p);
+											PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, unknown_cols_p, "Failed to add unknown column \"%s\"", key_s);
 										}
 
-
-									if (add_status == OS_SUCCEEDED)
+									if (error_s)
 										{
-											++ imported_columns;
+											AddParameterErrorMessageToServiceJob (job_p,PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, error_s);
+											FreeCopiedString (error_s);
 										}
-									else if (add_status == OS_IDLE)
+									else
 										{
-											char *error_s = ConcatenateVarargsStrings ("Unknown column name \"", key_s, "\"", NULL);
-
-											/*
-											 * unknown column
-											 */
-											if (!SetJSONNull (unknown_cols_p, key_s))
-												{
-													PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, unknown_cols_p, "Failed to add unknown column \"%s\"", key_s);
-												}
-
-											if (error_s)
-												{
-													AddParameterErrorMessageToServiceJob (job_p,PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, error_s);
-													FreeCopiedString (error_s);
-												}
-											else
-												{
-													AddParameterErrorMessageToServiceJob (job_p,PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, "Unknown column name");
-												}
-
+											AddParameterErrorMessageToServiceJob (job_p,PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, "Unknown column name");
 										}
 
 								}		/* if (add_status == OS_IDLE) */
@@ -1698,14 +2038,30 @@ static Plot *GetPlotForUpdating (ServiceJob *job_p, json_t *table_row_json_p, St
 	if (CheckPlotRequirements (plots_cache_p, table_row_json_p, row_index, job_p, &row, &column, &study_index, &rack))
 		{
 			/*
-			 * does the plot already exist?
+			 * does the plot already exist? All of the study's plots
+			 * have already been loaded into the cache so we don't
+			 * need to query the database.
 			 */
-			//plot_p = GetPlotByRowColumnRack (row, column, rack, study_p, VF_STORAGE, data_p);
-			plot_p = GetPlotByRowColumn (row, column, study_p, VF_STORAGE, data_p);
+			plot_p = GetPlotFromPlotsCache (plots_cache_p, row, column);
 
 			if (plot_p)
 				{
-					*new_plot_flag_p = false;
+					/*
+					 * Make sure that the rack isn't already used by a different
+					 * row in the existing plot.
+					 */
+					Row *existing_row_p = (rack > 0) ? GetRowFromPlotsCache (plots_cache_p, row, column, rack) : NULL;
+
+					if ((existing_row_p) && (existing_row_p -> ro_by_study_index != (uint32) study_index))
+						{
+							AddTabularParameterErrorMessageToServiceJob (job_p, PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, "Rack is already used by another row in this plot", row_index, PL_RACK_TITLE_S);
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, table_row_json_p, "Rack " INT32_FMT " at row " INT32_FMT ", column " INT32_FMT " is already used by study index " UINT32_FMT, rack, row, column, existing_row_p -> ro_by_study_index);
+							plot_p = NULL;
+						}
+					else
+						{
+							*new_plot_flag_p = false;
+						}
 				}
 			else
 				{
@@ -1733,7 +2089,7 @@ static Plot *GetPlotForUpdating (ServiceJob *job_p, json_t *table_row_json_p, St
 }
 
 
-static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *study_p, FieldTrialServiceData *data_p)
+bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *study_p, PlotsTableSchema *schema_p, FieldTrialServiceData *data_p)
 {
 	OperationStatus status = OS_FAILED;
 	bool success_flag	= true;
@@ -1741,11 +2097,13 @@ static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *st
 	if (json_is_array (plots_json_p))
 		{
 			const size_t num_rows = json_array_size (plots_json_p);
+			size_t num_rows_to_process = num_rows;
 			size_t i;
 			size_t num_empty_rows = 0;
 			size_t num_fully_imported = 0;
 			size_t num_partially_imported = 0;
 			char *study_id_s = NULL;
+			OperationStatus save_status = OS_SUCCEEDED;
 			GeneBank *gru_gene_bank_p = GetGeneBankByName (GENE_BANK_GRU_S, data_p);
 
 			if (gru_gene_bank_p)
@@ -1759,10 +2117,49 @@ static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *st
 							if (notes_cols_p)
 								{
 									PlotsCache *plots_cache_p = AllocatePlotsCache ();
+									MaterialsMap *materials_p = NULL;
 
 									if (plots_cache_p)
 										{
-											for (i = 0; i < num_rows; ++ i)
+											/*
+											 * Load all of the existing plots for the study
+											 * once rather than querying for each row
+											 */
+											if (GetStudyPlots (study_p, VF_STORAGE, data_p))
+												{
+													if (!AddStudyPlotsToPlotsCache (plots_cache_p, study_p))
+														{
+															num_rows_to_process = 0;
+														}
+												}
+											else
+												{
+													num_rows_to_process = 0;
+												}
+
+											if (num_rows_to_process == 0)
+												{
+													AddGeneralErrorMessageToServiceJob (job_p, "Failed to load the existing plots for the study");
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to load the existing plots for study \"%s\"", study_p -> st_name_s);
+												}
+											else
+												{
+													/*
+													 * Likewise get the Materials for all of the accessions
+													 * at once. If this fails, each row looks up its own.
+													 */
+													materials_p = AllocateMaterialsMap ();
+
+													if (materials_p)
+														{
+															if (!AddUploadedMaterialsToMaterialsMap (materials_p, plots_json_p, num_rows_to_process, data_p))
+																{
+																	PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get all of the materials for study \"%s\"", study_p -> st_name_s);
+																}
+														}
+												}
+
+											for (i = 0; i < num_rows_to_process; ++ i)
 												{
 													json_t *table_row_json_p = json_array_get (plots_json_p, i);
 
@@ -1771,7 +2168,7 @@ static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *st
 													 */
 													if (json_object_size (table_row_json_p) > 0)
 														{
-															OperationStatus add_status = AddPlotFromJSON (job_p, table_row_json_p, study_p, gru_gene_bank_p, unknown_cols_p, notes_cols_p, i + 1, plots_cache_p, data_p);
+															OperationStatus add_status = AddPlotFromJSON (job_p, table_row_json_p, study_p, gru_gene_bank_p, unknown_cols_p, notes_cols_p, i + 1, plots_cache_p, materials_p, schema_p, data_p);
 
 															switch (add_status)
 																{
@@ -1794,6 +2191,16 @@ static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *st
 														}
 												}
 
+											if (num_fully_imported + num_partially_imported > 0)
+												{
+													save_status = SaveModifiedPlotsFromPlotsCache (plots_cache_p, job_p, data_p);
+												}
+
+											if (materials_p)
+												{
+													FreeMaterialsMap (materials_p);
+												}
+
 											FreePlotsCache (plots_cache_p);
 										}
 
@@ -1818,6 +2225,15 @@ static bool AddPlotsFromJSON (ServiceJob *job_p, json_t *plots_json_p, Study *st
 					status = OS_PARTIALLY_SUCCEEDED;
 				}
 
+			if (save_status == OS_FAILED)
+				{
+					status = OS_FAILED;
+				}
+			else if ((save_status == OS_PARTIALLY_SUCCEEDED) && (status == OS_SUCCEEDED))
+				{
+					status = OS_PARTIALLY_SUCCEEDED;
+				}
+
 			/*
 			 * As the plots have been updated, clear any cached study
 			 */
@@ -1958,21 +2374,6 @@ Plot *GetPlotByRowColumnRack (const uint32 row, const uint32 column, const uint3
 }
 
 
-static Plot *GetPlotByRowColumn (const uint32 row, const uint32 column, Study *study_p, const ViewFormat format, FieldTrialServiceData *data_p)
-{
-	Plot *plot_p = NULL;
-	bson_t *query_p = BCON_NEW (PL_ROW_INDEX_S, BCON_INT32 (row), PL_COLUMN_INDEX_S, BCON_INT32 (column), PL_PARENT_STUDY_S, BCON_OID (study_p -> st_id_p));
-
-	if (query_p)
-		{
-			plot_p = GetUniquePlot (query_p, study_p, format, data_p, false);
-
-			bson_destroy (query_p);
-		}		/* if (query_p) */
-
-	return plot_p;
-}
-
 /*
  * https://frictionlessdata.io/data-package/#the-data-package-suite-of-specifications
  * https://specs.frictionlessdata.io/table-schema/
@@ -1999,6 +2400,50 @@ bool AddPlotsTableSchema (json_t *table_p)
  * STATIC DEFINITIONS
  */
 
+/*
+ * Get the Materials for all of the accessions in an upload with a single query.
+ */
+static bool AddUploadedMaterialsToMaterialsMap (MaterialsMap *materials_p, const json_t *plots_json_p, const size_t num_rows, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = true;
+
+	if (num_rows > 0)
+		{
+			const char **accessions_ss = (const char **) AllocMemoryArray (num_rows, sizeof (const char *));
+
+			if (accessions_ss)
+				{
+					size_t num_accessions = 0;
+					size_t i;
+
+					for (i = 0; i < num_rows; ++ i)
+						{
+							const char *accession_s = GetJSONString (json_array_get (plots_json_p, i), PL_ACCESSION_TABLE_TITLE_S);
+
+							if (!IsStringEmpty (accession_s))
+								{
+									* (accessions_ss + num_accessions) = accession_s;
+									++ num_accessions;
+								}
+						}
+
+					if (num_accessions > 0)
+						{
+							success_flag = AddMaterialsByAccessionsToMaterialsMap (materials_p, accessions_ss, num_accessions, data_p);
+						}
+
+					FreeMemory (accessions_ss);
+				}
+			else
+				{
+					success_flag = false;
+				}
+		}
+
+	return success_flag;
+}
+
+
 static bool RemoveExistingPlotsForStudy (Study *study_p, const FieldTrialServiceData *data_p)
 {
 	bool success_flag = false;
@@ -2013,6 +2458,14 @@ static bool RemoveExistingPlotsForStudy (Study *study_p, const FieldTrialService
 
 					bson_destroy (query_p);
 				}		/* if (query_p) */
+
+			if (success_flag)
+				{
+					if (!RemoveMaterialUsageForStudy (study_p -> st_id_p, data_p))
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to remove material usage for study \"%s\"", study_p -> st_name_s);
+						}
+				}
 		}
 
 	return success_flag;
@@ -2078,6 +2531,9 @@ static json_t *GetStudyPlotsForSubmissionTable (Study *study_p, FieldTrialServic
 	 */
 	if (study_p -> st_plots_p -> ll_size == 0)
 		{
+			/* The plots are only read to fill in the table */
+			UseStudyArena (study_p, service_data_p);
+
 			if (!GetStudyPlots (study_p, VF_CLIENT_FULL, service_data_p))
 				{
 
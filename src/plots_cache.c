@@ -6,15 +6,30 @@
  */
 
 
+#include <time.h>
+
 #include "plots_cache.h"
 #include "plot_jobs.h"
 #include "row_jobs.h"
+#include "dfw_util.h"
+#include "material_usage.h"
+#include "revision_store.h"
 
 #include "math_utils.h"
+#include "mongodb_util.h"
+#include "time_util.h"
 
 
 static int IsCachedEntry (json_t *cache_p, const char * const key_s, const size_t row_index, size_t *duplicate_value_p);
 
+static void SetPlotsCacheKey (char *key_s, const uint32 row, const uint32 column);
+
+static CachedPlotNode *GetCachedPlotNode (PlotsCache *plots_cache_p, const uint32 row, const uint32 column);
+
+static json_t *GetExistingPlots (bson_t *ids_p, const FieldTrialServiceData *data_p);
+
+static size_t ReportBulkWriteErrors (const bson_t *reply_p, CachedPlotNode **nodes_pp, const size_t num_nodes, ServiceJob *job_p);
+
 
 
 PlotsCache *AllocatePlotsCache (void)
@@ -27,14 +42,30 @@ PlotsCache *AllocatePlotsCache (void)
 
 			if (id_cache_p)
 				{
-					PlotsCache * pc_p = (PlotsCache *) AllocMemory (sizeof (PlotsCache));
+					LinkedList *plots_p = AllocateLinkedList (FreeListItem);
 
-					if (pc_p)
+					if (plots_p)
 						{
-							pc_p -> pc_grid_cache_p = grid_cache_p;
-							pc_p -> pc_index_cache_p = id_cache_p;
+							HashTable *plots_table_p = GetHashTableOfStringPointers (256, 75);
+
+							if (plots_table_p)
+								{
+									PlotsCache * pc_p = (PlotsCache *) AllocMemory (sizeof (PlotsCache));
+
+									if (pc_p)
+										{
+											pc_p -> pc_grid_cache_p = grid_cache_p;
+											pc_p -> pc_index_cache_p = id_cache_p;
+											pc_p -> pc_plots_p = plots_p;
+											pc_p -> pc_plots_table_p = plots_table_p;
 
-							return pc_p;
+											return pc_p;
+										}
+
+									FreeHashTable (plots_table_p);
+								}
+
+							FreeLinkedList (plots_p);
 						}
 
 					json_decref (id_cache_p);
@@ -52,6 +83,13 @@ void FreePlotsCache (PlotsCache *plots_cache_p)
 	json_decref (plots_cache_p -> pc_grid_cache_p);
 	json_decref (plots_cache_p -> pc_index_cache_p);
 
+	/*
+	 * The table's keys point into the list's nodes
+	 * so free the table first.
+	 */
+	FreeHashTable (plots_cache_p -> pc_plots_table_p);
+	FreeLinkedList (plots_cache_p -> pc_plots_p);
+
 	FreeMemory (plots_cache_p);
 }
 
@@ -262,3 +300,617 @@ static int IsCachedEntry (json_t *cache_p, const char * const key_s, const size_
 	return cached_res;
 }
 
+
+bool AddStudyPlotsToPlotsCache (PlotsCache *plots_cache_p, Study *study_p)
+{
+	PlotNode *node_p = (PlotNode *) (study_p -> st_plots_p -> ll_head_p);
+
+	while (node_p)
+		{
+			if (!AddPlotToPlotsCache (plots_cache_p, node_p -> pn_plot_p))
+				{
+					return false;
+				}
+
+			node_p = (PlotNode *) (node_p -> pn_node.ln_next_p);
+		}
+
+	return true;
+}
+
+
+bool AddPlotToPlotsCache (PlotsCache *plots_cache_p, Plot *plot_p)
+{
+	CachedPlotNode *node_p = (CachedPlotNode *) AllocMemory (sizeof (CachedPlotNode));
+
+	if (node_p)
+		{
+			InitListItem (& (node_p -> cpn_node));
+
+			node_p -> cpn_plot_p = plot_p;
+			node_p -> cpn_spreadsheet_row = 0;
+			SetPlotsCacheKey (node_p -> cpn_key_s, plot_p -> pl_row_index, plot_p -> pl_column_index);
+
+			if (PutInHashTable (plots_cache_p -> pc_plots_table_p, node_p -> cpn_key_s, node_p))
+				{
+					LinkedListAddTail (plots_cache_p -> pc_plots_p, & (node_p -> cpn_node));
+					return true;
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add plot at row " UINT32_FMT ", column " UINT32_FMT " to plots cache", plot_p -> pl_row_index, plot_p -> pl_column_index);
+				}
+
+			FreeMemory (node_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate plots cache node for row " UINT32_FMT ", column " UINT32_FMT, plot_p -> pl_row_index, plot_p -> pl_column_index);
+		}
+
+	return false;
+}
+
+
+Plot *GetPlotFromPlotsCache (PlotsCache *plots_cache_p, const uint32 row, const uint32 column)
+{
+	CachedPlotNode *node_p = GetCachedPlotNode (plots_cache_p, row, column);
+
+	return node_p ? node_p -> cpn_plot_p : NULL;
+}
+
+
+Row *GetRowFromPlotsCache (PlotsCache *plots_cache_p, const uint32 row, const uint32 column, const uint32 rack)
+{
+	Plot *plot_p = GetPlotFromPlotsCache (plots_cache_p, row, column);
+
+	return plot_p ? GetRowFromPlotByRackIndex (plot_p, rack) : NULL;
+}
+
+
+bool SetPlotsCacheEntryModified (PlotsCache *plots_cache_p, const Plot *plot_p, const uint32 spreadsheet_row)
+{
+	CachedPlotNode *node_p = GetCachedPlotNode (plots_cache_p, plot_p -> pl_row_index, plot_p -> pl_column_index);
+
+	if (node_p)
+		{
+			node_p -> cpn_spreadsheet_row = spreadsheet_row;
+			return true;
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "No plots cache entry for row " UINT32_FMT ", column " UINT32_FMT, plot_p -> pl_row_index, plot_p -> pl_column_index);
+
+	return false;
+}
+
+
+OperationStatus SaveModifiedPlotsFromPlotsCache (PlotsCache *plots_cache_p, ServiceJob *job_p, const FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	CachedPlotNode *node_p = (CachedPlotNode *) (plots_cache_p -> pc_plots_p -> ll_head_p);
+	CachedPlotNode **nodes_pp = NULL;
+	json_t *saved_plots_p = NULL;
+	size_t num_modified = 0;
+
+	while (node_p)
+		{
+			if (node_p -> cpn_spreadsheet_row > 0)
+				{
+					++ num_modified;
+				}
+
+			node_p = (CachedPlotNode *) (node_p -> cpn_node.ln_next_p);
+		}
+
+	if (num_modified == 0)
+		{
+			return OS_SUCCEEDED;
+		}
+
+	/*
+	 * Store which plot each bulk operation is for so that
+	 * we can map any write errors back to the spreadsheet rows
+	 */
+	nodes_pp = (CachedPlotNode **) AllocMemoryArray (num_modified, sizeof (CachedPlotNode *));
+
+	if (nodes_pp)
+		{
+			bson_t *existing_ids_p = bson_new ();
+
+			if (existing_ids_p)
+				{
+					time_t now = time (NULL);
+					struct tm now_tm;
+					char *timestamp_s = NULL;
+
+					localtime_r (&now, &now_tm);
+					timestamp_s = GetTimeAsString (&now_tm, true, NULL);
+
+					if (timestamp_s)
+						{
+							bson_t *bulk_opts_p = BCON_NEW ("ordered", BCON_BOOL (false));
+
+							if (bulk_opts_p)
+								{
+									bson_t *upsert_opts_p = BCON_NEW ("upsert", BCON_BOOL (true));
+
+									if (upsert_opts_p)
+										{
+											size_t num_ops = 0;
+											size_t num_existing = 0;
+											json_t *existing_plots_p = NULL;
+											json_t *revisions_p = NULL;
+											mongoc_bulk_operation_t *bulk_p = NULL;
+
+											/*
+											 * Get the ids of the plots that are already in the
+											 * database before PrepareSaveData () creates ids
+											 * for the new ones
+											 */
+											node_p = (CachedPlotNode *) (plots_cache_p -> pc_plots_p -> ll_head_p);
+											while (node_p)
+												{
+													if ((node_p -> cpn_spreadsheet_row > 0) && (node_p -> cpn_plot_p -> pl_id_p))
+														{
+															char buffer_s [16];
+															const char *key_s = NULL;
+
+															bson_uint32_to_string ((uint32_t) num_existing, &key_s, buffer_s, sizeof (buffer_s));
+															BSON_APPEND_OID (existing_ids_p, key_s, node_p -> cpn_plot_p -> pl_id_p);
+															++ num_existing;
+														}
+
+													node_p = (CachedPlotNode *) (node_p -> cpn_node.ln_next_p);
+												}
+
+											/*
+											 * Each existing plot's previous version goes in the revision
+											 * store, so get them all with a single query
+											 */
+											if (num_existing > 0)
+												{
+													existing_plots_p = GetExistingPlots (existing_ids_p, data_p);
+
+													if (!existing_plots_p)
+														{
+															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get " SIZET_FMT " existing plots, they will not be saved", num_existing);
+														}
+												}
+
+											if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+												{
+													bulk_p = mongoc_collection_create_bulk_operation_with_opts (data_p -> dftsd_mongo_p -> mt_collection_p, bulk_opts_p);
+												}
+
+											if (bulk_p)
+												{
+													/*
+													 * The saved plots in the same order as the bulk operations so that
+													 * the material usage can be updated for those that were written
+													 */
+													saved_plots_p = json_array ();
+
+													if (!saved_plots_p)
+														{
+															PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to allocate saved plots array, material usage will not be updated");
+														}
+
+													/*
+													 * The revisions of the existing plots, or null for the new ones,
+													 * in the same order as the bulk operations
+													 */
+													revisions_p = json_array ();
+
+													if (!revisions_p)
+														{
+															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate revisions array, no revisions will be stored");
+														}
+
+													node_p = (CachedPlotNode *) (plots_cache_p -> pc_plots_p -> ll_head_p);
+
+													while (node_p)
+														{
+															if (node_p -> cpn_spreadsheet_row > 0)
+																{
+																	Plot *plot_p = node_p -> cpn_plot_p;
+																	bson_t *selector_p = NULL;
+																	bool added_flag = false;
+																	const json_t *previous_plot_p = NULL;
+																	bool revised_flag = true;
+
+																	if (plot_p -> pl_id_p)
+																		{
+																			char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+																			bson_oid_to_string (plot_p -> pl_id_p, id_s);
+																			previous_plot_p = existing_plots_p ? json_object_get (existing_plots_p, id_s) : NULL;
+
+																			/*
+																			 * We couldn't get the existing version so it
+																			 * can't be stored as a revision
+																			 */
+																			if ((!previous_plot_p) && (!existing_plots_p))
+																				{
+																					revised_flag = false;
+																				}
+																		}
+
+																	if (revised_flag && (PrepareSaveData (& (plot_p -> pl_id_p), &selector_p)))
+																		{
+																			json_t *plot_json_p = GetPlotAsJSON (plot_p, VF_STORAGE, NULL, data_p);
+
+																			if (plot_json_p)
+																				{
+																					if (SetJSONString (plot_json_p, MONGO_TIMESTAMP_S, timestamp_s))
+																						{
+																							bson_t *doc_p = NULL;
+																							bson_t *query_p = NULL;
+																							json_t *revision_p = NULL;
+
+																							if (previous_plot_p)
+																								{
+																									/*
+																									 * Only replace the plot if it is still the version that
+																									 * the revision is made from. If it has changed, the
+																									 * upsert fails with a duplicate id and is reported
+																									 * along with any other write errors.
+																									 */
+																									revision_p = GetRevisionEntry (previous_plot_p, plot_json_p, data_p);
+
+																									if (revision_p)
+																										{
+																											query_p = bson_copy (selector_p);
+
+																											if (query_p && (!AddRevisionConditionsToSelector (query_p, previous_plot_p)))
+																												{
+																													bson_destroy (query_p);
+																													query_p = NULL;
+																												}
+																										}
+																									else
+																										{
+																											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, previous_plot_p, "Failed to create revision of plot");
+																										}
+																								}
+																							else if (SetJSONInteger (plot_json_p, RS_REVISION_NUMBER_S, 0))
+																								{
+																									query_p = bson_copy (selector_p);
+																								}
+
+																							if (query_p)
+																								{
+																									doc_p = ConvertJSONToBSON (plot_json_p);
+																								}
+
+																							if (doc_p)
+																								{
+																									bson_error_t error;
+
+																									if (mongoc_bulk_operation_replace_one_with_opts (bulk_p, query_p, doc_p, upsert_opts_p, &error))
+																										{
+																											* (nodes_pp + num_ops) = node_p;
+																											++ num_ops;
+																											added_flag = true;
+
+																											if (saved_plots_p && (json_array_append (saved_plots_p, plot_json_p) != 0))
+																												{
+																													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to store saved plot, material usage will not be updated");
+																													json_decref (saved_plots_p);
+																													saved_plots_p = NULL;
+																												}
+
+																											/*
+																											 * Keep the revisions in the same order as the bulk
+																											 * operations so that they are only stored for the
+																											 * plots that are written.
+																											 */
+																											if (revisions_p)
+																												{
+																													json_t *value_p = revision_p ? revision_p : json_null ();
+
+																													revision_p = NULL;
+
+																													if (json_array_append_new (revisions_p, value_p) != 0)
+																														{
+																															PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to store revision of plot, no revisions will be stored");
+																															json_decref (revisions_p);
+																															revisions_p = NULL;
+																														}
+																												}
+																										}
+																									else
+																										{
+																											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to add plot to bulk operation: \"%s\"", error.message);
+																										}
+
+																									bson_destroy (doc_p);
+																								}		/* if (doc_p) */
+
+																							if (query_p)
+																								{
+																									bson_destroy (query_p);
+																								}
+
+																							if (revision_p)
+																								{
+																									json_decref (revision_p);
+																								}
+
+																						}		/* if (SetJSONString (plot_json_p, MONGO_TIMESTAMP_S, timestamp_s)) */
+
+																					json_decref (plot_json_p);
+																				}		/* if (plot_json_p) */
+
+																			if (selector_p)
+																				{
+																					bson_free (selector_p);
+																				}
+
+																		}		/* if (PrepareSaveData (& (plot_p -> pl_id_p), &selector_p)) */
+
+																	if (!added_flag)
+																		{
+																			AddTabularParameterErrorMessageToServiceJob (job_p, PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, "Failed to save row", node_p -> cpn_spreadsheet_row, NULL);
+																		}
+
+																}		/* if (node_p -> cpn_spreadsheet_row > 0) */
+
+															node_p = (CachedPlotNode *) (node_p -> cpn_node.ln_next_p);
+														}		/* while (node_p) */
+
+
+													if (num_ops > 0)
+														{
+															bson_t reply;
+															bson_error_t error;
+															size_t num_failed = 0;
+															bool executed_flag = (mongoc_bulk_operation_execute (bulk_p, &reply, &error) != 0);
+
+															if (!executed_flag)
+																{
+																	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Bulk write of " SIZET_FMT " plots failed: \"%s\"", num_ops, error.message);
+																}
+
+															/*
+															 * With an unordered bulk write, the failures for individual
+															 * plots are listed in the reply and the others are still written
+															 */
+															num_failed = ReportBulkWriteErrors (&reply, nodes_pp, num_ops, job_p);
+
+															/*
+															 * If the whole operation failed without any individual
+															 * errors, e.g. a network error, nothing was saved
+															 */
+															if ((num_failed == 0) && (!executed_flag))
+																{
+																	num_failed = num_ops;
+																}
+
+															if (num_failed == 0)
+																{
+																	status = (num_ops == num_modified) ? OS_SUCCEEDED : OS_PARTIALLY_SUCCEEDED;
+																}
+															else if (num_failed < num_ops)
+																{
+																	status = OS_PARTIALLY_SUCCEEDED;
+																}
+
+															if (saved_plots_p && (num_failed < num_ops))
+																{
+																	size_t i;
+
+																	/* Skip the plots that failed to be written */
+																	for (i = 0; i < num_ops; ++ i)
+																		{
+																			if (! (* (nodes_pp + i)))
+																				{
+																					json_array_set_new (saved_plots_p, i, json_null ());
+																				}
+																		}
+
+																	if (!UpdateMaterialUsageForPlots (saved_plots_p, data_p))
+																		{
+																			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to update material usage for " SIZET_FMT " plots", num_ops - num_failed);
+																		}
+																}
+
+															if (revisions_p && (num_failed < num_ops))
+																{
+																	json_t *written_revisions_p = json_array ();
+
+																	if (written_revisions_p)
+																		{
+																			size_t i;
+
+																			/* Only store the revisions of the plots that were written */
+																			for (i = 0; i < num_ops; ++ i)
+																				{
+																					json_t *revision_p = json_array_get (revisions_p, i);
+
+																					if ((* (nodes_pp + i)) && (json_is_object (revision_p)))
+																						{
+																							json_array_append (written_revisions_p, revision_p);
+																						}
+																				}
+
+																			if (!AddRevisionEntries (written_revisions_p, DFTD_PLOT, data_p))
+																				{
+																					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Saved plots but failed to store " SIZET_FMT " of their previous versions", json_array_size (written_revisions_p));
+																				}
+
+																			json_decref (written_revisions_p);
+																		}
+																	else
+																		{
+																			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate written revisions array, no revisions will be stored");
+																		}
+																}
+
+															bson_destroy (&reply);
+														}		/* if (num_ops > 0) */
+
+													if (saved_plots_p)
+														{
+															json_decref (saved_plots_p);
+														}
+
+													if (revisions_p)
+														{
+															json_decref (revisions_p);
+														}
+
+													mongoc_bulk_operation_destroy (bulk_p);
+												}		/* if (bulk_p) */
+											else
+												{
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create bulk operation for " SIZET_FMT " plots", num_modified);
+												}
+
+											if (existing_plots_p)
+												{
+													json_decref (existing_plots_p);
+												}
+
+											bson_destroy (upsert_opts_p);
+										}		/* if (upsert_opts_p) */
+
+									bson_destroy (bulk_opts_p);
+								}		/* if (bulk_opts_p) */
+
+							FreeCopiedString (timestamp_s);
+						}		/* if (timestamp_s) */
+
+					bson_destroy (existing_ids_p);
+				}		/* if (existing_ids_p) */
+
+			FreeMemory (nodes_pp);
+		}		/* if (nodes_pp) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate bulk operations list for " SIZET_FMT " plots", num_modified);
+		}
+
+	return status;
+}
+
+
+static void SetPlotsCacheKey (char *key_s, const uint32 row, const uint32 column)
+{
+	snprintf (key_s, PC_PLOT_KEY_BUFFER_SIZE, UINT32_FMT "," UINT32_FMT, row, column);
+}
+
+
+static CachedPlotNode *GetCachedPlotNode (PlotsCache *plots_cache_p, const uint32 row, const uint32 column)
+{
+	char key_s [PC_PLOT_KEY_BUFFER_SIZE];
+
+	SetPlotsCacheKey (key_s, row, column);
+
+	return (CachedPlotNode *) GetFromHashTable (plots_cache_p -> pc_plots_table_p, key_s);
+}
+
+
+/*
+ * Get the current versions of the given plots as a JSON object
+ * keyed by their ids.
+ */
+static json_t *GetExistingPlots (bson_t *ids_p, const FieldTrialServiceData *data_p)
+{
+	json_t *plots_p = NULL;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+		{
+			bson_t *query_p = BCON_NEW (MONGO_ID_S, "{", "$in", BCON_ARRAY (ids_p), "}");
+
+			if (query_p)
+				{
+					json_t *results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, NULL);
+
+					if (results_p)
+						{
+							plots_p = json_object ();
+
+							if (plots_p)
+								{
+									json_t *plot_json_p;
+									size_t i;
+
+									json_array_foreach (results_p, i, plot_json_p)
+										{
+											bson_oid_t id;
+
+											if (GetMongoIdFromJSON (plot_json_p, &id))
+												{
+													char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+													bson_oid_to_string (&id, id_s);
+
+													if (json_object_set (plots_p, id_s, plot_json_p) != 0)
+														{
+															PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to store existing plot");
+															json_decref (plots_p);
+															plots_p = NULL;
+															break;
+														}
+												}
+										}
+
+								}		/* if (plots_p) */
+
+							json_decref (results_p);
+						}		/* if (results_p) */
+
+					bson_destroy (query_p);
+				}		/* if (query_p) */
+
+		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT])) */
+
+	return plots_p;
+}
+
+
+static size_t ReportBulkWriteErrors (const bson_t *reply_p, CachedPlotNode **nodes_pp, const size_t num_nodes, ServiceJob *job_p)
+{
+	size_t num_errors = 0;
+	json_t *reply_json_p = ConvertBSONToJSON (reply_p, NULL);
+
+	if (reply_json_p)
+		{
+			const json_t *errors_p = json_object_get (reply_json_p, "writeErrors");
+
+			if (json_is_array (errors_p))
+				{
+					const json_t *error_p;
+					size_t i;
+
+					json_array_foreach (errors_p, i, error_p)
+						{
+							json_int_t op_index = -1;
+
+							if (GetJSONInteger (error_p, "index", &op_index))
+								{
+									if ((op_index >= 0) && (((size_t) op_index) < num_nodes) && (* (nodes_pp + op_index)))
+										{
+											const CachedPlotNode *node_p = * (nodes_pp + op_index);
+											const char *message_s = GetJSONString (error_p, "errmsg");
+
+											AddTabularParameterErrorMessageToServiceJob (job_p, PL_PLOT_TABLE.npt_name_s, PL_PLOT_TABLE.npt_type, message_s ? message_s : "Failed to save row", node_p -> cpn_spreadsheet_row, NULL);
+											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, error_p, "Failed to save plot for spreadsheet row " UINT32_FMT, node_p -> cpn_spreadsheet_row);
+
+											++ num_errors;
+
+											/* Let the caller know that this plot wasn't saved */
+											* (nodes_pp + op_index) = NULL;
+										}
+								}
+
+						}		/* json_array_foreach (errors_p, i, error_p) */
+
+				}		/* if (json_is_array (errors_p)) */
+
+			json_decref (reply_json_p);
+		}		/* if (reply_json_p) */
+
+	return num_errors;
+}
+
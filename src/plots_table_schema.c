@@ -0,0 +1,170 @@
+/*
+ * plots_table_schema.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include "plots_table_schema.h"
+#include "dfw_util.h"
+#include "study_jobs.h"
+
+#include "memory_allocations.h"
+#include "streams.h"
+#include "string_utils.h"
+
+
+static PlotsTableColumn *CompilePlotsTableColumn (const char *key_s, Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p);
+
+
+PlotsTableSchema *AllocatePlotsTableSchema (void)
+{
+	LinkedList *columns_p = AllocateLinkedList (FreePlotsTableColumn);
+
+	if (columns_p)
+		{
+			HashTable *table_p = GetHashTableOfStringPointers (64, 75);
+
+			if (table_p)
+				{
+					PlotsTableSchema *schema_p = (PlotsTableSchema *) AllocMemory (sizeof (PlotsTableSchema));
+
+					if (schema_p)
+						{
+							schema_p -> pts_columns_p = columns_p;
+							schema_p -> pts_table_p = table_p;
+
+							return schema_p;
+						}
+
+					FreeHashTable (table_p);
+				}
+
+			FreeLinkedList (columns_p);
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate PlotsTableSchema");
+
+	return NULL;
+}
+
+
+void FreePlotsTableSchema (PlotsTableSchema *schema_p)
+{
+	/*
+	 * The table only points to the columns' keys so
+	 * it needs to go before the list
+	 */
+	FreeHashTable (schema_p -> pts_table_p);
+	FreeLinkedList (schema_p -> pts_columns_p);
+
+	FreeMemory (schema_p);
+}
+
+
+const PlotsTableColumn *GetPlotsTableColumn (PlotsTableSchema *schema_p, const char *key_s, Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p)
+{
+	PlotsTableColumn *column_p = (PlotsTableColumn *) GetFromHashTable (schema_p -> pts_table_p, key_s);
+
+	if (!column_p)
+		{
+			column_p = CompilePlotsTableColumn (key_s, study_p, job_p, data_p);
+
+			if (column_p)
+				{
+					if (PutInHashTable (schema_p -> pts_table_p, column_p -> ptc_key_s, column_p))
+						{
+							LinkedListAddTail (schema_p -> pts_columns_p, & (column_p -> ptc_node));
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add column \"%s\" to PlotsTableSchema", key_s);
+							FreePlotsTableColumn (& (column_p -> ptc_node));
+							column_p = NULL;
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "CompilePlotsTableColumn () failed for \"%s\"", key_s);
+				}
+		}
+
+	return column_p;
+}
+
+
+void FreePlotsTableColumn (ListItem *node_p)
+{
+	PlotsTableColumn *column_p = (PlotsTableColumn *) node_p;
+
+	if (column_p -> ptc_key_s)
+		{
+			FreeCopiedString (column_p -> ptc_key_s);
+		}
+
+	if (column_p -> ptc_measured_variable_p)
+		{
+			if ((column_p -> ptc_measured_variable_mem == MF_DEEP_COPY) || (column_p -> ptc_measured_variable_mem == MF_SHALLOW_COPY))
+				{
+					FreeMeasuredVariable (column_p -> ptc_measured_variable_p);
+				}
+		}
+
+	if (column_p -> ptc_metadata_p)
+		{
+			FreeObservationMetadata (column_p -> ptc_metadata_p);
+		}
+
+	FreeMemory (column_p);
+}
+
+
+static PlotsTableColumn *CompilePlotsTableColumn (const char *key_s, Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p)
+{
+	char *copied_key_s = EasyCopyToNewString (key_s);
+
+	if (copied_key_s)
+		{
+			PlotsTableColumn *column_p = (PlotsTableColumn *) AllocMemory (sizeof (PlotsTableColumn));
+
+			if (column_p)
+				{
+					bool notes_flag = false;
+
+					InitListItem (& (column_p -> ptc_node));
+
+					column_p -> ptc_key_s = copied_key_s;
+					column_p -> ptc_type = PTCT_UNKNOWN;
+					column_p -> ptc_measured_variable_p = NULL;
+					column_p -> ptc_measured_variable_mem = MF_ALREADY_FREED;
+					column_p -> ptc_metadata_p = NULL;
+					column_p -> ptc_treatment_factor_p = NULL;
+
+					/*
+					 * The row index isn't used when parsing the column heading
+					 */
+					if (GetObservationMetadata (key_s, & (column_p -> ptc_measured_variable_p), & (column_p -> ptc_metadata_p), &notes_flag, job_p, 0, & (column_p -> ptc_measured_variable_mem), data_p) == OS_SUCCEEDED)
+						{
+							if (column_p -> ptc_metadata_p)
+								{
+									column_p -> ptc_type = PTCT_OBSERVATION;
+								}
+						}
+					else
+						{
+							column_p -> ptc_treatment_factor_p = GetTreatmentFactorForStudyByUrl (study_p, key_s, data_p);
+
+							if (column_p -> ptc_treatment_factor_p)
+								{
+									column_p -> ptc_type = PTCT_TREATMENT_FACTOR;
+								}
+						}
+
+					return column_p;
+				}
+
+			FreeCopiedString (copied_key_s);
+		}
+
+	return NULL;
+}
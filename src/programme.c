@@ -30,6 +30,7 @@
 
 #include "programme_jobs.h"
 #include "mongodb_util.h"
+#include "option_list_cache.h"
 
 
 
@@ -785,6 +786,8 @@ OperationStatus SaveProgramme (Programme *programme_p, ServiceJob *job_p, FieldT
 							char *id_s = GetBSONOidAsString (programme_p -> pr_id_p);
 							json_t *programme_indexing_p = GetProgrammeAsJSON (programme_p, VF_INDEXING, data_p);
 
+							ClearOptionListCache (DFTD_PROGRAMME, data_p);
+
 							if (programme_indexing_p)
 								{
 									status = IndexData (job_p, programme_indexing_p, NULL);
@@ -31,6 +31,7 @@
 #include "frictionless_data_util.h"
 
 #include "permissions_editor.h"
+#include "option_list_cache.h"
 
 static const char * const S_EMPTY_LIST_OPTION_S = "<empty>";
 
@@ -402,7 +403,7 @@ json_t *GetAllProgrammesAsJSON (const FieldTrialServiceData *data_p, const bool
 bool SetUpProgrammesListParameter (const FieldTrialServiceData *data_p, StringParameter *param_p, const Programme *active_program_p, const bool empty_option_flag)
 {
 	bool success_flag = false;
-	json_t *results_p = GetAllProgrammesAsJSON (data_p, false);
+	json_t *results_p = GetOptionListDocuments (DFTD_PROGRAMME, data_p);
 	bool value_set_flag = false;
 
 	if (results_p)
@@ -0,0 +1,1392 @@
+/*
+ * revision_store.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <string.h>
+#include <time.h>
+
+#define ALLOCATE_REVISION_STORE_TAGS (1)
+#include "revision_store.h"
+#include "dfw_util.h"
+
+#include "mongodb_util.h"
+#include "time_util.h"
+#include "streams.h"
+#include "string_utils.h"
+#include "json_util.h"
+
+
+/*
+ * The extra keys added to the entries in the backup collections.
+ * Entries without a type are full copies made before revisions
+ * were stored as deltas and are treated as snapshots.
+ */
+static const char * const S_REVISION_TYPE_S = "revision_type";
+
+static const char * const S_REVISION_CHAIN_S = "revision_chain";
+
+static const char * const S_REVISION_DELTA_S = "revision_delta";
+
+static const char * const S_REVISION_SNAPSHOT_S = "snapshot";
+
+static const char * const S_REVISION_DELTA_TYPE_S = "delta";
+
+static const char * const S_REVISION_CURRENT_S = "current";
+
+
+/*
+ * The keys used within a delta. A delta either replaces a value
+ * outright or lists the changes to an object's keys or to an
+ * array's entries along with the array's new length.
+ */
+static const char * const S_DELTA_VALUE_S = "v";
+
+static const char * const S_DELTA_OBJECT_S = "o";
+
+static const char * const S_DELTA_DELETED_S = "d";
+
+static const char * const S_DELTA_ARRAY_S = "a";
+
+static const char * const S_DELTA_LENGTH_S = "n";
+
+
+static bool ReplaceRevisedMongoData (const json_t *json_p, const json_t *previous_p, const FieldTrialDatatype collection_type, const bson_t *selector_p, const FieldTrialServiceData *data_p);
+
+static bool AppendMissingCondition (bson_t *selector_p, const char *key_s);
+
+static json_int_t GetRevisionNumber (const json_t *doc_p);
+
+static json_t *GetNormalisedRevision (const json_t *doc_p);
+
+static json_t *GetRevisionFromEntry (const json_t *entry_p, const json_t *newer_p);
+
+static bson_t *GetNewerRevisionsQuery (const bson_oid_t *id_p, const char *timestamp_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+static json_t *GetCurrentVersion (const bson_oid_t *id_p, const char *timestamp_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p);
+
+static json_t *RunRevisionQuery (const char *collection_s, bson_t *query_p, bson_t *opts_p, const FieldTrialServiceData *data_p);
+
+static bool IsDeltaEntry (const json_t *entry_p);
+
+static size_t GetJSONSize (const json_t *json_p);
+
+static json_t *GetJSONDelta (const json_t *from_p, const json_t *to_p);
+
+static json_t *GetJSONObjectDelta (const json_t *from_p, const json_t *to_p);
+
+static json_t *GetJSONArrayDelta (const json_t *from_p, const json_t *to_p);
+
+static json_t *ApplyJSONDelta (const json_t *doc_p, const json_t *delta_p);
+
+static bool ApplyJSONDeltaInPlace (json_t **value_pp, const json_t *delta_p);
+
+static bool IsExtendedJSONValue (const json_t *value_p);
+
+
+
+bool SaveAndBackupMongoDataWithRevisions (json_t *json_p, const FieldTrialDatatype collection_type, bson_t *selector_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	time_t now = time (NULL);
+	struct tm now_tm;
+	char *timestamp_s = NULL;
+
+	localtime_r (&now, &now_tm);
+	timestamp_s = GetTimeAsString (&now_tm, true, NULL);
+
+	if (timestamp_s)
+		{
+			if (SetJSONString (json_p, MONGO_TIMESTAMP_S, timestamp_s))
+				{
+					json_t *existing_p = NULL;
+
+					if (selector_p)
+						{
+							if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [collection_type]))
+								{
+									existing_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, selector_p, NULL);
+								}
+
+							if (!existing_p)
+								{
+									PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, selector_p, "Failed to get existing document from \"%s\"", data_p -> dftsd_collection_ss [collection_type]);
+								}
+						}
+
+					if ((!selector_p) || (existing_p && (json_array_size (existing_p) == 0)))
+						{
+							/* It's a new document */
+							if (SetJSONInteger (json_p, RS_REVISION_NUMBER_S, 0))
+								{
+									success_flag = SaveMongoData (data_p -> dftsd_mongo_p, json_p, data_p -> dftsd_collection_ss [collection_type], selector_p);
+								}
+						}
+					else if (existing_p)
+						{
+							const size_t num_existing = json_array_size (existing_p);
+
+							if (num_existing == 1)
+								{
+									const json_t *previous_p = json_array_get (existing_p, 0);
+									json_t *entry_p = GetRevisionEntry (previous_p, json_p, data_p);
+
+									if (entry_p)
+										{
+											/*
+											 * The previous version is only stored once the new one has replaced
+											 * it so that the revisions never include a version that wasn't saved
+											 */
+											if (ReplaceRevisedMongoData (json_p, previous_p, collection_type, selector_p, data_p))
+												{
+													success_flag = true;
+
+													if (!AddRevisionEntry (entry_p, collection_type, data_p))
+														{
+															PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, selector_p, "Saved document in \"%s\" but failed to store its previous version", data_p -> dftsd_collection_ss [collection_type]);
+														}
+												}
+
+											json_decref (entry_p);
+										}
+								}
+							else
+								{
+									PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, selector_p, "Selector matched " SIZET_FMT " documents in \"%s\"", num_existing, data_p -> dftsd_collection_ss [collection_type]);
+								}
+						}
+
+					if (existing_p)
+						{
+							json_decref (existing_p);
+						}
+
+				}		/* if (SetJSONString (json_p, MONGO_TIMESTAMP_S, timestamp_s)) */
+
+			FreeCopiedString (timestamp_s);
+		}		/* if (timestamp_s) */
+
+	return success_flag;
+}
+
+
+json_t *GetRevisionEntry (const json_t *previous_p, json_t *current_p, const FieldTrialServiceData *data_p)
+{
+	json_t *entry_p = NULL;
+	json_t *previous_revision_p = GetNormalisedRevision (previous_p);
+
+	if (previous_revision_p)
+		{
+			json_t *id_p = json_object_get (previous_revision_p, DFT_BACKUPS_ID_KEY_S);
+
+			if (id_p)
+				{
+					const json_int_t number = GetRevisionNumber (previous_revision_p);
+
+					if (SetJSONInteger (current_p, RS_REVISION_NUMBER_S, number + 1))
+						{
+							const json_int_t size = (json_int_t) GetJSONSize (previous_revision_p);
+							const uint32 interval = data_p -> dftsd_revision_snapshot_interval;
+
+							/*
+							 * Store a full snapshot every interval revisions so that rebuilding
+							 * an old version never needs too many deltas. With no interval,
+							 * every revision is a snapshot as SaveAndBackupMongoDataWithTimestamp ()
+							 * would store.
+							 */
+							if ((interval > 0) && ((number % interval) != 0))
+								{
+									json_t *current_revision_p = GetNormalisedRevision (current_p);
+
+									if (current_revision_p)
+										{
+											/* The delta goes from the new version back to the previous one */
+											json_t *delta_p = GetJSONDelta (current_revision_p, previous_revision_p);
+
+											if (delta_p)
+												{
+													entry_p = json_pack ("{s:O,s:s,s:I,s:I,s:I,s:o}", DFT_BACKUPS_ID_KEY_S, id_p, S_REVISION_TYPE_S, S_REVISION_DELTA_TYPE_S,
+																							 S_REVISION_CHAIN_S, (json_int_t) (number % interval), RS_REVISION_NUMBER_S, number, RS_REVISION_SIZE_S, size, S_REVISION_DELTA_S, delta_p);
+
+													if (entry_p)
+														{
+															const char *timestamp_s = GetJSONString (previous_revision_p, MONGO_TIMESTAMP_S);
+
+															if (timestamp_s && (!SetJSONString (entry_p, MONGO_TIMESTAMP_S, timestamp_s)))
+																{
+																	json_decref (entry_p);
+																	entry_p = NULL;
+																}
+														}
+												}
+
+											json_decref (current_revision_p);
+										}
+								}
+							else
+								{
+									entry_p = json_incref (previous_revision_p);
+
+									/* The backup collection gives the snapshot its own id */
+									json_object_del (entry_p, MONGO_ID_S);
+
+									if (! ((SetJSONString (entry_p, S_REVISION_TYPE_S, S_REVISION_SNAPSHOT_S)) && (SetJSONInteger (entry_p, S_REVISION_CHAIN_S, 0)) &&
+												 (SetJSONInteger (entry_p, RS_REVISION_NUMBER_S, number)) && (SetJSONInteger (entry_p, RS_REVISION_SIZE_S, size))))
+										{
+											json_decref (entry_p);
+											entry_p = NULL;
+										}
+								}
+
+							if (!entry_p)
+								{
+									PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, previous_revision_p, "Failed to create revision");
+								}
+
+						}		/* if (SetJSONInteger (current_p, RS_REVISION_NUMBER_S, number + 1)) */
+
+				}		/* if (id_p) */
+			else
+				{
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, previous_p, "Document has no id");
+				}
+
+			json_decref (previous_revision_p);
+		}		/* if (previous_revision_p) */
+
+	return entry_p;
+}
+
+
+bool AddRevisionConditionsToSelector (bson_t *selector_p, const json_t *previous_p)
+{
+	bool success_flag = false;
+	const char *timestamp_s = GetJSONString (previous_p, MONGO_TIMESTAMP_S);
+	json_int_t number = 0;
+
+	if (timestamp_s)
+		{
+			success_flag = BSON_APPEND_UTF8 (selector_p, MONGO_TIMESTAMP_S, timestamp_s);
+		}
+	else
+		{
+			success_flag = AppendMissingCondition (selector_p, MONGO_TIMESTAMP_S);
+		}
+
+	if (success_flag)
+		{
+			if (GetJSONInteger (previous_p, RS_REVISION_NUMBER_S, &number))
+				{
+					success_flag = BSON_APPEND_INT64 (selector_p, RS_REVISION_NUMBER_S, number);
+				}
+			else
+				{
+					success_flag = AppendMissingCondition (selector_p, RS_REVISION_NUMBER_S);
+				}
+		}
+
+	if (!success_flag)
+		{
+			PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, selector_p, "Failed to add revision conditions to selector");
+		}
+
+	return success_flag;
+}
+
+
+bool AddRevisionEntry (const json_t *entry_p, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_backup_collection_ss [collection_type]))
+		{
+			bson_t *doc_p = ConvertJSONToBSON (entry_p);
+
+			if (doc_p)
+				{
+					bson_error_t error;
+
+					if (mongoc_collection_insert_one (data_p -> dftsd_mongo_p -> mt_collection_p, doc_p, NULL, NULL, &error))
+						{
+							success_flag = true;
+						}
+					else
+						{
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to store revision: \"%s\"", error.message);
+						}
+
+					bson_destroy (doc_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+bool AddRevisionEntries (const json_t *entries_p, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	const size_t num_entries = json_array_size (entries_p);
+
+	if (num_entries == 0)
+		{
+			success_flag = true;
+		}
+	else if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_backup_collection_ss [collection_type]))
+		{
+			bson_t *opts_p = BCON_NEW ("ordered", BCON_BOOL (false));
+
+			if (opts_p)
+				{
+					mongoc_bulk_operation_t *bulk_p = mongoc_collection_create_bulk_operation_with_opts (data_p -> dftsd_mongo_p -> mt_collection_p, opts_p);
+
+					if (bulk_p)
+						{
+							size_t i;
+							bool added_flag = true;
+
+							for (i = 0; (i < num_entries) && added_flag; ++ i)
+								{
+									const json_t *entry_p = json_array_get (entries_p, i);
+									bson_t *doc_p = ConvertJSONToBSON (entry_p);
+
+									added_flag = false;
+
+									if (doc_p)
+										{
+											bson_error_t error;
+
+											if (mongoc_bulk_operation_insert_with_opts (bulk_p, doc_p, NULL, &error))
+												{
+													added_flag = true;
+												}
+											else
+												{
+													PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to add revision to bulk operation: \"%s\"", error.message);
+												}
+
+											bson_destroy (doc_p);
+										}
+								}
+
+							if (added_flag)
+								{
+									bson_t reply;
+									bson_error_t error;
+
+									if (mongoc_bulk_operation_execute (bulk_p, &reply, &error) != 0)
+										{
+											success_flag = true;
+										}
+									else
+										{
+											PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, &reply, "Failed to store " SIZET_FMT " revisions: \"%s\"", num_entries, error.message);
+										}
+
+									bson_destroy (&reply);
+								}
+
+							mongoc_bulk_operation_destroy (bulk_p);
+						}		/* if (bulk_p) */
+
+					bson_destroy (opts_p);
+				}		/* if (opts_p) */
+
+		}		/* else if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_backup_collection_ss [collection_type])) */
+
+	return success_flag;
+}
+
+
+json_t *GetAllRevisionsOfObject (const char *id_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	if (bson_oid_is_valid (id_s, strlen (id_s)))
+		{
+			bson_oid_t oid;
+			json_t *live_p = NULL;
+
+			bson_oid_init_from_string (&oid, id_s);
+
+			live_p = GetCurrentVersion (&oid, NULL, collection_type, data_p);
+
+			if (live_p)
+				{
+					bson_t *query_p = BCON_NEW (DFT_BACKUPS_ID_KEY_S, BCON_OID (&oid));
+
+					if (query_p)
+						{
+							bson_t *opts_p = BCON_NEW ("sort", "{", RS_REVISION_NUMBER_S, BCON_INT32 (-1), MONGO_TIMESTAMP_S, BCON_INT32 (-1), "}");
+
+							if (opts_p)
+								{
+									json_t *entries_p = RunRevisionQuery (data_p -> dftsd_backup_collection_ss [collection_type], query_p, opts_p, data_p);
+
+									if (entries_p)
+										{
+											json_t *results_p = json_array ();
+
+											if (results_p)
+												{
+													const size_t num_entries = json_array_size (entries_p);
+													size_t i = 0;
+													bool success_flag = true;
+
+													/*
+													 * Each delta is from the version after it so work
+													 * back from the current version
+													 */
+													json_t *newer_p = NULL;
+
+													if (json_array_size (live_p) == 1)
+														{
+															json_t *current_p = json_array_get (live_p, 0);
+
+															success_flag = (json_array_append (results_p, current_p) == 0);
+															newer_p = GetNormalisedRevision (current_p);
+														}
+
+													while ((i < num_entries) && success_flag)
+														{
+															json_t *version_p = GetRevisionFromEntry (json_array_get (entries_p, i), newer_p);
+
+															if (version_p)
+																{
+																	if (json_array_append (results_p, version_p) == 0)
+																		{
+																			if (newer_p)
+																				{
+																					json_decref (newer_p);
+																				}
+
+																			newer_p = version_p;
+																			++ i;
+																		}
+																	else
+																		{
+																			json_decref (version_p);
+																			success_flag = false;
+																		}
+																}
+															else
+																{
+																	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to rebuild revision " SIZET_FMT " of \"%s\"", i, id_s);
+																	success_flag = false;
+																}
+														}
+
+													if (newer_p)
+														{
+															json_decref (newer_p);
+														}
+
+													if (success_flag)
+														{
+															json_decref (entries_p);
+															bson_destroy (opts_p);
+															bson_destroy (query_p);
+															json_decref (live_p);
+
+															return results_p;
+														}
+
+													json_decref (results_p);
+												}		/* if (results_p) */
+
+											json_decref (entries_p);
+										}		/* if (entries_p) */
+
+									bson_destroy (opts_p);
+								}		/* if (opts_p) */
+
+							bson_destroy (query_p);
+						}		/* if (query_p) */
+
+					json_decref (live_p);
+				}		/* if (live_p) */
+
+		}		/* if (bson_oid_is_valid (id_s, strlen (id_s))) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" is not a valid oid", id_s);
+		}
+
+	return NULL;
+}
+
+
+json_t *GetRevisionOfObject (const char *id_s, const char *timestamp_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	json_t *version_p = NULL;
+
+	if (bson_oid_is_valid (id_s, strlen (id_s)))
+		{
+			bson_oid_t oid;
+			json_t *live_p = NULL;
+
+			bson_oid_init_from_string (&oid, id_s);
+
+			/* Is it the current version? */
+			live_p = GetCurrentVersion (&oid, timestamp_s, collection_type, data_p);
+
+			if (live_p)
+				{
+					if (json_array_size (live_p) == 1)
+						{
+							version_p = json_incref (json_array_get (live_p, 0));
+						}
+					else
+						{
+							/*
+							 * Get the requested version and all of the newer ones, oldest
+							 * first, so we can find the nearest snapshot to rebuild from
+							 */
+							bson_t *query_p = GetNewerRevisionsQuery (&oid, timestamp_s, collection_type, data_p);
+
+							if (query_p)
+								{
+									bson_t *opts_p = BCON_NEW ("sort", "{", RS_REVISION_NUMBER_S, BCON_INT32 (1), MONGO_TIMESTAMP_S, BCON_INT32 (1), "}");
+
+									if (opts_p)
+										{
+											json_t *entries_p = RunRevisionQuery (data_p -> dftsd_backup_collection_ss [collection_type], query_p, opts_p, data_p);
+
+											if (entries_p)
+												{
+													const size_t num_entries = json_array_size (entries_p);
+													const json_t *first_p = json_array_get (entries_p, 0);
+													const char *first_timestamp_s = first_p ? GetJSONString (first_p, MONGO_TIMESTAMP_S) : NULL;
+
+													if (first_timestamp_s && (strcmp (first_timestamp_s, timestamp_s) == 0))
+														{
+															size_t i = 0;
+															json_t *newer_p = NULL;
+
+															while ((i < num_entries) && (IsDeltaEntry (json_array_get (entries_p, i))))
+																{
+																	++ i;
+																}
+
+															if (i < num_entries)
+																{
+																	newer_p = GetNormalisedRevision (json_array_get (entries_p, i));
+																}
+															else
+																{
+																	/* There's no newer snapshot so start from the current version */
+																	json_t *current_p = GetCurrentVersion (&oid, NULL, collection_type, data_p);
+
+																	if (current_p)
+																		{
+																			if (json_array_size (current_p) == 1)
+																				{
+																					newer_p = GetNormalisedRevision (json_array_get (current_p, 0));
+																				}
+
+																			json_decref (current_p);
+																		}
+																}
+
+															while (newer_p && (i > 0))
+																{
+																	json_t *older_p = NULL;
+
+																	-- i;
+
+																	older_p = GetRevisionFromEntry (json_array_get (entries_p, i), newer_p);
+																	json_decref (newer_p);
+																	newer_p = older_p;
+																}
+
+															if (newer_p)
+																{
+																	version_p = newer_p;
+																}
+															else
+																{
+																	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to rebuild revision \"%s\" of \"%s\"", timestamp_s, id_s);
+																}
+														}
+
+													json_decref (entries_p);
+												}		/* if (entries_p) */
+
+											bson_destroy (opts_p);
+										}		/* if (opts_p) */
+
+									bson_destroy (query_p);
+								}		/* if (query_p) */
+
+						}
+
+					json_decref (live_p);
+				}		/* if (live_p) */
+
+		}		/* if (bson_oid_is_valid (id_s, strlen (id_s))) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" is not a valid oid", id_s);
+		}
+
+	return version_p;
+}
+
+
+json_t *GetRevisionsMetadataOfObject (const char *id_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	if (bson_oid_is_valid (id_s, strlen (id_s)))
+		{
+			bson_oid_t oid;
+			json_t *live_p = NULL;
+
+			bson_oid_init_from_string (&oid, id_s);
+
+			live_p = GetCurrentVersion (&oid, NULL, collection_type, data_p);
+
+			if (live_p)
+				{
+					bson_t *query_p = BCON_NEW (DFT_BACKUPS_ID_KEY_S, BCON_OID (&oid));
+
+					if (query_p)
+						{
+							/* Only get the details that we need rather than the full versions */
+							bson_t *opts_p = BCON_NEW ("sort", "{", RS_REVISION_NUMBER_S, BCON_INT32 (-1), MONGO_TIMESTAMP_S, BCON_INT32 (-1), "}",
+																				 "projection", "{", MONGO_TIMESTAMP_S, BCON_INT32 (1), S_REVISION_TYPE_S, BCON_INT32 (1), RS_REVISION_SIZE_S, BCON_INT32 (1), "}");
+
+							if (opts_p)
+								{
+									json_t *entries_p = RunRevisionQuery (data_p -> dftsd_backup_collection_ss [collection_type], query_p, opts_p, data_p);
+
+									if (entries_p)
+										{
+											json_t *results_p = json_array ();
+
+											if (results_p)
+												{
+													bool success_flag = true;
+													const size_t num_entries = json_array_size (entries_p);
+													size_t i;
+
+													if (json_array_size (live_p) == 1)
+														{
+															const json_t *current_p = json_array_get (live_p, 0);
+															const char *timestamp_s = GetJSONString (current_p, MONGO_TIMESTAMP_S);
+															json_t *metadata_p = json_pack ("{s:s,s:I}", S_REVISION_TYPE_S, S_REVISION_CURRENT_S, RS_REVISION_SIZE_S, (json_int_t) GetJSONSize (current_p));
+
+															success_flag = false;
+
+															if (metadata_p)
+																{
+																	if ((!timestamp_s) || (SetJSONString (metadata_p, MONGO_TIMESTAMP_S, timestamp_s)))
+																		{
+																			success_flag = (json_array_append_new (results_p, metadata_p) == 0);
+																		}
+																	else
+																		{
+																			json_decref (metadata_p);
+																		}
+																}
+														}
+
+													for (i = 0; (i < num_entries) && success_flag; ++ i)
+														{
+															json_t *entry_p = json_array_get (entries_p, i);
+
+															/* Old full copies don't have a type */
+															if (!json_object_get (entry_p, S_REVISION_TYPE_S))
+																{
+																	success_flag = SetJSONString (entry_p, S_REVISION_TYPE_S, S_REVISION_SNAPSHOT_S);
+																}
+
+															if (success_flag)
+																{
+																	json_object_del (entry_p, MONGO_ID_S);
+
+																	success_flag = (json_array_append (results_p, entry_p) == 0);
+																}
+														}
+
+													if (success_flag)
+														{
+															json_decref (entries_p);
+															bson_destroy (opts_p);
+															bson_destroy (query_p);
+															json_decref (live_p);
+
+															return results_p;
+														}
+
+													json_decref (results_p);
+												}		/* if (results_p) */
+
+											json_decref (entries_p);
+										}		/* if (entries_p) */
+
+									bson_destroy (opts_p);
+								}		/* if (opts_p) */
+
+							bson_destroy (query_p);
+						}		/* if (query_p) */
+
+					json_decref (live_p);
+				}		/* if (live_p) */
+
+		}		/* if (bson_oid_is_valid (id_s, strlen (id_s))) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" is not a valid oid", id_s);
+		}
+
+	return NULL;
+}
+
+
+/*
+ * Replace a document only if it is still the previous version that
+ * its revision was made from.
+ */
+static bool ReplaceRevisedMongoData (const json_t *json_p, const json_t *previous_p, const FieldTrialDatatype collection_type, const bson_t *selector_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	bson_t *query_p = bson_copy (selector_p);
+
+	if (query_p)
+		{
+			if (AddRevisionConditionsToSelector (query_p, previous_p))
+				{
+					if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [collection_type]))
+						{
+							bson_t *doc_p = ConvertJSONToBSON (json_p);
+
+							if (doc_p)
+								{
+									bson_t reply;
+									bson_error_t error;
+
+									if (mongoc_collection_replace_one (data_p -> dftsd_mongo_p -> mt_collection_p, query_p, doc_p, NULL, &reply, &error))
+										{
+											bson_iter_t iter;
+
+											if (bson_iter_init_find (&iter, &reply, "matchedCount") && (bson_iter_as_int64 (&iter) == 1))
+												{
+													success_flag = true;
+												}
+											else
+												{
+													PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Document in \"%s\" has been changed by another request", data_p -> dftsd_collection_ss [collection_type]);
+												}
+										}
+									else
+										{
+											PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Failed to replace document in \"%s\": \"%s\"", data_p -> dftsd_collection_ss [collection_type], error.message);
+										}
+
+									bson_destroy (&reply);
+									bson_destroy (doc_p);
+								}		/* if (doc_p) */
+
+						}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [collection_type])) */
+
+				}		/* if (AddRevisionConditionsToSelector (query_p, previous_p)) */
+
+			bson_destroy (query_p);
+		}		/* if (query_p) */
+
+	return success_flag;
+}
+
+
+static bool AppendMissingCondition (bson_t *selector_p, const char *key_s)
+{
+	bool success_flag = false;
+	bson_t *exists_p = BCON_NEW ("$exists", BCON_BOOL (false));
+
+	if (exists_p)
+		{
+			success_flag = BSON_APPEND_DOCUMENT (selector_p, key_s, exists_p);
+			bson_destroy (exists_p);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Documents saved before their revisions were numbered count as revision 0.
+ */
+static json_int_t GetRevisionNumber (const json_t *doc_p)
+{
+	json_int_t number = 0;
+
+	if (!GetJSONInteger (doc_p, RS_REVISION_NUMBER_S, &number))
+		{
+			number = 0;
+		}
+
+	return number;
+}
+
+
+/*
+ * Put a stored version into the same form whether it came from the live
+ * collection or the backup collection. It keeps the id of the document
+ * it is a version of in both MONGO_ID_S and DFT_BACKUPS_ID_KEY_S and
+ * has none of the revision details.
+ */
+static json_t *GetNormalisedRevision (const json_t *doc_p)
+{
+	json_t *revision_p = json_deep_copy (doc_p);
+
+	if (revision_p)
+		{
+			json_t *id_p = json_object_get (revision_p, DFT_BACKUPS_ID_KEY_S);
+			int res;
+
+			if (id_p)
+				{
+					res = json_object_set (revision_p, MONGO_ID_S, id_p);
+				}
+			else
+				{
+					id_p = json_object_get (revision_p, MONGO_ID_S);
+					res = id_p ? json_object_set (revision_p, DFT_BACKUPS_ID_KEY_S, id_p) : 0;
+				}
+
+			if (res == 0)
+				{
+					json_object_del (revision_p, S_REVISION_TYPE_S);
+					json_object_del (revision_p, S_REVISION_CHAIN_S);
+					json_object_del (revision_p, RS_REVISION_SIZE_S);
+					json_object_del (revision_p, S_REVISION_DELTA_S);
+
+					return revision_p;
+				}
+
+			json_decref (revision_p);
+		}
+
+	return NULL;
+}
+
+
+static json_t *GetRevisionFromEntry (const json_t *entry_p, const json_t *newer_p)
+{
+	json_t *revision_p = NULL;
+
+	if (IsDeltaEntry (entry_p))
+		{
+			const json_t *delta_p = json_object_get (entry_p, S_REVISION_DELTA_S);
+
+			if (delta_p && newer_p)
+				{
+					json_int_t number;
+					json_int_t newer_number;
+
+					/*
+					 * A delta can only be applied to the version that it was made
+					 * from, so if that one is missing we can't rebuild this one.
+					 */
+					if ((GetJSONInteger (entry_p, RS_REVISION_NUMBER_S, &number)) && (GetJSONInteger (newer_p, RS_REVISION_NUMBER_S, &newer_number)) && (newer_number != number + 1))
+						{
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Delta is for revision " UINT32_FMT " but the next stored revision is " UINT32_FMT, (uint32) (number + 1), (uint32) newer_number);
+						}
+					else
+						{
+							revision_p = ApplyJSONDelta (newer_p, delta_p);
+						}
+				}
+			else
+				{
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "No version to apply delta to");
+				}
+		}
+	else
+		{
+			revision_p = GetNormalisedRevision (entry_p);
+		}
+
+	return revision_p;
+}
+
+
+/*
+ * Get the query for the stored version with the given timestamp and all of
+ * the ones newer than it. If there are several with the same timestamp,
+ * the newest one is used.
+ */
+static bson_t *GetNewerRevisionsQuery (const bson_oid_t *id_p, const char *timestamp_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	bson_t *newer_query_p = NULL;
+	bson_t *query_p = BCON_NEW (DFT_BACKUPS_ID_KEY_S, BCON_OID (id_p), MONGO_TIMESTAMP_S, BCON_UTF8 (timestamp_s));
+
+	if (query_p)
+		{
+			bson_t *opts_p = BCON_NEW ("sort", "{", RS_REVISION_NUMBER_S, BCON_INT32 (-1), "}", "limit", BCON_INT64 (1), "projection", "{", RS_REVISION_NUMBER_S, BCON_INT32 (1), "}");
+
+			if (opts_p)
+				{
+					json_t *results_p = RunRevisionQuery (data_p -> dftsd_backup_collection_ss [collection_type], query_p, opts_p, data_p);
+
+					if (results_p)
+						{
+							json_int_t number;
+
+							if ((json_array_size (results_p) == 1) && (GetJSONInteger (json_array_get (results_p, 0), RS_REVISION_NUMBER_S, &number)))
+								{
+									newer_query_p = BCON_NEW (DFT_BACKUPS_ID_KEY_S, BCON_OID (id_p), RS_REVISION_NUMBER_S, "{", "$gte", BCON_INT64 (number), "}");
+								}
+							else
+								{
+									/*
+									 * Versions stored before the revisions were numbered are
+									 * older than all of the numbered ones
+									 */
+									newer_query_p = BCON_NEW (DFT_BACKUPS_ID_KEY_S, BCON_OID (id_p),
+																						"$or", "[",
+																							"{", RS_REVISION_NUMBER_S, "{", "$exists", BCON_BOOL (true), "}", "}",
+																							"{", MONGO_TIMESTAMP_S, "{", "$gte", BCON_UTF8 (timestamp_s), "}", "}",
+																						"]");
+								}
+
+							json_decref (results_p);
+						}
+
+					bson_destroy (opts_p);
+				}
+
+			bson_destroy (query_p);
+		}
+
+	return newer_query_p;
+}
+
+
+static json_t *GetCurrentVersion (const bson_oid_t *id_p, const char *timestamp_s, const FieldTrialDatatype collection_type, const FieldTrialServiceData *data_p)
+{
+	json_t *results_p = NULL;
+	bson_t *query_p = BCON_NEW (MONGO_ID_S, BCON_OID (id_p));
+
+	if (query_p)
+		{
+			if ((timestamp_s == NULL) || (BSON_APPEND_UTF8 (query_p, MONGO_TIMESTAMP_S, timestamp_s)))
+				{
+					results_p = RunRevisionQuery (data_p -> dftsd_collection_ss [collection_type], query_p, NULL, data_p);
+				}
+
+			bson_destroy (query_p);
+		}
+
+	return results_p;
+}
+
+
+static json_t *RunRevisionQuery (const char *collection_s, bson_t *query_p, bson_t *opts_p, const FieldTrialServiceData *data_p)
+{
+	json_t *results_p = NULL;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, collection_s))
+		{
+			results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, opts_p);
+
+			if (!results_p)
+				{
+					PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Failed to get results from \"%s\"", collection_s);
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set collection to \"%s\"", collection_s);
+		}
+
+	return results_p;
+}
+
+
+static bool IsDeltaEntry (const json_t *entry_p)
+{
+	const char *type_s = GetJSONString (entry_p, S_REVISION_TYPE_S);
+
+	return (type_s && (strcmp (type_s, S_REVISION_DELTA_TYPE_S) == 0));
+}
+
+
+static size_t GetJSONSize (const json_t *json_p)
+{
+	size_t size = 0;
+	char *dump_s = json_dumps (json_p, JSON_COMPACT);
+
+	if (dump_s)
+		{
+			size = strlen (dump_s);
+			free (dump_s);
+		}
+
+	return size;
+}
+
+
+static json_t *GetJSONDelta (const json_t *from_p, const json_t *to_p)
+{
+	json_t *delta_p = NULL;
+
+	if (json_is_object (from_p) && json_is_object (to_p) && (!IsExtendedJSONValue (from_p)) && (!IsExtendedJSONValue (to_p)))
+		{
+			delta_p = GetJSONObjectDelta (from_p, to_p);
+		}
+	else if (json_is_array (from_p) && json_is_array (to_p))
+		{
+			delta_p = GetJSONArrayDelta (from_p, to_p);
+		}
+	else
+		{
+			delta_p = json_pack ("{s:O}", S_DELTA_VALUE_S, (json_t *) to_p);
+		}
+
+	return delta_p;
+}
+
+
+static json_t *GetJSONObjectDelta (const json_t *from_p, const json_t *to_p)
+{
+	json_t *delta_p = json_object ();
+
+	if (delta_p)
+		{
+			json_t *changes_p = json_object ();
+
+			if (changes_p)
+				{
+					json_t *deleted_p = json_array ();
+
+					if (deleted_p)
+						{
+							bool success_flag = true;
+							const char *key_s;
+							json_t *to_value_p;
+							json_t *from_value_p;
+
+							json_object_foreach ((json_t *) to_p, key_s, to_value_p)
+								{
+									if (success_flag)
+										{
+											from_value_p = json_object_get (from_p, key_s);
+
+											if ((!from_value_p) || (!json_equal (from_value_p, to_value_p)))
+												{
+													json_t *child_p = NULL;
+
+													if (from_value_p)
+														{
+															child_p = GetJSONDelta (from_value_p, to_value_p);
+														}
+													else
+														{
+															child_p = json_pack ("{s:O}", S_DELTA_VALUE_S, to_value_p);
+														}
+
+													if (! ((child_p) && (json_object_set_new (changes_p, key_s, child_p) == 0)))
+														{
+															success_flag = false;
+														}
+												}
+										}
+								}
+
+							json_object_foreach ((json_t *) from_p, key_s, from_value_p)
+								{
+									if (success_flag && (!json_object_get (to_p, key_s)))
+										{
+											if (json_array_append_new (deleted_p, json_string (key_s)) != 0)
+												{
+													success_flag = false;
+												}
+										}
+								}
+
+							if (success_flag && (json_object_size (changes_p) > 0))
+								{
+									success_flag = (json_object_set (delta_p, S_DELTA_OBJECT_S, changes_p) == 0);
+								}
+
+							if (success_flag && (json_array_size (deleted_p) > 0))
+								{
+									success_flag = (json_object_set (delta_p, S_DELTA_DELETED_S, deleted_p) == 0);
+								}
+
+							json_decref (deleted_p);
+							json_decref (changes_p);
+
+							if (success_flag)
+								{
+									return delta_p;
+								}
+						}
+					else
+						{
+							json_decref (changes_p);
+						}
+				}
+
+			json_decref (delta_p);
+		}
+
+	return NULL;
+}
+
+
+/*
+ * Arrays are compared entry by entry so that editing a single row
+ * of a Plot only stores the changes to that row.
+ */
+static json_t *GetJSONArrayDelta (const json_t *from_p, const json_t *to_p)
+{
+	json_t *delta_p = json_pack ("{s:I}", S_DELTA_LENGTH_S, (json_int_t) json_array_size (to_p));
+
+	if (delta_p)
+		{
+			json_t *changes_p = json_object ();
+
+			if (changes_p)
+				{
+					const size_t from_size = json_array_size (from_p);
+					const size_t to_size = json_array_size (to_p);
+					bool success_flag = true;
+					size_t i;
+
+					for (i = 0; (i < to_size) && success_flag; ++ i)
+						{
+							json_t *to_value_p = json_array_get (to_p, i);
+							json_t *child_p = NULL;
+							bool changed_flag = true;
+
+							if (i < from_size)
+								{
+									json_t *from_value_p = json_array_get (from_p, i);
+
+									if (json_equal (from_value_p, to_value_p))
+										{
+											changed_flag = false;
+										}
+									else
+										{
+											child_p = GetJSONDelta (from_value_p, to_value_p);
+										}
+								}
+							else
+								{
+									child_p = json_pack ("{s:O}", S_DELTA_VALUE_S, to_value_p);
+								}
+
+							if (changed_flag)
+								{
+									char index_s [32];
+
+									snprintf (index_s, sizeof (index_s), SIZET_FMT, i);
+
+									if (! ((child_p) && (json_object_set_new (changes_p, index_s, child_p) == 0)))
+										{
+											success_flag = false;
+										}
+								}
+						}
+
+					if (success_flag && (json_object_size (changes_p) > 0))
+						{
+							success_flag = (json_object_set (delta_p, S_DELTA_ARRAY_S, changes_p) == 0);
+						}
+
+					json_decref (changes_p);
+
+					if (success_flag)
+						{
+							return delta_p;
+						}
+				}
+
+			json_decref (delta_p);
+		}
+
+	return NULL;
+}
+
+
+static json_t *ApplyJSONDelta (const json_t *doc_p, const json_t *delta_p)
+{
+	json_t *result_p = json_deep_copy (doc_p);
+
+	if (result_p)
+		{
+			if (!ApplyJSONDeltaInPlace (&result_p, delta_p))
+				{
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, delta_p, "Failed to apply delta");
+
+					if (result_p)
+						{
+							json_decref (result_p);
+							result_p = NULL;
+						}
+				}
+		}
+
+	return result_p;
+}
+
+
+static bool ApplyJSONDeltaInPlace (json_t **value_pp, const json_t *delta_p)
+{
+	bool success_flag = false;
+	const json_t *value_p = json_object_get (delta_p, S_DELTA_VALUE_S);
+
+	if (value_p)
+		{
+			json_t *copied_value_p = json_deep_copy (value_p);
+
+			if (copied_value_p)
+				{
+					if (*value_pp)
+						{
+							json_decref (*value_pp);
+						}
+
+					*value_pp = copied_value_p;
+					success_flag = true;
+				}
+		}
+	else if (json_is_object (*value_pp))
+		{
+			const json_t *changes_p = json_object_get (delta_p, S_DELTA_OBJECT_S);
+			const json_t *deleted_p = json_object_get (delta_p, S_DELTA_DELETED_S);
+			const char *key_s;
+			json_t *child_delta_p;
+
+			success_flag = true;
+
+			json_object_foreach ((json_t *) changes_p, key_s, child_delta_p)
+				{
+					if (success_flag)
+						{
+							json_t *child_p = json_object_get (*value_pp, key_s);
+
+							if (child_p)
+								{
+									json_incref (child_p);
+								}
+
+							if (ApplyJSONDeltaInPlace (&child_p, child_delta_p))
+								{
+									success_flag = (json_object_set_new (*value_pp, key_s, child_p) == 0);
+								}
+							else
+								{
+									if (child_p)
+										{
+											json_decref (child_p);
+										}
+
+									success_flag = false;
+								}
+						}
+				}
+
+			if (success_flag && deleted_p)
+				{
+					size_t i;
+					json_t *deleted_key_p;
+
+					json_array_foreach (deleted_p, i, deleted_key_p)
+						{
+							json_object_del (*value_pp, json_string_value (deleted_key_p));
+						}
+				}
+		}
+	else if (json_is_array (*value_pp))
+		{
+			json_int_t length = 0;
+
+			if (GetJSONInteger (delta_p, S_DELTA_LENGTH_S, &length))
+				{
+					const json_t *changes_p = json_object_get (delta_p, S_DELTA_ARRAY_S);
+					size_t i;
+
+					success_flag = true;
+
+					/*
+					 * Any new entries are all at the end so going
+					 * through them in order appends them correctly
+					 */
+					for (i = 0; (i < (size_t) length) && success_flag; ++ i)
+						{
+							char index_s [32];
+							const json_t *child_delta_p = NULL;
+
+							snprintf (index_s, sizeof (index_s), SIZET_FMT, i);
+
+							child_delta_p = json_object_get (changes_p, index_s);
+
+							if (child_delta_p)
+								{
+									const size_t size = json_array_size (*value_pp);
+									json_t *child_p = NULL;
+
+									if (i < size)
+										{
+											child_p = json_incref (json_array_get (*value_pp, i));
+										}
+
+									if (ApplyJSONDeltaInPlace (&child_p, child_delta_p))
+										{
+											if (i < size)
+												{
+													success_flag = (json_array_set_new (*value_pp, i, child_p) == 0);
+												}
+											else
+												{
+													success_flag = (json_array_append_new (*value_pp, child_p) == 0);
+												}
+										}
+									else
+										{
+											if (child_p)
+												{
+													json_decref (child_p);
+												}
+
+											success_flag = false;
+										}
+								}
+						}
+
+					while (success_flag && (json_array_size (*value_pp) > (size_t) length))
+						{
+							success_flag = (json_array_remove (*value_pp, json_array_size (*value_pp) - 1) == 0);
+						}
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Values such as ids and dates are stored as objects with a single
+ * "$"-prefixed key and need to be treated as a single value rather
+ * than being diffed key by key.
+ */
+static bool IsExtendedJSONValue (const json_t *value_p)
+{
+	bool extended_flag = false;
+	void *iter_p = json_object_iter ((json_t *) value_p);
+
+	if (iter_p)
+		{
+			const char *key_s = json_object_iter_key (iter_p);
+
+			if (*key_s == '$')
+				{
+					extended_flag = true;
+				}
+		}
+
+	return extended_flag;
+}
@@ -68,6 +68,7 @@ bool InitRow (Row *row_p, bson_oid_t *id_p, const uint32 study_index, Plot *pare
 	row_p -> ro_by_study_index = study_index;
 	row_p -> ro_plot_p = parent_plot_p;
 	row_p -> ro_study_p = parent_plot_p -> pl_parent_p;
+	row_p -> ro_arena_p = NULL;
 
 	SetRowCallbackFunctions (row_p, clear_fn, add_to_json_fn, add_from_json_fn, add_to_fd_fn);
 
@@ -77,7 +78,7 @@ bool InitRow (Row *row_p, bson_oid_t *id_p, const uint32 study_index, Plot *pare
 
 void ClearRow (Row *row_p)
 {
-	FreeBSONOid (row_p -> ro_id_p);
+	FreeStudyBSONOid (row_p -> ro_arena_p, row_p -> ro_id_p);
 }
 
 
@@ -90,7 +91,7 @@ void FreeRow (Row *row_p)
 			row_p -> ro_clear_fn (row_p);
 		}
 
-	FreeMemory (row_p);
+	FreeStudyMemory (row_p -> ro_arena_p, row_p);
 }
 
 
@@ -297,9 +298,9 @@ Row *GetRowFromJSON (const json_t *row_json_p, Plot *plot_p, const Study *study_
 }
 
 
-static bson_oid_t *GetNamedBSONOidFromJSON (const json_t *json_p, const char *key_s)
+static bson_oid_t *GetNamedBSONOidFromJSON (const json_t *json_p, const char *key_s, StudyArena *arena_p)
 {
-	bson_oid_t *id_p = GetNewUnitialisedBSONOid ();
+	bson_oid_t *id_p = AllocStudyBSONOid (arena_p);
 
 	if (id_p)
 		{
@@ -312,7 +313,7 @@ static bson_oid_t *GetNamedBSONOidFromJSON (const json_t *json_p, const char *ke
 
 				}
 
-			FreeBSONOid (id_p);
+			FreeStudyBSONOid (arena_p, id_p);
 		}		/* if (id_p) */
 	else
 		{
@@ -349,7 +350,7 @@ bool PopulateRowFromJSON (Row *row_p, Plot *plot_p, const json_t *row_json_p, co
 {
 	if (!plot_p)
 		{
-			bson_oid_t *plot_id_p = GetNamedBSONOidFromJSON (row_json_p, RO_PLOT_ID_S);
+			bson_oid_t *plot_id_p = GetNamedBSONOidFromJSON (row_json_p, RO_PLOT_ID_S, NULL);
 
 			if (plot_id_p)
 				{
@@ -367,7 +368,7 @@ bool PopulateRowFromJSON (Row *row_p, Plot *plot_p, const json_t *row_json_p, co
 	if (plot_p)
 		{
 			RowType rt = RT_STANDARD;
-			bson_oid_t *id_p = GetNamedBSONOidFromJSON (row_json_p, MONGO_ID_S);
+			bson_oid_t *id_p = GetNamedBSONOidFromJSON (row_json_p, MONGO_ID_S, row_p -> ro_arena_p);
 
 			if (id_p)
 				{
@@ -390,7 +391,7 @@ bool PopulateRowFromJSON (Row *row_p, Plot *plot_p, const json_t *row_json_p, co
 							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, row_json_p, "Failed to get study index for row using \"%s\"", RO_STUDY_INDEX_S);
 						}
 
-					FreeBSONOid (id_p);
+					FreeStudyBSONOid (row_p -> ro_arena_p, id_p);
 				}		/* if (id_p) */
 			else
 				{
@@ -406,7 +407,7 @@ bool PopulateRowFromJSON (Row *row_p, Plot *plot_p, const json_t *row_json_p, co
 
 RowNode *AllocateRowNode (Row *row_p)
 {
-	RowNode *sr_node_p = (RowNode *) AllocMemory (sizeof (RowNode));
+	RowNode *sr_node_p = (RowNode *) AllocStudyMemory (row_p -> ro_arena_p, sizeof (RowNode));
 
 	if (sr_node_p)
 		{
@@ -423,13 +424,15 @@ RowNode *AllocateRowNode (Row *row_p)
 void FreeRowNode (ListItem *node_p)
 {
 	RowNode *sr_node_p = (RowNode *) node_p;
+	StudyArena *arena_p = NULL;
 
 	if (sr_node_p -> rn_row_p)
 		{
+			arena_p = sr_node_p -> rn_row_p -> ro_arena_p;
 			FreeRow (sr_node_p -> rn_row_p);
 		}
 
-	FreeMemory (sr_node_p);
+	FreeStudyMemory (arena_p, sr_node_p);
 }
 
 
@@ -63,6 +63,12 @@ typedef struct
 
 static void SetObservationError (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p);
 
+static OperationStatus AddTreatmentFactorLabelToStandardRow (StandardRow *row_p, TreatmentFactor *tf_p, const char *label_s);
+
+static bson_t *GetSingleRowProjection (const bson_oid_t *row_id_p);
+
+static Row *GetRowFromSingleRowPlotJSON (const json_t *plot_json_p, const bson_oid_t *row_id_p, const ViewFormat format, const FieldTrialServiceData *data_p);
+
 
 /*
  * API Definitions
@@ -469,7 +475,7 @@ OperationStatus AddObservationValueToStandardRow (StandardRow *row_p, const uint
 								
 
 
-							status = AddObservationValueToStandardRowByParts (job_p, row_p, measured_variable_p, metadata_p, key_s, raw_value_p,
+							status = AddObservationValueToStandardRowByParts (job_p, row_p, measured_variable_p, measured_variable_mem, metadata_p, key_s, raw_value_p,
 																																corrected_value_p, notes_s, &free_measured_variable_flag, SetObservationError, &error_obj);
 
 
@@ -519,7 +525,7 @@ OperationStatus AddObservationValueToStandardRow (StandardRow *row_p, const uint
 }
 
 
-OperationStatus AddObservationValueToStandardRowByParts (ServiceJob *job_p, StandardRow *row_p, MeasuredVariable *measured_variable_p, ObservationMetadata *metadata_p,
+OperationStatus AddObservationValueToStandardRowByParts (ServiceJob *job_p, StandardRow *row_p, MeasuredVariable *measured_variable_p, MEM_FLAG measured_variable_mem, ObservationMetadata *metadata_p,
 											const char *key_s, const json_t *raw_value_p, const json_t *corrected_value_p, const char *notes_s, bool *free_measured_variable_flag_p,
 											void (*on_error_callback_fn) (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p), void *user_data_p)
 {
@@ -668,7 +674,7 @@ OperationStatus AddObservationValueToStandardRowByParts (ServiceJob *job_p, Stan
 
 							if (obs_type != OT_NUM_TYPES)
 								{
-									observation_p = AllocateObservationWithErrorHandler (observation_id_p, metadata_p, measured_variable_p, MF_SHALLOW_COPY, raw_value_p,
+									observation_p = AllocateObservationWithErrorHandler (observation_id_p, metadata_p, measured_variable_p, measured_variable_mem, raw_value_p,
 																																			 corrected_value_p, growth_stage_s, method_s, instrument_p, nature,
 																																			 notes_s, obs_type, on_error_callback_fn, job_p, user_data_p);
 								}
@@ -1018,7 +1024,7 @@ OperationStatus AddSingleTreatmentFactorValueToStandardRow  (StandardRow *row_p,
 	Treatment *treatment_p = NULL;
 	bool cached_treatment_flag = false;
 
-	if (data_p -> dftsd_treatments_cache_p)
+	if (HasTreatmentCache (data_p))
 		{
 			treatment_p = GetCachedTreatmentByURL (data_p, name_s);
 		}
@@ -1029,7 +1035,7 @@ OperationStatus AddSingleTreatmentFactorValueToStandardRow  (StandardRow *row_p,
 
 			if (treatment_p)
 				{
-					if (data_p -> dftsd_treatments_cache_p)
+					if (HasTreatmentCache (data_p))
 						{
 							if (AddTreatmentToCache (data_p, treatment_p, MF_SHALLOW_COPY))
 								{
@@ -1053,21 +1059,7 @@ OperationStatus AddSingleTreatmentFactorValueToStandardRow  (StandardRow *row_p,
 
 			if (tf_p)
 				{
-					const char *value_s = GetTreatmentFactorValue (tf_p, name_s);
-
-					/* Is it a valid defined label? */
-					if (IsStringEmpty (value_s))
-						{
-							/* nothing to do */
-							status = OS_SUCCEEDED;
-						}
-					else
-						{
-							if (AddTreatmentFactorValueToRowByParts (row_p, tf_p, name_s))
-								{
-									status = OS_SUCCEEDED;
-								}
-						}
+					status = AddTreatmentFactorLabelToStandardRow (row_p, tf_p, name_s);
 
 					//FreeTreatmentFactor (tf_p);
 				}
@@ -1084,6 +1076,80 @@ OperationStatus AddSingleTreatmentFactorValueToStandardRow  (StandardRow *row_p,
 }
 
 
+OperationStatus AddPlotsTableValueToStandardRow (StandardRow *row_p, const uint32 row_index, const char *key_s, const json_t *value_p, PlotsTableSchema *schema_p, Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_IDLE;
+
+	/*
+	 * ignore our column names
+	 */
+	if ((strcmp (key_s, S_PLOT_INDEX_S) != 0) && (strcmp (key_s, S_RACK_S) != 0))
+		{
+			const char *value_s = json_string_value (value_p);
+
+			if (!IsStringEmpty (value_s))
+				{
+					const PlotsTableColumn *column_p = GetPlotsTableColumn (schema_p, key_s, study_p, job_p, data_p);
+
+					if (column_p)
+						{
+							switch (column_p -> ptc_type)
+								{
+									case PTCT_OBSERVATION:
+										{
+											bool free_measured_variable_flag = false;
+											const json_t *raw_value_p = NULL;
+											const json_t *corrected_value_p = NULL;
+											ObservationError error_obj;
+
+											error_obj.oe_row = row_index;
+											error_obj.oe_column_s = key_s;
+
+											if (column_p -> ptc_metadata_p -> om_corrected_flag)
+												{
+													corrected_value_p = value_p;
+												}
+											else
+												{
+													raw_value_p = value_p;
+												}
+
+											/*
+											 * The Measured Variable belongs to the column so the
+											 * Observation just borrows it
+											 */
+											status = AddObservationValueToStandardRowByParts (job_p, row_p, column_p -> ptc_measured_variable_p, MF_SHADOW_USE, column_p -> ptc_metadata_p, key_s,
+																																				raw_value_p, corrected_value_p, NULL, &free_measured_variable_flag, SetObservationError, &error_obj);
+										}
+										break;
+
+									case PTCT_TREATMENT_FACTOR:
+										status = AddTreatmentFactorLabelToStandardRow (row_p, column_p -> ptc_treatment_factor_p, value_s);
+										break;
+
+									default:
+										break;
+								}
+
+						}		/* if (column_p) */
+					else
+						{
+							status = OS_FAILED;
+						}
+
+				}		/* if (!IsStringEmpty (value_s)) */
+			else
+				{
+					PrintLog (STM_LEVEL_FINER, __FILE__, __LINE__, "Skipping empty value for \"%s\" on row " UINT32_FMT, key_s, row_index);
+					status = OS_SUCCEEDED;
+				}
+
+		}		/* if ((strcmp (key_s, S_PLOT_INDEX_S) != 0) && (strcmp (key_s, S_RACK_S) != 0)) */
+
+	return status;
+}
+
+
 void RemoveObservationNode (const StandardRow *row_p, ObservationNode *node_p)
 {
 	LinkedListRemove (row_p -> sr_observations_p, & (node_p -> on_node));
@@ -1340,27 +1406,42 @@ Row *GetRowByIdString (const char *row_id_s, const ViewFormat format, const Fiel
 
 			if (row_id_p)
 				{
-					Plot *parent_plot_p = GetDFWObjectByNamedIdString (row_id_s, DFTD_PLOT, row_key_s, GetPlotCallback, format, data_p);
-
-					if (parent_plot_p)
+					if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
 						{
-							RowNode *row_node_p = (RowNode *) (parent_plot_p -> pl_rows_p -> ll_head_p);
+							bson_t *query_p = BCON_NEW (row_key_s, BCON_OID (row_id_p));
 
-							while (row_node_p)
+							if (query_p)
 								{
-									Row *r_p = row_node_p -> rn_row_p;
+									bson_t *opts_p = GetSingleRowProjection (row_id_p);
 
-									if (bson_oid_equal (row_id_p, r_p -> ro_id_p))
+									if (opts_p)
 										{
-											found_row_p = r_p;
-											row_node_p = NULL;		/* force exit from loop */
-										}
-									else
-										{
-											row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
-										}
-								}
+											json_t *results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, opts_p);
+
+											if (results_p)
+												{
+													if (json_is_array (results_p) && (json_array_size (results_p) == 1))
+														{
+															found_row_p = GetRowFromSingleRowPlotJSON (json_array_get (results_p, 0), row_id_p, format, data_p);
+														}
+													else
+														{
+															PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, results_p, "Expected a single plot for row \"%s\"", row_id_s);
+														}
+
+													json_decref (results_p);
+												}		/* if (results_p) */
+
+											bson_destroy (opts_p);
+										}		/* if (opts_p) */
+
+									bson_destroy (query_p);
+								}		/* if (query_p) */
 
+						}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT])) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set mongo collection to \"%s\"", data_p -> dftsd_collection_ss [DFTD_PLOT]);
 						}
 
 					FreeBSONOid (row_id_p);
@@ -1374,6 +1455,119 @@ Row *GetRowByIdString (const char *row_id_s, const ViewFormat format, const Fiel
 }
 
 
+/*
+ * Get the projection for a Plot with just its own fields and the
+ * given Row rather than all of its Rows with their observations.
+ */
+static bson_t *GetSingleRowProjection (const bson_oid_t *row_id_p)
+{
+	/* The Plot fields that GetPlotFromJSON () reads */
+	const char *plot_keys_ss [] =
+		{
+			PL_PARENT_STUDY_S,
+			PL_ROW_INDEX_S,
+			PL_COLUMN_INDEX_S,
+			PL_SOWING_DATE_S,
+			PL_HARVEST_DATE_S,
+			PL_WIDTH_S,
+			PL_LENGTH_S,
+			PL_SOWING_ORDER_S,
+			PL_WALKING_ORDER_S,
+			PL_TREATMENT_S,
+			PL_COMMENT_S,
+			PL_IMAGE_S,
+			PL_THUMBNAIL_S,
+			NULL
+		};
+	bson_t *opts_p = bson_new ();
+
+	if (opts_p)
+		{
+			bson_t projection;
+
+			if (BSON_APPEND_DOCUMENT_BEGIN (opts_p, "projection", &projection))
+				{
+					const char **key_ss = plot_keys_ss;
+					bool success_flag = true;
+
+					while (success_flag && (*key_ss))
+						{
+							success_flag = BSON_APPEND_INT32 (&projection, *key_ss, 1);
+							++ key_ss;
+						}
+
+					if (success_flag)
+						{
+							bson_t rows_match;
+
+							success_flag = false;
+
+							/* Only return the matching Row */
+							if (BSON_APPEND_DOCUMENT_BEGIN (&projection, PL_ROWS_S, &rows_match))
+								{
+									bson_t row_id;
+
+									if (BSON_APPEND_DOCUMENT_BEGIN (&rows_match, "$elemMatch", &row_id))
+										{
+											if (BSON_APPEND_OID (&row_id, MONGO_ID_S, row_id_p))
+												{
+													success_flag = bson_append_document_end (&rows_match, &row_id);
+												}
+										}
+
+									success_flag = bson_append_document_end (&projection, &rows_match) && success_flag;
+								}
+						}
+
+					if (bson_append_document_end (opts_p, &projection) && success_flag)
+						{
+							return opts_p;
+						}
+				}
+
+			bson_destroy (opts_p);
+		}		/* if (opts_p) */
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create single row projection");
+
+	return NULL;
+}
+
+
+/*
+ * Get the Row from a Plot that was fetched with GetSingleRowProjection ().
+ * As the Plot only has the one Row, that is all that gets built along
+ * with its material and observations.
+ */
+static Row *GetRowFromSingleRowPlotJSON (const json_t *plot_json_p, const bson_oid_t *row_id_p, const ViewFormat format, const FieldTrialServiceData *data_p)
+{
+	Plot *plot_p = GetPlotFromJSON (plot_json_p, NULL, format, (FieldTrialServiceData *) data_p);
+
+	if (plot_p)
+		{
+			RowNode *row_node_p = (RowNode *) (plot_p -> pl_rows_p -> ll_head_p);
+
+			/* The Plot doesn't have all of its Rows so stop it from being saved as a whole */
+			plot_p -> pl_partial_rows_flag = true;
+
+			if (row_node_p && (bson_oid_equal (row_id_p, row_node_p -> rn_row_p -> ro_id_p)))
+				{
+					return row_node_p -> rn_row_p;
+				}
+
+			PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to get row from plot");
+
+			FreePlot (plot_p);
+		}		/* if (plot_p) */
+	else
+		{
+			PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, plot_json_p, "Failed to get plot");
+		}
+
+	return NULL;
+}
+
+
 
 
 static void SetObservationError (ServiceJob *job_p, const char * const observation_field_s, const void *value_p, void *user_data_p)
@@ -1400,6 +1594,29 @@ static void SetObservationError (ServiceJob *job_p, const char * const observati
 }
 
 
+static OperationStatus AddTreatmentFactorLabelToStandardRow (StandardRow *row_p, TreatmentFactor *tf_p, const char *label_s)
+{
+	OperationStatus status = OS_IDLE;
+	const char *value_s = GetTreatmentFactorValue (tf_p, label_s);
+
+	/* Is it a valid defined label? */
+	if (IsStringEmpty (value_s))
+		{
+			/* nothing to do */
+			status = OS_SUCCEEDED;
+		}
+	else
+		{
+			if (AddTreatmentFactorValueToRowByParts (row_p, tf_p, label_s))
+				{
+					status = OS_SUCCEEDED;
+				}
+		}
+
+	return status;
+}
+
+
 static void ReportJSONError (ServiceJob *job_p, const NamedParameterType *param_p, const char * const key_s, const json_t *value_p, const char * const message_s)
 {
 	bool done_error_message_flag = false;
@@ -0,0 +1,794 @@
+/*
+ * row_update.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <time.h>
+
+#include "row_update.h"
+#include "row_jobs.h"
+#include "plot.h"
+#include "study.h"
+#include "standard_row.h"
+#include "dfw_util.h"
+#include "revision_store.h"
+#include "material_usage.h"
+
+#include "mongodb_util.h"
+#include "time_util.h"
+#include "streams.h"
+#include "string_utils.h"
+
+
+static bool AddRowDifferences (const json_t *original_row_json_p, const json_t *row_json_p, json_t *set_p, json_t *unset_p, json_t *pushed_p, bool *observations_set_flag_p);
+
+static bool AddObservationDifferences (const json_t *original_observations_p, const json_t *observations_p, json_t *set_p, json_t *pushed_p, bool *observations_set_flag_p);
+
+static bool SetRowPathValue (json_t *doc_p, const char *key_s, const char *index_s, json_t *value_p);
+
+static bool RunRowUpdate (const Row *row_p, json_t *set_p, json_t *unset_p, json_t *pushed_p, const json_t *previous_plot_p, const FieldTrialServiceData *data_p);
+
+static bool RunRowReplacement (const Row *row_p, const json_t *row_json_p, const json_t *current_plot_p, const json_t *previous_plot_p, const FieldTrialServiceData *data_p);
+
+static bson_t *GetRowUpdateQuery (const Row *row_p, const json_t *previous_plot_p);
+
+static bool RunRowUpdateOperation (const bson_t *query_p, const bson_t *update_p, const FieldTrialServiceData *data_p);
+
+static json_t *GetPlotRevisionForRow (const Row *row_p, const json_t *row_json_p, const char *timestamp_s, json_t **previous_plot_pp, json_t **current_plot_pp, const FieldTrialServiceData *data_p);
+
+static bool HasMaterialChanged (const json_t *original_row_json_p, const json_t *row_json_p);
+
+static json_t *GetStoredPlot (const Row *row_p, const FieldTrialServiceData *data_p);
+
+static json_t *GetCachedRowEntry (json_t *study_json_p, const Row *row_p, size_t *index_p);
+
+static bool DoesJSONHaveId (const json_t *json_p, const bson_oid_t *id_p);
+
+
+
+bool SaveRowChanges (const Row *row_p, const json_t *original_row_json_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	json_t *row_json_p = GetRowAsJSON (row_p, VF_STORAGE, NULL, data_p);
+
+	if (row_json_p)
+		{
+			json_t *set_p = json_object ();
+
+			if (set_p)
+				{
+					json_t *unset_p = json_object ();
+
+					if (unset_p)
+						{
+							json_t *pushed_p = json_array ();
+
+							if (pushed_p)
+								{
+									bool observations_set_flag = false;
+
+									if (AddRowDifferences (original_row_json_p, row_json_p, set_p, unset_p, pushed_p, &observations_set_flag))
+										{
+											if ((json_object_size (set_p) == 0) && (json_object_size (unset_p) == 0) && (json_array_size (pushed_p) == 0))
+												{
+													/* Nothing has changed */
+													success_flag = true;
+												}
+											else
+												{
+													time_t now = time (NULL);
+													struct tm now_tm;
+													char *timestamp_s = NULL;
+
+													localtime_r (&now, &now_tm);
+													timestamp_s = GetTimeAsString (&now_tm, true, NULL);
+
+													if (timestamp_s)
+														{
+															json_t *previous_plot_p = NULL;
+															json_t *current_plot_p = NULL;
+
+															if (SetJSONString (set_p, MONGO_TIMESTAMP_S, timestamp_s))
+																{
+																	json_t *revision_p = GetPlotRevisionForRow (row_p, row_json_p, timestamp_s, &previous_plot_p, &current_plot_p, data_p);
+
+																	if (revision_p)
+																		{
+																			json_int_t revision_number;
+
+																			if ((GetJSONInteger (current_plot_p, RS_REVISION_NUMBER_S, &revision_number)) && (SetJSONInteger (set_p, RS_REVISION_NUMBER_S, revision_number)))
+																				{
+																					/*
+																					 * We can't $set an Observation and $push to the
+																					 * Observations array in the same update, so if
+																					 * we need to do both, the whole row is replaced
+																					 * instead.
+																					 */
+																					if (observations_set_flag && (json_array_size (pushed_p) > 0))
+																						{
+																							success_flag = RunRowReplacement (row_p, row_json_p, current_plot_p, previous_plot_p, data_p);
+																						}
+																					else
+																						{
+																							success_flag = RunRowUpdate (row_p, set_p, unset_p, pushed_p, previous_plot_p, data_p);
+																						}
+																				}
+
+																			/*
+																			 * The update only matches the Plot if it is still the
+																			 * version that the revision was made from, so the
+																			 * revision is only stored once the update has been made.
+																			 */
+																			if (success_flag)
+																				{
+																					if (!AddRevisionEntry (revision_p, DFTD_PLOT, data_p))
+																						{
+																							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Saved row " UINT32_FMT " in study \"%s\" but failed to store the previous version of its plot", row_p -> ro_by_study_index,
+																													row_p -> ro_study_p ? row_p -> ro_study_p -> st_name_s : "");
+																						}
+
+																					/*
+																					 * If the row's accession has changed, the
+																					 * material usage entries need updating
+																					 */
+																					if (HasMaterialChanged (original_row_json_p, row_json_p))
+																						{
+																							if (!UpdateMaterialUsageForPlot (current_plot_p, data_p))
+																								{
+																									PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, row_json_p, "Failed to update material usage for row");
+																								}
+																						}
+																				}
+
+																			json_decref (revision_p);
+																		}
+																	else
+																		{
+																			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create revision of plot for row " UINT32_FMT " in study \"%s\"", row_p -> ro_by_study_index,
+																									row_p -> ro_study_p ? row_p -> ro_study_p -> st_name_s : "");
+																		}
+																}
+
+															if (previous_plot_p)
+																{
+																	json_decref (previous_plot_p);
+																}
+
+															if (current_plot_p)
+																{
+																	json_decref (current_plot_p);
+																}
+
+															FreeCopiedString (timestamp_s);
+														}		/* if (timestamp_s) */
+
+												}
+
+										}		/* if (AddRowDifferences (original_row_json_p, row_json_p, set_p, unset_p, pushed_p, &observations_set_flag)) */
+
+									json_decref (pushed_p);
+								}		/* if (pushed_p) */
+
+							json_decref (unset_p);
+						}		/* if (unset_p) */
+
+					json_decref (set_p);
+				}		/* if (set_p) */
+
+			json_decref (row_json_p);
+		}		/* if (row_json_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GetRowAsJSON () failed for row " UINT32_FMT " in study \"%s\"", row_p -> ro_by_study_index,
+									row_p -> ro_study_p ? row_p -> ro_study_p -> st_name_s : "");
+		}
+
+	return success_flag;
+}
+
+
+bool UpdateCachedStudyRow (const Row *row_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	const Study *study_p = row_p -> ro_study_p;
+
+	if (study_p && (study_p -> st_id_p))
+		{
+			char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+			json_t *cached_study_json_p = NULL;
+
+			bson_oid_to_string (study_p -> st_id_p, id_s);
+
+			cached_study_json_p = GetCachedStudy (id_s, data_p);
+
+			if (cached_study_json_p)
+				{
+					/* The cached JSON is shared so we need our own copy to change */
+					json_t *study_json_p = json_deep_copy (cached_study_json_p);
+
+					if (study_json_p)
+						{
+							size_t index = 0;
+							json_t *rows_p = GetCachedRowEntry (study_json_p, row_p, &index);
+
+							if (rows_p)
+								{
+									/*
+									 * The cached Studies are stored in the full client format
+									 * which is the same as the one that the row is viewed with
+									 */
+									json_t *row_json_p = GetRowAsJSON (row_p, VF_CLIENT_FULL, NULL, data_p);
+
+									if (row_json_p)
+										{
+											if (json_array_set_new (rows_p, index, row_json_p) == 0)
+												{
+													success_flag = CacheStudy (id_s, study_json_p, data_p);
+												}
+										}
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to find row " UINT32_FMT " in cached study \"%s\"", row_p -> ro_by_study_index, study_p -> st_name_s);
+								}
+
+							json_decref (study_json_p);
+						}		/* if (study_json_p) */
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to copy cached study \"%s\"", study_p -> st_name_s);
+						}
+
+					json_decref (cached_study_json_p);
+				}		/* if (cached_study_json_p) */
+			else
+				{
+					/* Nothing to update */
+					success_flag = true;
+				}
+
+		}		/* if (study_p && (study_p -> st_id_p)) */
+
+	return success_flag;
+}
+
+
+static bool AddRowDifferences (const json_t *original_row_json_p, const json_t *row_json_p, json_t *set_p, json_t *unset_p, json_t *pushed_p, bool *observations_set_flag_p)
+{
+	bool success_flag = true;
+	const char *key_s;
+	json_t *value_p;
+
+	json_object_foreach ((json_t *) row_json_p, key_s, value_p)
+		{
+			const json_t *original_value_p = json_object_get (original_row_json_p, key_s);
+
+			if (success_flag)
+				{
+					if ((strcmp (key_s, SR_OBSERVATIONS_S) == 0) && (json_is_array (value_p)) && (json_is_array (original_value_p)) && (json_array_size (value_p) >= json_array_size (original_value_p)))
+						{
+							success_flag = AddObservationDifferences (original_value_p, value_p, set_p, pushed_p, observations_set_flag_p);
+						}
+					else if ((!original_value_p) || (!json_equal (original_value_p, value_p)))
+						{
+							success_flag = SetRowPathValue (set_p, key_s, NULL, value_p);
+
+							if (strcmp (key_s, SR_OBSERVATIONS_S) == 0)
+								{
+									*observations_set_flag_p = true;
+								}
+						}
+				}
+		}
+
+	/* Has anything been removed? */
+	json_object_foreach ((json_t *) original_row_json_p, key_s, value_p)
+		{
+			if (success_flag && (!json_object_get (row_json_p, key_s)))
+				{
+					json_t *empty_p = json_string ("");
+
+					if (empty_p)
+						{
+							success_flag = SetRowPathValue (unset_p, key_s, NULL, empty_p);
+							json_decref (empty_p);
+
+							if (strcmp (key_s, SR_OBSERVATIONS_S) == 0)
+								{
+									*observations_set_flag_p = true;
+								}
+						}
+					else
+						{
+							success_flag = false;
+						}
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Existing Observations are edited in place and new ones are
+ * appended so anything past the end of the original array is new.
+ */
+static bool AddObservationDifferences (const json_t *original_observations_p, const json_t *observations_p, json_t *set_p, json_t *pushed_p, bool *observations_set_flag_p)
+{
+	bool success_flag = true;
+	const size_t num_original = json_array_size (original_observations_p);
+	const size_t num_observations = json_array_size (observations_p);
+	size_t i;
+
+	for (i = 0; (i < num_original) && success_flag; ++ i)
+		{
+			json_t *observation_p = json_array_get (observations_p, i);
+
+			if (!json_equal (json_array_get (original_observations_p, i), observation_p))
+				{
+					char *index_s = ConvertSizeTToString (i);
+
+					if (index_s)
+						{
+							success_flag = SetRowPathValue (set_p, SR_OBSERVATIONS_S, index_s, observation_p);
+							*observations_set_flag_p = true;
+
+							FreeCopiedString (index_s);
+						}
+					else
+						{
+							success_flag = false;
+						}
+				}
+		}
+
+	for ( ; (i < num_observations) && success_flag; ++ i)
+		{
+			if (json_array_append (pushed_p, json_array_get (observations_p, i)) != 0)
+				{
+					success_flag = false;
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Use the positional operator so that the update applies to
+ * whichever entry of the rows array matched the query.
+ */
+static bool SetRowPathValue (json_t *doc_p, const char *key_s, const char *index_s, json_t *value_p)
+{
+	bool success_flag = false;
+	char *path_s = NULL;
+
+	if (index_s)
+		{
+			path_s = ConcatenateVarargsStrings (PL_ROWS_S, ".$.", key_s, ".", index_s, NULL);
+		}
+	else
+		{
+			path_s = ConcatenateVarargsStrings (PL_ROWS_S, ".$.", key_s, NULL);
+		}
+
+	if (path_s)
+		{
+			if (json_object_set (doc_p, path_s, value_p) == 0)
+				{
+					success_flag = true;
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add \"%s\" to update", path_s);
+				}
+
+			FreeCopiedString (path_s);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to make update path for \"%s\"", key_s);
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * The update only matches the row's Plot if it is still previous_plot_p.
+ */
+static bool RunRowUpdate (const Row *row_p, json_t *set_p, json_t *unset_p, json_t *pushed_p, const json_t *previous_plot_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	json_t *update_p = json_object ();
+
+	if (update_p)
+		{
+			bool added_flag = true;
+
+			if (json_object_size (set_p) > 0)
+				{
+					added_flag = (json_object_set (update_p, "$set", set_p) == 0);
+				}
+
+			if (added_flag && (json_object_size (unset_p) > 0))
+				{
+					added_flag = (json_object_set (update_p, "$unset", unset_p) == 0);
+				}
+
+			if (added_flag && (json_array_size (pushed_p) > 0))
+				{
+					char *path_s = ConcatenateVarargsStrings (PL_ROWS_S, ".$.", SR_OBSERVATIONS_S, NULL);
+
+					added_flag = false;
+
+					if (path_s)
+						{
+							json_t *push_p = json_pack ("{s:{s:O}}", path_s, "$each", pushed_p);
+
+							if (push_p)
+								{
+									if (json_object_set_new (update_p, "$push", push_p) == 0)
+										{
+											added_flag = true;
+										}
+									else
+										{
+											json_decref (push_p);
+										}
+								}
+
+							FreeCopiedString (path_s);
+						}
+				}
+
+			if (added_flag)
+				{
+					bson_t *query_p = GetRowUpdateQuery (row_p, previous_plot_p);
+
+					if (query_p)
+						{
+							bson_t *update_bson_p = ConvertJSONToBSON (update_p);
+
+							if (update_bson_p)
+								{
+									success_flag = RunRowUpdateOperation (query_p, update_bson_p, data_p);
+									bson_destroy (update_bson_p);
+								}
+							else
+								{
+									PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, update_p, "ConvertJSONToBSON () failed");
+								}
+
+							bson_destroy (query_p);
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to build update for row " UINT32_FMT, row_p -> ro_by_study_index);
+				}
+
+			json_decref (update_p);
+		}		/* if (update_p) */
+
+	return success_flag;
+}
+
+
+static bool RunRowUpdateOperation (const bson_t *query_p, const bson_t *update_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+		{
+			bson_t reply;
+			bson_error_t error;
+
+			if (mongoc_collection_update_one (data_p -> dftsd_mongo_p -> mt_collection_p, query_p, update_p, NULL, &reply, &error))
+				{
+					bson_iter_t iter;
+
+					if (bson_iter_init_find (&iter, &reply, "matchedCount") && (bson_iter_as_int64 (&iter) == 1))
+						{
+							success_flag = true;
+						}
+					else
+						{
+							PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, update_p, "Row update did not match a plot, it may have been changed by another request");
+						}
+				}
+			else
+				{
+					PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, update_p, "Row update failed: \"%s\"", error.message);
+				}
+
+			bson_destroy (&reply);
+		}		/* if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT])) */
+
+	return success_flag;
+}
+
+
+/*
+ * Replace the whole row, and set the Plot's timestamp and revision number,
+ * with a single pipeline update so that either all of it is applied or
+ * none of it is. The row is wrapped in $literal so that none of its values
+ * are treated as expressions.
+ */
+static bool RunRowReplacement (const Row *row_p, const json_t *row_json_p, const json_t *current_plot_p, const json_t *previous_plot_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	const char *timestamp_s = GetJSONString (current_plot_p, MONGO_TIMESTAMP_S);
+	json_int_t revision_number;
+
+	if (timestamp_s && (GetJSONInteger (current_plot_p, RS_REVISION_NUMBER_S, &revision_number)))
+		{
+			char *rows_s = ConcatenateVarargsStrings ("$", PL_ROWS_S, NULL);
+
+			if (rows_s)
+				{
+					char *row_id_s = ConcatenateVarargsStrings ("$$row.", MONGO_ID_S, NULL);
+
+					if (row_id_s)
+						{
+							bson_t *row_doc_p = ConvertJSONToBSON (row_json_p);
+
+							if (row_doc_p)
+								{
+									bson_t *pipeline_p = BCON_NEW ("0", "{",
+																										"$set", "{",
+																											PL_ROWS_S, "{",
+																												"$map", "{",
+																													"input", BCON_UTF8 (rows_s),
+																													"as", BCON_UTF8 ("row"),
+																													"in", "{",
+																														"$cond", "[",
+																															"{", "$eq", "[", BCON_UTF8 (row_id_s), BCON_OID (row_p -> ro_id_p), "]", "}",
+																															"{", "$literal", BCON_DOCUMENT (row_doc_p), "}",
+																															BCON_UTF8 ("$$row"),
+																														"]",
+																													"}",
+																												"}",
+																											"}",
+																											MONGO_TIMESTAMP_S, BCON_UTF8 (timestamp_s),
+																											RS_REVISION_NUMBER_S, BCON_INT64 (revision_number),
+																										"}",
+																									"}");
+
+									if (pipeline_p)
+										{
+											bson_t *query_p = GetRowUpdateQuery (row_p, previous_plot_p);
+
+											if (query_p)
+												{
+													success_flag = RunRowUpdateOperation (query_p, pipeline_p, data_p);
+													bson_destroy (query_p);
+												}
+
+											bson_destroy (pipeline_p);
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to build replacement for row " UINT32_FMT, row_p -> ro_by_study_index);
+										}
+
+									bson_destroy (row_doc_p);
+								}
+							else
+								{
+									PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, row_json_p, "ConvertJSONToBSON () failed");
+								}
+
+							FreeCopiedString (row_id_s);
+						}
+
+					FreeCopiedString (rows_s);
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Match the row within its Plot as long as the Plot is still previous_plot_p.
+ */
+static bson_t *GetRowUpdateQuery (const Row *row_p, const json_t *previous_plot_p)
+{
+	bson_t *query_p = NULL;
+	char *row_key_s = GetRowsNameKey ();
+
+	if (row_key_s)
+		{
+			query_p = BCON_NEW (MONGO_ID_S, BCON_OID (row_p -> ro_plot_p -> pl_id_p), row_key_s, BCON_OID (row_p -> ro_id_p));
+
+			if (query_p && (!AddRevisionConditionsToSelector (query_p, previous_plot_p)))
+				{
+					bson_destroy (query_p);
+					query_p = NULL;
+				}
+
+			FreeRowsNameKey (row_key_s);
+		}
+
+	return query_p;
+}
+
+
+/*
+ * Get the revision of the row's Plot in the same way as saving the whole
+ * Plot would. The new version of the Plot is the previous one with the row
+ * replaced and the new timestamp and revision number, which is what the
+ * update will store. Both versions are returned to the caller upon success.
+ */
+static json_t *GetPlotRevisionForRow (const Row *row_p, const json_t *row_json_p, const char *timestamp_s, json_t **previous_plot_pp, json_t **current_plot_pp, const FieldTrialServiceData *data_p)
+{
+	json_t *revision_p = NULL;
+	bool success_flag = false;
+	json_t *previous_plot_p = GetStoredPlot (row_p, data_p);
+
+	if (previous_plot_p)
+		{
+			json_t *current_plot_p = json_deep_copy (previous_plot_p);
+
+			if (current_plot_p)
+				{
+					json_t *rows_p = json_object_get (current_plot_p, PL_ROWS_S);
+					const size_t num_rows = json_array_size (rows_p);
+					size_t i;
+					bool replaced_flag = false;
+
+					for (i = 0; i < num_rows; ++ i)
+						{
+							if (DoesJSONHaveId (json_array_get (rows_p, i), row_p -> ro_id_p))
+								{
+									replaced_flag = (json_array_set (rows_p, i, (json_t *) row_json_p) == 0);
+									break;
+								}
+						}
+
+					if (replaced_flag)
+						{
+							if (SetJSONString (current_plot_p, MONGO_TIMESTAMP_S, timestamp_s))
+								{
+									revision_p = GetRevisionEntry (previous_plot_p, current_plot_p, data_p);
+									success_flag = (revision_p != NULL);
+								}
+						}
+					else
+						{
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, previous_plot_p, "Failed to find row " UINT32_FMT " in stored plot", row_p -> ro_by_study_index);
+						}
+
+					if (success_flag)
+						{
+							*current_plot_pp = current_plot_p;
+						}
+					else
+						{
+							json_decref (current_plot_p);
+						}
+				}		/* if (current_plot_p) */
+
+			if (success_flag)
+				{
+					*previous_plot_pp = previous_plot_p;
+				}
+			else
+				{
+					json_decref (previous_plot_p);
+				}
+		}		/* if (previous_plot_p) */
+
+	return revision_p;
+}
+
+
+static bool HasMaterialChanged (const json_t *original_row_json_p, const json_t *row_json_p)
+{
+	const json_t *original_material_p = json_object_get (original_row_json_p, SR_MATERIAL_ID_S);
+	const json_t *material_p = json_object_get (row_json_p, SR_MATERIAL_ID_S);
+
+	if (original_material_p && material_p)
+		{
+			return !json_equal (original_material_p, material_p);
+		}
+
+	return (original_material_p != material_p);
+}
+
+
+static json_t *GetStoredPlot (const Row *row_p, const FieldTrialServiceData *data_p)
+{
+	json_t *plot_json_p = NULL;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
+		{
+			bson_t *query_p = BCON_NEW (MONGO_ID_S, BCON_OID (row_p -> ro_plot_p -> pl_id_p));
+
+			if (query_p)
+				{
+					json_t *results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, NULL);
+
+					if (results_p)
+						{
+							if (json_array_size (results_p) == 1)
+								{
+									plot_json_p = json_incref (json_array_get (results_p, 0));
+								}
+							else
+								{
+									PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Found " SIZET_FMT " plots for row " UINT32_FMT, json_array_size (results_p), row_p -> ro_by_study_index);
+								}
+
+							json_decref (results_p);
+						}
+					else
+						{
+							PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Failed to get plot for row " UINT32_FMT, row_p -> ro_by_study_index);
+						}
+
+					bson_destroy (query_p);
+				}
+		}
+
+	return plot_json_p;
+}
+
+
+/*
+ * Find the rows array within the cached Study JSON that holds the given
+ * row along with the row's position within it.
+ */
+static json_t *GetCachedRowEntry (json_t *study_json_p, const Row *row_p, size_t *index_p)
+{
+	json_t *plots_p = json_object_get (study_json_p, ST_PLOTS_S);
+
+	if (json_is_array (plots_p))
+		{
+			const size_t num_plots = json_array_size (plots_p);
+			size_t i;
+
+			for (i = 0; i < num_plots; ++ i)
+				{
+					json_t *plot_json_p = json_array_get (plots_p, i);
+
+					if (DoesJSONHaveId (plot_json_p, row_p -> ro_plot_p -> pl_id_p))
+						{
+							json_t *rows_p = json_object_get (plot_json_p, PL_ROWS_S);
+							const size_t num_rows = json_array_size (rows_p);
+							size_t j;
+
+							for (j = 0; j < num_rows; ++ j)
+								{
+									if (DoesJSONHaveId (json_array_get (rows_p, j), row_p -> ro_id_p))
+										{
+											*index_p = j;
+											return rows_p;
+										}
+								}
+
+							/* The row isn't in the plot that it should be */
+							return NULL;
+						}
+				}
+		}
+
+	return NULL;
+}
+
+
+static bool DoesJSONHaveId (const json_t *json_p, const bson_oid_t *id_p)
+{
+	bool match_flag = false;
+	bson_oid_t json_id;
+
+	if (GetMongoIdFromJSON (json_p, &json_id))
+		{
+			match_flag = bson_oid_equal (&json_id, id_p);
+		}
+
+	return match_flag;
+}
@@ -20,6 +20,8 @@
  *      Author: billy
  */
 
+#include <string.h>
+
 #include "search_service.h"
 #include "plot_jobs.h"
 #include "field_trial_jobs.h"
@@ -55,6 +57,7 @@ static NamedParameterType S_KEYWORD = { "FT Keyword Search", PT_KEYWORD };
 static NamedParameterType S_FACET = { "FT Facet", PT_STRING };
 static NamedParameterType S_PAGE_NUMBER = { "FT Results Page Number", PT_UNSIGNED_INT };
 static NamedParameterType S_PAGE_SIZE = { "FT Results Page Size", PT_UNSIGNED_INT };
+static NamedParameterType S_FULL_RESULTS = { "FT Full Results", PT_BOOLEAN };
 
 static NamedParameterType S_FACET_STUDY = { "FT Study Facet", PT_BOOLEAN };
 static NamedParameterType S_FACET_FIELD_TRIAL = { "FT Trial Facet", PT_BOOLEAN };
@@ -115,14 +118,49 @@ static bool AddFacetParameterToList (const char *name_s, const char *value_s, Pa
 static LinkedList *GetFacets (ParameterSet *params_p);
 
 
-typedef struct
+/*
+ * A single hit from the Lucene results
+ */
+typedef struct SearchHitNode
+{
+	ListItem shn_node;
+
+	FieldTrialDatatype shn_datatype;
+
+	char shn_id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+	/*
+	 * The stored document for this hit. This is owned by the
+	 * array of query results that it was found in.
+	 */
+	const json_t *shn_document_p;
+
+} SearchHitNode;
+
+
+typedef struct SearchData
 {
 	FieldTrialServiceData *sd_service_data_p;
 	ServiceJob *sd_job_p;
 	ViewFormat sd_format;
+
+	/*
+	 * The SearchHitNodes for the current page of
+	 * results in the order that Lucene ranked them.
+	 */
+	LinkedList *sd_hits_p;
 } SearchData;
 
 
+static OperationStatus AddSearchHitsToServiceJob (SearchData *search_data_p);
+
+static bool GetSearchHitDocuments (SearchData *search_data_p, const FieldTrialDatatype datatype, json_t *documents_p);
+
+static bool SetSearchHitDocuments (SearchData *search_data_p, const FieldTrialDatatype datatype, const json_t *results_p);
+
+static bool AddSearchHitToServiceJob (const SearchHitNode *hit_p, SearchData *search_data_p);
+
+
 /*
  * API definitions
  */
@@ -289,6 +327,13 @@ static ParameterSet *GetDFWFieldTrialSearchServiceParameters (Service *service_p
 
 									if ((param_p = EasyCreateAndAddUnsignedIntParameterToParameterSet (& (data_p -> dftsd_base_data), params_p, group_p, S_PAGE_SIZE.npt_name_s, "Page size", "The maximum number of results on each page", &def, PL_SIMPLE)) != NULL)
 										{
+											bool full_results_flag = false;
+
+											if ((param_p = EasyCreateAndAddBooleanParameterToParameterSet (& (data_p -> dftsd_base_data), params_p, group_p, S_FULL_RESULTS.npt_name_s, "Full results", "Get the full details of each result rather than a summary", &full_results_flag, PL_ALL)) == NULL)
+												{
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add %s parameter", S_FULL_RESULTS.npt_name_s);
+												}
+
 											if (AddSearchFieldTrialParams (& (data_p -> dftsd_base_data), params_p))
 												{
 													if (AddSearchStudyParams (& (data_p -> dftsd_base_data), params_p))
@@ -373,6 +418,7 @@ static bool GetDFWFieldTrialSearchServiceParameterTypesForNamedParameters (const
 			S_FACET,
 			S_PAGE_NUMBER,
 			S_PAGE_SIZE,
+			S_FULL_RESULTS,
 			S_FACET_STUDY,
 			S_FACET_FIELD_TRIAL,
 			S_FACET_LOCATION,
@@ -518,13 +564,26 @@ static ServiceJobSet *RunDFWFieldTrialSearchService (Service *service_p, Paramet
 									const char *keyword_s = NULL;
 									const uint32 *page_number_p = NULL;
 									const uint32 *page_size_p = NULL;
+									const bool *full_results_flag_p = NULL;
+									ViewFormat format = VF_CLIENT_MINIMAL;
 
 									GetCurrentStringParameterValueFromParameterSet (param_set_p, S_KEYWORD.npt_name_s, &keyword_s);
 
 									GetCurrentUnsignedIntParameterValueFromParameterSet (param_set_p, S_PAGE_NUMBER.npt_name_s, &page_number_p);
 									GetCurrentUnsignedIntParameterValueFromParameterSet (param_set_p, S_PAGE_SIZE.npt_name_s, &page_size_p);
 
-									SearchFieldTrialsForKeyword (keyword_s, facets_p, page_number_p ? *page_number_p : S_DEFAULT_PAGE_NUMBER, page_size_p ? *page_size_p : S_DEFAULT_PAGE_SIZE, job_p, VF_CLIENT_MINIMAL, data_p);
+									/*
+									 * By default we only return summaries of each result
+									 */
+									if (GetCurrentBooleanParameterValueFromParameterSet (param_set_p, S_FULL_RESULTS.npt_name_s, &full_results_flag_p))
+										{
+											if ((full_results_flag_p != NULL) && (*full_results_flag_p == true))
+												{
+													format = VF_CLIENT_FULL;
+												}
+										}
+
+									SearchFieldTrialsForKeyword (keyword_s, facets_p, page_number_p ? *page_number_p : S_DEFAULT_PAGE_NUMBER, page_size_p ? *page_size_p : S_DEFAULT_PAGE_SIZE, job_p, format, data_p);
 
 									FreeLinkedList (facets_p);
 								}
@@ -820,8 +879,32 @@ static void SearchFieldTrialsForKeyword (const char *keyword_s, LinkedList *face
 									sd.sd_service_data_p = data_p;
 									sd.sd_job_p = job_p;
 									sd.sd_format = fmt;
+									sd.sd_hits_p = AllocateLinkedList (FreeListItem);
+
+									if (sd.sd_hits_p)
+										{
+											status = ParseLuceneResults (lucene_p, from, to, AddFieldTrialResultsFromLuceneResults, &sd);
+
+											if ((status == OS_SUCCEEDED) || (status == OS_PARTIALLY_SUCCEEDED))
+												{
+													/*
+													 * Now we have all of the hits for this page, get their
+													 * documents and add them to the results
+													 */
+													OperationStatus hits_status = AddSearchHitsToServiceJob (&sd);
 
-									status = ParseLuceneResults (lucene_p, from, to, AddFieldTrialResultsFromLuceneResults, &sd);
+													if ((status == OS_SUCCEEDED) || (hits_status == OS_FAILED))
+														{
+															status = hits_status;
+														}
+												}
+
+											FreeLinkedList (sd.sd_hits_p);
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate search hits list for \"%s\"", keyword_s);
+										}
 
 									if ((status == OS_SUCCEEDED) || (status == OS_PARTIALLY_SUCCEEDED))
 										{
@@ -912,131 +995,410 @@ static bool AddFieldTrialResultsFromLuceneResults (const json_t *document_p, con
 					switch (datatype)
 						{
 							case DFTD_FIELD_TRIAL:
-//								success_flag = FindAndAddResultToServiceJob (id_s, search_data_p -> sd_format, search_data_p -> sd_job_p, NULL, GetFieldTrialJSONForId, search_data_p -> sd_service_data_p);
+							case DFTD_STUDY:
+							case DFTD_MEASURED_VARIABLE:
+							case DFTD_LOCATION:
+							case DFTD_PROGRAMME:
+							case DFTD_TREATMENT:
 								{
-									FieldTrial *trial_p = GetFieldTrialByIdString (id_s, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
-
-									if (trial_p)
+									/*
+									 * Just store the hit for now so that we can get all
+									 * of the documents of each type with a single query
+									 */
+									if (strlen (id_s) < MONGO_OID_STRING_BUFFER_SIZE)
 										{
-											if (AddFieldTrialToServiceJob (search_data_p -> sd_job_p, trial_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p))
+											SearchHitNode *node_p = (SearchHitNode *) AllocMemory (sizeof (SearchHitNode));
+
+											if (node_p)
 												{
+													InitListItem (& (node_p -> shn_node));
+													node_p -> shn_datatype = datatype;
+													strcpy (node_p -> shn_id_s, id_s);
+													node_p -> shn_document_p = NULL;
+
+													LinkedListAddTail (search_data_p -> sd_hits_p, & (node_p -> shn_node));
 													success_flag = true;
 												}
 											else
 												{
-													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add field trial %s to ServiceJob", trial_p -> ft_name_s);
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate search hit for \"%s\"", id_s);
 												}
-
-											FreeFieldTrial (trial_p);
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "\"%s\" is not a valid id", id_s);
 										}
 								}
 								break;
 
-							case DFTD_STUDY:
-								success_flag = FindAndAddResultToServiceJob (id_s, search_data_p -> sd_format, search_data_p -> sd_job_p, NULL, GetStudyJSONForId, DFTD_STUDY, search_data_p -> sd_service_data_p);
+							default:
 								break;
 
-							case DFTD_MEASURED_VARIABLE:
+						}		/* switch (datatype) */
+
+				}		/* if (type_s) */
+
+		}		/* if (id_s) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get \"_id\" from document");
+		}
+
+	return success_flag;
+}
+
+
+static OperationStatus AddSearchHitsToServiceJob (SearchData *search_data_p)
+{
+	OperationStatus status = OS_FAILED;
+
+	/*
+	 * This holds the query results that the hits' documents
+	 * point into until they have all been added.
+	 */
+	json_t *documents_p = json_array ();
+
+	if (documents_p)
+		{
+			const FieldTrialDatatype datatypes [] = { DFTD_FIELD_TRIAL, DFTD_STUDY, DFTD_MEASURED_VARIABLE, DFTD_LOCATION, DFTD_PROGRAMME, DFTD_TREATMENT };
+			const size_t num_datatypes = sizeof (datatypes) / sizeof (datatypes [0]);
+			const size_t num_hits = search_data_p -> sd_hits_p -> ll_size;
+			SearchHitNode *node_p = (SearchHitNode *) (search_data_p -> sd_hits_p -> ll_head_p);
+			size_t num_added = 0;
+			size_t i;
+
+			for (i = 0; i < num_datatypes; ++ i)
+				{
+					if (!GetSearchHitDocuments (search_data_p, datatypes [i], documents_p))
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get documents for %s search hits", GetDatatypeAsString (datatypes [i]));
+						}
+				}
+
+			/*
+			 * Add the results in the order that Lucene ranked them
+			 */
+			while (node_p)
+				{
+					if (AddSearchHitToServiceJob (node_p, search_data_p))
+						{
+							++ num_added;
+						}
+
+					node_p = (SearchHitNode *) (node_p -> shn_node.ln_next_p);
+				}
+
+			if (num_added == num_hits)
+				{
+					status = OS_SUCCEEDED;
+				}
+			else if (num_added > 0)
+				{
+					status = OS_PARTIALLY_SUCCEEDED;
+				}
+
+			json_decref (documents_p);
+		}		/* if (documents_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate search hit documents array");
+		}
+
+	return status;
+}
+
+
+static bool GetSearchHitDocuments (SearchData *search_data_p, const FieldTrialDatatype datatype, json_t *documents_p)
+{
+	bool success_flag = true;
+	size_t num_ids = 0;
+	SearchHitNode *node_p = (SearchHitNode *) (search_data_p -> sd_hits_p -> ll_head_p);
+
+	/*
+	 * Full studies come from the study cache where possible,
+	 * so there is no need to get their documents
+	 */
+	if (! ((datatype == DFTD_STUDY) && (search_data_p -> sd_format == VF_CLIENT_FULL)))
+		{
+			while (node_p)
+				{
+					if (node_p -> shn_datatype == datatype)
+						{
+							++ num_ids;
+						}
+
+					node_p = (SearchHitNode *) (node_p -> shn_node.ln_next_p);
+				}
+		}
+
+	if (num_ids > 0)
+		{
+			const char **ids_ss = (const char **) AllocMemoryArray (num_ids, sizeof (const char *));
+
+			success_flag = false;
+
+			if (ids_ss)
+				{
+					const char **id_ss = ids_ss;
+					json_t *results_p = NULL;
+
+					node_p = (SearchHitNode *) (search_data_p -> sd_hits_p -> ll_head_p);
+
+					while (node_p)
+						{
+							if (node_p -> shn_datatype == datatype)
+								{
+									*id_ss = node_p -> shn_id_s;
+									++ id_ss;
+								}
+
+							node_p = (SearchHitNode *) (node_p -> shn_node.ln_next_p);
+						}
+
+					results_p = GetDFWObjectsJSONByIdStrings (ids_ss, num_ids, datatype, search_data_p -> sd_service_data_p);
+
+					if (results_p)
+						{
+							if (json_array_append_new (documents_p, results_p) == 0)
+								{
+									success_flag = SetSearchHitDocuments (search_data_p, datatype, results_p);
+								}
+							else
+								{
+									json_decref (results_p);
+								}
+						}
+
+					FreeMemory (ids_ss);
+				}		/* if (ids_ss) */
+
+		}		/* if (num_ids > 0) */
+
+	return success_flag;
+}
+
+
+static bool SetSearchHitDocuments (SearchData *search_data_p, const FieldTrialDatatype datatype, const json_t *results_p)
+{
+	bool success_flag = false;
+	const size_t num_results = json_array_size (results_p);
+
+	if (num_results > 0)
+		{
+			/*
+			 * The table's keys point into this buffer
+			 */
+			char *result_ids_s = (char *) AllocMemoryArray (num_results, MONGO_OID_STRING_BUFFER_SIZE);
+
+			if (result_ids_s)
+				{
+					HashTable *results_table_p = GetHashTableOfStringPointers (num_results * 2, 75);
+
+					if (results_table_p)
+						{
+							SearchHitNode *node_p = (SearchHitNode *) (search_data_p -> sd_hits_p -> ll_head_p);
+							char *result_id_s = result_ids_s;
+							size_t i;
+							const json_t *result_p;
+
+							json_array_foreach (results_p, i, result_p)
 								{
-									MeasuredVariable *mv_p = GetMeasuredVariableByIdString (id_s, search_data_p -> sd_service_data_p);
+									bson_oid_t oid;
 
-									if (mv_p)
+									if (GetMongoIdFromJSON (result_p, &oid))
 										{
-											if (AddMeasuredVariableToServiceJob (search_data_p -> sd_job_p, mv_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p))
-												{
-													success_flag = true;
-												}
-											else
+											bson_oid_to_string (&oid, result_id_s);
+
+											if (!PutInHashTable (results_table_p, result_id_s, result_p))
 												{
-													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add MeasuredVariable %s to ServiceJob", mv_p -> mv_variable_term_p -> st_name_s);
+													PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add \"%s\" to search hits table", result_id_s);
 												}
+										}
+									else
+										{
+											PrintJSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, result_p, "Failed to get id from search hit document");
+										}
+
+									result_id_s += MONGO_OID_STRING_BUFFER_SIZE;
+								}
 
-											FreeMeasuredVariable (mv_p);
+							while (node_p)
+								{
+									if (node_p -> shn_datatype == datatype)
+										{
+											node_p -> shn_document_p = (const json_t *) GetFromHashTable (results_table_p, node_p -> shn_id_s);
 										}
+
+									node_p = (SearchHitNode *) (node_p -> shn_node.ln_next_p);
 								}
-							break;
 
-							case DFTD_LOCATION:
+							success_flag = true;
+							FreeHashTable (results_table_p);
+						}		/* if (results_table_p) */
+
+					FreeMemory (result_ids_s);
+				}		/* if (result_ids_s) */
+
+		}		/* if (num_results > 0) */
+	else
+		{
+			success_flag = true;
+		}
+
+	return success_flag;
+}
+
+
+static bool AddSearchHitToServiceJob (const SearchHitNode *hit_p, SearchData *search_data_p)
+{
+	bool success_flag = false;
+	const json_t *doc_p = hit_p -> shn_document_p;
+	const char *id_s = hit_p -> shn_id_s;
+
+	if ((hit_p -> shn_datatype == DFTD_STUDY) && (search_data_p -> sd_format == VF_CLIENT_FULL))
+		{
+			success_flag = FindAndAddResultToServiceJob (id_s, search_data_p -> sd_format, search_data_p -> sd_job_p, NULL, GetStudyJSONForId, DFTD_STUDY, search_data_p -> sd_service_data_p);
+		}
+	else if (!doc_p)
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "No stored %s found for search hit \"%s\"", GetDatatypeAsString (hit_p -> shn_datatype), id_s);
+		}
+	else
+		{
+			switch (hit_p -> shn_datatype)
+				{
+					case DFTD_FIELD_TRIAL:
+						{
+							FieldTrial *trial_p = GetFieldTrialFromJSON (doc_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
+
+							if (trial_p)
+								{
+									if (AddFieldTrialToServiceJob (search_data_p -> sd_job_p, trial_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p))
+										{
+											success_flag = true;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add field trial %s to ServiceJob", trial_p -> ft_name_s);
+										}
+
+									FreeFieldTrial (trial_p);
+								}
+						}
+						break;
+
+					case DFTD_STUDY:
+						{
+							Study *study_p = GetStudyFromJSON (doc_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
+
+							if (study_p)
 								{
-									Location *location_p = GetLocationByIdString (id_s, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
+									if (AddStudyToServiceJob (search_data_p -> sd_job_p, study_p, search_data_p -> sd_format, NULL, search_data_p -> sd_service_data_p))
+										{
+											success_flag = true;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add study %s to ServiceJob", study_p -> st_name_s);
+										}
+
+									FreeStudy (study_p);
+								}
+						}
+						break;
+
+					case DFTD_MEASURED_VARIABLE:
+						{
+							MeasuredVariable *mv_p = GetMeasuredVariableFromJSON (doc_p, search_data_p -> sd_service_data_p);
+
+							if (mv_p)
+								{
+									if (AddMeasuredVariableToServiceJob (search_data_p -> sd_job_p, mv_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p))
+										{
+											success_flag = true;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add MeasuredVariable %s to ServiceJob", mv_p -> mv_variable_term_p -> st_name_s);
+										}
+
+									FreeMeasuredVariable (mv_p);
+								}
+						}
+						break;
 
-									if (location_p)
+					case DFTD_LOCATION:
+						{
+							Location *location_p = GetLocationFromJSON (doc_p, search_data_p -> sd_service_data_p);
+
+							if (location_p)
+								{
+									if (AddLocationToServiceJob (search_data_p -> sd_job_p, location_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p))
+										{
+											success_flag = true;
+										}
+									else
 										{
-											if (AddLocationToServiceJob (search_data_p -> sd_job_p, location_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p))
+											const char *name_s = "";
+
+											if (location_p -> lo_address_p)
 												{
-													success_flag = true;
+													name_s = location_p -> lo_address_p -> ad_name_s;
 												}
-											else
-												{
-													const char *name_s = "";
 
-													if (location_p -> lo_address_p)
-														{
-															name_s = location_p -> lo_address_p -> ad_name_s;
-														}
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Location %s to ServiceJob", name_s);
+										}
 
-													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Location %s to ServiceJob", name_s);
-												}
+									FreeLocation (location_p);
+								}
+						}
+						break;
 
-											FreeLocation (location_p);
+					case DFTD_PROGRAMME:
+						{
+							Programme *program_p = GetProgrammeFromJSON (doc_p, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
+
+							if (program_p)
+								{
+									if (AddProgrammeToServiceJob (search_data_p -> sd_job_p, program_p, VF_CLIENT_FULL, search_data_p -> sd_service_data_p))
+										{
+											success_flag = true;
 										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Programme %s to ServiceJob", program_p -> pr_name_s);
+										}
+
+									FreeProgramme (program_p);
 								}
-							break;
-
-						case DFTD_PROGRAMME:
-							{
-								Programme *program_p = GetProgrammeByIdString (id_s, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
-
-								if (program_p)
-									{
-										if (AddProgrammeToServiceJob (search_data_p -> sd_job_p, program_p, VF_CLIENT_FULL, search_data_p -> sd_service_data_p))
-											{
-												success_flag = true;
-											}
-										else
-											{
-												PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Programme %s to ServiceJob", program_p -> pr_name_s);
-											}
-
-										FreeProgramme (program_p);
-									}
-							}
-							break;
-
-						case DFTD_TREATMENT:
-							{
-								Treatment *treatment_p = GetTreatmentByIdString (id_s, search_data_p -> sd_format, search_data_p -> sd_service_data_p);
-
-								if (treatment_p)
-									{
-										if (AddTreatmentToServiceJob (search_data_p -> sd_job_p, treatment_p, VF_CLIENT_FULL, search_data_p -> sd_service_data_p))
-											{
-												success_flag = true;
-											}
-										else
-											{
-												PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Treatment %s to ServiceJob", treatment_p -> tr_ontology_term_p -> st_name_s);
-											}
-
-										FreeTreatment (treatment_p);
-									}
-							}
-							break;
-
-
-						default:
-							break;
+						}
+						break;
 
-						}		/* switch (datatype) */
+					case DFTD_TREATMENT:
+						{
+							Treatment *treatment_p = GetTreatmentFromJSON (doc_p);
 
-				}		/* if (type_s) */
+							if (treatment_p)
+								{
+									if (AddTreatmentToServiceJob (search_data_p -> sd_job_p, treatment_p, VF_CLIENT_FULL, search_data_p -> sd_service_data_p))
+										{
+											success_flag = true;
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Treatment %s to ServiceJob", treatment_p -> tr_ontology_term_p -> st_name_s);
+										}
 
-		}		/* if (id_s) */
-	else
-		{
-			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get \"_id\" from document");
+									FreeTreatment (treatment_p);
+								}
+						}
+						break;
+
+					default:
+						break;
+
+				}		/* switch (hit_p -> shn_datatype) */
 		}
 
 	return success_flag;
 }
-
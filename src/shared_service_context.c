@@ -0,0 +1,974 @@
+/*
+ * shared_service_context.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <string.h>
+
+#include "shared_service_context.h"
+
+#include "measured_variable.h"
+#include "option_list_cache.h"
+#include "treatment.h"
+
+#include "memory_allocations.h"
+#include "streams.h"
+#include "string_hash_table.h"
+#include "string_utils.h"
+
+
+/**
+ * A MongoTool that is waiting to be reused.
+ */
+typedef struct MongoToolNode
+{
+	ListItem mtn_node;
+
+	MongoTool *mtn_tool_p;
+
+} MongoToolNode;
+
+
+/**
+ * A batch of entries that have been removed from one of the caches.
+ */
+typedef struct RetiredCacheEntries
+{
+	ListItem rce_node;
+
+	/** The epoch that the entries were removed in. */
+	uint32 rce_epoch;
+
+	/** The MeasuredVariableNodes or TreatmentNodes that were removed. */
+	LinkedList *rce_entries_p;
+
+} RetiredCacheEntries;
+
+
+/*
+ * Keep enough idle MongoTools for the short-lived services, such as
+ * the post-save and reindexing workers, without holding on to
+ * every connection that has ever been used.
+ */
+static const uint32 S_MAX_IDLE_MONGO_TOOLS = 8;
+
+
+static pthread_mutex_t s_contexts_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static LinkedList *s_contexts_p = NULL;
+
+
+static SharedServiceContext *AllocateSharedServiceContext (const char *database_s, GrassrootsServer *grassroots_p);
+
+static void FreeSharedServiceContext (SharedServiceContext *context_p);
+
+static void FreeSharedServiceContextNode (ListItem *node_p);
+
+static MongoToolNode *AllocateMongoToolNode (MongoTool *tool_p);
+
+static void FreeMongoToolNode (ListItem *node_p);
+
+static bool AllocateMeasuredVariablesTables (SharedServiceContext *context_p);
+
+static void FreeMeasuredVariablesTables (SharedServiceContext *context_p);
+
+static void ClearMeasuredVariablesCacheLocked (SharedServiceContext *context_p);
+
+static void RetireCacheEntries (SharedServiceContext *context_p, LinkedList *entries_p);
+
+static void ReclaimRetiredCacheEntries (SharedServiceContext *context_p);
+
+static void FreeRetiredCacheEntriesNode (ListItem *node_p);
+
+static void FreeSharedServiceContextPinNode (ListItem *node_p);
+
+
+
+SharedServiceContext *AcquireSharedServiceContext (const char *database_s, GrassrootsServer *grassroots_p)
+{
+	SharedServiceContext *context_p = NULL;
+
+	pthread_mutex_lock (&s_contexts_mutex);
+
+	if (!s_contexts_p)
+		{
+			s_contexts_p = AllocateLinkedList (FreeSharedServiceContextNode);
+		}
+
+	if (s_contexts_p)
+		{
+			SharedServiceContext *node_p = (SharedServiceContext *) (s_contexts_p -> ll_head_p);
+
+			while (node_p && !context_p)
+				{
+					if ((node_p -> ssc_grassroots_p == grassroots_p) && (strcmp (node_p -> ssc_database_s, database_s) == 0))
+						{
+							context_p = node_p;
+						}
+					else
+						{
+							node_p = (SharedServiceContext *) (node_p -> ssc_node.ln_next_p);
+						}
+				}
+
+			if (!context_p)
+				{
+					context_p = AllocateSharedServiceContext (database_s, grassroots_p);
+
+					if (context_p)
+						{
+							LinkedListAddTail (s_contexts_p, & (context_p -> ssc_node));
+						}
+				}
+
+			if (context_p)
+				{
+					++ (context_p -> ssc_ref_count);
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate list of shared service contexts");
+		}
+
+	pthread_mutex_unlock (&s_contexts_mutex);
+
+	return context_p;
+}
+
+
+void ReleaseSharedServiceContext (SharedServiceContext *context_p)
+{
+	pthread_mutex_lock (&s_contexts_mutex);
+
+	if (context_p -> ssc_ref_count > 0)
+		{
+			-- (context_p -> ssc_ref_count);
+		}
+
+	if (context_p -> ssc_ref_count == 0)
+		{
+			LinkedListRemove (s_contexts_p, & (context_p -> ssc_node));
+			FreeSharedServiceContext (context_p);
+
+			if (s_contexts_p -> ll_size == 0)
+				{
+					FreeLinkedList (s_contexts_p);
+					s_contexts_p = NULL;
+				}
+		}
+
+	pthread_mutex_unlock (&s_contexts_mutex);
+}
+
+
+SharedServiceContextPin *PinSharedServiceContext (SharedServiceContext *context_p)
+{
+	SharedServiceContextPin *pin_p = (SharedServiceContextPin *) AllocMemory (sizeof (SharedServiceContextPin));
+
+	if (pin_p)
+		{
+			InitListItem (& (pin_p -> sscp_node));
+
+			pthread_mutex_lock (& (context_p -> ssc_mutex));
+			pin_p -> sscp_epoch = context_p -> ssc_epoch;
+			LinkedListAddTail (context_p -> ssc_pins_p, & (pin_p -> sscp_node));
+			pthread_mutex_unlock (& (context_p -> ssc_mutex));
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate pin for shared service context \"%s\"", context_p -> ssc_database_s);
+		}
+
+	return pin_p;
+}
+
+
+void RefreshSharedServiceContextPin (SharedServiceContext *context_p, SharedServiceContextPin *pin_p)
+{
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	pin_p -> sscp_epoch = context_p -> ssc_epoch;
+	ReclaimRetiredCacheEntries (context_p);
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+}
+
+
+void ReleaseSharedServiceContextPin (SharedServiceContext *context_p, SharedServiceContextPin *pin_p)
+{
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	LinkedListRemove (context_p -> ssc_pins_p, & (pin_p -> sscp_node));
+	ReclaimRetiredCacheEntries (context_p);
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	FreeMemory (pin_p);
+}
+
+
+MongoTool *GetPooledMongoTool (SharedServiceContext *context_p)
+{
+	MongoTool *tool_p = NULL;
+	MongoToolNode *node_p;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	node_p = (MongoToolNode *) LinkedListRemHead (context_p -> ssc_idle_mongo_tools_p);
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	if (node_p)
+		{
+			tool_p = node_p -> mtn_tool_p;
+			node_p -> mtn_tool_p = NULL;
+			FreeMongoToolNode (& (node_p -> mtn_node));
+		}
+	else
+		{
+			tool_p = AllocateMongoTool (NULL, context_p -> ssc_grassroots_p -> gs_mongo_manager_p);
+
+			if (tool_p)
+				{
+					if (!SetMongoToolDatabase (tool_p, context_p -> ssc_database_s))
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to set db to \"%s\"", context_p -> ssc_database_s);
+
+							FreeMongoTool (tool_p);
+							tool_p = NULL;
+						}
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate MongoTool");
+				}
+		}
+
+	return tool_p;
+}
+
+
+void ReleasePooledMongoTool (SharedServiceContext *context_p, MongoTool *tool_p)
+{
+	MongoToolNode *node_p = NULL;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_idle_mongo_tools_p -> ll_size < S_MAX_IDLE_MONGO_TOOLS)
+		{
+			node_p = AllocateMongoToolNode (tool_p);
+
+			if (node_p)
+				{
+					LinkedListAddTail (context_p -> ssc_idle_mongo_tools_p, & (node_p -> mtn_node));
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	if (!node_p)
+		{
+			FreeMongoTool (tool_p);
+		}
+}
+
+
+bool EnableSharedMeasuredVariablesCache (SharedServiceContext *context_p)
+{
+	bool success_flag = true;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (! (context_p -> ssc_measured_variables_cache_p))
+		{
+			success_flag = false;
+
+			context_p -> ssc_measured_variables_cache_p = AllocateLinkedList (FreeMeasuredVariableNode);
+
+			if (context_p -> ssc_measured_variables_cache_p)
+				{
+					if (AllocateMeasuredVariablesTables (context_p))
+						{
+							success_flag = true;
+						}
+					else
+						{
+							FreeLinkedList (context_p -> ssc_measured_variables_cache_p);
+							context_p -> ssc_measured_variables_cache_p = NULL;
+						}
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return success_flag;
+}
+
+
+bool HasSharedMeasuredVariablesCache (SharedServiceContext *context_p)
+{
+	bool has_cache_flag;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	has_cache_flag = (context_p -> ssc_measured_variables_cache_p != NULL);
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return has_cache_flag;
+}
+
+
+MeasuredVariable *GetSharedCachedMeasuredVariableById (SharedServiceContext *context_p, const char *mv_id_s)
+{
+	MeasuredVariable *mv_p = NULL;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_measured_variables_by_id_p)
+		{
+			MeasuredVariableNode *node_p = (MeasuredVariableNode *) GetFromHashTable (context_p -> ssc_measured_variables_by_id_p, mv_id_s);
+
+			if (node_p)
+				{
+					mv_p = node_p -> mvn_measured_variable_p;
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return mv_p;
+}
+
+
+MeasuredVariable *GetSharedCachedMeasuredVariableByName (SharedServiceContext *context_p, const char *name_s)
+{
+	MeasuredVariable *mv_p = NULL;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_measured_variables_by_name_p)
+		{
+			MeasuredVariableNode *node_p = (MeasuredVariableNode *) GetFromHashTable (context_p -> ssc_measured_variables_by_name_p, name_s);
+
+			if (node_p)
+				{
+					mv_p = node_p -> mvn_measured_variable_p;
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return mv_p;
+}
+
+
+bool AddMeasuredVariableToSharedCache (SharedServiceContext *context_p, MeasuredVariable *mv_p, MEM_FLAG mf)
+{
+	bool success_flag = false;
+	MeasuredVariableNode *node_p = AllocateMeasuredVariableNode (mv_p, mf);
+	const char *name_s = GetMeasuredVariableName (mv_p);
+
+	if (node_p)
+		{
+			pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+			if (context_p -> ssc_measured_variables_cache_p)
+				{
+					/*
+					 * The keys point to the node's data so they remain valid
+					 * for as long as the node is in the cache
+					 */
+					if (PutInHashTable (context_p -> ssc_measured_variables_by_id_p, node_p -> mvn_id_s, node_p))
+						{
+							if ((!name_s) || (PutInHashTable (context_p -> ssc_measured_variables_by_name_p, name_s, node_p)))
+								{
+									LinkedListAddTail (context_p -> ssc_measured_variables_cache_p, & (node_p -> mvn_node));
+									success_flag = true;
+								}
+							else
+								{
+									RemoveFromHashTable (context_p -> ssc_measured_variables_by_id_p, node_p -> mvn_id_s);
+								}
+						}
+				}
+
+			pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+			if (!success_flag)
+				{
+					/* The caller still owns the MeasuredVariable */
+					node_p -> mvn_measured_variable_p = NULL;
+					FreeMeasuredVariableNode (& (node_p -> mvn_node));
+				}
+		}
+
+	if (!success_flag)
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add \"%s\" to measured variables cache", name_s ? name_s : "");
+		}
+
+	return success_flag;
+}
+
+
+bool RemoveMeasuredVariableFromSharedCache (SharedServiceContext *context_p, const char *name_s)
+{
+	bool removed_flag = false;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_measured_variables_by_name_p)
+		{
+			MeasuredVariableNode *node_p = (MeasuredVariableNode *) GetFromHashTable (context_p -> ssc_measured_variables_by_name_p, name_s);
+
+			if (node_p)
+				{
+					LinkedList *retired_p = AllocateLinkedList (FreeMeasuredVariableNode);
+
+					RemoveFromHashTable (context_p -> ssc_measured_variables_by_name_p, name_s);
+					RemoveFromHashTable (context_p -> ssc_measured_variables_by_id_p, node_p -> mvn_id_s);
+
+					/*
+					 * Other services may still be using the MeasuredVariable
+					 * so it is retired rather than freed. If we can't do that,
+					 * leave it in the list where it can no longer be found and
+					 * it will be retired along with the rest of the cache.
+					 */
+					if (retired_p)
+						{
+							LinkedListRemove (context_p -> ssc_measured_variables_cache_p, & (node_p -> mvn_node));
+							LinkedListAddTail (retired_p, & (node_p -> mvn_node));
+
+							RetireCacheEntries (context_p, retired_p);
+						}
+
+					removed_flag = true;
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return removed_flag;
+}
+
+
+void ClearSharedMeasuredVariablesCache (SharedServiceContext *context_p)
+{
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	ClearMeasuredVariablesCacheLocked (context_p);
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+}
+
+
+bool BeginWarmingSharedMeasuredVariablesCache (SharedServiceContext *context_p, uint32 *epoch_p)
+{
+	bool claimed_flag = false;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if ((context_p -> ssc_measured_variables_cache_p) && (context_p -> ssc_measured_variables_state == MVCS_COLD))
+		{
+			context_p -> ssc_measured_variables_state = MVCS_WARMING;
+			*epoch_p = context_p -> ssc_epoch;
+			claimed_flag = true;
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return claimed_flag;
+}
+
+
+void EndWarmingSharedMeasuredVariablesCache (SharedServiceContext *context_p, const uint32 epoch, const bool success_flag)
+{
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_epoch != epoch)
+		{
+			/*
+			 * Entries were removed while we were filling the cache so
+			 * some of the ones that we added may be out of date.
+			 */
+			ClearMeasuredVariablesCacheLocked (context_p);
+		}
+	else
+		{
+			context_p -> ssc_measured_variables_state = success_flag ? MVCS_WARM : MVCS_COLD;
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+}
+
+
+MeasuredVariablesCacheState GetSharedMeasuredVariablesCacheState (SharedServiceContext *context_p)
+{
+	MeasuredVariablesCacheState state;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	state = context_p -> ssc_measured_variables_state;
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return state;
+}
+
+
+void ClearAllSharedMeasuredVariablesCaches (void)
+{
+	pthread_mutex_lock (&s_contexts_mutex);
+
+	if (s_contexts_p)
+		{
+			SharedServiceContext *context_p = (SharedServiceContext *) (s_contexts_p -> ll_head_p);
+
+			while (context_p)
+				{
+					ClearSharedMeasuredVariablesCache (context_p);
+					context_p = (SharedServiceContext *) (context_p -> ssc_node.ln_next_p);
+				}
+		}
+
+	pthread_mutex_unlock (&s_contexts_mutex);
+}
+
+
+bool EnableSharedTreatmentsCache (SharedServiceContext *context_p)
+{
+	bool success_flag = true;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (! (context_p -> ssc_treatments_cache_p))
+		{
+			success_flag = false;
+
+			context_p -> ssc_treatments_cache_p = AllocateLinkedList (FreeTreatmentNode);
+
+			if (context_p -> ssc_treatments_cache_p)
+				{
+					context_p -> ssc_treatments_by_url_p = GetHashTableOfStringPointers (64, 75);
+
+					if (context_p -> ssc_treatments_by_url_p)
+						{
+							success_flag = true;
+						}
+					else
+						{
+							FreeLinkedList (context_p -> ssc_treatments_cache_p);
+							context_p -> ssc_treatments_cache_p = NULL;
+						}
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return success_flag;
+}
+
+
+bool HasSharedTreatmentsCache (SharedServiceContext *context_p)
+{
+	bool has_cache_flag;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+	has_cache_flag = (context_p -> ssc_treatments_cache_p != NULL);
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return has_cache_flag;
+}
+
+
+Treatment *GetSharedCachedTreatmentByURL (SharedServiceContext *context_p, const char *url_s)
+{
+	Treatment *treatment_p = NULL;
+
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_treatments_by_url_p)
+		{
+			TreatmentNode *node_p = (TreatmentNode *) GetFromHashTable (context_p -> ssc_treatments_by_url_p, url_s);
+
+			if (node_p)
+				{
+					treatment_p = node_p -> tn_treatment_p;
+				}
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+	return treatment_p;
+}
+
+
+bool AddTreatmentToSharedCache (SharedServiceContext *context_p, Treatment *treatment_p, MEM_FLAG mf)
+{
+	bool success_flag = false;
+	TreatmentNode *node_p = AllocateTreatmentNode (treatment_p, mf);
+
+	if (node_p)
+		{
+			pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+			if (context_p -> ssc_treatments_cache_p)
+				{
+					if (PutInHashTable (context_p -> ssc_treatments_by_url_p, node_p -> tn_treatment_url_s, node_p))
+						{
+							LinkedListAddTail (context_p -> ssc_treatments_cache_p, & (node_p -> tn_node));
+							success_flag = true;
+						}
+				}
+
+			pthread_mutex_unlock (& (context_p -> ssc_mutex));
+
+			if (!success_flag)
+				{
+					/* The caller still owns the Treatment */
+					node_p -> tn_treatment_mem = MF_SHADOW_USE;
+					FreeTreatmentNode (& (node_p -> tn_node));
+				}
+		}
+
+	if (!success_flag)
+		{
+			PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add \"%s\" to treatments cache", treatment_p -> tr_ontology_term_p -> st_url_s);
+		}
+
+	return success_flag;
+}
+
+
+void ClearSharedTreatmentsCache (SharedServiceContext *context_p)
+{
+	pthread_mutex_lock (& (context_p -> ssc_mutex));
+
+	if (context_p -> ssc_treatments_cache_p)
+		{
+			LinkedList *old_entries_p = context_p -> ssc_treatments_cache_p;
+
+			FreeHashTable (context_p -> ssc_treatments_by_url_p);
+			context_p -> ssc_treatments_by_url_p = NULL;
+
+			context_p -> ssc_treatments_cache_p = AllocateLinkedList (FreeTreatmentNode);
+
+			if (context_p -> ssc_treatments_cache_p)
+				{
+					context_p -> ssc_treatments_by_url_p = GetHashTableOfStringPointers (64, 75);
+
+					if (! (context_p -> ssc_treatments_by_url_p))
+						{
+							FreeLinkedList (context_p -> ssc_treatments_cache_p);
+							context_p -> ssc_treatments_cache_p = NULL;
+						}
+				}
+
+			if (! (context_p -> ssc_treatments_cache_p))
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to reallocate treatments cache, disabling cache");
+				}
+
+			/*
+			 * Rows that any of the services have already loaded may be
+			 * using the cached Treatments, so retire them rather than
+			 * deleting them now.
+			 */
+			RetireCacheEntries (context_p, old_entries_p);
+		}
+
+	pthread_mutex_unlock (& (context_p -> ssc_mutex));
+}
+
+
+
+static SharedServiceContext *AllocateSharedServiceContext (const char *database_s, GrassrootsServer *grassroots_p)
+{
+	char *copied_database_s = EasyCopyToNewString (database_s);
+
+	if (copied_database_s)
+		{
+			LinkedList *idle_mongo_tools_p = AllocateLinkedList (FreeMongoToolNode);
+
+			if (idle_mongo_tools_p)
+				{
+					LinkedList *pins_p = AllocateLinkedList (FreeSharedServiceContextPinNode);
+
+					if (pins_p)
+						{
+							LinkedList *retired_p = AllocateLinkedList (FreeRetiredCacheEntriesNode);
+
+							if (retired_p)
+								{
+									SharedServiceContext *context_p = (SharedServiceContext *) AllocMemory (sizeof (SharedServiceContext));
+
+									if (context_p)
+										{
+											if (pthread_mutex_init (& (context_p -> ssc_mutex), NULL) == 0)
+												{
+													InitListItem (& (context_p -> ssc_node));
+
+													context_p -> ssc_database_s = copied_database_s;
+													context_p -> ssc_grassroots_p = grassroots_p;
+													context_p -> ssc_ref_count = 0;
+													context_p -> ssc_idle_mongo_tools_p = idle_mongo_tools_p;
+
+													context_p -> ssc_measured_variables_cache_p = NULL;
+													context_p -> ssc_measured_variables_by_name_p = NULL;
+													context_p -> ssc_measured_variables_by_id_p = NULL;
+													context_p -> ssc_measured_variables_state = MVCS_COLD;
+
+													context_p -> ssc_treatments_cache_p = NULL;
+													context_p -> ssc_treatments_by_url_p = NULL;
+
+													context_p -> ssc_epoch = 0;
+													context_p -> ssc_pins_p = pins_p;
+													context_p -> ssc_retired_p = retired_p;
+
+													context_p -> ssc_option_lists_p = AllocateOptionListCache ();
+
+													if (! (context_p -> ssc_option_lists_p))
+														{
+															PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to allocate option list cache for \"%s\"", database_s);
+														}
+
+													return context_p;
+												}
+
+											FreeMemory (context_p);
+										}
+
+									FreeLinkedList (retired_p);
+								}
+
+							FreeLinkedList (pins_p);
+						}
+
+					FreeLinkedList (idle_mongo_tools_p);
+				}
+
+			FreeCopiedString (copied_database_s);
+		}
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate shared service context for \"%s\"", database_s);
+
+	return NULL;
+}
+
+
+static void FreeSharedServiceContext (SharedServiceContext *context_p)
+{
+	FreeLinkedList (context_p -> ssc_idle_mongo_tools_p);
+
+	if (context_p -> ssc_measured_variables_cache_p)
+		{
+			FreeMeasuredVariablesTables (context_p);
+			FreeLinkedList (context_p -> ssc_measured_variables_cache_p);
+		}
+
+	if (context_p -> ssc_treatments_cache_p)
+		{
+			FreeHashTable (context_p -> ssc_treatments_by_url_p);
+			FreeLinkedList (context_p -> ssc_treatments_cache_p);
+		}
+
+	/*
+	 * Every service has released the context so nothing
+	 * can be using the retired entries any more.
+	 */
+	FreeLinkedList (context_p -> ssc_retired_p);
+	FreeLinkedList (context_p -> ssc_pins_p);
+
+	if (context_p -> ssc_option_lists_p)
+		{
+			FreeOptionListCache (context_p -> ssc_option_lists_p);
+		}
+
+	pthread_mutex_destroy (& (context_p -> ssc_mutex));
+
+	FreeCopiedString (context_p -> ssc_database_s);
+	FreeMemory (context_p);
+}
+
+
+static void FreeSharedServiceContextNode (ListItem *node_p)
+{
+	FreeSharedServiceContext ((SharedServiceContext *) node_p);
+}
+
+
+static MongoToolNode *AllocateMongoToolNode (MongoTool *tool_p)
+{
+	MongoToolNode *node_p = (MongoToolNode *) AllocMemory (sizeof (MongoToolNode));
+
+	if (node_p)
+		{
+			InitListItem (& (node_p -> mtn_node));
+			node_p -> mtn_tool_p = tool_p;
+		}
+
+	return node_p;
+}
+
+
+static void FreeMongoToolNode (ListItem *node_p)
+{
+	MongoToolNode *mt_node_p = (MongoToolNode *) node_p;
+
+	if (mt_node_p -> mtn_tool_p)
+		{
+			FreeMongoTool (mt_node_p -> mtn_tool_p);
+		}
+
+	FreeMemory (mt_node_p);
+}
+
+
+static bool AllocateMeasuredVariablesTables (SharedServiceContext *context_p)
+{
+	context_p -> ssc_measured_variables_by_name_p = GetHashTableOfStringPointers (256, 75);
+
+	if (context_p -> ssc_measured_variables_by_name_p)
+		{
+			context_p -> ssc_measured_variables_by_id_p = GetHashTableOfStringPointers (256, 75);
+
+			if (context_p -> ssc_measured_variables_by_id_p)
+				{
+					return true;
+				}
+
+			FreeHashTable (context_p -> ssc_measured_variables_by_name_p);
+			context_p -> ssc_measured_variables_by_name_p = NULL;
+		}
+
+	PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to allocate measured variable cache tables");
+
+	return false;
+}
+
+
+static void FreeMeasuredVariablesTables (SharedServiceContext *context_p)
+{
+	if (context_p -> ssc_measured_variables_by_name_p)
+		{
+			FreeHashTable (context_p -> ssc_measured_variables_by_name_p);
+			context_p -> ssc_measured_variables_by_name_p = NULL;
+		}
+
+	if (context_p -> ssc_measured_variables_by_id_p)
+		{
+			FreeHashTable (context_p -> ssc_measured_variables_by_id_p);
+			context_p -> ssc_measured_variables_by_id_p = NULL;
+		}
+}
+
+
+/*
+ * The caller must hold context_p -> ssc_mutex.
+ */
+static void ClearMeasuredVariablesCacheLocked (SharedServiceContext *context_p)
+{
+	if (context_p -> ssc_measured_variables_cache_p)
+		{
+			LinkedList *old_entries_p = context_p -> ssc_measured_variables_cache_p;
+
+			FreeMeasuredVariablesTables (context_p);
+
+			context_p -> ssc_measured_variables_cache_p = AllocateLinkedList (FreeMeasuredVariableNode);
+
+			if (context_p -> ssc_measured_variables_cache_p)
+				{
+					if (!AllocateMeasuredVariablesTables (context_p))
+						{
+							FreeLinkedList (context_p -> ssc_measured_variables_cache_p);
+							context_p -> ssc_measured_variables_cache_p = NULL;
+						}
+				}
+
+			if (! (context_p -> ssc_measured_variables_cache_p))
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to reallocate measured variables cache, disabling cache");
+				}
+
+			/*
+			 * Observations that any of the services have already loaded may be
+			 * using the cached MeasuredVariables, so retire them rather than
+			 * deleting them now.
+			 */
+			RetireCacheEntries (context_p, old_entries_p);
+
+			context_p -> ssc_measured_variables_state = MVCS_COLD;
+		}
+}
+
+
+/*
+ * Store some entries that have been removed from a cache until no
+ * service can be using them. The caller must hold context_p -> ssc_mutex.
+ */
+static void RetireCacheEntries (SharedServiceContext *context_p, LinkedList *entries_p)
+{
+	RetiredCacheEntries *retired_p = (RetiredCacheEntries *) AllocMemory (sizeof (RetiredCacheEntries));
+
+	if (retired_p)
+		{
+			InitListItem (& (retired_p -> rce_node));
+			retired_p -> rce_epoch = context_p -> ssc_epoch;
+			retired_p -> rce_entries_p = entries_p;
+
+			LinkedListAddTail (context_p -> ssc_retired_p, & (retired_p -> rce_node));
+		}
+	else
+		{
+			/*
+			 * We can't tell when it is safe to free them,
+			 * so the only safe thing to do is to leak them.
+			 */
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to retire " UINT32_FMT " cache entries", entries_p -> ll_size);
+		}
+
+	++ (context_p -> ssc_epoch);
+
+	ReclaimRetiredCacheEntries (context_p);
+}
+
+
+/*
+ * Free any retired entries that were removed before the oldest pin
+ * was taken. The caller must hold context_p -> ssc_mutex.
+ */
+static void ReclaimRetiredCacheEntries (SharedServiceContext *context_p)
+{
+	const SharedServiceContextPin *pin_p = (const SharedServiceContextPin *) (context_p -> ssc_pins_p -> ll_head_p);
+	bool pinned_flag = false;
+	uint32 oldest_epoch = 0;
+	RetiredCacheEntries *retired_p;
+
+	while (pin_p)
+		{
+			if ((!pinned_flag) || (pin_p -> sscp_epoch < oldest_epoch))
+				{
+					oldest_epoch = pin_p -> sscp_epoch;
+					pinned_flag = true;
+				}
+
+			pin_p = (const SharedServiceContextPin *) (pin_p -> sscp_node.ln_next_p);
+		}
+
+	/*
+	 * The batches are in the order that they were retired
+	 */
+	while (((retired_p = (RetiredCacheEntries *) (context_p -> ssc_retired_p -> ll_head_p)) != NULL) &&
+				 ((!pinned_flag) || (retired_p -> rce_epoch < oldest_epoch)))
+		{
+			LinkedListRemove (context_p -> ssc_retired_p, & (retired_p -> rce_node));
+			FreeRetiredCacheEntriesNode (& (retired_p -> rce_node));
+		}
+}
+
+
+static void FreeRetiredCacheEntriesNode (ListItem *node_p)
+{
+	RetiredCacheEntries *retired_p = (RetiredCacheEntries *) node_p;
+
+	FreeLinkedList (retired_p -> rce_entries_p);
+	FreeMemory (retired_p);
+}
+
+
+static void FreeSharedServiceContextPinNode (ListItem *node_p)
+{
+	FreeMemory (node_p);
+}
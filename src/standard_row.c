@@ -52,10 +52,10 @@ static bool AddStandardRowFrictionlessDataDetails (const Row *base_row_p, json_t
 
 static bool AddStandardRowFromJSON (Row *row_p, const json_t *row_json_p, const FieldTrialServiceData *data_p);
 
-static StandardRow *AllocateEmptyStandardRow (void);
+static StandardRow *AllocateEmptyStandardRow (StudyArena *arena_p);
 
 
-static StandardRow *AllocateEmptyStandardRow (void)
+static StandardRow *AllocateEmptyStandardRow (StudyArena *arena_p)
 {
 	LinkedList *observations_p = AllocateLinkedList (FreeObservationNode);
 
@@ -65,10 +65,12 @@ static StandardRow *AllocateEmptyStandardRow (void)
 
 			if (tf_values_p)
 				{
-					StandardRow *row_p = (StandardRow *) AllocMemory (sizeof (StandardRow));
+					StandardRow *row_p = (StandardRow *) AllocStudyMemory (arena_p, sizeof (StandardRow));
 
 					if (row_p)
 						{
+							row_p -> sr_base.ro_arena_p = arena_p;
+
 							row_p -> sr_observations_p = observations_p;
 							row_p -> sr_treatment_factor_values_p = tf_values_p;
 
@@ -193,7 +195,16 @@ void ClearStandardRow (Row *row_p)
 
 void SetStandardRowMaterial (StandardRow *row_p, Material *material_p, MEM_FLAG material_mem)
 {
+	if ((row_p -> sr_material_mem == MF_DEEP_COPY) || (row_p -> sr_material_mem == MF_SHALLOW_COPY))
+		{
+			if ((row_p -> sr_material_p) && (row_p -> sr_material_p != material_p))
+				{
+					FreeMaterial (row_p -> sr_material_p);
+				}
+		}
 
+	row_p -> sr_material_p = material_p;
+	row_p -> sr_material_mem = material_mem;
 }
 
 
@@ -202,6 +213,7 @@ StandardRow *GetStandardRowFromJSON (const json_t *row_json_p, Plot *plot_p, Mat
 {
 	StandardRow *row_p = NULL;
 	Material *material_to_use_p = material_p;
+	MEM_FLAG material_mem = MF_SHADOW_USE;
 
 	if (!plot_p)
 		{
@@ -220,7 +232,7 @@ StandardRow *GetStandardRowFromJSON (const json_t *row_json_p, Plot *plot_p, Mat
 
 	if (plot_p)
 		{
-			row_p = AllocateEmptyStandardRow ();
+			row_p = AllocateEmptyStandardRow (plot_p -> pl_arena_p);
 
 			if (row_p)
 				{
@@ -241,7 +253,23 @@ StandardRow *GetStandardRowFromJSON (const json_t *row_json_p, Plot *plot_p, Mat
 												{
 													if (GetNamedIdFromJSON (row_json_p, SR_MATERIAL_ID_S, material_id_p))
 														{
-															material_to_use_p = GetMaterialById (material_id_p, data_p);
+															/*
+															 * Has the Study already got the material?
+															 */
+															if (study_p && (study_p -> st_materials_p))
+																{
+																	material_to_use_p = GetMaterialFromMaterialsMap (study_p -> st_materials_p, material_id_p);
+																}
+
+															if (!material_to_use_p)
+																{
+																	material_to_use_p = GetMaterialById (material_id_p, data_p);
+
+																	if (material_to_use_p)
+																		{
+																			material_mem = MF_SHALLOW_COPY;
+																		}
+																}
 
 															if (material_to_use_p)
 																{
@@ -317,11 +345,9 @@ StandardRow *GetStandardRowFromJSON (const json_t *row_json_p, Plot *plot_p, Mat
 
 													if ((replicate != 0) || (rep_control_flag))
 														{
-															MEM_FLAG mf = material_to_use_p == material_p ? MF_SHADOW_USE : MF_SHALLOW_COPY;
-
 															row_p -> sr_rack_index = rack_index;
 															row_p -> sr_material_p = material_to_use_p;
-															row_p -> sr_material_mem = mf;
+															row_p -> sr_material_mem = material_mem;
 															row_p -> sr_replicate_index = replicate;
 
 
@@ -395,7 +421,7 @@ StandardRow *GetStandardRowFromJSON (const json_t *row_json_p, Plot *plot_p, Mat
 
 	if (row_p)
 		{
-			if (material_to_use_p && (material_to_use_p != material_p) && (row_p -> sr_material_p != material_to_use_p))
+			if (material_to_use_p && (material_mem == MF_SHALLOW_COPY) && (row_p -> sr_material_p != material_to_use_p))
 				{
 					FreeMaterial (material_to_use_p);
 				}
@@ -404,7 +430,7 @@ StandardRow *GetStandardRowFromJSON (const json_t *row_json_p, Plot *plot_p, Mat
 		}
 	else
 		{
-			if (material_to_use_p && (material_to_use_p != material_p))
+			if (material_to_use_p && (material_mem == MF_SHALLOW_COPY))
 				{
 					FreeMaterial (material_to_use_p);
 				}
@@ -678,7 +704,7 @@ static bool GetObservationsFromJSON (const json_t *row_json_p, StandardRow *row_
 			for (i = 0; i < size; ++ i)
 				{
 					const json_t *observation_json_p = json_array_get (observations_json_p, i);
-					Observation *observation_p = GetObservationFromJSON (observation_json_p, data_p);
+					Observation *observation_p = GetObservationFromJSON (observation_json_p, row_p -> sr_base.ro_arena_p, data_p);
 
 					if (observation_p)
 						{
@@ -23,17 +23,17 @@ static bool GetStringObservationValueAsString (const struct Observation *observa
 
 StringObservation *AllocateStringObservation (bson_oid_t *id_p, ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p, MEM_FLAG phenotype_mem,
 																							const char * const raw_value_s, const char * const corrected_value_s, const char *growth_stage_s,
-																							const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s)
+																							const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s, StudyArena *arena_p)
 {
 	char *copied_raw_value_s = NULL;
 
-	if ((!raw_value_s) || ((copied_raw_value_s = EasyCopyToNewString (raw_value_s)) != NULL))
+	if ((!raw_value_s) || ((copied_raw_value_s = CopyStudyString (arena_p, raw_value_s)) != NULL))
 		{
 			char *copied_corrected_value_s = NULL;
 
-			if ((!corrected_value_s) || ((copied_corrected_value_s = EasyCopyToNewString (corrected_value_s)) != NULL))
+			if ((!corrected_value_s) || ((copied_corrected_value_s = CopyStudyString (arena_p, corrected_value_s)) != NULL))
 				{
-					StringObservation *observation_p = (StringObservation *) AllocMemory (sizeof (StringObservation));
+					StringObservation *observation_p = (StringObservation *) AllocStudyMemory (arena_p, sizeof (StringObservation));
 
 					if (observation_p)
 						{
@@ -42,7 +42,7 @@ StringObservation *AllocateStringObservation (bson_oid_t *id_p, ObservationMetad
 							if (InitObservation (& (observation_p -> so_base_observation), id_p, metadata_p, phenotype_p, phenotype_mem, growth_stage_s, method_s, instrument_p, nature, notes_s,
 																	 OT_STRING,
 																	 ClearStringObservation, AddStringObservationValuesToJSON, SetStringObservationValueFromJSON,
-																	 SetStringObservationValueFromString, GetStringObservationValueAsString))
+																	 SetStringObservationValueFromString, GetStringObservationValueAsString, arena_p))
 								{
 									observation_p -> so_raw_value_s = copied_raw_value_s;
 									observation_p -> so_corrected_value_s = copied_corrected_value_s;
@@ -52,18 +52,18 @@ StringObservation *AllocateStringObservation (bson_oid_t *id_p, ObservationMetad
 
 							ClearObservation (& (observation_p -> so_base_observation));
 							ClearStringObservation (& (observation_p -> so_base_observation));
-							FreeMemory (observation_p);
+							FreeStudyMemory (arena_p, observation_p);
 						}
 
 					if (copied_corrected_value_s)
 						{
-							FreeCopiedString (copied_corrected_value_s);
+							FreeStudyString (arena_p, copied_corrected_value_s);
 						}
 				}
 
 			if (copied_raw_value_s)
 				{
-					FreeCopiedString (copied_raw_value_s);
+					FreeStudyString (arena_p, copied_raw_value_s);
 				}
 		}
 
@@ -78,13 +78,13 @@ void ClearStringObservation (Observation *observation_p)
 
 	if (string_obs_p -> so_raw_value_s)
 		{
-			FreeCopiedString (string_obs_p -> so_raw_value_s);
+			FreeStudyString (observation_p -> ob_arena_p, string_obs_p -> so_raw_value_s);
 			string_obs_p -> so_raw_value_s = NULL;
 		}
 
 	if (string_obs_p -> so_corrected_value_s)
 		{
-			FreeCopiedString (string_obs_p -> so_corrected_value_s);
+			FreeStudyString (observation_p -> ob_arena_p, string_obs_p -> so_corrected_value_s);
 			string_obs_p -> so_corrected_value_s = NULL;
 		}
 }
@@ -42,6 +42,9 @@
 #include "handbook_generator.h"
 #include "person_jobs.h"
 #include "mongodb_util.h"
+#include "study_post_save_queue.h"
+#include "option_list_cache.h"
+#include "revision_store.h"
 
 #ifdef ENABLE_MARTI
 	#include "marti_util.h"
@@ -99,6 +102,10 @@ static bool AddCommonPlotValuesToJSON (Study *study_p, json_t *study_json_p, con
 
 static bool AddPersonFromJSON (Person *person_p, void *user_data_p, MEM_FLAG *mem_p);
 
+static bool GetStudyPlotsMaterials (Study *study_p, const json_t *plots_json_p, const FieldTrialServiceData *data_p);
+
+static void ClearStudyPlotsMaterials (Study *study_p);
+
 
 
 /*
@@ -268,6 +275,7 @@ Study *AllocateStudy (bson_oid_t *id_p,  Metadata *metadata_p,  const char *name
 																																																																					study_p -> st_parent_field_trial_mem = parent_field_trial_mem;
 																																																																					study_p -> st_location_p = location_p;
 																																																																					study_p -> st_plots_p = plots_p;
+																																																																					study_p -> st_materials_p = NULL;
 																																																																					study_p -> st_current_crop_p = current_crop_p;
 																																																																					study_p -> st_previous_crop_p = previous_crop_p;
 																																																																					study_p -> st_description_s = copied_description_s;
@@ -311,6 +319,8 @@ Study *AllocateStudy (bson_oid_t *id_p,  Metadata *metadata_p,  const char *name
 																																																																					study_p -> st_phenotypes_p = stats_p;
 
 																																																																					study_p -> st_contributors_p = contributors_p;
+																																																																					study_p -> st_arena_p = NULL;
+
 																																																																					return study_p;
 																																																																				}
 
@@ -593,6 +603,21 @@ void FreeStudy (Study *study_p)
 			FreeLinkedList (study_p -> st_plots_p);
 		}
 
+	/*
+	 * The rows share these Materials so they need to
+	 * go after the plots
+	 */
+	ClearStudyPlotsMaterials (study_p);
+
+	/*
+	 * Any plots, rows and observations allocated from the arena
+	 * have been cleared above so it can now go in one go.
+	 */
+	if (study_p -> st_arena_p)
+		{
+			FreeStudyArena (study_p -> st_arena_p);
+		}
+
 	if (study_p -> st_current_crop_p)
 		{
 			FreeCrop (study_p -> st_current_crop_p);
@@ -822,11 +847,38 @@ bool AddStudyPlotsJSONDirectly (Study *study_p, json_t *study_json_p,  const Fie
 }
 
 
+bool UseStudyArena (Study *study_p, const FieldTrialServiceData *data_p)
+{
+	if ((!study_p -> st_arena_p) && (data_p -> dftsd_study_arena_block_size > 0))
+		{
+			study_p -> st_arena_p = AllocateStudyArena (data_p -> dftsd_study_arena_block_size);
+		}
+
+	return (study_p -> st_arena_p != NULL);
+}
+
+
 bool GetStudyPlots (Study *study_p, const ViewFormat format, FieldTrialServiceData *data_p)
 {
 	bool success_flag = false;
 
 	ClearLinkedList (study_p -> st_plots_p);
+	ClearStudyPlotsMaterials (study_p);
+
+	/*
+	 * Any previous plots were allocated from the arena, so start a new
+	 * one rather than keeping their memory until the Study is freed.
+	 */
+	if (study_p -> st_arena_p)
+		{
+			FreeStudyArena (study_p -> st_arena_p);
+			study_p -> st_arena_p = NULL;
+
+			if (!UseStudyArena (study_p, data_p))
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to allocate new arena for study \"%s\", its plots will be allocated from the heap", study_p -> st_name_s);
+				}
+		}
 
 	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, data_p -> dftsd_collection_ss [DFTD_PLOT]))
 		{
@@ -856,6 +908,18 @@ bool GetStudyPlots (Study *study_p, const ViewFormat format, FieldTrialServiceDa
 												{
 													json_t *plot_json_p;
 
+													/*
+													 * Get all of the rows' Materials up front rather
+													 * than making a query for each row
+													 */
+													if (format != VF_CLIENT_MINIMAL)
+														{
+															if (!GetStudyPlotsMaterials (study_p, results_p, data_p))
+																{
+																	PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to get all of the materials for study \"%s\", the remaining ones will be fetched for each row", study_p -> st_name_s);
+																}
+														}
+
 													json_array_foreach (results_p, i, plot_json_p)
 														{
 															Plot *plot_p = GetPlotFromJSON (plot_json_p, study_p, format, data_p);
@@ -892,6 +956,109 @@ bool GetStudyPlots (Study *study_p, const ViewFormat format, FieldTrialServiceDa
 
 
 
+/*
+ * Collect the distinct material ids from the rows of the given plots
+ * and get them all with a single query.
+ */
+static bool GetStudyPlotsMaterials (Study *study_p, const json_t *plots_json_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	json_t *ids_p = json_object ();
+
+	if (ids_p)
+		{
+			size_t i;
+			const json_t *plot_json_p;
+
+			success_flag = true;
+
+			json_array_foreach (plots_json_p, i, plot_json_p)
+				{
+					const json_t *rows_p = json_object_get (plot_json_p, PL_ROWS_S);
+
+					if (json_is_array (rows_p))
+						{
+							size_t j;
+							const json_t *row_json_p;
+
+							json_array_foreach (rows_p, j, row_json_p)
+								{
+									bson_oid_t id;
+
+									if (GetNamedIdFromJSON (row_json_p, SR_MATERIAL_ID_S, &id))
+										{
+											char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+											bson_oid_to_string (&id, id_s);
+
+											if (json_object_set_new (ids_p, id_s, json_true ()) != 0)
+												{
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add material id \"%s\"", id_s);
+													success_flag = false;
+												}
+										}
+								}
+						}
+
+				}		/* json_array_foreach (plots_json_p, i, plot_json_p) */
+
+			if (success_flag)
+				{
+					const size_t num_ids = json_object_size (ids_p);
+
+					if (num_ids > 0)
+						{
+							const char **ids_ss = (const char **) AllocMemory (num_ids * sizeof (const char *));
+
+							success_flag = false;
+
+							if (ids_ss)
+								{
+									MaterialsMap *materials_p = AllocateMaterialsMap ();
+
+									if (materials_p)
+										{
+											const char *key_s;
+											json_t *value_p;
+											const char **id_ss = ids_ss;
+
+											json_object_foreach (ids_p, key_s, value_p)
+												{
+													*id_ss = key_s;
+													++ id_ss;
+												}
+
+											/*
+											 * Keep whatever we got even on partial failure since
+											 * any missing ones will be fetched by their rows
+											 */
+											success_flag = AddMaterialsToMaterialsMap (materials_p, ids_ss, num_ids, data_p);
+											study_p -> st_materials_p = materials_p;
+										}
+
+									FreeMemory (ids_ss);
+								}
+						}
+
+				}		/* if (success_flag) */
+
+			json_decref (ids_p);
+		}		/* if (ids_p) */
+
+	return success_flag;
+}
+
+
+static void ClearStudyPlotsMaterials (Study *study_p)
+{
+	if (study_p -> st_materials_p)
+		{
+			FreeMaterialsMap (study_p -> st_materials_p);
+			study_p -> st_materials_p = NULL;
+		}
+}
+
+
 bool AddPlotToStudy (Study *study_p, Plot *plot_p)
 {
 	bool success_flag = false;
@@ -924,11 +1091,12 @@ OperationStatus SaveStudy (Study *study_p, ServiceJob *job_p, FieldTrialServiceD
 
 			if (study_json_p)
 				{
-					if (SaveAndBackupMongoDataWithTimestamp (data_p -> dftsd_mongo_p, study_json_p, data_p -> dftsd_collection_ss [DFTD_STUDY], 
-							data_p -> dftsd_backup_collection_ss [DFTD_STUDY], DFT_BACKUPS_ID_KEY_S, selector_p, MONGO_TIMESTAMP_S))
+					if (SaveAndBackupMongoDataWithRevisions (study_json_p, DFTD_STUDY, selector_p, data_p))
 						{
 							char *id_s = GetBSONOidAsString (study_p -> st_id_p);
 
+							ClearOptionListCache (DFTD_STUDY, data_p);
+
 							if (id_s)
 								{
 									json_t *info_p = NULL;
@@ -940,14 +1108,6 @@ OperationStatus SaveStudy (Study *study_p, ServiceJob *job_p, FieldTrialServiceD
 											ClearCachedStudy (id_s, data_p);
 										}
 
-									if (data_p -> dftsd_assets_path_s)
-										{
-											if (!SaveStudyAsFrictionlessData (study_p, data_p))
-												{
-													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "SaveStudyAsFrictionlessData () failed for Study \"%s\"", study_p -> st_name_s);
-												}
-										}
-
 									/*
 									 * If we have the front-end web address to view the study,
 									 * save it to the ServiceJob.
@@ -1011,7 +1171,7 @@ OperationStatus SaveStudy (Study *study_p, ServiceJob *job_p, FieldTrialServiceD
 						}
 					else
 						{
-							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, study_json_p, "SaveAndBackupMongoDataWithTimestamp () failed for Study \"%s\"", study_p -> st_name_s);
+							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, study_json_p, "SaveAndBackupMongoDataWithRevisions () failed for Study \"%s\"", study_p -> st_name_s);
 						}
 
 					json_decref (study_json_p);
@@ -1022,27 +1182,19 @@ OperationStatus SaveStudy (Study *study_p, ServiceJob *job_p, FieldTrialServiceD
 				}
 
 			/*
-			 * Index the Study using Lucene
+			 * Build the Frictionless Data package, Lucene index entry
+			 * and handbook for the Study. If the background queue is
+			 * enabled, these are done after we return.
 			 */
 			if ((status == OS_SUCCEEDED) || (status == OS_PARTIALLY_SUCCEEDED))
 				{
-					OperationStatus s = IndexStudy (study_p, job_p, NULL, data_p);
-
-					if (s != OS_SUCCEEDED)
+					if (!QueueStudyPostSaveTasks (study_p, data_p))
 						{
-							status = OS_PARTIALLY_SUCCEEDED;
-							AddGeneralErrorMessageToServiceJob (job_p, "Saved study but failed to index for searching");
-							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "IndexStudy () failed for Study \"%s\"", study_p -> st_name_s);
-						}
-
-					s = GenerateStudyAsPDF (study_p, data_p);
-					if (s != OS_SUCCEEDED)
-						{
-							status = OS_PARTIALLY_SUCCEEDED;
-							AddGeneralErrorMessageToServiceJob (job_p, "Saved study but failed to generate handbook");
-							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GenerateStudyAsPDF () failed for Study \"%s\" with status %d", study_p -> st_name_s, s);
+							if (RunStudyPostSaveTasks (study_p, job_p, data_p) != OS_SUCCEEDED)
+								{
+									status = OS_PARTIALLY_SUCCEEDED;
+								}
 						}
-
 				}
 
 		}		/* if (success_flag) */
@@ -1053,35 +1205,91 @@ OperationStatus SaveStudy (Study *study_p, ServiceJob *job_p, FieldTrialServiceD
 }
 
 
+OperationStatus RunStudyPostSaveTasks (Study *study_p, ServiceJob *job_p, FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_SUCCEEDED;
+	OperationStatus s;
+
+	if (data_p -> dftsd_assets_path_s)
+		{
+			if (!SaveStudyAsFrictionlessData (study_p, data_p))
+				{
+					status = OS_PARTIALLY_SUCCEEDED;
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "SaveStudyAsFrictionlessData () failed for Study \"%s\"", study_p -> st_name_s);
+				}
+		}
+
+	/*
+	 * Index the Study using Lucene
+	 */
+	s = IndexStudy (study_p, job_p, NULL, data_p);
+
+	if (s != OS_SUCCEEDED)
+		{
+			status = OS_PARTIALLY_SUCCEEDED;
+			AddGeneralErrorMessageToServiceJob (job_p, "Saved study but failed to index for searching");
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "IndexStudy () failed for Study \"%s\"", study_p -> st_name_s);
+		}
+
+	s = GenerateStudyAsPDF (study_p, data_p);
+
+	if (s != OS_SUCCEEDED)
+		{
+			status = OS_PARTIALLY_SUCCEEDED;
+			AddGeneralErrorMessageToServiceJob (job_p, "Saved study but failed to generate handbook");
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GenerateStudyAsPDF () failed for Study \"%s\" with status %d", study_p -> st_name_s, s);
+		}
+
+	return status;
+}
+
+
 OperationStatus IndexStudy (Study *study_p, ServiceJob *job_p, const char *job_name_s, FieldTrialServiceData *data_p)
 {
 	OperationStatus status = OS_FAILED;
-	const ViewFormat format = VF_INDEXING;
+	json_t *study_json_p = GetStudyIndexingJSON (study_p, data_p);
 
-	if (GetStudyPlots (study_p, format, data_p))
+	if (study_json_p)
 		{
-			json_t *study_json_p = GetStudyAsJSON (study_p, format, NULL, data_p);
+			status = IndexData (job_p, study_json_p, job_name_s);
 
-			if (study_json_p)
+			if (status != OS_SUCCEEDED)
 				{
-					status = IndexData (job_p, study_json_p, job_name_s);
+					PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, study_json_p, "Failed to index Study \"%s\" as JSON to Lucene", study_p -> st_name_s);
+					AddGeneralErrorMessageToServiceJob (job_p, "Study saved but failed to index for searching");
+				}
 
-					if (status != OS_SUCCEEDED)
-						{
-							PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, study_json_p, "Failed to index Study \"%s\" as JSON to Lucene", study_p -> st_name_s);
-							AddGeneralErrorMessageToServiceJob (job_p, "Study saved but failed to index for searching");
-						}
+			json_decref (study_json_p);
+		}
+	else
+		{
+			AddGeneralErrorMessageToServiceJob (job_p, "Study saved but failed to index for searching");
+		}
 
-					json_decref (study_json_p);
-				}
-			else
+	return status;
+}
+
+
+json_t *GetStudyIndexingJSON (Study *study_p, FieldTrialServiceData *data_p)
+{
+	json_t *study_json_p = NULL;
+	const ViewFormat format = VF_INDEXING;
+
+	if (GetStudyPlots (study_p, format, data_p))
+		{
+			study_json_p = GetStudyAsJSON (study_p, format, NULL, data_p);
+
+			if (!study_json_p)
 				{
 					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GetStudyAsJSON for \"%s\" failed", study_p -> st_name_s);
-					AddGeneralErrorMessageToServiceJob (job_p, "Study saved but failed to index for searching");
 				}
 		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GetStudyPlots for \"%s\" failed", study_p -> st_name_s);
+		}
 
-	return status;
+	return study_json_p;
 }
 
 
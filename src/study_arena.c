@@ -0,0 +1,339 @@
+/*
+ * study_arena.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <string.h>
+
+#include "study_arena.h"
+
+#include "memory_allocations.h"
+#include "dfw_util.h"
+#include "mongodb_util.h"
+#include "string_utils.h"
+#include "streams.h"
+
+
+/*
+ * All allocations are rounded up to this so that the
+ * doubles and pointers stored in the arena are aligned.
+ */
+#define S_ARENA_ALIGNMENT (sizeof (double64))
+
+
+/**
+ * A chunk of memory that the allocations are taken from.
+ */
+typedef struct StudyArenaBlock
+{
+	/** The previously allocated block. */
+	struct StudyArenaBlock *sab_prev_p;
+
+	/** The size in bytes of sab_data_p. */
+	size_t sab_size;
+
+	/** The number of bytes of sab_data_p that have been used. */
+	size_t sab_used;
+
+	/** The memory that allocations are taken from. */
+	double64 sab_data_p [];
+
+} StudyArenaBlock;
+
+
+struct StudyArena
+{
+	/** The block that allocations are currently taken from. */
+	StudyArenaBlock *sa_current_block_p;
+
+	/** The default size in bytes of each block. */
+	size_t sa_block_size;
+
+	/** The total number of bytes that have been allocated. */
+	size_t sa_allocated_size;
+};
+
+
+static StudyArenaBlock *AllocateStudyArenaBlock (const size_t size, StudyArenaBlock *prev_p);
+
+static void *AllocateFromStudyArena (StudyArena *arena_p, size_t size);
+
+
+StudyArena *AllocateStudyArena (const size_t block_size)
+{
+	StudyArena *arena_p = (StudyArena *) AllocMemory (sizeof (StudyArena));
+
+	if (arena_p)
+		{
+			arena_p -> sa_current_block_p = NULL;
+			arena_p -> sa_block_size = block_size;
+			arena_p -> sa_allocated_size = 0;
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate StudyArena with block size " SIZET_FMT, block_size);
+		}
+
+	return arena_p;
+}
+
+
+void FreeStudyArena (StudyArena *arena_p)
+{
+	StudyArenaBlock *block_p = arena_p -> sa_current_block_p;
+
+	while (block_p)
+		{
+			StudyArenaBlock *prev_p = block_p -> sab_prev_p;
+
+			FreeMemory (block_p);
+			block_p = prev_p;
+		}
+
+	FreeMemory (arena_p);
+}
+
+
+size_t GetStudyArenaSize (const StudyArena *arena_p)
+{
+	return arena_p -> sa_allocated_size;
+}
+
+
+void *AllocStudyMemory (StudyArena *arena_p, const size_t size)
+{
+	void *mem_p = NULL;
+
+	if (arena_p)
+		{
+			mem_p = AllocateFromStudyArena (arena_p, size);
+		}
+	else
+		{
+			mem_p = AllocMemory (size);
+		}
+
+	return mem_p;
+}
+
+
+void FreeStudyMemory (StudyArena *arena_p, void *mem_p)
+{
+	if (!arena_p)
+		{
+			FreeMemory (mem_p);
+		}
+}
+
+
+char *CopyStudyString (StudyArena *arena_p, const char *src_s)
+{
+	char *copied_value_s = NULL;
+
+	if (arena_p)
+		{
+			const size_t l = strlen (src_s) + 1;
+
+			copied_value_s = (char *) AllocateFromStudyArena (arena_p, l);
+
+			if (copied_value_s)
+				{
+					memcpy (copied_value_s, src_s, l);
+				}
+		}
+	else
+		{
+			copied_value_s = EasyCopyToNewString (src_s);
+		}
+
+	return copied_value_s;
+}
+
+
+void FreeStudyString (StudyArena *arena_p, char *value_s)
+{
+	if (!arena_p)
+		{
+			FreeCopiedString (value_s);
+		}
+}
+
+
+bson_oid_t *AllocStudyBSONOid (StudyArena *arena_p)
+{
+	bson_oid_t *id_p = NULL;
+
+	if (arena_p)
+		{
+			id_p = (bson_oid_t *) AllocateFromStudyArena (arena_p, sizeof (bson_oid_t));
+		}
+	else
+		{
+			id_p = GetNewUnitialisedBSONOid ();
+		}
+
+	return id_p;
+}
+
+
+void FreeStudyBSONOid (StudyArena *arena_p, bson_oid_t *id_p)
+{
+	if (!arena_p)
+		{
+			FreeBSONOid (id_p);
+		}
+}
+
+
+bool CopyValidStudyReal (StudyArena *arena_p, const double64 *src_p, double64 **dest_pp)
+{
+	bool success_flag = true;
+
+	if (arena_p)
+		{
+			double64 *copied_value_p = NULL;
+
+			if (src_p)
+				{
+					copied_value_p = (double64 *) AllocateFromStudyArena (arena_p, sizeof (double64));
+
+					if (copied_value_p)
+						{
+							*copied_value_p = *src_p;
+						}
+					else
+						{
+							success_flag = false;
+						}
+				}
+
+			*dest_pp = copied_value_p;
+		}
+	else
+		{
+			success_flag = CopyValidReal (src_p, dest_pp);
+		}
+
+	return success_flag;
+}
+
+
+bool CopyValidStudyUnsignedInteger (StudyArena *arena_p, const uint32 *src_p, uint32 **dest_pp)
+{
+	bool success_flag = true;
+
+	if (arena_p)
+		{
+			uint32 *copied_value_p = NULL;
+
+			if (src_p)
+				{
+					copied_value_p = (uint32 *) AllocateFromStudyArena (arena_p, sizeof (uint32));
+
+					if (copied_value_p)
+						{
+							*copied_value_p = *src_p;
+						}
+					else
+						{
+							success_flag = false;
+						}
+				}
+
+			*dest_pp = copied_value_p;
+		}
+	else
+		{
+			success_flag = CopyValidUnsignedInteger (src_p, dest_pp);
+		}
+
+	return success_flag;
+}
+
+
+bool CopyValidStudyInteger (StudyArena *arena_p, const int32 *src_p, int32 **dest_pp)
+{
+	bool success_flag = true;
+
+	if (arena_p)
+		{
+			int32 *copied_value_p = NULL;
+
+			if (src_p)
+				{
+					copied_value_p = (int32 *) AllocateFromStudyArena (arena_p, sizeof (int32));
+
+					if (copied_value_p)
+						{
+							*copied_value_p = *src_p;
+						}
+					else
+						{
+							success_flag = false;
+						}
+				}
+
+			*dest_pp = copied_value_p;
+		}
+	else
+		{
+			success_flag = CopyValidInteger (src_p, dest_pp);
+		}
+
+	return success_flag;
+}
+
+
+
+static StudyArenaBlock *AllocateStudyArenaBlock (const size_t size, StudyArenaBlock *prev_p)
+{
+	StudyArenaBlock *block_p = (StudyArenaBlock *) AllocMemory (sizeof (StudyArenaBlock) + size);
+
+	if (block_p)
+		{
+			block_p -> sab_prev_p = prev_p;
+			block_p -> sab_size = size;
+			block_p -> sab_used = 0;
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate StudyArenaBlock of " SIZET_FMT " bytes", size);
+		}
+
+	return block_p;
+}
+
+
+static void *AllocateFromStudyArena (StudyArena *arena_p, size_t size)
+{
+	void *mem_p = NULL;
+	StudyArenaBlock *block_p = arena_p -> sa_current_block_p;
+
+	size = (size + S_ARENA_ALIGNMENT - 1) & ~ (S_ARENA_ALIGNMENT - 1);
+
+	if ((!block_p) || (block_p -> sab_used + size > block_p -> sab_size))
+		{
+			/*
+			 * Anything bigger than a block gets a block of its own
+			 */
+			const size_t block_size = (size > arena_p -> sa_block_size) ? size : arena_p -> sa_block_size;
+
+			block_p = AllocateStudyArenaBlock (block_size, arena_p -> sa_current_block_p);
+
+			if (block_p)
+				{
+					arena_p -> sa_current_block_p = block_p;
+				}
+		}
+
+	if (block_p)
+		{
+			mem_p = ((char *) (block_p -> sab_data_p)) + block_p -> sab_used;
+			block_p -> sab_used += size;
+			arena_p -> sa_allocated_size += size;
+		}
+
+	return mem_p;
+}
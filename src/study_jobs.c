@@ -35,6 +35,8 @@
 #include "treatment_jobs.h"
 #include "treatment_factor_jobs.h"
 #include "dfw_util.h"
+#include "study_memory_cache.h"
+#include "material_usage.h"
 #include "key_value_pair.h"
 #include "time_util.h"
 #include "frictionless_data_util.h"
@@ -60,13 +62,11 @@
 #include "phenotype_statistics.h"
 #include "person_jobs.h"
 #include "permissions_editor.h"
+#include "option_list_cache.h"
 
-typedef struct
-{
-	Study *spd_study_p;
-	StatisticsTool *spd_stats_tool_p;
-} StudyProcessData;
-
+#ifdef ENABLE_MARTI
+	#include "marti_util.h"
+#endif
 
 /*
  * Study parameters
@@ -187,10 +187,6 @@ static bool AddTreatmentFactorsAsFrictionlessData (json_t *json_p, LinkedList *t
 static bool AddGeneralSubmissionStudyParams (Study *active_study_p, const char *id_s, const char *trial_s, const char *location_s, ParameterSet *params_p, ParameterGroup *group_p, ServiceData *data_p);
 
 
-static OperationStatus ProcessDistinctValues (bson_oid_t *study_id_p, const char *key_s, bool (*process_value_fn) (const char *oid_s, void *user_data_p, const FieldTrialServiceData *service_data_p), void *user_data_p, const FieldTrialServiceData *service_data_p);
-
-static bool ProcessStudyPhenotype (const char *phenotype_oid_s, void *user_data_p, const FieldTrialServiceData *service_data_p);
-
 static bool AddCuratorSubmissionParams (const Person *curator_p, ParameterSet *params_p, ServiceData *data_p);
 
 static bool AddContactSubmissionParams (const Person *contact_p, ParameterSet *params_p, ServiceData *data_p);
@@ -590,7 +586,11 @@ OperationStatus ImportStudy ()
 bool RemoveCachedStudyById (const char * const id_s, FieldTrialServiceData *data_p)
 {
 	bool success_flag = false;
-	char *filename_s = GetFullCacheFilename (id_s, data_p);
+	char *filename_s = NULL;
+
+	RemoveStudyFromMemoryCache (id_s);
+
+	filename_s = GetFullCacheFilename (id_s, data_p);
 
 	if (filename_s)
 		{
@@ -2100,20 +2100,29 @@ OperationStatus GenerateStatisticsForStudy (Study *study_p, ServiceJob *job_p,
 {
 	OperationStatus status = OS_IDLE;
 
+	/*
+	 * The aggregated statistics don't need the study's plots
+	 * unless they are being checked against the in-process ones
+	 */
+	const bool needs_plots_flag = (! (data_p -> dftsd_aggregate_statistics_flag)) || (data_p -> dftsd_verify_statistics_flag);
+
 	/* Does the study already have its plots? */
-	if (study_p -> st_plots_p -> ll_size == 0)
+	if (needs_plots_flag && (study_p -> st_plots_p -> ll_size == 0))
 		{
+			/* The plots are only read to build the statistics */
+			UseStudyArena (study_p, data_p);
+
 			if (!GetStudyPlots (study_p, VF_STORAGE, data_p))
 				{
 					status = OS_FAILED;
 				}
 
-		}		/*( if (study_p -> st_plots_p -> ll_size == 0) */
+		}		/* if (needs_plots_flag && (study_p -> st_plots_p -> ll_size == 0)) */
 
 	if (status == OS_IDLE)
 		{
-			/* Does the study have any plots? */
-			if (study_p -> st_plots_p -> ll_size > 0)
+			/* Does the study have any plots? The aggregation finds this out for itself */
+			if ((data_p -> dftsd_aggregate_statistics_flag) || (study_p -> st_plots_p -> ll_size > 0))
 				{
 					status = CalculateStudyStatistics (study_p, data_p);
 
@@ -2184,6 +2193,9 @@ bool SaveStudyAsFrictionlessData (Study *study_p, FieldTrialServiceData *data_p)
 														{
 															if (json_array_append_new (resources_p, programme_fd_p) == 0)
 																{
+																	/* The plots are only read to write the data package */
+																	UseStudyArena (study_p, data_p);
+
 																	if (GetStudyPlots (study_p, VF_CLIENT_FULL, data_p))
 																		{
 																			json_t *study_fd_p = GetStudyAsFrictionlessDataResource (study_p, data_p);
@@ -2194,7 +2206,7 @@ bool SaveStudyAsFrictionlessData (Study *study_p, FieldTrialServiceData *data_p)
 																						{
 																							if (study_p -> st_plots_p -> ll_size > 0)
 																								{
-																									json_t *plots_fd_p = GetPlotsAsFDTabularPackage (study_p, data_p);
+																									json_t *plots_fd_p = SavePlotsAsFDTabularFile (study_p, data_p);
 
 																									if (plots_fd_p)
 																										{
@@ -2755,305 +2767,30 @@ json_t *GetStudyAsFrictionlessDataPackage (const Study *study_p, const FieldTria
 }
 
 
-OperationStatus CalculateStudyStatistics (Study *study_p, const FieldTrialServiceData *service_data_p)
+OperationStatus CalculateStudyStatistics (Study *study_p, FieldTrialServiceData *service_data_p)
 {
 	OperationStatus status = OS_FAILED;
-	size_t num_plots = study_p -> st_plots_p -> ll_size;
-	StatisticsTool *stats_tool_p = AllocateStatisticsTool (num_plots);
 
-	if (stats_tool_p)
+	/*
+	 * The in-process statistics are calculated from the Study's Plots
+	 * so make sure that they are loaded
+	 */
+	if (((! (service_data_p -> dftsd_aggregate_statistics_flag)) || (service_data_p -> dftsd_verify_statistics_flag)) && (study_p -> st_plots_p -> ll_size == 0))
 		{
-			char *key_s = ConcatenateVarargsStrings (PL_ROWS_S, ".", SR_OBSERVATIONS_S, ".", OB_PHENOTYPE_ID_S, NULL);
-
-			if (key_s)
-				{
-					StudyProcessData spd;
-
-					spd.spd_study_p = study_p;
-					spd.spd_stats_tool_p = stats_tool_p;
-
-					status = ProcessDistinctValues (study_p -> st_id_p, key_s, ProcessStudyPhenotype, &spd, service_data_p);
-
-					FreeCopiedString (key_s);
-				}		/* if (key_s) */
-			else
+			if (!GetStudyPlots (study_p, VF_STORAGE, service_data_p))
 				{
-					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "ConcatenateVarargsStrings () failed for \"%s\", \"%s\", \"%s\"", PL_ROWS_S, SR_OBSERVATIONS_S, OB_PHENOTYPE_ID_S);
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get plots for study \"%s\"", study_p -> st_name_s);
+					return status;
 				}
-
-			FreeStatisticsTool (stats_tool_p);
 		}
 
-
-	return status;
-}
-
-
-static bool ProcessStudyPhenotype (const char *phenotype_oid_s, void *user_data_p, const FieldTrialServiceData *service_data_p)
-{
-	bool success_flag = false;
-	MeasuredVariable *phenotype_p = GetMeasuredVariableByIdString (phenotype_oid_s, service_data_p);
-
-	if (phenotype_p)
+	if (service_data_p -> dftsd_aggregate_statistics_flag)
 		{
-			const ScaleClass *class_p = GetMeasuredVariableScaleClass (phenotype_p);
-			const char *mv_s = GetMeasuredVariableName (phenotype_p);
-			Statistics *stats_p = NULL;
-			PhenotypeStatisticsNode *node_p = NULL;
-			StudyProcessData *spd_p = (StudyProcessData *) user_data_p;
-			Study *study_p = spd_p -> spd_study_p;
-
-			if (class_p)
-				{
-					/*
-					 * Is it a numerical phenotype?
-					 */
-					if (strcmp (class_p -> sc_name_s, SCALE_NUMERICAL.sc_name_s) == 0)
-						{
-							StatisticsTool *stats_tool_p = spd_p -> spd_stats_tool_p;
-							PlotNode *plot_node_p = (PlotNode *) (study_p -> st_plots_p -> ll_head_p);
-
-							ResetStatisticsTool (stats_tool_p);
-
-							while (plot_node_p)
-								{
-									Plot *plot_p = plot_node_p -> pn_plot_p;
-
-									/*
-									 * Are there any rows?
-									 */
-									if (plot_p -> pl_rows_p -> ll_size > 0)
-										{
-											RowNode *row_node_p = (RowNode *) (plot_p -> pl_rows_p -> ll_head_p);
-
-											while (row_node_p)
-												{
-													Row *row_p = row_node_p -> rn_row_p;
-
-													/*
-													 * Is it a standard row?
-													 */
-													if (row_p -> ro_type == RT_STANDARD)
-														{
-															StandardRow *standard_row_p = (StandardRow *) row_p;
-
-															/*
-															 * Are there any observations?
-															 */
-															if (standard_row_p -> sr_observations_p -> ll_size > 0)
-																{
-																	Observation *obs_p = GetMatchingObservation (standard_row_p, phenotype_p, NULL);
-
-																	if (obs_p)
-																		{
-																			if (obs_p -> ob_type == OT_NUMERIC)
-																				{
-																					NumericObservation *num_obs_p = (NumericObservation *) obs_p;
-																					double d;
-																					bool value_flag = true;
-
-																					if (num_obs_p -> no_corrected_value_p)
-																						{
-																							d = * (num_obs_p -> no_corrected_value_p);
-																						}
-																					else if (num_obs_p -> no_raw_value_p)
-																						{
-																							d = * (num_obs_p -> no_raw_value_p);
-																						}
-																					else
-																						{
-																							value_flag = false;
-																						}
-
-																					if (value_flag)
-																						{
-																							if (!AddStatisticsValue (stats_tool_p, d))
-																								{
-																									char *obs_id_s = GetBSONOidAsString (obs_p -> ob_id_p);
-																									const char *phenotype_s = GetMeasuredVariableName (phenotype_p);
-
-																									if (obs_id_s)
-																										{
-																											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add %lf to \"%s\" for variable \"%s\"", d, obs_id_s, phenotype_s);
-																											FreeBSONOidString (obs_id_s);
-																										}
-																									else
-																										{
-																											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add %lf for variable \"%s\"", d, phenotype_s);
-																										}
-																								}
-																						}
-
-																				}
-																		}
-																}
-
-														}		/* if (row_p -> ro_type == RT_STANDARD) */
-
-
-
-													row_node_p = (RowNode *) (row_node_p -> rn_node.ln_next_p);
-												}		/* while (row_node_p) */
-
-										}		/* if (plot_p -> pl_rows_p -> ll_size > 0) */
-
-									plot_node_p = (PlotNode *) (plot_node_p -> pn_node.ln_next_p);
-								}		/* while (plot_node_p) */
-
-
-							/*
-							 * Do we have any stats?
-							 */
-							if (stats_tool_p -> st_current_index > 0)
-								{
-									CalculateStatistics (stats_tool_p);
-
-									stats_p = & (stats_tool_p -> st_stats);
-								}
-
-						}		/* if (strcmp (class_p -> sc_name_s, SCALE_NUMERICAL -> sc_name_s) == 0) */
-
-				}		/* if (class_p) */
-
-
-			if (AddPhenotypeStatisticsToStudy (study_p, mv_s, stats_p))
-				{
-					success_flag = true;
-				}
-
-
-			FreeMeasuredVariable (phenotype_p);
-		}		/* if (phenotype_p) */
-
-	return success_flag;
-}
-
-
-static OperationStatus ProcessDistinctValues (bson_oid_t *study_id_p, const char *key_s, bool (*process_value_fn) (const char *oid_s, void *user_data_p, const FieldTrialServiceData *service_data_p), void *user_data_p, const FieldTrialServiceData *service_data_p)
-{
-	OperationStatus status = OS_FAILED_TO_START;
-
-	if (SetMongoToolCollection (service_data_p -> dftsd_mongo_p, service_data_p -> dftsd_collection_ss [DFTD_PLOT]))
+			status = CalculatePhenotypeStatisticsForStudyByAggregation (study_p, service_data_p);
+		}
+	else
 		{
-			bson_t *command_p = BCON_NEW ("distinct",
-																		BCON_UTF8 (service_data_p -> dftsd_collection_ss [DFTD_PLOT]),
-																		"key",
-																		BCON_UTF8 (key_s),
-																		"query",
-																		"{",
-																		PL_PARENT_STUDY_S,
-																		BCON_OID (study_id_p),
-																		"}");
-
-			if (command_p)
-				{
-					bson_t *reply_p = NULL;
-
-					if (RunMongoCommand (service_data_p -> dftsd_mongo_p, command_p, &reply_p))
-						{
-							if (reply_p)
-								{
-									json_t *results_p = ConvertBSONToJSON (reply_p, NULL);
-
-									if (results_p)
-										{
-											json_t *oid_values_p = json_object_get (results_p, "values");
-
-											if (oid_values_p)
-												{
-													if (json_is_array (oid_values_p))
-														{
-															json_t *oid_value_p;
-															size_t i;
-															const size_t size = json_array_size (oid_values_p);
-															size_t num_successes = 0;
-
-															/*
-															 * Create a stats list node for each measured variable
-															 */
-
-															json_array_foreach (oid_values_p, i, oid_value_p)
-															{
-																const char *oid_s = GetJSONString (oid_value_p, "$oid");
-
-																if (oid_s)
-																	{
-																		if (process_value_fn (oid_s, user_data_p, service_data_p))
-																			{
-																				++ num_successes;
-																			}
-																		else
-																			{
-																				PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to process data for\"%s\"", oid_s);
-																			}
-																	}		/* if (oid_s) */
-
-															}		/* json_array_foreach (oids_p, i, oid_p) */
-
-
-															if (num_successes == size)
-																{
-																	status = OS_SUCCEEDED;
-																}
-															else if (num_successes > 0)
-																{
-																	status = OS_PARTIALLY_SUCCEEDED;
-																}
-															else
-																{
-																	status = OS_FAILED;
-																}
-
-														}		/* if (json_is_array (oids_p)) */
-
-												}		/* if (oids_p) */
-
-
-											json_decref (results_p);
-										}		/* if (results_p) */
-
-
-									bson_destroy (reply_p);
-								}		/* if (reply_p) */
-							else
-								{
-									size_t length;
-									char *json_s = ConvertBSONToJSON (command_p, &length);
-									if (json_s)
-										{
-											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "RunMongoCommand had empty reply for \"%s\"", json_s);
-											bson_free (json_s);
-										}
-									else
-										{
-											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "RunMongoCommand had empty reply");
-										}
-
-								}
-						}		/* if (RunMongoCommand (data_p -> dftsd_mongo_p, command_p, &reply_p)) */
-					else
-						{
-							size_t length;
-							char *json_s = ConvertBSONToJSON (command_p, &length);
-
-							if (json_s)
-								{
-									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "RunMongoCommand failed for \"%s\"", json_s);
-									bson_free (json_s);
-								}
-							else
-								{
-									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "RunMongoCommand failed");
-								}
-						}
-
-					bson_destroy (command_p);
-				}		/* if (command_p) */
-			else
-				{
-					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create command");
-				}
-
+			status = CalculatePhenotypeStatisticsForStudy (study_p, service_data_p);
 		}
 
 	return status;
@@ -3343,7 +3080,7 @@ static bool AddTermToJSON (const SchemaTerm *term_p, json_t *phenotypes_p)
 bool SetUpStudiesListParameter (const FieldTrialServiceData *data_p, Parameter *param_p, const Study *active_study_p, const bool empty_option_flag)
 {
 	bool success_flag = false;
-	json_t *results_p = GetAllStudiesAsJSON (data_p, false);
+	json_t *results_p = GetOptionListDocuments (DFTD_STUDY, data_p);
 	bool value_set_flag = false;
 
 	if (results_p)
@@ -3640,7 +3377,17 @@ json_t *GetStudyJSONForId (const char *id_s, const ViewFormat format, JSONProces
 										{
 											if (format == VF_CLIENT_FULL)
 												{
-													CacheStudy (id_s, study_json_p, data_p);
+													bool cache_flag = true;
+
+													#ifdef ENABLE_MARTI
+													/* Don't keep the JSON until the MARTi samples are available */
+													cache_flag = !IsMartiResultPending (study_json_p);
+													#endif
+
+													if (cache_flag)
+														{
+															CacheStudy (id_s, study_json_p, data_p);
+														}
 												}
 
 											*study_name_ss = EasyCopyToNewString (study_p -> st_name_s);
@@ -4205,6 +3952,11 @@ OperationStatus RemovePlotsForStudyById (const char *id_s, FieldTrialServiceData
 											if (RemoveMongoDocumentsByBSON (tool_p, query_p, false))
 												{
 													status = OS_SUCCEEDED;
+
+													if (!RemoveMaterialUsageForStudy (id_p, data_p))
+														{
+															PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to remove material usage for \"%s\"", id_s);
+														}
 												}
 											else
 												{
@@ -4410,6 +4162,7 @@ OperationStatus DeleteStudyById (const char *id_s, ServiceJob *job_p, FieldTrial
 										{
 											if (RemoveMongoDocumentsByBSON (tool_p, query_p, false))
 												{
+													ClearOptionListCache (DFTD_STUDY, data_p);
 													status = RemovePlotsForStudyById (id_s, data_p);
 												}
 										}
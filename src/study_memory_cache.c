@@ -0,0 +1,499 @@
+/*
+ * study_memory_cache.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#include "study_memory_cache.h"
+#include "dfw_util.h"
+
+#include "memory_allocations.h"
+#include "json_util.h"
+#include "streams.h"
+
+
+/**
+ * A Study's JSON stored in the in-memory cache.
+ */
+typedef struct StudyMemoryCacheEntry
+{
+	/** The base list node. */
+	ListItem smce_node;
+
+	/** The id of the Study, which is also the key for the lookup table. */
+	char smce_id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+	/**
+	 * The Study's JSON. This is shared with the callers of
+	 * GetStudyFromMemoryCache () so it is never modified.
+	 */
+	json_t *smce_study_json_p;
+
+	/** The estimated number of bytes of heap used by the Study's JSON. */
+	size_t smce_size;
+
+	/**
+	 * The details of the on-disk cache file that the JSON came from.
+	 * If the file is changed or removed, possibly by another process,
+	 * the entry is no longer used.
+	 */
+	struct stat smce_file_stats;
+
+} StudyMemoryCacheEntry;
+
+
+/**
+ * The in-memory cache of Studies that is shared by all of the
+ * services in this process.
+ */
+typedef struct StudyMemoryCache
+{
+	pthread_mutex_t smc_mutex;
+
+	/**
+	 * The StudyMemoryCacheEntries with the most
+	 * recently used at the head.
+	 */
+	LinkedList *smc_entries_p;
+
+	/** A table to look up the entries by Study id. */
+	HashTable *smc_table_p;
+
+	/** The maximum total heap size in bytes of the cached Studies. */
+	size_t smc_max_size;
+
+	/** The current total heap size in bytes of the cached Studies. */
+	size_t smc_current_size;
+
+	size_t smc_hits;
+
+	size_t smc_misses;
+
+	size_t smc_evictions;
+
+	/** The number of entries dropped because their cache file had changed. */
+	size_t smc_stale;
+
+} StudyMemoryCache;
+
+
+static StudyMemoryCache s_cache = { PTHREAD_MUTEX_INITIALIZER, NULL, NULL, 0, 0, 0, 0, 0, 0 };
+
+
+/*
+ * The approximate number of bytes that jansson allocates for each type
+ * of value, including the allocator's own overhead, on a 64-bit system.
+ * These are used to estimate how much memory a cached Study takes up.
+ */
+#define SMC_ALLOCATION_OVERHEAD (16)
+
+#define SMC_OBJECT_SIZE (64 + SMC_ALLOCATION_OVERHEAD)
+
+#define SMC_OBJECT_MEMBER_SIZE (56 + SMC_ALLOCATION_OVERHEAD)
+
+#define SMC_OBJECT_BUCKET_SIZE (16)
+
+#define SMC_ARRAY_SIZE (40 + SMC_ALLOCATION_OVERHEAD)
+
+#define SMC_STRING_SIZE (32 + SMC_ALLOCATION_OVERHEAD)
+
+#define SMC_NUMBER_SIZE (24 + SMC_ALLOCATION_OVERHEAD)
+
+
+static bool InitStudyMemoryCache (const FieldTrialServiceData *data_p);
+
+static void FreeStudyMemoryCacheEntry (ListItem *node_p);
+
+static void RemoveStudyMemoryCacheEntry (StudyMemoryCacheEntry *entry_p);
+
+static bool AddStudyToMemoryCache (const char *id_s, const struct stat *file_stats_p, json_t *study_json_p, const FieldTrialServiceData *data_p);
+
+static bool IsStudyMemoryCacheEntryCurrent (const StudyMemoryCacheEntry *entry_p, const char *filename_s);
+
+static bool AreFileStatsEqual (const struct stat *stats_0_p, const struct stat *stats_1_p);
+
+static size_t GetJSONHeapSize (const json_t *value_p);
+
+
+
+json_t *GetStudyFromMemoryCache (const char *id_s, const char *filename_s, const FieldTrialServiceData *data_p)
+{
+	json_t *study_json_p = NULL;
+
+	pthread_mutex_lock (& (s_cache.smc_mutex));
+
+	if (InitStudyMemoryCache (data_p))
+		{
+			StudyMemoryCacheEntry *entry_p = (StudyMemoryCacheEntry *) GetFromHashTable (s_cache.smc_table_p, id_s);
+
+			if (entry_p && !IsStudyMemoryCacheEntryCurrent (entry_p, filename_s))
+				{
+					RemoveStudyMemoryCacheEntry (entry_p);
+					entry_p = NULL;
+
+					++ (s_cache.smc_stale);
+				}
+
+			if (entry_p)
+				{
+					/*
+					 * Rather than copying the whole Study, the caller
+					 * shares the cached JSON and mustn't modify it
+					 */
+					study_json_p = json_incref (entry_p -> smce_study_json_p);
+
+					/* Move it to the front as the most recently used */
+					LinkedListRemove (s_cache.smc_entries_p, & (entry_p -> smce_node));
+					LinkedListAddHead (s_cache.smc_entries_p, & (entry_p -> smce_node));
+
+					++ (s_cache.smc_hits);
+				}
+			else
+				{
+					++ (s_cache.smc_misses);
+				}
+		}
+
+	pthread_mutex_unlock (& (s_cache.smc_mutex));
+
+	return study_json_p;
+}
+
+
+json_t *LoadStudyIntoMemoryCache (const char *id_s, const char *filename_s, const FieldTrialServiceData *data_p)
+{
+	json_t *study_json_p = NULL;
+	struct stat before_stats;
+	json_error_t err;
+
+	/*
+	 * We need the details of the file so that we can tell if another
+	 * process changes it.
+	 */
+	const bool stats_flag = (data_p -> dftsd_study_memory_cache_size > 0) && (stat (filename_s, &before_stats) == 0);
+
+	study_json_p = json_load_file (filename_s, 0, &err);
+
+	if (study_json_p)
+		{
+			if (stats_flag)
+				{
+					struct stat after_stats;
+
+					/*
+					 * Only keep the JSON if the file wasn't changed while we were loading it
+					 */
+					if ((stat (filename_s, &after_stats) == 0) && (AreFileStatsEqual (&before_stats, &after_stats)))
+						{
+							AddStudyToMemoryCache (id_s, &after_stats, study_json_p, data_p);
+						}
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to load cached study from \"%s\", error \"%s\" at [%d, %d]", filename_s, err.text, err.line, err.column);
+		}
+
+	return study_json_p;
+}
+
+
+static bool AddStudyToMemoryCache (const char *id_s, const struct stat *file_stats_p, json_t *study_json_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	size_t size;
+
+	if (strlen (id_s) >= MONGO_OID_STRING_BUFFER_SIZE)
+		{
+			return false;
+		}
+
+	size = GetJSONHeapSize (study_json_p);
+
+	pthread_mutex_lock (& (s_cache.smc_mutex));
+
+	if (InitStudyMemoryCache (data_p))
+		{
+			StudyMemoryCacheEntry *entry_p = (StudyMemoryCacheEntry *) GetFromHashTable (s_cache.smc_table_p, id_s);
+
+			if (entry_p)
+				{
+					RemoveStudyMemoryCacheEntry (entry_p);
+				}
+
+			/*
+			 * Don't let a single Study flush everything else out
+			 */
+			if (size <= s_cache.smc_max_size)
+				{
+					entry_p = (StudyMemoryCacheEntry *) AllocMemory (sizeof (StudyMemoryCacheEntry));
+
+					if (entry_p)
+						{
+							InitListItem (& (entry_p -> smce_node));
+							strcpy (entry_p -> smce_id_s, id_s);
+							entry_p -> smce_size = size;
+							entry_p -> smce_file_stats = *file_stats_p;
+							entry_p -> smce_study_json_p = json_incref (study_json_p);
+
+							if (PutInHashTable (s_cache.smc_table_p, entry_p -> smce_id_s, entry_p))
+								{
+									LinkedListAddHead (s_cache.smc_entries_p, & (entry_p -> smce_node));
+									s_cache.smc_current_size += size;
+
+									/*
+									 * Remove the least recently used entries until we are within our limit
+									 */
+									while (s_cache.smc_current_size > s_cache.smc_max_size)
+										{
+											RemoveStudyMemoryCacheEntry ((StudyMemoryCacheEntry *) (s_cache.smc_entries_p -> ll_tail_p));
+											++ (s_cache.smc_evictions);
+										}
+
+									success_flag = true;
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add study \"%s\" to memory cache", id_s);
+									FreeStudyMemoryCacheEntry (& (entry_p -> smce_node));
+								}
+						}
+
+				}		/* if (size <= s_cache.smc_max_size) */
+
+		}		/* if (InitStudyMemoryCache (data_p)) */
+
+	pthread_mutex_unlock (& (s_cache.smc_mutex));
+
+	return success_flag;
+}
+
+
+void RemoveStudyFromMemoryCache (const char *id_s)
+{
+	pthread_mutex_lock (& (s_cache.smc_mutex));
+
+	if (s_cache.smc_table_p)
+		{
+			StudyMemoryCacheEntry *entry_p = (StudyMemoryCacheEntry *) GetFromHashTable (s_cache.smc_table_p, id_s);
+
+			if (entry_p)
+				{
+					RemoveStudyMemoryCacheEntry (entry_p);
+				}
+		}
+
+	pthread_mutex_unlock (& (s_cache.smc_mutex));
+}
+
+
+void ClearStudyMemoryCache (void)
+{
+	pthread_mutex_lock (& (s_cache.smc_mutex));
+
+	if (s_cache.smc_entries_p)
+		{
+			while (s_cache.smc_entries_p -> ll_head_p)
+				{
+					RemoveStudyMemoryCacheEntry ((StudyMemoryCacheEntry *) (s_cache.smc_entries_p -> ll_head_p));
+				}
+		}
+
+	pthread_mutex_unlock (& (s_cache.smc_mutex));
+}
+
+
+json_t *GetStudyMemoryCacheStatisticsAsJSON (void)
+{
+	json_t *stats_p = NULL;
+
+	pthread_mutex_lock (& (s_cache.smc_mutex));
+
+	stats_p = json_pack ("{s:I,s:I,s:I,s:I,s:I,s:I,s:I}",
+											 "hits", (json_int_t) s_cache.smc_hits,
+											 "misses", (json_int_t) s_cache.smc_misses,
+											 "evictions", (json_int_t) s_cache.smc_evictions,
+											 "stale", (json_int_t) s_cache.smc_stale,
+											 "entries", (json_int_t) (s_cache.smc_entries_p ? s_cache.smc_entries_p -> ll_size : 0),
+											 "size", (json_int_t) s_cache.smc_current_size,
+											 "max_size", (json_int_t) s_cache.smc_max_size);
+
+	pthread_mutex_unlock (& (s_cache.smc_mutex));
+
+	if (!stats_p)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create study memory cache statistics");
+		}
+
+	return stats_p;
+}
+
+
+/*
+ * This must be called with the cache's mutex locked.
+ */
+static bool InitStudyMemoryCache (const FieldTrialServiceData *data_p)
+{
+	if (data_p -> dftsd_study_memory_cache_size == 0)
+		{
+			return false;
+		}
+
+	if (!s_cache.smc_entries_p)
+		{
+			s_cache.smc_entries_p = AllocateLinkedList (FreeStudyMemoryCacheEntry);
+
+			if (s_cache.smc_entries_p)
+				{
+					s_cache.smc_table_p = GetHashTableOfStringPointers (64, 75);
+
+					if (s_cache.smc_table_p)
+						{
+							s_cache.smc_max_size = data_p -> dftsd_study_memory_cache_size;
+						}
+					else
+						{
+							FreeLinkedList (s_cache.smc_entries_p);
+							s_cache.smc_entries_p = NULL;
+						}
+				}
+
+			if (!s_cache.smc_entries_p)
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate study memory cache");
+				}
+		}
+
+	return (s_cache.smc_entries_p != NULL);
+}
+
+
+static void FreeStudyMemoryCacheEntry (ListItem *node_p)
+{
+	StudyMemoryCacheEntry *entry_p = (StudyMemoryCacheEntry *) node_p;
+
+	if (entry_p -> smce_study_json_p)
+		{
+			json_decref (entry_p -> smce_study_json_p);
+		}
+
+	FreeMemory (entry_p);
+}
+
+
+/*
+ * This must be called with the cache's mutex locked.
+ */
+static void RemoveStudyMemoryCacheEntry (StudyMemoryCacheEntry *entry_p)
+{
+	RemoveFromHashTable (s_cache.smc_table_p, entry_p -> smce_id_s);
+	LinkedListRemove (s_cache.smc_entries_p, & (entry_p -> smce_node));
+
+	s_cache.smc_current_size -= entry_p -> smce_size;
+
+	FreeStudyMemoryCacheEntry (& (entry_p -> smce_node));
+}
+
+
+/*
+ * Check that the on-disk cache file hasn't been changed or removed
+ * since the entry was made from it.
+ */
+static bool IsStudyMemoryCacheEntryCurrent (const StudyMemoryCacheEntry *entry_p, const char *filename_s)
+{
+	struct stat file_stats;
+
+	return ((stat (filename_s, &file_stats) == 0) && (AreFileStatsEqual (& (entry_p -> smce_file_stats), &file_stats)));
+}
+
+
+/*
+ * The sub-second times are in differently named fields on each
+ * platform so only the whole seconds are compared. The on-disk cache
+ * files are replaced rather than rewritten in place, so a change within
+ * the same second still gives a different inode.
+ */
+static bool AreFileStatsEqual (const struct stat *stats_0_p, const struct stat *stats_1_p)
+{
+	return ((stats_0_p -> st_ino == stats_1_p -> st_ino) &&
+					(stats_0_p -> st_size == stats_1_p -> st_size) &&
+					(stats_0_p -> st_mtime == stats_1_p -> st_mtime) &&
+					(stats_0_p -> st_ctime == stats_1_p -> st_ctime));
+}
+
+
+/*
+ * Estimate the number of bytes of heap that jansson uses to hold
+ * a value and all of its children.
+ */
+static size_t GetJSONHeapSize (const json_t *value_p)
+{
+	size_t size = 0;
+
+	switch (json_typeof (value_p))
+		{
+			case JSON_OBJECT:
+				{
+					const char *key_s;
+					json_t *child_p;
+					size_t num_buckets = 8;
+
+					size = SMC_OBJECT_SIZE;
+
+					json_object_foreach ((json_t *) value_p, key_s, child_p)
+						{
+							size += SMC_OBJECT_MEMBER_SIZE + strlen (key_s) + 1 + GetJSONHeapSize (child_p);
+						}
+
+					/* The hash table doubles in size as it fills up */
+					while (num_buckets < json_object_size (value_p))
+						{
+							num_buckets <<= 1;
+						}
+
+					size += num_buckets * SMC_OBJECT_BUCKET_SIZE;
+				}
+				break;
+
+			case JSON_ARRAY:
+				{
+					const size_t num_entries = json_array_size (value_p);
+					size_t capacity = 8;
+					size_t i;
+
+					/* The table of entries grows by doubling */
+					while (capacity < num_entries)
+						{
+							capacity <<= 1;
+						}
+
+					size = SMC_ARRAY_SIZE + (capacity * sizeof (json_t *)) + SMC_ALLOCATION_OVERHEAD;
+
+					for (i = 0; i < num_entries; ++ i)
+						{
+							size += GetJSONHeapSize (json_array_get (value_p, i));
+						}
+				}
+				break;
+
+			case JSON_STRING:
+				size = SMC_STRING_SIZE + json_string_length (value_p) + 1 + SMC_ALLOCATION_OVERHEAD;
+				break;
+
+			case JSON_INTEGER:
+			case JSON_REAL:
+				size = SMC_NUMBER_SIZE;
+				break;
+
+			default:
+				/* true, false and null are shared singletons */
+				break;
+		}
+
+	return size;
+}
@@ -0,0 +1,859 @@
+/*
+ * study_post_save_queue.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+
+#include "study_post_save_queue.h"
+#include "indexing.h"
+
+#include "memory_allocations.h"
+#include "mongodb_tool.h"
+#include "streams.h"
+
+
+/*
+ * How often, in seconds, that idle workers check for entries
+ * that have been queued by other processes.
+ */
+#define SPSQ_POLL_INTERVAL (30)
+
+
+/*
+ * The MongoDB error code for a duplicate key.
+ */
+#define SPSQ_DUPLICATE_KEY_ERROR (11000)
+
+
+/*
+ * The collection holding the queue. There is a document for each
+ * rebuild with the following keys:
+ *
+ * S_STUDY_ID_S: The id of the Study.
+ * S_STATUS_S: The OperationStatus of the rebuild as a string.
+ * S_QUEUED_S: The time that the rebuild was queued.
+ * S_DUE_S: The time after which the Study can be rebuilt.
+ * S_STARTED_S: The time that the rebuild started.
+ * S_FINISHED_S: The time that the rebuild finished.
+ * S_ERRORS_S: Any errors from the rebuild's ServiceJob.
+ *
+ * All of the times are in seconds since the epoch.
+ */
+static const char * const S_POST_SAVE_COLLECTION_S = "StudyPostSaveQueue";
+
+static const char * const S_STUDY_ID_S = "study_id";
+
+static const char * const S_STATUS_S = "status";
+
+static const char * const S_QUEUED_S = "queued";
+
+static const char * const S_DUE_S = "due";
+
+static const char * const S_STARTED_S = "started";
+
+static const char * const S_FINISHED_S = "finished";
+
+static const char * const S_ERRORS_S = "errors";
+
+
+/*
+ * The unique index that stops a Study from having more than one
+ * pending entry when it is queued by several processes at once.
+ */
+static const char * const S_PENDING_INDEX_S = "study_id_1_status_1_pending";
+
+
+/**
+ * The workers that process the queue.
+ */
+typedef struct StudyPostSaveQueue
+{
+	pthread_mutex_t spsq_mutex;
+
+	/**
+	 * Signalled when a Study has been queued or a rebuild has
+	 * finished so that idle workers check the queue again.
+	 */
+	pthread_cond_t spsq_cond;
+
+	pthread_t *spsq_workers_p;
+
+	uint32 spsq_num_workers;
+
+	/** Set by StopStudyPostSaveQueue () to make the workers exit. */
+	bool spsq_stop_flag;
+
+	GrassrootsServer *spsq_grassroots_p;
+
+} StudyPostSaveQueue;
+
+
+/**
+ * The data passed to each worker thread.
+ */
+typedef struct StudyPostSaveWorker
+{
+	StudyPostSaveQueue *spsw_queue_p;
+
+	uint32 spsw_index;
+
+} StudyPostSaveWorker;
+
+
+/*
+ * The workers are shared by all of the services in this process and
+ * run until StopStudyPostSaveQueue () is called when this library
+ * is unloaded.
+ */
+static StudyPostSaveQueue *s_queue_p = NULL;
+
+static pthread_mutex_t s_queue_init_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+
+static StudyPostSaveQueue *GetStudyPostSaveQueue (FieldTrialServiceData *data_p);
+
+static StudyPostSaveQueue *AllocateStudyPostSaveQueue (const uint32 num_workers, GrassrootsServer *grassroots_p);
+
+static void AddStudyPostSaveIndexes (const FieldTrialServiceData *data_p);
+
+static void StopStudyPostSaveQueueOnUnload (void) __attribute__ ((destructor));
+
+static void FreeStudyPostSaveQueue (StudyPostSaveQueue *queue_p);
+
+static void *RunStudyPostSaveWorker (void *data_p);
+
+static bool AddStudyPostSaveEntry (const bson_oid_t *study_id_p, const uint32 delay, const FieldTrialServiceData *data_p);
+
+static bool ClaimNextStudyPostSaveEntry (bson_oid_t *entry_id_p, bson_oid_t *study_id_p, time_t *wait_until_p, const FieldTrialServiceData *data_p);
+
+static bool IsStudyRunning (mongoc_collection_t *collection_p, const bson_oid_t *study_id_p, const time_t stale_time);
+
+static bool ClaimStudyPostSaveEntry (mongoc_collection_t *collection_p, const bson_t *entry_p, const time_t now);
+
+static bool FinishStudyPostSaveEntry (const bson_oid_t *entry_id_p, const bson_oid_t *study_id_p, const OperationStatus status, json_t *errors_p, const FieldTrialServiceData *data_p);
+
+static void RunQueuedStudyPostSaveTasks (const bson_oid_t *entry_id_p, const bson_oid_t *study_id_p, Service *service_p);
+
+
+
+bool StartStudyPostSaveQueue (FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (data_p -> dftsd_post_save_num_workers > 0)
+		{
+			if (GetStudyPostSaveQueue (data_p))
+				{
+					success_flag = true;
+				}
+		}
+
+	return success_flag;
+}
+
+
+void StopStudyPostSaveQueue (void)
+{
+	pthread_mutex_lock (&s_queue_init_mutex);
+
+	if (s_queue_p)
+		{
+			uint32 i;
+
+			pthread_mutex_lock (& (s_queue_p -> spsq_mutex));
+			s_queue_p -> spsq_stop_flag = true;
+			pthread_cond_broadcast (& (s_queue_p -> spsq_cond));
+			pthread_mutex_unlock (& (s_queue_p -> spsq_mutex));
+
+			/*
+			 * Any rebuilds that are in progress are allowed to finish.
+			 * Those that are still pending stay in the collection and
+			 * will be run when the queue is next started.
+			 */
+			for (i = 0; i < s_queue_p -> spsq_num_workers; ++ i)
+				{
+					pthread_join (* ((s_queue_p -> spsq_workers_p) + i), NULL);
+				}
+
+			PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Stopped " UINT32_FMT " post-save workers", s_queue_p -> spsq_num_workers);
+
+			FreeStudyPostSaveQueue (s_queue_p);
+			s_queue_p = NULL;
+		}
+
+	pthread_mutex_unlock (&s_queue_init_mutex);
+}
+
+
+static void StopStudyPostSaveQueueOnUnload (void)
+{
+	StopStudyPostSaveQueue ();
+}
+
+
+bool QueueStudyPostSaveTasks (const Study *study_p, FieldTrialServiceData *data_p)
+{
+	bool queued_flag = false;
+
+	if (data_p -> dftsd_post_save_num_workers > 0)
+		{
+			StudyPostSaveQueue *queue_p = GetStudyPostSaveQueue (data_p);
+
+			if (queue_p)
+				{
+					if (AddStudyPostSaveEntry (study_p -> st_id_p, data_p -> dftsd_post_save_delay, data_p))
+						{
+							pthread_mutex_lock (& (queue_p -> spsq_mutex));
+							pthread_cond_broadcast (& (queue_p -> spsq_cond));
+							pthread_mutex_unlock (& (queue_p -> spsq_mutex));
+
+							queued_flag = true;
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to queue post-save tasks for Study \"%s\"", study_p -> st_name_s);
+						}
+				}		/* if (queue_p) */
+
+		}		/* if (data_p -> dftsd_post_save_num_workers > 0) */
+
+	return queued_flag;
+}
+
+
+json_t *GetStudyPostSaveStatus (const bson_oid_t *study_id_p, const FieldTrialServiceData *data_p)
+{
+	json_t *results_p = NULL;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_POST_SAVE_COLLECTION_S))
+		{
+			bson_t *query_p = BCON_NEW (S_STUDY_ID_S, BCON_OID (study_id_p));
+
+			if (query_p)
+				{
+					bson_t *opts_p = BCON_NEW ("sort", "{", S_QUEUED_S, BCON_INT32 (1), "}");
+
+					if (opts_p)
+						{
+							results_p = GetAllMongoResultsAsJSON (data_p -> dftsd_mongo_p, query_p, opts_p);
+
+							if (!results_p)
+								{
+									PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Failed to get post-save status");
+								}
+
+							bson_destroy (opts_p);
+						}
+
+					bson_destroy (query_p);
+				}
+		}
+
+	return results_p;
+}
+
+
+
+static StudyPostSaveQueue *GetStudyPostSaveQueue (FieldTrialServiceData *data_p)
+{
+	StudyPostSaveQueue *queue_p = NULL;
+
+	pthread_mutex_lock (&s_queue_init_mutex);
+
+	if (!s_queue_p)
+		{
+			GrassrootsServer *grassroots_p = data_p -> dftsd_base_data.sd_service_p -> se_grassroots_p;
+
+			AddStudyPostSaveIndexes (data_p);
+
+			s_queue_p = AllocateStudyPostSaveQueue (data_p -> dftsd_post_save_num_workers, grassroots_p);
+		}
+
+	queue_p = s_queue_p;
+
+	pthread_mutex_unlock (&s_queue_init_mutex);
+
+	return queue_p;
+}
+
+
+static StudyPostSaveQueue *AllocateStudyPostSaveQueue (const uint32 num_workers, GrassrootsServer *grassroots_p)
+{
+	StudyPostSaveQueue *queue_p = (StudyPostSaveQueue *) AllocMemory (sizeof (StudyPostSaveQueue));
+
+	if (queue_p)
+		{
+			queue_p -> spsq_workers_p = (pthread_t *) AllocMemoryArray (num_workers, sizeof (pthread_t));
+
+			if (queue_p -> spsq_workers_p)
+				{
+					pthread_mutex_init (& (queue_p -> spsq_mutex), NULL);
+					pthread_cond_init (& (queue_p -> spsq_cond), NULL);
+
+					queue_p -> spsq_num_workers = 0;
+					queue_p -> spsq_stop_flag = false;
+					queue_p -> spsq_grassroots_p = grassroots_p;
+
+					while (queue_p -> spsq_num_workers < num_workers)
+						{
+							StudyPostSaveWorker *worker_p = (StudyPostSaveWorker *) AllocMemory (sizeof (StudyPostSaveWorker));
+
+							if (worker_p)
+								{
+									worker_p -> spsw_queue_p = queue_p;
+									worker_p -> spsw_index = queue_p -> spsq_num_workers;
+
+									if (pthread_create ((queue_p -> spsq_workers_p) + (queue_p -> spsq_num_workers), NULL, RunStudyPostSaveWorker, worker_p) == 0)
+										{
+											++ (queue_p -> spsq_num_workers);
+										}
+									else
+										{
+											PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to start post-save worker " UINT32_FMT, queue_p -> spsq_num_workers);
+											FreeMemory (worker_p);
+											break;
+										}
+								}
+							else
+								{
+									break;
+								}
+						}
+
+					/*
+					 * As long as we have some workers, we can use the queue
+					 */
+					if (queue_p -> spsq_num_workers > 0)
+						{
+							PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Started " UINT32_FMT " post-save workers", queue_p -> spsq_num_workers);
+							return queue_p;
+						}
+
+					pthread_cond_destroy (& (queue_p -> spsq_cond));
+					pthread_mutex_destroy (& (queue_p -> spsq_mutex));
+
+					FreeMemory (queue_p -> spsq_workers_p);
+				}		/* if (queue_p -> spsq_workers_p) */
+
+			FreeMemory (queue_p);
+		}		/* if (queue_p) */
+
+	PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to start post-save queue, studies will be processed when saved");
+
+	return NULL;
+}
+
+
+static void AddStudyPostSaveIndexes (const FieldTrialServiceData *data_p)
+{
+	const char *keys_ss [] = { S_STUDY_ID_S, S_STATUS_S, NULL };
+	const char **key_ss = keys_ss;
+
+	while (*key_ss)
+		{
+			if (!AddCollectionSingleIndex (data_p -> dftsd_mongo_p, NULL, S_POST_SAVE_COLLECTION_S, *key_ss, NULL, false, false))
+				{
+					PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add index on \"%s\" to \"%s\"", *key_ss, S_POST_SAVE_COLLECTION_S);
+				}
+
+			++ key_ss;
+		}
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_POST_SAVE_COLLECTION_S))
+		{
+			/*
+			 * AddCollectionCompoundIndex () can't make a partial index so
+			 * run the command ourselves
+			 */
+			bson_t *command_p = BCON_NEW ("createIndexes", BCON_UTF8 (S_POST_SAVE_COLLECTION_S),
+																		"indexes", "[",
+																			"{",
+																				"key", "{", S_STUDY_ID_S, BCON_INT32 (1), S_STATUS_S, BCON_INT32 (1), "}",
+																				"name", BCON_UTF8 (S_PENDING_INDEX_S),
+																				"unique", BCON_BOOL (true),
+																				"partialFilterExpression", "{", S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_PENDING)), "}",
+																			"}",
+																		"]");
+
+			if (command_p)
+				{
+					bson_error_t error;
+
+					if (!mongoc_collection_write_command_with_opts (data_p -> dftsd_mongo_p -> mt_collection_p, command_p, NULL, NULL, &error))
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add index \"%s\" to \"%s\": \"%s\"", S_PENDING_INDEX_S, S_POST_SAVE_COLLECTION_S, error.message);
+						}
+
+					bson_destroy (command_p);
+				}
+		}
+}
+
+
+static void FreeStudyPostSaveQueue (StudyPostSaveQueue *queue_p)
+{
+	pthread_cond_destroy (& (queue_p -> spsq_cond));
+	pthread_mutex_destroy (& (queue_p -> spsq_mutex));
+
+	FreeMemory (queue_p -> spsq_workers_p);
+	FreeMemory (queue_p);
+}
+
+
+static void *RunStudyPostSaveWorker (void *data_p)
+{
+	StudyPostSaveWorker *worker_p = (StudyPostSaveWorker *) data_p;
+	StudyPostSaveQueue *queue_p = worker_p -> spsw_queue_p;
+
+	/*
+	 * Each worker has its own Service so that it has its own
+	 * database connection and configuration
+	 */
+	Service *service_p = GetFieldTrialIndexingService (queue_p -> spsq_grassroots_p);
+
+	if (!service_p)
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create service for post-save worker " UINT32_FMT, worker_p -> spsw_index);
+			FreeMemory (worker_p);
+			return NULL;
+		}
+
+	pthread_mutex_lock (& (queue_p -> spsq_mutex));
+
+	while (! (queue_p -> spsq_stop_flag))
+		{
+			bson_oid_t entry_id;
+			bson_oid_t study_id;
+			time_t wait_until = 0;
+			bool claimed_flag;
+
+			pthread_mutex_unlock (& (queue_p -> spsq_mutex));
+
+			claimed_flag = ClaimNextStudyPostSaveEntry (&entry_id, &study_id, &wait_until, (FieldTrialServiceData *) (service_p -> se_data_p));
+
+			if (claimed_flag)
+				{
+					RunQueuedStudyPostSaveTasks (&entry_id, &study_id, service_p);
+				}
+
+			/*
+			 * The worker's Service lasts for as long as the worker does, so
+			 * let the shared caches free anything that it has finished with.
+			 */
+			RefreshSharedCachesPin ((FieldTrialServiceData *) (service_p -> se_data_p));
+
+			pthread_mutex_lock (& (queue_p -> spsq_mutex));
+
+			if (claimed_flag)
+				{
+					/*
+					 * Another save of this Study might have been waiting for us to finish
+					 */
+					pthread_cond_broadcast (& (queue_p -> spsq_cond));
+				}
+			else if (! (queue_p -> spsq_stop_flag))
+				{
+					/*
+					 * Other processes can add to the queue without signalling
+					 * us, so we never wait for longer than the poll interval.
+					 */
+					const time_t poll_time = time (NULL) + SPSQ_POLL_INTERVAL;
+					struct timespec ts;
+
+					if ((wait_until == 0) || (wait_until > poll_time))
+						{
+							wait_until = poll_time;
+						}
+
+					ts.tv_sec = wait_until;
+					ts.tv_nsec = 0;
+
+					pthread_cond_timedwait (& (queue_p -> spsq_cond), & (queue_p -> spsq_mutex), &ts);
+				}
+		}
+
+	pthread_mutex_unlock (& (queue_p -> spsq_mutex));
+
+	FreeService (service_p);
+	FreeMemory (worker_p);
+
+	return NULL;
+}
+
+
+/*
+ * Add a pending entry for the Study. If there is already one, this
+ * save will be picked up by that rebuild.
+ */
+static bool AddStudyPostSaveEntry (const bson_oid_t *study_id_p, const uint32 delay, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_POST_SAVE_COLLECTION_S))
+		{
+			const time_t now = time (NULL);
+			bson_t *query_p = BCON_NEW (S_STUDY_ID_S, BCON_OID (study_id_p), S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_PENDING)));
+			bson_t *update_p = BCON_NEW ("$setOnInsert", "{", S_QUEUED_S, BCON_INT64 ((int64_t) now), S_DUE_S, BCON_INT64 ((int64_t) (now + delay)), "}");
+			bson_t *opts_p = BCON_NEW ("upsert", BCON_BOOL (true));
+
+			if (query_p && update_p && opts_p)
+				{
+					bson_error_t error;
+
+					if (mongoc_collection_update_one (data_p -> dftsd_mongo_p -> mt_collection_p, query_p, update_p, opts_p, NULL, &error))
+						{
+							success_flag = true;
+						}
+					else if (error.code == SPSQ_DUPLICATE_KEY_ERROR)
+						{
+							/*
+							 * Another process has just added the pending entry
+							 * so this save will be picked up by that one
+							 */
+							success_flag = true;
+						}
+					else
+						{
+							PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, query_p, "Failed to add post-save entry: \"%s\"", error.message);
+						}
+				}
+
+			if (opts_p)
+				{
+					bson_destroy (opts_p);
+				}
+
+			if (update_p)
+				{
+					bson_destroy (update_p);
+				}
+
+			if (query_p)
+				{
+					bson_destroy (query_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * Find the next entry that is due and mark it as running. If there
+ * isn't one, wait_until_p is set to the time that the next pending
+ * entry will be due, or 0 if that is not known.
+ */
+static bool ClaimNextStudyPostSaveEntry (bson_oid_t *entry_id_p, bson_oid_t *study_id_p, time_t *wait_until_p, const FieldTrialServiceData *data_p)
+{
+	bool claimed_flag = false;
+
+	*wait_until_p = 0;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_POST_SAVE_COLLECTION_S))
+		{
+			mongoc_collection_t *collection_p = data_p -> dftsd_mongo_p -> mt_collection_p;
+			const time_t now = time (NULL);
+			const time_t stale_time = now - (time_t) (data_p -> dftsd_post_save_stale_time);
+			bson_t *query_p = BCON_NEW ("$or", "[",
+																	"{", S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_PENDING)), "}",
+																	"{", S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_STARTED)), S_STARTED_S, "{", "$lt", BCON_INT64 ((int64_t) stale_time), "}", "}",
+																"]");
+			bson_t *opts_p = BCON_NEW ("sort", "{", S_DUE_S, BCON_INT32 (1), "}");
+
+			if (query_p && opts_p)
+				{
+					mongoc_cursor_t *cursor_p = mongoc_collection_find_with_opts (collection_p, query_p, opts_p, NULL);
+
+					if (cursor_p)
+						{
+							const bson_t *doc_p = NULL;
+							bson_error_t error;
+
+							while ((!claimed_flag) && (*wait_until_p == 0) && mongoc_cursor_next (cursor_p, &doc_p))
+								{
+									bson_iter_t iter;
+									time_t due = 0;
+
+									if (bson_iter_init_find (&iter, doc_p, S_DUE_S))
+										{
+											due = (time_t) bson_iter_as_int64 (&iter);
+										}
+
+									if (due <= now)
+										{
+											if (bson_iter_init_find (&iter, doc_p, S_STUDY_ID_S) && BSON_ITER_HOLDS_OID (&iter))
+												{
+													bson_oid_copy (bson_iter_oid (&iter), study_id_p);
+
+													/*
+													 * Don't rebuild the same Study on two workers at once
+													 */
+													if (!IsStudyRunning (collection_p, study_id_p, stale_time))
+														{
+															if (ClaimStudyPostSaveEntry (collection_p, doc_p, now))
+																{
+																	if (bson_iter_init_find (&iter, doc_p, MONGO_ID_S) && BSON_ITER_HOLDS_OID (&iter))
+																		{
+																			bson_oid_copy (bson_iter_oid (&iter), entry_id_p);
+																			claimed_flag = true;
+																		}
+																}
+														}
+												}
+											else
+												{
+													PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, doc_p, "Post-save entry has no study id");
+												}
+										}
+									else
+										{
+											/*
+											 * The entries are sorted by due time so this is the
+											 * earliest that the next one will be ready
+											 */
+											*wait_until_p = due;
+										}
+								}
+
+							if (mongoc_cursor_error (cursor_p, &error))
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to get post-save entries: \"%s\"", error.message);
+								}
+
+							mongoc_cursor_destroy (cursor_p);
+						}		/* if (cursor_p) */
+
+				}
+
+			if (opts_p)
+				{
+					bson_destroy (opts_p);
+				}
+
+			if (query_p)
+				{
+					bson_destroy (query_p);
+				}
+		}
+
+	return claimed_flag;
+}
+
+
+static bool IsStudyRunning (mongoc_collection_t *collection_p, const bson_oid_t *study_id_p, const time_t stale_time)
+{
+	bool running_flag = true;
+	bson_t *query_p = BCON_NEW (S_STUDY_ID_S, BCON_OID (study_id_p),
+															S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_STARTED)),
+															S_STARTED_S, "{", "$gte", BCON_INT64 ((int64_t) stale_time), "}");
+
+	if (query_p)
+		{
+			bson_error_t error;
+			int64_t count = mongoc_collection_count_documents (collection_p, query_p, NULL, NULL, NULL, &error);
+
+			if (count == 0)
+				{
+					running_flag = false;
+				}
+			else if (count < 0)
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to count running post-save entries: \"%s\"", error.message);
+				}
+
+			bson_destroy (query_p);
+		}
+
+	return running_flag;
+}
+
+
+/*
+ * Mark an entry as running. This only succeeds if the entry hasn't been
+ * changed since it was read, so that only one worker across all of the
+ * processes using the queue can claim it.
+ */
+static bool ClaimStudyPostSaveEntry (mongoc_collection_t *collection_p, const bson_t *entry_p, const time_t now)
+{
+	bool claimed_flag = false;
+	bson_iter_t iter;
+
+	if (bson_iter_init_find (&iter, entry_p, MONGO_ID_S) && BSON_ITER_HOLDS_OID (&iter))
+		{
+			const bson_oid_t *id_p = bson_iter_oid (&iter);
+			bson_t *query_p = NULL;
+
+			if (bson_iter_init_find (&iter, entry_p, S_STARTED_S))
+				{
+					query_p = BCON_NEW (MONGO_ID_S, BCON_OID (id_p), S_STARTED_S, BCON_INT64 (bson_iter_as_int64 (&iter)));
+				}
+			else
+				{
+					query_p = BCON_NEW (MONGO_ID_S, BCON_OID (id_p), S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_PENDING)));
+				}
+
+			if (query_p)
+				{
+					bson_t *update_p = BCON_NEW ("$set", "{", S_STATUS_S, BCON_UTF8 (GetOperationStatusAsString (OS_STARTED)), S_STARTED_S, BCON_INT64 ((int64_t) now), "}");
+
+					if (update_p)
+						{
+							bson_t reply;
+							bson_error_t error;
+
+							if (mongoc_collection_update_one (collection_p, query_p, update_p, NULL, &reply, &error))
+								{
+									if (bson_iter_init_find (&iter, &reply, "modifiedCount") && (bson_iter_as_int64 (&iter) == 1))
+										{
+											claimed_flag = true;
+										}
+								}
+							else
+								{
+									PrintBSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, entry_p, "Failed to claim post-save entry: \"%s\"", error.message);
+								}
+
+							bson_destroy (&reply);
+							bson_destroy (update_p);
+						}
+
+					bson_destroy (query_p);
+				}
+		}
+
+	return claimed_flag;
+}
+
+
+/*
+ * Store the result of a rebuild so that it can be polled with
+ * GetStudyPostSaveStatus () and remove the results of any
+ * earlier rebuilds of the Study.
+ */
+static bool FinishStudyPostSaveEntry (const bson_oid_t *entry_id_p, const bson_oid_t *study_id_p, const OperationStatus status, json_t *errors_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+
+	if (SetMongoToolCollection (data_p -> dftsd_mongo_p, S_POST_SAVE_COLLECTION_S))
+		{
+			json_t *update_json_p = json_pack ("{s:{s:s,s:I,s:O?}}", "$set",
+																				 S_STATUS_S, GetOperationStatusAsString (status),
+																				 S_FINISHED_S, (json_int_t) time (NULL),
+																				 S_ERRORS_S, errors_p);
+
+			if (update_json_p)
+				{
+					bson_t *update_p = ConvertJSONToBSON (update_json_p);
+
+					if (update_p)
+						{
+							bson_t *query_p = BCON_NEW (MONGO_ID_S, BCON_OID (entry_id_p));
+
+							if (query_p)
+								{
+									bson_error_t error;
+
+									if (mongoc_collection_update_one (data_p -> dftsd_mongo_p -> mt_collection_p, query_p, update_p, NULL, NULL, &error))
+										{
+											bson_t *old_p = BCON_NEW (S_STUDY_ID_S, BCON_OID (study_id_p),
+																								MONGO_ID_S, "{", "$ne", BCON_OID (entry_id_p), "}",
+																								S_STATUS_S, "{", "$nin", "[", BCON_UTF8 (GetOperationStatusAsString (OS_PENDING)), BCON_UTF8 (GetOperationStatusAsString (OS_STARTED)), "]", "}");
+
+											success_flag = true;
+
+											if (old_p)
+												{
+													if (!RemoveMongoDocumentsByBSON (data_p -> dftsd_mongo_p, old_p, false))
+														{
+															PrintBSONToErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, old_p, "Failed to remove old post-save entries");
+														}
+
+													bson_destroy (old_p);
+												}
+										}
+									else
+										{
+											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, update_json_p, "Failed to update post-save entry: \"%s\"", error.message);
+										}
+
+									bson_destroy (query_p);
+								}
+
+							bson_destroy (update_p);
+						}
+
+					json_decref (update_json_p);
+				}
+		}
+
+	return success_flag;
+}
+
+
+static void RunQueuedStudyPostSaveTasks (const bson_oid_t *entry_id_p, const bson_oid_t *study_id_p, Service *service_p)
+{
+	FieldTrialServiceData *data_p = (FieldTrialServiceData *) (service_p -> se_data_p);
+	char id_s [MONGO_OID_STRING_BUFFER_SIZE];
+
+	bson_oid_to_string (study_id_p, id_s);
+
+	service_p -> se_jobs_p = AllocateSimpleServiceJobSet (service_p, NULL, "Study post-save");
+
+	if (service_p -> se_jobs_p)
+		{
+			ServiceJob *job_p = GetServiceJobFromServiceJobSet (service_p -> se_jobs_p, 0);
+			OperationStatus status = OS_FAILED;
+
+			/*
+			 * Load the latest version of the Study as there might
+			 * have been more than one save since this was queued
+			 */
+			Study *study_p = GetStudyByIdString (id_s, VF_STORAGE, data_p);
+
+			if (study_p)
+				{
+					status = RunStudyPostSaveTasks (study_p, job_p, data_p);
+
+					if (status == OS_SUCCEEDED)
+						{
+							PrintLog (STM_LEVEL_FINE, __FILE__, __LINE__, "Rebuilt Study \"%s\"", study_p -> st_name_s);
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Rebuilding Study \"%s\" with id \"%s\" had status %s", study_p -> st_name_s, id_s, GetOperationStatusAsString (status));
+						}
+
+					FreeStudy (study_p);
+				}
+			else
+				{
+					AddGeneralErrorMessageToServiceJob (job_p, "Failed to load Study");
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to load Study with id \"%s\" for rebuilding", id_s);
+				}
+
+			SetServiceJobStatus (job_p, status);
+
+			/*
+			 * The job's status and errors are kept in the queue's
+			 * collection once the job itself has gone.
+			 */
+			if (!FinishStudyPostSaveEntry (entry_id_p, study_id_p, status, job_p -> sj_errors_p, data_p))
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to store post-save status for Study with id \"%s\"", id_s);
+				}
+
+			FreeServiceJobSet (service_p -> se_jobs_p);
+			service_p -> se_jobs_p = NULL;
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate job for rebuilding Study with id \"%s\"", id_s);
+
+			FinishStudyPostSaveEntry (entry_id_p, study_id_p, OS_FAILED, NULL, data_p);
+		}
+}
@@ -0,0 +1,664 @@
+/*
+ * study_reindexer.c
+ *
+ *  Created on: 17 Oct 2026
+ *      Author: billy
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "study_reindexer.h"
+#include "indexing.h"
+#include "study.h"
+#include "study_jobs.h"
+
+#include "lucene_tool.h"
+#include "grassroots_server.h"
+#include "service.h"
+#include "service_job.h"
+#include "data_resource.h"
+#include "json_util.h"
+#include "memory_allocations.h"
+#include "streams.h"
+
+
+/**
+ * The maximum number of Studies to send to Lucene at once.
+ */
+static const size_t S_BATCH_SIZE = 32;
+
+
+/**
+ * The Study ids to be indexed along with the progress
+ * of the workers that are indexing them.
+ */
+typedef struct StudyReindexer
+{
+	/** Guards the queue position and the counts. */
+	pthread_mutex_t sr_mutex;
+
+	/**
+	 * Lucene only allows a single writer for an index so the
+	 * workers take turns to add their batches.
+	 */
+	pthread_mutex_t sr_index_mutex;
+
+	/** The ids of the Studies that need indexing. */
+	char (*sr_ids_p) [MONGO_OID_STRING_BUFFER_SIZE];
+
+	/** The number of entries in sr_ids_p. */
+	size_t sr_num_ids;
+
+	/** The index in sr_ids_p of the next Study to give to a worker. */
+	size_t sr_next_index;
+
+	/** The number of Studies that were indexed by a previous run. */
+	size_t sr_num_skipped;
+
+	size_t sr_num_indexed;
+
+	size_t sr_num_failed;
+
+	size_t sr_num_plots;
+
+	/** The file to append the ids of indexed Studies to. This can be NULL. */
+	FILE *sr_checkpoint_f;
+
+	GrassrootsServer *sr_grassroots_p;
+
+	time_t sr_start_time;
+
+	time_t sr_end_time;
+
+} StudyReindexer;
+
+
+/**
+ * The data passed to each worker thread.
+ */
+typedef struct StudyReindexWorker
+{
+	StudyReindexer *srw_reindexer_p;
+
+	uint32 srw_index;
+
+	pthread_t srw_thread;
+
+} StudyReindexWorker;
+
+
+static bool SetStudyReindexerIds (StudyReindexer *reindexer_p, const FieldTrialServiceData *data_p);
+
+static json_t *GetCheckpointedStudyIds (const char * const path_s);
+
+static OperationStatus RunStudyReindexWorkers (StudyReindexer *reindexer_p, uint32 num_workers);
+
+static void *RunStudyReindexWorker (void *data_p);
+
+static void IndexStudyBatches (StudyReindexer *reindexer_p, const uint32 worker_index, LuceneTool *lucene_p, FieldTrialServiceData *data_p);
+
+static const char *GetNextStudyIdToReindex (StudyReindexer *reindexer_p);
+
+static void IndexStudyBatch (StudyReindexer *reindexer_p, LuceneTool *lucene_p, json_t *batch_p, char (*batch_ids_p) [MONGO_OID_STRING_BUFFER_SIZE], const size_t num_plots);
+
+static void AddStudyFailures (StudyReindexer *reindexer_p, const size_t num_failed);
+
+static bool AddStudyReindexerResultToServiceJob (ServiceJob *job_p, const StudyReindexer *reindexer_p);
+
+
+
+OperationStatus ReindexStudiesInParallel (ServiceJob *job_p, const FieldTrialServiceData *data_p)
+{
+	OperationStatus status = OS_FAILED;
+	StudyReindexer reindexer;
+
+	memset (&reindexer, 0, sizeof (StudyReindexer));
+	reindexer.sr_grassroots_p = GetGrassrootsServerFromService (job_p -> sj_service_p);
+
+	if (SetStudyReindexerIds (&reindexer, data_p))
+		{
+			if (reindexer.sr_num_ids > 0)
+				{
+					if (data_p -> dftsd_reindex_checkpoint_path_s)
+						{
+							reindexer.sr_checkpoint_f = fopen (data_p -> dftsd_reindex_checkpoint_path_s, "a");
+
+							/*
+							 * We can still do the reindex, it just won't be resumable
+							 */
+							if (! (reindexer.sr_checkpoint_f))
+								{
+									PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to open reindex checkpoint file \"%s\"", data_p -> dftsd_reindex_checkpoint_path_s);
+								}
+						}
+
+					status = RunStudyReindexWorkers (&reindexer, data_p -> dftsd_reindex_num_workers);
+
+					if (reindexer.sr_checkpoint_f)
+						{
+							fclose (reindexer.sr_checkpoint_f);
+						}
+				}
+			else
+				{
+					/* A previous run got through all of them */
+					status = OS_SUCCEEDED;
+				}
+
+			/*
+			 * Once all of the studies are done, the next reindex
+			 * needs to start from the beginning again
+			 */
+			if ((status == OS_SUCCEEDED) && (data_p -> dftsd_reindex_checkpoint_path_s))
+				{
+					if ((remove (data_p -> dftsd_reindex_checkpoint_path_s) != 0) && (errno != ENOENT))
+						{
+							PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to remove reindex checkpoint file \"%s\"", data_p -> dftsd_reindex_checkpoint_path_s);
+						}
+				}
+
+			if (reindexer.sr_num_failed > 0)
+				{
+					AddGeneralErrorMessageToServiceJob (job_p, "Failed to index some of the studies");
+				}
+
+			AddStudyReindexerResultToServiceJob (job_p, &reindexer);
+
+			if (reindexer.sr_ids_p)
+				{
+					FreeMemory (reindexer.sr_ids_p);
+				}
+
+		}		/* if (SetStudyReindexerIds (&reindexer, data_p)) */
+
+	return status;
+}
+
+
+static bool SetStudyReindexerIds (StudyReindexer *reindexer_p, const FieldTrialServiceData *data_p)
+{
+	bool success_flag = false;
+	json_t *id_results_p = GetAllStudyIds (data_p -> dftsd_base_data.sd_service_p);
+
+	if (id_results_p)
+		{
+			const size_t num_results = json_array_size (id_results_p);
+
+			if (num_results > 0)
+				{
+					reindexer_p -> sr_ids_p = AllocMemoryArray (num_results, MONGO_OID_STRING_BUFFER_SIZE);
+
+					if (reindexer_p -> sr_ids_p)
+						{
+							json_t *done_ids_p = NULL;
+							json_t *id_result_p;
+							size_t i;
+
+							if (data_p -> dftsd_reindex_checkpoint_path_s)
+								{
+									done_ids_p = GetCheckpointedStudyIds (data_p -> dftsd_reindex_checkpoint_path_s);
+								}
+
+							json_array_foreach (id_results_p, i, id_result_p)
+								{
+									bson_oid_t id;
+
+									if (GetMongoIdFromJSON (id_result_p, &id))
+										{
+											char *id_s = * ((reindexer_p -> sr_ids_p) + (reindexer_p -> sr_num_ids));
+
+											bson_oid_to_string (&id, id_s);
+
+											if (done_ids_p && json_object_get (done_ids_p, id_s))
+												{
+													++ (reindexer_p -> sr_num_skipped);
+												}
+											else
+												{
+													++ (reindexer_p -> sr_num_ids);
+												}
+										}
+									else
+										{
+											PrintJSONToErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, id_result_p, "GetMongoIdFromJSON () failed");
+											++ (reindexer_p -> sr_num_failed);
+										}
+								}
+
+							if (done_ids_p)
+								{
+									json_decref (done_ids_p);
+								}
+
+							success_flag = true;
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate " SIZET_FMT " study ids for reindexing", num_results);
+						}
+				}
+			else
+				{
+					success_flag = true;
+				}
+
+			json_decref (id_results_p);
+		}		/* if (id_results_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GetAllStudyIds () failed");
+		}
+
+	return success_flag;
+}
+
+
+/*
+ * The checkpoint file has one Study id per line. If the file doesn't exist
+ * then this isn't an error, it just means we are starting from scratch.
+ */
+static json_t *GetCheckpointedStudyIds (const char * const path_s)
+{
+	json_t *ids_p = NULL;
+	FILE *in_f = fopen (path_s, "r");
+
+	if (in_f)
+		{
+			ids_p = json_object ();
+
+			if (ids_p)
+				{
+					char buffer_s [MONGO_OID_STRING_BUFFER_SIZE + 2];
+
+					while (fgets (buffer_s, sizeof (buffer_s), in_f))
+						{
+							char *newline_s = strchr (buffer_s, '\n');
+
+							if (newline_s)
+								{
+									*newline_s = '\0';
+								}
+
+							if (*buffer_s != '\0')
+								{
+									if (json_object_set_new (ids_p, buffer_s, json_true ()) != 0)
+										{
+											PrintErrors (STM_LEVEL_WARNING, __FILE__, __LINE__, "Failed to add \"%s\" from reindex checkpoint file \"%s\"", buffer_s, path_s);
+										}
+								}
+						}
+
+					PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Resuming reindex from \"%s\" with " SIZET_FMT " studies already indexed", path_s, json_object_size (ids_p));
+				}
+
+			fclose (in_f);
+		}
+
+	return ids_p;
+}
+
+
+static OperationStatus RunStudyReindexWorkers (StudyReindexer *reindexer_p, uint32 num_workers)
+{
+	OperationStatus status = OS_FAILED;
+	StudyReindexWorker *workers_p = NULL;
+
+	if (num_workers > reindexer_p -> sr_num_ids)
+		{
+			num_workers = (uint32) (reindexer_p -> sr_num_ids);
+		}
+
+	workers_p = (StudyReindexWorker *) AllocMemoryArray (num_workers, sizeof (StudyReindexWorker));
+
+	if (workers_p)
+		{
+			uint32 num_started = 0;
+			uint32 i;
+
+			pthread_mutex_init (& (reindexer_p -> sr_mutex), NULL);
+			pthread_mutex_init (& (reindexer_p -> sr_index_mutex), NULL);
+
+			reindexer_p -> sr_start_time = time (NULL);
+
+			for (i = 0; i < num_workers; ++ i)
+				{
+					StudyReindexWorker *worker_p = workers_p + i;
+
+					worker_p -> srw_reindexer_p = reindexer_p;
+					worker_p -> srw_index = i;
+
+					if (pthread_create (& (worker_p -> srw_thread), NULL, RunStudyReindexWorker, worker_p) == 0)
+						{
+							++ num_started;
+						}
+					else
+						{
+							/*
+							 * The workers that have started will get through all
+							 * of the studies, it'll just take a bit longer
+							 */
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to start reindex worker " UINT32_FMT, i);
+							break;
+						}
+				}
+
+			PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Reindexing " SIZET_FMT " studies with " UINT32_FMT " workers", reindexer_p -> sr_num_ids, num_started);
+
+			for (i = 0; i < num_started; ++ i)
+				{
+					pthread_join ((workers_p + i) -> srw_thread, NULL);
+				}
+
+			reindexer_p -> sr_end_time = time (NULL);
+
+			pthread_mutex_destroy (& (reindexer_p -> sr_index_mutex));
+			pthread_mutex_destroy (& (reindexer_p -> sr_mutex));
+
+			FreeMemory (workers_p);
+
+			if ((reindexer_p -> sr_num_indexed == reindexer_p -> sr_num_ids) && (reindexer_p -> sr_num_failed == 0))
+				{
+					status = OS_SUCCEEDED;
+				}
+			else if (reindexer_p -> sr_num_indexed > 0)
+				{
+					status = OS_PARTIALLY_SUCCEEDED;
+				}
+
+		}		/* if (workers_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate " UINT32_FMT " reindex workers", num_workers);
+		}
+
+	return status;
+}
+
+
+static void *RunStudyReindexWorker (void *data_p)
+{
+	StudyReindexWorker *worker_p = (StudyReindexWorker *) data_p;
+	StudyReindexer *reindexer_p = worker_p -> srw_reindexer_p;
+
+	/*
+	 * Each worker has its own Service so that it has its own
+	 * database connection and caches
+	 */
+	Service *service_p = GetFieldTrialIndexingService (reindexer_p -> sr_grassroots_p);
+
+	if (service_p)
+		{
+			service_p -> se_jobs_p = AllocateSimpleServiceJobSet (service_p, NULL, "Reindex studies");
+
+			if (service_p -> se_jobs_p)
+				{
+					ServiceJob *job_p = GetServiceJobFromServiceJobSet (service_p -> se_jobs_p, 0);
+					LuceneTool *lucene_p = AllocateLuceneTool (reindexer_p -> sr_grassroots_p, job_p -> sj_id);
+
+					if (lucene_p)
+						{
+							if (SetLuceneToolName (lucene_p, "index_studies"))
+								{
+									IndexStudyBatches (reindexer_p, worker_p -> srw_index, lucene_p, (FieldTrialServiceData *) (service_p -> se_data_p));
+								}
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "SetLuceneToolName () failed for reindex worker " UINT32_FMT, worker_p -> srw_index);
+								}
+
+							FreeLuceneTool (lucene_p);
+						}
+					else
+						{
+							PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate LuceneTool for reindex worker " UINT32_FMT, worker_p -> srw_index);
+						}
+
+					FreeServiceJobSet (service_p -> se_jobs_p);
+					service_p -> se_jobs_p = NULL;
+				}
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate job for reindex worker " UINT32_FMT, worker_p -> srw_index);
+				}
+
+			FreeService (service_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create service for reindex worker " UINT32_FMT, worker_p -> srw_index);
+		}
+
+	return NULL;
+}
+
+
+static void IndexStudyBatches (StudyReindexer *reindexer_p, const uint32 worker_index, LuceneTool *lucene_p, FieldTrialServiceData *data_p)
+{
+	json_t *batch_p = json_array ();
+
+	if (batch_p)
+		{
+			char (*batch_ids_p) [MONGO_OID_STRING_BUFFER_SIZE] = AllocMemoryArray (S_BATCH_SIZE, MONGO_OID_STRING_BUFFER_SIZE);
+
+			if (batch_ids_p)
+				{
+					size_t num_plots = 0;
+					const char *id_s;
+
+					while ((id_s = GetNextStudyIdToReindex (reindexer_p)) != NULL)
+						{
+							Study *study_p = GetStudyByIdString (id_s, VF_CLIENT_FULL, data_p);
+							bool added_flag = false;
+
+							if (study_p)
+								{
+									json_t *study_json_p = GetStudyIndexingJSON (study_p, data_p);
+
+									if (study_json_p)
+										{
+											const size_t i = json_array_size (batch_p);
+
+											if (json_array_append_new (batch_p, study_json_p) == 0)
+												{
+													memcpy (* (batch_ids_p + i), id_s, MONGO_OID_STRING_BUFFER_SIZE);
+													num_plots += study_p -> st_plots_p -> ll_size;
+													added_flag = true;
+												}
+											else
+												{
+													PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to add Study \"%s\" to reindex batch", study_p -> st_name_s);
+												}
+										}
+
+									FreeStudy (study_p);
+								}		/* if (study_p) */
+							else
+								{
+									PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "GetStudyByIdString () failed for \"%s\"", id_s);
+								}
+
+							if (!added_flag)
+								{
+									AddStudyFailures (reindexer_p, 1);
+								}
+
+							if (json_array_size (batch_p) == S_BATCH_SIZE)
+								{
+									IndexStudyBatch (reindexer_p, lucene_p, batch_p, batch_ids_p, num_plots);
+									num_plots = 0;
+								}
+						}
+
+					if (json_array_size (batch_p) > 0)
+						{
+							IndexStudyBatch (reindexer_p, lucene_p, batch_p, batch_ids_p, num_plots);
+						}
+
+					FreeMemory (batch_ids_p);
+				}		/* if (batch_ids_p) */
+			else
+				{
+					PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate batch ids for reindex worker " UINT32_FMT, worker_index);
+				}
+
+			json_decref (batch_p);
+		}		/* if (batch_p) */
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to allocate batch for reindex worker " UINT32_FMT, worker_index);
+		}
+}
+
+
+static const char *GetNextStudyIdToReindex (StudyReindexer *reindexer_p)
+{
+	const char *id_s = NULL;
+
+	pthread_mutex_lock (& (reindexer_p -> sr_mutex));
+
+	if (reindexer_p -> sr_next_index < reindexer_p -> sr_num_ids)
+		{
+			id_s = * ((reindexer_p -> sr_ids_p) + (reindexer_p -> sr_next_index));
+			++ (reindexer_p -> sr_next_index);
+		}
+
+	pthread_mutex_unlock (& (reindexer_p -> sr_mutex));
+
+	return id_s;
+}
+
+
+static void IndexStudyBatch (StudyReindexer *reindexer_p, LuceneTool *lucene_p, json_t *batch_p, char (*batch_ids_p) [MONGO_OID_STRING_BUFFER_SIZE], const size_t num_plots)
+{
+	const size_t num_studies = json_array_size (batch_p);
+	OperationStatus status;
+
+	pthread_mutex_lock (& (reindexer_p -> sr_index_mutex));
+
+	status = IndexLucene (lucene_p, batch_p, true);
+
+	if (status == OS_SUCCEEDED)
+		{
+			if (reindexer_p -> sr_checkpoint_f)
+				{
+					size_t i;
+
+					for (i = 0; i < num_studies; ++ i)
+						{
+							fprintf (reindexer_p -> sr_checkpoint_f, "%s\n", * (batch_ids_p + i));
+						}
+
+					fflush (reindexer_p -> sr_checkpoint_f);
+				}
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "IndexLucene () failed for batch of " SIZET_FMT " studies starting with \"%s\"", num_studies, *batch_ids_p);
+		}
+
+	pthread_mutex_unlock (& (reindexer_p -> sr_index_mutex));
+
+	if (status == OS_SUCCEEDED)
+		{
+			double elapsed;
+
+			pthread_mutex_lock (& (reindexer_p -> sr_mutex));
+
+			reindexer_p -> sr_num_indexed += num_studies;
+			reindexer_p -> sr_num_plots += num_plots;
+
+			elapsed = difftime (time (NULL), reindexer_p -> sr_start_time);
+
+			if (elapsed > 0.0)
+				{
+					PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Reindexed " SIZET_FMT " of " SIZET_FMT " studies, %.2f studies/s, %.2f plots/s",
+										reindexer_p -> sr_num_indexed, reindexer_p -> sr_num_ids,
+										reindexer_p -> sr_num_indexed / elapsed, reindexer_p -> sr_num_plots / elapsed);
+				}
+			else
+				{
+					PrintLog (STM_LEVEL_INFO, __FILE__, __LINE__, "Reindexed " SIZET_FMT " of " SIZET_FMT " studies", reindexer_p -> sr_num_indexed, reindexer_p -> sr_num_ids);
+				}
+
+			pthread_mutex_unlock (& (reindexer_p -> sr_mutex));
+		}
+	else
+		{
+			AddStudyFailures (reindexer_p, num_studies);
+		}
+
+	json_array_clear (batch_p);
+}
+
+
+static void AddStudyFailures (StudyReindexer *reindexer_p, const size_t num_failed)
+{
+	pthread_mutex_lock (& (reindexer_p -> sr_mutex));
+	reindexer_p -> sr_num_failed += num_failed;
+	pthread_mutex_unlock (& (reindexer_p -> sr_mutex));
+}
+
+
+static bool AddStudyReindexerResultToServiceJob (ServiceJob *job_p, const StudyReindexer *reindexer_p)
+{
+	bool success_flag = false;
+	double elapsed = 0.0;
+	double studies_per_second = 0.0;
+	double plots_per_second = 0.0;
+	json_t *stats_p = NULL;
+
+	if (reindexer_p -> sr_start_time > 0)
+		{
+			elapsed = difftime (reindexer_p -> sr_end_time, reindexer_p -> sr_start_time);
+
+			if (elapsed > 0.0)
+				{
+					studies_per_second = reindexer_p -> sr_num_indexed / elapsed;
+					plots_per_second = reindexer_p -> sr_num_plots / elapsed;
+				}
+		}
+
+	stats_p = json_pack ("{s:I,s:I,s:I,s:I,s:I,s:f,s:f,s:f}",
+											 "studies", (json_int_t) (reindexer_p -> sr_num_ids + reindexer_p -> sr_num_skipped),
+											 "indexed", (json_int_t) reindexer_p -> sr_num_indexed,
+											 "skipped", (json_int_t) reindexer_p -> sr_num_skipped,
+											 "failed", (json_int_t) reindexer_p -> sr_num_failed,
+											 "plots", (json_int_t) reindexer_p -> sr_num_plots,
+											 "seconds", elapsed,
+											 "studies_per_second", studies_per_second,
+											 "plots_per_second", plots_per_second);
+
+	if (stats_p)
+		{
+			json_t *dest_record_p = GetDataResourceAsJSONByParts (PROTOCOL_INLINE_S, NULL, "Study Reindexing", stats_p);
+
+			if (dest_record_p)
+				{
+					if (AddResultToServiceJob (job_p, dest_record_p))
+						{
+							success_flag = true;
+						}
+					else
+						{
+							json_decref (dest_record_p);
+							PrintErrors (STM_LEVEL_INFO, __FILE__, __LINE__, "AddResultToServiceJob failed for study reindexing statistics");
+						}
+				}
+			else
+				{
+					PrintJSONToErrors (STM_LEVEL_INFO, __FILE__, __LINE__, stats_p, "GetDataResourceAsJSONByParts failed for study reindexing statistics");
+				}
+
+			json_decref (stats_p);
+		}
+	else
+		{
+			PrintErrors (STM_LEVEL_SEVERE, __FILE__, __LINE__, "Failed to create study reindexing statistics");
+		}
+
+	return success_flag;
+}
@@ -203,6 +203,9 @@ static ServiceJobSet *RunPlotsSubmissionService (Service *service_p, ParameterSe
 {
 	FieldTrialServiceData *data_p = (FieldTrialServiceData *) (service_p -> se_data_p);
 
+	/* Each observation looks up its MeasuredVariable so fill the cache first */
+	RewarmMeasuredVariablesCacheIfNeeded (data_p);
+
 	service_p -> se_jobs_p = AllocateSimpleServiceJobSet (service_p, NULL, "Submit Plots");
 
 	if (service_p -> se_jobs_p)
@@ -28,6 +28,7 @@
 #include "study_jobs.h"
 #include "treatment_factor_jobs.h"
 #include "person_jobs.h"
+#include "study_post_save_queue.h"
 
 #include "string_array_parameter.h"
 #include "json_parameter.h"
@@ -101,6 +102,15 @@ Service *GetStudySubmissionService (GrassrootsServer *grassroots_p)
 								{
 									service_p -> se_custom_parameter_decoder_fn = CreateStudyParameterFromJSON;
 
+									/*
+									 * Start the workers now so that any rebuilds left
+									 * over from before a restart are run straight away.
+									 */
+									if (data_p -> dftsd_post_save_num_workers > 0)
+										{
+											StartStudyPostSaveQueue (data_p);
+										}
+
 									return service_p;
 								}
 
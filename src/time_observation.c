@@ -6,6 +6,8 @@
  */
 
 
+#include <string.h>
+
 #include "time_observation.h"
 #include "dfw_util.h"
 #include "math_utils.h"
@@ -34,7 +36,7 @@ static bool GetTimeObservationValueAsString (const struct Observation *observati
 
 
 TimeObservation *AllocateTimeObservation (bson_oid_t *id_p, ObservationMetadata *metadata_p, MeasuredVariable *phenotype_p, MEM_FLAG phenotype_mem, const struct tm *raw_value_p, const struct tm *corrected_value_p,
-	const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s)
+	const char *growth_stage_s, const char *method_s, Instrument *instrument_p, const ObservationNature nature, const char *notes_s, StudyArena *arena_p)
 {
 	struct tm *copied_raw_value_p = NULL;
 
@@ -44,17 +46,20 @@ TimeObservation *AllocateTimeObservation (bson_oid_t *id_p, ObservationMetadata
 
 			if (CopyValidTime (corrected_value_p, &copied_corrected_value_p))
 				{
-					TimeObservation *observation_p = (TimeObservation *) AllocMemory (sizeof (TimeObservation));
+					TimeObservation *observation_p = (TimeObservation *) AllocStudyMemory (arena_p, sizeof (TimeObservation));
 
 					if (observation_p)
 						{
+							memset (observation_p, 0, sizeof (TimeObservation));
+
 							if (InitObservation (& (observation_p -> to_base_observation), id_p, metadata_p, phenotype_p, phenotype_mem, growth_stage_s, method_s, instrument_p, nature, notes_s,
 																	 OT_TIME,
 									ClearTimeObservation,
 									AddTimeObservationValuesToJSON,
 									SetTimeObservationValueFromJSON,
 									SetTimeObservationValueFromString,
-									GetTimeObservationValueAsString))
+									GetTimeObservationValueAsString,
+									arena_p))
 								{
 									observation_p -> to_raw_value_p = copied_raw_value_p;
 									observation_p -> to_corrected_value_p = copied_corrected_value_p;
@@ -64,7 +69,7 @@ TimeObservation *AllocateTimeObservation (bson_oid_t *id_p, ObservationMetadata
 
 							ClearObservation (& (observation_p -> to_base_observation));
 							ClearTimeObservation (& (observation_p -> to_base_observation));
-							FreeMemory (observation_p);
+							FreeStudyMemory (arena_p, observation_p);
 						}
 
 					if (copied_corrected_value_p)